@@ -0,0 +1,1266 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarks.cpp
+// ============
+// benchmark modes that are selected from the command line instead of the
+// interactive render loop - results are printed to the console
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Benchmarks.h"
+#include "GLStateCache.h"
+#include "MemoryTracker.h"
+#include "MeshOptimizer.h"
+#include "MipGenerator.h"
+#include "TraceProfiler.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+// declaration of the global variables and defines
+namespace
+{
+	// frames rendered before and during each measurement
+	const int WARMUP_FRAMES = 10;
+	const int MEASURED_FRAMES = 60;
+
+	// seed for the randomly placed stress lights
+	const unsigned int STRESS_LIGHT_SEED = 1234;
+
+	// seed of the desk grid variations, and the frames measured per
+	// grid size - the largest grids take a good part of a second
+	// per frame without the frustum test
+	const unsigned int SCENE_GRID_SEED = 4321;
+	const int SCALING_MEASURED_FRAMES = 20;
+
+	// the mesh benchmark transforms the vertices of each mesh this
+	// many times with the rasterizer off, so that only the vertex
+	// work is timed
+	const int MESH_DRAW_REPEATS = 200;
+	// position, normal and texture coordinate, like the basic meshes
+	const int MESH_FLOATS_PER_VERTEX = 8;
+	const char* g_MeshVertexShaderPath = "shaders/sceneVertexShader.glsl";
+	const char* g_MeshFragmentShaderPath = "shaders/shadowDepthFragmentShader.glsl";
+
+	const float PI = 3.14159265358979f;
+
+	// rays per grid size of the picking benchmark, traced through
+	// the pick tree and, far fewer, against every draw
+	const int PICK_RAYS = 100000;
+	const int PICK_BRUTE_FORCE_RAYS = 200;
+	const unsigned int PICK_RAY_SEED = 99;
+	// the refit rows move every PICK_MOVE_INTERVAL-th draw, then
+	// every draw, by this far along x
+	const int PICK_MOVE_INTERVAL = 100;
+	const float PICK_MOVE_STEP = 0.25f;
+
+	// thumbnail tiles of the multi-view benchmark and the passes
+	// measured per view count; the cameras are spread over an arc
+	// in front of the desk, looking at its middle
+	const int THUMBNAIL_WIDTH = 320;
+	const int THUMBNAIL_HEIGHT = 240;
+	const int MULTI_VIEW_MEASURED_PASSES = 20;
+	const glm::vec3 THUMBNAIL_TARGET = glm::vec3(0.0f, 2.0f, 0.0f);
+	const float THUMBNAIL_DISTANCE = 12.0f;
+	const float THUMBNAIL_ARC_DEGREES = 140.0f;
+	const char* g_ThumbnailAtlasFilename = "thumbnails.ppm";
+
+	// heap allocations of the frames counted since the last
+	// ResetFrameAllocations(), for the allocation columns
+	uint64_t g_measuredAllocations = 0;
+	uint64_t g_measuredAllocatedBytes = 0;
+	int g_measuredAllocationFrames = 0;
+
+	/***********************************************************
+	 *  CountFrameAllocations()
+	 *
+	 *  Close the memory tracker's frame and add its allocations
+	 *  to the measured totals.  The frame runs from the last
+	 *  call, so the swap of the previous frame is included.
+	 ***********************************************************/
+	void CountFrameAllocations()
+	{
+		MemoryTracker::BeginFrame();
+		MemoryTracker::FRAME_STATS frameStats = MemoryTracker::GetLastFrameStats();
+		g_measuredAllocations += frameStats.allocations;
+		g_measuredAllocatedBytes += frameStats.bytesAllocated;
+		g_measuredAllocationFrames++;
+	}
+
+	/***********************************************************
+	 *  ResetFrameAllocations()
+	 *
+	 *  Start the allocation totals of a row, after its warm up
+	 *  frames.
+	 ***********************************************************/
+	void ResetFrameAllocations()
+	{
+		g_measuredAllocations = 0;
+		g_measuredAllocatedBytes = 0;
+		g_measuredAllocationFrames = 0;
+	}
+
+	/***********************************************************
+	 *  PrintFrameAllocations()
+	 *
+	 *  Print the allocations and the allocated kilobytes per
+	 *  frame of the row, or dashes when the memory tracker is
+	 *  not compiled in.
+	 ***********************************************************/
+	void PrintFrameAllocations()
+	{
+		if ((MemoryTracker::IsEnabled() == false) || (g_measuredAllocationFrames == 0))
+		{
+			std::cout << std::setw(10) << "-" << std::setw(12) << "-";
+			return;
+		}
+		std::cout << std::fixed << std::setprecision(1)
+			<< std::setw(10) << (double)g_measuredAllocations / g_measuredAllocationFrames
+			<< std::setw(12) << (double)g_measuredAllocatedBytes / 1024.0 / g_measuredAllocationFrames;
+	}
+
+	/***********************************************************
+	 *  RenderFrame()
+	 *
+	 *  Render one frame the same way as the interactive loop
+	 *  and wait for the GPU, so that the returned time covers
+	 *  both the CPU and the GPU work of the frame.
+	 ***********************************************************/
+	double RenderFrame(
+		GLFWwindow* pWindow,
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager)
+	{
+		double startTime = TraceProfiler::NowMilliseconds();
+
+		GLStateCache::Enable(GL_DEPTH_TEST);
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		pViewManager->PrepareSceneView();
+		pSceneManager->SetViewTransform(pViewManager->GetViewMatrix(), pViewManager->GetProjectionMatrix());
+		pSceneManager->RenderScene();
+
+		glFinish();
+		double frameTime = TraceProfiler::NowMilliseconds() - startTime;
+		CountFrameAllocations();
+
+		glfwSwapBuffers(pWindow);
+		glfwPollEvents();
+
+		return(frameTime);
+	}
+
+	/***********************************************************
+	 *  RenderMultiViewPass()
+	 *
+	 *  Render the views into the thumbnail atlas and wait for
+	 *  the GPU, returning the time of the whole pass, or -1
+	 *  when the pass could not be drawn.
+	 ***********************************************************/
+	double RenderMultiViewPass(
+		SceneManager* pSceneManager,
+		const std::vector<SceneManager::SCENE_VIEW>& views,
+		bool bSinglePass)
+	{
+		double startTime = TraceProfiler::NowMilliseconds();
+
+		GLStateCache::Enable(GL_DEPTH_TEST);
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		bool bRendered = pSceneManager->RenderMultiView(views.data(), (int)views.size(), bSinglePass);
+
+		glFinish();
+		double passTime = TraceProfiler::NowMilliseconds() - startTime;
+		CountFrameAllocations();
+
+		glfwPollEvents();
+
+		return(bRendered ? passTime : -1.0);
+	}
+
+	void AddVertex(std::vector<float>& vertices, const glm::vec3& position, const glm::vec3& normal, float u, float v)
+	{
+		vertices.push_back(position.x);
+		vertices.push_back(position.y);
+		vertices.push_back(position.z);
+		vertices.push_back(normal.x);
+		vertices.push_back(normal.y);
+		vertices.push_back(normal.z);
+		vertices.push_back(u);
+		vertices.push_back(v);
+	}
+
+	/***********************************************************
+	 *  AddGridIndices()
+	 *
+	 *  Two triangles for every cell of a grid of rows x columns
+	 *  cells, row by row - the ring order of the basic meshes.
+	 ***********************************************************/
+	void AddGridIndices(std::vector<unsigned int>& indices, int rows, int columns)
+	{
+		const int rowLength = columns + 1;
+		for (int row = 0; row < rows; row++)
+		{
+			for (int column = 0; column < columns; column++)
+			{
+				unsigned int topLeft = row * rowLength + column;
+				unsigned int bottomLeft = topLeft + rowLength;
+				indices.push_back(topLeft);
+				indices.push_back(topLeft + 1);
+				indices.push_back(bottomLeft);
+				indices.push_back(bottomLeft);
+				indices.push_back(topLeft + 1);
+				indices.push_back(bottomLeft + 1);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  BuildSphere()
+	 ***********************************************************/
+	void BuildSphere(int stacks, int slices, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+	{
+		for (int stack = 0; stack <= stacks; stack++)
+		{
+			float v = (float)stack / stacks;
+			for (int slice = 0; slice <= slices; slice++)
+			{
+				float u = (float)slice / slices;
+				glm::vec3 normal = glm::vec3(
+					std::sin(v * PI) * std::cos(u * 2.0f * PI),
+					std::cos(v * PI),
+					std::sin(v * PI) * std::sin(u * 2.0f * PI));
+				AddVertex(vertices, normal, normal, u, 1.0f - v);
+			}
+		}
+		AddGridIndices(indices, stacks, slices);
+	}
+
+	/***********************************************************
+	 *  BuildTorus()
+	 ***********************************************************/
+	void BuildTorus(int rings, int sides, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+	{
+		const float tubeRadius = 0.1f;
+		for (int ring = 0; ring <= rings; ring++)
+		{
+			float u = (float)ring / rings;
+			glm::vec3 center = glm::vec3(std::cos(u * 2.0f * PI), 0.0f, std::sin(u * 2.0f * PI));
+			for (int side = 0; side <= sides; side++)
+			{
+				float v = (float)side / sides;
+				glm::vec3 normal = center * std::cos(v * 2.0f * PI) + glm::vec3(0.0f, std::sin(v * 2.0f * PI), 0.0f);
+				AddVertex(vertices, center + normal * tubeRadius, normal, u, v);
+			}
+		}
+		AddGridIndices(indices, rings, sides);
+	}
+
+	/***********************************************************
+	 *  BuildCylinder()
+	 *
+	 *  The sides only, split into stacks along the height.
+	 ***********************************************************/
+	void BuildCylinder(int slices, int stacks, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+	{
+		for (int stack = 0; stack <= stacks; stack++)
+		{
+			float v = (float)stack / stacks;
+			for (int slice = 0; slice <= slices; slice++)
+			{
+				float u = (float)slice / slices;
+				glm::vec3 normal = glm::vec3(std::cos(u * 2.0f * PI), 0.0f, std::sin(u * 2.0f * PI));
+				AddVertex(vertices, glm::vec3(normal.x, v, normal.z), normal, u, v);
+			}
+		}
+		AddGridIndices(indices, stacks, slices);
+	}
+
+	/***********************************************************
+	 *  TimeVertexWork()
+	 *
+	 *  Upload the mesh and draw it MESH_DRAW_REPEATS times with
+	 *  the rasterizer discarding every primitive, returning the
+	 *  GPU time of the draws in milliseconds.
+	 ***********************************************************/
+	double TimeVertexWork(const std::vector<float>& vertices, const std::vector<unsigned int>& indices)
+	{
+		GLuint vertexArrayID = 0;
+		GLuint buffers[2] = { 0, 0 };
+		glGenVertexArrays(1, &vertexArrayID);
+		glGenBuffers(2, buffers);
+
+		glBindVertexArray(vertexArrayID);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+		const GLsizei vertexStride = MESH_FLOATS_PER_VERTEX * sizeof(float);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, vertexStride, (void*)(6 * sizeof(float)));
+
+		GLsizei indexCount = (GLsizei)indices.size();
+		glEnable(GL_RASTERIZER_DISCARD);
+
+		// the first draws pay for the upload
+		for (int i = 0; i < WARMUP_FRAMES; i++)
+		{
+			glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (void*)0);
+		}
+
+		GLuint queryID = 0;
+		glGenQueries(1, &queryID);
+		glBeginQuery(GL_TIME_ELAPSED, queryID);
+		for (int i = 0; i < MESH_DRAW_REPEATS; i++)
+		{
+			glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (void*)0);
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+
+		GLuint64 elapsedNanoseconds = 0;
+		glGetQueryObjectui64v(queryID, GL_QUERY_RESULT, &elapsedNanoseconds);
+		glDeleteQueries(1, &queryID);
+
+		glDisable(GL_RASTERIZER_DISCARD);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glDeleteBuffers(2, buffers);
+		glDeleteVertexArrays(1, &vertexArrayID);
+
+		return(elapsedNanoseconds / 1000000.0);
+	}
+}
+
+/***********************************************************
+ *  RunLightScaling()
+ *
+ *  This function is used to measure how the frame time grows
+ *  with the number of point lights.  Every light count is
+ *  rendered once with the brute force loop over all lights,
+ *  once with the clustered light lists and once with the
+ *  per-object light lists.
+ ***********************************************************/
+void Benchmarks::RunLightScaling(
+	GLFWwindow* pWindow,
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager)
+{
+	const int lightCounts[] = { 0, 16, 64, 256, 512, 1024 };
+	const int modes[] = { ClusteredLighting::LIGHTS_ALL, ClusteredLighting::LIGHTS_CLUSTERED, ClusteredLighting::LIGHTS_OBJECT };
+	const char* modeNames[] = { "fixed", "clustered", "all", "object" };
+
+	// the measurement must not be capped by the display refresh
+	glfwSwapInterval(0);
+
+	std::cout << "INFO: Point light scaling benchmark, " << MEASURED_FRAMES << " frames per row\n";
+	std::cout << std::setw(8) << "lights" << std::setw(12) << "mode"
+		<< std::setw(12) << "frame ms" << std::setw(12) << "bin ms"
+		<< std::setw(12) << "visible" << std::setw(14) << "avg/list"
+		<< std::setw(14) << "max/list" << std::setw(10) << "allocs" << std::setw(12) << "alloc KB" << "\n";
+
+	for (int lightCount : lightCounts)
+	{
+		pSceneManager->RemoveStressLights();
+		pSceneManager->AddStressLights(lightCount, STRESS_LIGHT_SEED);
+
+		for (int mode : modes)
+		{
+			pSceneManager->SetPointLightMode(mode);
+
+			for (int i = 0; i < WARMUP_FRAMES; i++)
+			{
+				RenderFrame(pWindow, pViewManager, pSceneManager);
+			}
+
+			double totalFrameTime = 0.0;
+			double totalBinTime = 0.0;
+			ClusteredLighting::CLUSTER_STATS stats;
+			ClusteredLighting::OBJECT_STATS objectStats;
+			ResetFrameAllocations();
+			for (int i = 0; i < MEASURED_FRAMES; i++)
+			{
+				totalFrameTime += RenderFrame(pWindow, pViewManager, pSceneManager);
+				stats = pSceneManager->GetClusterStats();
+				objectStats = pSceneManager->GetObjectLightStats();
+				totalBinTime += (mode == ClusteredLighting::LIGHTS_OBJECT)
+					? objectStats.buildMilliseconds : stats.buildMilliseconds;
+			}
+
+			// the lists are per cluster or per draw; the per-object
+			// lists do not cull the lights against the view
+			int lightTotal = stats.lightCount;
+			int visibleLights = stats.visibleLightCount;
+			double averagePerList = (double)stats.assignedIndexCount / ClusteredLighting::CLUSTER_COUNT;
+			int maxPerList = stats.maxLightsPerCluster;
+			if (mode == ClusteredLighting::LIGHTS_OBJECT)
+			{
+				lightTotal = objectStats.lightCount;
+				visibleLights = objectStats.lightCount;
+				averagePerList = (double)objectStats.assignedLightCount / std::max(objectStats.objectCount, 1);
+				maxPerList = objectStats.maxLightsPerObject;
+			}
+
+			std::cout << std::fixed << std::setprecision(3)
+				<< std::setw(8) << lightTotal
+				<< std::setw(12) << modeNames[mode]
+				<< std::setw(12) << (totalFrameTime / MEASURED_FRAMES)
+				<< std::setw(12) << (totalBinTime / MEASURED_FRAMES)
+				<< std::setw(12) << visibleLights
+				<< std::setw(14) << averagePerList
+				<< std::setw(14) << maxPerList;
+			PrintFrameAllocations();
+			std::cout << "\n";
+		}
+	}
+	std::cout << std::endl;
+
+	pSceneManager->RemoveStressLights();
+	pSceneManager->SetPointLightMode(ClusteredLighting::LIGHTS_CLUSTERED);
+	glfwSwapInterval(1);
+}
+
+/***********************************************************
+ *  RunDrawOrder()
+ *
+ *  This function is used to measure how much fragment work
+ *  the draw order saves.  The shaded samples count every
+ *  fragment that passed the depth test in the lighting
+ *  passes, so overdraw shows up directly in that number.
+ ***********************************************************/
+void Benchmarks::RunDrawOrder(
+	GLFWwindow* pWindow,
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager)
+{
+	struct DRAW_ORDER_CASE
+	{
+		const char* name;
+		int renderPath;
+		bool bDepthPrepass;
+	};
+	const DRAW_ORDER_CASE cases[] = {
+		{ "source order", RenderQueue::PATH_SOURCE_ORDER, false },
+		{ "sorted", RenderQueue::PATH_SORTED, false },
+		{ "sorted + pre-pass", RenderQueue::PATH_SORTED, true }
+	};
+
+	glfwSwapInterval(0);
+
+	std::cout << "INFO: Draw order benchmark, " << MEASURED_FRAMES << " frames per row\n";
+	std::cout << std::setw(20) << "path" << std::setw(12) << "frame ms"
+		<< std::setw(12) << "GPU ms" << std::setw(16) << "shaded samples"
+		<< std::setw(10) << "allocs" << std::setw(12) << "alloc KB" << "\n";
+
+	RenderQueue& renderQueue = pSceneManager->GetRenderQueue();
+	for (const DRAW_ORDER_CASE& drawCase : cases)
+	{
+		pSceneManager->SetRenderPath(drawCase.renderPath);
+		pSceneManager->SetDepthPrepass(drawCase.bDepthPrepass);
+
+		for (int i = 0; i < WARMUP_FRAMES; i++)
+		{
+			RenderFrame(pWindow, pViewManager, pSceneManager);
+		}
+
+		renderQueue.ResetStats();
+		ResetFrameAllocations();
+		double totalFrameTime = 0.0;
+		for (int i = 0; i < MEASURED_FRAMES; i++)
+		{
+			totalFrameTime += RenderFrame(pWindow, pViewManager, pSceneManager);
+		}
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(20) << drawCase.name
+			<< std::setw(12) << (totalFrameTime / MEASURED_FRAMES)
+			<< std::setw(12) << renderQueue.GetAverageShadingGpuMs()
+			<< std::setw(16) << std::setprecision(0) << renderQueue.GetAverageShadedSamples();
+		PrintFrameAllocations();
+		std::cout << "\n";
+	}
+	std::cout << std::endl;
+
+	pSceneManager->SetRenderPath(RenderQueue::PATH_SORTED);
+	pSceneManager->SetDepthPrepass(false);
+	glfwSwapInterval(1);
+}
+
+/***********************************************************
+ *  RunShaderPermutations()
+ *
+ *  This function is used to measure what the runtime
+ *  branches of the uber shader cost against the variants
+ *  that have them compiled out.  The depth pre-pass is on,
+ *  so that every visible pixel is shaded exactly once and
+ *  the shading pass time is the fragment cost.
+ ***********************************************************/
+void Benchmarks::RunShaderPermutations(
+	GLFWwindow* pWindow,
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager)
+{
+	const int lightModes[] = { ClusteredLighting::LIGHTS_FIXED, ClusteredLighting::LIGHTS_CLUSTERED };
+	const bool permutationModes[] = { false, true };
+
+	glfwSwapInterval(0);
+	pSceneManager->SetDepthPrepass(true);
+
+	std::cout << "INFO: Shader permutation benchmark, " << MEASURED_FRAMES << " frames per row\n";
+	std::cout << std::setw(12) << "lights" << std::setw(14) << "shader"
+		<< std::setw(12) << "frame ms" << std::setw(12) << "shading ms"
+		<< std::setw(16) << "shaded samples" << std::setw(10) << "allocs" << std::setw(12) << "alloc KB" << "\n";
+
+	RenderQueue& renderQueue = pSceneManager->GetRenderQueue();
+	for (int lightMode : lightModes)
+	{
+		pSceneManager->SetPointLightMode(lightMode);
+
+		for (bool bPermutations : permutationModes)
+		{
+			pSceneManager->SetShaderPermutations(bPermutations);
+
+			// the warm up frames also compile the variants
+			for (int i = 0; i < WARMUP_FRAMES; i++)
+			{
+				RenderFrame(pWindow, pViewManager, pSceneManager);
+			}
+
+			renderQueue.ResetStats();
+			ResetFrameAllocations();
+			double totalFrameTime = 0.0;
+			for (int i = 0; i < MEASURED_FRAMES; i++)
+			{
+				totalFrameTime += RenderFrame(pWindow, pViewManager, pSceneManager);
+			}
+
+			std::cout << std::fixed << std::setprecision(3)
+				<< std::setw(12) << ((lightMode == ClusteredLighting::LIGHTS_FIXED) ? "fixed" : "clustered")
+				<< std::setw(14) << (bPermutations ? "specialized" : "uber")
+				<< std::setw(12) << (totalFrameTime / MEASURED_FRAMES)
+				<< std::setw(12) << renderQueue.GetAverageShadingGpuMs()
+				<< std::setw(16) << std::setprecision(0) << renderQueue.GetAverageShadedSamples();
+			PrintFrameAllocations();
+			std::cout << "\n";
+		}
+	}
+	std::cout << std::endl;
+
+	pSceneManager->SetPointLightMode(ClusteredLighting::LIGHTS_CLUSTERED);
+	pSceneManager->SetShaderPermutations(true);
+	pSceneManager->SetDepthPrepass(false);
+	glfwSwapInterval(1);
+}
+
+/***********************************************************
+ *  RunMipGeneration()
+ *
+ *  This function is used to compare the texture load time
+ *  of uploading level 0 and calling glGenerateMipmap with
+ *  building the chain on the CPU and uploading it level by
+ *  level.  Every scene texture is decoded, mipmapped and
+ *  uploaded into a scratch texture, and the GPU is waited
+ *  for, so the upload column covers the driver's work too.
+ ***********************************************************/
+void Benchmarks::RunMipGeneration(SceneManager* pSceneManager)
+{
+	const int filters[] = {
+		MipGenerator::MIP_FILTER_GPU,
+		MipGenerator::MIP_FILTER_BOX,
+		MipGenerator::MIP_FILTER_KAISER
+	};
+
+	std::vector<std::string> filenames = pSceneManager->GetTextureFiles();
+
+	std::cout << "INFO: Mip generation benchmark, " << filenames.size() << " textures, "
+		<< MipGenerator::GetWorkerCount() << " worker threads\n";
+	std::cout << std::setw(20) << "filter" << std::setw(12) << "decode ms"
+		<< std::setw(12) << "mips ms" << std::setw(12) << "upload ms"
+		<< std::setw(12) << "total ms" << "\n";
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (int filter : filters)
+	{
+		double decodeTime = 0.0;
+		double mipTime = 0.0;
+		double uploadTime = 0.0;
+
+		for (const std::string& filename : filenames)
+		{
+			double startTime = TraceProfiler::NowMilliseconds();
+			int width = 0;
+			int height = 0;
+			int colorChannels = 0;
+			unsigned char* image = stbi_load(filename.c_str(), &width, &height, &colorChannels, 0);
+			if (!image)
+			{
+				continue;
+			}
+			GLenum format = (colorChannels == 4) ? GL_RGBA : ((colorChannels == 3) ? GL_RGB : GL_RED);
+			double decodedTime = TraceProfiler::NowMilliseconds();
+
+			std::vector<MipGenerator::MIP_LEVEL> levels;
+			MipGenerator::GenerateMipChain(image, width, height, colorChannels, filter, levels);
+			stbi_image_free(image);
+			double generatedTime = TraceProfiler::NowMilliseconds();
+
+			GLuint textureID = 0;
+			glGenTextures(1, &textureID);
+			GLStateCache::BindTexture2D(TextureStreamer::UPLOAD_TEXTURE_UNIT, textureID);
+			for (size_t level = 0; level < levels.size(); level++)
+			{
+				glTexImage2D(GL_TEXTURE_2D, (GLint)level, format, levels[level].width, levels[level].height, 0,
+					format, GL_UNSIGNED_BYTE, levels[level].pixels.data());
+			}
+			if (filter == MipGenerator::MIP_FILTER_GPU)
+			{
+				glGenerateMipmap(GL_TEXTURE_2D);
+			}
+			glFinish();
+			double uploadedTime = TraceProfiler::NowMilliseconds();
+
+			GLStateCache::BindTexture2D(TextureStreamer::UPLOAD_TEXTURE_UNIT, 0);
+			glDeleteTextures(1, &textureID);
+
+			decodeTime += decodedTime - startTime;
+			mipTime += generatedTime - decodedTime;
+			uploadTime += uploadedTime - generatedTime;
+		}
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(20) << MipGenerator::GetFilterName(filter)
+			<< std::setw(12) << decodeTime
+			<< std::setw(12) << mipTime
+			<< std::setw(12) << uploadTime
+			<< std::setw(12) << (decodeTime + mipTime + uploadTime) << "\n";
+	}
+	std::cout << std::endl;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	GLStateCache::ActiveTexture(0);
+}
+
+/***********************************************************
+ *  RunSceneScaling()
+ *
+ *  This function is used to measure how the frame grows with
+ *  the number of objects.  The desk is repeated over square
+ *  grids up to 40 x 40 desks, about 240,000 draws, and every
+ *  grid is rendered with the frustum test of the grid cells
+ *  and without it.  The CPU columns split RenderScene into
+ *  its phases; the GPU column is the timestamped scene, and
+ *  the frame column includes waiting for the GPU to finish.
+ ***********************************************************/
+void Benchmarks::RunSceneScaling(
+	GLFWwindow* pWindow,
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager)
+{
+	const int gridSizes[] = { 1, 2, 4, 8, 16, 24, 32, 40 };
+	const bool cullModes[] = { true, false };
+
+	// looking down over the rows of desks behind the original one
+	pViewManager->SetCameraPose(glm::vec3(0.0f, 30.0f, 40.0f), glm::vec3(0.0f, -0.6f, -1.0f), 80.0f, false);
+
+	glfwSwapInterval(0);
+
+	std::cout << "INFO: Scene scaling benchmark, " << SCALING_MEASURED_FRAMES << " frames per row, CPU and GPU times in ms\n";
+	std::cout << std::setw(8) << "grid" << std::setw(8) << "culled"
+		<< std::setw(10) << "draws" << std::setw(8) << "cells"
+		<< std::setw(10) << "record" << std::setw(10) << "cull"
+		<< std::setw(10) << "shadow" << std::setw(10) << "sort"
+		<< std::setw(10) << "submit" << std::setw(10) << "queries"
+		<< std::setw(10) << "CPU" << std::setw(10) << "GPU"
+		<< std::setw(10) << "frame" << std::setw(10) << "allocs" << std::setw(12) << "alloc KB" << "\n";
+
+	for (int gridSize : gridSizes)
+	{
+		pSceneManager->SetSceneGrid(gridSize, gridSize, SCENE_GRID_SEED);
+
+		for (bool bCulled : cullModes)
+		{
+			pSceneManager->SetGridFrustumCulling(bCulled);
+
+			for (int i = 0; i < WARMUP_FRAMES; i++)
+			{
+				RenderFrame(pWindow, pViewManager, pSceneManager);
+			}
+
+			pSceneManager->ResetFrameTiming();
+			ResetFrameAllocations();
+			double totalFrameTime = 0.0;
+			for (int i = 0; i < SCALING_MEASURED_FRAMES; i++)
+			{
+				totalFrameTime += RenderFrame(pWindow, pViewManager, pSceneManager);
+			}
+
+			// every frame was finished, so the timestamps are back
+			SceneManager::FRAME_TIMING timing = pSceneManager->GetAverageFrameTiming();
+			const SceneGenerator::GENERATOR_STATS& gridStats = pSceneManager->GetGridStats();
+
+			std::cout << std::fixed << std::setprecision(3)
+				<< std::setw(8) << (std::to_string(gridSize) + "x" + std::to_string(gridSize))
+				<< std::setw(8) << (bCulled ? "yes" : "no")
+				<< std::setw(10) << std::setprecision(0) << timing.itemCount
+				<< std::setw(8) << gridStats.visibleCells
+				<< std::setprecision(3)
+				<< std::setw(10) << timing.recordMilliseconds
+				<< std::setw(10) << timing.cullMilliseconds
+				<< std::setw(10) << timing.shadowMilliseconds
+				<< std::setw(10) << timing.sortMilliseconds
+				<< std::setw(10) << timing.submitMilliseconds
+				<< std::setw(10) << timing.queryMilliseconds
+				<< std::setw(10) << timing.totalMilliseconds
+				<< std::setw(10) << timing.gpuMilliseconds
+				<< std::setw(10) << (totalFrameTime / SCALING_MEASURED_FRAMES);
+			PrintFrameAllocations();
+			std::cout << "\n";
+		}
+	}
+	std::cout << std::endl;
+
+	pSceneManager->SetSceneGrid(1, 1, SCENE_GRID_SEED);
+	pSceneManager->SetGridFrustumCulling(true);
+	glfwSwapInterval(1);
+}
+
+/***********************************************************
+ *  RunMeshOptimization()
+ *
+ *  This function is used to measure what the mesh optimizer
+ *  saves on finely tessellated meshes.  Each mesh is built
+ *  in the row by row order of the basic meshes, then run
+ *  through the cache, overdraw and fetch passes.  The cache
+ *  columns come from the FIFO simulation; the GPU column is
+ *  the time of drawing the mesh MESH_DRAW_REPEATS times
+ *  with the scene vertex shader and the rasterizer off, so
+ *  it only contains the vertex work.
+ ***********************************************************/
+void Benchmarks::RunMeshOptimization()
+{
+	struct BENCH_MESH
+	{
+		const char* name;
+		int shape;
+		int rows;
+		int columns;
+	};
+	const BENCH_MESH meshes[] = {
+		{ "sphere 64x128", 0, 64, 128 },
+		{ "sphere 256x512", 0, 256, 512 },
+		{ "torus 256x64", 1, 256, 64 },
+		{ "torus 1024x128", 1, 1024, 128 },
+		{ "cylinder 512x64", 2, 512, 64 }
+	};
+
+	ShaderManager* pShaderManager = new ShaderManager();
+	pShaderManager->LoadShaders(g_MeshVertexShaderPath, g_MeshFragmentShaderPath);
+	pShaderManager->use();
+	pShaderManager->setMat4Value("model", glm::mat4(1.0f));
+	pShaderManager->setMat4Value("view", glm::mat4(1.0f));
+	pShaderManager->setMat4Value("projection", glm::mat4(1.0f));
+	pShaderManager->setBoolValue("bInstanced", false);
+	pShaderManager->setBoolValue("bUseDrawData", false);
+
+	std::cout << "INFO: Mesh optimization benchmark, FIFO cache of " << MeshOptimizer::DEFAULT_CACHE_SIZE
+		<< " vertices, " << MESH_DRAW_REPEATS << " draws per GPU time\n";
+	std::cout << std::setw(18) << "mesh" << std::setw(12) << "order"
+		<< std::setw(10) << "tris" << std::setw(10) << "verts"
+		<< std::setw(8) << "ACMR" << std::setw(8) << "ATVR"
+		<< std::setw(12) << "shaded" << std::setw(10) << "opt ms"
+		<< std::setw(10) << "GPU ms" << "\n";
+
+	for (const BENCH_MESH& mesh : meshes)
+	{
+		std::vector<float> vertices;
+		std::vector<unsigned int> indices;
+		if (mesh.shape == 0)
+		{
+			BuildSphere(mesh.rows, mesh.columns, vertices, indices);
+		}
+		else if (mesh.shape == 1)
+		{
+			BuildTorus(mesh.rows, mesh.columns, vertices, indices);
+		}
+		else
+		{
+			BuildCylinder(mesh.columns, mesh.rows, vertices, indices);
+		}
+
+		for (int pass = 0; pass < 2; pass++)
+		{
+			double optimizeTime = 0.0;
+			if (pass == 1)
+			{
+				double startTime = TraceProfiler::NowMilliseconds();
+				int vertexCount = (int)(vertices.size() / MESH_FLOATS_PER_VERTEX);
+				std::vector<int> clusters;
+				MeshOptimizer::OptimizeVertexCache(indices, vertexCount, MeshOptimizer::DEFAULT_CACHE_SIZE, &clusters);
+				MeshOptimizer::OptimizeOverdraw(indices, vertices, MESH_FLOATS_PER_VERTEX, clusters,
+					MeshOptimizer::DEFAULT_CACHE_SIZE, MeshOptimizer::DEFAULT_OVERDRAW_THRESHOLD);
+				MeshOptimizer::OptimizeVertexFetch(indices, vertices, MESH_FLOATS_PER_VERTEX);
+				optimizeTime = TraceProfiler::NowMilliseconds() - startTime;
+			}
+
+			int vertexCount = (int)(vertices.size() / MESH_FLOATS_PER_VERTEX);
+			MeshOptimizer::CACHE_STATS stats =
+				MeshOptimizer::AnalyzeVertexCache(indices, vertexCount, MeshOptimizer::DEFAULT_CACHE_SIZE);
+			double gpuTime = TimeVertexWork(vertices, indices);
+
+			std::cout << std::fixed << std::setprecision(3)
+				<< std::setw(18) << mesh.name
+				<< std::setw(12) << ((pass == 0) ? "ring" : "optimized")
+				<< std::setw(10) << stats.triangleCount
+				<< std::setw(10) << vertexCount
+				<< std::setw(8) << stats.acmr
+				<< std::setw(8) << stats.atvr
+				<< std::setw(12) << stats.shadedVertices
+				<< std::setw(10) << optimizeTime
+				<< std::setw(10) << gpuTime << "\n";
+		}
+	}
+	std::cout << std::endl;
+
+	GLStateCache::InvalidateUniforms(pShaderManager);
+	delete pShaderManager;
+	// the program was bound behind the state cache's back
+	GLStateCache::InvalidateAll();
+}
+
+/***********************************************************
+ *  RunLightmaps()
+ *
+ *  This function is used to compare the shading pass of the
+ *  desk scene lit by the shader's light loops with the same
+ *  scene drawn with its baked lightmaps.  The bake itself is
+ *  timed too - a second run loads it from the cache file.
+ ***********************************************************/
+void Benchmarks::RunLightmaps(
+	GLFWwindow* pWindow,
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager)
+{
+	const bool lightmapModes[] = { false, true };
+
+	glfwSwapInterval(0);
+
+	double startTime = TraceProfiler::NowMilliseconds();
+	pSceneManager->BakeLightmaps();
+	double bakeTime = TraceProfiler::NowMilliseconds() - startTime;
+
+	pSceneManager->SetDepthPrepass(true);
+
+	std::cout << "INFO: Lightmap benchmark, bake " << std::fixed << std::setprecision(1)
+		<< bakeTime << " ms, " << MEASURED_FRAMES << " frames per row\n";
+	std::cout << std::setw(12) << "lighting" << std::setw(12) << "frame ms"
+		<< std::setw(12) << "shading ms" << std::setw(16) << "shaded samples"
+		<< std::setw(10) << "allocs" << std::setw(12) << "alloc KB" << "\n";
+
+	RenderQueue& renderQueue = pSceneManager->GetRenderQueue();
+	for (bool bLightmaps : lightmapModes)
+	{
+		pSceneManager->SetLightmaps(bLightmaps);
+
+		for (int i = 0; i < WARMUP_FRAMES; i++)
+		{
+			RenderFrame(pWindow, pViewManager, pSceneManager);
+		}
+
+		renderQueue.ResetStats();
+		ResetFrameAllocations();
+		double totalFrameTime = 0.0;
+		for (int i = 0; i < MEASURED_FRAMES; i++)
+		{
+			totalFrameTime += RenderFrame(pWindow, pViewManager, pSceneManager);
+		}
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(12) << (bLightmaps ? "baked" : "runtime")
+			<< std::setw(12) << (totalFrameTime / MEASURED_FRAMES)
+			<< std::setw(12) << renderQueue.GetAverageShadingGpuMs()
+			<< std::setw(16) << std::setprecision(0) << renderQueue.GetAverageShadedSamples();
+		PrintFrameAllocations();
+		std::cout << "\n";
+	}
+	std::cout << std::endl;
+
+	pSceneManager->SetLightmaps(true);
+	pSceneManager->SetDepthPrepass(false);
+	glfwSwapInterval(1);
+}
+
+/***********************************************************
+ *  RunSoftwareRaster()
+ *
+ *  This function is used to compare the frame time of the GL
+ *  passes on the current driver with the CPU rasterizer on
+ *  one thread, half the cores and every core.  On a host
+ *  without a GPU the GL row is Mesa's software path, which
+ *  the renderer name in the header shows.  The last software
+ *  frame is written to software_frame.ppm for comparison
+ *  with a GL capture.
+ ***********************************************************/
+void Benchmarks::RunSoftwareRaster(
+	GLFWwindow* pWindow,
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager)
+{
+	int coreCount = (int)std::max(1u, std::thread::hardware_concurrency());
+	std::vector<int> threadCounts;
+	threadCounts.push_back(1);
+	if (coreCount >= 4)
+	{
+		threadCounts.push_back(coreCount / 2);
+	}
+	if (coreCount > 1)
+	{
+		threadCounts.push_back(coreCount);
+	}
+
+	glfwSwapInterval(0);
+
+	std::cout << "INFO: Software rasterizer benchmark on " << glGetString(GL_RENDERER)
+		<< ", " << MEASURED_FRAMES << " frames per row\n";
+	std::cout << std::setw(10) << "backend" << std::setw(10) << "threads"
+		<< std::setw(12) << "frame ms" << std::setw(12) << "setup ms"
+		<< std::setw(12) << "raster ms" << std::setw(12) << "blit ms"
+		<< std::setw(12) << "hiz reject" << std::setw(10) << "allocs" << std::setw(12) << "alloc KB" << "\n";
+
+	// the GL passes first, on whatever driver the context runs on
+	pSceneManager->SetSoftwareRasterizer(false, 0);
+	for (int i = 0; i < WARMUP_FRAMES; i++)
+	{
+		RenderFrame(pWindow, pViewManager, pSceneManager);
+	}
+	ResetFrameAllocations();
+	double totalFrameTime = 0.0;
+	for (int i = 0; i < MEASURED_FRAMES; i++)
+	{
+		totalFrameTime += RenderFrame(pWindow, pViewManager, pSceneManager);
+	}
+	std::cout << std::fixed << std::setprecision(3)
+		<< std::setw(10) << "gl" << std::setw(10) << "-"
+		<< std::setw(12) << (totalFrameTime / MEASURED_FRAMES)
+		<< std::setw(12) << "-" << std::setw(12) << "-"
+		<< std::setw(12) << "-" << std::setw(12) << "-";
+	PrintFrameAllocations();
+	std::cout << "\n";
+
+	for (int threadCount : threadCounts)
+	{
+		pSceneManager->SetSoftwareRasterizer(true, threadCount);
+		for (int i = 0; i < WARMUP_FRAMES; i++)
+		{
+			RenderFrame(pWindow, pViewManager, pSceneManager);
+		}
+
+		double frameTime = 0.0;
+		double setupTime = 0.0;
+		double rasterTime = 0.0;
+		double blitTime = 0.0;
+		long long testedBlocks = 0;
+		long long rejectedBlocks = 0;
+		ResetFrameAllocations();
+		for (int i = 0; i < MEASURED_FRAMES; i++)
+		{
+			frameTime += RenderFrame(pWindow, pViewManager, pSceneManager);
+			SoftwareRasterizer::RASTER_STATS stats = pSceneManager->GetSoftwareRasterStats();
+			setupTime += stats.setupMilliseconds + stats.binMilliseconds;
+			rasterTime += stats.rasterMilliseconds;
+			blitTime += stats.blitMilliseconds;
+			testedBlocks += stats.testedBlocks;
+			rejectedBlocks += stats.rejectedBlocks;
+		}
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(10) << "software" << std::setw(10) << threadCount
+			<< std::setw(12) << (frameTime / MEASURED_FRAMES)
+			<< std::setw(12) << (setupTime / MEASURED_FRAMES)
+			<< std::setw(12) << (rasterTime / MEASURED_FRAMES)
+			<< std::setw(12) << (blitTime / MEASURED_FRAMES)
+			<< std::setw(11) << std::setprecision(1)
+			<< ((testedBlocks > 0) ? 100.0 * rejectedBlocks / testedBlocks : 0.0) << "%";
+		PrintFrameAllocations();
+		std::cout << "\n";
+	}
+	std::cout << std::endl;
+
+	pSceneManager->SaveSoftwareFrame("software_frame.ppm");
+	pSceneManager->SetSoftwareRasterizer(false, 0);
+	glfwSwapInterval(1);
+}
+
+/***********************************************************
+ *  RunPicking()
+ *
+ *  This function is used to measure the pick tree over the
+ *  draws of desk grids up to 40 x 40 desks.  The frustum test
+ *  of the grid cells is off, so the tree holds every draw of
+ *  the grid.  The same random rays through the view are
+ *  traced through the tree and, for the first few of them,
+ *  against every draw, and the answers of the two are
+ *  compared.  The refit columns move one draw in
+ *  PICK_MOVE_INTERVAL and then every draw, the way animated
+ *  props would move between two picks, and time the update
+ *  of the tree including finding the moved draws.
+ ***********************************************************/
+void Benchmarks::RunPicking(
+	GLFWwindow* pWindow,
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager)
+{
+	const int gridSizes[] = { 1, 8, 16, 24, 32, 40 };
+
+	// looking down over the rows of desks behind the original one
+	pViewManager->SetCameraPose(glm::vec3(0.0f, 30.0f, 40.0f), glm::vec3(0.0f, -0.6f, -1.0f), 80.0f, false);
+	pSceneManager->SetGridFrustumCulling(false);
+
+	std::cout << "INFO: Picking benchmark, " << PICK_RAYS << " rays per grid through the tree, "
+		<< PICK_BRUTE_FORCE_RAYS << " against every draw\n";
+	std::cout << std::setw(8) << "grid" << std::setw(10) << "draws"
+		<< std::setw(10) << "nodes" << std::setw(7) << "depth"
+		<< std::setw(8) << "SAH" << std::setw(10) << "build ms"
+		<< std::setw(10) << "tree us" << std::setw(12) << "brute us"
+		<< std::setw(11) << "nodes/ray" << std::setw(8) << "hits"
+		<< std::setw(8) << "errors" << std::setw(12) << "refit 1% ms"
+		<< std::setw(12) << "refit all ms" << "\n";
+
+	std::mt19937 generator(PICK_RAY_SEED);
+	std::uniform_real_distribution<float> ndc(-1.0f, 1.0f);
+	std::vector<glm::vec3> origins(PICK_RAYS);
+	std::vector<glm::vec3> directions(PICK_RAYS);
+	std::vector<int> treeHits(PICK_RAYS);
+	std::vector<ScenePicker::PICK_RESULT> bruteResults(PICK_BRUTE_FORCE_RAYS);
+	RenderQueue movedQueue;
+
+	for (int gridSize : gridSizes)
+	{
+		pSceneManager->SetSceneGrid(gridSize, gridSize, SCENE_GRID_SEED);
+		RenderFrame(pWindow, pViewManager, pSceneManager);
+		const RenderQueue& renderQueue = pSceneManager->GetRenderQueue();
+
+		ScenePicker picker;
+		picker.Update(renderQueue);
+		ScenePicker::PICKER_STATS buildStats = picker.GetStats();
+
+		for (int i = 0; i < PICK_RAYS; i++)
+		{
+			float ndcX = ndc(generator);
+			float ndcY = ndc(generator);
+			ScenePicker::GetViewRay(pViewManager->GetViewMatrix(), pViewManager->GetProjectionMatrix(),
+				ndcX, ndcY, origins[i], directions[i]);
+		}
+
+		long long testedNodes = 0;
+		int hitCount = 0;
+		double startTime = TraceProfiler::NowMilliseconds();
+		for (int i = 0; i < PICK_RAYS; i++)
+		{
+			ScenePicker::PICK_RESULT result;
+			picker.Pick(origins[i], directions[i], result);
+			treeHits[i] = result.itemIndex;
+			testedNodes += result.testedNodes;
+			hitCount += (result.itemIndex >= 0) ? 1 : 0;
+		}
+		double treeMicroseconds = (TraceProfiler::NowMilliseconds() - startTime) * 1000.0 / PICK_RAYS;
+
+		startTime = TraceProfiler::NowMilliseconds();
+		for (int i = 0; i < PICK_BRUTE_FORCE_RAYS; i++)
+		{
+			picker.PickBruteForce(origins[i], directions[i], bruteResults[i]);
+		}
+		double bruteMicroseconds = (TraceProfiler::NowMilliseconds() - startTime) * 1000.0 / PICK_BRUTE_FORCE_RAYS;
+
+		// a different draw at the same distance is a tie, not an error
+		int errorCount = 0;
+		for (int i = 0; i < PICK_BRUTE_FORCE_RAYS; i++)
+		{
+			if (bruteResults[i].itemIndex == treeHits[i])
+			{
+				continue;
+			}
+			ScenePicker::PICK_RESULT result;
+			picker.Pick(origins[i], directions[i], result);
+			if (std::fabs(result.distance - bruteResults[i].distance) > 1.0e-4f)
+			{
+				errorCount++;
+			}
+		}
+
+		// a step further every time, so that the second row moves
+		// every draw again
+		const int moveIntervals[2] = { PICK_MOVE_INTERVAL, 1 };
+		double refitMilliseconds[2];
+		for (int m = 0; m < 2; m++)
+		{
+			movedQueue.Clear();
+			for (int i = 0; i < renderQueue.GetItemCount(); i++)
+			{
+				RenderQueue::DRAW_ITEM item = renderQueue.GetItem(i);
+				if ((i % moveIntervals[m]) == 0)
+				{
+					item.model[3].x += PICK_MOVE_STEP * (m + 1);
+				}
+				movedQueue.Submit(item);
+			}
+
+			startTime = TraceProfiler::NowMilliseconds();
+			picker.Update(movedQueue);
+			refitMilliseconds[m] = TraceProfiler::NowMilliseconds() - startTime;
+		}
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(8) << (std::to_string(gridSize) + "x" + std::to_string(gridSize))
+			<< std::setw(10) << buildStats.itemCount
+			<< std::setw(10) << buildStats.nodeCount
+			<< std::setw(7) << buildStats.maxDepth
+			<< std::setw(8) << std::setprecision(1) << buildStats.sahCost
+			<< std::setw(10) << std::setprecision(3) << buildStats.buildMilliseconds
+			<< std::setw(10) << treeMicroseconds
+			<< std::setw(12) << std::setprecision(1) << bruteMicroseconds
+			<< std::setw(11) << ((double)testedNodes / PICK_RAYS)
+			<< std::setw(7) << (100.0 * hitCount / PICK_RAYS) << "%"
+			<< std::setw(8) << errorCount
+			<< std::setw(12) << std::setprecision(3) << refitMilliseconds[0]
+			<< std::setw(12) << refitMilliseconds[1] << "\n";
+
+		if (gridSize == gridSizes[sizeof(gridSizes) / sizeof(gridSizes[0]) - 1])
+		{
+			picker.PrintStats();
+		}
+	}
+	std::cout << std::endl;
+
+	pSceneManager->SetSceneGrid(1, 1, SCENE_GRID_SEED);
+	pSceneManager->SetGridFrustumCulling(true);
+}
+
+/***********************************************************
+ *  RunMultiView()
+ *
+ *  This function is used to measure how many catalog
+ *  thumbnails of the desk can be rendered per second.  For
+ *  a growing number of cameras the views are drawn into the
+ *  thumbnail atlas with a full pass per view and with the
+ *  single multi-view pass, which records, sorts and uploads
+ *  the scene once for all of them.  The CPU columns are the
+ *  scene recording and the rest of the CPU work, summed over
+ *  the views; the pass column includes waiting for the GPU.
+ *  The atlas of the last single pass is saved.
+ ***********************************************************/
+void Benchmarks::RunMultiView(
+	SceneManager* pSceneManager)
+{
+	const int viewCounts[] = { 1, 2, 4, 8, 16 };
+
+	if (pSceneManager->CreateMultiViewTarget(THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT) == false)
+	{
+		std::cerr << "ERROR: Multi-view benchmark needs the thumbnail atlas" << std::endl;
+		return;
+	}
+
+	glfwSwapInterval(0);
+
+	std::cout << "INFO: Multi-view benchmark, " << MULTI_VIEW_MEASURED_PASSES << " passes per row, "
+		<< THUMBNAIL_WIDTH << "x" << THUMBNAIL_HEIGHT << " thumbnails, times in ms\n";
+	std::cout << std::setw(8) << "views" << std::setw(14) << "mode"
+		<< std::setw(10) << "draws" << std::setw(10) << "record"
+		<< std::setw(10) << "submit" << std::setw(10) << "pass"
+		<< std::setw(10) << "allocs" << std::setw(12) << "alloc KB"
+		<< std::setw(12) << "views/s" << std::setw(10) << "speedup" << "\n";
+
+	bool bSinglePassSupported = true;
+	for (int viewCount : viewCounts)
+	{
+		std::vector<SceneManager::SCENE_VIEW> views(viewCount);
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), pSceneManager->GetMultiViewAspect(), 0.1f, 100.0f);
+		for (int i = 0; i < viewCount; i++)
+		{
+			// evenly over the arc, every other camera a little higher
+			float arc = (viewCount > 1) ? (float)i / (float)(viewCount - 1) - 0.5f : 0.0f;
+			float yaw = glm::radians(arc * THUMBNAIL_ARC_DEGREES);
+			glm::vec3 position = THUMBNAIL_TARGET + glm::vec3(
+				std::sin(yaw) * THUMBNAIL_DISTANCE, 3.0f + 3.0f * (float)(i % 2), std::cos(yaw) * THUMBNAIL_DISTANCE);
+			views[i].view = glm::lookAt(position, THUMBNAIL_TARGET, glm::vec3(0.0f, 1.0f, 0.0f));
+			views[i].projection = projection;
+		}
+
+		double viewsPerSecond[2] = { 0.0, 0.0 };
+		for (int pass = 0; pass < 2; pass++)
+		{
+			bool bSinglePass = (pass == 1);
+			if ((bSinglePass == true) && (bSinglePassSupported == false))
+			{
+				continue;
+			}
+
+			for (int i = 0; i < WARMUP_FRAMES; i++)
+			{
+				RenderMultiViewPass(pSceneManager, views, bSinglePass);
+			}
+
+			double totalPassTime = 0.0;
+			double totalRecordTime = 0.0;
+			double totalSubmitTime = 0.0;
+			int measuredPasses = 0;
+			ResetFrameAllocations();
+			for (int i = 0; i < MULTI_VIEW_MEASURED_PASSES; i++)
+			{
+				double passTime = RenderMultiViewPass(pSceneManager, views, bSinglePass);
+				if (passTime < 0.0)
+				{
+					break;
+				}
+				const SceneManager::MULTI_VIEW_STATS& stats = pSceneManager->GetMultiViewStats();
+				totalPassTime += passTime;
+				totalRecordTime += stats.recordMilliseconds;
+				totalSubmitTime += stats.submitMilliseconds;
+				measuredPasses++;
+			}
+
+			if (measuredPasses == 0)
+			{
+				if (bSinglePass == false)
+				{
+					std::cerr << "ERROR: Multi-view passes cannot be drawn with the software rasterizer" << std::endl;
+					glfwSwapInterval(1);
+					return;
+				}
+				std::cout << "WARNING: Multi-view shader variants are not available, only the pass per view is measured" << std::endl;
+				bSinglePassSupported = false;
+				continue;
+			}
+
+			double passTime = totalPassTime / measuredPasses;
+			viewsPerSecond[pass] = viewCount * 1000.0 / passTime;
+			std::cout << std::fixed << std::setprecision(3)
+				<< std::setw(8) << viewCount
+				<< std::setw(14) << (bSinglePass ? "single pass" : "pass per view")
+				<< std::setw(10) << pSceneManager->GetMultiViewStats().itemCount
+				<< std::setw(10) << totalRecordTime / measuredPasses
+				<< std::setw(10) << totalSubmitTime / measuredPasses
+				<< std::setw(10) << passTime;
+			PrintFrameAllocations();
+			std::cout << std::setw(12) << std::setprecision(1) << viewsPerSecond[pass];
+			if ((bSinglePass == true) && (viewsPerSecond[0] > 0.0))
+			{
+				std::cout << std::setw(9) << std::setprecision(2) << viewsPerSecond[1] / viewsPerSecond[0] << "x";
+			}
+			std::cout << "\n";
+		}
+	}
+	std::cout << std::endl;
+
+	pSceneManager->SaveMultiViewAtlas(g_ThumbnailAtlasFilename);
+	glfwSwapInterval(1);
+}
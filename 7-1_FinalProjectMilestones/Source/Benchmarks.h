@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarks.h
+// ============
+// benchmark modes that are selected from the command line instead of the
+// interactive render loop - results are printed to the console
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneManager.h"
+#include "ViewManager.h"
+
+// GLFW library
+#include "GLFW/glfw3.h"
+
+namespace Benchmarks
+{
+	// render the desk scene with an increasing number of point
+	// lights, comparing the clustered and brute force light loops
+	void RunLightScaling(
+		GLFWwindow* pWindow,
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager);
+
+	// render the desk scene in recorded order, sorted, and sorted
+	// with a depth pre-pass, comparing the shaded samples
+	void RunDrawOrder(
+		GLFWwindow* pWindow,
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager);
+
+	// render the desk scene with the uber shader and with the
+	// specialized shader variants, for the fixed and the clustered
+	// point lights, comparing the GPU time of the shading pass
+	void RunShaderPermutations(
+		GLFWwindow* pWindow,
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager);
+
+	// load every scene texture with glGenerateMipmap and with the
+	// CPU box and Kaiser mip chains, comparing the load times
+	void RunMipGeneration(SceneManager* pSceneManager);
+
+	// render square grids of desks of a growing size, with and
+	// without the frustum test of the grid cells, comparing the
+	// CPU phases of the frame and its GPU time
+	void RunSceneScaling(
+		GLFWwindow* pWindow,
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager);
+
+	// build finely tessellated spheres, tori and cylinders in ring
+	// order and reordered by the mesh optimizer, comparing their
+	// simulated cache misses and the GPU time of their vertices
+	void RunMeshOptimization();
+
+	// bake the lighting of the desk scene, then render it with the
+	// runtime lights and with the lightmaps, comparing the GPU time
+	// of the shading pass
+	void RunLightmaps(
+		GLFWwindow* pWindow,
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager);
+
+	// render the desk scene with GL and with the CPU rasterizer on
+	// a growing number of threads, comparing the frame times, and
+	// save the last software frame
+	void RunSoftwareRaster(
+		GLFWwindow* pWindow,
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager);
+
+	// build the pick tree over growing grids of desks and trace
+	// random view rays through it and against every draw,
+	// comparing the query times, then time the refit of the tree
+	// for a few and for all draws moving
+	void RunPicking(
+		GLFWwindow* pWindow,
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager);
+
+	// render up to 16 thumbnail views of the desk into one atlas,
+	// with a full pass per view and with the single multi-view
+	// pass, comparing the views rendered per second
+	void RunMultiView(
+		SceneManager* pSceneManager);
+}
@@ -0,0 +1,204 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.cpp
+// ============
+// recorded camera paths - the per-frame camera state and the input that moved
+// it, stored in a compact binary file so that a run can be replayed exactly
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraPath.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// file header - the magic, the format version and the number
+	// of frames, followed by fixed size little endian records
+	const char PATH_MAGIC[4] = { 'C', 'A', 'M', 'P' };
+	const uint32_t PATH_VERSION = 1;
+	// 16 floats, the key mask and the projection flag
+	const size_t FRAME_RECORD_SIZE = 16 * sizeof(float) + sizeof(uint16_t) + sizeof(uint8_t);
+
+	/***********************************************************
+	 *  PutValue()
+	 *
+	 *  Append the bytes of a value to a record, in the byte
+	 *  order of the targeted x86 and x64 machines.
+	 ***********************************************************/
+	template <typename T>
+	void PutValue(std::vector<unsigned char>& record, T value)
+	{
+		unsigned char bytes[sizeof(T)];
+		memcpy(bytes, &value, sizeof(T));
+		record.insert(record.end(), bytes, bytes + sizeof(T));
+	}
+
+	/***********************************************************
+	 *  GetValue()
+	 *
+	 *  Read a value from a record and advance past it.
+	 ***********************************************************/
+	template <typename T>
+	T GetValue(const unsigned char*& pRecord)
+	{
+		T value;
+		memcpy(&value, pRecord, sizeof(T));
+		pRecord += sizeof(T);
+		return(value);
+	}
+}
+
+/***********************************************************
+ *  CameraPath()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraPath::CameraPath()
+{
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used to remove every frame of the path.
+ ***********************************************************/
+void CameraPath::Clear()
+{
+	m_frames.clear();
+}
+
+/***********************************************************
+ *  AddFrame()
+ *
+ *  This method is used to append the state of one frame.
+ ***********************************************************/
+void CameraPath::AddFrame(const CAMERA_FRAME& frame)
+{
+	m_frames.push_back(frame);
+}
+
+/***********************************************************
+ *  Save()
+ *
+ *  This method is used to write the path to a binary file.
+ ***********************************************************/
+bool CameraPath::Save(const char* filename) const
+{
+	FILE* pFile = fopen(filename, "wb");
+	if (NULL == pFile)
+	{
+		std::cerr << "ERROR: Could not write the camera path: " << filename << std::endl;
+		return(false);
+	}
+
+	std::vector<unsigned char> data;
+	data.reserve(12 + m_frames.size() * FRAME_RECORD_SIZE);
+	data.insert(data.end(), PATH_MAGIC, PATH_MAGIC + 4);
+	PutValue<uint32_t>(data, PATH_VERSION);
+	PutValue<uint32_t>(data, (uint32_t)m_frames.size());
+
+	for (size_t i = 0; i < m_frames.size(); i++)
+	{
+		const CAMERA_FRAME& frame = m_frames[i];
+		PutValue<float>(data, frame.deltaTime);
+		for (int c = 0; c < 3; c++)
+		{
+			PutValue<float>(data, frame.position[c]);
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			PutValue<float>(data, frame.front[c]);
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			PutValue<float>(data, frame.up[c]);
+		}
+		PutValue<float>(data, frame.yaw);
+		PutValue<float>(data, frame.pitch);
+		PutValue<float>(data, frame.zoom);
+		PutValue<float>(data, frame.mouseOffsetX);
+		PutValue<float>(data, frame.mouseOffsetY);
+		PutValue<float>(data, frame.scrollOffset);
+		PutValue<uint16_t>(data, frame.keys);
+		PutValue<uint8_t>(data, frame.bOrthographic ? 1 : 0);
+	}
+
+	bool bWritten = (fwrite(data.data(), 1, data.size(), pFile) == data.size());
+	fclose(pFile);
+
+	std::cout << "INFO: Recorded " << m_frames.size() << " camera frames to " << filename << std::endl;
+	return(bWritten);
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used to read the path from a binary file.
+ ***********************************************************/
+bool CameraPath::Load(const char* filename)
+{
+	m_frames.clear();
+
+	FILE* pFile = fopen(filename, "rb");
+	if (NULL == pFile)
+	{
+		std::cerr << "ERROR: Could not read the camera path: " << filename << std::endl;
+		return(false);
+	}
+
+	std::vector<unsigned char> data;
+	unsigned char buffer[4096];
+	size_t bytesRead = 0;
+	while ((bytesRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+	{
+		data.insert(data.end(), buffer, buffer + bytesRead);
+	}
+	fclose(pFile);
+
+	if ((data.size() < 12) || (memcmp(data.data(), PATH_MAGIC, 4) != 0))
+	{
+		std::cerr << "ERROR: Not a camera path file: " << filename << std::endl;
+		return(false);
+	}
+
+	const unsigned char* pRecord = data.data() + 4;
+	uint32_t version = GetValue<uint32_t>(pRecord);
+	uint32_t frameCount = GetValue<uint32_t>(pRecord);
+	if ((version != PATH_VERSION) || (data.size() < 12 + (size_t)frameCount * FRAME_RECORD_SIZE))
+	{
+		std::cerr << "ERROR: Unsupported or truncated camera path: " << filename << std::endl;
+		return(false);
+	}
+
+	m_frames.resize(frameCount);
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		CAMERA_FRAME& frame = m_frames[i];
+		frame.deltaTime = GetValue<float>(pRecord);
+		for (int c = 0; c < 3; c++)
+		{
+			frame.position[c] = GetValue<float>(pRecord);
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			frame.front[c] = GetValue<float>(pRecord);
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			frame.up[c] = GetValue<float>(pRecord);
+		}
+		frame.yaw = GetValue<float>(pRecord);
+		frame.pitch = GetValue<float>(pRecord);
+		frame.zoom = GetValue<float>(pRecord);
+		frame.mouseOffsetX = GetValue<float>(pRecord);
+		frame.mouseOffsetY = GetValue<float>(pRecord);
+		frame.scrollOffset = GetValue<float>(pRecord);
+		frame.keys = GetValue<uint16_t>(pRecord);
+		frame.bOrthographic = (GetValue<uint8_t>(pRecord) != 0);
+	}
+
+	std::cout << "INFO: Loaded " << frameCount << " camera frames from " << filename << std::endl;
+	return(true);
+}
@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.h
+// ============
+// recorded camera paths - the per-frame camera state and the input that moved
+// it, stored in a compact binary file so that a run can be replayed exactly
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  CameraPath
+ *
+ *  This class holds the frames of a recorded camera path
+ *  and reads and writes the path files.
+ ***********************************************************/
+class CameraPath
+{
+public:
+	// keys held during a frame
+	enum INPUT_KEY
+	{
+		KEY_FORWARD = 1 << 0,	// W
+		KEY_BACKWARD = 1 << 1,	// S
+		KEY_LEFT = 1 << 2,		// A
+		KEY_RIGHT = 1 << 3,		// D
+		KEY_UP = 1 << 4,		// Q
+		KEY_DOWN = 1 << 5,		// E
+		KEY_ORTHOGRAPHIC = 1 << 6,	// O
+		KEY_PERSPECTIVE = 1 << 7	// P
+	};
+
+	// camera state at the end of one frame, and the input that
+	// was processed in that frame
+	struct CAMERA_FRAME
+	{
+		float deltaTime;
+		glm::vec3 position;
+		glm::vec3 front;
+		glm::vec3 up;
+		float yaw;
+		float pitch;
+		float zoom;
+		bool bOrthographic;
+		uint16_t keys;
+		float mouseOffsetX;
+		float mouseOffsetY;
+		float scrollOffset;
+	};
+
+	// constructor
+	CameraPath();
+
+	void Clear();
+	void AddFrame(const CAMERA_FRAME& frame);
+	int GetFrameCount() const { return (int)m_frames.size(); }
+	const CAMERA_FRAME& GetFrame(int index) const { return m_frames[index]; }
+
+	// write the frames to a path file
+	bool Save(const char* filename) const;
+	// read the frames of a path file - false if the file cannot be
+	// read or is not a camera path
+	bool Load(const char* filename);
+
+private:
+	std::vector<CAMERA_FRAME> m_frames;
+};
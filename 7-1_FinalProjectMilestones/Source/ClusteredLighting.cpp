@@ -0,0 +1,629 @@
+///////////////////////////////////////////////////////////////////////////////
+// clusteredlighting.cpp
+// ============
+// clustered forward lighting - point lights are binned on the CPU into
+// view space froxels and uploaded as texture buffers, so that each fragment
+// only evaluates the lights that reach its cluster
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ClusteredLighting.h"
+#include "GLStateCache.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+// GLM Math Header inclusions
+#include <glm/gtx/transform.hpp>
+
+// declaration of the global variables and defines
+namespace
+{
+	// light contributions below this intensity are treated as zero
+	// when the light radius is derived from its attenuation
+	const float LIGHT_CUTOFF_INTENSITY = 1.0f / 256.0f;
+
+	// number of RGBA32F texels stored per light in the light buffer
+	const int TEXELS_PER_LIGHT = 4;
+
+	/***********************************************************
+	 *  MaxComponent()
+	 ***********************************************************/
+	float MaxComponent(const glm::vec3& value)
+	{
+		return std::max(value.x, std::max(value.y, value.z));
+	}
+
+	/***********************************************************
+	 *  BoxDistanceSquared()
+	 *
+	 *  Squared distance from the point to the closest point of
+	 *  the box, zero inside of it.
+	 ***********************************************************/
+	float BoxDistanceSquared(const glm::vec3& center, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		float distanceSquared = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float value = center[axis];
+			if (value < boxMin[axis])
+			{
+				distanceSquared += (boxMin[axis] - value) * (boxMin[axis] - value);
+			}
+			else if (value > boxMax[axis])
+			{
+				distanceSquared += (value - boxMax[axis]) * (value - boxMax[axis]);
+			}
+		}
+		return(distanceSquared);
+	}
+
+	/***********************************************************
+	 *  SphereIntersectsBox()
+	 *
+	 *  Squared distance from the sphere center to the closest
+	 *  point of the box, compared against the radius.
+	 ***********************************************************/
+	bool SphereIntersectsBox(const glm::vec3& center, float radius, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		return(BoxDistanceSquared(center, boxMin, boxMax) <= radius * radius);
+	}
+
+	/***********************************************************
+	 *  UploadTextureBuffer()
+	 *
+	 *  Orphan the buffer storage and upload the new contents.
+	 *  Texture buffers must not be empty, so a single zero
+	 *  element is uploaded in place of an empty array.
+	 ***********************************************************/
+	void UploadTextureBuffer(GLuint buffer, const void* pData, size_t size)
+	{
+		static const unsigned int zero[4] = { 0, 0, 0, 0 };
+		if (size == 0)
+		{
+			pData = zero;
+			size = sizeof(zero);
+		}
+
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, size, pData);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+}
+
+/***********************************************************
+ *  ClusteredLighting()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ClusteredLighting::ClusteredLighting()
+{
+	m_bLightDataDirty = true;
+	m_boundsProjection = glm::mat4(0.0f);
+	m_boundsWidth = 0;
+	m_boundsHeight = 0;
+	m_nearPlane = 0.1f;
+	m_farPlane = 100.0f;
+	m_lightDataBuffer = 0;
+	m_lightDataTexture = 0;
+	m_clusterGridBuffer = 0;
+	m_clusterGridTexture = 0;
+	m_lightIndexBuffer = 0;
+	m_lightIndexTexture = 0;
+	m_tileSize = glm::vec2(1.0f);
+	m_stats = CLUSTER_STATS();
+	m_objectStats = OBJECT_STATS();
+
+	m_clusterBounds.resize(CLUSTER_COUNT);
+	m_clusterCounts.resize(CLUSTER_COUNT);
+	m_clusterGrid.resize(CLUSTER_COUNT * 2);
+}
+
+/***********************************************************
+ *  ~ClusteredLighting()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ClusteredLighting::~ClusteredLighting()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to create the three texture buffers
+ *  and to point the shader's buffer samplers at their
+ *  reserved texture units.
+ ***********************************************************/
+bool ClusteredLighting::Create(ShaderManager* pShaderManager)
+{
+	Destroy();
+
+	glGenBuffers(1, &m_lightDataBuffer);
+	glGenBuffers(1, &m_clusterGridBuffer);
+	glGenBuffers(1, &m_lightIndexBuffer);
+	glGenTextures(1, &m_lightDataTexture);
+	glGenTextures(1, &m_clusterGridTexture);
+	glGenTextures(1, &m_lightIndexTexture);
+
+	// give every buffer valid storage before it is attached
+	UploadTextureBuffer(m_lightDataBuffer, NULL, 0);
+	UploadTextureBuffer(m_clusterGridBuffer, NULL, 0);
+	UploadTextureBuffer(m_lightIndexBuffer, NULL, 0);
+
+	glBindTexture(GL_TEXTURE_BUFFER, m_lightDataTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_lightDataBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, m_clusterGridTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, m_clusterGridBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, m_lightIndexTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_lightIndexBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	// every sampler in the program needs a unit of its own, even
+	// when the clustered path is not selected
+	if (NULL != pShaderManager)
+	{
+		GLStateCache::SetInt(pShaderManager, "clusterLightData", LIGHT_DATA_TEXTURE_UNIT);
+		GLStateCache::SetInt(pShaderManager, "clusterGrid", CLUSTER_GRID_TEXTURE_UNIT);
+		GLStateCache::SetInt(pShaderManager, "clusterLightIndices", LIGHT_INDEX_TEXTURE_UNIT);
+	}
+
+	m_bLightDataDirty = true;
+
+	return(glGetError() == GL_NO_ERROR);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to free the texture buffers.
+ ***********************************************************/
+void ClusteredLighting::Destroy()
+{
+	GLuint textures[] = { m_lightDataTexture, m_clusterGridTexture, m_lightIndexTexture };
+	GLuint buffers[] = { m_lightDataBuffer, m_clusterGridBuffer, m_lightIndexBuffer };
+
+	if (m_lightDataTexture != 0)
+	{
+		glDeleteTextures(3, textures);
+		glDeleteBuffers(3, buffers);
+	}
+
+	m_lightDataBuffer = m_clusterGridBuffer = m_lightIndexBuffer = 0;
+	m_lightDataTexture = m_clusterGridTexture = m_lightIndexTexture = 0;
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method is used to replace the point light list and
+ *  to derive each light's range from its attenuation.
+ ***********************************************************/
+void ClusteredLighting::SetLights(const std::vector<POINT_LIGHT>& lights)
+{
+	m_lights.clear();
+	m_lightRadii.clear();
+
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		if (lights[i].bActive)
+		{
+			m_lights.push_back(lights[i]);
+			m_lightRadii.push_back(CalcLightRadius(lights[i], LIGHT_CUTOFF_INTENSITY));
+		}
+	}
+
+	m_bLightDataDirty = true;
+}
+
+/***********************************************************
+ *  CalcLightRadius()
+ *
+ *  This method is used to solve the attenuation equation
+ *
+ *    intensity / (constant + linear*d + quadratic*d*d) = threshold
+ *
+ *  for the distance d, using the light's strongest color
+ *  channel as the intensity.
+ ***********************************************************/
+float ClusteredLighting::CalcLightRadius(const POINT_LIGHT& light, float threshold)
+{
+	float intensity = MaxComponent(light.ambient + light.diffuse + light.specular);
+	float c = light.constant - intensity / threshold;
+
+	if (c >= 0.0f)
+	{
+		// the light never gets brighter than the threshold
+		return(0.0f);
+	}
+
+	if (light.quadratic > 0.0f)
+	{
+		float discriminant = light.linear * light.linear - 4.0f * light.quadratic * c;
+		return((-light.linear + std::sqrt(discriminant)) / (2.0f * light.quadratic));
+	}
+	if (light.linear > 0.0f)
+	{
+		return(-c / light.linear);
+	}
+
+	// no attenuation at all - the light reaches everything
+	return(1.0e6f);
+}
+
+/***********************************************************
+ *  DepthToSlice()
+ *
+ *  Depth slices are spaced exponentially between the near
+ *  and far planes, which keeps the clusters roughly cubic.
+ *  The fragment shader uses the same formula.
+ ***********************************************************/
+int ClusteredLighting::DepthToSlice(float viewDepth) const
+{
+	float scale = (float)CLUSTERS_Z / std::log(m_farPlane / m_nearPlane);
+	float bias = -(float)CLUSTERS_Z * std::log(m_nearPlane) / std::log(m_farPlane / m_nearPlane);
+	int slice = (int)std::floor(std::log(std::max(viewDepth, m_nearPlane)) * scale + bias);
+	return(glm::clamp(slice, 0, CLUSTERS_Z - 1));
+}
+
+/***********************************************************
+ *  BuildClusterBounds()
+ *
+ *  This method is used to compute the view space bounding
+ *  box of every cluster.  The tile corners are unprojected
+ *  through the inverse projection, which handles both the
+ *  perspective and the orthographic camera.
+ ***********************************************************/
+void ClusteredLighting::BuildClusterBounds(const glm::mat4& projection, int viewportWidth, int viewportHeight)
+{
+	m_boundsProjection = projection;
+	m_boundsWidth = viewportWidth;
+	m_boundsHeight = viewportHeight;
+
+	// recover the clip planes from the projection matrix
+	if (projection[2][3] != 0.0f)
+	{
+		m_nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+		m_farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	}
+	else
+	{
+		m_nearPlane = (projection[3][2] + 1.0f) / projection[2][2];
+		m_farPlane = (projection[3][2] - 1.0f) / projection[2][2];
+	}
+
+	m_tileSize = glm::vec2(
+		std::ceil((float)viewportWidth / CLUSTERS_X),
+		std::ceil((float)viewportHeight / CLUSTERS_Y));
+
+	glm::mat4 inverseProjection = glm::inverse(projection);
+
+	for (int y = 0; y < CLUSTERS_Y; y++)
+	{
+		for (int x = 0; x < CLUSTERS_X; x++)
+		{
+			// unproject the tile corners onto the near and far planes
+			glm::vec3 nearCorners[4];
+			glm::vec3 farCorners[4];
+			for (int corner = 0; corner < 4; corner++)
+			{
+				float pixelX = (x + (corner & 1)) * m_tileSize.x;
+				float pixelY = (y + (corner >> 1)) * m_tileSize.y;
+				float ndcX = glm::min(pixelX / viewportWidth, 1.0f) * 2.0f - 1.0f;
+				float ndcY = glm::min(pixelY / viewportHeight, 1.0f) * 2.0f - 1.0f;
+
+				glm::vec4 nearPoint = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+				glm::vec4 farPoint = inverseProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+				nearCorners[corner] = glm::vec3(nearPoint) / nearPoint.w;
+				farCorners[corner] = glm::vec3(farPoint) / farPoint.w;
+			}
+
+			for (int z = 0; z < CLUSTERS_Z; z++)
+			{
+				float sliceNear = m_nearPlane * std::pow(m_farPlane / m_nearPlane, (float)z / CLUSTERS_Z);
+				float sliceFar = m_nearPlane * std::pow(m_farPlane / m_nearPlane, (float)(z + 1) / CLUSTERS_Z);
+
+				glm::vec3 boxMin = glm::vec3(1.0e30f);
+				glm::vec3 boxMax = glm::vec3(-1.0e30f);
+				for (int corner = 0; corner < 4; corner++)
+				{
+					glm::vec3 ray = farCorners[corner] - nearCorners[corner];
+					float depths[2] = { sliceNear, sliceFar };
+					for (int d = 0; d < 2; d++)
+					{
+						// intersect the corner ray with the plane z = -depth
+						float t = (-depths[d] - nearCorners[corner].z) / ray.z;
+						glm::vec3 point = nearCorners[corner] + ray * t;
+						boxMin = glm::min(boxMin, point);
+						boxMax = glm::max(boxMax, point);
+					}
+				}
+
+				CLUSTER_BOUNDS& bounds = m_clusterBounds[(z * CLUSTERS_Y + y) * CLUSTERS_X + x];
+				bounds.minPoint = boxMin;
+				bounds.maxPoint = boxMax;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  UploadLightData()
+ *
+ *  This method is used to upload the light parameters, four
+ *  RGBA32F texels per light:
+ *    [position.xyz, radius] [ambient.rgb, constant]
+ *    [diffuse.rgb, linear]  [specular.rgb, quadratic]
+ ***********************************************************/
+void ClusteredLighting::UploadLightData()
+{
+	std::vector<float> lightData(m_lights.size() * TEXELS_PER_LIGHT * 4);
+
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		const POINT_LIGHT& light = m_lights[i];
+		float* pTexel = &lightData[i * TEXELS_PER_LIGHT * 4];
+
+		pTexel[0] = light.position.x;  pTexel[1] = light.position.y;  pTexel[2] = light.position.z;  pTexel[3] = m_lightRadii[i];
+		pTexel[4] = light.ambient.r;   pTexel[5] = light.ambient.g;   pTexel[6] = light.ambient.b;   pTexel[7] = light.constant;
+		pTexel[8] = light.diffuse.r;   pTexel[9] = light.diffuse.g;   pTexel[10] = light.diffuse.b;  pTexel[11] = light.linear;
+		pTexel[12] = light.specular.r; pTexel[13] = light.specular.g; pTexel[14] = light.specular.b; pTexel[15] = light.quadratic;
+	}
+
+	UploadTextureBuffer(m_lightDataBuffer, lightData.empty() ? NULL : &lightData[0], lightData.size() * sizeof(float));
+	m_bLightDataDirty = false;
+}
+
+/***********************************************************
+ *  BuildClusters()
+ *
+ *  This method is used to assign every light to the clusters
+ *  its sphere of influence overlaps.  The candidate clusters
+ *  are limited to the screen rectangle and depth slices the
+ *  sphere projects to, and each candidate is then tested
+ *  against the cluster's view space bounds.  The result is a
+ *  compact index list with an (offset, count) pair for each
+ *  cluster.
+ ***********************************************************/
+void ClusteredLighting::BuildClusters(const glm::mat4& view, const glm::mat4& projection, int viewportWidth, int viewportHeight)
+{
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	if ((viewportWidth != m_boundsWidth) || (viewportHeight != m_boundsHeight) ||
+		(projection != m_boundsProjection))
+	{
+		BuildClusterBounds(projection, viewportWidth, viewportHeight);
+	}
+
+	if (m_bLightDataDirty)
+	{
+		UploadLightData();
+	}
+
+	std::fill(m_clusterCounts.begin(), m_clusterCounts.end(), 0u);
+	m_pairs.clear();
+
+	int visibleLights = 0;
+	for (size_t lightIndex = 0; lightIndex < m_lights.size(); lightIndex++)
+	{
+		float radius = m_lightRadii[lightIndex];
+		glm::vec3 center = glm::vec3(view * glm::vec4(m_lights[lightIndex].position, 1.0f));
+		float depth = -center.z;
+
+		// completely in front of the near plane or behind the far plane
+		if ((depth + radius < m_nearPlane) || (depth - radius > m_farPlane))
+		{
+			continue;
+		}
+
+		int sliceFirst = DepthToSlice(depth - radius);
+		int sliceLast = DepthToSlice(depth + radius);
+
+		// screen space tile range of the sphere's bounding box; a
+		// sphere that crosses the near plane may cover the whole screen
+		int tileFirstX = 0;
+		int tileLastX = CLUSTERS_X - 1;
+		int tileFirstY = 0;
+		int tileLastY = CLUSTERS_Y - 1;
+		if (depth - radius > m_nearPlane)
+		{
+			glm::vec2 ndcMin = glm::vec2(1.0e30f);
+			glm::vec2 ndcMax = glm::vec2(-1.0e30f);
+			for (int corner = 0; corner < 8; corner++)
+			{
+				glm::vec3 offset = glm::vec3(
+					(corner & 1) ? radius : -radius,
+					(corner & 2) ? radius : -radius,
+					(corner & 4) ? radius : -radius);
+				glm::vec4 clip = projection * glm::vec4(center + offset, 1.0f);
+				glm::vec2 ndc = glm::vec2(clip.x / clip.w, clip.y / clip.w);
+				ndcMin = glm::min(ndcMin, ndc);
+				ndcMax = glm::max(ndcMax, ndc);
+			}
+
+			// entirely off screen
+			if ((ndcMax.x < -1.0f) || (ndcMin.x > 1.0f) || (ndcMax.y < -1.0f) || (ndcMin.y > 1.0f))
+			{
+				continue;
+			}
+
+			tileFirstX = glm::clamp((int)((ndcMin.x * 0.5f + 0.5f) * viewportWidth / m_tileSize.x), 0, CLUSTERS_X - 1);
+			tileLastX = glm::clamp((int)((ndcMax.x * 0.5f + 0.5f) * viewportWidth / m_tileSize.x), 0, CLUSTERS_X - 1);
+			tileFirstY = glm::clamp((int)((ndcMin.y * 0.5f + 0.5f) * viewportHeight / m_tileSize.y), 0, CLUSTERS_Y - 1);
+			tileLastY = glm::clamp((int)((ndcMax.y * 0.5f + 0.5f) * viewportHeight / m_tileSize.y), 0, CLUSTERS_Y - 1);
+		}
+
+		visibleLights++;
+
+		for (int z = sliceFirst; z <= sliceLast; z++)
+		{
+			for (int y = tileFirstY; y <= tileLastY; y++)
+			{
+				for (int x = tileFirstX; x <= tileLastX; x++)
+				{
+					int clusterIndex = (z * CLUSTERS_Y + y) * CLUSTERS_X + x;
+					const CLUSTER_BOUNDS& bounds = m_clusterBounds[clusterIndex];
+					if (SphereIntersectsBox(center, radius, bounds.minPoint, bounds.maxPoint))
+					{
+						m_pairs.push_back((unsigned int)clusterIndex);
+						m_pairs.push_back((unsigned int)lightIndex);
+						m_clusterCounts[clusterIndex]++;
+					}
+				}
+			}
+		}
+	}
+
+	// prefix sum of the counts gives each cluster its offset
+	unsigned int offset = 0;
+	int maxLightsPerCluster = 0;
+	int dropped = 0;
+	for (int i = 0; i < CLUSTER_COUNT; i++)
+	{
+		unsigned int count = m_clusterCounts[i];
+		if (offset + count > (unsigned int)MAX_LIGHT_INDICES)
+		{
+			dropped += (int)(offset + count) - MAX_LIGHT_INDICES;
+			count = (unsigned int)MAX_LIGHT_INDICES - offset;
+		}
+		m_clusterGrid[i * 2] = offset;
+		m_clusterGrid[i * 2 + 1] = count;
+		maxLightsPerCluster = std::max(maxLightsPerCluster, (int)count);
+		offset += count;
+		// reuse the counts as the fill cursor of each cluster
+		m_clusterCounts[i] = 0;
+	}
+
+	m_lightIndices.resize(offset);
+	for (size_t i = 0; i < m_pairs.size(); i += 2)
+	{
+		unsigned int clusterIndex = m_pairs[i];
+		unsigned int& cursor = m_clusterCounts[clusterIndex];
+		if (cursor < m_clusterGrid[clusterIndex * 2 + 1])
+		{
+			m_lightIndices[m_clusterGrid[clusterIndex * 2] + cursor] = m_pairs[i + 1];
+			cursor++;
+		}
+	}
+
+	UploadTextureBuffer(m_clusterGridBuffer, &m_clusterGrid[0], m_clusterGrid.size() * sizeof(unsigned int));
+	UploadTextureBuffer(m_lightIndexBuffer, m_lightIndices.empty() ? NULL : &m_lightIndices[0],
+		m_lightIndices.size() * sizeof(unsigned int));
+
+	m_stats.lightCount = (int)m_lights.size();
+	m_stats.visibleLightCount = visibleLights;
+	m_stats.assignedIndexCount = (int)offset;
+	m_stats.droppedIndexCount = dropped;
+	m_stats.maxLightsPerCluster = maxLightsPerCluster;
+	m_stats.buildMilliseconds = TraceProfiler::NowMilliseconds() - startTime;
+}
+
+/***********************************************************
+ *  BuildObjectLights()
+ *
+ *  This method is used to assign the lights to the draws
+ *  instead of the clusters.  A light is kept for a draw when
+ *  its sphere of influence overlaps the draw's bounding box.
+ *  When more than MAX_OBJECT_LIGHTS reach the box, the ones
+ *  whose center is nearest to the box relative to their
+ *  radius are kept, as they contribute the most.
+ ***********************************************************/
+void ClusteredLighting::BuildObjectLights(const std::vector<OBJECT_BOUNDS>& bounds, std::vector<OBJECT_LIGHTS>& objectLights)
+{
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	if (m_bLightDataDirty)
+	{
+		UploadLightData();
+	}
+
+	objectLights.resize(bounds.size());
+
+	int assigned = 0;
+	int dropped = 0;
+	int maxLightsPerObject = 0;
+	for (size_t objectIndex = 0; objectIndex < bounds.size(); objectIndex++)
+	{
+		const OBJECT_BOUNDS& box = bounds[objectIndex];
+		OBJECT_LIGHTS& lightList = objectLights[objectIndex];
+		// distance of each kept light relative to its radius, the
+		// list is kept sorted by it
+		float weights[MAX_OBJECT_LIGHTS];
+		int reached = 0;
+		lightList.count = 0;
+
+		for (size_t lightIndex = 0; lightIndex < m_lights.size(); lightIndex++)
+		{
+			float radius = m_lightRadii[lightIndex];
+			float distanceSquared = BoxDistanceSquared(m_lights[lightIndex].position, box.minPoint, box.maxPoint);
+			if (distanceSquared > radius * radius)
+			{
+				continue;
+			}
+			reached++;
+
+			float weight = (radius > 0.0f) ? (distanceSquared / (radius * radius)) : 1.0f;
+			int slot = lightList.count;
+			if (slot == MAX_OBJECT_LIGHTS)
+			{
+				// full - replace the farthest light if this one is nearer
+				if (weight >= weights[MAX_OBJECT_LIGHTS - 1])
+				{
+					continue;
+				}
+				slot = MAX_OBJECT_LIGHTS - 1;
+			}
+			else
+			{
+				lightList.count++;
+			}
+
+			while ((slot > 0) && (weights[slot - 1] > weight))
+			{
+				weights[slot] = weights[slot - 1];
+				lightList.indices[slot] = lightList.indices[slot - 1];
+				slot--;
+			}
+			weights[slot] = weight;
+			lightList.indices[slot] = (unsigned int)lightIndex;
+		}
+
+		assigned += lightList.count;
+		dropped += reached - lightList.count;
+		maxLightsPerObject = std::max(maxLightsPerObject, lightList.count);
+	}
+
+	m_objectStats.lightCount = (int)m_lights.size();
+	m_objectStats.objectCount = (int)bounds.size();
+	m_objectStats.assignedLightCount = assigned;
+	m_objectStats.droppedLightCount = dropped;
+	m_objectStats.maxLightsPerObject = maxLightsPerObject;
+	m_objectStats.buildMilliseconds = TraceProfiler::NowMilliseconds() - startTime;
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used to bind the light buffers to their
+ *  texture units and to pass the per-frame cluster values
+ *  and the selected point light mode into the shader.
+ ***********************************************************/
+void ClusteredLighting::Bind(ShaderManager* pShaderManager, int mode) const
+{
+	glActiveTexture(GL_TEXTURE0 + LIGHT_DATA_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_lightDataTexture);
+	glActiveTexture(GL_TEXTURE0 + CLUSTER_GRID_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_clusterGridTexture);
+	glActiveTexture(GL_TEXTURE0 + LIGHT_INDEX_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_lightIndexTexture);
+
+	float depthScale = (float)CLUSTERS_Z / std::log(m_farPlane / m_nearPlane);
+	float depthBias = -(float)CLUSTERS_Z * std::log(m_nearPlane) / std::log(m_farPlane / m_nearPlane);
+
+	GLStateCache::SetInt(pShaderManager, "pointLightMode", mode);
+	GLStateCache::SetInt(pShaderManager, "clusterLightCount", (int)m_lights.size());
+	GLStateCache::SetVec2(pShaderManager, "clusterTileSize", m_tileSize);
+	GLStateCache::SetVec2(pShaderManager, "clusterDepthParams", glm::vec2(depthScale, depthBias));
+}
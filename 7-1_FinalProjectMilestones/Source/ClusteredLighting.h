@@ -0,0 +1,180 @@
+///////////////////////////////////////////////////////////////////////////////
+// clusteredlighting.h
+// ============
+// clustered forward lighting - point lights are binned on the CPU into
+// view space froxels and uploaded as texture buffers, so that each fragment
+// only evaluates the lights that reach its cluster
+//
+//  The same light buffer also serves per-object light lists: the lights whose
+//  range reaches an object's bounding box are gathered on the CPU once per
+//  frame, and the draw passes their indices on to the fragment shader.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  ClusteredLighting
+ *
+ *  This class contains the point light list, the CPU light
+ *  to cluster assignment and the texture buffers the scene
+ *  fragment shader reads the light lists from.
+ ***********************************************************/
+class ClusteredLighting
+{
+public:
+	// how the fragment shader finds the point lights
+	enum POINT_LIGHT_MODE
+	{
+		LIGHTS_FIXED = 0,		// the fixed pointLights[4] uniform array
+		LIGHTS_CLUSTERED,		// only the lights binned into the fragment's cluster
+		LIGHTS_ALL,				// every light in the light buffer (brute force)
+		LIGHTS_OBJECT			// only the lights whose range reaches the object
+	};
+
+	struct POINT_LIGHT
+	{
+		glm::vec3 position;
+		glm::vec3 ambient;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+		float constant;
+		float linear;
+		float quadratic;
+		bool bActive;
+	};
+
+	struct CLUSTER_STATS
+	{
+		int lightCount;
+		int visibleLightCount;
+		int assignedIndexCount;
+		int droppedIndexCount;
+		int maxLightsPerCluster;
+		double buildMilliseconds;
+	};
+
+	// world space bounding box of a draw
+	struct OBJECT_BOUNDS
+	{
+		glm::vec3 minPoint;
+		glm::vec3 maxPoint;
+	};
+
+	// most lights a single draw is shaded with - the nearest ones
+	// are kept when more of them reach the object
+	static const int MAX_OBJECT_LIGHTS = 8;
+
+	// indices into the light buffer of the lights that reach a draw
+	struct OBJECT_LIGHTS
+	{
+		int count;
+		unsigned int indices[MAX_OBJECT_LIGHTS];
+	};
+
+	struct OBJECT_STATS
+	{
+		int lightCount;
+		int objectCount;
+		int assignedLightCount;
+		int droppedLightCount;	// lights beyond MAX_OBJECT_LIGHTS
+		int maxLightsPerObject;
+		double buildMilliseconds;
+	};
+
+	// froxel grid dimensions - 16x9 screen tiles, 24 depth slices
+	static const int CLUSTERS_X = 16;
+	static const int CLUSTERS_Y = 9;
+	static const int CLUSTERS_Z = 24;
+	static const int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+	// upper limit for the light index list uploaded each frame
+	static const int MAX_LIGHT_INDICES = 256 * 1024;
+
+	// texture units used by the light buffers
+	static const int LIGHT_DATA_TEXTURE_UNIT = 12;
+	static const int CLUSTER_GRID_TEXTURE_UNIT = 13;
+	static const int LIGHT_INDEX_TEXTURE_UNIT = 14;
+
+	// constructor
+	ClusteredLighting();
+	// destructor
+	~ClusteredLighting();
+
+	// create the GL buffers and set the sampler uniforms
+	bool Create(ShaderManager* pShaderManager);
+	// free the GL buffers
+	void Destroy();
+
+	// replace the light list; only active lights are kept
+	void SetLights(const std::vector<POINT_LIGHT>& lights);
+	int GetLightCount() const { return (int)m_lights.size(); }
+
+	// distance at which a light's strongest channel falls below
+	// the passed in intensity threshold
+	static float CalcLightRadius(const POINT_LIGHT& light, float threshold);
+
+	// assign the lights to clusters for the passed in camera and
+	// upload the result - called once per frame before drawing
+	void BuildClusters(const glm::mat4& view, const glm::mat4& projection, int viewportWidth, int viewportHeight);
+
+	// gather the lights that reach each of the passed in bounding
+	// boxes - called once per frame before the draw data upload
+	void BuildObjectLights(const std::vector<OBJECT_BOUNDS>& bounds, std::vector<OBJECT_LIGHTS>& objectLights);
+
+	// bind the light buffers and set the per-frame uniforms
+	void Bind(ShaderManager* pShaderManager, int mode) const;
+
+	const CLUSTER_STATS& GetStats() const { return m_stats; }
+	const OBJECT_STATS& GetObjectStats() const { return m_objectStats; }
+
+private:
+	struct CLUSTER_BOUNDS
+	{
+		glm::vec3 minPoint;
+		glm::vec3 maxPoint;
+	};
+
+	std::vector<POINT_LIGHT> m_lights;
+	std::vector<float> m_lightRadii;
+	bool m_bLightDataDirty;
+
+	// view space bounds of every cluster, rebuilt when the
+	// projection or the viewport size changes
+	std::vector<CLUSTER_BOUNDS> m_clusterBounds;
+	glm::mat4 m_boundsProjection;
+	int m_boundsWidth;
+	int m_boundsHeight;
+	float m_nearPlane;
+	float m_farPlane;
+
+	// CPU side of the uploaded buffers, reused between frames
+	std::vector<unsigned int> m_clusterCounts;
+	std::vector<unsigned int> m_clusterGrid;
+	std::vector<unsigned int> m_lightIndices;
+	std::vector<unsigned int> m_pairs;
+
+	// texture buffers: light data (RGBA32F), cluster offset and
+	// count (RG32UI) and the light index list (R32UI)
+	GLuint m_lightDataBuffer;
+	GLuint m_lightDataTexture;
+	GLuint m_clusterGridBuffer;
+	GLuint m_clusterGridTexture;
+	GLuint m_lightIndexBuffer;
+	GLuint m_lightIndexTexture;
+
+	glm::vec2 m_tileSize;
+	CLUSTER_STATS m_stats;
+	OBJECT_STATS m_objectStats;
+
+	// rebuild the view space cluster bounds
+	void BuildClusterBounds(const glm::mat4& projection, int viewportWidth, int viewportHeight);
+	// upload the light positions, colors and radii
+	void UploadLightData();
+	// depth slice that contains the passed in view space distance
+	int DepthToSlice(float viewDepth) const;
+};
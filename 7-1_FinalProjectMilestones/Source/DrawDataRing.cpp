@@ -0,0 +1,456 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawdataring.cpp
+// ============
+// per-draw data ring - the model transform, color, UV scale and material of
+// every queued draw are written once per frame into a triple-buffered
+// texture buffer, and the scene vertex shader fetches them by draw index
+// together with the draw's point light list
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DrawDataRing.h"
+
+#include "GLCapture.h"
+#include "GLStateCache.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// floats in one RGBA32F texel
+	const int FLOATS_PER_TEXEL = 4;
+	const int FLOATS_PER_DRAW = DrawDataRing::TEXELS_PER_DRAW * FLOATS_PER_TEXEL;
+	const size_t BYTES_PER_DRAW = FLOATS_PER_DRAW * sizeof(float);
+
+	// a fence that has not signaled after this long is given up on
+	const GLuint64 STALL_TIMEOUT_NS = 1000000000;
+
+	const GLbitfield PERSISTENT_MAP_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+}
+
+/***********************************************************
+ *  DrawDataRing()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DrawDataRing::DrawDataRing()
+{
+	m_bPersistent = false;
+	m_bufferID = 0;
+	m_textureID = 0;
+	m_drawCapacity = 0;
+	m_maxDrawCapacity = 0;
+	m_pMapped = NULL;
+	for (int i = 0; i < RING_FRAMES; i++)
+	{
+		m_fences[i] = NULL;
+	}
+	m_region = 0;
+	m_regionBase = 0;
+	m_uploadedCount = 0;
+	m_bRegionPending = false;
+	m_stats = RING_STATS();
+}
+
+/***********************************************************
+ *  ~DrawDataRing()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DrawDataRing::~DrawDataRing()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to choose the upload path, allocate
+ *  the ring for the passed in number of draws per frame and
+ *  attach it to the texture buffer.
+ ***********************************************************/
+bool DrawDataRing::Create(int drawCapacity)
+{
+	Destroy();
+
+	// every region has to be addressable through the one texture
+	GLint maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	m_maxDrawCapacity = maxTexels / (TEXELS_PER_DRAW * RING_FRAMES);
+	if (m_maxDrawCapacity <= 0)
+	{
+		std::cerr << "ERROR: Texture buffers are too small for the draw data" << std::endl;
+		return(false);
+	}
+
+	m_bPersistent = (GLEW_ARB_buffer_storage || GLEW_VERSION_4_4) ? true : false;
+	glGenTextures(1, &m_textureID);
+
+	if (AllocateStorage(std::min(std::max(drawCapacity, 1), m_maxDrawCapacity)) == false)
+	{
+		if (m_bPersistent == false)
+		{
+			Destroy();
+			return(false);
+		}
+
+		std::cout << "WARNING: Persistent draw data mapping failed, orphaning the buffer instead" << std::endl;
+		m_bPersistent = false;
+		if (AllocateStorage(std::min(std::max(drawCapacity, 1), m_maxDrawCapacity)) == false)
+		{
+			Destroy();
+			return(false);
+		}
+	}
+
+	std::cout << "INFO: Draw data ring created for " << m_drawCapacity << " draws per frame ("
+		<< (m_bPersistent ? "persistent mapping" : "orphaned buffer") << ")" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to free the buffer, its texture and
+ *  the fences of the regions.
+ ***********************************************************/
+void DrawDataRing::Destroy()
+{
+	FreeStorage();
+	if (m_textureID != 0)
+	{
+		glDeleteTextures(1, &m_textureID);
+		m_textureID = 0;
+	}
+	m_drawCapacity = 0;
+	m_uploadedCount = 0;
+}
+
+/***********************************************************
+ *  AllocateStorage()
+ *
+ *  This method is used to create the buffer for the passed
+ *  in capacity.  The persistent buffer holds all the ring
+ *  regions and stays mapped; the orphaned buffer holds one
+ *  region and gets new storage every frame.
+ ***********************************************************/
+bool DrawDataRing::AllocateStorage(int drawCapacity)
+{
+	FreeStorage();
+
+	m_drawCapacity = drawCapacity;
+	glGenBuffers(1, &m_bufferID);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_bufferID);
+	if (m_bPersistent == true)
+	{
+		// dynamic storage lets a traced frame upload its region
+		// through glBufferSubData
+		GLsizeiptr size = (GLsizeiptr)(BYTES_PER_DRAW * m_drawCapacity * RING_FRAMES);
+		glBufferStorage(GL_TEXTURE_BUFFER, size, NULL, PERSISTENT_MAP_FLAGS | GL_DYNAMIC_STORAGE_BIT);
+		m_pMapped = (float*)glMapBufferRange(GL_TEXTURE_BUFFER, 0, size, PERSISTENT_MAP_FLAGS);
+		if (NULL == m_pMapped)
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			FreeStorage();
+			return(false);
+		}
+	}
+	else
+	{
+		glBufferData(GL_TEXTURE_BUFFER, BYTES_PER_DRAW * m_drawCapacity, NULL, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_BUFFER, m_textureID);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_bufferID);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	m_region = 0;
+	m_regionBase = 0;
+	m_bRegionPending = false;
+	return(true);
+}
+
+/***********************************************************
+ *  FreeStorage()
+ *
+ *  This method is used to wait for the regions still in use
+ *  and to unmap and delete the buffer.
+ ***********************************************************/
+void DrawDataRing::FreeStorage()
+{
+	for (int i = 0; i < RING_FRAMES; i++)
+	{
+		WaitRegion(i);
+	}
+
+	if (m_bufferID != 0)
+	{
+		if (NULL != m_pMapped)
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, m_bufferID);
+			glUnmapBuffer(GL_TEXTURE_BUFFER);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+			m_pMapped = NULL;
+		}
+		glDeleteBuffers(1, &m_bufferID);
+		m_bufferID = 0;
+	}
+}
+
+/***********************************************************
+ *  WaitRegion()
+ *
+ *  This method is used to make sure that the GPU has read
+ *  the region before it is written again.  The fence is
+ *  polled first, so only a real wait counts as a stall.
+ ***********************************************************/
+void DrawDataRing::WaitRegion(int region)
+{
+	GLsync fence = m_fences[region];
+	if (fence == NULL)
+	{
+		return;
+	}
+
+	GLenum waitResult = glClientWaitSync(fence, 0, 0);
+	if ((waitResult != GL_ALREADY_SIGNALED) && (waitResult != GL_CONDITION_SATISFIED))
+	{
+		double startTime = TraceProfiler::NowMilliseconds();
+		waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STALL_TIMEOUT_NS);
+		double stallTime = TraceProfiler::NowMilliseconds() - startTime;
+
+		m_stats.stallCount++;
+		m_stats.stallMilliseconds += stallTime;
+		m_stats.maxStallMilliseconds = std::max(m_stats.maxStallMilliseconds, stallTime);
+		if ((waitResult == GL_TIMEOUT_EXPIRED) || (waitResult == GL_WAIT_FAILED))
+		{
+			std::cout << "WARNING: Draw data fence did not signal, the region is overwritten" << std::endl;
+		}
+	}
+
+	glDeleteSync(fence);
+	m_fences[region] = NULL;
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used to write the draw data of the queued
+ *  items for the frame.  A queue larger than the ring makes
+ *  it grow to twice the size, once every region is idle.
+ ***********************************************************/
+void DrawDataRing::Upload(const RenderQueue& renderQueue, const std::vector<ClusteredLighting::OBJECT_LIGHTS>* pObjectLights)
+{
+	m_uploadedCount = 0;
+	if (m_bufferID == 0)
+	{
+		return;
+	}
+
+	int itemCount = renderQueue.GetItemCount();
+	if ((itemCount > m_drawCapacity) && (m_drawCapacity < m_maxDrawCapacity))
+	{
+		int newCapacity = std::min(std::max(itemCount, m_drawCapacity * 2), m_maxDrawCapacity);
+		if (AllocateStorage(newCapacity) == false)
+		{
+			std::cerr << "ERROR: Draw data ring could not grow to " << newCapacity << " draws" << std::endl;
+			m_bPersistent = false;
+			if (AllocateStorage(newCapacity) == false)
+			{
+				return;
+			}
+		}
+	}
+
+	m_uploadedCount = std::min(itemCount, m_drawCapacity);
+	m_stats.overflowDraws += itemCount - m_uploadedCount;
+	size_t regionBytes = BYTES_PER_DRAW * m_uploadedCount;
+
+	// the trace capture only sees buffer contents that go through
+	// glBufferData and glBufferSubData
+	bool bStaged = GLCapture::IsCapturing();
+	float* pTexels = NULL;
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m_bufferID);
+	if (m_bPersistent == true)
+	{
+		WaitRegion(m_region);
+		m_regionBase = m_region * m_drawCapacity;
+		pTexels = m_pMapped + (size_t)m_regionBase * FLOATS_PER_DRAW;
+	}
+	else
+	{
+		// new storage every frame, so the draws of the previous
+		// frames keep reading the old one
+		m_regionBase = 0;
+		glBufferData(GL_TEXTURE_BUFFER, BYTES_PER_DRAW * m_drawCapacity, NULL, GL_STREAM_DRAW);
+		if ((bStaged == false) && (regionBytes > 0))
+		{
+			pTexels = (float*)glMapBufferRange(GL_TEXTURE_BUFFER, 0, regionBytes,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (NULL == pTexels)
+			{
+				bStaged = true;
+			}
+		}
+	}
+
+	if (bStaged == true)
+	{
+		m_staging.resize((size_t)m_uploadedCount * FLOATS_PER_DRAW);
+		pTexels = m_staging.data();
+	}
+
+	if ((NULL != pObjectLights) && ((int)pObjectLights->size() < m_uploadedCount))
+	{
+		pObjectLights = NULL;
+	}
+	for (int i = 0; i < m_uploadedCount; i++)
+	{
+		PackDrawData(renderQueue.GetItem(i), (NULL != pObjectLights) ? &(*pObjectLights)[i] : NULL,
+			pTexels + (size_t)i * FLOATS_PER_DRAW);
+	}
+
+	if ((bStaged == true) && (regionBytes > 0))
+	{
+		glBufferSubData(GL_TEXTURE_BUFFER, BYTES_PER_DRAW * m_regionBase, regionBytes, m_staging.data());
+	}
+	else if ((m_bPersistent == false) && (regionBytes > 0))
+	{
+		glUnmapBuffer(GL_TEXTURE_BUFFER);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	m_bRegionPending = true;
+	m_stats.frameCount++;
+	m_stats.uploadedBytes += (long long)regionBytes;
+}
+
+/***********************************************************
+ *  PackDrawData()
+ *
+ *  This method is used to write the texels of a draw.  The
+ *  last row of an affine model matrix is always 0,0,0,1, so
+ *  only the first three rows are stored.  The light indices
+ *  are stored as floats, which hold them exactly.
+ ***********************************************************/
+void DrawDataRing::PackDrawData(const RenderQueue::DRAW_ITEM& item, const ClusteredLighting::OBJECT_LIGHTS* pLights, float* pTexels)
+{
+	for (int row = 0; row < 3; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			pTexels[row * FLOATS_PER_TEXEL + column] = item.model[column][row];
+		}
+	}
+
+	float* pColor = pTexels + 3 * FLOATS_PER_TEXEL;
+	pColor[0] = item.color.r;
+	pColor[1] = item.color.g;
+	pColor[2] = item.color.b;
+	pColor[3] = item.color.a;
+
+	float* pSurface = pTexels + 4 * FLOATS_PER_TEXEL;
+	pSurface[0] = item.uvScale.x;
+	pSurface[1] = item.uvScale.y;
+	pSurface[2] = item.shininess;
+	pSurface[3] = item.opacity;
+
+	float* pDiffuse = pTexels + 5 * FLOATS_PER_TEXEL;
+	pDiffuse[0] = item.diffuseColor.r;
+	pDiffuse[1] = item.diffuseColor.g;
+	pDiffuse[2] = item.diffuseColor.b;
+	pDiffuse[3] = item.bUseTexture ? 1.0f : 0.0f;
+
+	float* pSpecular = pTexels + 6 * FLOATS_PER_TEXEL;
+	pSpecular[0] = item.specularColor.r;
+	pSpecular[1] = item.specularColor.g;
+	pSpecular[2] = item.specularColor.b;
+	pSpecular[3] = (NULL != pLights) ? (float)pLights->count : 0.0f;
+
+	float* pLightIndices = pTexels + 7 * FLOATS_PER_TEXEL;
+	for (int i = 0; i < ClusteredLighting::MAX_OBJECT_LIGHTS; i++)
+	{
+		pLightIndices[i] = ((NULL != pLights) && (i < pLights->count)) ? (float)pLights->indices[i] : 0.0f;
+	}
+}
+
+/***********************************************************
+ *  GetDrawIndex()
+ *
+ *  This method is used to get the index of the item's draw
+ *  data within the whole ring, as the shader addresses it.
+ ***********************************************************/
+int DrawDataRing::GetDrawIndex(int itemIndex) const
+{
+	if ((itemIndex < 0) || (itemIndex >= m_uploadedCount))
+	{
+		return(-1);
+	}
+	return(m_regionBase + itemIndex);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used to bind the texture buffer to the
+ *  draw data unit.
+ ***********************************************************/
+void DrawDataRing::Bind() const
+{
+	GLStateCache::ActiveTexture(DRAW_DATA_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_textureID);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used to fence the region written for the
+ *  frame and to move on to the next one.  The orphaned
+ *  buffer needs no fence, the driver keeps the old storage
+ *  alive for as long as it is read.
+ ***********************************************************/
+void DrawDataRing::EndFrame()
+{
+	if (m_bRegionPending == false)
+	{
+		return;
+	}
+	m_bRegionPending = false;
+
+	if (m_bPersistent == true)
+	{
+		m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_region = (m_region + 1) % RING_FRAMES;
+	}
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used to print the upload path, the data
+ *  written per frame and the time the CPU spent waiting for
+ *  the GPU to release a region.
+ ***********************************************************/
+void DrawDataRing::PrintStats() const
+{
+	if (m_stats.frameCount == 0)
+	{
+		return;
+	}
+
+	double frames = (double)m_stats.frameCount;
+	std::cout << std::fixed << std::setprecision(2)
+		<< "INFO: Draw data ring over " << m_stats.frameCount << " frames ("
+		<< (m_bPersistent ? "persistent mapping" : "orphaned buffer") << "): "
+		<< m_stats.uploadedBytes / frames / 1024.0 << " KB per frame, "
+		<< m_stats.stallCount << " stalls, "
+		<< m_stats.stallMilliseconds << " ms waited (max "
+		<< m_stats.maxStallMilliseconds << " ms), "
+		<< m_stats.overflowDraws << " draws over capacity" << std::endl;
+}
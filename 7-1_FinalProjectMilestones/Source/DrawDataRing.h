@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawdataring.h
+// ============
+// per-draw data ring - the model transform, color, UV scale and material of
+// every queued draw are written once per frame into a triple-buffered
+// texture buffer, and the scene vertex shader fetches them by draw index
+// together with the draw's point light list
+//
+//  Where ARB_buffer_storage is available the buffer is mapped persistently
+//  once, and each frame's region is guarded by a fence so that the CPU never
+//  overwrites data the GPU is still reading.  Otherwise the buffer storage is
+//  orphaned and mapped again every frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ClusteredLighting.h"
+#include "RenderQueue.h"
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  DrawDataRing
+ *
+ *  This class owns the draw data buffer, its texture view
+ *  and the fences of the ring regions.
+ ***********************************************************/
+class DrawDataRing
+{
+public:
+	// frames whose draw data can be in flight at the same time
+	static const int RING_FRAMES = 3;
+	// RGBA32F texels per draw - a 3x4 affine model matrix, the
+	// color, the UV scale with shininess and opacity, the diffuse
+	// and specular colors with the light count, and the indices
+	// of the draw's point lights
+	static const int TEXELS_PER_DRAW = 7 + ClusteredLighting::MAX_OBJECT_LIGHTS / 4;
+	// texture unit of the draw data buffer
+	static const int DRAW_DATA_TEXTURE_UNIT = 16;
+
+	struct RING_STATS
+	{
+		int frameCount;			// frames uploaded
+		int stallCount;			// frames that waited on a fence
+		double stallMilliseconds;	// CPU time spent waiting
+		double maxStallMilliseconds;
+		long long uploadedBytes;
+		int overflowDraws;		// draws that did not fit and used uniforms
+	};
+
+	// constructor
+	DrawDataRing();
+	// destructor
+	~DrawDataRing();
+
+	// create the buffer for the passed in number of draws per frame -
+	// the programs reading it point their drawData sampler at
+	// DRAW_DATA_TEXTURE_UNIT while they are bound
+	bool Create(int drawCapacity);
+	// unmap and free the buffer and the fences
+	void Destroy();
+
+	// write the draw data of every queued item into the next region,
+	// growing the buffer when the queue no longer fits; the light
+	// lists are optional and hold one entry per item
+	void Upload(const RenderQueue& renderQueue, const std::vector<ClusteredLighting::OBJECT_LIGHTS>* pObjectLights);
+	// index of the item's draw data for the shader, or -1 when the
+	// item was not uploaded and has to use the uniforms
+	int GetDrawIndex(int itemIndex) const;
+	// bind the texture buffer to its unit
+	void Bind() const;
+	// fence the region of the frame - called after the last draw
+	// that reads it
+	void EndFrame();
+
+	bool IsPersistent() const { return m_bPersistent; }
+	const RING_STATS& GetStats() const { return m_stats; }
+	// print the upload path, the bytes per frame and the stalls
+	void PrintStats() const;
+
+private:
+	bool m_bPersistent;
+	GLuint m_bufferID;
+	GLuint m_textureID;
+	// draws per region and the largest count the texture buffer
+	// can address
+	int m_drawCapacity;
+	int m_maxDrawCapacity;
+	// persistent mapping of the whole ring
+	float* m_pMapped;
+	// copy of the region written through glBufferSubData while a
+	// GL trace is recorded, which cannot see the mapped writes
+	std::vector<float> m_staging;
+
+	GLsync m_fences[RING_FRAMES];
+	int m_region;
+	int m_regionBase;
+	int m_uploadedCount;
+	bool m_bRegionPending;
+
+	RING_STATS m_stats;
+
+	// allocate the buffer storage for the passed in capacity
+	bool AllocateStorage(int drawCapacity);
+	void FreeStorage();
+	// wait until the GPU has finished with the region
+	void WaitRegion(int region);
+	// write the draw data of one item, pLights may be NULL
+	static void PackDrawData(const RenderQueue::DRAW_ITEM& item, const ClusteredLighting::OBJECT_LIGHTS* pLights, float* pTexels);
+};
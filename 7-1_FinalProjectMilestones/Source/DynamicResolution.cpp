@@ -0,0 +1,450 @@
+///////////////////////////////////////////////////////////////////////////////
+// dynamicresolution.cpp
+// ============
+// dynamic resolution scaling - the scene is rendered into an offscreen target
+// whose scale follows the measured GPU frame time against a budget, and the
+// result is upscaled to the window with a bilinear blit or a sharpening pass
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DynamicResolution.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	const char* g_UpscaleVertexShaderPath = "shaders/upscaleVertexShader.glsl";
+	const char* g_UpscaleFragmentShaderPath = "shaders/upscaleFragmentShader.glsl";
+
+	// default budget - the GPU share of a 60 Hz frame
+	const double DEFAULT_FRAME_BUDGET = 14.0;
+	const float DEFAULT_MIN_SCALE = 0.5f;
+	const float DEFAULT_MAX_SCALE = 1.0f;
+
+	// weight of a new sample in the moving average
+	const double AVERAGE_WEIGHT = 0.1;
+	// frames between two scale changes, so that the average can
+	// settle on the new scale before the next decision
+	const int FRAMES_PER_CHANGE = 15;
+	// the scale grows again only below this part of the budget
+	const double SCALE_UP_THRESHOLD = 0.85;
+	// largest change of the scale in one step
+	const float MAX_SCALE_STEP = 0.1f;
+	// strength of the unsharp mask of UPSCALE_SHARPEN
+	const float SHARPNESS = 0.4f;
+}
+
+/***********************************************************
+ *  DynamicResolution()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DynamicResolution::DynamicResolution()
+{
+	m_windowWidth = 0;
+	m_windowHeight = 0;
+	m_framebufferID = 0;
+	m_colorTextureID = 0;
+	m_depthRenderbufferID = 0;
+	m_vertexArrayID = 0;
+	m_pUpscaleShaderManager = NULL;
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		m_timerQueryIDs[i][0] = 0;
+		m_timerQueryIDs[i][1] = 0;
+		m_bTimerPending[i] = false;
+	}
+	m_timerIndex = 0;
+	m_frameBudget = DEFAULT_FRAME_BUDGET;
+	m_minScale = DEFAULT_MIN_SCALE;
+	m_maxScale = DEFAULT_MAX_SCALE;
+	m_scale = DEFAULT_MAX_SCALE;
+	m_upscaleFilter = UPSCALE_BILINEAR;
+	m_framesSinceChange = 0;
+	m_stats.scale = m_scale;
+	m_stats.renderWidth = 0;
+	m_stats.renderHeight = 0;
+	m_stats.averageGpuMilliseconds = 0.0;
+	m_stats.scaleChanges = 0;
+	m_frameCount = 0;
+	m_totalScale = 0.0;
+	m_lowestScale = m_scale;
+	m_highestScale = m_scale;
+}
+
+/***********************************************************
+ *  ~DynamicResolution()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DynamicResolution::~DynamicResolution()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to create the offscreen target at
+ *  the full window size.  Lower scales render into the lower
+ *  left part of it, so that a scale change never has to
+ *  reallocate anything.
+ ***********************************************************/
+bool DynamicResolution::Create(int windowWidth, int windowHeight)
+{
+	if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query)
+	{
+		std::cout << "WARNING: GL_TIMESTAMP queries are not supported, dynamic resolution is off" << std::endl;
+		return(false);
+	}
+
+	m_windowWidth = windowWidth;
+	m_windowHeight = windowHeight;
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	glGenTextures(1, &m_colorTextureID);
+	glBindTexture(GL_TEXTURE_2D, m_colorTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, windowWidth, windowHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &m_depthRenderbufferID);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, windowWidth, windowHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTextureID, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbufferID);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "ERROR: Dynamic resolution framebuffer is incomplete, status: 0x" << std::hex << status << std::dec << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		glGenQueries(2, m_timerQueryIDs[i]);
+	}
+
+	// the full screen triangle is generated from gl_VertexID, but
+	// the core profile still needs a vertex array to be bound
+	glGenVertexArrays(1, &m_vertexArrayID);
+
+	// loading leaves the new program bound, so the scene program
+	// is restored afterwards
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	m_pUpscaleShaderManager = new ShaderManager();
+	m_pUpscaleShaderManager->LoadShaders(g_UpscaleVertexShaderPath, g_UpscaleFragmentShaderPath);
+	glUseProgram(previousProgram);
+
+	std::cout << "INFO: Dynamic resolution enabled, " << windowWidth << "x" << windowHeight
+		<< ", budget " << m_frameBudget << " ms, scale " << m_minScale << " - " << m_maxScale << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to free the render target, the
+ *  queries and the upscale program.
+ ***********************************************************/
+void DynamicResolution::Destroy()
+{
+	if (m_framebufferID != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebufferID);
+		m_framebufferID = 0;
+	}
+	if (m_colorTextureID != 0)
+	{
+		glDeleteTextures(1, &m_colorTextureID);
+		m_colorTextureID = 0;
+	}
+	if (m_depthRenderbufferID != 0)
+	{
+		glDeleteRenderbuffers(1, &m_depthRenderbufferID);
+		m_depthRenderbufferID = 0;
+	}
+	if (m_vertexArrayID != 0)
+	{
+		glDeleteVertexArrays(1, &m_vertexArrayID);
+		m_vertexArrayID = 0;
+	}
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		if (m_timerQueryIDs[i][0] != 0)
+		{
+			glDeleteQueries(2, m_timerQueryIDs[i]);
+			m_timerQueryIDs[i][0] = 0;
+			m_timerQueryIDs[i][1] = 0;
+		}
+		m_bTimerPending[i] = false;
+	}
+	if (NULL != m_pUpscaleShaderManager)
+	{
+		delete m_pUpscaleShaderManager;
+		m_pUpscaleShaderManager = NULL;
+	}
+}
+
+/***********************************************************
+ *  SetFrameBudget()
+ *
+ *  This method is used to set the GPU time per frame that
+ *  the scale is adjusted towards.
+ ***********************************************************/
+void DynamicResolution::SetFrameBudget(double milliseconds)
+{
+	m_frameBudget = milliseconds;
+}
+
+/***********************************************************
+ *  SetScaleRange()
+ *
+ *  This method is used to set the lowest and highest scale
+ *  of the window size that the scene is rendered at.
+ ***********************************************************/
+void DynamicResolution::SetScaleRange(float minScale, float maxScale)
+{
+	m_maxScale = std::min(std::max(maxScale, 0.1f), 1.0f);
+	m_minScale = std::min(std::max(minScale, 0.1f), m_maxScale);
+	m_scale = m_maxScale;
+	m_lowestScale = m_scale;
+	m_highestScale = m_scale;
+}
+
+/***********************************************************
+ *  SetUpscaleFilter()
+ *
+ *  This method is used to choose between the bilinear blit
+ *  and the sharpening upscale pass.
+ ***********************************************************/
+void DynamicResolution::SetUpscaleFilter(int filter)
+{
+	m_upscaleFilter = filter;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used to adjust the scale from the timers
+ *  that have finished, to bind the render target with the
+ *  scaled viewport and to start the frame's GPU timer.
+ ***********************************************************/
+void DynamicResolution::BeginFrame()
+{
+	TRACE_SCOPE("DynamicResolution::BeginFrame");
+	if (m_framebufferID == 0)
+	{
+		return;
+	}
+
+	CollectTimers();
+	UpdateScale();
+
+	m_stats.scale = m_scale;
+	m_stats.renderWidth = std::max((int)(m_windowWidth * m_scale + 0.5f), 1);
+	m_stats.renderHeight = std::max((int)(m_windowHeight * m_scale + 0.5f), 1);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	glViewport(0, 0, m_stats.renderWidth, m_stats.renderHeight);
+
+	// a slot whose result has not come back yet is skipped, and
+	// that frame simply goes unmeasured
+	if (!m_bTimerPending[m_timerIndex])
+	{
+		glQueryCounter(m_timerQueryIDs[m_timerIndex][0], GL_TIMESTAMP);
+	}
+
+	m_frameCount++;
+	m_totalScale += m_scale;
+	m_lowestScale = std::min(m_lowestScale, m_scale);
+	m_highestScale = std::max(m_highestScale, m_scale);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used to stop the frame's GPU timer and to
+ *  upscale the rendered part of the target to the window.
+ ***********************************************************/
+void DynamicResolution::EndFrame()
+{
+	TRACE_SCOPE("DynamicResolution::EndFrame");
+	if (m_framebufferID == 0)
+	{
+		return;
+	}
+
+	if (!m_bTimerPending[m_timerIndex])
+	{
+		glQueryCounter(m_timerQueryIDs[m_timerIndex][1], GL_TIMESTAMP);
+		m_bTimerPending[m_timerIndex] = true;
+	}
+	m_timerIndex = (m_timerIndex + 1) % TIMER_FRAMES;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_windowWidth, m_windowHeight);
+
+	if ((m_upscaleFilter == UPSCALE_SHARPEN) && (NULL != m_pUpscaleShaderManager))
+	{
+		GLint previousProgram = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+		glDisable(GL_DEPTH_TEST);
+		glActiveTexture(GL_TEXTURE0 + UPSCALE_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_2D, m_colorTextureID);
+
+		m_pUpscaleShaderManager->use();
+		m_pUpscaleShaderManager->setIntValue("sourceTexture", UPSCALE_TEXTURE_UNIT);
+		m_pUpscaleShaderManager->setVec2Value("sourceScale",
+			(float)m_stats.renderWidth / m_windowWidth, (float)m_stats.renderHeight / m_windowHeight);
+		m_pUpscaleShaderManager->setVec2Value("sourceTexelSize",
+			1.0f / m_windowWidth, 1.0f / m_windowHeight);
+		m_pUpscaleShaderManager->setFloatValue("sharpness", SHARPNESS);
+
+		glBindVertexArray(m_vertexArrayID);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindVertexArray(0);
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glEnable(GL_DEPTH_TEST);
+		glUseProgram(previousProgram);
+	}
+	else
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferID);
+		glBlitFramebuffer(
+			0, 0, m_stats.renderWidth, m_stats.renderHeight,
+			0, 0, m_windowWidth, m_windowHeight,
+			GL_COLOR_BUFFER_BIT,
+			(m_scale < 1.0f) ? GL_LINEAR : GL_NEAREST);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	}
+}
+
+/***********************************************************
+ *  CollectTimers()
+ *
+ *  This method is used to add the GPU time of every frame
+ *  whose timestamps have come back to the moving average.
+ ***********************************************************/
+void DynamicResolution::CollectTimers()
+{
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		if (!m_bTimerPending[i])
+		{
+			continue;
+		}
+
+		GLint available = 0;
+		glGetQueryObjectiv(m_timerQueryIDs[i][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0)
+		{
+			continue;
+		}
+
+		GLuint64 startTime = 0;
+		GLuint64 endTime = 0;
+		glGetQueryObjectui64v(m_timerQueryIDs[i][0], GL_QUERY_RESULT, &startTime);
+		glGetQueryObjectui64v(m_timerQueryIDs[i][1], GL_QUERY_RESULT, &endTime);
+		m_bTimerPending[i] = false;
+
+		double frameTime = (double)(endTime - startTime) / 1000000.0;
+		if (m_stats.averageGpuMilliseconds == 0.0)
+		{
+			m_stats.averageGpuMilliseconds = frameTime;
+		}
+		else
+		{
+			m_stats.averageGpuMilliseconds += (frameTime - m_stats.averageGpuMilliseconds) * AVERAGE_WEIGHT;
+		}
+	}
+}
+
+/***********************************************************
+ *  UpdateScale()
+ *
+ *  This method is used to move the scale towards the budget.
+ *  The GPU time is taken to grow with the pixel count, so
+ *  the scale changes by the square root of the time ratio,
+ *  limited to one step, and only grows back once the time is
+ *  well below the budget so that it does not oscillate.
+ ***********************************************************/
+void DynamicResolution::UpdateScale()
+{
+	m_framesSinceChange++;
+	if ((m_framesSinceChange < FRAMES_PER_CHANGE) || (m_stats.averageGpuMilliseconds <= 0.0))
+	{
+		return;
+	}
+
+	double averageTime = m_stats.averageGpuMilliseconds;
+	float targetScale = m_scale;
+	if (averageTime > m_frameBudget)
+	{
+		targetScale = m_scale * (float)sqrt(m_frameBudget / averageTime);
+	}
+	else if (averageTime < m_frameBudget * SCALE_UP_THRESHOLD)
+	{
+		targetScale = m_scale * (float)sqrt(m_frameBudget * SCALE_UP_THRESHOLD / averageTime);
+	}
+
+	targetScale = std::min(std::max(targetScale, m_scale - MAX_SCALE_STEP), m_scale + MAX_SCALE_STEP);
+	targetScale = std::min(std::max(targetScale, m_minScale), m_maxScale);
+
+	// ignore changes of less than a percent
+	if (fabsf(targetScale - m_scale) >= 0.01f)
+	{
+		m_scale = targetScale;
+		m_framesSinceChange = 0;
+		m_stats.scaleChanges++;
+	}
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used to print the scales the scene was
+ *  rendered at and the measured GPU frame time.
+ ***********************************************************/
+void DynamicResolution::PrintStats() const
+{
+	if (m_frameCount == 0)
+	{
+		return;
+	}
+
+	std::cout << "INFO: Dynamic resolution statistics\n";
+	std::cout << "  frames: " << m_frameCount
+		<< ", budget " << m_frameBudget << " ms"
+		<< ", avg GPU " << m_stats.averageGpuMilliseconds << " ms\n";
+	std::cout << std::fixed << std::setprecision(2)
+		<< "  scale: current " << m_scale
+		<< ", avg " << (m_totalScale / m_frameCount)
+		<< ", min " << m_lowestScale
+		<< ", max " << m_highestScale
+		<< ", changes " << m_stats.scaleChanges << "\n";
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout << std::setprecision(6) << std::endl;
+}
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// dynamicresolution.h
+// ============
+// dynamic resolution scaling - the scene is rendered into an offscreen target
+// whose scale follows the measured GPU frame time against a budget, and the
+// result is upscaled to the window with a bilinear blit or a sharpening pass
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  DynamicResolution
+ *
+ *  This class owns the offscreen render target, the GPU
+ *  frame timers and the scale controller.
+ ***********************************************************/
+class DynamicResolution
+{
+public:
+	// how the rendered part of the target reaches the window
+	enum UPSCALE_FILTER
+	{
+		UPSCALE_BILINEAR = 0,	// glBlitFramebuffer with GL_LINEAR
+		UPSCALE_SHARPEN			// bilinear plus an unsharp mask
+	};
+
+	// scale and timing of the current frame, for the statistics
+	struct RESOLUTION_STATS
+	{
+		float scale;
+		int renderWidth;
+		int renderHeight;
+		// moving average of the measured GPU frame time
+		double averageGpuMilliseconds;
+		int scaleChanges;
+	};
+
+	// texture unit the target is sampled from while upscaling
+	static const int UPSCALE_TEXTURE_UNIT = 10;
+
+	// constructor
+	DynamicResolution();
+	// destructor
+	~DynamicResolution();
+
+	// create the target at the window's framebuffer size and load
+	// the upscale shaders - false leaves rendering to the window
+	bool Create(int windowWidth, int windowHeight);
+	void Destroy();
+
+	// GPU time the scale is adjusted towards
+	void SetFrameBudget(double milliseconds);
+	// range the scale is kept in, as a fraction of the window size
+	void SetScaleRange(float minScale, float maxScale);
+	void SetUpscaleFilter(int filter);
+
+	// read back the finished timers, adjust the scale and bind the
+	// target with a viewport of the scaled size
+	void BeginFrame();
+	// upscale the rendered part of the target to the window
+	void EndFrame();
+
+	float GetScale() const { return m_scale; }
+	const RESOLUTION_STATS& GetStats() const { return m_stats; }
+	// print the scale range used and the measured frame times
+	void PrintStats() const;
+
+private:
+	// timestamps around the scene, in a small ring so that the
+	// results are read back a few frames later without a stall
+	static const int TIMER_FRAMES = 4;
+
+	int m_windowWidth;
+	int m_windowHeight;
+	GLuint m_framebufferID;
+	GLuint m_colorTextureID;
+	GLuint m_depthRenderbufferID;
+	GLuint m_vertexArrayID;
+	ShaderManager* m_pUpscaleShaderManager;
+
+	GLuint m_timerQueryIDs[TIMER_FRAMES][2];
+	bool m_bTimerPending[TIMER_FRAMES];
+	int m_timerIndex;
+
+	double m_frameBudget;
+	float m_minScale;
+	float m_maxScale;
+	float m_scale;
+	int m_upscaleFilter;
+	int m_framesSinceChange;
+	RESOLUTION_STATS m_stats;
+
+	// totals over the run, for PrintStats()
+	int m_frameCount;
+	double m_totalScale;
+	float m_lowestScale;
+	float m_highestScale;
+
+	// add the finished frame timers to the moving average
+	void CollectTimers();
+	// move the scale towards the frame budget
+	void UpdateScale();
+};
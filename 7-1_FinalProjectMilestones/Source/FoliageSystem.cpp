@@ -0,0 +1,375 @@
+///////////////////////////////////////////////////////////////////////////////
+// foliagesystem.cpp
+// ============
+// procedural foliage for the vase plant - the flowers and puffs are generated
+// once from a seed and a density into an instance buffer, drawn with one
+// instanced draw per layer, and swayed by the scene vertex shader
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FoliageSystem.h"
+#include "MeshOptimizer.h"
+#include "TraceProfiler.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <random>
+
+// declaration of the global variables and defines
+namespace
+{
+	// resolution of the instanced sphere - the instances are small
+	// on screen, so a few hundred triangles are plenty
+	const int SPHERE_SLICES = 12;
+	const int SPHERE_STACKS = 8;
+	// position, normal and texture coordinate
+	const int FLOATS_PER_VERTEX = 8;
+
+	// the blossoms grow in clusters, in a dome that widens from the
+	// rim to the top of the branches
+	const int FLOWERS_PER_CLUSTER = 32;
+	const float FLOWER_MIN_HEIGHT = 1.0f;
+	const float FLOWER_MAX_HEIGHT = 2.8f;
+	const float FLOWER_CLUSTER_SPREAD = 0.18f;
+	const float FLOWER_SCALE = 0.05f;
+
+	// the puffs hang in a ring around the rim, pointing outwards
+	const float PUFF_MIN_RADIUS = 0.8f;
+	const float PUFF_MAX_RADIUS = 1.7f;
+	const float PUFF_MIN_HEIGHT = 0.3f;
+	const float PUFF_MAX_HEIGHT = 1.9f;
+	const float PUFF_SCALE = 0.12f;
+	const float PUFF_STRETCH = 3.2f;
+
+	// sway per unit of height above the rim
+	const float MIN_SWAY_AMPLITUDE = 0.03f;
+	const float MAX_SWAY_AMPLITUDE = 0.06f;
+}
+
+const float FoliageSystem::PLANT_RADIUS = 2.0f;
+const float FoliageSystem::PLANT_HEIGHT = 3.2f;
+
+/***********************************************************
+ *  FoliageSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FoliageSystem::FoliageSystem()
+{
+	m_vertexBufferID = 0;
+	m_indexBufferID = 0;
+	m_instanceBufferID = 0;
+	m_indexCount = 0;
+	for (int i = 0; i < LAYER_COUNT; i++)
+	{
+		m_vertexArrayIDs[i] = 0;
+		m_instanceCounts[i] = 0;
+	}
+	m_bSway = true;
+	m_startTime = TraceProfiler::NowMilliseconds();
+}
+
+/***********************************************************
+ *  ~FoliageSystem()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FoliageSystem::~FoliageSystem()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to generate the instances of every
+ *  layer and to create the mesh and instance buffers.  Both
+ *  layers share one instance buffer; each layer has its own
+ *  vertex array whose instance attributes start at the
+ *  layer's first instance, since the base instance draws
+ *  are not available on OpenGL 4.1.
+ ***********************************************************/
+bool FoliageSystem::Create(const FOLIAGE_PARAMS& params)
+{
+	Destroy();
+
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	std::vector<FOLIAGE_INSTANCE> instances;
+	GenerateInstances(params, instances);
+
+	CreateSphereMesh();
+
+	glGenBuffers(1, &m_instanceBufferID);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBufferID);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(FOLIAGE_INSTANCE), instances.data(), GL_STATIC_DRAW);
+
+	const GLsizei vertexStride = FLOATS_PER_VERTEX * sizeof(float);
+	size_t firstInstance = 0;
+	for (int layer = 0; layer < LAYER_COUNT; layer++)
+	{
+		glGenVertexArrays(1, &m_vertexArrayIDs[layer]);
+		glBindVertexArray(m_vertexArrayIDs[layer]);
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferID);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, vertexStride, (void*)(6 * sizeof(float)));
+
+		size_t layerOffset = firstInstance * sizeof(FOLIAGE_INSTANCE);
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceBufferID);
+		glEnableVertexAttribArray(INSTANCE_PLACEMENT_LOCATION);
+		glVertexAttribPointer(INSTANCE_PLACEMENT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(FOLIAGE_INSTANCE),
+			(void*)(layerOffset + offsetof(FOLIAGE_INSTANCE, placement)));
+		glVertexAttribDivisor(INSTANCE_PLACEMENT_LOCATION, 1);
+		glEnableVertexAttribArray(INSTANCE_SHAPE_LOCATION);
+		glVertexAttribPointer(INSTANCE_SHAPE_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(FOLIAGE_INSTANCE),
+			(void*)(layerOffset + offsetof(FOLIAGE_INSTANCE, shape)));
+		glVertexAttribDivisor(INSTANCE_SHAPE_LOCATION, 1);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferID);
+
+		firstInstance += m_instanceCounts[layer];
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	m_startTime = TraceProfiler::NowMilliseconds();
+
+	std::cout << "INFO: Foliage generated " << m_instanceCounts[LAYER_FLOWERS] << " flowers and "
+		<< m_instanceCounts[LAYER_PUFFS] << " puffs in " << (m_startTime - startTime) << " ms" << std::endl;
+
+	return(glGetError() == GL_NO_ERROR);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to free the mesh and instance
+ *  buffers.
+ ***********************************************************/
+void FoliageSystem::Destroy()
+{
+	for (int i = 0; i < LAYER_COUNT; i++)
+	{
+		if (m_vertexArrayIDs[i] != 0)
+		{
+			glDeleteVertexArrays(1, &m_vertexArrayIDs[i]);
+			m_vertexArrayIDs[i] = 0;
+		}
+		m_instanceCounts[i] = 0;
+	}
+
+	GLuint buffers[] = { m_vertexBufferID, m_indexBufferID, m_instanceBufferID };
+	if (m_vertexBufferID != 0)
+	{
+		glDeleteBuffers(3, buffers);
+	}
+	m_vertexBufferID = 0;
+	m_indexBufferID = 0;
+	m_instanceBufferID = 0;
+	m_indexCount = 0;
+}
+
+/***********************************************************
+ *  DrawLayer()
+ *
+ *  This method is used to draw all instances of one layer.
+ *  The caller has set the model transform of the plant and
+ *  turned on the instancing in the vertex shader.
+ ***********************************************************/
+void FoliageSystem::DrawLayer(int layer) const
+{
+	if ((layer < 0) || (layer >= LAYER_COUNT) || (m_vertexArrayIDs[layer] == 0) || (m_instanceCounts[layer] == 0))
+	{
+		return;
+	}
+
+	glBindVertexArray(m_vertexArrayIDs[layer]);
+	glDrawElementsInstanced(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_SHORT, (void*)0, m_instanceCounts[layer]);
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  GetInstanceCount()
+ *
+ *  This method is used to get the number of instances of
+ *  one layer.
+ ***********************************************************/
+int FoliageSystem::GetInstanceCount(int layer) const
+{
+	if ((layer < 0) || (layer >= LAYER_COUNT))
+	{
+		return(0);
+	}
+	return(m_instanceCounts[layer]);
+}
+
+/***********************************************************
+ *  GetSwayTime()
+ *
+ *  This method is used to get the animation time in seconds
+ *  since the foliage was created, or zero when the sway is
+ *  turned off.
+ ***********************************************************/
+float FoliageSystem::GetSwayTime() const
+{
+	if (m_bSway == false)
+	{
+		return(0.0f);
+	}
+	return((float)((TraceProfiler::NowMilliseconds() - m_startTime) / 1000.0));
+}
+
+/***********************************************************
+ *  CreateSphereMesh()
+ *
+ *  This method is used to build a unit sphere from stacks
+ *  and slices, with positions, normals and texture
+ *  coordinates interleaved like the basic meshes.  Every
+ *  instance transforms the whole mesh, so the triangles and
+ *  vertices are reordered for the vertex cache first.
+ ***********************************************************/
+void FoliageSystem::CreateSphereMesh()
+{
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+	vertices.reserve((SPHERE_STACKS + 1) * (SPHERE_SLICES + 1) * FLOATS_PER_VERTEX);
+	indices.reserve(SPHERE_STACKS * SPHERE_SLICES * 6);
+
+	for (int stack = 0; stack <= SPHERE_STACKS; stack++)
+	{
+		float v = (float)stack / SPHERE_STACKS;
+		float polar = v * glm::pi<float>();
+		for (int slice = 0; slice <= SPHERE_SLICES; slice++)
+		{
+			float u = (float)slice / SPHERE_SLICES;
+			float azimuth = u * glm::two_pi<float>();
+			glm::vec3 normal = glm::vec3(
+				std::sin(polar) * std::cos(azimuth),
+				std::cos(polar),
+				std::sin(polar) * std::sin(azimuth));
+
+			// the unit sphere's position is its normal
+			vertices.push_back(normal.x);
+			vertices.push_back(normal.y);
+			vertices.push_back(normal.z);
+			vertices.push_back(normal.x);
+			vertices.push_back(normal.y);
+			vertices.push_back(normal.z);
+			vertices.push_back(u);
+			vertices.push_back(1.0f - v);
+		}
+	}
+
+	const int rowLength = SPHERE_SLICES + 1;
+	for (int stack = 0; stack < SPHERE_STACKS; stack++)
+	{
+		for (int slice = 0; slice < SPHERE_SLICES; slice++)
+		{
+			unsigned int topLeft = stack * rowLength + slice;
+			unsigned int bottomLeft = topLeft + rowLength;
+
+			// counter clockwise seen from outside the sphere
+			indices.push_back(topLeft);
+			indices.push_back(topLeft + 1);
+			indices.push_back(bottomLeft);
+			indices.push_back(bottomLeft);
+			indices.push_back(topLeft + 1);
+			indices.push_back(bottomLeft + 1);
+		}
+	}
+
+	MeshOptimizer::OptimizeMesh("foliage sphere", indices, vertices, FLOATS_PER_VERTEX);
+	std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+	m_indexCount = (GLsizei)shortIndices.size();
+
+	glGenBuffers(1, &m_vertexBufferID);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferID);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_indexBufferID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBufferID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(GLushort), shortIndices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  GenerateInstances()
+ *
+ *  This method is used to place the flowers and the puffs.
+ *  The flowers are scattered around cluster centers in a
+ *  dome over the rim, and the puffs in a ring around it.
+ *  The instances shrink as the density grows, so that a
+ *  denser plant keeps about the same overall shape.
+ ***********************************************************/
+void FoliageSystem::GenerateInstances(
+	const FOLIAGE_PARAMS& params,
+	std::vector<FOLIAGE_INSTANCE>& instances)
+{
+	std::mt19937 generator(params.seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::normal_distribution<float> spread(0.0f, FLOWER_CLUSTER_SPREAD);
+
+	float density = std::max(params.density, 0.01f);
+	float sizeFactor = 1.0f / std::cbrt(std::max(density, 0.1f));
+
+	m_instanceCounts[LAYER_FLOWERS] = std::max((int)(FLOWER_COUNT * density + 0.5f), 1);
+	m_instanceCounts[LAYER_PUFFS] = std::max((int)(PUFF_COUNT * density + 0.5f), 1);
+	instances.clear();
+	instances.reserve(m_instanceCounts[LAYER_FLOWERS] + m_instanceCounts[LAYER_PUFFS]);
+
+	// flowers - the dome widens with the height above the rim
+	int clusterCount = std::max(m_instanceCounts[LAYER_FLOWERS] / FLOWERS_PER_CLUSTER, 1);
+	std::vector<glm::vec3> clusterCenters(clusterCount);
+	for (glm::vec3& center : clusterCenters)
+	{
+		float height = FLOWER_MIN_HEIGHT + unit(generator) * (FLOWER_MAX_HEIGHT - FLOWER_MIN_HEIGHT);
+		float maxRadius = 0.3f + 0.35f * (height - FLOWER_MIN_HEIGHT);
+		float radius = maxRadius * std::sqrt(unit(generator));
+		float angle = unit(generator) * glm::two_pi<float>();
+		center = glm::vec3(radius * std::cos(angle), height, radius * std::sin(angle));
+	}
+	for (int i = 0; i < m_instanceCounts[LAYER_FLOWERS]; i++)
+	{
+		const glm::vec3& center = clusterCenters[i % clusterCount];
+		glm::vec3 position = center + glm::vec3(spread(generator), spread(generator), spread(generator));
+		position.y = glm::clamp(position.y, FLOWER_MIN_HEIGHT - FLOWER_CLUSTER_SPREAD, FLOWER_MAX_HEIGHT + FLOWER_CLUSTER_SPREAD);
+
+		FOLIAGE_INSTANCE instance;
+		instance.placement = glm::vec4(position, FLOWER_SCALE * sizeFactor * (0.8f + 0.4f * unit(generator)));
+		instance.shape = glm::vec4(
+			1.0f,
+			unit(generator) * glm::two_pi<float>(),
+			unit(generator) * glm::two_pi<float>(),
+			MIN_SWAY_AMPLITUDE + unit(generator) * (MAX_SWAY_AMPLITUDE - MIN_SWAY_AMPLITUDE));
+		instances.push_back(instance);
+	}
+
+	// puffs - the long axis points away from the rim
+	for (int i = 0; i < m_instanceCounts[LAYER_PUFFS]; i++)
+	{
+		float angle = unit(generator) * glm::two_pi<float>();
+		float radius = PUFF_MIN_RADIUS + unit(generator) * (PUFF_MAX_RADIUS - PUFF_MIN_RADIUS);
+		float height = PUFF_MIN_HEIGHT + unit(generator) * (PUFF_MAX_HEIGHT - PUFF_MIN_HEIGHT);
+
+		FOLIAGE_INSTANCE instance;
+		instance.placement = glm::vec4(
+			radius * std::cos(angle),
+			height,
+			radius * std::sin(angle),
+			PUFF_SCALE * sizeFactor * (0.8f + 0.4f * unit(generator)));
+		instance.shape = glm::vec4(
+			PUFF_STRETCH,
+			glm::half_pi<float>() - angle,
+			unit(generator) * glm::two_pi<float>(),
+			MIN_SWAY_AMPLITUDE + unit(generator) * (MAX_SWAY_AMPLITUDE - MIN_SWAY_AMPLITUDE));
+		instances.push_back(instance);
+	}
+}
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// foliagesystem.h
+// ============
+// procedural foliage for the vase plant - the flowers and puffs are generated
+// once from a seed and a density into an instance buffer, drawn with one
+// instanced draw per layer, and swayed by the scene vertex shader
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  FoliageSystem
+ *
+ *  This class owns the instanced sphere mesh, the instance
+ *  buffer of every foliage layer and the sway clock.
+ ***********************************************************/
+class FoliageSystem
+{
+public:
+	// instance sets that are drawn with their own material
+	enum FOLIAGE_LAYER
+	{
+		LAYER_FLOWERS = 0,		// small blossoms in a dome over the rim
+		LAYER_PUFFS,			// elongated puffs in a ring around the rim
+		LAYER_COUNT
+	};
+
+	struct FOLIAGE_PARAMS
+	{
+		unsigned int seed;
+		// 1.0 generates FLOWER_COUNT flowers and PUFF_COUNT puffs
+		float density;
+	};
+
+	// instances generated at density 1.0
+	static const int FLOWER_COUNT = 1024;
+	static const int PUFF_COUNT = 256;
+
+	// extent of the plant above the vase rim, including the sway,
+	// for the bounding boxes of the foliage draws
+	static const float PLANT_RADIUS;
+	static const float PLANT_HEIGHT;
+
+	// instance attribute locations in the scene vertex shader
+	static const int INSTANCE_PLACEMENT_LOCATION = 3;
+	static const int INSTANCE_SHAPE_LOCATION = 4;
+
+	// constructor
+	FoliageSystem();
+	// destructor
+	~FoliageSystem();
+
+	// generate the instances and create the GL buffers
+	bool Create(const FOLIAGE_PARAMS& params);
+	// free the GL buffers
+	void Destroy();
+
+	// draw every instance of the layer, around the current model
+	// transform, with one instanced draw call
+	void DrawLayer(int layer) const;
+	int GetInstanceCount(int layer) const;
+
+	// enable or disable the sway animation - still foliage keeps
+	// the frames repeatable
+	void SetSway(bool bEnabled) { m_bSway = bEnabled; }
+	// seconds for the sway animation of the current frame
+	float GetSwayTime() const;
+
+private:
+	// per instance vertex attributes
+	struct FOLIAGE_INSTANCE
+	{
+		// offset from the plant origin and uniform scale
+		glm::vec4 placement;
+		// stretch along the local z axis, yaw in radians, sway
+		// phase and sway amplitude per unit of height
+		glm::vec4 shape;
+	};
+
+	GLuint m_vertexBufferID;
+	GLuint m_indexBufferID;
+	GLuint m_instanceBufferID;
+	GLuint m_vertexArrayIDs[LAYER_COUNT];
+	GLsizei m_indexCount;
+	int m_instanceCounts[LAYER_COUNT];
+	bool m_bSway;
+	double m_startTime;
+
+	// build a low polygon sphere with the vertex layout of the
+	// basic meshes
+	void CreateSphereMesh();
+	// place the instances of both layers
+	void GenerateInstances(
+		const FOLIAGE_PARAMS& params,
+		std::vector<FOLIAGE_INSTANCE>& instances);
+};
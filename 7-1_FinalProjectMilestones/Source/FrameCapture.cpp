@@ -0,0 +1,574 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.cpp
+// ============
+// non-blocking frame capture - the window is read back into a ring of pixel
+// buffer objects guarded by fences, mapped a few frames later, and written
+// out as PNG images or a raw Y4M video by background encoder threads
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameCapture.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// encoder threads for PNG output - Y4M always uses one
+	const int MAX_PNG_WORKERS = 4;
+	// frame rate written into the Y4M header
+	const int Y4M_FRAME_RATE = 60;
+	// longest wait for a readback when the capture is finished
+	const GLuint64 FINISH_TIMEOUT_NS = 1000000000;
+
+	/***********************************************************
+	 *  Crc32()
+	 *
+	 *  CRC of a PNG chunk, continued from the passed in value.
+	 ***********************************************************/
+	unsigned int Crc32(unsigned int crc, const unsigned char* pData, size_t size)
+	{
+		static unsigned int table[256];
+		static bool bTableReady = false;
+		if (!bTableReady)
+		{
+			for (unsigned int n = 0; n < 256; n++)
+			{
+				unsigned int c = n;
+				for (int k = 0; k < 8; k++)
+				{
+					c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+				}
+				table[n] = c;
+			}
+			bTableReady = true;
+		}
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = table[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return(~crc);
+	}
+
+	/***********************************************************
+	 *  PutBigEndian()
+	 *
+	 *  Append a 32 bit value in PNG byte order.
+	 ***********************************************************/
+	void PutBigEndian(std::vector<unsigned char>& bytes, unsigned int value)
+	{
+		bytes.push_back((unsigned char)(value >> 24));
+		bytes.push_back((unsigned char)(value >> 16));
+		bytes.push_back((unsigned char)(value >> 8));
+		bytes.push_back((unsigned char)value);
+	}
+
+	/***********************************************************
+	 *  WriteChunk()
+	 *
+	 *  Write one PNG chunk with its length and CRC.
+	 ***********************************************************/
+	void WriteChunk(FILE* pFile, const char* type, const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> header;
+		PutBigEndian(header, (unsigned int)data.size());
+		header.insert(header.end(), type, type + 4);
+
+		unsigned int crc = Crc32(0, (const unsigned char*)type, 4);
+		crc = Crc32(crc, data.data(), data.size());
+		std::vector<unsigned char> footer;
+		PutBigEndian(footer, crc);
+
+		fwrite(header.data(), 1, header.size(), pFile);
+		if (!data.empty())
+		{
+			fwrite(data.data(), 1, data.size(), pFile);
+		}
+		fwrite(footer.data(), 1, footer.size(), pFile);
+	}
+}
+
+/***********************************************************
+ *  FrameCapture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameCapture::FrameCapture()
+{
+	m_width = 0;
+	m_height = 0;
+	m_format = CAPTURE_PNG;
+	m_maxFrames = 0;
+	m_bActive = false;
+	for (int i = 0; i < READBACK_RING_SIZE; i++)
+	{
+		m_slots[i].bufferID = 0;
+		m_slots[i].fence = NULL;
+		m_slots[i].frameIndex = 0;
+	}
+	m_nextSlot = 0;
+	m_frameIndex = 0;
+	m_bStopWorkers = false;
+	m_pVideoFile = NULL;
+	m_capturedFrames = 0;
+	m_droppedFrames = 0;
+	m_writtenFrames = 0;
+	m_totalCaptureMs = 0.0;
+	m_maxCaptureMs = 0.0;
+	m_measuredFrames = 0;
+}
+
+/***********************************************************
+ *  ~FrameCapture()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameCapture::~FrameCapture()
+{
+	Finish();
+
+	for (size_t i = 0; i < m_freeJobs.size(); i++)
+	{
+		delete m_freeJobs[i];
+	}
+	m_freeJobs.clear();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to create the pixel buffer ring and
+ *  to start the encoder threads.  The Y4M stream is opened
+ *  here, so that a bad output path is reported right away.
+ ***********************************************************/
+bool FrameCapture::Create(int width, int height, int format, const char* outputPrefix, int maxFrames)
+{
+	m_width = width;
+	m_height = height;
+	m_format = format;
+	m_outputPrefix = outputPrefix;
+	m_maxFrames = maxFrames;
+
+	if (m_format == CAPTURE_Y4M)
+	{
+		std::string filename = m_outputPrefix + ".y4m";
+		m_pVideoFile = fopen(filename.c_str(), "wb");
+		if (NULL == m_pVideoFile)
+		{
+			std::cerr << "ERROR: Could not open the capture file: " << filename << std::endl;
+			return(false);
+		}
+		// the chroma planes are subsampled, so the size is even
+		fprintf(m_pVideoFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+			m_width & ~1, m_height & ~1, Y4M_FRAME_RATE);
+	}
+
+	size_t frameBytes = (size_t)m_width * m_height * 4;
+	for (int i = 0; i < READBACK_RING_SIZE; i++)
+	{
+		glGenBuffers(1, &m_slots[i].bufferID);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_slots[i].bufferID);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	int workerCount = 1;
+	if (m_format == CAPTURE_PNG)
+	{
+		workerCount = std::max(1, std::min((int)std::thread::hardware_concurrency() - 1, MAX_PNG_WORKERS));
+	}
+	for (int i = 0; i < workerCount; i++)
+	{
+		m_workers.push_back(std::thread(&FrameCapture::WorkerMain, this));
+	}
+
+	m_bActive = true;
+	std::cout << "INFO: Capturing " << m_width << "x" << m_height << " frames to " << m_outputPrefix
+		<< ((m_format == CAPTURE_Y4M) ? ".y4m" : "_*.png") << " with " << workerCount << " encoder threads" << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used to stop capturing.  The readbacks in
+ *  flight are waited for and queued, and the encoders write
+ *  every queued frame before they stop.
+ ***********************************************************/
+void FrameCapture::Finish()
+{
+	if (m_bActive)
+	{
+		for (int i = 0; i < READBACK_RING_SIZE; i++)
+		{
+			READBACK_SLOT& slot = m_slots[(m_nextSlot + i) % READBACK_RING_SIZE];
+			if (slot.fence != NULL)
+			{
+				glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FINISH_TIMEOUT_NS);
+				CollectSlot(slot);
+			}
+		}
+		m_bActive = false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopWorkers = true;
+	}
+	m_condition.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+
+	for (int i = 0; i < READBACK_RING_SIZE; i++)
+	{
+		if (m_slots[i].bufferID != 0)
+		{
+			glDeleteBuffers(1, &m_slots[i].bufferID);
+			m_slots[i].bufferID = 0;
+		}
+	}
+
+	if (NULL != m_pVideoFile)
+	{
+		fclose(m_pVideoFile);
+		m_pVideoFile = NULL;
+	}
+}
+
+/***********************************************************
+ *  CaptureFrame()
+ *
+ *  This method is used to queue the readback of the frame in
+ *  the back buffer into the next pixel buffer.  glReadPixels
+ *  into a buffer object returns at once; the copy runs on
+ *  the GPU after the frame, and the fence tells when it has
+ *  finished.  Slots whose fence has signaled are mapped and
+ *  handed to the encoders, without waiting on the others.
+ ***********************************************************/
+void FrameCapture::CaptureFrame()
+{
+	TRACE_SCOPE("CaptureFrame");
+	if (!m_bActive)
+	{
+		return;
+	}
+
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	// collect the finished readbacks, oldest first
+	for (int i = 0; i < READBACK_RING_SIZE; i++)
+	{
+		READBACK_SLOT& slot = m_slots[(m_nextSlot + i) % READBACK_RING_SIZE];
+		if (slot.fence == NULL)
+		{
+			continue;
+		}
+		GLenum waitResult = glClientWaitSync(slot.fence, 0, 0);
+		if ((waitResult != GL_ALREADY_SIGNALED) && (waitResult != GL_CONDITION_SATISFIED))
+		{
+			break;
+		}
+		CollectSlot(slot);
+	}
+
+	READBACK_SLOT& slot = m_slots[m_nextSlot];
+	if ((m_maxFrames > 0) && (m_frameIndex >= m_maxFrames))
+	{
+		// every requested frame has been read back
+	}
+	else if (slot.fence != NULL)
+	{
+		// the whole ring is still in flight - this frame is dropped
+		// rather than stalling on the oldest readback
+		m_droppedFrames++;
+		m_frameIndex++;
+	}
+	else
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.bufferID);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadBuffer(GL_BACK);
+		glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.frameIndex = m_frameIndex++;
+		m_nextSlot = (m_nextSlot + 1) % READBACK_RING_SIZE;
+		m_capturedFrames++;
+	}
+
+	// the readback and the copies out of the mapped buffers are
+	// all the capture adds to the frame
+	double captureTime = TraceProfiler::NowMilliseconds() - startTime;
+	m_totalCaptureMs += captureTime;
+	m_maxCaptureMs = std::max(m_maxCaptureMs, captureTime);
+	m_measuredFrames++;
+}
+
+/***********************************************************
+ *  CollectSlot()
+ *
+ *  This method is used to copy a finished readback out of
+ *  its pixel buffer into an encode job.  When the encoders
+ *  are too far behind the frame is dropped instead.
+ ***********************************************************/
+void FrameCapture::CollectSlot(READBACK_SLOT& slot)
+{
+	glDeleteSync(slot.fence);
+	slot.fence = NULL;
+
+	ENCODE_JOB* pJob = NULL;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if ((int)m_jobQueue.size() >= MAX_QUEUED_FRAMES)
+		{
+			m_droppedFrames++;
+			return;
+		}
+		if (!m_freeJobs.empty())
+		{
+			pJob = m_freeJobs.back();
+			m_freeJobs.pop_back();
+		}
+	}
+	if (NULL == pJob)
+	{
+		pJob = new ENCODE_JOB();
+	}
+
+	size_t frameBytes = (size_t)m_width * m_height * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.bufferID);
+	const unsigned char* pPixels = (const unsigned char*)glMapBufferRange(
+		GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+	if (NULL != pPixels)
+	{
+		pJob->frameIndex = slot.frameIndex;
+		pJob->pixels.assign(pPixels, pPixels + frameBytes);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (NULL == pPixels)
+	{
+		m_freeJobs.push_back(pJob);
+		m_droppedFrames++;
+		return;
+	}
+	m_jobQueue.push_back(pJob);
+	m_condition.notify_one();
+}
+
+/***********************************************************
+ *  WorkerMain()
+ *
+ *  This method is the body of the encoder threads.  Jobs are
+ *  taken in order, so the single Y4M encoder writes the
+ *  frames in the order they were captured.
+ ***********************************************************/
+void FrameCapture::WorkerMain()
+{
+	TRACE_THREAD_NAME("frame encoder");
+	while (true)
+	{
+		ENCODE_JOB* pJob = NULL;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_bStopWorkers || !m_jobQueue.empty(); });
+			if (m_jobQueue.empty())
+			{
+				return;
+			}
+			pJob = m_jobQueue.front();
+			m_jobQueue.pop_front();
+		}
+
+		if (m_format == CAPTURE_Y4M)
+		{
+			WriteY4mFrame(pJob);
+		}
+		else
+		{
+			WritePng(pJob);
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_freeJobs.push_back(pJob);
+		m_writtenFrames++;
+	}
+}
+
+/***********************************************************
+ *  WritePng()
+ *
+ *  This method is used to write one frame as an RGB PNG.
+ *  The image data is stored without compression, which
+ *  keeps the encoder cheap enough to follow the frame rate;
+ *  the rows are flipped since GL reads bottom up.
+ ***********************************************************/
+void FrameCapture::WritePng(const ENCODE_JOB* pJob)
+{
+	TRACE_SCOPE("EncodePng");
+	char filename[512];
+	snprintf(filename, sizeof(filename), "%s_%05d.png", m_outputPrefix.c_str(), pJob->frameIndex);
+
+	FILE* pFile = fopen(filename, "wb");
+	if (NULL == pFile)
+	{
+		std::cerr << "ERROR: Could not write the capture file: " << filename << std::endl;
+		return;
+	}
+
+	static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	fwrite(signature, 1, sizeof(signature), pFile);
+
+	std::vector<unsigned char> header;
+	PutBigEndian(header, (unsigned int)m_width);
+	PutBigEndian(header, (unsigned int)m_height);
+	header.push_back(8);	// bit depth
+	header.push_back(2);	// RGB
+	header.push_back(0);	// deflate
+	header.push_back(0);	// adaptive filtering
+	header.push_back(0);	// no interlace
+	WriteChunk(pFile, "IHDR", header);
+
+	// filter type 0 scanlines, top row first
+	size_t rowBytes = (size_t)m_width * 3 + 1;
+	std::vector<unsigned char> scanlines(rowBytes * m_height);
+	for (int y = 0; y < m_height; y++)
+	{
+		const unsigned char* pSource = pJob->pixels.data() + (size_t)(m_height - 1 - y) * m_width * 4;
+		unsigned char* pDest = scanlines.data() + y * rowBytes;
+		*pDest++ = 0;
+		for (int x = 0; x < m_width; x++)
+		{
+			*pDest++ = pSource[x * 4 + 0];
+			*pDest++ = pSource[x * 4 + 1];
+			*pDest++ = pSource[x * 4 + 2];
+		}
+	}
+
+	// zlib stream of stored deflate blocks
+	std::vector<unsigned char> zlibData;
+	zlibData.reserve(scanlines.size() + scanlines.size() / 65535 * 5 + 16);
+	zlibData.push_back(0x78);
+	zlibData.push_back(0x01);
+	size_t offset = 0;
+	do
+	{
+		size_t blockSize = std::min(scanlines.size() - offset, (size_t)65535);
+		bool bFinal = (offset + blockSize == scanlines.size());
+		zlibData.push_back(bFinal ? 1 : 0);
+		zlibData.push_back((unsigned char)(blockSize & 0xFF));
+		zlibData.push_back((unsigned char)(blockSize >> 8));
+		zlibData.push_back((unsigned char)(~blockSize & 0xFF));
+		zlibData.push_back((unsigned char)((~blockSize >> 8) & 0xFF));
+		zlibData.insert(zlibData.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+		offset += blockSize;
+	} while (offset < scanlines.size());
+
+	unsigned int adlerA = 1;
+	unsigned int adlerB = 0;
+	for (size_t i = 0; i < scanlines.size(); i++)
+	{
+		adlerA = (adlerA + scanlines[i]) % 65521;
+		adlerB = (adlerB + adlerA) % 65521;
+	}
+	PutBigEndian(zlibData, (adlerB << 16) | adlerA);
+
+	WriteChunk(pFile, "IDAT", zlibData);
+	WriteChunk(pFile, "IEND", std::vector<unsigned char>());
+	fclose(pFile);
+}
+
+/***********************************************************
+ *  WriteY4mFrame()
+ *
+ *  This method is used to append one frame to the Y4M
+ *  stream, converted to full range BT.601 4:2:0, which is
+ *  what the C420jpeg header announces.
+ ***********************************************************/
+void FrameCapture::WriteY4mFrame(const ENCODE_JOB* pJob)
+{
+	TRACE_SCOPE("EncodeY4mFrame");
+	int width = m_width & ~1;
+	int height = m_height & ~1;
+	std::vector<unsigned char> planes((size_t)width * height * 3 / 2);
+	unsigned char* pLuma = planes.data();
+	unsigned char* pBlue = pLuma + (size_t)width * height;
+	unsigned char* pRed = pBlue + (size_t)(width / 2) * (height / 2);
+
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* pSource = pJob->pixels.data() + (size_t)(m_height - 1 - y) * m_width * 4;
+		for (int x = 0; x < width; x++)
+		{
+			const unsigned char* p = pSource + x * 4;
+			pLuma[y * width + x] = (unsigned char)std::min(255.0f,
+				0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] + 0.5f);
+		}
+	}
+
+	for (int y = 0; y < height / 2; y++)
+	{
+		for (int x = 0; x < width / 2; x++)
+		{
+			float r = 0.0f;
+			float g = 0.0f;
+			float b = 0.0f;
+			for (int dy = 0; dy < 2; dy++)
+			{
+				const unsigned char* pSource = pJob->pixels.data()
+					+ ((size_t)(m_height - 1 - (y * 2 + dy)) * m_width + x * 2) * 4;
+				r += pSource[0] + pSource[4];
+				g += pSource[1] + pSource[5];
+				b += pSource[2] + pSource[6];
+			}
+			r *= 0.25f;
+			g *= 0.25f;
+			b *= 0.25f;
+			float cb = 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b;
+			float cr = 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b;
+			pBlue[y * (width / 2) + x] = (unsigned char)std::min(std::max(cb + 0.5f, 0.0f), 255.0f);
+			pRed[y * (width / 2) + x] = (unsigned char)std::min(std::max(cr + 0.5f, 0.0f), 255.0f);
+		}
+	}
+
+	fputs("FRAME\n", m_pVideoFile);
+	fwrite(planes.data(), 1, planes.size(), m_pVideoFile);
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used to print how many frames were
+ *  captured and written, and the frame time they cost.
+ ***********************************************************/
+void FrameCapture::PrintStats() const
+{
+	if (m_capturedFrames + m_droppedFrames == 0)
+	{
+		return;
+	}
+
+	std::cout << "INFO: Frame capture statistics\n";
+	std::cout << "  frames: captured " << m_capturedFrames
+		<< ", written " << m_writtenFrames
+		<< ", dropped " << m_droppedFrames << "\n";
+	if (m_measuredFrames > 0)
+	{
+		std::cout << "  frame time: avg " << (m_totalCaptureMs / m_measuredFrames)
+			<< " ms, max " << m_maxCaptureMs << " ms\n";
+	}
+	std::cout << std::endl;
+}
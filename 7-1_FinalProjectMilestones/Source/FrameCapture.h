@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.h
+// ============
+// non-blocking frame capture - the window is read back into a ring of pixel
+// buffer objects guarded by fences, mapped a few frames later, and written
+// out as PNG images or a raw Y4M video by background encoder threads
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  FrameCapture
+ *
+ *  This class owns the readback buffers, their fences and
+ *  the encoder threads.
+ ***********************************************************/
+class FrameCapture
+{
+public:
+	enum CAPTURE_FORMAT
+	{
+		CAPTURE_PNG = 0,		// one image per frame
+		CAPTURE_Y4M				// one 4:2:0 video stream
+	};
+
+	// constructor
+	FrameCapture();
+	// destructor
+	~FrameCapture();
+
+	// create the readback ring for the window size and start the
+	// encoders; the frames are written to <outputPrefix>_NNNNN.png
+	// or <outputPrefix>.y4m, and maxFrames 0 captures until exit
+	bool Create(int width, int height, int format, const char* outputPrefix, int maxFrames);
+	// wait for the outstanding readbacks and encodes
+	void Finish();
+
+	// start the readback of the finished frame in the back buffer
+	// and hand the readbacks that have completed to the encoders;
+	// called after the frame is drawn, before the buffer swap
+	void CaptureFrame();
+
+	bool IsActive() const { return m_bActive; }
+	// print the captured and dropped frames and the frame time
+	// that the capture cost
+	void PrintStats() const;
+
+private:
+	// frames between a readback and its mapping - enough for the
+	// copy to have finished without the CPU waiting on it
+	static const int READBACK_RING_SIZE = 3;
+	// frames waiting for an encoder before new ones are dropped
+	static const int MAX_QUEUED_FRAMES = 16;
+
+	struct READBACK_SLOT
+	{
+		GLuint bufferID;
+		GLsync fence;
+		int frameIndex;
+	};
+
+	struct ENCODE_JOB
+	{
+		int frameIndex;
+		std::vector<unsigned char> pixels;
+	};
+
+	int m_width;
+	int m_height;
+	int m_format;
+	std::string m_outputPrefix;
+	int m_maxFrames;
+	bool m_bActive;
+
+	READBACK_SLOT m_slots[READBACK_RING_SIZE];
+	int m_nextSlot;
+	int m_frameIndex;
+
+	// encoder threads and the frames they still have to write
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<ENCODE_JOB*> m_jobQueue;
+	// pixel buffers returned by the encoders for reuse
+	std::vector<ENCODE_JOB*> m_freeJobs;
+	bool m_bStopWorkers;
+	// the Y4M stream is written by a single encoder in order
+	FILE* m_pVideoFile;
+
+	// statistics
+	int m_capturedFrames;
+	int m_droppedFrames;
+	int m_writtenFrames;
+	double m_totalCaptureMs;
+	double m_maxCaptureMs;
+	int m_measuredFrames;
+
+	void WorkerMain();
+	// map the slot's buffer and queue a copy of it for encoding
+	void CollectSlot(READBACK_SLOT& slot);
+	void WritePng(const ENCODE_JOB* pJob);
+	void WriteY4mFrame(const ENCODE_JOB* pJob);
+};
@@ -0,0 +1,1235 @@
+///////////////////////////////////////////////////////////////////////////////
+// glcapture.cpp
+// ============
+// GL command stream capture - records the GL calls of a few frames, with
+// their arguments, buffer contents and snapshots of the objects they use,
+// into a binary trace for the standalone replayer (GLTraceReplay)
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLCapture.h"
+#include "GLTraceFormat.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef ENABLE_GL_CAPTURE
+
+#include <GL/glew.h>
+
+// the hooks below call the driver entry points that the forced
+// include routes to them
+#undef glDrawArrays
+#undef glDrawElements
+#undef glBindTexture
+#undef glEnable
+#undef glDisable
+#undef glDepthFunc
+#undef glDepthMask
+#undef glColorMask
+#undef glBlendFunc
+#undef glCullFace
+#undef glViewport
+#undef glClearColor
+#undef glClear
+
+// declaration of the global variables and defines
+namespace
+{
+	enum CAPTURE_STATE
+	{
+		CAPTURE_OFF = 0,
+		CAPTURE_WAITING,		// hooks installed, skipping frames
+		CAPTURE_RECORDING
+	};
+
+	// texture units whose bindings are part of the initial state
+	const int CAPTURED_TEXTURE_UNITS = 16;
+
+	int g_captureState = CAPTURE_OFF;
+	std::string g_filename;
+	int g_framesToSkip = 0;
+	int g_framesToCapture = 0;
+	int g_skippedFrames = 0;
+	int g_capturedFrames = 0;
+	int g_windowWidth = 0;
+	int g_windowHeight = 0;
+	size_t g_commandCount = 0;
+
+	// the recorded commands, written out when the capture ends
+	std::vector<unsigned char> g_trace;
+
+	// objects that already have a snapshot in the trace
+	std::unordered_set<GLuint> g_capturedPrograms;
+	std::unordered_set<GLuint> g_capturedBuffers;
+	std::unordered_set<GLuint> g_capturedVertexArrays;
+	std::unordered_set<GLuint> g_capturedTextures;
+
+	// format and buffer of every buffer texture created while the
+	// hooks are installed - core GL 4.1 cannot query them back
+	struct TEXTURE_BUFFER_INFO
+	{
+		GLenum internalFormat;
+		GLuint buffer;
+	};
+	std::unordered_map<GLuint, TEXTURE_BUFFER_INFO> g_textureBuffers;
+
+	// the GLEW entry points replaced by the hooks
+	PFNGLUSEPROGRAMPROC g_pUseProgram = NULL;
+	PFNGLBINDVERTEXARRAYPROC g_pBindVertexArray = NULL;
+	PFNGLACTIVETEXTUREPROC g_pActiveTexture = NULL;
+	PFNGLBINDBUFFERPROC g_pBindBuffer = NULL;
+	PFNGLBUFFERDATAPROC g_pBufferData = NULL;
+	PFNGLBUFFERSUBDATAPROC g_pBufferSubData = NULL;
+	PFNGLTEXBUFFERPROC g_pTexBuffer = NULL;
+	PFNGLGETUNIFORMLOCATIONPROC g_pGetUniformLocation = NULL;
+	PFNGLUNIFORM1IPROC g_pUniform1i = NULL;
+	PFNGLUNIFORM1FPROC g_pUniform1f = NULL;
+	PFNGLUNIFORM2FPROC g_pUniform2f = NULL;
+	PFNGLUNIFORM3FPROC g_pUniform3f = NULL;
+	PFNGLUNIFORM4FPROC g_pUniform4f = NULL;
+	PFNGLUNIFORM2FVPROC g_pUniform2fv = NULL;
+	PFNGLUNIFORM3FVPROC g_pUniform3fv = NULL;
+	PFNGLUNIFORM4FVPROC g_pUniform4fv = NULL;
+	PFNGLUNIFORMMATRIX4FVPROC g_pUniformMatrix4fv = NULL;
+	PFNGLDRAWARRAYSINSTANCEDPROC g_pDrawArraysInstanced = NULL;
+	PFNGLDRAWELEMENTSINSTANCEDPROC g_pDrawElementsInstanced = NULL;
+
+	bool IsRecording()
+	{
+		return(g_captureState == CAPTURE_RECORDING);
+	}
+
+	/***********************************************************
+	 *  WriteBytes(), Write(), WriteString()
+	 *
+	 *  Append packed fields to the trace.
+	 ***********************************************************/
+	void WriteBytes(const void* pData, size_t size)
+	{
+		const unsigned char* pBytes = (const unsigned char*)pData;
+		g_trace.insert(g_trace.end(), pBytes, pBytes + size);
+	}
+
+	template<typename T>
+	void Write(T value)
+	{
+		WriteBytes(&value, sizeof(T));
+	}
+
+	void WriteString(const char* text)
+	{
+		uint32_t length = (uint32_t)strlen(text);
+		Write<uint32_t>(length);
+		WriteBytes(text, length);
+	}
+
+	/***********************************************************
+	 *  BeginCommand(), EndCommand()
+	 *
+	 *  Start a command and patch its payload size once the
+	 *  payload has been written.
+	 ***********************************************************/
+	size_t BeginCommand(int command)
+	{
+		Write<uint16_t>((uint16_t)command);
+		size_t sizePosition = g_trace.size();
+		Write<uint32_t>(0);
+		g_commandCount++;
+		return(sizePosition);
+	}
+
+	void EndCommand(size_t sizePosition)
+	{
+		uint32_t payloadSize = (uint32_t)(g_trace.size() - sizePosition - sizeof(uint32_t));
+		memcpy(&g_trace[sizePosition], &payloadSize, sizeof(payloadSize));
+	}
+
+	// a command with one 32 bit argument
+	void RecordValue(int command, uint32_t value)
+	{
+		size_t sizePosition = BeginCommand(command);
+		Write<uint32_t>(value);
+		EndCommand(sizePosition);
+	}
+
+	void RecordUniformFloats(int command, GLint location, GLsizei count, int components, const GLfloat* pValues)
+	{
+		size_t sizePosition = BeginCommand(command);
+		Write<int32_t>(location);
+		Write<uint32_t>((uint32_t)count);
+		WriteBytes(pValues, sizeof(GLfloat) * components * count);
+		EndCommand(sizePosition);
+	}
+
+	/***********************************************************
+	 *  CaptureBuffer()
+	 *
+	 *  Snapshot the size and contents of a buffer the first
+	 *  time a recorded call references it.
+	 ***********************************************************/
+	void CaptureBuffer(GLuint buffer)
+	{
+		if ((buffer == 0) || (g_capturedBuffers.count(buffer) != 0))
+		{
+			return;
+		}
+		g_capturedBuffers.insert(buffer);
+
+		GLint previousBuffer = 0;
+		glGetIntegerv(GL_COPY_READ_BUFFER_BINDING, &previousBuffer);
+		g_pBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		GLint size = 0;
+		glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+		std::vector<unsigned char> contents(size);
+		if (size > 0)
+		{
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, contents.data());
+		}
+		g_pBindBuffer(GL_COPY_READ_BUFFER, previousBuffer);
+
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_CREATE_BUFFER);
+		Write<uint32_t>(buffer);
+		Write<uint32_t>((uint32_t)size);
+		WriteBytes(contents.data(), contents.size());
+		EndCommand(sizePosition);
+	}
+
+	/***********************************************************
+	 *  CaptureVertexArray()
+	 *
+	 *  Snapshot the element buffer and the enabled attributes
+	 *  of the bound vertex array, after the buffers they read.
+	 ***********************************************************/
+	void CaptureVertexArray(GLuint vertexArray)
+	{
+		if ((vertexArray == 0) || (g_capturedVertexArrays.count(vertexArray) != 0))
+		{
+			return;
+		}
+		g_capturedVertexArrays.insert(vertexArray);
+
+		struct VERTEX_ATTRIBUTE
+		{
+			GLint index;
+			GLint buffer;
+			GLint size;
+			GLint type;
+			GLint normalized;
+			GLint integer;
+			GLint stride;
+			GLint divisor;
+			uint64_t offset;
+		};
+
+		GLint maxAttributes = 0;
+		glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxAttributes);
+		std::vector<VERTEX_ATTRIBUTE> attributes;
+		for (GLint i = 0; i < maxAttributes; i++)
+		{
+			GLint bEnabled = 0;
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &bEnabled);
+			if (bEnabled == 0)
+			{
+				continue;
+			}
+
+			VERTEX_ATTRIBUTE attribute;
+			attribute.index = i;
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &attribute.buffer);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_SIZE, &attribute.size);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_TYPE, &attribute.type);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &attribute.normalized);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &attribute.integer);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &attribute.stride);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_DIVISOR, &attribute.divisor);
+			void* pOffset = NULL;
+			glGetVertexAttribPointerv(i, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pOffset);
+			attribute.offset = (uint64_t)(uintptr_t)pOffset;
+			attributes.push_back(attribute);
+		}
+
+		GLint elementBuffer = 0;
+		glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+		CaptureBuffer(elementBuffer);
+		for (const VERTEX_ATTRIBUTE& attribute : attributes)
+		{
+			CaptureBuffer(attribute.buffer);
+		}
+
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_CREATE_VERTEX_ARRAY);
+		Write<uint32_t>(vertexArray);
+		Write<uint32_t>(elementBuffer);
+		Write<uint32_t>((uint32_t)attributes.size());
+		for (const VERTEX_ATTRIBUTE& attribute : attributes)
+		{
+			Write<uint32_t>(attribute.index);
+			Write<uint32_t>(attribute.buffer);
+			Write<int32_t>(attribute.size);
+			Write<uint32_t>(attribute.type);
+			Write<uint8_t>((uint8_t)attribute.normalized);
+			Write<uint8_t>((uint8_t)attribute.integer);
+			Write<int32_t>(attribute.stride);
+			Write<uint32_t>(attribute.divisor);
+			Write<uint64_t>(attribute.offset);
+		}
+		EndCommand(sizePosition);
+	}
+
+	/***********************************************************
+	 *  GetUniformComponents()
+	 *
+	 *  Number of values of a uniform type whose value is part
+	 *  of the program snapshot, 0 for the other types.
+	 ***********************************************************/
+	int GetUniformComponents(GLenum type, bool& bInteger)
+	{
+		bInteger = false;
+		switch (type)
+		{
+		case GL_FLOAT:
+			return(1);
+		case GL_FLOAT_VEC2:
+			return(2);
+		case GL_FLOAT_VEC3:
+			return(3);
+		case GL_FLOAT_VEC4:
+			return(4);
+		case GL_FLOAT_MAT4:
+			return(16);
+		case GL_INT:
+		case GL_BOOL:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_BUFFER:
+		case GL_INT_SAMPLER_BUFFER:
+		case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+			bInteger = true;
+			return(1);
+		}
+		return(0);
+	}
+
+	/***********************************************************
+	 *  CaptureProgram()
+	 *
+	 *  Snapshot the shader sources of a program and the value
+	 *  of every active uniform, so that the uniforms set before
+	 *  the capture are restored by the replay.
+	 ***********************************************************/
+	void CaptureProgram(GLuint program)
+	{
+		if ((program == 0) || (g_capturedPrograms.count(program) != 0))
+		{
+			return;
+		}
+		g_capturedPrograms.insert(program);
+
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_CREATE_PROGRAM);
+		Write<uint32_t>(program);
+
+		GLuint shaders[8];
+		GLsizei shaderCount = 0;
+		glGetAttachedShaders(program, 8, &shaderCount, shaders);
+		if (shaderCount == 0)
+		{
+			std::cout << "WARNING: GL capture found no shaders attached to program " << program << std::endl;
+		}
+		Write<uint32_t>((uint32_t)shaderCount);
+		for (GLsizei i = 0; i < shaderCount; i++)
+		{
+			GLint shaderType = 0;
+			GLint sourceLength = 0;
+			glGetShaderiv(shaders[i], GL_SHADER_TYPE, &shaderType);
+			glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &sourceLength);
+			std::vector<GLchar> source(sourceLength + 1, '\0');
+			if (sourceLength > 0)
+			{
+				glGetShaderSource(shaders[i], sourceLength, NULL, source.data());
+			}
+			Write<uint32_t>(shaderType);
+			WriteString(source.data());
+		}
+
+		// the uniform count is patched after the array elements
+		// have been expanded
+		size_t countPosition = g_trace.size();
+		Write<uint32_t>(0);
+		uint32_t uniformCount = 0;
+
+		GLint activeUniforms = 0;
+		glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &activeUniforms);
+		for (GLint i = 0; i < activeUniforms; i++)
+		{
+			GLchar name[256];
+			GLsizei nameLength = 0;
+			GLint arraySize = 0;
+			GLenum type = 0;
+			glGetActiveUniform(program, i, sizeof(name), &nameLength, &arraySize, &type, name);
+
+			std::string baseName(name, nameLength);
+			if ((baseName.size() > 3) && (baseName.compare(baseName.size() - 3, 3, "[0]") == 0))
+			{
+				baseName.resize(baseName.size() - 3);
+			}
+
+			bool bInteger = false;
+			int components = GetUniformComponents(type, bInteger);
+			for (GLint element = 0; element < arraySize; element++)
+			{
+				std::string elementName = baseName;
+				if (arraySize > 1)
+				{
+					elementName += "[" + std::to_string(element) + "]";
+				}
+				GLint location = g_pGetUniformLocation(program, elementName.c_str());
+				if (location < 0)
+				{
+					continue;
+				}
+
+				Write<int32_t>(location);
+				WriteString(elementName.c_str());
+				Write<uint8_t>(bInteger ? 1 : 0);
+				Write<uint32_t>((uint32_t)components);
+				if (bInteger == true)
+				{
+					GLint values[16];
+					glGetUniformiv(program, location, values);
+					WriteBytes(values, sizeof(GLint) * components);
+				}
+				else if (components > 0)
+				{
+					GLfloat values[16];
+					glGetUniformfv(program, location, values);
+					WriteBytes(values, sizeof(GLfloat) * components);
+				}
+				uniformCount++;
+			}
+		}
+		memcpy(&g_trace[countPosition], &uniformCount, sizeof(uniformCount));
+		EndCommand(sizePosition);
+	}
+
+	/***********************************************************
+	 *  CaptureTexture()
+	 *
+	 *  Snapshot the size, format and sampler state of a 2D
+	 *  texture and the contents of its level 0, or the format
+	 *  and buffer of a buffer texture.  The texture has to be
+	 *  bound to the active unit.
+	 ***********************************************************/
+	void CaptureTexture(GLenum target, GLuint texture)
+	{
+		if ((texture == 0) || (g_capturedTextures.count(texture) != 0))
+		{
+			return;
+		}
+
+		GLint width = 0;
+		GLint height = 0;
+		GLint internalFormat = 0;
+		GLint levelOneWidth = 0;
+		GLint sampler[6] = { GL_LINEAR, GL_LINEAR, GL_REPEAT, GL_REPEAT, GL_NONE, GL_LEQUAL };
+		GLuint buffer = 0;
+		bool bDepth = false;
+		std::vector<unsigned char> contents;
+
+		if (target == GL_TEXTURE_2D)
+		{
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 1, GL_TEXTURE_WIDTH, &levelOneWidth);
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &sampler[0]);
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, &sampler[1]);
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &sampler[2]);
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, &sampler[3]);
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, &sampler[4]);
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, &sampler[5]);
+
+			bDepth = (internalFormat == GL_DEPTH_COMPONENT) || (internalFormat == GL_DEPTH_COMPONENT16)
+				|| (internalFormat == GL_DEPTH_COMPONENT24) || (internalFormat == GL_DEPTH_COMPONENT32F)
+				|| (internalFormat == GL_DEPTH24_STENCIL8);
+			// depth targets are rendered by the replay itself, so only
+			// the color textures carry their contents
+			if ((bDepth == false) && (width > 0) && (height > 0))
+			{
+				contents.resize((size_t)width * height * 4);
+				glPixelStorei(GL_PACK_ALIGNMENT, 1);
+				glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, contents.data());
+				glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			}
+		}
+		else if (target == GL_TEXTURE_BUFFER)
+		{
+			std::unordered_map<GLuint, TEXTURE_BUFFER_INFO>::const_iterator found = g_textureBuffers.find(texture);
+			if (found == g_textureBuffers.end())
+			{
+				std::cout << "WARNING: GL capture has no format for buffer texture " << texture << std::endl;
+				return;
+			}
+			internalFormat = found->second.internalFormat;
+			buffer = found->second.buffer;
+			CaptureBuffer(buffer);
+		}
+		else
+		{
+			// other targets are not used by the scene
+			return;
+		}
+		g_capturedTextures.insert(texture);
+
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_CREATE_TEXTURE);
+		Write<uint32_t>(texture);
+		Write<uint32_t>(target);
+		Write<int32_t>(width);
+		Write<int32_t>(height);
+		Write<uint32_t>(internalFormat);
+		Write<uint8_t>(bDepth ? 1 : 0);
+		Write<uint8_t>((levelOneWidth > 0) ? 1 : 0);
+		WriteBytes(sampler, sizeof(sampler));
+		Write<uint32_t>(buffer);
+		Write<uint32_t>((uint32_t)contents.size());
+		WriteBytes(contents.data(), contents.size());
+		EndCommand(sizePosition);
+	}
+
+	void RecordBindTexture(GLenum target, GLuint texture)
+	{
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_BIND_TEXTURE);
+		Write<uint32_t>(target);
+		Write<uint32_t>(texture);
+		EndCommand(sizePosition);
+	}
+
+	void RecordDepthMask(GLboolean flag)
+	{
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_DEPTH_MASK);
+		Write<uint8_t>(flag);
+		EndCommand(sizePosition);
+	}
+
+	void RecordColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+	{
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_COLOR_MASK);
+		Write<uint8_t>(red);
+		Write<uint8_t>(green);
+		Write<uint8_t>(blue);
+		Write<uint8_t>(alpha);
+		EndCommand(sizePosition);
+	}
+
+	void RecordBlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+	{
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_BLEND_FUNC);
+		Write<uint32_t>(sourceFactor);
+		Write<uint32_t>(destinationFactor);
+		EndCommand(sizePosition);
+	}
+
+	void RecordViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_VIEWPORT);
+		Write<int32_t>(x);
+		Write<int32_t>(y);
+		Write<int32_t>(width);
+		Write<int32_t>(height);
+		EndCommand(sizePosition);
+	}
+
+	void RecordClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+	{
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_CLEAR_COLOR);
+		Write<float>(red);
+		Write<float>(green);
+		Write<float>(blue);
+		Write<float>(alpha);
+		EndCommand(sizePosition);
+	}
+
+	/***********************************************************
+	 *  CaptureInitialState()
+	 *
+	 *  Record the state that the first captured frame inherits
+	 *  from the frames before it - the bound program, vertex
+	 *  array and textures, and the fixed function state.
+	 ***********************************************************/
+	void CaptureInitialState()
+	{
+		GLint program = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+		CaptureProgram(program);
+		RecordValue(GLTraceFormat::CMD_USE_PROGRAM, program);
+
+		GLint vertexArray = 0;
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertexArray);
+		CaptureVertexArray(vertexArray);
+		RecordValue(GLTraceFormat::CMD_BIND_VERTEX_ARRAY, vertexArray);
+
+		GLint activeTexture = GL_TEXTURE0;
+		glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+		for (int unit = 0; unit < CAPTURED_TEXTURE_UNITS; unit++)
+		{
+			g_pActiveTexture(GL_TEXTURE0 + unit);
+			RecordValue(GLTraceFormat::CMD_ACTIVE_TEXTURE, GL_TEXTURE0 + unit);
+
+			GLint texture = 0;
+			glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+			if (texture != 0)
+			{
+				CaptureTexture(GL_TEXTURE_2D, texture);
+				RecordBindTexture(GL_TEXTURE_2D, texture);
+			}
+			glGetIntegerv(GL_TEXTURE_BINDING_BUFFER, &texture);
+			if (texture != 0)
+			{
+				CaptureTexture(GL_TEXTURE_BUFFER, texture);
+				RecordBindTexture(GL_TEXTURE_BUFFER, texture);
+			}
+		}
+		g_pActiveTexture(activeTexture);
+		RecordValue(GLTraceFormat::CMD_ACTIVE_TEXTURE, activeTexture);
+
+		const GLenum capabilities[3] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE };
+		for (int i = 0; i < 3; i++)
+		{
+			RecordValue(glIsEnabled(capabilities[i]) ? GLTraceFormat::CMD_ENABLE : GLTraceFormat::CMD_DISABLE, capabilities[i]);
+		}
+
+		GLint value = 0;
+		glGetIntegerv(GL_DEPTH_FUNC, &value);
+		RecordValue(GLTraceFormat::CMD_DEPTH_FUNC, value);
+		glGetIntegerv(GL_CULL_FACE_MODE, &value);
+		RecordValue(GLTraceFormat::CMD_CULL_FACE, value);
+
+		GLboolean depthMask = GL_TRUE;
+		glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+		RecordDepthMask(depthMask);
+		GLboolean colorMask[4] = { GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE };
+		glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+		RecordColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+
+		GLint sourceFactor = GL_ONE;
+		GLint destinationFactor = GL_ZERO;
+		glGetIntegerv(GL_BLEND_SRC_RGB, &sourceFactor);
+		glGetIntegerv(GL_BLEND_DST_RGB, &destinationFactor);
+		RecordBlendFunc(sourceFactor, destinationFactor);
+
+		GLint viewport[4] = { 0, 0, 0, 0 };
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		RecordViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+		RecordClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+	}
+
+	/***********************************************************
+	 *  Hook*()
+	 *
+	 *  The replacements of the GLEW entry points - every hook
+	 *  calls the driver first and then records the call while
+	 *  a frame is being captured.
+	 ***********************************************************/
+	void GLAPIENTRY HookUseProgram(GLuint program)
+	{
+		g_pUseProgram(program);
+		if (IsRecording())
+		{
+			CaptureProgram(program);
+			RecordValue(GLTraceFormat::CMD_USE_PROGRAM, program);
+		}
+	}
+
+	void GLAPIENTRY HookBindVertexArray(GLuint vertexArray)
+	{
+		g_pBindVertexArray(vertexArray);
+		if (IsRecording())
+		{
+			CaptureVertexArray(vertexArray);
+			RecordValue(GLTraceFormat::CMD_BIND_VERTEX_ARRAY, vertexArray);
+		}
+	}
+
+	void GLAPIENTRY HookActiveTexture(GLenum texture)
+	{
+		g_pActiveTexture(texture);
+		if (IsRecording())
+		{
+			RecordValue(GLTraceFormat::CMD_ACTIVE_TEXTURE, texture);
+		}
+	}
+
+	void GLAPIENTRY HookBindBuffer(GLenum target, GLuint buffer)
+	{
+		g_pBindBuffer(target, buffer);
+		if (IsRecording())
+		{
+			CaptureBuffer(buffer);
+			size_t sizePosition = BeginCommand(GLTraceFormat::CMD_BIND_BUFFER);
+			Write<uint32_t>(target);
+			Write<uint32_t>(buffer);
+			EndCommand(sizePosition);
+		}
+	}
+
+	void GLAPIENTRY HookBufferData(GLenum target, GLsizeiptr size, const void* pData, GLenum usage)
+	{
+		g_pBufferData(target, size, pData, usage);
+		if (IsRecording())
+		{
+			size_t sizePosition = BeginCommand(GLTraceFormat::CMD_BUFFER_DATA);
+			Write<uint32_t>(target);
+			Write<uint32_t>((uint32_t)size);
+			Write<uint32_t>(usage);
+			Write<uint8_t>((NULL != pData) ? 1 : 0);
+			if (NULL != pData)
+			{
+				WriteBytes(pData, (size_t)size);
+			}
+			EndCommand(sizePosition);
+		}
+	}
+
+	void GLAPIENTRY HookBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* pData)
+	{
+		g_pBufferSubData(target, offset, size, pData);
+		if (IsRecording())
+		{
+			size_t sizePosition = BeginCommand(GLTraceFormat::CMD_BUFFER_SUB_DATA);
+			Write<uint32_t>(target);
+			Write<uint32_t>((uint32_t)offset);
+			Write<uint32_t>((uint32_t)size);
+			WriteBytes(pData, (size_t)size);
+			EndCommand(sizePosition);
+		}
+	}
+
+	void GLAPIENTRY HookTexBuffer(GLenum target, GLenum internalFormat, GLuint buffer)
+	{
+		g_pTexBuffer(target, internalFormat, buffer);
+
+		GLint texture = 0;
+		glGetIntegerv(GL_TEXTURE_BINDING_BUFFER, &texture);
+		TEXTURE_BUFFER_INFO info;
+		info.internalFormat = internalFormat;
+		info.buffer = buffer;
+		g_textureBuffers[texture] = info;
+	}
+
+	GLint GLAPIENTRY HookGetUniformLocation(GLuint program, const GLchar* name)
+	{
+		GLint location = g_pGetUniformLocation(program, name);
+		if (IsRecording())
+		{
+			CaptureProgram(program);
+			size_t sizePosition = BeginCommand(GLTraceFormat::CMD_GET_UNIFORM_LOCATION);
+			Write<uint32_t>(program);
+			WriteString(name);
+			EndCommand(sizePosition);
+		}
+		return(location);
+	}
+
+	void GLAPIENTRY HookUniform1i(GLint location, GLint value)
+	{
+		g_pUniform1i(location, value);
+		if (IsRecording())
+		{
+			size_t sizePosition = BeginCommand(GLTraceFormat::CMD_UNIFORM_1I);
+			Write<int32_t>(location);
+			Write<int32_t>(value);
+			EndCommand(sizePosition);
+		}
+	}
+
+	void GLAPIENTRY HookUniform1f(GLint location, GLfloat value)
+	{
+		g_pUniform1f(location, value);
+		if (IsRecording())
+		{
+			RecordUniformFloats(GLTraceFormat::CMD_UNIFORM_1F, location, 1, 1, &value);
+		}
+	}
+
+	void GLAPIENTRY HookUniform2f(GLint location, GLfloat x, GLfloat y)
+	{
+		g_pUniform2f(location, x, y);
+		if (IsRecording())
+		{
+			GLfloat values[2] = { x, y };
+			RecordUniformFloats(GLTraceFormat::CMD_UNIFORM_2F, location, 1, 2, values);
+		}
+	}
+
+	void GLAPIENTRY HookUniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z)
+	{
+		g_pUniform3f(location, x, y, z);
+		if (IsRecording())
+		{
+			GLfloat values[3] = { x, y, z };
+			RecordUniformFloats(GLTraceFormat::CMD_UNIFORM_3F, location, 1, 3, values);
+		}
+	}
+
+	void GLAPIENTRY HookUniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+	{
+		g_pUniform4f(location, x, y, z, w);
+		if (IsRecording())
+		{
+			GLfloat values[4] = { x, y, z, w };
+			RecordUniformFloats(GLTraceFormat::CMD_UNIFORM_4F, location, 1, 4, values);
+		}
+	}
+
+	void GLAPIENTRY HookUniform2fv(GLint location, GLsizei count, const GLfloat* pValues)
+	{
+		g_pUniform2fv(location, count, pValues);
+		if (IsRecording())
+		{
+			RecordUniformFloats(GLTraceFormat::CMD_UNIFORM_2F, location, count, 2, pValues);
+		}
+	}
+
+	void GLAPIENTRY HookUniform3fv(GLint location, GLsizei count, const GLfloat* pValues)
+	{
+		g_pUniform3fv(location, count, pValues);
+		if (IsRecording())
+		{
+			RecordUniformFloats(GLTraceFormat::CMD_UNIFORM_3F, location, count, 3, pValues);
+		}
+	}
+
+	void GLAPIENTRY HookUniform4fv(GLint location, GLsizei count, const GLfloat* pValues)
+	{
+		g_pUniform4fv(location, count, pValues);
+		if (IsRecording())
+		{
+			RecordUniformFloats(GLTraceFormat::CMD_UNIFORM_4F, location, count, 4, pValues);
+		}
+	}
+
+	void GLAPIENTRY HookUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* pValues)
+	{
+		g_pUniformMatrix4fv(location, count, transpose, pValues);
+		if (IsRecording())
+		{
+			// the replay uploads the matrices untransposed
+			std::vector<GLfloat> values(pValues, pValues + 16 * count);
+			if (transpose == GL_TRUE)
+			{
+				for (GLsizei m = 0; m < count; m++)
+				{
+					for (int row = 0; row < 4; row++)
+					{
+						for (int column = 0; column < 4; column++)
+						{
+							values[m * 16 + column * 4 + row] = pValues[m * 16 + row * 4 + column];
+						}
+					}
+				}
+			}
+			RecordUniformFloats(GLTraceFormat::CMD_UNIFORM_MATRIX_4F, location, count, 16, values.data());
+		}
+	}
+
+	void GLAPIENTRY HookDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount)
+	{
+		g_pDrawArraysInstanced(mode, first, count, instanceCount);
+		if (IsRecording())
+		{
+			size_t sizePosition = BeginCommand(GLTraceFormat::CMD_DRAW_ARRAYS_INSTANCED);
+			Write<uint32_t>(mode);
+			Write<int32_t>(first);
+			Write<int32_t>(count);
+			Write<int32_t>(instanceCount);
+			EndCommand(sizePosition);
+		}
+	}
+
+	void GLAPIENTRY HookDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* pIndices, GLsizei instanceCount)
+	{
+		g_pDrawElementsInstanced(mode, count, type, pIndices, instanceCount);
+		if (IsRecording())
+		{
+			size_t sizePosition = BeginCommand(GLTraceFormat::CMD_DRAW_ELEMENTS_INSTANCED);
+			Write<uint32_t>(mode);
+			Write<int32_t>(count);
+			Write<uint32_t>(type);
+			Write<uint64_t>((uint64_t)(uintptr_t)pIndices);
+			Write<int32_t>(instanceCount);
+			EndCommand(sizePosition);
+		}
+	}
+
+	/***********************************************************
+	 *  InstallHooks(), RemoveHooks()
+	 *
+	 *  Swap the GLEW function pointers with the hooks, and put
+	 *  the driver entry points back once the trace is written.
+	 ***********************************************************/
+	void InstallHooks()
+	{
+		g_pUseProgram = __glewUseProgram;
+		g_pBindVertexArray = __glewBindVertexArray;
+		g_pActiveTexture = __glewActiveTexture;
+		g_pBindBuffer = __glewBindBuffer;
+		g_pBufferData = __glewBufferData;
+		g_pBufferSubData = __glewBufferSubData;
+		g_pTexBuffer = __glewTexBuffer;
+		g_pGetUniformLocation = __glewGetUniformLocation;
+		g_pUniform1i = __glewUniform1i;
+		g_pUniform1f = __glewUniform1f;
+		g_pUniform2f = __glewUniform2f;
+		g_pUniform3f = __glewUniform3f;
+		g_pUniform4f = __glewUniform4f;
+		g_pUniform2fv = __glewUniform2fv;
+		g_pUniform3fv = __glewUniform3fv;
+		g_pUniform4fv = __glewUniform4fv;
+		g_pUniformMatrix4fv = __glewUniformMatrix4fv;
+		g_pDrawArraysInstanced = __glewDrawArraysInstanced;
+		g_pDrawElementsInstanced = __glewDrawElementsInstanced;
+
+		__glewUseProgram = HookUseProgram;
+		__glewBindVertexArray = HookBindVertexArray;
+		__glewActiveTexture = HookActiveTexture;
+		__glewBindBuffer = HookBindBuffer;
+		__glewBufferData = HookBufferData;
+		__glewBufferSubData = HookBufferSubData;
+		__glewTexBuffer = HookTexBuffer;
+		__glewGetUniformLocation = HookGetUniformLocation;
+		__glewUniform1i = HookUniform1i;
+		__glewUniform1f = HookUniform1f;
+		__glewUniform2f = HookUniform2f;
+		__glewUniform3f = HookUniform3f;
+		__glewUniform4f = HookUniform4f;
+		__glewUniform2fv = HookUniform2fv;
+		__glewUniform3fv = HookUniform3fv;
+		__glewUniform4fv = HookUniform4fv;
+		__glewUniformMatrix4fv = HookUniformMatrix4fv;
+		__glewDrawArraysInstanced = HookDrawArraysInstanced;
+		__glewDrawElementsInstanced = HookDrawElementsInstanced;
+	}
+
+	void RemoveHooks()
+	{
+		__glewUseProgram = g_pUseProgram;
+		__glewBindVertexArray = g_pBindVertexArray;
+		__glewActiveTexture = g_pActiveTexture;
+		__glewBindBuffer = g_pBindBuffer;
+		__glewBufferData = g_pBufferData;
+		__glewBufferSubData = g_pBufferSubData;
+		__glewTexBuffer = g_pTexBuffer;
+		__glewGetUniformLocation = g_pGetUniformLocation;
+		__glewUniform1i = g_pUniform1i;
+		__glewUniform1f = g_pUniform1f;
+		__glewUniform2f = g_pUniform2f;
+		__glewUniform3f = g_pUniform3f;
+		__glewUniform4f = g_pUniform4f;
+		__glewUniform2fv = g_pUniform2fv;
+		__glewUniform3fv = g_pUniform3fv;
+		__glewUniform4fv = g_pUniform4fv;
+		__glewUniformMatrix4fv = g_pUniformMatrix4fv;
+		__glewDrawArraysInstanced = g_pDrawArraysInstanced;
+		__glewDrawElementsInstanced = g_pDrawElementsInstanced;
+	}
+
+	/***********************************************************
+	 *  WriteTrace()
+	 *
+	 *  Write the header and the recorded commands, and free the
+	 *  capture buffers.
+	 ***********************************************************/
+	void WriteTrace()
+	{
+		FILE* pFile = fopen(g_filename.c_str(), "wb");
+		if (NULL == pFile)
+		{
+			std::cerr << "ERROR: Could not write the GL trace: " << g_filename << std::endl;
+		}
+		else
+		{
+			GLTraceFormat::TRACE_HEADER header;
+			header.magic = GLTraceFormat::TRACE_MAGIC;
+			header.version = GLTraceFormat::TRACE_VERSION;
+			header.frameCount = (uint32_t)g_capturedFrames;
+			header.windowWidth = g_windowWidth;
+			header.windowHeight = g_windowHeight;
+			fwrite(&header, sizeof(header), 1, pFile);
+			fwrite(g_trace.data(), 1, g_trace.size(), pFile);
+			fclose(pFile);
+
+			std::cout << "INFO: Wrote " << g_commandCount << " GL commands of " << g_capturedFrames
+				<< " frames (" << (g_trace.size() + 1023) / 1024 << " KB) to " << g_filename << std::endl;
+		}
+
+		std::vector<unsigned char>().swap(g_trace);
+		g_capturedPrograms.clear();
+		g_capturedBuffers.clear();
+		g_capturedVertexArrays.clear();
+		g_capturedTextures.clear();
+	}
+
+	/***********************************************************
+	 *  BeginRecording()
+	 *
+	 *  Start recording with the state the frame inherits.
+	 ***********************************************************/
+	void BeginRecording()
+	{
+		g_captureState = CAPTURE_RECORDING;
+		CaptureInitialState();
+	}
+}
+
+/***********************************************************
+ *  GLCapture_*()
+ *
+ *  The GL 1.1 entry points, routed here by GLCaptureHooks.h.
+ ***********************************************************/
+void GLAPIENTRY GLCapture_DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	glDrawArrays(mode, first, count);
+	if (IsRecording())
+	{
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_DRAW_ARRAYS);
+		Write<uint32_t>(mode);
+		Write<int32_t>(first);
+		Write<int32_t>(count);
+		EndCommand(sizePosition);
+	}
+}
+
+void GLAPIENTRY GLCapture_DrawElements(GLenum mode, GLsizei count, GLenum type, const void* pIndices)
+{
+	glDrawElements(mode, count, type, pIndices);
+	if (IsRecording())
+	{
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_DRAW_ELEMENTS);
+		Write<uint32_t>(mode);
+		Write<int32_t>(count);
+		Write<uint32_t>(type);
+		Write<uint64_t>((uint64_t)(uintptr_t)pIndices);
+		EndCommand(sizePosition);
+	}
+}
+
+void GLAPIENTRY GLCapture_BindTexture(GLenum target, GLuint texture)
+{
+	glBindTexture(target, texture);
+	if (IsRecording())
+	{
+		CaptureTexture(target, texture);
+		RecordBindTexture(target, texture);
+	}
+}
+
+void GLAPIENTRY GLCapture_Enable(GLenum capability)
+{
+	glEnable(capability);
+	if (IsRecording())
+	{
+		RecordValue(GLTraceFormat::CMD_ENABLE, capability);
+	}
+}
+
+void GLAPIENTRY GLCapture_Disable(GLenum capability)
+{
+	glDisable(capability);
+	if (IsRecording())
+	{
+		RecordValue(GLTraceFormat::CMD_DISABLE, capability);
+	}
+}
+
+void GLAPIENTRY GLCapture_DepthFunc(GLenum function)
+{
+	glDepthFunc(function);
+	if (IsRecording())
+	{
+		RecordValue(GLTraceFormat::CMD_DEPTH_FUNC, function);
+	}
+}
+
+void GLAPIENTRY GLCapture_DepthMask(GLboolean flag)
+{
+	glDepthMask(flag);
+	if (IsRecording())
+	{
+		RecordDepthMask(flag);
+	}
+}
+
+void GLAPIENTRY GLCapture_ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+	glColorMask(red, green, blue, alpha);
+	if (IsRecording())
+	{
+		RecordColorMask(red, green, blue, alpha);
+	}
+}
+
+void GLAPIENTRY GLCapture_BlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+	glBlendFunc(sourceFactor, destinationFactor);
+	if (IsRecording())
+	{
+		RecordBlendFunc(sourceFactor, destinationFactor);
+	}
+}
+
+void GLAPIENTRY GLCapture_CullFace(GLenum mode)
+{
+	glCullFace(mode);
+	if (IsRecording())
+	{
+		RecordValue(GLTraceFormat::CMD_CULL_FACE, mode);
+	}
+}
+
+void GLAPIENTRY GLCapture_Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	glViewport(x, y, width, height);
+	if (IsRecording())
+	{
+		RecordViewport(x, y, width, height);
+	}
+}
+
+void GLAPIENTRY GLCapture_ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	glClearColor(red, green, blue, alpha);
+	if (IsRecording())
+	{
+		RecordClearColor(red, green, blue, alpha);
+	}
+}
+
+void GLAPIENTRY GLCapture_Clear(GLbitfield mask)
+{
+	glClear(mask);
+	if (IsRecording())
+	{
+		RecordValue(GLTraceFormat::CMD_CLEAR, mask);
+	}
+}
+
+/***********************************************************
+ *  IsEnabled()
+ *
+ *  The capture was compiled into this build.
+ ***********************************************************/
+bool GLCapture::IsEnabled()
+{
+	return(true);
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  Install the hooks and record the frames after the skipped
+ *  ones.  The hooks go in right after GLEW is initialized,
+ *  so that the buffer textures created by the scene are seen.
+ ***********************************************************/
+bool GLCapture::Start(
+	const char* filename,
+	int frameCount,
+	int skipFrames,
+	int windowWidth,
+	int windowHeight)
+{
+	if (g_captureState != CAPTURE_OFF)
+	{
+		return(false);
+	}
+
+	g_filename = filename;
+	g_framesToCapture = (frameCount > 0) ? frameCount : 1;
+	g_framesToSkip = (skipFrames > 0) ? skipFrames : 0;
+	g_skippedFrames = 0;
+	g_capturedFrames = 0;
+	g_windowWidth = windowWidth;
+	g_windowHeight = windowHeight;
+	g_commandCount = 0;
+
+	InstallHooks();
+	g_captureState = CAPTURE_WAITING;
+	if (g_framesToSkip == 0)
+	{
+		BeginRecording();
+	}
+
+	std::cout << "INFO: Capturing " << g_framesToCapture << " frames of GL calls to " << g_filename
+		<< " after " << g_framesToSkip << " frames" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  IsCapturing()
+ *
+ *  A frame is being recorded.
+ ***********************************************************/
+bool GLCapture::IsCapturing()
+{
+	return(IsRecording());
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  Count the skipped frames, mark the end of a recorded one
+ *  and write the trace after the last one.
+ ***********************************************************/
+void GLCapture::EndFrame()
+{
+	if (g_captureState == CAPTURE_WAITING)
+	{
+		g_skippedFrames++;
+		if (g_skippedFrames >= g_framesToSkip)
+		{
+			BeginRecording();
+		}
+	}
+	else if (g_captureState == CAPTURE_RECORDING)
+	{
+		size_t sizePosition = BeginCommand(GLTraceFormat::CMD_FRAME_END);
+		EndCommand(sizePosition);
+		g_capturedFrames++;
+
+		if (g_capturedFrames >= g_framesToCapture)
+		{
+			g_captureState = CAPTURE_OFF;
+			RemoveHooks();
+			WriteTrace();
+		}
+	}
+}
+
+#else
+
+bool GLCapture::IsEnabled()
+{
+	return(false);
+}
+
+bool GLCapture::Start(const char*, int, int, int, int)
+{
+	std::cout << "WARNING: GL capture is not compiled in, define ENABLE_GL_CAPTURE to use it" << std::endl;
+	return(false);
+}
+
+bool GLCapture::IsCapturing()
+{
+	return(false);
+}
+
+void GLCapture::EndFrame()
+{
+}
+
+#endif
@@ -0,0 +1,37 @@
+///////////////////////////////////////////////////////////////////////////////
+// glcapture.h
+// ============
+// GL command stream capture - records the GL calls of a few frames, with
+// their arguments, buffer contents and snapshots of the objects they use,
+// into a binary trace for the standalone replayer (GLTraceReplay)
+//
+//  The capture is only compiled in when the ENABLE_GL_CAPTURE preprocessor
+//  symbol is defined in the project settings, together with GLCaptureHooks.h
+//  as a forced include.  Without it Start() only reports that the capture
+//  is not available.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+namespace GLCapture
+{
+	// true when the capture was compiled into the application
+	bool IsEnabled();
+
+	// capture frameCount frames into the file, after skipping the
+	// passed in number of frames so that the streamed textures and
+	// the shadow map have settled; the framebuffer size is stored
+	// for the replay window
+	bool Start(
+		const char* filename,
+		int frameCount,
+		int skipFrames,
+		int windowWidth,
+		int windowHeight);
+	// true while the calls of a frame are being recorded
+	bool IsCapturing();
+
+	// mark the end of a frame, after the buffer swap - the trace is
+	// written when the last captured frame ends
+	void EndFrame();
+}
@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+// glcapturehooks.h
+// ============
+// GL command capture hooks for the GL 1.1 entry points - GLEW loads the newer
+// entry points through function pointers that the capture can replace, but
+// the GL 1.1 ones are linked directly, so their calls are routed to the
+// capture by name
+//
+//  The project includes this header in front of every source file (Forced
+//  Include File), so that the calls in ShapeMeshes and ShaderManager are
+//  routed as well.  Without the ENABLE_GL_CAPTURE preprocessor symbol it
+//  is empty and every call goes straight to the driver.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#ifdef ENABLE_GL_CAPTURE
+
+#include <GL/glew.h>
+
+void GLAPIENTRY GLCapture_DrawArrays(GLenum mode, GLint first, GLsizei count);
+void GLAPIENTRY GLCapture_DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+void GLAPIENTRY GLCapture_BindTexture(GLenum target, GLuint texture);
+void GLAPIENTRY GLCapture_Enable(GLenum capability);
+void GLAPIENTRY GLCapture_Disable(GLenum capability);
+void GLAPIENTRY GLCapture_DepthFunc(GLenum function);
+void GLAPIENTRY GLCapture_DepthMask(GLboolean flag);
+void GLAPIENTRY GLCapture_ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+void GLAPIENTRY GLCapture_BlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+void GLAPIENTRY GLCapture_CullFace(GLenum mode);
+void GLAPIENTRY GLCapture_Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void GLAPIENTRY GLCapture_ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+void GLAPIENTRY GLCapture_Clear(GLbitfield mask);
+
+#define glDrawArrays GLCapture_DrawArrays
+#define glDrawElements GLCapture_DrawElements
+#define glBindTexture GLCapture_BindTexture
+#define glEnable GLCapture_Enable
+#define glDisable GLCapture_Disable
+#define glDepthFunc GLCapture_DepthFunc
+#define glDepthMask GLCapture_DepthMask
+#define glColorMask GLCapture_ColorMask
+#define glBlendFunc GLCapture_BlendFunc
+#define glCullFace GLCapture_CullFace
+#define glViewport GLCapture_Viewport
+#define glClearColor GLCapture_ClearColor
+#define glClear GLCapture_Clear
+
+#endif
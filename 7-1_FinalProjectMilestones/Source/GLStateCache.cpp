@@ -0,0 +1,477 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.cpp
+// ============
+// shadowed GL state - remembers the bound program, the active texture unit,
+// the 2D texture of every unit, a few capabilities, the depth function, the
+// depth and color write masks and the last value of every uniform set
+// through it, and drops the calls that would not change anything
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLStateCache.h"
+
+#include "ShaderManager.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+
+// declaration of the global variables and defines
+namespace
+{
+	// texture units whose bindings are shadowed - the scene and the
+	// helper passes use units 0 to 15
+	const int MAX_TEXTURE_UNITS = 16;
+	// binding value of a unit whose texture is not known
+	const GLuint UNKNOWN_TEXTURE = 0xFFFFFFFF;
+
+	// capabilities whose state is shadowed
+	const int CAPABILITY_COUNT = 3;
+	const GLenum g_capabilities[CAPABILITY_COUNT] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE };
+
+	enum CAPABILITY_STATE
+	{
+		STATE_UNKNOWN = -1,
+		STATE_DISABLED = 0,
+		STATE_ENABLED = 1
+	};
+
+	// last uploaded value of one uniform, as raw bytes
+	struct UNIFORM_VALUE
+	{
+		size_t size;
+		unsigned char data[sizeof(glm::mat4)];
+	};
+	typedef std::unordered_map<std::string, UNIFORM_VALUE> UNIFORM_TABLE;
+
+	ShaderManager* g_pCurrentProgram = NULL;
+	int g_activeTextureUnit = -1;
+	GLuint g_boundTextures[MAX_TEXTURE_UNITS];
+	int g_capabilityStates[CAPABILITY_COUNT] = { STATE_UNKNOWN, STATE_UNKNOWN, STATE_UNKNOWN };
+	// depth function, GL_NONE while unknown, and the write masks
+	GLenum g_depthFunction = GL_NONE;
+	int g_depthMaskState = STATE_UNKNOWN;
+	int g_colorMaskState = STATE_UNKNOWN;
+	std::unordered_map<const ShaderManager*, UNIFORM_TABLE> g_uniformValues;
+
+	// counters of the frame being rendered, of the last frame and
+	// of every finished frame
+	GLStateCache::CACHE_STATS g_frameStats = { 0, 0, 0, 0, 0, 0, 0 };
+	GLStateCache::CACHE_STATS g_lastFrameStats = { 0, 0, 0, 0, 0, 0, 0 };
+	GLStateCache::CACHE_STATS g_totalStats = { 0, 0, 0, 0, 0, 0, 0 };
+	int g_frameCount = 0;
+	bool g_bTexturesInitialized = false;
+
+	/***********************************************************
+	 *  Filtered()
+	 *
+	 *  Count a dropped call of the passed in kind.
+	 ***********************************************************/
+	void Filtered(int& kindCounter)
+	{
+		kindCounter++;
+		g_frameStats.filteredCalls++;
+	}
+
+	/***********************************************************
+	 *  ChangeUniform()
+	 *
+	 *  Store the new value of a uniform, and return whether it
+	 *  differs from the last one uploaded.
+	 ***********************************************************/
+	bool ChangeUniform(const ShaderManager* pShaderManager, const std::string& name, const void* pValue, size_t size)
+	{
+		UNIFORM_VALUE& cached = g_uniformValues[pShaderManager][name];
+		if ((cached.size == size) && (memcmp(cached.data, pValue, size) == 0))
+		{
+			Filtered(g_frameStats.filteredUniforms);
+			return(false);
+		}
+
+		cached.size = size;
+		memcpy(cached.data, pValue, size);
+		g_frameStats.issuedCalls++;
+		return(true);
+	}
+
+	int FindCapability(GLenum capability)
+	{
+		for (int i = 0; i < CAPABILITY_COUNT; i++)
+		{
+			if (g_capabilities[i] == capability)
+			{
+				return(i);
+			}
+		}
+		return(-1);
+	}
+
+	/***********************************************************
+	 *  SetCapability()
+	 *
+	 *  Enable or disable a capability unless it is already in
+	 *  the requested state.  Capabilities that are not shadowed
+	 *  are always passed on.
+	 ***********************************************************/
+	void SetCapability(GLenum capability, bool bEnabled)
+	{
+		int index = FindCapability(capability);
+		int state = bEnabled ? STATE_ENABLED : STATE_DISABLED;
+		if ((index >= 0) && (g_capabilityStates[index] == state))
+		{
+			Filtered(g_frameStats.filteredCapabilities);
+			return;
+		}
+
+		if (bEnabled == true)
+		{
+			glEnable(capability);
+		}
+		else
+		{
+			glDisable(capability);
+		}
+		if (index >= 0)
+		{
+			g_capabilityStates[index] = state;
+		}
+		g_frameStats.issuedCalls++;
+	}
+
+	/***********************************************************
+	 *  SetMaskState()
+	 *
+	 *  Record a new write mask state, and return whether it
+	 *  differs from the one last set.
+	 ***********************************************************/
+	bool SetMaskState(int& maskState, bool bWrite)
+	{
+		int state = bWrite ? STATE_ENABLED : STATE_DISABLED;
+		if (maskState == state)
+		{
+			Filtered(g_frameStats.filteredDepthState);
+			return(false);
+		}
+
+		maskState = state;
+		g_frameStats.issuedCalls++;
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  Latch the counters of the finished frame.
+ ***********************************************************/
+void GLStateCache::BeginFrame()
+{
+	g_lastFrameStats = g_frameStats;
+	if (g_frameStats.issuedCalls + g_frameStats.filteredCalls > 0)
+	{
+		g_totalStats.issuedCalls += g_frameStats.issuedCalls;
+		g_totalStats.filteredCalls += g_frameStats.filteredCalls;
+		g_totalStats.filteredUniforms += g_frameStats.filteredUniforms;
+		g_totalStats.filteredTextureCalls += g_frameStats.filteredTextureCalls;
+		g_totalStats.filteredPrograms += g_frameStats.filteredPrograms;
+		g_totalStats.filteredCapabilities += g_frameStats.filteredCapabilities;
+		g_totalStats.filteredDepthState += g_frameStats.filteredDepthState;
+		g_frameCount++;
+	}
+	g_frameStats = CACHE_STATS();
+}
+
+GLStateCache::CACHE_STATS GLStateCache::GetLastFrameStats()
+{
+	return(g_lastFrameStats);
+}
+
+/***********************************************************
+ *  InvalidateTextures()
+ *
+ *  Forget the active unit and the texture of every unit.
+ ***********************************************************/
+void GLStateCache::InvalidateTextures()
+{
+	g_activeTextureUnit = -1;
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		g_boundTextures[i] = UNKNOWN_TEXTURE;
+	}
+	g_bTexturesInitialized = true;
+}
+
+/***********************************************************
+ *  InvalidateAll()
+ *
+ *  Forget all of the shadowed binding state.  The uniform
+ *  values belong to the programs and are kept; the shader
+ *  variants copy the uber shader's values out of them.
+ ***********************************************************/
+void GLStateCache::InvalidateAll()
+{
+	InvalidateTextures();
+	g_pCurrentProgram = NULL;
+	for (int i = 0; i < CAPABILITY_COUNT; i++)
+	{
+		g_capabilityStates[i] = STATE_UNKNOWN;
+	}
+	g_depthFunction = GL_NONE;
+	g_depthMaskState = STATE_UNKNOWN;
+	g_colorMaskState = STATE_UNKNOWN;
+}
+
+void GLStateCache::InvalidateUniforms(const ShaderManager* pShaderManager)
+{
+	g_uniformValues.erase(pShaderManager);
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  Bind the program of the shader manager unless it is the
+ *  bound one already.
+ ***********************************************************/
+void GLStateCache::UseProgram(ShaderManager* pShaderManager)
+{
+	if (pShaderManager == g_pCurrentProgram)
+	{
+		Filtered(g_frameStats.filteredPrograms);
+		return;
+	}
+
+	pShaderManager->use();
+	g_pCurrentProgram = pShaderManager;
+	g_frameStats.issuedCalls++;
+}
+
+/***********************************************************
+ *  ActiveTexture()
+ *
+ *  Select a texture unit unless it is the active one.
+ ***********************************************************/
+void GLStateCache::ActiveTexture(int textureUnit)
+{
+	if (g_bTexturesInitialized == false)
+	{
+		InvalidateTextures();
+	}
+
+	if (textureUnit == g_activeTextureUnit)
+	{
+		Filtered(g_frameStats.filteredTextureCalls);
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	g_activeTextureUnit = textureUnit;
+	g_frameStats.issuedCalls++;
+}
+
+/***********************************************************
+ *  BindTexture2D()
+ *
+ *  Bind a 2D texture to a unit, selecting the unit first
+ *  only when the texture differs from the bound one.
+ ***********************************************************/
+bool GLStateCache::BindTexture2D(int textureUnit, GLuint textureID)
+{
+	if (g_bTexturesInitialized == false)
+	{
+		InvalidateTextures();
+	}
+
+	bool bShadowed = (textureUnit >= 0) && (textureUnit < MAX_TEXTURE_UNITS);
+	if ((bShadowed == true) && (g_boundTextures[textureUnit] == textureID))
+	{
+		// neither the unit selection nor the bind is needed
+		Filtered(g_frameStats.filteredTextureCalls);
+		Filtered(g_frameStats.filteredTextureCalls);
+		return(false);
+	}
+
+	ActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	if (bShadowed == true)
+	{
+		g_boundTextures[textureUnit] = textureID;
+	}
+	g_frameStats.issuedCalls++;
+	return(true);
+}
+
+void GLStateCache::Enable(GLenum capability)
+{
+	SetCapability(capability, true);
+}
+
+void GLStateCache::Disable(GLenum capability)
+{
+	SetCapability(capability, false);
+}
+
+/***********************************************************
+ *  DepthFunc(), DepthMask(), ColorMask()
+ *
+ *  Set the depth comparison and the write masks unless they
+ *  are already set.  The color channels are always masked
+ *  together.
+ ***********************************************************/
+void GLStateCache::DepthFunc(GLenum function)
+{
+	if (function == g_depthFunction)
+	{
+		Filtered(g_frameStats.filteredDepthState);
+		return;
+	}
+
+	glDepthFunc(function);
+	g_depthFunction = function;
+	g_frameStats.issuedCalls++;
+}
+
+void GLStateCache::DepthMask(bool bWrite)
+{
+	if (SetMaskState(g_depthMaskState, bWrite) == true)
+	{
+		glDepthMask(bWrite ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void GLStateCache::ColorMask(bool bWrite)
+{
+	if (SetMaskState(g_colorMaskState, bWrite) == true)
+	{
+		GLboolean mask = bWrite ? GL_TRUE : GL_FALSE;
+		glColorMask(mask, mask, mask, mask);
+	}
+}
+
+/***********************************************************
+ *  Set*()
+ *
+ *  Upload a uniform value unless the program already holds
+ *  it.  Booleans are stored as the int the shader manager
+ *  uploads for them.
+ ***********************************************************/
+bool GLStateCache::SetBool(ShaderManager* pShaderManager, const std::string& name, bool value)
+{
+	int intValue = value ? 1 : 0;
+	if (ChangeUniform(pShaderManager, name, &intValue, sizeof(intValue)) == false)
+	{
+		return(false);
+	}
+	pShaderManager->setBoolValue(name, value);
+	return(true);
+}
+
+bool GLStateCache::SetInt(ShaderManager* pShaderManager, const std::string& name, int value)
+{
+	if (ChangeUniform(pShaderManager, name, &value, sizeof(value)) == false)
+	{
+		return(false);
+	}
+	pShaderManager->setIntValue(name, value);
+	return(true);
+}
+
+bool GLStateCache::SetFloat(ShaderManager* pShaderManager, const std::string& name, float value)
+{
+	if (ChangeUniform(pShaderManager, name, &value, sizeof(value)) == false)
+	{
+		return(false);
+	}
+	pShaderManager->setFloatValue(name, value);
+	return(true);
+}
+
+bool GLStateCache::SetVec2(ShaderManager* pShaderManager, const std::string& name, const glm::vec2& value)
+{
+	if (ChangeUniform(pShaderManager, name, glm::value_ptr(value), sizeof(value)) == false)
+	{
+		return(false);
+	}
+	pShaderManager->setVec2Value(name, value);
+	return(true);
+}
+
+bool GLStateCache::SetVec3(ShaderManager* pShaderManager, const std::string& name, const glm::vec3& value)
+{
+	if (ChangeUniform(pShaderManager, name, glm::value_ptr(value), sizeof(value)) == false)
+	{
+		return(false);
+	}
+	pShaderManager->setVec3Value(name, value);
+	return(true);
+}
+
+bool GLStateCache::SetVec4(ShaderManager* pShaderManager, const std::string& name, const glm::vec4& value)
+{
+	if (ChangeUniform(pShaderManager, name, glm::value_ptr(value), sizeof(value)) == false)
+	{
+		return(false);
+	}
+	pShaderManager->setVec4Value(name, value);
+	return(true);
+}
+
+bool GLStateCache::SetMat4(ShaderManager* pShaderManager, const std::string& name, const glm::mat4& value)
+{
+	if (ChangeUniform(pShaderManager, name, glm::value_ptr(value), sizeof(value)) == false)
+	{
+		return(false);
+	}
+	pShaderManager->setMat4Value(name, value);
+	return(true);
+}
+
+/***********************************************************
+ *  GetUniform()
+ *
+ *  Copy out the last value uploaded through the cache for a
+ *  uniform of the shader manager, without asking GL.
+ ***********************************************************/
+bool GLStateCache::GetUniform(const ShaderManager* pShaderManager, const std::string& name, void* pValue, size_t size)
+{
+	auto table = g_uniformValues.find(pShaderManager);
+	if (table == g_uniformValues.end())
+	{
+		return(false);
+	}
+	auto found = table->second.find(name);
+	if ((found == table->second.end()) || (found->second.size != size))
+	{
+		return(false);
+	}
+	memcpy(pValue, found->second.data, size);
+	return(true);
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  Print the average number of calls per frame that were
+ *  passed on and that were dropped, by kind.
+ ***********************************************************/
+void GLStateCache::PrintStats()
+{
+	if (g_frameCount == 0)
+	{
+		return;
+	}
+
+	double frames = (double)g_frameCount;
+	double totalCalls = (double)(g_totalStats.issuedCalls + g_totalStats.filteredCalls);
+	std::cout << std::fixed << std::setprecision(1)
+		<< "INFO: GL state cache over " << g_frameCount << " frames: "
+		<< g_totalStats.issuedCalls / frames << " calls issued, "
+		<< g_totalStats.filteredCalls / frames << " filtered per frame ("
+		<< ((totalCalls > 0.0) ? 100.0 * g_totalStats.filteredCalls / totalCalls : 0.0) << "%) - "
+		<< g_totalStats.filteredUniforms / frames << " uniforms, "
+		<< g_totalStats.filteredTextureCalls / frames << " texture calls, "
+		<< g_totalStats.filteredPrograms / frames << " program binds, "
+		<< g_totalStats.filteredCapabilities / frames << " enables, "
+		<< g_totalStats.filteredDepthState / frames << " depth states" << std::endl;
+}
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.h
+// ============
+// shadowed GL state - remembers the bound program, the active texture unit,
+// the 2D texture of every unit, a few capabilities, the depth function, the
+// depth and color write masks and the last value of every uniform set
+// through it, and drops the calls that would not change anything
+//
+//  The cache only knows about the calls made through it.  Code that binds
+//  textures or changes the active unit directly has to be followed by
+//  InvalidateTextures() before the cache is used again; uniforms are only
+//  cached per shader manager, so a uniform must either always or never be
+//  set through the cache.  The framebuffer, viewport, polygon offset,
+//  clear values and the non-2D texture bindings are not shadowed and are
+//  set directly, by the pass that changes them.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+
+class ShaderManager;
+
+namespace GLStateCache
+{
+	struct CACHE_STATS
+	{
+		int issuedCalls;			// calls passed on to GL
+		int filteredCalls;			// calls dropped as no-ops, by kind below
+		int filteredUniforms;
+		int filteredTextureCalls;	// glActiveTexture and glBindTexture
+		int filteredPrograms;
+		int filteredCapabilities;
+		int filteredDepthState;		// depth function and write masks
+	};
+
+	// mark the frame boundary - the counters accumulated since the last
+	// call become the "last frame" values returned by GetLastFrameStats()
+	void BeginFrame();
+	CACHE_STATS GetLastFrameStats();
+
+	// forget the active unit and the texture bindings, after code that
+	// changed them without going through the cache
+	void InvalidateTextures();
+	// forget the program, the capabilities, the depth state and the
+	// texture bindings; the uniform values stay, since binding does
+	// not change them
+	void InvalidateAll();
+	// forget the cached uniform values of one shader manager, after
+	// its uniforms were set directly or before it is deleted
+	void InvalidateUniforms(const ShaderManager* pShaderManager);
+
+	// bind the program of the shader manager
+	void UseProgram(ShaderManager* pShaderManager);
+	// select a texture unit, for binding a target that is not
+	// shadowed such as a texture buffer
+	void ActiveTexture(int textureUnit);
+	// bind a 2D texture to a texture unit - returns true when the
+	// binding changed
+	bool BindTexture2D(int textureUnit, GLuint textureID);
+	void Enable(GLenum capability);
+	void Disable(GLenum capability);
+	// set the depth comparison and the depth and color writes
+	void DepthFunc(GLenum function);
+	void DepthMask(bool bWrite);
+	void ColorMask(bool bWrite);
+
+	// set a uniform of the shader manager's program, which must be the
+	// bound one - every setter returns true when the value was uploaded
+	bool SetBool(ShaderManager* pShaderManager, const std::string& name, bool value);
+	bool SetInt(ShaderManager* pShaderManager, const std::string& name, int value);
+	bool SetFloat(ShaderManager* pShaderManager, const std::string& name, float value);
+	bool SetVec2(ShaderManager* pShaderManager, const std::string& name, const glm::vec2& value);
+	bool SetVec3(ShaderManager* pShaderManager, const std::string& name, const glm::vec3& value);
+	bool SetVec4(ShaderManager* pShaderManager, const std::string& name, const glm::vec4& value);
+	bool SetMat4(ShaderManager* pShaderManager, const std::string& name, const glm::mat4& value);
+	// copy out the last value set through the cache - false when the
+	// cache does not hold the uniform or holds another size
+	bool GetUniform(const ShaderManager* pShaderManager, const std::string& name, void* pValue, size_t size);
+
+	// print the average issued and filtered calls per frame
+	void PrintStats();
+}
@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////
+// gltraceformat.h
+// ============
+// binary layout of a captured GL command stream - shared by the capture in
+// the application and the standalone replayer
+//
+//  A trace starts with a TRACE_HEADER, followed by the commands in the order
+//  they were issued.  Every command is a 16 bit command id and a 32 bit
+//  payload size, followed by the payload as packed little endian fields.
+//  The GL objects a frame uses are snapshot into CMD_CREATE_* commands the
+//  first time they are referenced, so that the replayer can rebuild them
+//  without running any of the scene code.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+
+namespace GLTraceFormat
+{
+	// "GLTR"
+	const uint32_t TRACE_MAGIC = 0x52544C47;
+	const uint32_t TRACE_VERSION = 1;
+
+	struct TRACE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t frameCount;
+		// framebuffer size of the captured window
+		int32_t windowWidth;
+		int32_t windowHeight;
+	};
+
+	// bytes of the command id and payload size in front of a payload
+	const uint32_t COMMAND_HEADER_SIZE = 6;
+
+	enum TRACE_COMMAND
+	{
+		// object snapshots, executed once before the replay loop
+		CMD_CREATE_PROGRAM = 0,		// id, shader sources, active uniforms and their values
+		CMD_CREATE_BUFFER,			// id, size, contents
+		CMD_CREATE_VERTEX_ARRAY,	// id, element buffer, enabled attributes
+		CMD_CREATE_TEXTURE,			// id, target, size, format, sampler state, level 0
+
+		// state and resource binds
+		CMD_USE_PROGRAM,
+		CMD_BIND_VERTEX_ARRAY,
+		CMD_ACTIVE_TEXTURE,
+		CMD_BIND_TEXTURE,
+		CMD_BIND_BUFFER,
+		CMD_BUFFER_DATA,
+		CMD_BUFFER_SUB_DATA,
+		CMD_ENABLE,
+		CMD_DISABLE,
+		CMD_DEPTH_FUNC,
+		CMD_DEPTH_MASK,
+		CMD_COLOR_MASK,
+		CMD_BLEND_FUNC,
+		CMD_CULL_FACE,
+		CMD_VIEWPORT,
+		CMD_CLEAR_COLOR,
+		CMD_CLEAR,
+
+		// uniform lookups and uploads
+		CMD_GET_UNIFORM_LOCATION,
+		CMD_UNIFORM_1I,
+		CMD_UNIFORM_1F,
+		CMD_UNIFORM_2F,
+		CMD_UNIFORM_3F,
+		CMD_UNIFORM_4F,
+		CMD_UNIFORM_MATRIX_4F,
+
+		// draws
+		CMD_DRAW_ARRAYS,
+		CMD_DRAW_ARRAYS_INSTANCED,
+		CMD_DRAW_ELEMENTS,
+		CMD_DRAW_ELEMENTS_INSTANCED,
+
+		// end of a captured frame - the replayer swaps buffers here
+		CMD_FRAME_END,
+
+		CMD_COUNT
+	};
+
+	/***********************************************************
+	 *  GetCommandName()
+	 *
+	 *  The GL entry point a command was captured from, for the
+	 *  replay statistics.
+	 ***********************************************************/
+	inline const char* GetCommandName(int command)
+	{
+		static const char* const s_commandNames[CMD_COUNT] = {
+			"create program",
+			"create buffer",
+			"create vertex array",
+			"create texture",
+			"glUseProgram",
+			"glBindVertexArray",
+			"glActiveTexture",
+			"glBindTexture",
+			"glBindBuffer",
+			"glBufferData",
+			"glBufferSubData",
+			"glEnable",
+			"glDisable",
+			"glDepthFunc",
+			"glDepthMask",
+			"glColorMask",
+			"glBlendFunc",
+			"glCullFace",
+			"glViewport",
+			"glClearColor",
+			"glClear",
+			"glGetUniformLocation",
+			"glUniform1i",
+			"glUniform1f",
+			"glUniform2f",
+			"glUniform3f",
+			"glUniform4f",
+			"glUniformMatrix4fv",
+			"glDrawArrays",
+			"glDrawArraysInstanced",
+			"glDrawElements",
+			"glDrawElementsInstanced",
+			"frame end" };
+
+		if ((command < 0) || (command >= CMD_COUNT))
+		{
+			return("unknown");
+		}
+		return(s_commandNames[command]);
+	}
+}
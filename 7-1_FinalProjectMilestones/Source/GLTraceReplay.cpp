@@ -0,0 +1,915 @@
+///////////////////////////////////////////////////////////////////////////////
+// gltracereplay.cpp
+// ============
+// standalone replayer of the GL command traces written by GLCapture - it
+// rebuilds the captured objects, re-executes the recorded calls in a loop
+// and reports the CPU time spent per call type, without any scene code
+//
+//  Usage: GLTraceReplay <trace file> [loops]
+//
+//  The trace only holds the calls between the frame's first command and the
+//  buffer swap; framebuffer binds, queries and texture uploads are not
+//  recorded, so every pass of the frame is replayed into the window.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLTraceFormat.h"
+#include "TraceProfiler.h"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// declaration of the global variables and defines
+namespace
+{
+	const char* const WINDOW_TITLE = "GL Trace Replay";
+
+	// replay loops when none are passed on the command line
+	const int DEFAULT_LOOPS = 100;
+
+	// one recorded call with its object ids already mapped to the
+	// objects created by the replay
+	struct REPLAY_COMMAND
+	{
+		int command;
+		GLuint values[4];		// enums, object ids and sizes
+		GLint location;			// uniform location in the replayed program
+		GLsizei count;			// uniform array elements
+		uint64_t offset;		// index buffer offset of element draws
+		size_t dataIndex;		// uniform values or name index
+		const unsigned char* pData;	// buffer data in the loaded trace
+	};
+
+	// a captured program and the location of each captured uniform
+	// location in the replayed program
+	struct REPLAY_PROGRAM
+	{
+		GLuint programID;
+		std::unordered_map<GLint, GLint> locations;
+	};
+
+	GLFWwindow* g_Window = nullptr;
+
+	std::vector<unsigned char> g_trace;
+	GLTraceFormat::TRACE_HEADER g_header;
+
+	// captured object ids to the replayed ones
+	std::unordered_map<GLuint, REPLAY_PROGRAM> g_programs;
+	std::unordered_map<GLuint, GLuint> g_buffers;
+	std::unordered_map<GLuint, GLuint> g_vertexArrays;
+	std::unordered_map<GLuint, GLuint> g_textures;
+
+	std::vector<REPLAY_COMMAND> g_commands;
+	std::vector<GLfloat> g_uniformValues;
+	std::vector<std::string> g_uniformNames;
+
+	// the payload of one command being decoded
+	struct PAYLOAD_READER
+	{
+		const unsigned char* pCurrent;
+		const unsigned char* pEnd;
+		bool bOverrun;
+	};
+
+	template<typename T>
+	T Read(PAYLOAD_READER& reader)
+	{
+		T value = T();
+		if (reader.pCurrent + sizeof(T) > reader.pEnd)
+		{
+			reader.bOverrun = true;
+			return(value);
+		}
+		memcpy(&value, reader.pCurrent, sizeof(T));
+		reader.pCurrent += sizeof(T);
+		return(value);
+	}
+
+	const unsigned char* ReadBytes(PAYLOAD_READER& reader, size_t size)
+	{
+		const unsigned char* pBytes = reader.pCurrent;
+		if (reader.pCurrent + size > reader.pEnd)
+		{
+			reader.bOverrun = true;
+			return(NULL);
+		}
+		reader.pCurrent += size;
+		return(pBytes);
+	}
+
+	std::string ReadString(PAYLOAD_READER& reader)
+	{
+		uint32_t length = Read<uint32_t>(reader);
+		const unsigned char* pText = ReadBytes(reader, length);
+		if (NULL == pText)
+		{
+			return(std::string());
+		}
+		return(std::string((const char*)pText, length));
+	}
+
+	GLuint MapObject(const std::unordered_map<GLuint, GLuint>& objects, GLuint capturedID)
+	{
+		std::unordered_map<GLuint, GLuint>::const_iterator found = objects.find(capturedID);
+		if (found == objects.end())
+		{
+			return(0);
+		}
+		return(found->second);
+	}
+}
+
+// Function declarations - all functions that are called manually
+// need to be pre-declared at the beginning of the source code.
+bool InitializeGLFW();
+bool InitializeGLEW();
+bool LoadTrace(const char* filename);
+bool DecodeTrace();
+void CreateProgram(PAYLOAD_READER& reader);
+void CreateBuffer(PAYLOAD_READER& reader);
+void CreateVertexArray(PAYLOAD_READER& reader);
+void CreateTexture(PAYLOAD_READER& reader);
+void ExecuteCommand(const REPLAY_COMMAND& command);
+void RunReplay(int loops);
+
+/***********************************************************
+ *  main(int, char*)
+ *
+ *  This function gets called after the application has been
+ *  launched.
+ ***********************************************************/
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: GLTraceReplay <trace file> [loops]" << std::endl;
+		return(EXIT_FAILURE);
+	}
+	int loops = (argc > 2) ? atoi(argv[2]) : DEFAULT_LOOPS;
+	if (loops < 1)
+	{
+		loops = 1;
+	}
+
+	if (LoadTrace(argv[1]) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+	if ((InitializeGLFW() == false) || (InitializeGLEW() == false))
+	{
+		return(EXIT_FAILURE);
+	}
+	if (DecodeTrace() == false)
+	{
+		glfwTerminate();
+		return(EXIT_FAILURE);
+	}
+
+	RunReplay(loops);
+
+	glfwTerminate();
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *	InitializeGLFW()
+ *
+ *  This function is used to create a window of the size of
+ *  the captured one, with the context version of the
+ *  application.
+ ***********************************************************/
+bool InitializeGLFW()
+{
+	if (glfwInit() == GLFW_FALSE)
+	{
+		std::cerr << "ERROR: Failed to initialize GLFW" << std::endl;
+		return(false);
+	}
+
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#else
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#endif
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+
+	g_Window = glfwCreateWindow(g_header.windowWidth, g_header.windowHeight, WINDOW_TITLE, NULL, NULL);
+	if (g_Window == NULL)
+	{
+		std::cerr << "ERROR: Failed to create the replay window" << std::endl;
+		glfwTerminate();
+		return(false);
+	}
+	glfwMakeContextCurrent(g_Window);
+	// the replay runs as fast as the driver takes the calls
+	glfwSwapInterval(0);
+
+	return(true);
+}
+
+/***********************************************************
+ *	InitializeGLEW()
+ *
+ *  This function is used to initialize the GLEW library.
+ ***********************************************************/
+bool InitializeGLEW()
+{
+	glewExperimental = GL_TRUE;
+	GLenum GLEWInitResult = glewInit();
+	if (GLEW_OK != GLEWInitResult)
+	{
+		std::cerr << "ERROR: " << glewGetErrorString(GLEWInitResult) << std::endl;
+		return(false);
+	}
+	std::cout << "INFO: Replaying on " << glGetString(GL_RENDERER)
+		<< " (" << glGetString(GL_VERSION) << ")" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *	LoadTrace()
+ *
+ *  This function is used to read the trace file and check
+ *  its header.
+ ***********************************************************/
+bool LoadTrace(const char* filename)
+{
+	FILE* pFile = fopen(filename, "rb");
+	if (NULL == pFile)
+	{
+		std::cerr << "ERROR: Could not open the GL trace: " << filename << std::endl;
+		return(false);
+	}
+
+	bool bValid = (fread(&g_header, sizeof(g_header), 1, pFile) == 1)
+		&& (g_header.magic == GLTraceFormat::TRACE_MAGIC)
+		&& (g_header.version == GLTraceFormat::TRACE_VERSION)
+		&& (g_header.windowWidth > 0) && (g_header.windowHeight > 0);
+	if (bValid == true)
+	{
+		unsigned char chunk[65536];
+		size_t readSize = 0;
+		while ((readSize = fread(chunk, 1, sizeof(chunk), pFile)) > 0)
+		{
+			g_trace.insert(g_trace.end(), chunk, chunk + readSize);
+		}
+	}
+	fclose(pFile);
+
+	if (bValid == false)
+	{
+		std::cerr << "ERROR: Not a version " << GLTraceFormat::TRACE_VERSION << " GL trace: " << filename << std::endl;
+		return(false);
+	}
+
+	std::cout << "INFO: Loaded " << g_header.frameCount << " frames (" << (g_trace.size() + 1023) / 1024
+		<< " KB) captured at " << g_header.windowWidth << "x" << g_header.windowHeight << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *	CreateProgram()
+ *
+ *  This function is used to compile the captured shader
+ *  sources and restore the captured uniform values.
+ ***********************************************************/
+void CreateProgram(PAYLOAD_READER& reader)
+{
+	GLuint capturedID = Read<uint32_t>(reader);
+	REPLAY_PROGRAM program;
+	program.programID = glCreateProgram();
+
+	uint32_t shaderCount = Read<uint32_t>(reader);
+	for (uint32_t i = 0; i < shaderCount; i++)
+	{
+		GLenum shaderType = Read<uint32_t>(reader);
+		std::string source = ReadString(reader);
+		const GLchar* pSource = source.c_str();
+
+		GLuint shaderID = glCreateShader(shaderType);
+		glShaderSource(shaderID, 1, &pSource, NULL);
+		glCompileShader(shaderID);
+		GLint bCompiled = GL_FALSE;
+		glGetShaderiv(shaderID, GL_COMPILE_STATUS, &bCompiled);
+		if (bCompiled == GL_FALSE)
+		{
+			GLchar infoLog[1024];
+			glGetShaderInfoLog(shaderID, sizeof(infoLog), NULL, infoLog);
+			std::cerr << "ERROR: Captured shader of program " << capturedID << " failed to compile:\n" << infoLog << std::endl;
+		}
+		glAttachShader(program.programID, shaderID);
+		glDeleteShader(shaderID);
+	}
+
+	glLinkProgram(program.programID);
+	GLint bLinked = GL_FALSE;
+	glGetProgramiv(program.programID, GL_LINK_STATUS, &bLinked);
+	if (bLinked == GL_FALSE)
+	{
+		GLchar infoLog[1024];
+		glGetProgramInfoLog(program.programID, sizeof(infoLog), NULL, infoLog);
+		std::cerr << "ERROR: Captured program " << capturedID << " failed to link:\n" << infoLog << std::endl;
+	}
+
+	glUseProgram(program.programID);
+	uint32_t uniformCount = Read<uint32_t>(reader);
+	for (uint32_t i = 0; (i < uniformCount) && (reader.bOverrun == false); i++)
+	{
+		GLint capturedLocation = Read<int32_t>(reader);
+		std::string name = ReadString(reader);
+		bool bInteger = (Read<uint8_t>(reader) != 0);
+		uint32_t components = Read<uint32_t>(reader);
+
+		GLint location = glGetUniformLocation(program.programID, name.c_str());
+		program.locations[capturedLocation] = location;
+
+		if (bInteger == true)
+		{
+			GLint value = 0;
+			for (uint32_t c = 0; c < components; c++)
+			{
+				value = Read<int32_t>(reader);
+			}
+			glUniform1i(location, value);
+		}
+		else
+		{
+			GLfloat values[16];
+			for (uint32_t c = 0; c < components; c++)
+			{
+				values[std::min<uint32_t>(c, 15)] = Read<float>(reader);
+			}
+			switch (components)
+			{
+			case 1:
+				glUniform1fv(location, 1, values);
+				break;
+			case 2:
+				glUniform2fv(location, 1, values);
+				break;
+			case 3:
+				glUniform3fv(location, 1, values);
+				break;
+			case 4:
+				glUniform4fv(location, 1, values);
+				break;
+			case 16:
+				glUniformMatrix4fv(location, 1, GL_FALSE, values);
+				break;
+			}
+		}
+	}
+
+	g_programs[capturedID] = program;
+}
+
+/***********************************************************
+ *	CreateBuffer()
+ *
+ *  This function is used to create a buffer with the
+ *  captured contents.
+ ***********************************************************/
+void CreateBuffer(PAYLOAD_READER& reader)
+{
+	GLuint capturedID = Read<uint32_t>(reader);
+	uint32_t size = Read<uint32_t>(reader);
+	const unsigned char* pContents = ReadBytes(reader, size);
+
+	GLuint bufferID = 0;
+	glGenBuffers(1, &bufferID);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+	glBufferData(GL_COPY_WRITE_BUFFER, size, pContents, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	g_buffers[capturedID] = bufferID;
+}
+
+/***********************************************************
+ *	CreateVertexArray()
+ *
+ *  This function is used to create a vertex array with the
+ *  captured element buffer and attribute layout.
+ ***********************************************************/
+void CreateVertexArray(PAYLOAD_READER& reader)
+{
+	GLuint capturedID = Read<uint32_t>(reader);
+	GLuint elementBuffer = MapObject(g_buffers, Read<uint32_t>(reader));
+
+	GLuint vertexArrayID = 0;
+	glGenVertexArrays(1, &vertexArrayID);
+	glBindVertexArray(vertexArrayID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+
+	uint32_t attributeCount = Read<uint32_t>(reader);
+	for (uint32_t i = 0; (i < attributeCount) && (reader.bOverrun == false); i++)
+	{
+		GLuint index = Read<uint32_t>(reader);
+		GLuint buffer = MapObject(g_buffers, Read<uint32_t>(reader));
+		GLint size = Read<int32_t>(reader);
+		GLenum type = Read<uint32_t>(reader);
+		bool bNormalized = (Read<uint8_t>(reader) != 0);
+		bool bInteger = (Read<uint8_t>(reader) != 0);
+		GLsizei stride = Read<int32_t>(reader);
+		GLuint divisor = Read<uint32_t>(reader);
+		const void* pOffset = (const void*)(uintptr_t)Read<uint64_t>(reader);
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		if (bInteger == true)
+		{
+			glVertexAttribIPointer(index, size, type, stride, pOffset);
+		}
+		else
+		{
+			glVertexAttribPointer(index, size, type, bNormalized ? GL_TRUE : GL_FALSE, stride, pOffset);
+		}
+		glEnableVertexAttribArray(index);
+		glVertexAttribDivisor(index, divisor);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	g_vertexArrays[capturedID] = vertexArrayID;
+}
+
+/***********************************************************
+ *	CreateTexture()
+ *
+ *  This function is used to create a 2D texture with the
+ *  captured size, sampler state and level 0, or a buffer
+ *  texture over a captured buffer.
+ ***********************************************************/
+void CreateTexture(PAYLOAD_READER& reader)
+{
+	GLuint capturedID = Read<uint32_t>(reader);
+	GLenum target = Read<uint32_t>(reader);
+	GLsizei width = Read<int32_t>(reader);
+	GLsizei height = Read<int32_t>(reader);
+	GLenum internalFormat = Read<uint32_t>(reader);
+	bool bDepth = (Read<uint8_t>(reader) != 0);
+	bool bMipmapped = (Read<uint8_t>(reader) != 0);
+	GLint sampler[6];
+	for (int i = 0; i < 6; i++)
+	{
+		sampler[i] = Read<int32_t>(reader);
+	}
+	GLuint buffer = MapObject(g_buffers, Read<uint32_t>(reader));
+	uint32_t contentSize = Read<uint32_t>(reader);
+	const unsigned char* pContents = ReadBytes(reader, contentSize);
+
+	GLuint textureID = 0;
+	glGenTextures(1, &textureID);
+	glBindTexture(target, textureID);
+	if (target == GL_TEXTURE_BUFFER)
+	{
+		glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer);
+	}
+	else if (bDepth == true)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	}
+	else
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+			(contentSize == (uint32_t)width * height * 4) ? pContents : NULL);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (bMipmapped == true)
+		{
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+	}
+
+	if (target == GL_TEXTURE_2D)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler[0]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler[1]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler[2]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler[3]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, sampler[4]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, sampler[5]);
+	}
+	glBindTexture(target, 0);
+
+	g_textures[capturedID] = textureID;
+}
+
+/***********************************************************
+ *	DecodeTrace()
+ *
+ *  This function is used to walk the trace once - the
+ *  object snapshots are created on the way and every other
+ *  command is decoded with its ids mapped to the created
+ *  objects, so that the replay loop only issues GL calls.
+ ***********************************************************/
+bool DecodeTrace()
+{
+	const unsigned char* pCurrent = g_trace.data();
+	const unsigned char* pEnd = g_trace.data() + g_trace.size();
+	// the program the uniform locations of the following
+	// commands belong to
+	const REPLAY_PROGRAM* pProgram = NULL;
+
+	while (pCurrent + GLTraceFormat::COMMAND_HEADER_SIZE <= pEnd)
+	{
+		uint16_t commandID = 0;
+		uint32_t payloadSize = 0;
+		memcpy(&commandID, pCurrent, sizeof(commandID));
+		memcpy(&payloadSize, pCurrent + sizeof(commandID), sizeof(payloadSize));
+		pCurrent += GLTraceFormat::COMMAND_HEADER_SIZE;
+		if (pCurrent + payloadSize > pEnd)
+		{
+			std::cerr << "ERROR: The GL trace is truncated" << std::endl;
+			return(false);
+		}
+
+		PAYLOAD_READER reader;
+		reader.pCurrent = pCurrent;
+		reader.pEnd = pCurrent + payloadSize;
+		reader.bOverrun = false;
+		pCurrent += payloadSize;
+
+		REPLAY_COMMAND command;
+		memset(&command, 0, sizeof(command));
+		command.command = commandID;
+
+		switch (commandID)
+		{
+		case GLTraceFormat::CMD_CREATE_PROGRAM:
+			CreateProgram(reader);
+			continue;
+		case GLTraceFormat::CMD_CREATE_BUFFER:
+			CreateBuffer(reader);
+			continue;
+		case GLTraceFormat::CMD_CREATE_VERTEX_ARRAY:
+			CreateVertexArray(reader);
+			continue;
+		case GLTraceFormat::CMD_CREATE_TEXTURE:
+			CreateTexture(reader);
+			continue;
+
+		case GLTraceFormat::CMD_USE_PROGRAM:
+		{
+			GLuint capturedID = Read<uint32_t>(reader);
+			std::unordered_map<GLuint, REPLAY_PROGRAM>::const_iterator found = g_programs.find(capturedID);
+			pProgram = (found != g_programs.end()) ? &found->second : NULL;
+			command.values[0] = (NULL != pProgram) ? pProgram->programID : 0;
+			break;
+		}
+		case GLTraceFormat::CMD_BIND_VERTEX_ARRAY:
+			command.values[0] = MapObject(g_vertexArrays, Read<uint32_t>(reader));
+			break;
+		case GLTraceFormat::CMD_BIND_TEXTURE:
+			command.values[0] = Read<uint32_t>(reader);
+			command.values[1] = MapObject(g_textures, Read<uint32_t>(reader));
+			break;
+		case GLTraceFormat::CMD_BIND_BUFFER:
+			command.values[0] = Read<uint32_t>(reader);
+			command.values[1] = MapObject(g_buffers, Read<uint32_t>(reader));
+			break;
+		case GLTraceFormat::CMD_BUFFER_DATA:
+			command.values[0] = Read<uint32_t>(reader);
+			command.values[1] = Read<uint32_t>(reader);
+			command.values[2] = Read<uint32_t>(reader);
+			if (Read<uint8_t>(reader) != 0)
+			{
+				command.pData = ReadBytes(reader, command.values[1]);
+			}
+			break;
+		case GLTraceFormat::CMD_BUFFER_SUB_DATA:
+			command.values[0] = Read<uint32_t>(reader);
+			command.values[1] = Read<uint32_t>(reader);
+			command.values[2] = Read<uint32_t>(reader);
+			command.pData = ReadBytes(reader, command.values[2]);
+			break;
+		case GLTraceFormat::CMD_ACTIVE_TEXTURE:
+		case GLTraceFormat::CMD_ENABLE:
+		case GLTraceFormat::CMD_DISABLE:
+		case GLTraceFormat::CMD_DEPTH_FUNC:
+		case GLTraceFormat::CMD_CULL_FACE:
+		case GLTraceFormat::CMD_CLEAR:
+			command.values[0] = Read<uint32_t>(reader);
+			break;
+		case GLTraceFormat::CMD_DEPTH_MASK:
+			command.values[0] = Read<uint8_t>(reader);
+			break;
+		case GLTraceFormat::CMD_COLOR_MASK:
+			for (int i = 0; i < 4; i++)
+			{
+				command.values[i] = Read<uint8_t>(reader);
+			}
+			break;
+		case GLTraceFormat::CMD_BLEND_FUNC:
+			command.values[0] = Read<uint32_t>(reader);
+			command.values[1] = Read<uint32_t>(reader);
+			break;
+		case GLTraceFormat::CMD_VIEWPORT:
+			for (int i = 0; i < 4; i++)
+			{
+				command.values[i] = (GLuint)Read<int32_t>(reader);
+			}
+			break;
+		case GLTraceFormat::CMD_CLEAR_COLOR:
+			command.dataIndex = g_uniformValues.size();
+			for (int i = 0; i < 4; i++)
+			{
+				g_uniformValues.push_back(Read<float>(reader));
+			}
+			break;
+
+		case GLTraceFormat::CMD_GET_UNIFORM_LOCATION:
+		{
+			std::unordered_map<GLuint, REPLAY_PROGRAM>::const_iterator found = g_programs.find(Read<uint32_t>(reader));
+			command.values[0] = (found != g_programs.end()) ? found->second.programID : 0;
+			command.dataIndex = g_uniformNames.size();
+			g_uniformNames.push_back(ReadString(reader));
+			break;
+		}
+		case GLTraceFormat::CMD_UNIFORM_1I:
+		case GLTraceFormat::CMD_UNIFORM_1F:
+		case GLTraceFormat::CMD_UNIFORM_2F:
+		case GLTraceFormat::CMD_UNIFORM_3F:
+		case GLTraceFormat::CMD_UNIFORM_4F:
+		case GLTraceFormat::CMD_UNIFORM_MATRIX_4F:
+		{
+			GLint capturedLocation = Read<int32_t>(reader);
+			command.location = -1;
+			if (NULL != pProgram)
+			{
+				std::unordered_map<GLint, GLint>::const_iterator found = pProgram->locations.find(capturedLocation);
+				if (found != pProgram->locations.end())
+				{
+					command.location = found->second;
+				}
+			}
+
+			if (commandID == GLTraceFormat::CMD_UNIFORM_1I)
+			{
+				command.values[0] = (GLuint)Read<int32_t>(reader);
+				break;
+			}
+
+			command.count = (GLsizei)Read<uint32_t>(reader);
+			int components = 1;
+			if (commandID == GLTraceFormat::CMD_UNIFORM_2F)
+			{
+				components = 2;
+			}
+			else if (commandID == GLTraceFormat::CMD_UNIFORM_3F)
+			{
+				components = 3;
+			}
+			else if (commandID == GLTraceFormat::CMD_UNIFORM_4F)
+			{
+				components = 4;
+			}
+			else if (commandID == GLTraceFormat::CMD_UNIFORM_MATRIX_4F)
+			{
+				components = 16;
+			}
+			command.dataIndex = g_uniformValues.size();
+			for (int i = 0; i < components * command.count; i++)
+			{
+				g_uniformValues.push_back(Read<float>(reader));
+			}
+			break;
+		}
+
+		case GLTraceFormat::CMD_DRAW_ARRAYS:
+		case GLTraceFormat::CMD_DRAW_ARRAYS_INSTANCED:
+			command.values[0] = Read<uint32_t>(reader);
+			command.values[1] = (GLuint)Read<int32_t>(reader);
+			command.values[2] = (GLuint)Read<int32_t>(reader);
+			if (commandID == GLTraceFormat::CMD_DRAW_ARRAYS_INSTANCED)
+			{
+				command.values[3] = (GLuint)Read<int32_t>(reader);
+			}
+			break;
+		case GLTraceFormat::CMD_DRAW_ELEMENTS:
+		case GLTraceFormat::CMD_DRAW_ELEMENTS_INSTANCED:
+			command.values[0] = Read<uint32_t>(reader);
+			command.values[1] = (GLuint)Read<int32_t>(reader);
+			command.values[2] = Read<uint32_t>(reader);
+			command.offset = Read<uint64_t>(reader);
+			if (commandID == GLTraceFormat::CMD_DRAW_ELEMENTS_INSTANCED)
+			{
+				command.values[3] = (GLuint)Read<int32_t>(reader);
+			}
+			break;
+
+		case GLTraceFormat::CMD_FRAME_END:
+			break;
+
+		default:
+			std::cout << "WARNING: Skipping unknown GL trace command " << commandID << std::endl;
+			continue;
+		}
+
+		if (reader.bOverrun == true)
+		{
+			std::cerr << "ERROR: Malformed " << GLTraceFormat::GetCommandName(commandID) << " command in the GL trace" << std::endl;
+			return(false);
+		}
+		g_commands.push_back(command);
+	}
+
+	std::cout << "INFO: Created " << g_programs.size() << " programs, " << g_buffers.size() << " buffers, "
+		<< g_vertexArrays.size() << " vertex arrays and " << g_textures.size() << " textures, "
+		<< g_commands.size() << " commands to replay" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *	ExecuteCommand()
+ *
+ *  This function is used to issue one decoded call.
+ ***********************************************************/
+void ExecuteCommand(const REPLAY_COMMAND& command)
+{
+	switch (command.command)
+	{
+	case GLTraceFormat::CMD_USE_PROGRAM:
+		glUseProgram(command.values[0]);
+		break;
+	case GLTraceFormat::CMD_BIND_VERTEX_ARRAY:
+		glBindVertexArray(command.values[0]);
+		break;
+	case GLTraceFormat::CMD_ACTIVE_TEXTURE:
+		glActiveTexture(command.values[0]);
+		break;
+	case GLTraceFormat::CMD_BIND_TEXTURE:
+		glBindTexture(command.values[0], command.values[1]);
+		break;
+	case GLTraceFormat::CMD_BIND_BUFFER:
+		glBindBuffer(command.values[0], command.values[1]);
+		break;
+	case GLTraceFormat::CMD_BUFFER_DATA:
+		glBufferData(command.values[0], command.values[1], command.pData, command.values[2]);
+		break;
+	case GLTraceFormat::CMD_BUFFER_SUB_DATA:
+		glBufferSubData(command.values[0], command.values[1], command.values[2], command.pData);
+		break;
+	case GLTraceFormat::CMD_ENABLE:
+		glEnable(command.values[0]);
+		break;
+	case GLTraceFormat::CMD_DISABLE:
+		glDisable(command.values[0]);
+		break;
+	case GLTraceFormat::CMD_DEPTH_FUNC:
+		glDepthFunc(command.values[0]);
+		break;
+	case GLTraceFormat::CMD_DEPTH_MASK:
+		glDepthMask((GLboolean)command.values[0]);
+		break;
+	case GLTraceFormat::CMD_COLOR_MASK:
+		glColorMask((GLboolean)command.values[0], (GLboolean)command.values[1],
+			(GLboolean)command.values[2], (GLboolean)command.values[3]);
+		break;
+	case GLTraceFormat::CMD_BLEND_FUNC:
+		glBlendFunc(command.values[0], command.values[1]);
+		break;
+	case GLTraceFormat::CMD_CULL_FACE:
+		glCullFace(command.values[0]);
+		break;
+	case GLTraceFormat::CMD_VIEWPORT:
+		glViewport((GLint)command.values[0], (GLint)command.values[1],
+			(GLsizei)command.values[2], (GLsizei)command.values[3]);
+		break;
+	case GLTraceFormat::CMD_CLEAR_COLOR:
+	{
+		const GLfloat* pColor = &g_uniformValues[command.dataIndex];
+		glClearColor(pColor[0], pColor[1], pColor[2], pColor[3]);
+		break;
+	}
+	case GLTraceFormat::CMD_CLEAR:
+		glClear(command.values[0]);
+		break;
+	case GLTraceFormat::CMD_GET_UNIFORM_LOCATION:
+		glGetUniformLocation(command.values[0], g_uniformNames[command.dataIndex].c_str());
+		break;
+	case GLTraceFormat::CMD_UNIFORM_1I:
+		glUniform1i(command.location, (GLint)command.values[0]);
+		break;
+	case GLTraceFormat::CMD_UNIFORM_1F:
+		glUniform1fv(command.location, command.count, &g_uniformValues[command.dataIndex]);
+		break;
+	case GLTraceFormat::CMD_UNIFORM_2F:
+		glUniform2fv(command.location, command.count, &g_uniformValues[command.dataIndex]);
+		break;
+	case GLTraceFormat::CMD_UNIFORM_3F:
+		glUniform3fv(command.location, command.count, &g_uniformValues[command.dataIndex]);
+		break;
+	case GLTraceFormat::CMD_UNIFORM_4F:
+		glUniform4fv(command.location, command.count, &g_uniformValues[command.dataIndex]);
+		break;
+	case GLTraceFormat::CMD_UNIFORM_MATRIX_4F:
+		glUniformMatrix4fv(command.location, command.count, GL_FALSE, &g_uniformValues[command.dataIndex]);
+		break;
+	case GLTraceFormat::CMD_DRAW_ARRAYS:
+		glDrawArrays(command.values[0], (GLint)command.values[1], (GLsizei)command.values[2]);
+		break;
+	case GLTraceFormat::CMD_DRAW_ARRAYS_INSTANCED:
+		glDrawArraysInstanced(command.values[0], (GLint)command.values[1], (GLsizei)command.values[2],
+			(GLsizei)command.values[3]);
+		break;
+	case GLTraceFormat::CMD_DRAW_ELEMENTS:
+		glDrawElements(command.values[0], (GLsizei)command.values[1], command.values[2],
+			(const void*)(uintptr_t)command.offset);
+		break;
+	case GLTraceFormat::CMD_DRAW_ELEMENTS_INSTANCED:
+		glDrawElementsInstanced(command.values[0], (GLsizei)command.values[1], command.values[2],
+			(const void*)(uintptr_t)command.offset, (GLsizei)command.values[3]);
+		break;
+	case GLTraceFormat::CMD_FRAME_END:
+		glfwSwapBuffers(g_Window);
+		glfwPollEvents();
+		break;
+	}
+}
+
+/***********************************************************
+ *	RunReplay()
+ *
+ *  This function is used to issue the decoded commands the
+ *  passed in number of times, timing every call, and to
+ *  print the time spent per call type.  The times are the
+ *  CPU side cost of the calls - the GPU work they queue is
+ *  waited for in the buffer swap at the end of each frame.
+ ***********************************************************/
+void RunReplay(int loops)
+{
+	// the cost of reading the clock twice, removed from every
+	// call so that the cheap state calls are not dominated by it
+	const int CALIBRATION_SAMPLES = 100000;
+	double calibrationStart = TraceProfiler::NowMilliseconds();
+	for (int i = 0; i < CALIBRATION_SAMPLES; i++)
+	{
+		TraceProfiler::NowMilliseconds();
+	}
+	double timerOverhead = (TraceProfiler::NowMilliseconds() - calibrationStart) / CALIBRATION_SAMPLES;
+
+	double totalMilliseconds[GLTraceFormat::CMD_COUNT];
+	size_t callCount[GLTraceFormat::CMD_COUNT];
+	for (int i = 0; i < GLTraceFormat::CMD_COUNT; i++)
+	{
+		totalMilliseconds[i] = 0.0;
+		callCount[i] = 0;
+	}
+
+	double replayStart = TraceProfiler::NowMilliseconds();
+	for (int loop = 0; (loop < loops) && (glfwWindowShouldClose(g_Window) == GLFW_FALSE); loop++)
+	{
+		for (const REPLAY_COMMAND& command : g_commands)
+		{
+			double callStart = TraceProfiler::NowMilliseconds();
+			ExecuteCommand(command);
+			double elapsed = TraceProfiler::NowMilliseconds() - callStart - timerOverhead;
+			totalMilliseconds[command.command] += std::max(elapsed, 0.0);
+			callCount[command.command]++;
+		}
+	}
+	glFinish();
+	double replayMilliseconds = TraceProfiler::NowMilliseconds() - replayStart;
+
+	double callMilliseconds = 0.0;
+	std::vector<int> order;
+	for (int i = 0; i < GLTraceFormat::CMD_COUNT; i++)
+	{
+		if (callCount[i] > 0)
+		{
+			order.push_back(i);
+			callMilliseconds += totalMilliseconds[i];
+		}
+	}
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return(totalMilliseconds[a] > totalMilliseconds[b]); });
+
+	size_t replayedFrames = std::max<size_t>(callCount[GLTraceFormat::CMD_FRAME_END], 1);
+	std::cout << "INFO: Replayed " << replayedFrames << " frames in " << std::fixed << std::setprecision(1)
+		<< replayMilliseconds << " ms (" << replayMilliseconds / replayedFrames << " ms per frame, timer overhead "
+		<< timerOverhead * 1000000.0 << " ns per call)" << std::endl;
+	std::cout << std::left << std::setw(26) << "call" << std::right << std::setw(14) << "calls/frame"
+		<< std::setw(12) << "total ms" << std::setw(12) << "ns/call" << std::setw(9) << "share" << std::endl;
+	for (int i : order)
+	{
+		std::cout << std::left << std::setw(26) << GLTraceFormat::GetCommandName(i) << std::right
+			<< std::setw(14) << std::setprecision(1) << (double)callCount[i] / replayedFrames
+			<< std::setw(12) << std::setprecision(2) << totalMilliseconds[i]
+			<< std::setw(12) << std::setprecision(0) << totalMilliseconds[i] * 1000000.0 / callCount[i]
+			<< std::setw(8) << std::setprecision(1) << 100.0 * totalMilliseconds[i] / std::max(callMilliseconds, 0.001)
+			<< "%" << std::endl;
+	}
+}
@@ -0,0 +1,1266 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.cpp
+// ============
+// CPU lightmap baker for the static desk scene - the direct lighting of the
+// scene lights and the ambient occlusion are ray traced on every core
+// against a BVH of the scene's primitives and stored in a lightmap atlas
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightmapBaker.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+
+// GLM Math Header inclusions
+#include <glm/gtx/transform.hpp>
+
+// declaration of the global variables and defines
+namespace
+{
+	// cache file header - the magic, the format version, the key of
+	// the bake inputs, the baked item count and the atlas height
+	const char CACHE_MAGIC[4] = { 'L', 'M', 'A', 'P' };
+	const uint32_t CACHE_VERSION = 1;
+
+	// lightmap texels per world unit along the largest extent of a
+	// draw, and the limits of the resulting tile size
+	const float TEXELS_PER_UNIT = 4.0f;
+	const int MIN_TILE_TEXELS = 8;
+	const int MAX_TILE_TEXELS = 128;
+	// tiles of a draw - one per face direction, three by two
+	const int FACE_TILES = 6;
+	const int TILE_COLUMNS = 3;
+
+	// rays start this far off the surface against self shadowing
+	const float SURFACE_BIAS = 0.01f;
+	// shadow rays of the directional light end after this distance
+	const float SHADOW_DISTANCE = 100.0f;
+	// hemisphere rays per texel and their length for the occlusion
+	const int AO_SAMPLES = 64;
+	const float AO_DISTANCE = 1.5f;
+
+	// top radius of the tapered cylinder mesh, the bottom radius is 1
+	const float TAPERED_TOP_RADIUS = 0.5f;
+
+	const int BVH_LEAF_SIZE = 2;
+	const int BVH_STACK_SIZE = 64;
+
+	const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+	/***********************************************************
+	 *  HashBytes()
+	 *
+	 *  FNV-1a hash of a block of memory, continued from the
+	 *  passed in hash value.
+	 ***********************************************************/
+	uint64_t HashBytes(uint64_t hash, const void* pData, size_t size)
+	{
+		const unsigned char* pBytes = (const unsigned char*)pData;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return(hash);
+	}
+
+	/***********************************************************
+	 *  PutValue()
+	 *
+	 *  Append the bytes of a value to the file data.
+	 ***********************************************************/
+	template <typename T>
+	void PutValue(std::vector<unsigned char>& data, T value)
+	{
+		unsigned char bytes[sizeof(T)];
+		memcpy(bytes, &value, sizeof(T));
+		data.insert(data.end(), bytes, bytes + sizeof(T));
+	}
+
+	/***********************************************************
+	 *  GetValue()
+	 *
+	 *  Read a value from the file data and advance past it.
+	 ***********************************************************/
+	template <typename T>
+	T GetValue(const unsigned char*& pData)
+	{
+		T value;
+		memcpy(&value, pData, sizeof(T));
+		pData += sizeof(T);
+		return(value);
+	}
+
+	/***********************************************************
+	 *  IsBakeable()
+	 *
+	 *  Meshes whose shape the baker can trace.  The torus is
+	 *  left out, as its faces overlap in the face projection,
+	 *  and so are the single box sides and the foliage.
+	 ***********************************************************/
+	bool IsBakeable(int meshShape)
+	{
+		return((meshShape == RenderQueue::MESH_PLANE) ||
+			(meshShape == RenderQueue::MESH_BOX) ||
+			(meshShape == RenderQueue::MESH_CYLINDER) ||
+			(meshShape == RenderQueue::MESH_TAPERED_CYLINDER) ||
+			(meshShape == RenderQueue::MESH_SPHERE));
+	}
+
+	/***********************************************************
+	 *  IsOccluderShape()
+	 ***********************************************************/
+	bool IsOccluderShape(int meshShape)
+	{
+		return((IsBakeable(meshShape) == true) || (meshShape == RenderQueue::MESH_BOX_SIDE));
+	}
+
+	/***********************************************************
+	 *  GetShapeBounds()
+	 *
+	 *  Object space box of a basic mesh, the box the lightmap
+	 *  face tiles are projected from.
+	 ***********************************************************/
+	void GetShapeBounds(int meshShape, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		switch (meshShape)
+		{
+		case RenderQueue::MESH_PLANE:
+			boundsMin = glm::vec3(-1.0f, -0.01f, -1.0f);
+			boundsMax = glm::vec3(1.0f, 0.01f, 1.0f);
+			break;
+		case RenderQueue::MESH_CYLINDER:
+		case RenderQueue::MESH_TAPERED_CYLINDER:
+			boundsMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+			boundsMax = glm::vec3(1.0f, 1.0f, 1.0f);
+			break;
+		case RenderQueue::MESH_SPHERE:
+			boundsMin = glm::vec3(-1.0f);
+			boundsMax = glm::vec3(1.0f);
+			break;
+		default:
+			boundsMin = glm::vec3(-0.5f);
+			boundsMax = glm::vec3(0.5f);
+			break;
+		}
+	}
+
+	/***********************************************************
+	 *  GetLightmapTransform()
+	 *
+	 *  Transform from object space into the 0..1 cube of the
+	 *  shape bounds, which the shaders project the tiles from.
+	 ***********************************************************/
+	glm::mat4 GetLightmapTransform(int meshShape)
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		GetShapeBounds(meshShape, boundsMin, boundsMax);
+		return(glm::scale(1.0f / (boundsMax - boundsMin)) * glm::translate(-boundsMin));
+	}
+
+	/***********************************************************
+	 *  IntersectBox()
+	 *
+	 *  Slab test against the unit box mesh.  A ray that starts
+	 *  inside of the box hits it where it leaves.
+	 ***********************************************************/
+	bool IntersectBox(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& tHit, glm::vec3& normal)
+	{
+		float tNear = -1.0e30f;
+		float tFar = 1.0e30f;
+		int nearAxis = 0;
+		int farAxis = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (std::fabs(direction[axis]) < 1.0e-12f)
+			{
+				if ((origin[axis] < -0.5f) || (origin[axis] > 0.5f))
+				{
+					return(false);
+				}
+				continue;
+			}
+			float t1 = (-0.5f - origin[axis]) / direction[axis];
+			float t2 = (0.5f - origin[axis]) / direction[axis];
+			if (t1 > t2)
+			{
+				std::swap(t1, t2);
+			}
+			if (t1 > tNear)
+			{
+				tNear = t1;
+				nearAxis = axis;
+			}
+			if (t2 < tFar)
+			{
+				tFar = t2;
+				farAxis = axis;
+			}
+		}
+		if (tNear > tFar)
+		{
+			return(false);
+		}
+
+		float t = tNear;
+		int axis = nearAxis;
+		if (t < tMin)
+		{
+			t = tFar;
+			axis = farAxis;
+		}
+		if ((t < tMin) || (t > tMax))
+		{
+			return(false);
+		}
+
+		tHit = t;
+		normal = glm::vec3(0.0f);
+		normal[axis] = (origin[axis] + direction[axis] * t > 0.0f) ? 1.0f : -1.0f;
+		return(true);
+	}
+
+	/***********************************************************
+	 *  IntersectPlane()
+	 *
+	 *  The plane mesh spans -1..1 in x and z at y = 0, facing up.
+	 ***********************************************************/
+	bool IntersectPlane(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& tHit, glm::vec3& normal)
+	{
+		if (std::fabs(direction.y) < 1.0e-12f)
+		{
+			return(false);
+		}
+		float t = -origin.y / direction.y;
+		if ((t < tMin) || (t > tMax))
+		{
+			return(false);
+		}
+		glm::vec3 point = origin + direction * t;
+		if ((std::fabs(point.x) > 1.0f) || (std::fabs(point.z) > 1.0f))
+		{
+			return(false);
+		}
+		tHit = t;
+		normal = glm::vec3(0.0f, 1.0f, 0.0f);
+		return(true);
+	}
+
+	/***********************************************************
+	 *  IntersectSphere()
+	 *
+	 *  The sphere mesh has a radius of 1 around the origin.
+	 ***********************************************************/
+	bool IntersectSphere(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax, float& tHit, glm::vec3& normal)
+	{
+		float a = glm::dot(direction, direction);
+		float b = 2.0f * glm::dot(origin, direction);
+		float c = glm::dot(origin, origin) - 1.0f;
+		float discriminant = b * b - 4.0f * a * c;
+		if ((discriminant < 0.0f) || (a <= 0.0f))
+		{
+			return(false);
+		}
+		float root = std::sqrt(discriminant);
+		float roots[2] = { (-b - root) / (2.0f * a), (-b + root) / (2.0f * a) };
+		for (int i = 0; i < 2; i++)
+		{
+			if ((roots[i] >= tMin) && (roots[i] <= tMax))
+			{
+				tHit = roots[i];
+				normal = origin + direction * roots[i];
+				return(true);
+			}
+		}
+		return(false);
+	}
+
+	/***********************************************************
+	 *  IntersectCylinder()
+	 *
+	 *  The cylinder meshes stand on y = 0 with a radius of 1 and
+	 *  a height of 1; the radius shrinks linearly to the top
+	 *  radius.  Only the parts in the MESH_PARTS flags count.
+	 ***********************************************************/
+	bool IntersectCylinder(const glm::vec3& origin, const glm::vec3& direction, float topRadius, int parts,
+		float tMin, float tMax, float& tHit, glm::vec3& normal)
+	{
+		bool bHit = false;
+		float slope = topRadius - 1.0f;
+
+		if ((parts & RenderQueue::PART_SIDES) != 0)
+		{
+			// x^2 + z^2 = (1 + slope * y)^2 along the ray
+			float radiusOrigin = 1.0f + slope * origin.y;
+			float a = direction.x * direction.x + direction.z * direction.z - slope * slope * direction.y * direction.y;
+			float b = 2.0f * (origin.x * direction.x + origin.z * direction.z - slope * radiusOrigin * direction.y);
+			float c = origin.x * origin.x + origin.z * origin.z - radiusOrigin * radiusOrigin;
+
+			float roots[2];
+			int rootCount = 0;
+			if (std::fabs(a) < 1.0e-12f)
+			{
+				if (std::fabs(b) > 1.0e-12f)
+				{
+					roots[rootCount++] = -c / b;
+				}
+			}
+			else
+			{
+				float discriminant = b * b - 4.0f * a * c;
+				if (discriminant >= 0.0f)
+				{
+					float root = std::sqrt(discriminant);
+					float t1 = (-b - root) / (2.0f * a);
+					float t2 = (-b + root) / (2.0f * a);
+					roots[rootCount++] = std::min(t1, t2);
+					roots[rootCount++] = std::max(t1, t2);
+				}
+			}
+
+			for (int i = 0; i < rootCount; i++)
+			{
+				float t = roots[i];
+				if ((t < tMin) || (t > tMax))
+				{
+					continue;
+				}
+				glm::vec3 point = origin + direction * t;
+				if ((point.y < 0.0f) || (point.y > 1.0f))
+				{
+					continue;
+				}
+				tHit = t;
+				tMax = t;
+				normal = glm::vec3(point.x, -slope * (1.0f + slope * point.y), point.z);
+				bHit = true;
+				break;
+			}
+		}
+
+		// the caps are disks at the bottom and the top
+		if (std::fabs(direction.y) > 1.0e-12f)
+		{
+			const int capParts[2] = { RenderQueue::PART_BOTTOM, RenderQueue::PART_TOP };
+			for (int cap = 0; cap < 2; cap++)
+			{
+				if ((parts & capParts[cap]) == 0)
+				{
+					continue;
+				}
+				float capY = (float)cap;
+				float capRadius = (cap == 0) ? 1.0f : topRadius;
+				float t = (capY - origin.y) / direction.y;
+				if ((t < tMin) || (t > tMax))
+				{
+					continue;
+				}
+				glm::vec3 point = origin + direction * t;
+				if (point.x * point.x + point.z * point.z > capRadius * capRadius)
+				{
+					continue;
+				}
+				tHit = t;
+				tMax = t;
+				normal = glm::vec3(0.0f, (cap == 0) ? -1.0f : 1.0f, 0.0f);
+				bHit = true;
+			}
+		}
+
+		return(bHit);
+	}
+
+	/***********************************************************
+	 *  IntersectShape()
+	 *
+	 *  Nearest hit of an object space ray with a basic mesh
+	 *  between tMin and tMax, and the object space normal of
+	 *  the hit.  The normal is not normalized.
+	 ***********************************************************/
+	bool IntersectShape(int meshShape, int meshParts, const glm::vec3& origin, const glm::vec3& direction,
+		float tMin, float tMax, float& tHit, glm::vec3& normal)
+	{
+		switch (meshShape)
+		{
+		case RenderQueue::MESH_PLANE:
+			return(IntersectPlane(origin, direction, tMin, tMax, tHit, normal));
+		case RenderQueue::MESH_BOX:
+		case RenderQueue::MESH_BOX_SIDE:
+			return(IntersectBox(origin, direction, tMin, tMax, tHit, normal));
+		case RenderQueue::MESH_CYLINDER:
+			return(IntersectCylinder(origin, direction, 1.0f, meshParts, tMin, tMax, tHit, normal));
+		case RenderQueue::MESH_TAPERED_CYLINDER:
+			return(IntersectCylinder(origin, direction, TAPERED_TOP_RADIUS, meshParts, tMin, tMax, tHit, normal));
+		case RenderQueue::MESH_SPHERE:
+			return(IntersectSphere(origin, direction, tMin, tMax, tHit, normal));
+		}
+		return(false);
+	}
+
+	/***********************************************************
+	 *  DominantAxis()
+	 *
+	 *  Axis the vector points along the most - the same choice
+	 *  the fragment shader makes for the lightmap tile.
+	 ***********************************************************/
+	int DominantAxis(const glm::vec3& value)
+	{
+		glm::vec3 magnitude = glm::abs(value);
+		if ((magnitude.x >= magnitude.y) && (magnitude.x >= magnitude.z))
+		{
+			return(0);
+		}
+		return((magnitude.y >= magnitude.z) ? 1 : 2);
+	}
+
+	/***********************************************************
+	 *  RayHitsBox()
+	 ***********************************************************/
+	bool RayHitsBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float tMax,
+		const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		glm::vec3 t1 = (boxMin - origin) * inverseDirection;
+		glm::vec3 t2 = (boxMax - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t1, t2);
+		glm::vec3 tFar = glm::max(t1, t2);
+		float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+		return(enter <= exit);
+	}
+
+	/***********************************************************
+	 *  GetWorldBounds()
+	 *
+	 *  World space box around the transformed shape bounds.
+	 ***********************************************************/
+	void GetWorldBounds(int meshShape, const glm::mat4& model, glm::vec3& worldMin, glm::vec3& worldMax)
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		GetShapeBounds(meshShape, boundsMin, boundsMax);
+
+		glm::vec3 center = glm::vec3(model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+		glm::vec3 halfSize = (boundsMax - boundsMin) * 0.5f;
+		glm::vec3 extent = glm::abs(glm::vec3(model[0])) * halfSize.x +
+			glm::abs(glm::vec3(model[1])) * halfSize.y +
+			glm::abs(glm::vec3(model[2])) * halfSize.z;
+		worldMin = center - extent;
+		worldMax = center + extent;
+	}
+}
+
+/***********************************************************
+ *  LightmapBaker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightmapBaker::LightmapBaker()
+{
+	m_atlasHeight = 0;
+	m_textureID = 0;
+	m_bValid = false;
+	m_stats = BAKE_STATS();
+}
+
+/***********************************************************
+ *  ~LightmapBaker()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightmapBaker::~LightmapBaker()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to free the atlas texture.
+ ***********************************************************/
+void LightmapBaker::Destroy()
+{
+	if (m_textureID != 0)
+	{
+		glDeleteTextures(1, &m_textureID);
+		m_textureID = 0;
+	}
+	m_bValid = false;
+}
+
+/***********************************************************
+ *  Bake()
+ *
+ *  This method is used to bake the lightmaps of the first
+ *  itemCount queued draws - the static desk scene.  The
+ *  cache file is used instead when its key matches, and it
+ *  is written after every bake.
+ ***********************************************************/
+bool LightmapBaker::Bake(const RenderQueue& renderQueue, int itemCount, const BAKE_LIGHTS& lights, const char* cacheFilename)
+{
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	Destroy();
+	m_stats = BAKE_STATS();
+	itemCount = std::min(itemCount, renderQueue.GetItemCount());
+
+	uint64_t key = HashBakeInputs(renderQueue, itemCount, lights);
+	if ((NULL != cacheFilename) && (LoadCache(cacheFilename, key, renderQueue) == true))
+	{
+		m_stats.bFromCache = true;
+	}
+	else
+	{
+		PackAtlas(renderQueue, itemCount);
+		BuildBVH(renderQueue, itemCount);
+		BakeTiles(renderQueue, lights);
+		if (NULL != cacheFilename)
+		{
+			SaveCache(cacheFilename, key);
+		}
+	}
+
+	m_itemLookup.assign(itemCount, -1);
+	for (size_t i = 0; i < m_bakedItems.size(); i++)
+	{
+		m_itemLookup[m_bakedItems[i].itemIndex] = (int)i;
+	}
+	m_stats.bakedItems = (int)m_bakedItems.size();
+
+	UploadAtlas();
+	m_bValid = (m_textureID != 0) && (m_bakedItems.empty() == false);
+	m_stats.bakeMilliseconds = TraceProfiler::NowMilliseconds() - startTime;
+
+	PrintStats();
+	return(m_bValid);
+}
+
+/***********************************************************
+ *  PackAtlas()
+ *
+ *  This method is used to size the tiles of every bakeable
+ *  draw by its world extent and to place them on shelves in
+ *  the atlas, the largest first.  Draws that no longer fit
+ *  keep the lighting of the shader.
+ ***********************************************************/
+void LightmapBaker::PackAtlas(const RenderQueue& renderQueue, int itemCount)
+{
+	m_bakedItems.clear();
+	for (int i = 0; i < itemCount; i++)
+	{
+		const RenderQueue::DRAW_ITEM& item = renderQueue.GetItem(i);
+		if ((IsBakeable(item.meshShape) == false) || (RenderQueue::IsTransparent(item) == true))
+		{
+			continue;
+		}
+
+		glm::vec3 worldMin;
+		glm::vec3 worldMax;
+		GetWorldBounds(item.meshShape, item.model, worldMin, worldMax);
+		glm::vec3 size = worldMax - worldMin;
+		float extent = std::max(size.x, std::max(size.y, size.z));
+
+		BAKED_ITEM baked;
+		baked.itemIndex = i;
+		baked.meshShape = item.meshShape;
+		baked.model = item.model;
+		baked.tileTexels = glm::clamp((int)std::ceil(extent * TEXELS_PER_UNIT), MIN_TILE_TEXELS, MAX_TILE_TEXELS);
+		baked.atlasX = 0;
+		baked.atlasY = 0;
+		m_bakedItems.push_back(baked);
+	}
+
+	std::stable_sort(m_bakedItems.begin(), m_bakedItems.end(),
+		[](const BAKED_ITEM& a, const BAKED_ITEM& b) { return a.tileTexels > b.tileTexels; });
+
+	int shelfX = 0;
+	int shelfY = 0;
+	int shelfHeight = 0;
+	size_t placed = 0;
+	for (size_t i = 0; i < m_bakedItems.size(); i++)
+	{
+		BAKED_ITEM& baked = m_bakedItems[i];
+		int width = baked.tileTexels * TILE_COLUMNS;
+		int height = baked.tileTexels * (FACE_TILES / TILE_COLUMNS);
+		if (shelfX + width > ATLAS_SIZE)
+		{
+			shelfY += shelfHeight;
+			shelfX = 0;
+			shelfHeight = 0;
+		}
+		if (shelfY + height > ATLAS_SIZE)
+		{
+			break;
+		}
+		baked.atlasX = shelfX;
+		baked.atlasY = shelfY;
+		shelfX += width;
+		shelfHeight = std::max(shelfHeight, height);
+		placed++;
+	}
+
+	if (placed < m_bakedItems.size())
+	{
+		std::cout << "WARNING: Lightmap atlas is full, " << (m_bakedItems.size() - placed)
+			<< " draws are not baked" << std::endl;
+		m_bakedItems.resize(placed);
+	}
+
+	m_atlasHeight = shelfY + shelfHeight;
+	m_atlas.assign((size_t)ATLAS_SIZE * m_atlasHeight * 3, 0.0f);
+}
+
+/***********************************************************
+ *  BuildBVH()
+ *
+ *  This method is used to collect every opaque draw of the
+ *  desk scene as an occluder and to build a bounding volume
+ *  hierarchy over their world space boxes.
+ ***********************************************************/
+void LightmapBaker::BuildBVH(const RenderQueue& renderQueue, int itemCount)
+{
+	m_occluders.clear();
+	m_nodes.clear();
+
+	for (int i = 0; i < itemCount; i++)
+	{
+		const RenderQueue::DRAW_ITEM& item = renderQueue.GetItem(i);
+		if ((IsOccluderShape(item.meshShape) == false) || (RenderQueue::IsTransparent(item) == true))
+		{
+			continue;
+		}
+
+		OCCLUDER occluder;
+		occluder.meshShape = item.meshShape;
+		occluder.meshParts = item.meshParts;
+		occluder.worldToLocal = glm::inverse(item.model);
+		GetWorldBounds(item.meshShape, item.model, occluder.boundsMin, occluder.boundsMax);
+		m_occluders.push_back(occluder);
+	}
+
+	if (m_occluders.empty() == false)
+	{
+		m_nodes.reserve(m_occluders.size() * 2);
+		m_nodes.push_back(BVH_NODE());
+		BuildNode(0, 0, (int)m_occluders.size());
+	}
+
+	m_stats.occluders = (int)m_occluders.size();
+	m_stats.bvhNodes = (int)m_nodes.size();
+}
+
+/***********************************************************
+ *  BuildNode()
+ *
+ *  This method is used to fill in a node for the passed in
+ *  occluders, splitting them at the median of their centers
+ *  along the longest axis.  The children of a node are
+ *  stored next to each other.
+ ***********************************************************/
+void LightmapBaker::BuildNode(int nodeIndex, int first, int count)
+{
+	glm::vec3 boundsMin = glm::vec3(1.0e30f);
+	glm::vec3 boundsMax = glm::vec3(-1.0e30f);
+	glm::vec3 centerMin = glm::vec3(1.0e30f);
+	glm::vec3 centerMax = glm::vec3(-1.0e30f);
+	for (int i = first; i < first + count; i++)
+	{
+		boundsMin = glm::min(boundsMin, m_occluders[i].boundsMin);
+		boundsMax = glm::max(boundsMax, m_occluders[i].boundsMax);
+		glm::vec3 center = (m_occluders[i].boundsMin + m_occluders[i].boundsMax) * 0.5f;
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+	m_nodes[nodeIndex].boundsMin = boundsMin;
+	m_nodes[nodeIndex].boundsMax = boundsMax;
+
+	if (count <= BVH_LEAF_SIZE)
+	{
+		m_nodes[nodeIndex].first = first;
+		m_nodes[nodeIndex].count = count;
+		return;
+	}
+
+	int axis = DominantAxis(centerMax - centerMin);
+	int half = count / 2;
+	std::nth_element(m_occluders.begin() + first, m_occluders.begin() + first + half, m_occluders.begin() + first + count,
+		[axis](const OCCLUDER& a, const OCCLUDER& b)
+		{
+			return (a.boundsMin[axis] + a.boundsMax[axis]) < (b.boundsMin[axis] + b.boundsMax[axis]);
+		});
+
+	int childIndex = (int)m_nodes.size();
+	m_nodes[nodeIndex].first = childIndex;
+	m_nodes[nodeIndex].count = 0;
+	m_nodes.push_back(BVH_NODE());
+	m_nodes.push_back(BVH_NODE());
+	BuildNode(childIndex, first, half);
+	BuildNode(childIndex + 1, first + half, count - half);
+}
+
+/***********************************************************
+ *  IsOccluded()
+ *
+ *  This method is used to trace a shadow ray through the
+ *  BVH.  The ray ends at origin + direction * tMax, and any
+ *  hit before that ends the search.
+ ***********************************************************/
+bool LightmapBaker::IsOccluded(const glm::vec3& origin, const glm::vec3& direction, float tMax) const
+{
+	if (m_nodes.empty() == true)
+	{
+		return(false);
+	}
+
+	glm::vec3 inverseDirection = 1.0f / direction;
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const BVH_NODE& node = m_nodes[stack[--stackSize]];
+		if (RayHitsBox(origin, inverseDirection, tMax, node.boundsMin, node.boundsMax) == false)
+		{
+			continue;
+		}
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				const OCCLUDER& occluder = m_occluders[i];
+				// the direction is not normalized, so t is the same
+				// in object space as in world space
+				glm::vec3 localOrigin = glm::vec3(occluder.worldToLocal * glm::vec4(origin, 1.0f));
+				glm::vec3 localDirection = glm::vec3(occluder.worldToLocal * glm::vec4(direction, 0.0f));
+				float tHit;
+				glm::vec3 normal;
+				if (IntersectShape(occluder.meshShape, occluder.meshParts, localOrigin, localDirection, 0.0f, tMax, tHit, normal) == true)
+				{
+					return(true);
+				}
+			}
+		}
+		else if (stackSize + 2 <= BVH_STACK_SIZE)
+		{
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = node.first + 1;
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  BakeTiles()
+ *
+ *  This method is used to bake every face tile of the baked
+ *  draws.  The tiles are handed out to one worker thread per
+ *  core, and each tile is written by a single thread.
+ ***********************************************************/
+void LightmapBaker::BakeTiles(const RenderQueue& renderQueue, const BAKE_LIGHTS& lights)
+{
+	int jobCount = (int)m_bakedItems.size() * FACE_TILES;
+	int threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, std::max(jobCount, 1));
+
+	std::atomic<int> nextJob(0);
+	std::atomic<long long> rayCount(0);
+	std::atomic<int> coveredTexels(0);
+
+	auto worker = [&]()
+	{
+		long long threadRays = 0;
+		int threadCovered = 0;
+		int job;
+		while ((job = nextJob++) < jobCount)
+		{
+			threadCovered += BakeTile(renderQueue, lights, job / FACE_TILES, job % FACE_TILES, threadRays);
+		}
+		rayCount += threadRays;
+		coveredTexels += threadCovered;
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < threadCount; i++)
+	{
+		threads.push_back(std::thread(worker));
+	}
+	worker();
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+
+	m_stats.texels = 0;
+	for (size_t i = 0; i < m_bakedItems.size(); i++)
+	{
+		m_stats.texels += m_bakedItems[i].tileTexels * m_bakedItems[i].tileTexels * FACE_TILES;
+	}
+	m_stats.coveredTexels = coveredTexels;
+	m_stats.rayCount = rayCount;
+	m_stats.threadCount = threadCount;
+}
+
+/***********************************************************
+ *  BakeTile()
+ *
+ *  This method is used to bake one face tile of a draw.
+ *  Every texel casts a ray from its face of the shape bounds
+ *  into the shape; the hit is the texel's surface point when
+ *  its normal points along the tile's face direction.  The
+ *  texel then stores the light that reaches that point:
+ *
+ *    ambient * occlusion + diffuse * material diffuse color
+ *
+ *  which the fragment shader multiplies with the base color,
+ *  just like its Phong terms without the specular.
+ ***********************************************************/
+int LightmapBaker::BakeTile(const RenderQueue& renderQueue, const BAKE_LIGHTS& lights, int bakedIndex, int tile, long long& rayCount)
+{
+	// the two bounds axes that map to the tile's u and v for
+	// the x, y and z face directions - must match the shader
+	static const int TILE_AXES[3][2] = { { 2, 1 }, { 0, 2 }, { 0, 1 } };
+	const float FACE_OFFSET = 0.001f;
+
+	const BAKED_ITEM& baked = m_bakedItems[bakedIndex];
+	const RenderQueue::DRAW_ITEM& item = renderQueue.GetItem(baked.itemIndex);
+	int axis = tile / 2;
+	float faceSign = ((tile % 2) == 0) ? 1.0f : -1.0f;
+	int tileTexels = baked.tileTexels;
+
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	GetShapeBounds(baked.meshShape, boundsMin, boundsMax);
+	glm::vec3 boundsSize = boundsMax - boundsMin;
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(baked.model)));
+
+	glm::vec3 localDirection = glm::vec3(0.0f);
+	localDirection[axis] = -faceSign * boundsSize[axis];
+
+	// the hemisphere samples repeat for every run of the bake
+	std::mt19937 generator((unsigned int)(bakedIndex * FACE_TILES + tile));
+	std::uniform_real_distribution<float> random(0.0f, 1.0f);
+
+	std::vector<glm::vec3> texels(tileTexels * tileTexels, glm::vec3(0.0f));
+	std::vector<bool> covered(tileTexels * tileTexels, false);
+	int coveredCount = 0;
+
+	for (int v = 0; v < tileTexels; v++)
+	{
+		for (int u = 0; u < tileTexels; u++)
+		{
+			glm::vec3 position01;
+			position01[TILE_AXES[axis][0]] = (u + 0.5f) / tileTexels;
+			position01[TILE_AXES[axis][1]] = (v + 0.5f) / tileTexels;
+			position01[axis] = (faceSign > 0.0f) ? (1.0f + FACE_OFFSET) : -FACE_OFFSET;
+			glm::vec3 localOrigin = boundsMin + position01 * boundsSize;
+
+			float tHit;
+			glm::vec3 localNormal;
+			if (IntersectShape(baked.meshShape, item.meshParts, localOrigin, localDirection,
+				0.0f, 1.0f + 2.0f * FACE_OFFSET, tHit, localNormal) == false)
+			{
+				continue;
+			}
+			if ((DominantAxis(localNormal) != axis) || (localNormal[axis] * faceSign <= 0.0f))
+			{
+				continue;
+			}
+
+			glm::vec3 position = glm::vec3(baked.model * glm::vec4(localOrigin + localDirection * tHit, 1.0f));
+			glm::vec3 normal = glm::normalize(normalMatrix * localNormal);
+			glm::vec3 rayOrigin = position + normal * SURFACE_BIAS;
+
+			glm::vec3 ambient = glm::vec3(0.0f);
+			glm::vec3 diffuse = glm::vec3(0.0f);
+
+			if (lights.bDirectionalActive == true)
+			{
+				ambient += lights.directionalAmbient;
+				glm::vec3 lightDirection = glm::normalize(-lights.directionalDirection);
+				float diffuseImpact = glm::dot(normal, lightDirection);
+				if (diffuseImpact > 0.0f)
+				{
+					rayCount++;
+					if (IsOccluded(rayOrigin, lightDirection, SHADOW_DISTANCE) == false)
+					{
+						diffuse += lights.directionalDiffuse * diffuseImpact;
+					}
+				}
+			}
+
+			for (size_t i = 0; i < lights.pointLights.size(); i++)
+			{
+				const ClusteredLighting::POINT_LIGHT& light = lights.pointLights[i];
+				if (light.bActive == false)
+				{
+					continue;
+				}
+				glm::vec3 toLight = light.position - position;
+				float distance = glm::length(toLight);
+				float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+				ambient += light.ambient * attenuation;
+
+				float diffuseImpact = (distance > 0.0f) ? glm::dot(normal, toLight / distance) : 0.0f;
+				if (diffuseImpact > 0.0f)
+				{
+					rayCount++;
+					if (IsOccluded(rayOrigin, light.position - rayOrigin, 1.0f) == false)
+					{
+						diffuse += light.diffuse * diffuseImpact * attenuation;
+					}
+				}
+			}
+
+			// cosine weighted hemisphere around the normal
+			glm::vec3 tangent = glm::normalize(glm::cross(normal,
+				(std::fabs(normal.x) > 0.9f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f)));
+			glm::vec3 bitangent = glm::cross(normal, tangent);
+			int blocked = 0;
+			for (int sample = 0; sample < AO_SAMPLES; sample++)
+			{
+				float radius = std::sqrt(random(generator));
+				float angle = 6.2831853f * random(generator);
+				glm::vec3 direction = tangent * (radius * std::cos(angle)) +
+					bitangent * (radius * std::sin(angle)) +
+					normal * std::sqrt(std::max(0.0f, 1.0f - radius * radius));
+				if (IsOccluded(rayOrigin, direction * AO_DISTANCE, 1.0f) == true)
+				{
+					blocked++;
+				}
+			}
+			rayCount += AO_SAMPLES;
+			float occlusion = 1.0f - (float)blocked / AO_SAMPLES;
+
+			int texel = v * tileTexels + u;
+			texels[texel] = ambient * occlusion + diffuse * item.diffuseColor;
+			covered[texel] = true;
+			coveredCount++;
+		}
+	}
+
+	DilateTile(texels, covered, tileTexels);
+
+	int tileX = baked.atlasX + (tile % TILE_COLUMNS) * tileTexels;
+	int tileY = baked.atlasY + (tile / TILE_COLUMNS) * tileTexels;
+	for (int v = 0; v < tileTexels; v++)
+	{
+		float* pRow = &m_atlas[((size_t)(tileY + v) * ATLAS_SIZE + tileX) * 3];
+		for (int u = 0; u < tileTexels; u++)
+		{
+			const glm::vec3& value = texels[v * tileTexels + u];
+			pRow[u * 3] = value.r;
+			pRow[u * 3 + 1] = value.g;
+			pRow[u * 3 + 2] = value.b;
+		}
+	}
+	return(coveredCount);
+}
+
+/***********************************************************
+ *  DilateTile()
+ *
+ *  This method is used to grow the covered texels into the
+ *  empty ones around them.  Filtering and the normals that
+ *  pick the tile at the edges of a face can sample a texel
+ *  just outside of the covered area.
+ ***********************************************************/
+void LightmapBaker::DilateTile(std::vector<glm::vec3>& texels, std::vector<bool>& covered, int tileTexels) const
+{
+	const int DILATE_PASSES = 2;
+
+	for (int pass = 0; pass < DILATE_PASSES; pass++)
+	{
+		std::vector<bool> filled = covered;
+		for (int v = 0; v < tileTexels; v++)
+		{
+			for (int u = 0; u < tileTexels; u++)
+			{
+				if (covered[v * tileTexels + u] == true)
+				{
+					continue;
+				}
+
+				glm::vec3 sum = glm::vec3(0.0f);
+				int count = 0;
+				for (int dv = -1; dv <= 1; dv++)
+				{
+					for (int du = -1; du <= 1; du++)
+					{
+						int nu = u + du;
+						int nv = v + dv;
+						if ((nu < 0) || (nv < 0) || (nu >= tileTexels) || (nv >= tileTexels) ||
+							(covered[nv * tileTexels + nu] == false))
+						{
+							continue;
+						}
+						sum += texels[nv * tileTexels + nu];
+						count++;
+					}
+				}
+				if (count > 0)
+				{
+					texels[v * tileTexels + u] = sum / (float)count;
+					filled[v * tileTexels + u] = true;
+				}
+			}
+		}
+		covered = filled;
+	}
+}
+
+/***********************************************************
+ *  UploadAtlas()
+ *
+ *  This method is used to create the atlas texture from the
+ *  baked texels.  The rows past the used height stay empty.
+ ***********************************************************/
+void LightmapBaker::UploadAtlas()
+{
+	if (m_atlasHeight <= 0)
+	{
+		return;
+	}
+
+	glGenTextures(1, &m_textureID);
+	glBindTexture(GL_TEXTURE_2D, m_textureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, ATLAS_SIZE, ATLAS_SIZE, 0, GL_RGB, GL_FLOAT, NULL);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ATLAS_SIZE, m_atlasHeight, GL_RGB, GL_FLOAT, m_atlas.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/***********************************************************
+ *  GetItemLightmap()
+ *
+ *  This method is used to get the lightmap values the
+ *  shaders need for a queued draw.  The rect holds the atlas
+ *  position of the first tile, the tile size in atlas UV and
+ *  the tile size in texels.
+ ***********************************************************/
+bool LightmapBaker::GetItemLightmap(int itemIndex, const RenderQueue::DRAW_ITEM& item, glm::vec4& rect, glm::mat4& transform) const
+{
+	if ((m_bValid == false) || (itemIndex < 0) || (itemIndex >= (int)m_itemLookup.size()) ||
+		(m_itemLookup[itemIndex] < 0))
+	{
+		return(false);
+	}
+
+	const BAKED_ITEM& baked = m_bakedItems[m_itemLookup[itemIndex]];
+	if ((item.meshShape != baked.meshShape) || (item.model != baked.model))
+	{
+		return(false);
+	}
+
+	rect = glm::vec4(
+		(float)baked.atlasX / ATLAS_SIZE,
+		(float)baked.atlasY / ATLAS_SIZE,
+		(float)baked.tileTexels / ATLAS_SIZE,
+		(float)baked.tileTexels);
+	transform = GetLightmapTransform(baked.meshShape);
+	return(true);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used to bind the atlas to its unit.
+ ***********************************************************/
+void LightmapBaker::Bind() const
+{
+	glActiveTexture(GL_TEXTURE0 + LIGHTMAP_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_textureID);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used to print what the bake covered and
+ *  how long it took.
+ ***********************************************************/
+void LightmapBaker::PrintStats() const
+{
+	std::cout << std::fixed << std::setprecision(2)
+		<< "INFO: Lightmaps " << (m_stats.bFromCache ? "loaded from the cache" : "baked") << " for "
+		<< m_stats.bakedItems << " draws, atlas " << ATLAS_SIZE << "x" << m_atlasHeight << " used, "
+		<< m_stats.bakeMilliseconds << " ms";
+	if (m_stats.bFromCache == false)
+	{
+		std::cout << " on " << m_stats.threadCount << " threads: "
+			<< m_stats.coveredTexels << " of " << m_stats.texels << " texels covered, "
+			<< m_stats.rayCount << " rays against " << m_stats.occluders << " occluders ("
+			<< m_stats.bvhNodes << " BVH nodes)";
+	}
+	std::cout << std::endl;
+}
+
+/***********************************************************
+ *  HashBakeInputs()
+ *
+ *  This method is used to hash the draws and lights that
+ *  the baked texels depend on, the key of the cache file.
+ ***********************************************************/
+uint64_t LightmapBaker::HashBakeInputs(const RenderQueue& renderQueue, int itemCount, const BAKE_LIGHTS& lights)
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+	int layout[3] = { ATLAS_SIZE, itemCount, (int)CACHE_VERSION };
+	hash = HashBytes(hash, layout, sizeof(layout));
+
+	for (int i = 0; i < itemCount; i++)
+	{
+		const RenderQueue::DRAW_ITEM& item = renderQueue.GetItem(i);
+		int shape[2] = { item.meshShape, item.meshParts };
+		hash = HashBytes(hash, shape, sizeof(shape));
+		hash = HashBytes(hash, &item.model, sizeof(item.model));
+		hash = HashBytes(hash, &item.diffuseColor, sizeof(item.diffuseColor));
+		hash = HashBytes(hash, &item.opacity, sizeof(item.opacity));
+	}
+
+	int directionalActive = lights.bDirectionalActive ? 1 : 0;
+	hash = HashBytes(hash, &directionalActive, sizeof(directionalActive));
+	hash = HashBytes(hash, &lights.directionalDirection, sizeof(lights.directionalDirection));
+	hash = HashBytes(hash, &lights.directionalAmbient, sizeof(lights.directionalAmbient));
+	hash = HashBytes(hash, &lights.directionalDiffuse, sizeof(lights.directionalDiffuse));
+	for (size_t i = 0; i < lights.pointLights.size(); i++)
+	{
+		const ClusteredLighting::POINT_LIGHT& light = lights.pointLights[i];
+		if (light.bActive == false)
+		{
+			continue;
+		}
+		float values[12] = {
+			light.position.x, light.position.y, light.position.z,
+			light.ambient.r, light.ambient.g, light.ambient.b,
+			light.diffuse.r, light.diffuse.g, light.diffuse.b,
+			light.constant, light.linear, light.quadratic };
+		hash = HashBytes(hash, values, sizeof(values));
+	}
+	return(hash);
+}
+
+/***********************************************************
+ *  LoadCache()
+ *
+ *  This method is used to read the baked items and atlas
+ *  rows from the cache file, when its key matches.
+ ***********************************************************/
+bool LightmapBaker::LoadCache(const char* filename, uint64_t key, const RenderQueue& renderQueue)
+{
+	FILE* pFile = fopen(filename, "rb");
+	if (NULL == pFile)
+	{
+		return(false);
+	}
+
+	std::vector<unsigned char> data;
+	unsigned char buffer[65536];
+	size_t bytesRead = 0;
+	while ((bytesRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+	{
+		data.insert(data.end(), buffer, buffer + bytesRead);
+	}
+	fclose(pFile);
+
+	const size_t HEADER_SIZE = 4 + sizeof(uint32_t) + sizeof(uint64_t) + 2 * sizeof(uint32_t);
+	const size_t ITEM_SIZE = 5 * sizeof(int32_t);
+	if ((data.size() < HEADER_SIZE) || (memcmp(data.data(), CACHE_MAGIC, 4) != 0))
+	{
+		return(false);
+	}
+
+	const unsigned char* pData = data.data() + 4;
+	uint32_t version = GetValue<uint32_t>(pData);
+	uint64_t fileKey = GetValue<uint64_t>(pData);
+	uint32_t itemCount = GetValue<uint32_t>(pData);
+	uint32_t atlasHeight = GetValue<uint32_t>(pData);
+	size_t atlasFloats = (size_t)ATLAS_SIZE * atlasHeight * 3;
+	if ((version != CACHE_VERSION) || (fileKey != key) || (atlasHeight > (uint32_t)ATLAS_SIZE) ||
+		(data.size() < HEADER_SIZE + itemCount * ITEM_SIZE + atlasFloats * sizeof(float)))
+	{
+		return(false);
+	}
+
+	m_bakedItems.resize(itemCount);
+	for (uint32_t i = 0; i < itemCount; i++)
+	{
+		BAKED_ITEM& baked = m_bakedItems[i];
+		baked.itemIndex = GetValue<int32_t>(pData);
+		baked.meshShape = GetValue<int32_t>(pData);
+		baked.tileTexels = GetValue<int32_t>(pData);
+		baked.atlasX = GetValue<int32_t>(pData);
+		baked.atlasY = GetValue<int32_t>(pData);
+		if ((baked.itemIndex < 0) || (baked.itemIndex >= renderQueue.GetItemCount()))
+		{
+			m_bakedItems.clear();
+			return(false);
+		}
+		// the key matched, so the draw is where it was baked
+		baked.model = renderQueue.GetItem(baked.itemIndex).model;
+	}
+
+	m_atlasHeight = (int)atlasHeight;
+	m_atlas.resize(atlasFloats);
+	if (atlasFloats > 0)
+	{
+		memcpy(m_atlas.data(), pData, atlasFloats * sizeof(float));
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  SaveCache()
+ *
+ *  This method is used to write the baked items and the
+ *  used atlas rows to the cache file.
+ ***********************************************************/
+void LightmapBaker::SaveCache(const char* filename, uint64_t key) const
+{
+	FILE* pFile = fopen(filename, "wb");
+	if (NULL == pFile)
+	{
+		std::cout << "WARNING: Could not write the lightmap cache: " << filename << std::endl;
+		return;
+	}
+
+	std::vector<unsigned char> data;
+	data.insert(data.end(), CACHE_MAGIC, CACHE_MAGIC + 4);
+	PutValue<uint32_t>(data, CACHE_VERSION);
+	PutValue<uint64_t>(data, key);
+	PutValue<uint32_t>(data, (uint32_t)m_bakedItems.size());
+	PutValue<uint32_t>(data, (uint32_t)m_atlasHeight);
+	for (size_t i = 0; i < m_bakedItems.size(); i++)
+	{
+		const BAKED_ITEM& baked = m_bakedItems[i];
+		PutValue<int32_t>(data, baked.itemIndex);
+		PutValue<int32_t>(data, baked.meshShape);
+		PutValue<int32_t>(data, baked.tileTexels);
+		PutValue<int32_t>(data, baked.atlasX);
+		PutValue<int32_t>(data, baked.atlasY);
+	}
+
+	bool bWritten = (fwrite(data.data(), 1, data.size(), pFile) == data.size());
+	if (m_atlas.empty() == false)
+	{
+		bWritten = bWritten && (fwrite(m_atlas.data(), sizeof(float), m_atlas.size(), pFile) == m_atlas.size());
+	}
+	fclose(pFile);
+
+	if (bWritten == false)
+	{
+		std::cout << "WARNING: Could not write the lightmap cache: " << filename << std::endl;
+	}
+}
@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.h
+// ============
+// CPU lightmap baker for the static desk scene - the direct lighting of the
+// scene lights and the ambient occlusion are ray traced on every core
+// against a BVH of the scene's primitives and stored in a lightmap atlas
+//
+//  The basic meshes have no second UV set, so the lightmap UVs are derived
+//  in the shaders: each baked draw gets six tiles in the atlas, one per box
+//  face direction, and a fragment samples the tile of the axis its object
+//  space normal points along.  The baked texels are found by casting a ray
+//  from the same box face onto the analytic shape of the mesh.
+//
+//  The atlas is written to a cache file next to the executable, keyed by a
+//  hash of the draws and lights, so an unchanged scene is baked only once.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ClusteredLighting.h"
+#include "RenderQueue.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  LightmapBaker
+ *
+ *  This class contains the baked draws, the lightmap atlas
+ *  and its texture.
+ ***********************************************************/
+class LightmapBaker
+{
+public:
+	// texture unit of the lightmap atlas
+	static const int LIGHTMAP_TEXTURE_UNIT = 17;
+	// width and height of the atlas in texels
+	static const int ATLAS_SIZE = 1024;
+
+	// the lights the scene is baked with
+	struct BAKE_LIGHTS
+	{
+		bool bDirectionalActive;
+		glm::vec3 directionalDirection;
+		glm::vec3 directionalAmbient;
+		glm::vec3 directionalDiffuse;
+		std::vector<ClusteredLighting::POINT_LIGHT> pointLights;
+	};
+
+	struct BAKE_STATS
+	{
+		int bakedItems;
+		int occluders;
+		int bvhNodes;
+		int texels;			// texels of the baked tiles
+		int coveredTexels;	// texels that found a surface
+		int threadCount;
+		long long rayCount;
+		double bakeMilliseconds;
+		bool bFromCache;
+	};
+
+	// constructor
+	LightmapBaker();
+	// destructor
+	~LightmapBaker();
+
+	// bake the first itemCount draws of the queue, or load them from
+	// the cache file when it was baked from the same draws and lights
+	bool Bake(const RenderQueue& renderQueue, int itemCount, const BAKE_LIGHTS& lights, const char* cacheFilename);
+	// free the atlas texture
+	void Destroy();
+
+	bool IsValid() const { return m_bValid; }
+
+	// atlas rectangle and lightmap transform of a queued draw - false
+	// when the draw is not baked or was moved since the bake
+	bool GetItemLightmap(int itemIndex, const RenderQueue::DRAW_ITEM& item, glm::vec4& rect, glm::mat4& transform) const;
+
+	// bind the atlas to its texture unit
+	void Bind() const;
+
+	const BAKE_STATS& GetStats() const { return m_stats; }
+	// print the baked draws, the coverage and the bake time
+	void PrintStats() const;
+
+private:
+	// one draw with lightmap tiles in the atlas
+	struct BAKED_ITEM
+	{
+		int itemIndex;
+		int meshShape;
+		glm::mat4 model;
+		int tileTexels;
+		int atlasX;
+		int atlasY;
+	};
+
+	// one shape that can shadow the baked texels
+	struct OCCLUDER
+	{
+		int meshShape;
+		int meshParts;
+		glm::mat4 worldToLocal;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	struct BVH_NODE
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		// leaves hold count occluders starting at first, inner nodes
+		// have count 0 and their children at first and first + 1
+		int first;
+		int count;
+	};
+
+	std::vector<BAKED_ITEM> m_bakedItems;
+	// baked item of each queue index, -1 for draws that are not baked
+	std::vector<int> m_itemLookup;
+	std::vector<OCCLUDER> m_occluders;
+	std::vector<BVH_NODE> m_nodes;
+	// RGB texels of the atlas rows that are in use
+	std::vector<float> m_atlas;
+	int m_atlasHeight;
+
+	GLuint m_textureID;
+	bool m_bValid;
+	BAKE_STATS m_stats;
+
+	// place the tiles of the bakeable draws in the atlas
+	void PackAtlas(const RenderQueue& renderQueue, int itemCount);
+	// collect the occluders and build the BVH over them
+	void BuildBVH(const RenderQueue& renderQueue, int itemCount);
+	void BuildNode(int nodeIndex, int first, int count);
+	// true when anything blocks the ray before tMax
+	bool IsOccluded(const glm::vec3& origin, const glm::vec3& direction, float tMax) const;
+	// bake the tiles of the baked items on all cores
+	void BakeTiles(const RenderQueue& renderQueue, const BAKE_LIGHTS& lights);
+	// bake one face tile of one item, returns the covered texels
+	int BakeTile(const RenderQueue& renderQueue, const BAKE_LIGHTS& lights, int bakedIndex, int tile, long long& rayCount);
+	// fill the texels without a surface from their neighbors
+	void DilateTile(std::vector<glm::vec3>& texels, std::vector<bool>& covered, int tileTexels) const;
+	// create the atlas texture
+	void UploadAtlas();
+
+	// hash of everything the baked texels depend on
+	static uint64_t HashBakeInputs(const RenderQueue& renderQueue, int itemCount, const BAKE_LIGHTS& lights);
+	bool LoadCache(const char* filename, uint64_t key, const RenderQueue& renderQueue);
+	void SaveCache(const char* filename, uint64_t key) const;
+};
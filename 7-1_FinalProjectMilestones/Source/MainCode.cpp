@@ -9,6 +9,7 @@
 
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -22,6 +23,16 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "MemoryTracker.h"
+#include "Benchmarks.h"
+#include "MipGenerator.h"
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "RegressionHarness.h"
+#include "PerfHud.h"
+#include "TraceProfiler.h"
+#include "GLCapture.h"
+#include "GLStateCache.h"
 
 // Namespace for declaring global variables
 namespace
@@ -38,12 +49,98 @@ namespace
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// offscreen render target whose resolution follows the frame time
+	DynamicResolution* g_DynamicResolution = nullptr;
+	// asynchronous readback of the displayed frames
+	FrameCapture* g_FrameCapture = nullptr;
+	// frame rate, frame time graph and draw counters over the scene
+	PerfHud* g_PerfHud = nullptr;
+
+	// shadow settings that can be changed from the command line
+	int g_ShadowQuality = ShadowMap::SHADOW_PCF_3X3;
+	bool g_bShadowCaching = true;
+
+	// point light settings that can be changed from the command line
+	int g_PointLightMode = ClusteredLighting::LIGHTS_CLUSTERED;
+	int g_StressLightCount = 0;
+	bool g_bRunLightBenchmark = false;
+
+	// draw order settings that can be changed from the command line
+	int g_RenderPath = RenderQueue::PATH_SORTED;
+	bool g_bDepthPrepass = false;
+	bool g_bShaderPermutations = true;
+	bool g_bRunShaderBenchmark = false;
+	bool g_bBakeLightmaps = false;
+	bool g_bRunLightmapBenchmark = false;
+	bool g_bRunDrawOrderBenchmark = false;
+	bool g_bOcclusionCulling = true;
+
+	// CPU render backend settings that can be changed from the command line
+	bool g_bSoftwareRaster = false;
+	int g_SoftwareThreadCount = 0;
+	bool g_bRunSoftwareBenchmark = false;
+
+	// texture streaming settings that can be changed from the command line
+	bool g_bTextureStreaming = true;
+	int g_TextureBudgetKB = 0;
+	int g_MipFilter = MipGenerator::MIP_FILTER_BOX;
+	bool g_bRunMipBenchmark = false;
+
+	// scene scaling settings that can be changed from the command line
+	int g_SceneGridColumns = 1;
+	int g_SceneGridRows = 1;
+	unsigned int g_SceneGridSeed = 4321;
+	bool g_bGridFrustumCulling = true;
+	bool g_bRunSceneScalingBenchmark = false;
+
+	// run the vertex cache benchmark of the mesh optimizer
+	bool g_bRunMeshBenchmark = false;
+	// run the query and refit benchmark of the pick tree
+	bool g_bRunPickingBenchmark = false;
+	// run the thumbnail benchmark of the multi-view pass
+	bool g_bRunMultiViewBenchmark = false;
+
+	// foliage settings that can be changed from the command line
+	float g_FoliageDensity = 1.0f;
+	unsigned int g_FoliageSeed = 1;
+	bool g_bFoliageSway = true;
+
+	// dynamic resolution settings that can be changed from the command line
+	bool g_bDynamicResolution = true;
+	double g_FrameBudgetMs = 0.0;
+	float g_MinResolutionScale = 0.5f;
+	int g_UpscaleFilter = DynamicResolution::UPSCALE_BILINEAR;
+
+	// frame capture settings that can be changed from the command line
+	const char* g_CapturePrefix = NULL;
+	int g_CaptureFormat = FrameCapture::CAPTURE_PNG;
+	int g_CaptureFrames = 0;
+
+	// show the performance HUD from the first frame
+	bool g_bShowPerfHud = false;
+
+	// GL command trace settings - the trace file, the frames to
+	// capture and the frames rendered before the capture starts
+	const char* g_GLTraceFile = NULL;
+	int g_GLTraceFrames = 1;
+	int g_GLTraceSkipFrames = 60;
+
+	// camera path files to record to or to replay from
+	const char* g_RecordCameraFile = NULL;
+	const char* g_ReplayCameraFile = NULL;
+
+	// regression run settings - the goldens directory and whether
+	// the goldens and the frame time baseline are rewritten
+	const char* g_RegressionDirectory = NULL;
+	bool g_bUpdateRegression = false;
+	bool g_bRegressionFailed = false;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+void ParseCommandLine(int argc, char* argv[]);
 
 
 /***********************************************************
@@ -54,6 +151,12 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// read the optional settings passed on the command line
+	ParseCommandLine(argc, argv);
+
+	// start the CPU trace when TRACE_PROFILE names an output file
+	TraceProfiler::Initialize();
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -75,22 +178,193 @@ int main(int argc, char* argv[])
 		return(EXIT_FAILURE);
 	}
 
+	// the GL trace hooks go in before any scene object is created
+	if (NULL != g_GLTraceFile)
+	{
+		int framebufferWidth = 0;
+		int framebufferHeight = 0;
+		glfwGetFramebufferSize(g_Window, &framebufferWidth, &framebufferHeight);
+		GLCapture::Start(
+			g_GLTraceFile,
+			g_GLTraceFrames,
+			g_GLTraceSkipFrames,
+			framebufferWidth,
+			framebufferHeight);
+	}
+
 	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"../../Utilities/shaders/vertexShader.glsl",
-		"../../Utilities/shaders/fragmentShader.glsl");
+	{
+		TRACE_SCOPE("LoadShaders");
+		g_ShaderManager->LoadShaders(
+			"shaders/sceneVertexShader.glsl",
+			"shaders/sceneFragmentShader.glsl");
+	}
 	g_ShaderManager->use();
 
 	// try to create a new scene manager object and prepare the 3D scene
 	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager->SetShadowQuality(g_ShadowQuality);
+	g_SceneManager->SetShadowCaching(g_bShadowCaching);
+	g_SceneManager->SetRenderPath(g_RenderPath);
+	g_SceneManager->SetDepthPrepass(g_bDepthPrepass);
+	g_SceneManager->SetShaderPermutations(g_bShaderPermutations);
+	g_SceneManager->SetOcclusionCulling(g_bOcclusionCulling);
+	g_SceneManager->SetTextureStreaming(g_bTextureStreaming, g_TextureBudgetKB);
+	g_SceneManager->SetMipFilter(g_MipFilter);
+	g_SceneManager->SetFoliage(g_FoliageDensity, g_FoliageSeed);
+	g_SceneManager->SetFoliageSway(g_bFoliageSway);
 	g_SceneManager->PrepareScene();
+	g_SceneManager->SetPointLightMode(g_PointLightMode);
+	g_SceneManager->AddStressLights(g_StressLightCount, 1234);
+	g_SceneManager->SetSceneGrid(g_SceneGridColumns, g_SceneGridRows, g_SceneGridSeed);
+	g_SceneManager->SetGridFrustumCulling(g_bGridFrustumCulling);
+	if (true == g_bBakeLightmaps)
+	{
+		g_SceneManager->BakeLightmaps();
+	}
+	if (true == g_bSoftwareRaster)
+	{
+		g_SceneManager->SetSoftwareRasterizer(true, g_SoftwareThreadCount);
+	}
+
+	// the benchmarks render their own frames and then exit
+	if (true == g_bRunLightBenchmark)
+	{
+		Benchmarks::RunLightScaling(g_Window, g_ViewManager, g_SceneManager);
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+	if (true == g_bRunDrawOrderBenchmark)
+	{
+		Benchmarks::RunDrawOrder(g_Window, g_ViewManager, g_SceneManager);
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+	if (true == g_bRunShaderBenchmark)
+	{
+		Benchmarks::RunShaderPermutations(g_Window, g_ViewManager, g_SceneManager);
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+	if (true == g_bRunSoftwareBenchmark)
+	{
+		Benchmarks::RunSoftwareRaster(g_Window, g_ViewManager, g_SceneManager);
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+	if (true == g_bRunLightmapBenchmark)
+	{
+		Benchmarks::RunLightmaps(g_Window, g_ViewManager, g_SceneManager);
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+	if (true == g_bRunMipBenchmark)
+	{
+		Benchmarks::RunMipGeneration(g_SceneManager);
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+	if (true == g_bRunSceneScalingBenchmark)
+	{
+		Benchmarks::RunSceneScaling(g_Window, g_ViewManager, g_SceneManager);
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+	if (true == g_bRunMeshBenchmark)
+	{
+		Benchmarks::RunMeshOptimization();
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+	if (true == g_bRunPickingBenchmark)
+	{
+		Benchmarks::RunPicking(g_Window, g_ViewManager, g_SceneManager);
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+	if (true == g_bRunMultiViewBenchmark)
+	{
+		Benchmarks::RunMultiView(g_SceneManager);
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+	if (NULL != g_RegressionDirectory)
+	{
+		g_bRegressionFailed = !RegressionHarness::Run(
+			g_ViewManager, g_SceneManager, g_RegressionDirectory, g_bUpdateRegression);
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+
+	// render the scene offscreen, at a scale that keeps the GPU
+	// time of a frame within the budget
+	if (true == g_bDynamicResolution)
+	{
+		int framebufferWidth = 0;
+		int framebufferHeight = 0;
+		glfwGetFramebufferSize(g_Window, &framebufferWidth, &framebufferHeight);
+
+		g_DynamicResolution = new DynamicResolution();
+		if (g_FrameBudgetMs > 0.0)
+		{
+			g_DynamicResolution->SetFrameBudget(g_FrameBudgetMs);
+		}
+		g_DynamicResolution->SetScaleRange(g_MinResolutionScale, 1.0f);
+		g_DynamicResolution->SetUpscaleFilter(g_UpscaleFilter);
+		if (g_DynamicResolution->Create(framebufferWidth, framebufferHeight) == false)
+		{
+			delete g_DynamicResolution;
+			g_DynamicResolution = NULL;
+		}
+	}
+
+	// drive the camera from a recorded path, or record this run
+	if (NULL != g_ReplayCameraFile)
+	{
+		if (g_ViewManager->StartCameraReplay(g_ReplayCameraFile) == false)
+		{
+			glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+		}
+	}
+	else if (NULL != g_RecordCameraFile)
+	{
+		g_ViewManager->StartCameraRecording(g_RecordCameraFile);
+	}
+
+	// record the displayed frames in the background
+	if (NULL != g_CapturePrefix)
+	{
+		int framebufferWidth = 0;
+		int framebufferHeight = 0;
+		glfwGetFramebufferSize(g_Window, &framebufferWidth, &framebufferHeight);
+
+		g_FrameCapture = new FrameCapture();
+		if (g_FrameCapture->Create(framebufferWidth, framebufferHeight, g_CaptureFormat, g_CapturePrefix, g_CaptureFrames) == false)
+		{
+			delete g_FrameCapture;
+			g_FrameCapture = NULL;
+		}
+	}
+
+	// the performance HUD is toggled with the H key
+	{
+		int framebufferWidth = 0;
+		int framebufferHeight = 0;
+		glfwGetFramebufferSize(g_Window, &framebufferWidth, &framebufferHeight);
+
+		g_PerfHud = new PerfHud();
+		g_PerfHud->Create(framebufferWidth, framebufferHeight);
+		g_ViewManager->SetPerfHudVisible(g_bShowPerfHud);
+	}
+	double lastFrameTime = glfwGetTime();
 
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
+		TRACE_SCOPE("Frame");
+
+		// latch the allocation counters of the previous frame
+		MemoryTracker::BeginFrame();
+		GLStateCache::BeginFrame();
+
+		// bind the scaled offscreen target
+		if (NULL != g_DynamicResolution)
+		{
+			g_DynamicResolution->BeginFrame();
+		}
+
+		// Enable z-depth - a no-op once the state cache knows it is on
+		GLStateCache::Enable(GL_DEPTH_TEST);
 
 		// Clear the frame and z buffers
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -98,26 +372,108 @@ int main(int argc, char* argv[])
 
 		// convert from 3D object space to 2D view
 		g_ViewManager->PrepareSceneView();
+		g_SceneManager->SetViewTransform(
+			g_ViewManager->GetViewMatrix(),
+			g_ViewManager->GetProjectionMatrix());
 
 		// refresh the 3D scene
 		g_SceneManager->RenderScene();
 
+		// pick the object under the cursor of a left click, among
+		// the draws of the frame that was just rendered
+		glm::vec3 pickOrigin;
+		glm::vec3 pickDirection;
+		if (g_ViewManager->TakePickRay(pickOrigin, pickDirection) == true)
+		{
+			SceneManager::PICKED_OBJECT picked;
+			g_SceneManager->PickObject(pickOrigin, pickDirection, picked);
+			g_SceneManager->PrintPickedObject(picked);
+		}
+
+		// upscale the offscreen target to the window
+		if (NULL != g_DynamicResolution)
+		{
+			g_DynamicResolution->EndFrame();
+		}
+
+		// draw the performance numbers over the window
+		if (NULL != g_PerfHud)
+		{
+			double frameTime = glfwGetTime();
+			const SceneManager::DRAW_COUNTERS& counters = g_SceneManager->GetDrawCounters();
+			PerfHud::HUD_FRAME_STATS hudStats;
+			hudStats.cpuMilliseconds = (frameTime - lastFrameTime) * 1000.0;
+			hudStats.gpuMilliseconds = g_SceneManager->GetFrameTiming().gpuMilliseconds;
+			hudStats.drawCalls = counters.drawCalls;
+			hudStats.triangles = counters.triangles;
+			hudStats.textureBinds = counters.textureBinds;
+			hudStats.uniformUploads = counters.uniformUploads;
+			hudStats.culledObjects = counters.culledObjects;
+			hudStats.filteredStateCalls = GLStateCache::GetLastFrameStats().filteredCalls;
+			MemoryTracker::FRAME_STATS allocationStats = MemoryTracker::GetLastFrameStats();
+			hudStats.allocations = allocationStats.allocations;
+			hudStats.allocatedBytes = allocationStats.bytesAllocated;
+			lastFrameTime = frameTime;
+
+			g_PerfHud->AddFrame(hudStats);
+			if (g_ViewManager->IsPerfHudVisible() == true)
+			{
+				g_PerfHud->Draw();
+			}
+		}
+
+		// start the readback of the finished frame
+		if (NULL != g_FrameCapture)
+		{
+			g_FrameCapture->CaptureFrame();
+		}
 
 		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+		{
+			TRACE_SCOPE("SwapBuffers");
+			glfwSwapBuffers(g_Window);
+		}
+		GLCapture::EndFrame();
 
 		// query the latest GLFW events
-		glfwPollEvents();
+		{
+			TRACE_SCOPE("PollEvents");
+			glfwPollEvents();
+		}
 	}
 
 	// clear the allocated manager objects from memory
+	if (NULL != g_PerfHud)
+	{
+		delete g_PerfHud;
+		g_PerfHud = NULL;
+	}
+	if (NULL != g_FrameCapture)
+	{
+		g_FrameCapture->Finish();
+		g_FrameCapture->PrintStats();
+		delete g_FrameCapture;
+		g_FrameCapture = NULL;
+	}
+	if (NULL != g_DynamicResolution)
+	{
+		g_DynamicResolution->PrintStats();
+		delete g_DynamicResolution;
+		g_DynamicResolution = NULL;
+	}
 	if (NULL != g_SceneManager)
 	{
+		g_SceneManager->PrintShadowStats();
+		g_SceneManager->PrintRenderStats();
+		g_SceneManager->PrintFrameTiming();
+		g_SceneManager->PrintTextureResidency();
+		GLStateCache::PrintStats();
 		delete g_SceneManager;
 		g_SceneManager = NULL;
 	}
 	if (NULL != g_ViewManager)
 	{
+		g_ViewManager->StopCameraPath();
 		delete g_ViewManager;
 		g_ViewManager = NULL;
 	}
@@ -127,10 +483,324 @@ int main(int argc, char* argv[])
 		g_ShaderManager = NULL;
 	}
 
+	// report the allocations made in each phase, including
+	// any memory that was never released
+	MemoryTracker::DumpSummary();
+
+	// write the CPU trace, after every worker thread has stopped
+	TraceProfiler::Shutdown();
+
+	// a failed regression run is reported through the exit code
+	if (true == g_bRegressionFailed)
+	{
+		exit(EXIT_FAILURE);
+	}
+
 	// Terminates the program successfully
 	exit(EXIT_SUCCESS); 
 }
 
+/***********************************************************
+ *	ParseCommandLine()
+ *
+ *  This function is used to read the optional settings
+ *  passed on the command line:
+ *    --shadow-quality <0-3>  0 off, 1 hard, 2 PCF 3x3, 3 PCF 5x5
+ *    --no-shadow-cache       re-render the shadow map every frame
+ *    --point-lights <mode>   fixed, clustered, all or object
+ *    --light-stress <count>  add randomly placed point lights
+ *    --bench-lights          run the point light scaling benchmark
+ *    --render-path <path>    source (recorded order) or sorted
+ *    --depth-prepass         lay down the opaque depth first
+ *    --bench-draw-order      compare the draw orders and pre-pass
+ *    --no-shader-permutations draw with the uber shader only
+ *    --bench-shaders         compare the uber shader with the
+ *                            specialized shader variants
+ *    --lightmaps             bake the desk lighting into lightmaps
+ *                            (cached in lightmaps.cache)
+ *    --bench-lightmaps       compare the baked and runtime lighting
+ *    --no-occlusion-culling  draw every object, even when hidden
+ *    --software-raster       draw the frames with the CPU rasterizer
+ *    --software-threads <n>  threads of the CPU rasterizer, 0 for
+ *                            every core
+ *    --bench-software        compare the GL frame time with the CPU
+ *                            rasterizer's over its thread counts;
+ *                            run with LIBGL_ALWAYS_SOFTWARE=1 to
+ *                            compare against llvmpipe
+ *    --texture-budget <KB>   texture bytes uploaded per frame
+ *    --no-texture-streaming  upload all textures before the first frame
+ *    --mip-filter <filter>   gpu (glGenerateMipmap), box or kaiser
+ *    --bench-mips            compare the texture mipmap load times
+ *    --scene-grid <c> <r>    repeat the desk over c x r desks
+ *    --scene-seed <n>        seed of the desk grid variations
+ *    --no-grid-culling       record every desk of the grid, even
+ *                            outside the view
+ *    --bench-scene-scaling   compare the frame phases over grid sizes
+ *    --bench-meshes          compare the vertex cache use of ring
+ *                            ordered and optimized meshes
+ *    --bench-picking         compare the pick tree with testing every
+ *                            draw over grid sizes, and time its refit
+ *    --bench-multiview       compare thumbnail views per second drawn
+ *                            with a pass per view and in one pass
+ *                            (atlas saved as thumbnails.ppm)
+ *    --foliage-density <x>   flowers and puffs of the vase plant,
+ *                            1.0 is 1024 flowers and 256 puffs
+ *    --foliage-seed <n>      seed of the foliage placement
+ *    --no-foliage-sway       keep the foliage still
+ *    --no-dynamic-resolution render at the window size every frame
+ *    --frame-budget <ms>     GPU time the resolution scale aims for
+ *    --min-scale <0.1-1>     lowest resolution scale
+ *    --upscale <filter>      bilinear or sharpen
+ *    --capture <prefix>      write the displayed frames to files
+ *    --capture-format <fmt>  png (one file per frame) or y4m
+ *    --capture-frames <n>    stop capturing after n frames
+ *    --regression <dir>      check the camera poses against the goldens
+ *                            in dir and exit with the result
+ *    --regression-update     rewrite the goldens and the baseline
+ *    --record-camera <file>  record the camera path of this run
+ *    --replay-camera <file>  replay a recorded camera path and exit
+ *    --perf-hud              show the performance HUD from the start
+ *    --gl-trace <file>       capture the GL calls of a frame for
+ *                            GLTraceReplay (ENABLE_GL_CAPTURE builds)
+ *    --gl-trace-frames <n>   frames to capture, 1 by default
+ *    --gl-trace-skip <n>     frames rendered before the capture
+ ***********************************************************/
+void ParseCommandLine(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "--shadow-quality") == 0) && (i + 1 < argc))
+		{
+			g_ShadowQuality = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--no-shadow-cache") == 0)
+		{
+			g_bShadowCaching = false;
+		}
+		else if ((strcmp(argv[i], "--point-lights") == 0) && (i + 1 < argc))
+		{
+			i++;
+			if (strcmp(argv[i], "fixed") == 0)
+			{
+				g_PointLightMode = ClusteredLighting::LIGHTS_FIXED;
+			}
+			else if (strcmp(argv[i], "all") == 0)
+			{
+				g_PointLightMode = ClusteredLighting::LIGHTS_ALL;
+			}
+			else if (strcmp(argv[i], "object") == 0)
+			{
+				g_PointLightMode = ClusteredLighting::LIGHTS_OBJECT;
+			}
+			else
+			{
+				g_PointLightMode = ClusteredLighting::LIGHTS_CLUSTERED;
+			}
+		}
+		else if ((strcmp(argv[i], "--light-stress") == 0) && (i + 1 < argc))
+		{
+			g_StressLightCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--bench-lights") == 0)
+		{
+			g_bRunLightBenchmark = true;
+		}
+		else if ((strcmp(argv[i], "--render-path") == 0) && (i + 1 < argc))
+		{
+			i++;
+			if (strcmp(argv[i], "source") == 0)
+			{
+				g_RenderPath = RenderQueue::PATH_SOURCE_ORDER;
+			}
+			else
+			{
+				g_RenderPath = RenderQueue::PATH_SORTED;
+			}
+		}
+		else if (strcmp(argv[i], "--depth-prepass") == 0)
+		{
+			g_bDepthPrepass = true;
+		}
+		else if (strcmp(argv[i], "--no-shader-permutations") == 0)
+		{
+			g_bShaderPermutations = false;
+		}
+		else if (strcmp(argv[i], "--bench-shaders") == 0)
+		{
+			g_bRunShaderBenchmark = true;
+		}
+		else if (strcmp(argv[i], "--lightmaps") == 0)
+		{
+			g_bBakeLightmaps = true;
+		}
+		else if (strcmp(argv[i], "--bench-lightmaps") == 0)
+		{
+			g_bRunLightmapBenchmark = true;
+		}
+		else if (strcmp(argv[i], "--bench-draw-order") == 0)
+		{
+			g_bRunDrawOrderBenchmark = true;
+		}
+		else if (strcmp(argv[i], "--no-occlusion-culling") == 0)
+		{
+			g_bOcclusionCulling = false;
+		}
+		else if (strcmp(argv[i], "--software-raster") == 0)
+		{
+			g_bSoftwareRaster = true;
+		}
+		else if ((strcmp(argv[i], "--software-threads") == 0) && (i + 1 < argc))
+		{
+			g_SoftwareThreadCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--bench-software") == 0)
+		{
+			g_bRunSoftwareBenchmark = true;
+		}
+		else if ((strcmp(argv[i], "--texture-budget") == 0) && (i + 1 < argc))
+		{
+			g_TextureBudgetKB = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--no-texture-streaming") == 0)
+		{
+			g_bTextureStreaming = false;
+		}
+		else if ((strcmp(argv[i], "--mip-filter") == 0) && (i + 1 < argc))
+		{
+			g_MipFilter = MipGenerator::ParseFilterName(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--bench-mips") == 0)
+		{
+			g_bRunMipBenchmark = true;
+		}
+		else if ((strcmp(argv[i], "--scene-grid") == 0) && (i + 2 < argc))
+		{
+			g_SceneGridColumns = atoi(argv[++i]);
+			g_SceneGridRows = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--scene-seed") == 0) && (i + 1 < argc))
+		{
+			g_SceneGridSeed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--no-grid-culling") == 0)
+		{
+			g_bGridFrustumCulling = false;
+		}
+		else if (strcmp(argv[i], "--bench-scene-scaling") == 0)
+		{
+			g_bRunSceneScalingBenchmark = true;
+		}
+		else if (strcmp(argv[i], "--bench-meshes") == 0)
+		{
+			g_bRunMeshBenchmark = true;
+		}
+		else if (strcmp(argv[i], "--bench-picking") == 0)
+		{
+			g_bRunPickingBenchmark = true;
+		}
+		else if (strcmp(argv[i], "--bench-multiview") == 0)
+		{
+			g_bRunMultiViewBenchmark = true;
+		}
+		else if ((strcmp(argv[i], "--foliage-density") == 0) && (i + 1 < argc))
+		{
+			g_FoliageDensity = (float)atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--foliage-seed") == 0) && (i + 1 < argc))
+		{
+			g_FoliageSeed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--no-foliage-sway") == 0)
+		{
+			g_bFoliageSway = false;
+		}
+		else if (strcmp(argv[i], "--no-dynamic-resolution") == 0)
+		{
+			g_bDynamicResolution = false;
+		}
+		else if ((strcmp(argv[i], "--frame-budget") == 0) && (i + 1 < argc))
+		{
+			g_FrameBudgetMs = atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--min-scale") == 0) && (i + 1 < argc))
+		{
+			g_MinResolutionScale = (float)atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--upscale") == 0) && (i + 1 < argc))
+		{
+			i++;
+			if (strcmp(argv[i], "sharpen") == 0)
+			{
+				g_UpscaleFilter = DynamicResolution::UPSCALE_SHARPEN;
+			}
+			else
+			{
+				g_UpscaleFilter = DynamicResolution::UPSCALE_BILINEAR;
+			}
+		}
+		else if ((strcmp(argv[i], "--capture") == 0) && (i + 1 < argc))
+		{
+			g_CapturePrefix = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--capture-format") == 0) && (i + 1 < argc))
+		{
+			i++;
+			if (strcmp(argv[i], "y4m") == 0)
+			{
+				g_CaptureFormat = FrameCapture::CAPTURE_Y4M;
+			}
+			else
+			{
+				g_CaptureFormat = FrameCapture::CAPTURE_PNG;
+			}
+		}
+		else if ((strcmp(argv[i], "--capture-frames") == 0) && (i + 1 < argc))
+		{
+			g_CaptureFrames = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--regression") == 0) && (i + 1 < argc))
+		{
+			// the images are only repeatable with every mipmap loaded
+			// and with still foliage
+			g_RegressionDirectory = argv[++i];
+			g_bTextureStreaming = false;
+			g_bFoliageSway = false;
+		}
+		else if (strcmp(argv[i], "--regression-update") == 0)
+		{
+			g_bUpdateRegression = true;
+		}
+		else if ((strcmp(argv[i], "--record-camera") == 0) && (i + 1 < argc))
+		{
+			g_RecordCameraFile = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--replay-camera") == 0) && (i + 1 < argc))
+		{
+			g_ReplayCameraFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--perf-hud") == 0)
+		{
+			g_bShowPerfHud = true;
+		}
+		else if ((strcmp(argv[i], "--gl-trace") == 0) && (i + 1 < argc))
+		{
+			g_GLTraceFile = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--gl-trace-frames") == 0) && (i + 1 < argc))
+		{
+			g_GLTraceFrames = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--gl-trace-skip") == 0) && (i + 1 < argc))
+		{
+			g_GLTraceSkipFrames = atoi(argv[++i]);
+		}
+		else
+		{
+			std::cout << "WARNING: Unknown command line option: " << argv[i] << std::endl;
+		}
+	}
+}
+
 /***********************************************************
  *	InitializeGLFW()
  * 
@@ -138,6 +808,7 @@ int main(int argc, char* argv[])
  ***********************************************************/
 bool InitializeGLFW()
 {
+	TRACE_SCOPE("InitializeGLFW");
 	// GLFW: initialize and configure library
 	// --------------------------------------
 	glfwInit();
@@ -165,6 +836,7 @@ bool InitializeGLFW()
  ***********************************************************/
 bool InitializeGLEW()
 {
+	TRACE_SCOPE("InitializeGLEW");
 	// GLEW: initialize
 	// -----------------------------------------
 	GLenum GLEWInitResult = GLEW_OK;
@@ -0,0 +1,509 @@
+///////////////////////////////////////////////////////////////////////////////
+// memorytracker.cpp
+// ============
+// optional global allocation tracker - attributes allocation counts and bytes
+// to named phases (PrepareScene, LoadSceneTextures, RenderScene, ...)
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MemoryTracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <new>
+
+#ifdef ENABLE_MEMORY_TRACKER
+
+// declaration of the global variables and defines
+namespace
+{
+	// every tracked block is preceded by this header so that the size
+	// and owning phase are known again when the block is released
+	struct BLOCK_HEADER
+	{
+		uint64_t size;
+		uint32_t phase;
+		uint32_t magic;
+	};
+
+	const uint32_t BLOCK_MAGIC = 0x4D454D54; // "MEMT"
+	const size_t HEADER_SIZE = 16;
+	static_assert(sizeof(BLOCK_HEADER) <= HEADER_SIZE, "block header must fit in the reserved prefix");
+
+	// maximum nesting depth of the phase stack on a single thread
+	const int MAX_PHASE_DEPTH = 16;
+
+	struct PHASE_SLOT
+	{
+		std::atomic<const char*> name;
+		std::atomic<uint64_t> allocations;
+		std::atomic<uint64_t> frees;
+		std::atomic<uint64_t> bytesAllocated;
+		std::atomic<uint64_t> bytesFreed;
+		std::atomic<int64_t> liveBytes;
+		std::atomic<int64_t> peakLiveBytes;
+	};
+
+	// slot 0 collects everything allocated outside of a named phase;
+	// the table is zero initialized before any constructor runs
+	PHASE_SLOT g_phases[MemoryTracker::MAX_PHASES];
+	std::atomic<int> g_phaseCount(1);
+	std::atomic_flag g_registerLock = ATOMIC_FLAG_INIT;
+
+	// counters for the frame that is currently being rendered
+	std::atomic<uint64_t> g_frameAllocations(0);
+	std::atomic<uint64_t> g_frameFrees(0);
+	std::atomic<uint64_t> g_frameBytesAllocated(0);
+	std::atomic<uint64_t> g_frameBytesFreed(0);
+	MemoryTracker::FRAME_STATS g_lastFrame = { 0, 0, 0, 0 };
+	uint64_t g_frameCount = 0;
+
+	// per-thread stack of active phases
+	thread_local int t_phaseStack[MAX_PHASE_DEPTH];
+	thread_local int t_phaseDepth = 0;
+
+	/***********************************************************
+	 *  FindOrRegisterPhase()
+	 *
+	 *  Return the slot index for the passed in phase name,
+	 *  claiming a new slot if the name has not been seen yet.
+	 *  No heap memory is used so this is safe to call while
+	 *  the allocation hooks are active.
+	 ***********************************************************/
+	int FindOrRegisterPhase(const char* phaseName)
+	{
+		int count = g_phaseCount.load(std::memory_order_acquire);
+		for (int i = 1; i < count; i++)
+		{
+			const char* name = g_phases[i].name.load(std::memory_order_relaxed);
+			if ((name == phaseName) || (strcmp(name, phaseName) == 0))
+			{
+				return(i);
+			}
+		}
+
+		while (g_registerLock.test_and_set(std::memory_order_acquire))
+		{
+		}
+
+		// another thread may have registered the phase in the meantime
+		int index = 0;
+		count = g_phaseCount.load(std::memory_order_relaxed);
+		for (int i = 1; (i < count) && (index == 0); i++)
+		{
+			if (strcmp(g_phases[i].name.load(std::memory_order_relaxed), phaseName) == 0)
+			{
+				index = i;
+			}
+		}
+		if ((index == 0) && (count < MemoryTracker::MAX_PHASES))
+		{
+			g_phases[count].name.store(phaseName, std::memory_order_relaxed);
+			g_phaseCount.store(count + 1, std::memory_order_release);
+			index = count;
+		}
+
+		g_registerLock.clear(std::memory_order_release);
+
+		// when the table is full the allocations fall back to slot 0
+		return(index);
+	}
+
+	/***********************************************************
+	 *  RecordAllocation()
+	 *
+	 *  Update the phase and frame counters for a new block.
+	 ***********************************************************/
+	void RecordAllocation(int phase, uint64_t size)
+	{
+		PHASE_SLOT& slot = g_phases[phase];
+		slot.allocations.fetch_add(1, std::memory_order_relaxed);
+		slot.bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+		int64_t live = slot.liveBytes.fetch_add((int64_t)size, std::memory_order_relaxed) + (int64_t)size;
+		int64_t peak = slot.peakLiveBytes.load(std::memory_order_relaxed);
+		while ((live > peak) &&
+			!slot.peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		{
+		}
+
+		g_frameAllocations.fetch_add(1, std::memory_order_relaxed);
+		g_frameBytesAllocated.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	/***********************************************************
+	 *  RecordFree()
+	 *
+	 *  Update the phase and frame counters for a released
+	 *  block.  Live bytes are returned to the owning phase,
+	 *  while the free itself is counted in the current phase.
+	 ***********************************************************/
+	void RecordFree(int owningPhase, uint64_t size)
+	{
+		int currentPhase = (t_phaseDepth > 0) ? t_phaseStack[t_phaseDepth - 1] : 0;
+
+		g_phases[owningPhase].liveBytes.fetch_sub((int64_t)size, std::memory_order_relaxed);
+		g_phases[currentPhase].frees.fetch_add(1, std::memory_order_relaxed);
+		g_phases[currentPhase].bytesFreed.fetch_add(size, std::memory_order_relaxed);
+
+		g_frameFrees.fetch_add(1, std::memory_order_relaxed);
+		g_frameBytesFreed.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	/***********************************************************
+	 *  TrackedAlloc()
+	 *
+	 *  Allocate a block with the tracking header in front.
+	 ***********************************************************/
+	void* TrackedAlloc(size_t size)
+	{
+		unsigned char* pBlock = (unsigned char*)malloc(size + HEADER_SIZE);
+		if (NULL == pBlock)
+		{
+			return(NULL);
+		}
+
+		int phase = (t_phaseDepth > 0) ? t_phaseStack[t_phaseDepth - 1] : 0;
+
+		BLOCK_HEADER* pHeader = (BLOCK_HEADER*)pBlock;
+		pHeader->size = size;
+		pHeader->phase = (uint32_t)phase;
+		pHeader->magic = BLOCK_MAGIC;
+
+		RecordAllocation(phase, size);
+
+		return(pBlock + HEADER_SIZE);
+	}
+
+	/***********************************************************
+	 *  TrackedFree()
+	 *
+	 *  Release a block that was allocated by TrackedAlloc().
+	 ***********************************************************/
+	void TrackedFree(void* pMemory)
+	{
+		if (NULL == pMemory)
+		{
+			return;
+		}
+
+		unsigned char* pBlock = (unsigned char*)pMemory - HEADER_SIZE;
+		BLOCK_HEADER* pHeader = (BLOCK_HEADER*)pBlock;
+		if (pHeader->magic != BLOCK_MAGIC)
+		{
+			// not one of ours - this should never happen, but leaking
+			// is safer than handing a foreign pointer to free()
+			return;
+		}
+
+		RecordFree((int)pHeader->phase, pHeader->size);
+		pHeader->magic = 0;
+		free(pBlock);
+	}
+}
+
+// global allocation hooks - every new/delete in the application is routed
+// through the tracker, including the mesh vertex arrays built in ShapeMeshes
+void* operator new(size_t size)
+{
+	void* pMemory = TrackedAlloc(size);
+	if (NULL == pMemory)
+	{
+		throw std::bad_alloc();
+	}
+	return(pMemory);
+}
+
+void* operator new[](size_t size)
+{
+	void* pMemory = TrackedAlloc(size);
+	if (NULL == pMemory)
+	{
+		throw std::bad_alloc();
+	}
+	return(pMemory);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return(TrackedAlloc(size));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return(TrackedAlloc(size));
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	TrackedFree(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+	TrackedFree(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+	TrackedFree(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+	TrackedFree(pMemory);
+}
+
+void operator delete(void* pMemory, const std::nothrow_t&) noexcept
+{
+	TrackedFree(pMemory);
+}
+
+void operator delete[](void* pMemory, const std::nothrow_t&) noexcept
+{
+	TrackedFree(pMemory);
+}
+
+/***********************************************************
+ *  IsEnabled()
+ *
+ *  The allocation hooks are compiled into this build.
+ ***********************************************************/
+bool MemoryTracker::IsEnabled()
+{
+	return(true);
+}
+
+/***********************************************************
+ *  PushPhase()
+ *
+ *  Make the passed in phase the target for all following
+ *  allocations on the calling thread.
+ ***********************************************************/
+void MemoryTracker::PushPhase(const char* phaseName)
+{
+	int phase = FindOrRegisterPhase(phaseName);
+	if (t_phaseDepth < MAX_PHASE_DEPTH)
+	{
+		t_phaseStack[t_phaseDepth] = phase;
+	}
+	t_phaseDepth++;
+}
+
+/***********************************************************
+ *  PopPhase()
+ *
+ *  Return to the phase that was active before the last
+ *  call to PushPhase() on the calling thread.
+ ***********************************************************/
+void MemoryTracker::PopPhase()
+{
+	if (t_phaseDepth > 0)
+	{
+		t_phaseDepth--;
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  Latch the counters of the frame that just finished and
+ *  start counting the next one.
+ ***********************************************************/
+void MemoryTracker::BeginFrame()
+{
+	g_lastFrame.allocations = g_frameAllocations.exchange(0, std::memory_order_relaxed);
+	g_lastFrame.frees = g_frameFrees.exchange(0, std::memory_order_relaxed);
+	g_lastFrame.bytesAllocated = g_frameBytesAllocated.exchange(0, std::memory_order_relaxed);
+	g_lastFrame.bytesFreed = g_frameBytesFreed.exchange(0, std::memory_order_relaxed);
+	g_frameCount++;
+}
+
+/***********************************************************
+ *  GetLastFrameStats()
+ *
+ *  Allocation activity of the previous complete frame.
+ ***********************************************************/
+MemoryTracker::FRAME_STATS MemoryTracker::GetLastFrameStats()
+{
+	return(g_lastFrame);
+}
+
+/***********************************************************
+ *  GetFrameCount()
+ *
+ *  Number of frame boundaries seen by BeginFrame().
+ ***********************************************************/
+uint64_t MemoryTracker::GetFrameCount()
+{
+	return(g_frameCount);
+}
+
+/***********************************************************
+ *  GetPhaseCount()
+ *
+ *  Number of phases, including the untracked slot 0.
+ ***********************************************************/
+int MemoryTracker::GetPhaseCount()
+{
+	return(g_phaseCount.load(std::memory_order_acquire));
+}
+
+/***********************************************************
+ *  GetPhaseStats()
+ *
+ *  Copy out the statistics for the phase at the passed in
+ *  index.
+ ***********************************************************/
+bool MemoryTracker::GetPhaseStats(int phaseIndex, PHASE_STATS& stats)
+{
+	if ((phaseIndex < 0) || (phaseIndex >= GetPhaseCount()))
+	{
+		return(false);
+	}
+
+	const PHASE_SLOT& slot = g_phases[phaseIndex];
+	stats.name = (phaseIndex == 0) ? "(untracked)" : slot.name.load(std::memory_order_relaxed);
+	stats.allocations = slot.allocations.load(std::memory_order_relaxed);
+	stats.frees = slot.frees.load(std::memory_order_relaxed);
+	stats.bytesAllocated = slot.bytesAllocated.load(std::memory_order_relaxed);
+	stats.bytesFreed = slot.bytesFreed.load(std::memory_order_relaxed);
+	stats.liveBytes = slot.liveBytes.load(std::memory_order_relaxed);
+	stats.peakLiveBytes = slot.peakLiveBytes.load(std::memory_order_relaxed);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Malloc() / Realloc() / Free()
+ *
+ *  Tracked replacements for the C allocation functions.
+ ***********************************************************/
+void* MemoryTracker::Malloc(size_t size)
+{
+	return(TrackedAlloc(size));
+}
+
+void* MemoryTracker::Realloc(void* pMemory, size_t newSize)
+{
+	if (NULL == pMemory)
+	{
+		return(TrackedAlloc(newSize));
+	}
+
+	BLOCK_HEADER* pHeader = (BLOCK_HEADER*)((unsigned char*)pMemory - HEADER_SIZE);
+	void* pNewMemory = TrackedAlloc(newSize);
+	if (NULL != pNewMemory)
+	{
+		size_t copySize = (pHeader->size < newSize) ? (size_t)pHeader->size : newSize;
+		memcpy(pNewMemory, pMemory, copySize);
+		TrackedFree(pMemory);
+	}
+	return(pNewMemory);
+}
+
+void MemoryTracker::Free(void* pMemory)
+{
+	TrackedFree(pMemory);
+}
+
+#else
+
+bool MemoryTracker::IsEnabled()
+{
+	return(false);
+}
+
+void MemoryTracker::PushPhase(const char*)
+{
+}
+
+void MemoryTracker::PopPhase()
+{
+}
+
+void MemoryTracker::BeginFrame()
+{
+}
+
+MemoryTracker::FRAME_STATS MemoryTracker::GetLastFrameStats()
+{
+	FRAME_STATS stats = { 0, 0, 0, 0 };
+	return(stats);
+}
+
+uint64_t MemoryTracker::GetFrameCount()
+{
+	return(0);
+}
+
+int MemoryTracker::GetPhaseCount()
+{
+	return(0);
+}
+
+bool MemoryTracker::GetPhaseStats(int, PHASE_STATS&)
+{
+	return(false);
+}
+
+void* MemoryTracker::Malloc(size_t size)
+{
+	return(malloc(size));
+}
+
+void* MemoryTracker::Realloc(void* pMemory, size_t newSize)
+{
+	return(realloc(pMemory, newSize));
+}
+
+void MemoryTracker::Free(void* pMemory)
+{
+	free(pMemory);
+}
+
+#endif
+
+/***********************************************************
+ *  DumpSummary()
+ *
+ *  Print the allocation statistics of every phase.  Live
+ *  bytes that remain at exit are memory that was never
+ *  released.
+ ***********************************************************/
+void MemoryTracker::DumpSummary()
+{
+	if (!IsEnabled())
+	{
+		return;
+	}
+
+	std::cout << "\nINFO: Memory allocation summary by phase\n";
+	std::cout << std::left << std::setw(20) << "  phase"
+		<< std::right << std::setw(12) << "allocs"
+		<< std::setw(12) << "frees"
+		<< std::setw(16) << "bytes alloc"
+		<< std::setw(16) << "peak live"
+		<< std::setw(16) << "live at exit" << "\n";
+
+	PHASE_STATS stats;
+	for (int i = 0; i < GetPhaseCount(); i++)
+	{
+		if (GetPhaseStats(i, stats))
+		{
+			std::cout << "  " << std::left << std::setw(18) << stats.name
+				<< std::right << std::setw(12) << stats.allocations
+				<< std::setw(12) << stats.frees
+				<< std::setw(16) << stats.bytesAllocated
+				<< std::setw(16) << stats.peakLiveBytes
+				<< std::setw(16) << stats.liveBytes << "\n";
+		}
+	}
+
+	FRAME_STATS lastFrame = GetLastFrameStats();
+	std::cout << "  frames: " << GetFrameCount()
+		<< ", last frame: " << lastFrame.allocations << " allocations ("
+		<< lastFrame.bytesAllocated << " bytes), " << lastFrame.frees << " frees ("
+		<< lastFrame.bytesFreed << " bytes)" << std::endl;
+}
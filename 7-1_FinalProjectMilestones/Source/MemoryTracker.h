@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// memorytracker.h
+// ============
+// optional global allocation tracker - attributes allocation counts and bytes
+// to named phases (PrepareScene, LoadSceneTextures, RenderScene, ...)
+//
+//  The global operator new/delete hooks are only installed when the
+//  ENABLE_MEMORY_TRACKER preprocessor symbol is defined in the project
+//  settings.  Without it the phase macros compile to nothing and all of
+//  the counters read as zero.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace MemoryTracker
+{
+	// maximum number of distinct named phases that can be tracked
+	const int MAX_PHASES = 32;
+
+	struct PHASE_STATS
+	{
+		const char* name;
+		uint64_t allocations;
+		uint64_t frees;
+		uint64_t bytesAllocated;
+		uint64_t bytesFreed;
+		int64_t liveBytes;
+		int64_t peakLiveBytes;
+	};
+
+	struct FRAME_STATS
+	{
+		uint64_t allocations;
+		uint64_t frees;
+		uint64_t bytesAllocated;
+		uint64_t bytesFreed;
+	};
+
+	// true when the allocation hooks were compiled into the application
+	bool IsEnabled();
+
+	// push and pop the named phase that new allocations are attributed to;
+	// the name must be a string literal or otherwise outlive the tracker
+	void PushPhase(const char* phaseName);
+	void PopPhase();
+
+	// mark the frame boundary - the counters accumulated since the last
+	// call become the "last frame" values returned by GetLastFrameStats()
+	void BeginFrame();
+	FRAME_STATS GetLastFrameStats();
+	uint64_t GetFrameCount();
+
+	// copy out the statistics of one tracked phase
+	int GetPhaseCount();
+	bool GetPhaseStats(int phaseIndex, PHASE_STATS& stats);
+
+	// print the per-phase summary to the console
+	void DumpSummary();
+
+	// tracked C allocation functions, used for third party code such
+	// as stb_image that allows its allocator to be overridden
+	void* Malloc(size_t size);
+	void* Realloc(void* pMemory, size_t newSize);
+	void Free(void* pMemory);
+
+	// attributes allocations within the enclosing scope to a phase
+	class ScopedPhase
+	{
+	public:
+		explicit ScopedPhase(const char* phaseName) { PushPhase(phaseName); }
+		~ScopedPhase() { PopPhase(); }
+	private:
+		ScopedPhase(const ScopedPhase&) = delete;
+		ScopedPhase& operator=(const ScopedPhase&) = delete;
+	};
+}
+
+#ifdef ENABLE_MEMORY_TRACKER
+#define MEMORY_TRACKER_CONCAT_INNER(a, b) a##b
+#define MEMORY_TRACKER_CONCAT(a, b) MEMORY_TRACKER_CONCAT_INNER(a, b)
+#define MEMORY_PHASE(phaseName) MemoryTracker::ScopedPhase MEMORY_TRACKER_CONCAT(memoryPhase_, __LINE__)(phaseName)
+#else
+#define MEMORY_PHASE(phaseName)
+#endif
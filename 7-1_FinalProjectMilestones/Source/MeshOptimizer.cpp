@@ -0,0 +1,453 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.cpp
+// ============
+// index and vertex buffer ordering for generated meshes - triangles are
+// reordered for the post-transform vertex cache (Tipsify), clusters of them
+// for less overdraw, and the vertices into the order they are first fetched
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshOptimizer.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// cache time of a vertex that was never loaded
+	const int NEVER_CACHED = -0x40000000;
+
+	/***********************************************************
+	 *  FIFO_CACHE
+	 *
+	 *  FIFO post-transform cache simulation.  A vertex is in the
+	 *  cache while fewer than cacheSize other vertices were
+	 *  loaded after it.
+	 ***********************************************************/
+	struct FIFO_CACHE
+	{
+		std::vector<int> loadTimes;
+		int time;
+		int cacheSize;
+
+		FIFO_CACHE(int vertexCount, int size)
+		{
+			loadTimes.assign(vertexCount, NEVER_CACHED);
+			time = 0;
+			cacheSize = size;
+		}
+
+		void Reset()
+		{
+			time += cacheSize;
+		}
+
+		// load the vertex unless it is cached - returns true on a miss
+		bool Access(unsigned int vertex)
+		{
+			if (time - loadTimes[vertex] < cacheSize)
+			{
+				return(false);
+			}
+			loadTimes[vertex] = time++;
+			return(true);
+		}
+	};
+
+	/***********************************************************
+	 *  CountMisses()
+	 *
+	 *  Cache misses of the triangles [first, last) drawn after
+	 *  the cache was flushed.
+	 ***********************************************************/
+	int CountMisses(const std::vector<unsigned int>& indices, FIFO_CACHE& cache, int firstTriangle, int lastTriangle)
+	{
+		cache.Reset();
+		int misses = 0;
+		for (int i = firstTriangle * 3; i < lastTriangle * 3; i++)
+		{
+			misses += (int)cache.Access(indices[i]);
+		}
+		return(misses);
+	}
+
+	glm::vec3 GetPosition(const std::vector<float>& vertices, int floatsPerVertex, unsigned int vertex)
+	{
+		const float* pPosition = &vertices[(size_t)vertex * floatsPerVertex];
+		return(glm::vec3(pPosition[0], pPosition[1], pPosition[2]));
+	}
+
+	struct TRIANGLE_CLUSTER
+	{
+		int firstTriangle;
+		int lastTriangle;
+		float sortKey;
+	};
+}
+
+/***********************************************************
+ *  AnalyzeVertexCache()
+ *
+ *  This function is used to count the vertices that a FIFO
+ *  cache of the passed in size transforms for the index
+ *  buffer, per triangle (ACMR) and per referenced vertex
+ *  (ATVR).
+ ***********************************************************/
+MeshOptimizer::CACHE_STATS MeshOptimizer::AnalyzeVertexCache(
+	const std::vector<unsigned int>& indices,
+	int vertexCount,
+	int cacheSize)
+{
+	CACHE_STATS stats = { 0, 0, 0.0f, 0.0f };
+	stats.triangleCount = (int)(indices.size() / 3);
+	if (stats.triangleCount == 0)
+	{
+		return(stats);
+	}
+
+	FIFO_CACHE cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	int referencedCount = 0;
+	for (size_t i = 0; i < (size_t)stats.triangleCount * 3; i++)
+	{
+		stats.shadedVertices += (int)cache.Access(indices[i]);
+		if (referenced[indices[i]] == false)
+		{
+			referenced[indices[i]] = true;
+			referencedCount++;
+		}
+	}
+
+	stats.acmr = (float)stats.shadedVertices / stats.triangleCount;
+	stats.atvr = (float)stats.shadedVertices / referencedCount;
+	return(stats);
+}
+
+/***********************************************************
+ *  OptimizeVertexCache()
+ *
+ *  This function is used to reorder the triangles with the
+ *  Tipsify algorithm (Sander, Nehab and Barczak 2007).  From
+ *  a fanning vertex all of its remaining triangles are
+ *  emitted, then the next fanning vertex is picked among the
+ *  vertices of those triangles, preferring the ones that
+ *  will still be cached once their remaining triangles are
+ *  drawn.  When none qualifies, the most recently used
+ *  vertex with triangles left is taken from the dead-end
+ *  stack, or else the next one in index order, and a new
+ *  cluster starts.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexCache(
+	std::vector<unsigned int>& indices,
+	int vertexCount,
+	int cacheSize,
+	std::vector<int>* pClusters)
+{
+	int triangleCount = (int)(indices.size() / 3);
+	if (NULL != pClusters)
+	{
+		pClusters->clear();
+	}
+	if ((triangleCount == 0) || (vertexCount == 0))
+	{
+		return;
+	}
+
+	// triangles of every vertex, as offsets into one list
+	std::vector<int> liveTriangles(vertexCount, 0);
+	for (int i = 0; i < triangleCount * 3; i++)
+	{
+		liveTriangles[indices[i]]++;
+	}
+	std::vector<int> adjacencyOffsets(vertexCount + 1, 0);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	}
+	std::vector<int> adjacency(adjacencyOffsets[vertexCount]);
+	std::vector<int> fillCounts(vertexCount, 0);
+	for (int i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int v = indices[i];
+		adjacency[adjacencyOffsets[v] + fillCounts[v]++] = i / 3;
+	}
+
+	std::vector<int> cacheTimes(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	deadEnd.reserve(indices.size());
+
+	int time = cacheSize + 1;
+	int cursor = 1;
+	int fanningVertex = 0;
+	if (NULL != pClusters)
+	{
+		pClusters->push_back(0);
+	}
+
+	while (fanningVertex >= 0)
+	{
+		candidates.clear();
+		for (int a = adjacencyOffsets[fanningVertex]; a < adjacencyOffsets[fanningVertex + 1]; a++)
+		{
+			int triangle = adjacency[a];
+			if (emitted[triangle] == true)
+			{
+				continue;
+			}
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int v = indices[triangle * 3 + corner];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (time - cacheTimes[v] > cacheSize)
+				{
+					cacheTimes[v] = time++;
+				}
+			}
+			emitted[triangle] = true;
+		}
+
+		// the candidate that will still be cached after its own
+		// remaining triangles, and that has been cached the longest
+		int nextVertex = -1;
+		int bestPriority = -1;
+		for (size_t c = 0; c < candidates.size(); c++)
+		{
+			unsigned int v = candidates[c];
+			if (liveTriangles[v] <= 0)
+			{
+				continue;
+			}
+			int priority = 0;
+			if (time - cacheTimes[v] + 2 * liveTriangles[v] <= cacheSize)
+			{
+				priority = time - cacheTimes[v];
+			}
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				nextVertex = (int)v;
+			}
+		}
+
+		if (nextVertex == -1)
+		{
+			// skip the dead end - the new fan starts a new cluster
+			while ((deadEnd.empty() == false) && (nextVertex == -1))
+			{
+				unsigned int v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveTriangles[v] > 0)
+				{
+					nextVertex = (int)v;
+				}
+			}
+			while ((nextVertex == -1) && (cursor < vertexCount))
+			{
+				if (liveTriangles[cursor] > 0)
+				{
+					nextVertex = cursor;
+				}
+				cursor++;
+			}
+
+			int emittedTriangles = (int)(output.size() / 3);
+			if ((nextVertex != -1) && (NULL != pClusters) && (emittedTriangles > pClusters->back()))
+			{
+				pClusters->push_back(emittedTriangles);
+			}
+		}
+		fanningVertex = nextVertex;
+	}
+
+	indices.swap(output);
+}
+
+/***********************************************************
+ *  OptimizeOverdraw()
+ *
+ *  This function is used to reorder the clusters of a cache
+ *  optimized index buffer (Sander et al., "fast triangle
+ *  reordering").  A cluster is split where the triangles up
+ *  to that point miss the cache no more often than the
+ *  threshold allows, and the clusters are sorted by how far
+ *  they face away from the mesh center, so that the outer
+ *  surfaces are drawn before what they hide.
+ ***********************************************************/
+void MeshOptimizer::OptimizeOverdraw(
+	std::vector<unsigned int>& indices,
+	const std::vector<float>& vertices,
+	int floatsPerVertex,
+	const std::vector<int>& clusters,
+	int cacheSize,
+	float threshold)
+{
+	int triangleCount = (int)(indices.size() / 3);
+	int vertexCount = (int)(vertices.size() / floatsPerVertex);
+	if ((triangleCount == 0) || (clusters.empty() == true))
+	{
+		return;
+	}
+
+	// split the hard clusters at soft boundaries
+	std::vector<TRIANGLE_CLUSTER> softClusters;
+	FIFO_CACHE cache(vertexCount, cacheSize);
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		int first = clusters[c];
+		int last = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+		float clusterThreshold = threshold * CountMisses(indices, cache, first, last) / (float)(last - first);
+
+		cache.Reset();
+		int start = first;
+		int misses = 0;
+		for (int t = first; t < last; t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				misses += (int)cache.Access(indices[t * 3 + corner]);
+			}
+			if ((t + 1 < last) && ((float)misses / (t + 1 - start) <= clusterThreshold))
+			{
+				TRIANGLE_CLUSTER cluster = { start, t + 1, 0.0f };
+				softClusters.push_back(cluster);
+				start = t + 1;
+				misses = 0;
+				cache.Reset();
+			}
+		}
+		TRIANGLE_CLUSTER cluster = { start, last, 0.0f };
+		softClusters.push_back(cluster);
+	}
+
+	// area weighted centroid of the whole mesh
+	glm::vec3 meshCenter = glm::vec3(0.0f);
+	float meshArea = 0.0f;
+	for (int t = 0; t < triangleCount; t++)
+	{
+		glm::vec3 p0 = GetPosition(vertices, floatsPerVertex, indices[t * 3]);
+		glm::vec3 p1 = GetPosition(vertices, floatsPerVertex, indices[t * 3 + 1]);
+		glm::vec3 p2 = GetPosition(vertices, floatsPerVertex, indices[t * 3 + 2]);
+		float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+		meshCenter += (p0 + p1 + p2) * (area / 3.0f);
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+	{
+		meshCenter /= meshArea;
+	}
+
+	// clusters facing away from the center occlude the others
+	for (size_t c = 0; c < softClusters.size(); c++)
+	{
+		TRIANGLE_CLUSTER& cluster = softClusters[c];
+		glm::vec3 center = glm::vec3(0.0f);
+		glm::vec3 normal = glm::vec3(0.0f);
+		float area = 0.0f;
+		for (int t = cluster.firstTriangle; t < cluster.lastTriangle; t++)
+		{
+			glm::vec3 p0 = GetPosition(vertices, floatsPerVertex, indices[t * 3]);
+			glm::vec3 p1 = GetPosition(vertices, floatsPerVertex, indices[t * 3 + 1]);
+			glm::vec3 p2 = GetPosition(vertices, floatsPerVertex, indices[t * 3 + 2]);
+			glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(areaNormal);
+			center += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += areaNormal;
+			area += triangleArea;
+		}
+		if (area > 0.0f)
+		{
+			center /= area;
+		}
+		float normalLength = glm::length(normal);
+		if (normalLength > 0.0f)
+		{
+			normal /= normalLength;
+		}
+		cluster.sortKey = glm::dot(center - meshCenter, normal);
+	}
+
+	std::stable_sort(softClusters.begin(), softClusters.end(),
+		[](const TRIANGLE_CLUSTER& a, const TRIANGLE_CLUSTER& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	for (size_t c = 0; c < softClusters.size(); c++)
+	{
+		output.insert(output.end(),
+			indices.begin() + softClusters[c].firstTriangle * 3,
+			indices.begin() + softClusters[c].lastTriangle * 3);
+	}
+	indices.swap(output);
+}
+
+/***********************************************************
+ *  OptimizeVertexFetch()
+ *
+ *  This function is used to store the vertices in the order
+ *  the triangles first reference them, so that consecutive
+ *  cache misses read neighbouring memory.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexFetch(
+	std::vector<unsigned int>& indices,
+	std::vector<float>& vertices,
+	int floatsPerVertex)
+{
+	int vertexCount = (int)(vertices.size() / floatsPerVertex);
+	std::vector<int> remap(vertexCount, -1);
+	std::vector<float> output;
+	output.reserve(vertices.size());
+
+	int nextVertex = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int v = indices[i];
+		if (remap[v] < 0)
+		{
+			remap[v] = nextVertex++;
+			output.insert(output.end(),
+				vertices.begin() + (size_t)v * floatsPerVertex,
+				vertices.begin() + (size_t)(v + 1) * floatsPerVertex);
+		}
+		indices[i] = (unsigned int)remap[v];
+	}
+	vertices.swap(output);
+}
+
+/***********************************************************
+ *  OptimizeMesh()
+ *
+ *  This function is used to run the cache, overdraw and
+ *  fetch passes in that order, and to print what the cache
+ *  simulation gives for the original and the final order.
+ ***********************************************************/
+void MeshOptimizer::OptimizeMesh(
+	const char* name,
+	std::vector<unsigned int>& indices,
+	std::vector<float>& vertices,
+	int floatsPerVertex)
+{
+	int vertexCount = (int)(vertices.size() / floatsPerVertex);
+	CACHE_STATS before = AnalyzeVertexCache(indices, vertexCount, DEFAULT_CACHE_SIZE);
+
+	std::vector<int> clusters;
+	OptimizeVertexCache(indices, vertexCount, DEFAULT_CACHE_SIZE, &clusters);
+	OptimizeOverdraw(indices, vertices, floatsPerVertex, clusters, DEFAULT_CACHE_SIZE, DEFAULT_OVERDRAW_THRESHOLD);
+	OptimizeVertexFetch(indices, vertices, floatsPerVertex);
+
+	CACHE_STATS after = AnalyzeVertexCache(indices, (int)(vertices.size() / floatsPerVertex), DEFAULT_CACHE_SIZE);
+	std::cout << std::fixed << std::setprecision(3)
+		<< "INFO: Mesh " << name << " optimized, " << after.triangleCount << " triangles - ACMR "
+		<< before.acmr << " -> " << after.acmr << ", ATVR "
+		<< before.atvr << " -> " << after.atvr << std::endl;
+}
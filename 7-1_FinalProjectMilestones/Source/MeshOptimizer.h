@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.h
+// ============
+// index and vertex buffer ordering for generated meshes - triangles are
+// reordered for the post-transform vertex cache (Tipsify), clusters of them
+// for less overdraw, and the vertices into the order they are first fetched
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+
+namespace MeshOptimizer
+{
+	// FIFO vertex cache entries the orderings are simulated for -
+	// small enough to suit every GPU the scene runs on
+	const int DEFAULT_CACHE_SIZE = 16;
+	// accepted increase of the cache misses when the clusters are
+	// split for the overdraw ordering
+	const float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+	// cache misses of an index buffer drawn as a triangle list
+	struct CACHE_STATS
+	{
+		int triangleCount;
+		int shadedVertices;	// vertices transformed, one per cache miss
+		float acmr;			// average cache miss ratio, per triangle
+		float atvr;			// transformed per referenced vertex, 1.0 at best
+	};
+
+	// simulate a FIFO cache of the passed in size over the indices
+	CACHE_STATS AnalyzeVertexCache(const std::vector<unsigned int>& indices, int vertexCount, int cacheSize);
+
+	// reorder the triangles with Tipsify for a cache of the passed
+	// in size; the first triangle of every cluster that starts after
+	// the cache had to be refilled is returned in pClusters
+	void OptimizeVertexCache(
+		std::vector<unsigned int>& indices,
+		int vertexCount,
+		int cacheSize,
+		std::vector<int>* pClusters);
+
+	// split the clusters where the cache order allows it and sort them
+	// so that the ones facing away from the mesh center are drawn
+	// first; a threshold of 1.05 accepts 5% more cache misses.  The
+	// positions are the first three floats of every vertex.
+	void OptimizeOverdraw(
+		std::vector<unsigned int>& indices,
+		const std::vector<float>& vertices,
+		int floatsPerVertex,
+		const std::vector<int>& clusters,
+		int cacheSize,
+		float threshold);
+
+	// renumber the vertices in the order the indices first use them,
+	// dropping the ones that no triangle references
+	void OptimizeVertexFetch(
+		std::vector<unsigned int>& indices,
+		std::vector<float>& vertices,
+		int floatsPerVertex);
+
+	// run the three passes and print the cache statistics before and
+	// after under the passed in name
+	void OptimizeMesh(
+		const char* name,
+		std::vector<unsigned int>& indices,
+		std::vector<float>& vertices,
+		int floatsPerVertex);
+}
@@ -0,0 +1,409 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipgenerator.cpp
+// ============
+// CPU mipmap generation - levels are filtered in linear space with a box or
+// a Kaiser windowed sinc filter, split across worker threads, and stored as
+// 8-bit sRGB again so that they can be uploaded level by level
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MipGenerator.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+// SSE2 is part of every x64 target; other targets use the scalar loops
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define MIP_GENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+// declaration of the global variables and defines
+namespace
+{
+	// Kaiser filter: 8 taps on the source level, i.e. a radius of
+	// two destination pixels, with a moderate side lobe suppression
+	const int KAISER_TAPS = 8;
+	const float KAISER_ALPHA = 4.0f;
+	const float KAISER_RADIUS = 2.0f;
+
+	// levels smaller than this are not worth splitting across threads
+	const int MIN_PIXELS_PER_WORKER = 32 * 1024;
+
+	// size of the linear to sRGB encode table
+	const int ENCODE_TABLE_SIZE = 4096;
+
+	const float PI = 3.14159265358979f;
+
+	// conversion tables, filled on first use
+	float g_DecodeTable[256];
+	unsigned char g_EncodeTable[ENCODE_TABLE_SIZE + 1];
+	bool g_bTablesReady = false;
+
+	/***********************************************************
+	 *  InitTables()
+	 *
+	 *  Fill the sRGB decode and encode tables.
+	 ***********************************************************/
+	void InitTables()
+	{
+		if (g_bTablesReady)
+		{
+			return;
+		}
+
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			g_DecodeTable[i] = (c <= 0.04045f) ? (c / 12.92f) : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i <= ENCODE_TABLE_SIZE; i++)
+		{
+			float l = (float)i / ENCODE_TABLE_SIZE;
+			float c = (l <= 0.0031308f) ? (l * 12.92f) : (1.055f * powf(l, 1.0f / 2.4f) - 0.055f);
+			g_EncodeTable[i] = (unsigned char)std::min(255.0f, std::max(0.0f, c * 255.0f + 0.5f));
+		}
+		g_bTablesReady = true;
+	}
+
+	/***********************************************************
+	 *  Encode()
+	 *
+	 *  Convert a filtered value back to 8 bits - sRGB for the
+	 *  color channels, plain rounding for alpha.
+	 ***********************************************************/
+	inline unsigned char Encode(float value, bool bAlpha)
+	{
+		value = std::min(1.0f, std::max(0.0f, value));
+		if (bAlpha)
+		{
+			return (unsigned char)(value * 255.0f + 0.5f);
+		}
+		return g_EncodeTable[(int)(value * ENCODE_TABLE_SIZE + 0.5f)];
+	}
+
+	/***********************************************************
+	 *  BesselI0()
+	 *
+	 *  Modified Bessel function of the first kind, order zero,
+	 *  used by the Kaiser window.
+	 ***********************************************************/
+	float BesselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 20; k++)
+		{
+			term *= (x / (2.0f * k)) * (x / (2.0f * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	/***********************************************************
+	 *  KaiserWeights()
+	 *
+	 *  Normalized weights for the source taps -3..+4 around a
+	 *  destination pixel, which sits between source pixels
+	 *  2x and 2x + 1.
+	 ***********************************************************/
+	void KaiserWeights(float weights[KAISER_TAPS])
+	{
+		float total = 0.0f;
+		for (int t = 0; t < KAISER_TAPS; t++)
+		{
+			// distance in destination pixels
+			float x = ((t - 3) - 0.5f) * 0.5f;
+			float sinc = (x == 0.0f) ? 1.0f : sinf(PI * x) / (PI * x);
+			float ratio = x / KAISER_RADIUS;
+			float window = (fabsf(ratio) < 1.0f)
+				? BesselI0(KAISER_ALPHA * sqrtf(1.0f - ratio * ratio)) / BesselI0(KAISER_ALPHA)
+				: 0.0f;
+			weights[t] = sinc * window;
+			total += weights[t];
+		}
+		for (int t = 0; t < KAISER_TAPS; t++)
+		{
+			weights[t] /= total;
+		}
+	}
+
+	/***********************************************************
+	 *  AddScaledRow()
+	 *
+	 *  dest += source * weight over a row of floats.
+	 ***********************************************************/
+	inline void AddScaledRow(float* pDest, const float* pSource, float weight, int count)
+	{
+		int i = 0;
+#ifdef MIP_GENERATOR_SSE2
+		__m128 w = _mm_set1_ps(weight);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 d = _mm_loadu_ps(pDest + i);
+			__m128 s = _mm_loadu_ps(pSource + i);
+			_mm_storeu_ps(pDest + i, _mm_add_ps(d, _mm_mul_ps(s, w)));
+		}
+#endif
+		for (; i < count; i++)
+		{
+			pDest[i] += pSource[i] * weight;
+		}
+	}
+
+	/***********************************************************
+	 *  BoxRows()
+	 *
+	 *  2x2 average for the destination rows [firstRow, endRow).
+	 *  The two source rows are averaged vertically first, which
+	 *  is one contiguous SIMD loop, then pixel pairs are added.
+	 ***********************************************************/
+	void BoxRows(
+		const float* pSource, int sourceWidth, int sourceHeight,
+		float* pDest, int destWidth, int channels,
+		int firstRow, int endRow)
+	{
+		int sourceStride = sourceWidth * channels;
+		std::vector<float> rowSum(sourceStride);
+
+		for (int y = firstRow; y < endRow; y++)
+		{
+			const float* pRow0 = pSource + std::min(y * 2, sourceHeight - 1) * sourceStride;
+			const float* pRow1 = pSource + std::min(y * 2 + 1, sourceHeight - 1) * sourceStride;
+
+			std::fill(rowSum.begin(), rowSum.end(), 0.0f);
+			AddScaledRow(rowSum.data(), pRow0, 0.25f, sourceStride);
+			AddScaledRow(rowSum.data(), pRow1, 0.25f, sourceStride);
+
+			float* pOut = pDest + (size_t)y * destWidth * channels;
+			for (int x = 0; x < destWidth; x++)
+			{
+				const float* p0 = rowSum.data() + std::min(x * 2, sourceWidth - 1) * channels;
+				const float* p1 = rowSum.data() + std::min(x * 2 + 1, sourceWidth - 1) * channels;
+#ifdef MIP_GENERATOR_SSE2
+				if (channels == 4)
+				{
+					_mm_storeu_ps(pOut + x * 4, _mm_add_ps(_mm_loadu_ps(p0), _mm_loadu_ps(p1)));
+					continue;
+				}
+#endif
+				for (int c = 0; c < channels; c++)
+				{
+					pOut[x * channels + c] = p0[c] + p1[c];
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  KaiserRows()
+	 *
+	 *  Separable Kaiser filter for the destination rows
+	 *  [firstRow, endRow): the needed source rows are weighted
+	 *  and summed vertically (SIMD), then filtered horizontally.
+	 ***********************************************************/
+	void KaiserRows(
+		const float* pSource, int sourceWidth, int sourceHeight,
+		float* pDest, int destWidth, int channels,
+		int firstRow, int endRow)
+	{
+		float weights[KAISER_TAPS];
+		KaiserWeights(weights);
+
+		int sourceStride = sourceWidth * channels;
+		std::vector<float> column(sourceStride);
+
+		for (int y = firstRow; y < endRow; y++)
+		{
+			std::fill(column.begin(), column.end(), 0.0f);
+			for (int t = 0; t < KAISER_TAPS; t++)
+			{
+				int sourceY = std::min(std::max(y * 2 + t - 3, 0), sourceHeight - 1);
+				AddScaledRow(column.data(), pSource + (size_t)sourceY * sourceStride, weights[t], sourceStride);
+			}
+
+			float* pOut = pDest + (size_t)y * destWidth * channels;
+			for (int x = 0; x < destWidth; x++)
+			{
+				float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (int t = 0; t < KAISER_TAPS; t++)
+				{
+					int sourceX = std::min(std::max(x * 2 + t - 3, 0), sourceWidth - 1);
+					const float* p = column.data() + sourceX * channels;
+					for (int c = 0; c < channels; c++)
+					{
+						sum[c] += p[c] * weights[t];
+					}
+				}
+				// the negative lobes can ring below zero
+				for (int c = 0; c < channels; c++)
+				{
+					pOut[x * channels + c] = std::max(sum[c], 0.0f);
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  FilterLevel()
+	 *
+	 *  Produce the next level from the passed in linear level,
+	 *  with the rows split across the worker threads.
+	 ***********************************************************/
+	void FilterLevel(
+		const float* pSource, int sourceWidth, int sourceHeight,
+		float* pDest, int destWidth, int destHeight,
+		int channels, int filter)
+	{
+		void (*pRowFunction)(const float*, int, int, float*, int, int, int, int) =
+			(filter == MipGenerator::MIP_FILTER_KAISER) ? KaiserRows : BoxRows;
+
+		int workerCount = std::min(MipGenerator::GetWorkerCount(),
+			std::max(1, (destWidth * destHeight) / MIN_PIXELS_PER_WORKER));
+		workerCount = std::min(workerCount, destHeight);
+
+		if (workerCount <= 1)
+		{
+			pRowFunction(pSource, sourceWidth, sourceHeight, pDest, destWidth, channels, 0, destHeight);
+			return;
+		}
+
+		std::vector<std::thread> workers;
+		int rowsPerWorker = (destHeight + workerCount - 1) / workerCount;
+		for (int i = 0; i < workerCount; i++)
+		{
+			int firstRow = i * rowsPerWorker;
+			int endRow = std::min(firstRow + rowsPerWorker, destHeight);
+			if (firstRow >= endRow)
+			{
+				break;
+			}
+			workers.push_back(std::thread(pRowFunction,
+				pSource, sourceWidth, sourceHeight, pDest, destWidth, channels, firstRow, endRow));
+		}
+		for (size_t i = 0; i < workers.size(); i++)
+		{
+			workers[i].join();
+		}
+	}
+}
+
+/***********************************************************
+ *  GenerateMipChain()
+ *
+ *  This function is used to build every mip level of an
+ *  image.  The image is decoded to linear floats once, and
+ *  each level is filtered from the previous float level, so
+ *  the 8-bit rounding does not add up down the chain.
+ ***********************************************************/
+void MipGenerator::GenerateMipChain(
+	const unsigned char* pImage,
+	int width,
+	int height,
+	int channels,
+	int filter,
+	std::vector<MIP_LEVEL>& levels)
+{
+	TRACE_SCOPE("GenerateMipChain");
+	InitTables();
+	levels.clear();
+
+	MIP_LEVEL baseLevel;
+	baseLevel.width = width;
+	baseLevel.height = height;
+	baseLevel.pixels.assign(pImage, pImage + (size_t)width * height * channels);
+	levels.push_back(std::move(baseLevel));
+
+	if (filter == MIP_FILTER_GPU)
+	{
+		return;
+	}
+
+	// the fourth channel is alpha and is filtered as is
+	size_t valueCount = (size_t)width * height * channels;
+	std::vector<float> source(valueCount);
+	for (size_t i = 0; i < valueCount; i++)
+	{
+		bool bAlpha = (channels == 4) && ((i % 4) == 3);
+		source[i] = bAlpha ? (pImage[i] / 255.0f) : g_DecodeTable[pImage[i]];
+	}
+
+	std::vector<float> dest;
+	int sourceWidth = width;
+	int sourceHeight = height;
+	while ((sourceWidth > 1) || (sourceHeight > 1))
+	{
+		int destWidth = std::max(sourceWidth / 2, 1);
+		int destHeight = std::max(sourceHeight / 2, 1);
+		dest.assign((size_t)destWidth * destHeight * channels, 0.0f);
+
+		FilterLevel(source.data(), sourceWidth, sourceHeight,
+			dest.data(), destWidth, destHeight, channels, filter);
+
+		MIP_LEVEL level;
+		level.width = destWidth;
+		level.height = destHeight;
+		level.pixels.resize(dest.size());
+		for (size_t i = 0; i < dest.size(); i++)
+		{
+			level.pixels[i] = Encode(dest[i], (channels == 4) && ((i % 4) == 3));
+		}
+		levels.push_back(std::move(level));
+
+		source.swap(dest);
+		sourceWidth = destWidth;
+		sourceHeight = destHeight;
+	}
+}
+
+/***********************************************************
+ *  GetWorkerCount()
+ *
+ *  This function is used to get the number of threads that
+ *  a large mip level is split across.
+ ***********************************************************/
+int MipGenerator::GetWorkerCount()
+{
+	static const int workerCount = std::max(1, std::min((int)std::thread::hardware_concurrency(), 8));
+	return(workerCount);
+}
+
+/***********************************************************
+ *  ParseFilterName()
+ *
+ *  This function is used to convert a command line filter
+ *  name to a MIP_FILTER value.
+ ***********************************************************/
+int MipGenerator::ParseFilterName(const char* name)
+{
+	if (strcmp(name, "gpu") == 0)
+	{
+		return(MIP_FILTER_GPU);
+	}
+	if (strcmp(name, "kaiser") == 0)
+	{
+		return(MIP_FILTER_KAISER);
+	}
+	return(MIP_FILTER_BOX);
+}
+
+/***********************************************************
+ *  GetFilterName()
+ *
+ *  This function is used to get the display name of a
+ *  MIP_FILTER value.
+ ***********************************************************/
+const char* MipGenerator::GetFilterName(int filter)
+{
+	switch (filter)
+	{
+	case MIP_FILTER_GPU:
+		return("glGenerateMipmap");
+	case MIP_FILTER_KAISER:
+		return("kaiser");
+	default:
+		return("box");
+	}
+}
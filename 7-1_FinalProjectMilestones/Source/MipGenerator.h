@@ -0,0 +1,47 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipgenerator.h
+// ============
+// CPU mipmap generation - levels are filtered in linear space with a box or
+// a Kaiser windowed sinc filter, split across worker threads, and stored as
+// 8-bit sRGB again so that they can be uploaded level by level
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+
+namespace MipGenerator
+{
+	// how the mip levels are produced
+	enum MIP_FILTER
+	{
+		MIP_FILTER_GPU = 0,		// level 0 only - glGenerateMipmap after upload
+		MIP_FILTER_BOX,			// 2x2 average
+		MIP_FILTER_KAISER		// 8 tap Kaiser windowed sinc
+	};
+
+	struct MIP_LEVEL
+	{
+		int width;
+		int height;
+		std::vector<unsigned char> pixels;
+	};
+
+	// build the mip chain of the passed in 8-bit image down to 1x1;
+	// levels[0] is a copy of the image.  Color channels are treated
+	// as sRGB, a fourth channel as linear alpha.
+	void GenerateMipChain(
+		const unsigned char* pImage,
+		int width,
+		int height,
+		int channels,
+		int filter,
+		std::vector<MIP_LEVEL>& levels);
+
+	// number of threads a level is split across
+	int GetWorkerCount();
+
+	// parse "gpu", "box" or "kaiser"; unknown names give the box filter
+	int ParseFilterName(const char* name);
+	const char* GetFilterName(int filter);
+}
@@ -0,0 +1,238 @@
+///////////////////////////////////////////////////////////////////////////////
+// multiviewtarget.cpp
+// ============
+// atlas render target of the multi-view passes - one tile per camera in a
+// grid of up to 16 tiles, with a viewport array entry for each tile so that
+// a single submission can draw every view
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MultiViewTarget.h"
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+/***********************************************************
+ *  MultiViewTarget()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MultiViewTarget::MultiViewTarget()
+{
+	m_tileWidth = 0;
+	m_tileHeight = 0;
+	m_framebufferID = 0;
+	m_colorTextureID = 0;
+	m_depthRenderbufferID = 0;
+	m_previousFramebuffer = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		m_previousViewport[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  ~MultiViewTarget()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MultiViewTarget::~MultiViewTarget()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to create the atlas, TILE_COLUMNS
+ *  tiles wide and TILE_ROWS tiles high, with one depth
+ *  buffer that the views share.  The tiles do not overlap,
+ *  so the views cannot hide each other.
+ ***********************************************************/
+bool MultiViewTarget::Create(int tileWidth, int tileHeight)
+{
+	Destroy();
+	m_tileWidth = tileWidth;
+	m_tileHeight = tileHeight;
+	int atlasWidth = tileWidth * TILE_COLUMNS;
+	int atlasHeight = tileHeight * TILE_ROWS;
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	glGenTextures(1, &m_colorTextureID);
+	glBindTexture(GL_TEXTURE_2D, m_colorTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasWidth, atlasHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &m_depthRenderbufferID);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasWidth, atlasHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTextureID, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbufferID);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "ERROR: Multi-view framebuffer is incomplete, status: 0x" << std::hex << status << std::dec << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	std::cout << "INFO: Multi-view atlas " << atlasWidth << "x" << atlasHeight << ", "
+		<< MAX_VIEWS << " tiles of " << tileWidth << "x" << tileHeight << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to free the atlas.
+ ***********************************************************/
+void MultiViewTarget::Destroy()
+{
+	if (m_framebufferID != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebufferID);
+		m_framebufferID = 0;
+	}
+	if (m_colorTextureID != 0)
+	{
+		glDeleteTextures(1, &m_colorTextureID);
+		m_colorTextureID = 0;
+	}
+	if (m_depthRenderbufferID != 0)
+	{
+		glDeleteRenderbuffers(1, &m_depthRenderbufferID);
+		m_depthRenderbufferID = 0;
+	}
+}
+
+/***********************************************************
+ *  GetTileOrigin()
+ *
+ *  This method is used to find the lower left corner of the
+ *  view's tile.  The first row of views is the top row of
+ *  the atlas.
+ ***********************************************************/
+void MultiViewTarget::GetTileOrigin(int view, int& x, int& y) const
+{
+	x = (view % TILE_COLUMNS) * m_tileWidth;
+	y = (TILE_ROWS - 1 - view / TILE_COLUMNS) * m_tileHeight;
+}
+
+/***********************************************************
+ *  Begin()
+ *
+ *  This method is used to bind the atlas for the views of a
+ *  pass and to clear every tile at once.  The viewports past
+ *  viewCount are left alone, the geometry shader does not
+ *  select them.
+ ***********************************************************/
+void MultiViewTarget::Begin(int viewCount, bool bViewportArray)
+{
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	glViewport(0, 0, m_tileWidth * TILE_COLUMNS, m_tileHeight * TILE_ROWS);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	if (bViewportArray == true)
+	{
+		GLfloat viewports[MAX_VIEWS * 4];
+		for (int i = 0; (i < viewCount) && (i < MAX_VIEWS); i++)
+		{
+			int x = 0;
+			int y = 0;
+			GetTileOrigin(i, x, y);
+			viewports[i * 4 + 0] = (GLfloat)x;
+			viewports[i * 4 + 1] = (GLfloat)y;
+			viewports[i * 4 + 2] = (GLfloat)m_tileWidth;
+			viewports[i * 4 + 3] = (GLfloat)m_tileHeight;
+		}
+		glViewportArrayv(0, (viewCount < MAX_VIEWS) ? viewCount : MAX_VIEWS, viewports);
+	}
+}
+
+/***********************************************************
+ *  SetTileViewport()
+ *
+ *  This method is used to draw into one tile with the
+ *  single viewport of an ordinary pass.
+ ***********************************************************/
+void MultiViewTarget::SetTileViewport(int view) const
+{
+	int x = 0;
+	int y = 0;
+	GetTileOrigin(view, x, y);
+	glViewport(x, y, m_tileWidth, m_tileHeight);
+}
+
+/***********************************************************
+ *  End()
+ *
+ *  This method is used to return to the framebuffer and the
+ *  viewport that were bound before Begin().  glViewport sets
+ *  every entry of the viewport array.
+ ***********************************************************/
+void MultiViewTarget::End()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+	glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+}
+
+/***********************************************************
+ *  SaveAtlas()
+ *
+ *  This method is used to read the atlas back and write it
+ *  as a binary PPM, top row first.
+ ***********************************************************/
+bool MultiViewTarget::SaveAtlas(const char* filename) const
+{
+	if (m_framebufferID == 0)
+	{
+		return(false);
+	}
+
+	int atlasWidth = m_tileWidth * TILE_COLUMNS;
+	int atlasHeight = m_tileHeight * TILE_ROWS;
+	std::vector<unsigned char> pixels((size_t)atlasWidth * atlasHeight * 3);
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferID);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, atlasWidth, atlasHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+
+	FILE* pFile = fopen(filename, "wb");
+	if (NULL == pFile)
+	{
+		std::cerr << "ERROR: Could not write the multi-view atlas: " << filename << std::endl;
+		return(false);
+	}
+
+	fprintf(pFile, "P6\n%d %d\n255\n", atlasWidth, atlasHeight);
+	size_t rowBytes = (size_t)atlasWidth * 3;
+	for (int y = atlasHeight - 1; y >= 0; y--)
+	{
+		fwrite(&pixels[(size_t)y * rowBytes], 1, rowBytes, pFile);
+	}
+	fclose(pFile);
+
+	std::cout << "INFO: Multi-view atlas written to " << filename << std::endl;
+	return(true);
+}
@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+// multiviewtarget.h
+// ============
+// atlas render target of the multi-view passes - one tile per camera in a
+// grid of up to 16 tiles, with a viewport array entry for each tile so that
+// a single submission can draw every view
+//
+//  View 0 is the top left tile, and the views go left to right, then down.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  MultiViewTarget
+ *
+ *  This class owns the atlas color texture, its depth
+ *  buffer and the tile layout.
+ ***********************************************************/
+class MultiViewTarget
+{
+public:
+	// must match MAX_VIEWS of the multi-view geometry shader
+	static const int MAX_VIEWS = 16;
+	static const int TILE_COLUMNS = 4;
+	static const int TILE_ROWS = (MAX_VIEWS + TILE_COLUMNS - 1) / TILE_COLUMNS;
+
+	// constructor
+	MultiViewTarget();
+	// destructor
+	~MultiViewTarget();
+
+	// create the atlas for tiles of the passed in size
+	bool Create(int tileWidth, int tileHeight);
+	void Destroy();
+	bool IsValid() const { return m_framebufferID != 0; }
+
+	// bind and clear the atlas; with viewport arrays the first
+	// viewCount viewports are set to the tiles of the views
+	void Begin(int viewCount, bool bViewportArray);
+	// draw into the tile of one view only, for a pass per view
+	void SetTileViewport(int view) const;
+	// bind the framebuffer and the viewport that Begin() replaced
+	void End();
+
+	int GetTileWidth() const { return m_tileWidth; }
+	int GetTileHeight() const { return m_tileHeight; }
+	float GetTileAspect() const { return (float)m_tileWidth / (float)m_tileHeight; }
+	// lower left corner of the view's tile in the atlas
+	void GetTileOrigin(int view, int& x, int& y) const;
+	// write the whole atlas as a binary PPM, top row first
+	bool SaveAtlas(const char* filename) const;
+
+private:
+	int m_tileWidth;
+	int m_tileHeight;
+	GLuint m_framebufferID;
+	GLuint m_colorTextureID;
+	GLuint m_depthRenderbufferID;
+	// state restored by End()
+	GLint m_previousFramebuffer;
+	GLint m_previousViewport[4];
+};
@@ -0,0 +1,471 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.cpp
+// ============
+// hardware occlusion culling of the recorded draws - bounding boxes are
+// tested with GL_ANY_SAMPLES_PASSED queries after the scene is drawn, and
+// the results are used on the following frame so that nothing stalls
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionCuller.h"
+#include "GLStateCache.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+/***********************************************************
+ *  OcclusionCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionCuller::OcclusionCuller()
+{
+	m_bConditionalRender = false;
+	m_bQueryActive = false;
+	m_stats.itemCount = 0;
+	m_stats.occludedCount = 0;
+	m_stats.conditionalCount = 0;
+	m_stats.queryCount = 0;
+	m_stats.queryCpuMilliseconds = 0.0;
+	m_timerQueryID = 0;
+	m_bTimerQueryPending = false;
+	m_queryStartTime = 0.0;
+	m_frameCount = 0;
+	m_totalOccluded = 0;
+	m_totalConditional = 0;
+	m_totalQueries = 0;
+	m_totalQueryCpuMs = 0.0;
+	m_gpuSampleCount = 0;
+	m_totalQueryGpuMs = 0.0;
+}
+
+/***********************************************************
+ *  ~OcclusionCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OcclusionCuller::~OcclusionCuller()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to check that GL_ANY_SAMPLES_PASSED
+ *  queries are supported, and whether conditional rendering
+ *  can be used for the items whose result is not back yet.
+ ***********************************************************/
+bool OcclusionCuller::Create()
+{
+	if (!GLEW_VERSION_3_3 && !GLEW_ARB_occlusion_query2)
+	{
+		std::cout << "WARNING: GL_ANY_SAMPLES_PASSED queries are not supported, occlusion culling is off" << std::endl;
+		return(false);
+	}
+
+	m_bConditionalRender = (GLEW_VERSION_3_0 || GLEW_NV_conditional_render);
+	glGenQueries(1, &m_timerQueryID);
+
+	std::cout << "INFO: Occlusion culling enabled, conditional rendering "
+		<< (m_bConditionalRender ? "on" : "off") << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to free the query objects.
+ ***********************************************************/
+void OcclusionCuller::Destroy()
+{
+	if (m_queries.empty() == false)
+	{
+		std::vector<GLuint> queryIDs(m_queries.size());
+		for (size_t i = 0; i < m_queries.size(); i++)
+		{
+			queryIDs[i] = m_queries[i].queryID;
+		}
+		glDeleteQueries((GLsizei)queryIDs.size(), queryIDs.data());
+	}
+	m_queries.clear();
+	m_freeQueries.clear();
+	m_keyQueries.clear();
+	m_itemQueries.clear();
+
+	if (m_timerQueryID != 0)
+	{
+		glDeleteQueries(1, &m_timerQueryID);
+		m_timerQueryID = 0;
+	}
+	m_bTimerQueryPending = false;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used to give every item of the frame the
+ *  query of its key, and to read back the queries that have
+ *  finished without waiting for the ones that have not.
+ *  The queries of the keys that are not drawn go back to
+ *  the pool, so an object that comes back into view starts
+ *  out visible instead of with a result from long ago.
+ ***********************************************************/
+void OcclusionCuller::BeginFrame(const std::vector<int>& itemKeys, int keyCount)
+{
+	CollectTimerQuery();
+
+	// another key range is another scene, none of the results
+	// belong to it
+	if ((int)m_keyQueries.size() != keyCount)
+	{
+		m_keyQueries.assign(keyCount, -1);
+		m_freeQueries.clear();
+		for (int i = (int)m_queries.size() - 1; i >= 0; i--)
+		{
+			ReleaseQuery(i);
+		}
+	}
+
+	int itemCount = (int)itemKeys.size();
+	for (size_t i = 0; i < m_queries.size(); i++)
+	{
+		m_queries[i].bUsed = false;
+	}
+	int missingCount = 0;
+	for (int i = 0; i < itemCount; i++)
+	{
+		int key = itemKeys[i];
+		if ((key < 0) || (key >= keyCount))
+		{
+			continue;
+		}
+		if (m_keyQueries[key] >= 0)
+		{
+			m_queries[m_keyQueries[key]].bUsed = true;
+		}
+		else
+		{
+			missingCount++;
+		}
+	}
+	for (int i = 0; i < (int)m_queries.size(); i++)
+	{
+		if ((m_queries[i].key >= 0) && !m_queries[i].bUsed)
+		{
+			m_keyQueries[m_queries[i].key] = -1;
+			ReleaseQuery(i);
+		}
+	}
+	if (missingCount > (int)m_freeQueries.size())
+	{
+		GrowQueries(missingCount - (int)m_freeQueries.size());
+	}
+
+	m_itemQueries.resize(itemCount);
+	for (int i = 0; i < itemCount; i++)
+	{
+		int key = itemKeys[i];
+		m_itemQueries[i] = -1;
+		if ((key < 0) || (key >= keyCount))
+		{
+			continue;
+		}
+		if ((m_keyQueries[key] < 0) && (m_freeQueries.empty() == false))
+		{
+			m_keyQueries[key] = m_freeQueries.back();
+			m_freeQueries.pop_back();
+			m_queries[m_keyQueries[key]].key = key;
+		}
+		m_itemQueries[i] = m_keyQueries[key];
+	}
+
+	m_stats.itemCount = itemCount;
+	m_stats.occludedCount = 0;
+	m_stats.conditionalCount = 0;
+	m_stats.queryCount = 0;
+
+	for (size_t i = 0; i < m_queries.size(); i++)
+	{
+		ITEM_QUERY& item = m_queries[i];
+		if (!item.bPending)
+		{
+			continue;
+		}
+
+		GLint available = 0;
+		glGetQueryObjectiv(item.queryID, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available != 0)
+		{
+			GLint anySamplesPassed = 0;
+			glGetQueryObjectiv(item.queryID, GL_QUERY_RESULT, &anySamplesPassed);
+			item.bOccluded = (anySamplesPassed == 0);
+			item.bPending = false;
+		}
+	}
+
+	for (int i = 0; i < itemCount; i++)
+	{
+		ITEM_VISIBILITY visibility = GetVisibility(i);
+		if (visibility == ITEM_OCCLUDED)
+		{
+			m_stats.occludedCount++;
+		}
+		else if (visibility == ITEM_CONDITIONAL)
+		{
+			m_stats.conditionalCount++;
+		}
+	}
+}
+
+/***********************************************************
+ *  GetVisibility()
+ *
+ *  This method is used to get how the passed in item is to
+ *  be drawn in this frame.
+ ***********************************************************/
+OcclusionCuller::ITEM_VISIBILITY OcclusionCuller::GetVisibility(int item) const
+{
+	int query = GetItemQuery(item);
+	if (query < 0)
+	{
+		return(ITEM_VISIBLE);
+	}
+
+	// the last query is still in flight - without conditional
+	// rendering the item is drawn to be safe
+	if (m_queries[query].bPending)
+	{
+		return(m_bConditionalRender ? ITEM_CONDITIONAL : ITEM_VISIBLE);
+	}
+
+	return(m_queries[query].bOccluded ? ITEM_OCCLUDED : ITEM_VISIBLE);
+}
+
+/***********************************************************
+ *  BeginConditional()
+ *
+ *  This method is used to start conditional rendering on the
+ *  item's in-flight query.  With GL_QUERY_NO_WAIT the GPU
+ *  draws anyway if the result is not ready either.
+ ***********************************************************/
+void OcclusionCuller::BeginConditional(int item) const
+{
+	glBeginConditionalRender(m_queries[m_itemQueries[item]].queryID, GL_QUERY_NO_WAIT);
+}
+
+/***********************************************************
+ *  EndConditional()
+ *
+ *  This method is used to stop conditional rendering.
+ ***********************************************************/
+void OcclusionCuller::EndConditional() const
+{
+	glEndConditionalRender();
+}
+
+/***********************************************************
+ *  BeginQueries()
+ *
+ *  This method is used to start the bounding box pass.  The
+ *  boxes only test against the depth buffer; they write
+ *  neither color nor depth.
+ ***********************************************************/
+void OcclusionCuller::BeginQueries()
+{
+	m_queryStartTime = TraceProfiler::NowMilliseconds();
+
+	if (!m_bTimerQueryPending && (m_timerQueryID != 0))
+	{
+		glBeginQuery(GL_TIME_ELAPSED, m_timerQueryID);
+		m_bTimerQueryPending = true;
+		m_bQueryActive = true;
+	}
+
+	GLStateCache::ColorMask(false);
+	GLStateCache::DepthMask(false);
+	GLStateCache::DepthFunc(GL_LEQUAL);
+}
+
+/***********************************************************
+ *  BeginQuery()
+ *
+ *  This method is used to start the query of one item.  An
+ *  item whose previous query is still in flight is skipped,
+ *  since its result has not been used yet.
+ ***********************************************************/
+bool OcclusionCuller::BeginQuery(int item)
+{
+	int query = GetItemQuery(item);
+	if ((query < 0) || m_queries[query].bPending)
+	{
+		return(false);
+	}
+
+	glBeginQuery(GL_ANY_SAMPLES_PASSED, m_queries[query].queryID);
+	m_queries[query].bPending = true;
+	m_stats.queryCount++;
+	return(true);
+}
+
+/***********************************************************
+ *  EndQuery()
+ *
+ *  This method is used to end the query of the current item.
+ ***********************************************************/
+void OcclusionCuller::EndQuery()
+{
+	glEndQuery(GL_ANY_SAMPLES_PASSED);
+}
+
+/***********************************************************
+ *  EndQueries()
+ *
+ *  This method is used to finish the bounding box pass and
+ *  restore the default write masks.
+ ***********************************************************/
+void OcclusionCuller::EndQueries()
+{
+	GLStateCache::ColorMask(true);
+	GLStateCache::DepthMask(true);
+	GLStateCache::DepthFunc(GL_LESS);
+
+	if (m_bQueryActive)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		m_bQueryActive = false;
+	}
+
+	m_stats.queryCpuMilliseconds = TraceProfiler::NowMilliseconds() - m_queryStartTime;
+
+	m_frameCount++;
+	m_totalOccluded += m_stats.occludedCount;
+	m_totalConditional += m_stats.conditionalCount;
+	m_totalQueries += m_stats.queryCount;
+	m_totalQueryCpuMs += m_stats.queryCpuMilliseconds;
+}
+
+/***********************************************************
+ *  ForceVisible()
+ *
+ *  This method is used to mark an item as visible without
+ *  testing it.
+ ***********************************************************/
+void OcclusionCuller::ForceVisible(int item)
+{
+	int query = GetItemQuery(item);
+	if ((query >= 0) && !m_queries[query].bPending)
+	{
+		m_queries[query].bOccluded = false;
+	}
+}
+
+/***********************************************************
+ *  GetItemQuery()
+ *
+ *  This method is used to find the pool entry of an item of
+ *  the frame.
+ ***********************************************************/
+int OcclusionCuller::GetItemQuery(int item) const
+{
+	if ((item < 0) || (item >= (int)m_itemQueries.size()))
+	{
+		return(-1);
+	}
+	return(m_itemQueries[item]);
+}
+
+/***********************************************************
+ *  ReleaseQuery()
+ *
+ *  This method is used to put a query back into the pool.
+ *  A query that is still in flight can be begun again, its
+ *  old result is never read.
+ ***********************************************************/
+void OcclusionCuller::ReleaseQuery(int query)
+{
+	m_queries[query].key = -1;
+	m_queries[query].bPending = false;
+	m_queries[query].bOccluded = false;
+	m_queries[query].bUsed = false;
+	m_freeQueries.push_back(query);
+}
+
+/***********************************************************
+ *  GrowQueries()
+ *
+ *  This method is used to add at least count queries to the
+ *  pool with a single glGenQueries call.  The pool grows by
+ *  half its size or a batch, so a growing scene does not
+ *  generate queries on every frame.
+ ***********************************************************/
+void OcclusionCuller::GrowQueries(int count)
+{
+	int growCount = std::max(count, std::max(QUERY_BATCH, (int)m_queries.size() / 2));
+	std::vector<GLuint> queryIDs(growCount);
+	glGenQueries(growCount, queryIDs.data());
+
+	int firstQuery = (int)m_queries.size();
+	m_queries.resize(firstQuery + growCount);
+	for (int i = growCount - 1; i >= 0; i--)
+	{
+		m_queries[firstQuery + i].queryID = queryIDs[i];
+		ReleaseQuery(firstQuery + i);
+	}
+}
+
+/***********************************************************
+ *  CollectTimerQuery()
+ *
+ *  This method is used to add the GPU time of the last
+ *  bounding box pass to the totals, if it has finished.
+ ***********************************************************/
+void OcclusionCuller::CollectTimerQuery()
+{
+	if (!m_bTimerQueryPending || m_bQueryActive)
+	{
+		return;
+	}
+
+	GLint available = 0;
+	glGetQueryObjectiv(m_timerQueryID, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available == 0)
+	{
+		return;
+	}
+
+	GLuint64 elapsedNanoseconds = 0;
+	glGetQueryObjectui64v(m_timerQueryID, GL_QUERY_RESULT, &elapsedNanoseconds);
+	m_totalQueryGpuMs += (double)elapsedNanoseconds / 1000000.0;
+	m_gpuSampleCount++;
+	m_bTimerQueryPending = false;
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used to print how many draws were culled
+ *  per frame and what the bounding box queries cost.
+ ***********************************************************/
+void OcclusionCuller::PrintStats()
+{
+	CollectTimerQuery();
+
+	std::cout << "INFO: Occlusion culling statistics\n";
+	if (m_frameCount > 0)
+	{
+		std::cout << "  frames: " << m_frameCount
+			<< ", draws " << m_stats.itemCount
+			<< ", avg occluded " << ((double)m_totalOccluded / m_frameCount)
+			<< ", avg conditional " << ((double)m_totalConditional / m_frameCount) << "\n";
+		std::cout << "  queries: avg " << ((double)m_totalQueries / m_frameCount)
+			<< " per frame, avg CPU " << (m_totalQueryCpuMs / m_frameCount) << " ms";
+		if (m_gpuSampleCount > 0)
+		{
+			std::cout << ", avg GPU " << (m_totalQueryGpuMs / m_gpuSampleCount) << " ms";
+		}
+		std::cout << "\n";
+	}
+	std::cout << std::endl;
+}
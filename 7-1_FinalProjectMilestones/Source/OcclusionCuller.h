@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.h
+// ============
+// hardware occlusion culling of the recorded draws - bounding boxes are
+// tested with GL_ANY_SAMPLES_PASSED queries after the scene is drawn, and
+// the results are used on the following frame so that nothing stalls
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  OcclusionCuller
+ *
+ *  This class owns a pool of occlusion queries, one for
+ *  every recorded draw item of the frame, and decides from
+ *  the previous frame's results which items are skipped,
+ *  drawn, or drawn conditionally.  The results follow the
+ *  items by a stable key, not by their place in the queue.
+ ***********************************************************/
+class OcclusionCuller
+{
+public:
+	// how an item is issued in the current frame
+	enum ITEM_VISIBILITY
+	{
+		ITEM_VISIBLE = 0,		// draw normally
+		ITEM_OCCLUDED,			// skip - the box was hidden last frame
+		ITEM_CONDITIONAL		// result not back yet - let the GPU decide
+	};
+
+	struct CULL_STATS
+	{
+		int itemCount;
+		int occludedCount;
+		int conditionalCount;
+		int queryCount;
+		double queryCpuMilliseconds;
+	};
+
+	// constructor
+	OcclusionCuller();
+	// destructor
+	~OcclusionCuller();
+
+	// check that the GL context supports the queries
+	bool Create();
+	// free the query objects
+	void Destroy();
+
+	// collect the finished query results and give every recorded
+	// draw of this frame its query; itemKeys holds a key below
+	// keyCount for each draw that names the same object on every
+	// frame, and a new keyCount drops all the results
+	void BeginFrame(const std::vector<int>& itemKeys, int keyCount);
+	ITEM_VISIBILITY GetVisibility(int item) const;
+
+	// draw calls between these are skipped by the GPU when the
+	// item's last query found no samples
+	void BeginConditional(int item) const;
+	void EndConditional() const;
+
+	// bounding box test pass, issued once the depth buffer of
+	// the frame is complete
+	void BeginQueries();
+	bool BeginQuery(int item);
+	void EndQuery();
+	void EndQueries();
+
+	// items whose box contains the camera are always visible,
+	// since the box faces would be clipped away
+	void ForceVisible(int item);
+
+	const CULL_STATS& GetStats() const { return m_stats; }
+	// print the average culled counts and the query overhead
+	void PrintStats();
+
+private:
+	// queries generated at once when the pool runs out
+	static const int QUERY_BATCH = 256;
+
+	struct ITEM_QUERY
+	{
+		GLuint queryID;
+		int key;			// -1 while the query is free
+		bool bPending;
+		bool bOccluded;
+		bool bUsed;			// the key was drawn in this frame
+	};
+
+	// the pool grows in batches and keeps its queries until
+	// Destroy(); the free entries are reused first
+	std::vector<ITEM_QUERY> m_queries;
+	std::vector<int> m_freeQueries;
+	// pool entry of each key, or -1 for the keys not drawn
+	std::vector<int> m_keyQueries;
+	// pool entry of each item of the frame
+	std::vector<int> m_itemQueries;
+	bool m_bConditionalRender;
+	bool m_bQueryActive;
+	CULL_STATS m_stats;
+
+	// GPU timer around the bounding box pass, read back
+	// non-blocking on a later frame
+	GLuint m_timerQueryID;
+	bool m_bTimerQueryPending;
+	double m_queryStartTime;
+
+	// accumulated statistics
+	uint64_t m_frameCount;
+	uint64_t m_totalOccluded;
+	uint64_t m_totalConditional;
+	uint64_t m_totalQueries;
+	double m_totalQueryCpuMs;
+	uint64_t m_gpuSampleCount;
+	double m_totalQueryGpuMs;
+
+	// pool entry of an item of the frame, or -1
+	int GetItemQuery(int item) const;
+	// return a query to the pool with its result dropped
+	void ReleaseQuery(int query);
+	// generate at least count more queries
+	void GrowQueries(int count);
+	// collect the GPU time of the last bounding box pass
+	void CollectTimerQuery();
+};
@@ -0,0 +1,565 @@
+///////////////////////////////////////////////////////////////////////////////
+// perfhud.cpp
+// ============
+// performance HUD - live frame rate, a CPU/GPU frame time graph and the draw
+// counters of the last frame, drawn over the window as one batch of quads
+// that sample a bitmap font atlas
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PerfHud.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	const char* g_HudVertexShaderPath = "shaders/hudVertexShader.glsl";
+	const char* g_HudFragmentShaderPath = "shaders/hudFragmentShader.glsl";
+
+	// 5x7 glyphs of the characters from ' ' to '_', one byte per
+	// row with the leftmost pixel in bit 4 - the HUD text is upper
+	// case, so lower case letters are drawn with these glyphs too
+	const int FIRST_GLYPH = ' ';
+	const int GLYPH_COUNT = 64;
+	const int GLYPH_WIDTH = 5;
+	const int GLYPH_HEIGHT = 7;
+	const unsigned char g_FontGlyphs[GLYPH_COUNT][GLYPH_HEIGHT] =
+	{
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// space
+		{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 },	// '!'
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '"'
+		{ 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A },	// '#'
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '$'
+		{ 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },	// '%'
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '&'
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '''
+		{ 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },	// '('
+		{ 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },	// ')'
+		{ 0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00 },	// '*'
+		{ 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 },	// '+'
+		{ 0x00, 0x00, 0x00, 0x00, 0x06, 0x02, 0x04 },	// ','
+		{ 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 },	// '-'
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C },	// '.'
+		{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },	// '/'
+		{ 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },	// '0'
+		{ 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },	// '1'
+		{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },	// '2'
+		{ 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },	// '3'
+		{ 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },	// '4'
+		{ 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },	// '5'
+		{ 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },	// '6'
+		{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },	// '7'
+		{ 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },	// '8'
+		{ 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },	// '9'
+		{ 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },	// ':'
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// ';'
+		{ 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 },	// '<'
+		{ 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 },	// '='
+		{ 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 },	// '>'
+		{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 },	// '?'
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '@'
+		{ 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },	// 'A'
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },	// 'B'
+		{ 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },	// 'C'
+		{ 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },	// 'D'
+		{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },	// 'E'
+		{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },	// 'F'
+		{ 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },	// 'G'
+		{ 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },	// 'H'
+		{ 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },	// 'I'
+		{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },	// 'J'
+		{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },	// 'K'
+		{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },	// 'L'
+		{ 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },	// 'M'
+		{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },	// 'N'
+		{ 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },	// 'O'
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },	// 'P'
+		{ 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },	// 'Q'
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },	// 'R'
+		{ 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },	// 'S'
+		{ 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	// 'T'
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },	// 'U'
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },	// 'V'
+		{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },	// 'W'
+		{ 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },	// 'X'
+		{ 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04 },	// 'Y'
+		{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F },	// 'Z'
+		{ 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E },	// '['
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '\'
+		{ 0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E },	// ']'
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '^'
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F }	// '_'
+	};
+
+	// the atlas holds 16 x 4 cells of 8 x 8 texels; the last texel
+	// of the last cell is set for the solid rectangles
+	const int ATLAS_COLUMNS = 16;
+	const int CELL_SIZE = 8;
+	const int ATLAS_WIDTH = ATLAS_COLUMNS * CELL_SIZE;
+	const int ATLAS_HEIGHT = (GLYPH_COUNT / ATLAS_COLUMNS) * CELL_SIZE;
+
+	// every atlas texel is drawn as 2 x 2 pixels, and a character
+	// advances by its glyph plus one texel of spacing
+	const float TEXT_SCALE = 2.0f;
+	const float CHAR_ADVANCE = (GLYPH_WIDTH + 1) * TEXT_SCALE;
+	const float LINE_HEIGHT = (GLYPH_HEIGHT + 3) * TEXT_SCALE;
+
+	// panel placement in pixels from the top left corner
+	const float PANEL_MARGIN = 8.0f;
+	const float PANEL_PADDING = 8.0f;
+	const int PANEL_COLUMNS = 40;
+	const float GRAPH_HEIGHT = 80.0f;
+	// frame time at the top of the graph, with a mark at 60 Hz
+	const double GRAPH_MAX_MILLISECONDS = 33.3;
+	const double GRAPH_TARGET_MILLISECONDS = 16.7;
+
+	const GLubyte PANEL_COLOR[4] = { 0, 0, 0, 160 };
+	const GLubyte TEXT_COLOR[4] = { 230, 230, 230, 255 };
+	const GLubyte CPU_COLOR[4] = { 90, 220, 90, 255 };
+	const GLubyte GPU_COLOR[4] = { 250, 160, 40, 255 };
+	const GLubyte TARGET_COLOR[4] = { 255, 255, 255, 90 };
+	const GLubyte HUD_COLOR[4] = { 140, 170, 230, 255 };
+}
+
+/***********************************************************
+ *  PerfHud()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+PerfHud::PerfHud()
+{
+	m_windowWidth = 0;
+	m_windowHeight = 0;
+	m_fontTextureID = 0;
+	m_vertexArrayID = 0;
+	m_vertexBufferID = 0;
+	m_vertexBufferSize = 0;
+	m_pHudShaderManager = NULL;
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		m_timerQueryIDs[i][0] = 0;
+		m_timerQueryIDs[i][1] = 0;
+		m_bTimerPending[i] = false;
+	}
+	m_timerIndex = 0;
+	m_lastFrame = HUD_FRAME_STATS();
+	for (int i = 0; i < GRAPH_FRAMES; i++)
+	{
+		m_cpuHistory[i] = 0.0;
+		m_gpuHistory[i] = 0.0;
+	}
+	m_historyIndex = 0;
+	m_historyCount = 0;
+	m_hudCpuMilliseconds = 0.0;
+	m_hudGpuMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~PerfHud()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+PerfHud::~PerfHud()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to expand the glyph bitmaps into the
+ *  font atlas texture, to create the streamed vertex buffer
+ *  and to load the overlay shaders.
+ ***********************************************************/
+bool PerfHud::Create(int windowWidth, int windowHeight)
+{
+	m_windowWidth = windowWidth;
+	m_windowHeight = windowHeight;
+
+	std::vector<GLubyte> atlas(ATLAS_WIDTH * ATLAS_HEIGHT, 0);
+	for (int glyph = 0; glyph < GLYPH_COUNT; glyph++)
+	{
+		int cellX = (glyph % ATLAS_COLUMNS) * CELL_SIZE;
+		int cellY = (glyph / ATLAS_COLUMNS) * CELL_SIZE;
+		for (int row = 0; row < GLYPH_HEIGHT; row++)
+		{
+			for (int column = 0; column < GLYPH_WIDTH; column++)
+			{
+				if ((g_FontGlyphs[glyph][row] & (0x10 >> column)) != 0)
+				{
+					atlas[(cellY + row) * ATLAS_WIDTH + cellX + column] = 255;
+				}
+			}
+		}
+	}
+	atlas[ATLAS_WIDTH * ATLAS_HEIGHT - 1] = 255;
+
+	glGenTextures(1, &m_fontTextureID);
+	glBindTexture(GL_TEXTURE_2D, m_fontTextureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_WIDTH, ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenVertexArrays(1, &m_vertexArrayID);
+	glGenBuffers(1, &m_vertexBufferID);
+	glBindVertexArray(m_vertexArrayID);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferID);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HUD_VERTEX), (void*)offsetof(HUD_VERTEX, x));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(HUD_VERTEX), (void*)offsetof(HUD_VERTEX, u));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HUD_VERTEX), (void*)offsetof(HUD_VERTEX, color));
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		glGenQueries(2, m_timerQueryIDs[i]);
+	}
+
+	// loading leaves the new program bound, so the scene program
+	// is restored afterwards
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	m_pHudShaderManager = new ShaderManager();
+	m_pHudShaderManager->LoadShaders(g_HudVertexShaderPath, g_HudFragmentShaderPath);
+	glUseProgram(previousProgram);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to free the font atlas, the vertex
+ *  buffer, the queries and the overlay program.
+ ***********************************************************/
+void PerfHud::Destroy()
+{
+	if (m_fontTextureID != 0)
+	{
+		glDeleteTextures(1, &m_fontTextureID);
+		m_fontTextureID = 0;
+	}
+	if (m_vertexBufferID != 0)
+	{
+		glDeleteBuffers(1, &m_vertexBufferID);
+		m_vertexBufferID = 0;
+		m_vertexBufferSize = 0;
+	}
+	if (m_vertexArrayID != 0)
+	{
+		glDeleteVertexArrays(1, &m_vertexArrayID);
+		m_vertexArrayID = 0;
+	}
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		if (m_timerQueryIDs[i][0] != 0)
+		{
+			glDeleteQueries(2, m_timerQueryIDs[i]);
+			m_timerQueryIDs[i][0] = 0;
+			m_timerQueryIDs[i][1] = 0;
+		}
+		m_bTimerPending[i] = false;
+	}
+	if (NULL != m_pHudShaderManager)
+	{
+		delete m_pHudShaderManager;
+		m_pHudShaderManager = NULL;
+	}
+}
+
+/***********************************************************
+ *  AddFrame()
+ *
+ *  This method is used to keep the counters of the finished
+ *  frame and to add its frame times to the graph history.
+ ***********************************************************/
+void PerfHud::AddFrame(const HUD_FRAME_STATS& stats)
+{
+	m_lastFrame = stats;
+	m_cpuHistory[m_historyIndex] = stats.cpuMilliseconds;
+	m_gpuHistory[m_historyIndex] = stats.gpuMilliseconds;
+	m_historyIndex = (m_historyIndex + 1) % GRAPH_FRAMES;
+	m_historyCount = std::min(m_historyCount + 1, (int)GRAPH_FRAMES);
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is used to build the quads of the panel, the
+ *  text and the graph into one vertex batch, and to draw it
+ *  over the window with alpha blending.  The time spent here
+ *  and the GPU time of the draw are shown on a later frame.
+ ***********************************************************/
+void PerfHud::Draw()
+{
+	TRACE_SCOPE("DrawPerfHud");
+	if ((m_vertexArrayID == 0) || (NULL == m_pHudShaderManager))
+	{
+		return;
+	}
+
+	double startTime = TraceProfiler::NowMilliseconds();
+	CollectTimers();
+
+	// the numbers are averaged over the graph, so that they can be
+	// read while they change every frame
+	double cpuAverage = 0.0;
+	double gpuAverage = 0.0;
+	for (int i = 0; i < m_historyCount; i++)
+	{
+		cpuAverage += m_cpuHistory[i];
+		gpuAverage += m_gpuHistory[i];
+	}
+	if (m_historyCount > 0)
+	{
+		cpuAverage /= m_historyCount;
+		gpuAverage /= m_historyCount;
+	}
+	double framesPerSecond = (cpuAverage > 0.0) ? (1000.0 / cpuAverage) : 0.0;
+
+	float panelWidth = PANEL_COLUMNS * CHAR_ADVANCE + PANEL_PADDING * 2.0f;
+	float panelHeight = LINE_HEIGHT * 7.0f + GRAPH_HEIGHT + PANEL_PADDING * 3.0f;
+	float x = PANEL_MARGIN + PANEL_PADDING;
+	float y = PANEL_MARGIN + PANEL_PADDING;
+	char text[128];
+
+	m_vertices.clear();
+	AddRect(PANEL_MARGIN, PANEL_MARGIN, panelWidth, panelHeight, PANEL_COLOR);
+
+	snprintf(text, sizeof(text), "FPS %.1f", framesPerSecond);
+	AddText(x, y, text, TEXT_COLOR);
+	y += LINE_HEIGHT;
+	snprintf(text, sizeof(text), "CPU %.2f MS", cpuAverage);
+	AddText(x, y, text, CPU_COLOR);
+	snprintf(text, sizeof(text), "GPU %.2f MS", gpuAverage);
+	AddText(x + CHAR_ADVANCE * 20.0f, y, text, GPU_COLOR);
+	y += LINE_HEIGHT;
+
+	AddGraph(x, y, PANEL_COLUMNS * CHAR_ADVANCE, GRAPH_HEIGHT);
+	y += GRAPH_HEIGHT + PANEL_PADDING;
+
+	snprintf(text, sizeof(text), "DRAWS %d", m_lastFrame.drawCalls);
+	AddText(x, y, text, TEXT_COLOR);
+	snprintf(text, sizeof(text), "TRIS %llu", (unsigned long long)m_lastFrame.triangles);
+	AddText(x + CHAR_ADVANCE * 20.0f, y, text, TEXT_COLOR);
+	y += LINE_HEIGHT;
+	snprintf(text, sizeof(text), "TEX BINDS %d", m_lastFrame.textureBinds);
+	AddText(x, y, text, TEXT_COLOR);
+	snprintf(text, sizeof(text), "UNIFORMS %d", m_lastFrame.uniformUploads);
+	AddText(x + CHAR_ADVANCE * 20.0f, y, text, TEXT_COLOR);
+	y += LINE_HEIGHT;
+	snprintf(text, sizeof(text), "CULLED %d", m_lastFrame.culledObjects);
+	AddText(x, y, text, TEXT_COLOR);
+	snprintf(text, sizeof(text), "FILTERED %d", m_lastFrame.filteredStateCalls);
+	AddText(x + CHAR_ADVANCE * 20.0f, y, text, TEXT_COLOR);
+	y += LINE_HEIGHT;
+	snprintf(text, sizeof(text), "ALLOCS %llu", (unsigned long long)m_lastFrame.allocations);
+	AddText(x, y, text, TEXT_COLOR);
+	snprintf(text, sizeof(text), "ALLOC KB %.1f", m_lastFrame.allocatedBytes / 1024.0);
+	AddText(x + CHAR_ADVANCE * 20.0f, y, text, TEXT_COLOR);
+	y += LINE_HEIGHT;
+
+	// the overlay's own cost, measured on an earlier frame
+	snprintf(text, sizeof(text), "HUD CPU %.3f MS  GPU %.3f MS", m_hudCpuMilliseconds, m_hudGpuMilliseconds);
+	AddText(x, y, text, HUD_COLOR);
+
+	GLsizei vertexCount = (GLsizei)m_vertices.size();
+	size_t dataSize = m_vertices.size() * sizeof(HUD_VERTEX);
+
+	// the buffer is orphaned every frame, so that the upload never
+	// waits for the draw of the previous frame
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBufferID);
+	m_vertexBufferSize = std::max(m_vertexBufferSize, dataSize);
+	glBufferData(GL_ARRAY_BUFFER, m_vertexBufferSize, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, dataSize, m_vertices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLboolean bBlendEnabled = glIsEnabled(GL_BLEND);
+
+	// a slot whose result has not come back yet is skipped, and
+	// that frame simply goes unmeasured
+	bool bTimerStarted = !m_bTimerPending[m_timerIndex];
+	if (bTimerStarted == true)
+	{
+		glQueryCounter(m_timerQueryIDs[m_timerIndex][0], GL_TIMESTAMP);
+	}
+
+	glViewport(0, 0, m_windowWidth, m_windowHeight);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glActiveTexture(GL_TEXTURE0 + FONT_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_fontTextureID);
+
+	m_pHudShaderManager->use();
+	m_pHudShaderManager->setIntValue("fontTexture", FONT_TEXTURE_UNIT);
+	m_pHudShaderManager->setVec2Value("screenSize", (float)m_windowWidth, (float)m_windowHeight);
+
+	glBindVertexArray(m_vertexArrayID);
+	glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+	glBindVertexArray(0);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glEnable(GL_DEPTH_TEST);
+	if (bBlendEnabled == GL_FALSE)
+	{
+		glDisable(GL_BLEND);
+	}
+	glUseProgram(previousProgram);
+
+	if (bTimerStarted == true)
+	{
+		glQueryCounter(m_timerQueryIDs[m_timerIndex][1], GL_TIMESTAMP);
+		m_bTimerPending[m_timerIndex] = true;
+	}
+	m_timerIndex = (m_timerIndex + 1) % TIMER_FRAMES;
+
+	m_hudCpuMilliseconds = TraceProfiler::NowMilliseconds() - startTime;
+}
+
+/***********************************************************
+ *  CollectTimers()
+ *
+ *  This method is used to read the GPU time of the overlay
+ *  from every frame whose timestamps have come back.
+ ***********************************************************/
+void PerfHud::CollectTimers()
+{
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		if (!m_bTimerPending[i])
+		{
+			continue;
+		}
+
+		GLint available = 0;
+		glGetQueryObjectiv(m_timerQueryIDs[i][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0)
+		{
+			continue;
+		}
+
+		GLuint64 startTime = 0;
+		GLuint64 endTime = 0;
+		glGetQueryObjectui64v(m_timerQueryIDs[i][0], GL_QUERY_RESULT, &startTime);
+		glGetQueryObjectui64v(m_timerQueryIDs[i][1], GL_QUERY_RESULT, &endTime);
+		m_bTimerPending[i] = false;
+
+		m_hudGpuMilliseconds = (double)(endTime - startTime) / 1000000.0;
+	}
+}
+
+/***********************************************************
+ *  AddRect()
+ *
+ *  This method is used to append a solid rectangle, which
+ *  samples the one solid texel of the atlas.
+ ***********************************************************/
+void PerfHud::AddRect(float x, float y, float width, float height, const GLubyte color[4])
+{
+	float u = (ATLAS_WIDTH - 0.5f) / ATLAS_WIDTH;
+	float v = (ATLAS_HEIGHT - 0.5f) / ATLAS_HEIGHT;
+	HUD_VERTEX corners[4] = {
+		{ x, y, u, v, { color[0], color[1], color[2], color[3] } },
+		{ x + width, y, u, v, { color[0], color[1], color[2], color[3] } },
+		{ x + width, y + height, u, v, { color[0], color[1], color[2], color[3] } },
+		{ x, y + height, u, v, { color[0], color[1], color[2], color[3] } } };
+
+	m_vertices.push_back(corners[0]);
+	m_vertices.push_back(corners[1]);
+	m_vertices.push_back(corners[2]);
+	m_vertices.push_back(corners[0]);
+	m_vertices.push_back(corners[2]);
+	m_vertices.push_back(corners[3]);
+}
+
+/***********************************************************
+ *  AddText()
+ *
+ *  This method is used to append one quad per character of
+ *  the text, with its top left corner at the passed in
+ *  position.  Characters outside the atlas are drawn as '?'.
+ ***********************************************************/
+void PerfHud::AddText(float x, float y, const char* text, const GLubyte color[4])
+{
+	float glyphWidth = GLYPH_WIDTH * TEXT_SCALE;
+	float glyphHeight = GLYPH_HEIGHT * TEXT_SCALE;
+
+	for (const char* pChar = text; *pChar != '\0'; pChar++, x += CHAR_ADVANCE)
+	{
+		int character = *pChar;
+		if ((character >= 'a') && (character <= 'z'))
+		{
+			character += 'A' - 'a';
+		}
+		if (character == ' ')
+		{
+			continue;
+		}
+		int glyph = character - FIRST_GLYPH;
+		if ((glyph < 0) || (glyph >= GLYPH_COUNT))
+		{
+			glyph = '?' - FIRST_GLYPH;
+		}
+
+		float u0 = (float)((glyph % ATLAS_COLUMNS) * CELL_SIZE) / ATLAS_WIDTH;
+		float v0 = (float)((glyph / ATLAS_COLUMNS) * CELL_SIZE) / ATLAS_HEIGHT;
+		float u1 = u0 + (float)GLYPH_WIDTH / ATLAS_WIDTH;
+		float v1 = v0 + (float)GLYPH_HEIGHT / ATLAS_HEIGHT;
+		HUD_VERTEX corners[4] = {
+			{ x, y, u0, v0, { color[0], color[1], color[2], color[3] } },
+			{ x + glyphWidth, y, u1, v0, { color[0], color[1], color[2], color[3] } },
+			{ x + glyphWidth, y + glyphHeight, u1, v1, { color[0], color[1], color[2], color[3] } },
+			{ x, y + glyphHeight, u0, v1, { color[0], color[1], color[2], color[3] } } };
+
+		m_vertices.push_back(corners[0]);
+		m_vertices.push_back(corners[1]);
+		m_vertices.push_back(corners[2]);
+		m_vertices.push_back(corners[0]);
+		m_vertices.push_back(corners[2]);
+		m_vertices.push_back(corners[3]);
+	}
+}
+
+/***********************************************************
+ *  AddGraph()
+ *
+ *  This method is used to append one bar per recorded frame,
+ *  oldest on the left, with the GPU time drawn over the CPU
+ *  time and a line at the 60 Hz frame time.
+ ***********************************************************/
+void PerfHud::AddGraph(float x, float y, float width, float height)
+{
+	float barWidth = width / GRAPH_FRAMES;
+	float bottom = y + height;
+
+	for (int i = 0; i < m_historyCount; i++)
+	{
+		// the oldest frame is the next one to be overwritten
+		int index = (m_historyIndex - m_historyCount + i + GRAPH_FRAMES) % GRAPH_FRAMES;
+		float barX = x + (GRAPH_FRAMES - m_historyCount + i) * barWidth;
+
+		float cpuHeight = (float)(std::min(m_cpuHistory[index], GRAPH_MAX_MILLISECONDS) / GRAPH_MAX_MILLISECONDS) * height;
+		float gpuHeight = (float)(std::min(m_gpuHistory[index], GRAPH_MAX_MILLISECONDS) / GRAPH_MAX_MILLISECONDS) * height;
+		AddRect(barX, bottom - cpuHeight, barWidth - 1.0f, cpuHeight, CPU_COLOR);
+		AddRect(barX + barWidth * 0.25f, bottom - gpuHeight, barWidth * 0.5f, gpuHeight, GPU_COLOR);
+	}
+
+	float targetY = bottom - (float)(GRAPH_TARGET_MILLISECONDS / GRAPH_MAX_MILLISECONDS) * height;
+	AddRect(x, targetY, width, 1.0f, TARGET_COLOR);
+}
@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// perfhud.h
+// ============
+// performance HUD - live frame rate, a CPU/GPU frame time graph and the draw
+// counters of the last frame, drawn over the window as one batch of quads
+// that sample a bitmap font atlas
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  PerfHud
+ *
+ *  This class owns the font atlas, the streamed vertex
+ *  buffer and the frame time history of the overlay, and
+ *  measures what drawing the overlay itself costs.
+ ***********************************************************/
+class PerfHud
+{
+public:
+	// numbers of one finished frame, passed in by the main loop
+	struct HUD_FRAME_STATS
+	{
+		double cpuMilliseconds;		// wall clock time since the last frame
+		double gpuMilliseconds;		// GPU time of the scene passes
+		int drawCalls;
+		uint64_t triangles;
+		int textureBinds;
+		int uniformUploads;
+		int culledObjects;
+		int filteredStateCalls;		// no-op calls dropped by the state cache
+		uint64_t allocations;		// heap allocations, from the memory tracker
+		uint64_t allocatedBytes;
+	};
+
+	// frames shown in the frame time graph
+	static const int GRAPH_FRAMES = 120;
+	// texture unit the font atlas is sampled from while drawing
+	static const int FONT_TEXTURE_UNIT = 9;
+
+	// constructor
+	PerfHud();
+	// destructor
+	~PerfHud();
+
+	// build the font atlas and load the overlay shaders for a
+	// window of the passed in framebuffer size
+	bool Create(int windowWidth, int windowHeight);
+	void Destroy();
+
+	// add the numbers of the finished frame to the history - it is
+	// called every frame, so that the graph is filled when shown
+	void AddFrame(const HUD_FRAME_STATS& stats);
+	// draw the overlay over the window with one draw call
+	void Draw();
+
+private:
+	// position in pixels from the top left corner of the window,
+	// atlas coordinates and color
+	struct HUD_VERTEX
+	{
+		float x;
+		float y;
+		float u;
+		float v;
+		GLubyte color[4];
+	};
+
+	// timestamps around the overlay's own draw, read back a few
+	// frames later without a stall
+	static const int TIMER_FRAMES = 4;
+
+	int m_windowWidth;
+	int m_windowHeight;
+	GLuint m_fontTextureID;
+	GLuint m_vertexArrayID;
+	GLuint m_vertexBufferID;
+	size_t m_vertexBufferSize;
+	ShaderManager* m_pHudShaderManager;
+	std::vector<HUD_VERTEX> m_vertices;
+
+	GLuint m_timerQueryIDs[TIMER_FRAMES][2];
+	bool m_bTimerPending[TIMER_FRAMES];
+	int m_timerIndex;
+
+	// ring of the last GRAPH_FRAMES frame times
+	HUD_FRAME_STATS m_lastFrame;
+	double m_cpuHistory[GRAPH_FRAMES];
+	double m_gpuHistory[GRAPH_FRAMES];
+	int m_historyIndex;
+	int m_historyCount;
+
+	// cost of the overlay, shown on the next frame
+	double m_hudCpuMilliseconds;
+	double m_hudGpuMilliseconds;
+
+	// read back the finished overlay timers
+	void CollectTimers();
+	// append a solid rectangle or a line of text to the batch
+	void AddRect(float x, float y, float width, float height, const GLubyte color[4]);
+	void AddText(float x, float y, const char* text, const GLubyte color[4]);
+	// append the frame time graph to the batch
+	void AddGraph(float x, float y, float width, float height);
+};
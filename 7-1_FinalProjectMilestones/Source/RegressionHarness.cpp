@@ -0,0 +1,449 @@
+///////////////////////////////////////////////////////////////////////////////
+// regressionharness.cpp
+// ============
+// golden image and frame time regression checks of the desk scene - a fixed
+// list of camera poses is rendered offscreen and compared against stored
+// reference images and a baseline of frame times
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RegressionHarness.h"
+#include "GLStateCache.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// declaration of the global variables and defines
+namespace
+{
+	// frames rendered before the image is taken, so that the
+	// shadow cache and the occlusion results have settled
+	const int WARMUP_FRAMES = 10;
+	// frames timed per pose; the median is compared
+	const int MEASURED_FRAMES = 30;
+
+	// a pixel counts as changed above this CIE76 color distance,
+	// a little over twice the just noticeable difference
+	const float PIXEL_DELTA_E = 5.0f;
+	// the image fails when more pixels than this change, or when
+	// the average distance over the image grows above the limit
+	const float MAX_CHANGED_PIXEL_FRACTION = 0.001f;
+	const float MAX_MEAN_DELTA_E = 1.0f;
+
+	// a frame time regression has to exceed both limits, so that
+	// timer noise on very short frames is not reported
+	const double MAX_FRAME_TIME_INCREASE = 0.15;
+	const double MIN_FRAME_TIME_INCREASE_MS = 0.5;
+
+	const char* g_BaselineFilename = "frametimes.txt";
+
+	// the fixed camera poses, covering both projections
+	struct CAMERA_POSE
+	{
+		const char* name;
+		glm::vec3 position;
+		glm::vec3 front;
+		float zoom;
+		bool bOrthographic;
+	};
+
+	const CAMERA_POSE g_CameraPoses[] = {
+		{ "perspective_default", glm::vec3(0.0f, 5.0f, 12.0f), glm::vec3(0.0f, -0.5f, -2.0f), 80.0f, false },
+		{ "perspective_desk", glm::vec3(0.0f, 6.0f, 5.0f), glm::vec3(0.0f, -0.6f, -1.0f), 60.0f, false },
+		{ "perspective_left", glm::vec3(-10.0f, 6.0f, 6.0f), glm::vec3(1.0f, -0.4f, -0.8f), 70.0f, false },
+		{ "perspective_right", glm::vec3(10.0f, 4.0f, 4.0f), glm::vec3(-1.0f, -0.2f, -0.6f), 70.0f, false },
+		{ "orthographic_front", glm::vec3(0.0f, 0.0f, 12.0f), glm::vec3(0.0f, 0.0f, -1.0f), 80.0f, true }
+	};
+
+	// result of one pose, for the summary
+	struct POSE_RESULT
+	{
+		std::string name;
+		bool bImagePassed;
+		bool bTimePassed;
+		float meanDeltaE;
+		float changedFraction;
+		double frameTime;
+		double baselineTime;
+		std::string note;
+	};
+
+	/***********************************************************
+	 *  RenderOffscreen()
+	 *
+	 *  Render one frame of the scene into the bound target and
+	 *  wait for the GPU, returning the frame time.
+	 ***********************************************************/
+	double RenderOffscreen(
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager)
+	{
+		double startTime = TraceProfiler::NowMilliseconds();
+
+		GLStateCache::Enable(GL_DEPTH_TEST);
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		pViewManager->PrepareSceneView();
+		pSceneManager->SetViewTransform(pViewManager->GetViewMatrix(), pViewManager->GetProjectionMatrix());
+		pSceneManager->RenderScene();
+
+		glFinish();
+		double frameTime = TraceProfiler::NowMilliseconds() - startTime;
+
+		// keep the window responsive while the poses render
+		glfwPollEvents();
+
+		return(frameTime);
+	}
+
+	/***********************************************************
+	 *  WritePpm()
+	 *
+	 *  Write a top down RGB image as a binary PPM file.
+	 ***********************************************************/
+	bool WritePpm(const std::string& filename, int width, int height, const std::vector<unsigned char>& pixels)
+	{
+		FILE* pFile = fopen(filename.c_str(), "wb");
+		if (NULL == pFile)
+		{
+			std::cerr << "ERROR: Could not write " << filename << std::endl;
+			return(false);
+		}
+		fprintf(pFile, "P6\n%d %d\n255\n", width, height);
+		fwrite(pixels.data(), 1, pixels.size(), pFile);
+		fclose(pFile);
+		return(true);
+	}
+
+	/***********************************************************
+	 *  ReadPpm()
+	 *
+	 *  Read a binary PPM file written by WritePpm().
+	 ***********************************************************/
+	bool ReadPpm(const std::string& filename, int& width, int& height, std::vector<unsigned char>& pixels)
+	{
+		FILE* pFile = fopen(filename.c_str(), "rb");
+		if (NULL == pFile)
+		{
+			return(false);
+		}
+
+		int maxValue = 0;
+		bool bRead = (fscanf(pFile, "P6 %d %d %d", &width, &height, &maxValue) == 3) && (maxValue == 255);
+		if (bRead)
+		{
+			// a single whitespace byte ends the header
+			fgetc(pFile);
+			pixels.resize((size_t)width * height * 3);
+			bRead = (fread(pixels.data(), 1, pixels.size(), pFile) == pixels.size());
+		}
+		fclose(pFile);
+		return(bRead);
+	}
+
+	/***********************************************************
+	 *  ToLab()
+	 *
+	 *  Convert an 8-bit sRGB color to CIE L*a*b* (D65), where
+	 *  distances roughly follow perceived differences.
+	 ***********************************************************/
+	glm::vec3 ToLab(const unsigned char* pColor)
+	{
+		static float linearTable[256];
+		static bool bTableReady = false;
+		if (!bTableReady)
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float c = i / 255.0f;
+				linearTable[i] = (c <= 0.04045f) ? (c / 12.92f) : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+			bTableReady = true;
+		}
+
+		float r = linearTable[pColor[0]];
+		float g = linearTable[pColor[1]];
+		float b = linearTable[pColor[2]];
+
+		// XYZ relative to the D65 white point
+		float xyz[3] = {
+			(0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f,
+			(0.2126f * r + 0.7152f * g + 0.0722f * b),
+			(0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f
+		};
+		for (int i = 0; i < 3; i++)
+		{
+			xyz[i] = (xyz[i] > 0.008856f) ? cbrtf(xyz[i]) : (7.787f * xyz[i] + 16.0f / 116.0f);
+		}
+
+		return(glm::vec3(
+			116.0f * xyz[1] - 16.0f,
+			500.0f * (xyz[0] - xyz[1]),
+			200.0f * (xyz[1] - xyz[2])));
+	}
+
+	/***********************************************************
+	 *  CompareImages()
+	 *
+	 *  Compare two images of the same size pixel by pixel in
+	 *  L*a*b*, and build a diff image where the changed pixels
+	 *  are red over a darkened copy of the golden.
+	 ***********************************************************/
+	void CompareImages(
+		const std::vector<unsigned char>& golden,
+		const std::vector<unsigned char>& actual,
+		float& meanDeltaE,
+		float& changedFraction,
+		std::vector<unsigned char>& diff)
+	{
+		size_t pixelCount = golden.size() / 3;
+		double totalDeltaE = 0.0;
+		size_t changedPixels = 0;
+		diff.resize(golden.size());
+
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			float deltaE = glm::length(ToLab(&golden[i * 3]) - ToLab(&actual[i * 3]));
+			totalDeltaE += deltaE;
+
+			unsigned char gray = (unsigned char)((golden[i * 3] + golden[i * 3 + 1] + golden[i * 3 + 2]) / 12);
+			if (deltaE > PIXEL_DELTA_E)
+			{
+				changedPixels++;
+				diff[i * 3 + 0] = (unsigned char)std::min(255.0f, 128.0f + deltaE * 4.0f);
+				diff[i * 3 + 1] = gray;
+				diff[i * 3 + 2] = gray;
+			}
+			else
+			{
+				diff[i * 3 + 0] = gray;
+				diff[i * 3 + 1] = gray;
+				diff[i * 3 + 2] = gray;
+			}
+		}
+
+		meanDeltaE = (pixelCount > 0) ? (float)(totalDeltaE / pixelCount) : 0.0f;
+		changedFraction = (pixelCount > 0) ? ((float)changedPixels / pixelCount) : 0.0f;
+	}
+
+	/***********************************************************
+	 *  ReadBaseline()
+	 *
+	 *  Read the "<pose> <milliseconds>" lines of the frame time
+	 *  baseline file.
+	 ***********************************************************/
+	std::map<std::string, double> ReadBaseline(const std::string& filename)
+	{
+		std::map<std::string, double> baseline;
+		std::ifstream file(filename);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream fields(line);
+			std::string name;
+			double milliseconds = 0.0;
+			if ((fields >> name >> milliseconds) && (name[0] != '#'))
+			{
+				baseline[name] = milliseconds;
+			}
+		}
+		return(baseline);
+	}
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This function is used to render each camera pose into an
+ *  offscreen target of the view size and to check it.  The
+ *  image is compared against <directory>/<pose>.ppm, and the
+ *  median frame time against <directory>/frametimes.txt; on a
+ *  failed image the new image and a diff image are written
+ *  next to the golden.  Frame times only compare on the
+ *  machine that recorded the baseline.
+ ***********************************************************/
+bool RegressionHarness::Run(
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager,
+	const char* directory,
+	bool bUpdate)
+{
+	int width = ViewManager::GetViewWidth();
+	int height = ViewManager::GetViewHeight();
+	std::string basePath = std::string(directory) + "/";
+
+	// offscreen target, so that the window size and the dynamic
+	// resolution scale cannot change the images
+	GLuint framebufferID = 0;
+	GLuint renderbufferIDs[2] = { 0, 0 };
+	glGenRenderbuffers(2, renderbufferIDs);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbufferIDs[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbufferIDs[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glGenFramebuffers(1, &framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbufferIDs[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbufferIDs[1]);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "ERROR: Regression framebuffer is incomplete" << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &framebufferID);
+		glDeleteRenderbuffers(2, renderbufferIDs);
+		return(false);
+	}
+	glViewport(0, 0, width, height);
+
+	std::map<std::string, double> baseline = ReadBaseline(basePath + g_BaselineFilename);
+	std::vector<POSE_RESULT> results;
+	std::vector<unsigned char> readback((size_t)width * height * 3);
+	std::vector<unsigned char> actual(readback.size());
+
+	std::cout << "INFO: Regression run, " << (sizeof(g_CameraPoses) / sizeof(g_CameraPoses[0]))
+		<< " camera poses, " << width << "x" << height << (bUpdate ? ", updating the goldens" : "") << std::endl;
+
+	for (const CAMERA_POSE& pose : g_CameraPoses)
+	{
+		pViewManager->SetCameraPose(pose.position, pose.front, pose.zoom, pose.bOrthographic);
+
+		for (int i = 0; i < WARMUP_FRAMES; i++)
+		{
+			RenderOffscreen(pViewManager, pSceneManager);
+		}
+
+		std::vector<double> frameTimes;
+		for (int i = 0; i < MEASURED_FRAMES; i++)
+		{
+			frameTimes.push_back(RenderOffscreen(pViewManager, pSceneManager));
+		}
+		std::sort(frameTimes.begin(), frameTimes.end());
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, readback.data());
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+		// the files are stored top row first
+		size_t rowBytes = (size_t)width * 3;
+		for (int y = 0; y < height; y++)
+		{
+			std::copy(
+				readback.begin() + (height - 1 - y) * rowBytes,
+				readback.begin() + (height - y) * rowBytes,
+				actual.begin() + y * rowBytes);
+		}
+
+		POSE_RESULT result;
+		result.name = pose.name;
+		result.bImagePassed = true;
+		result.bTimePassed = true;
+		result.meanDeltaE = 0.0f;
+		result.changedFraction = 0.0f;
+		result.frameTime = frameTimes[frameTimes.size() / 2];
+		result.baselineTime = 0.0;
+
+		std::string goldenFilename = basePath + pose.name + ".ppm";
+		if (bUpdate)
+		{
+			result.bImagePassed = WritePpm(goldenFilename, width, height, actual);
+			baseline[pose.name] = result.frameTime;
+			result.note = "updated";
+			results.push_back(result);
+			continue;
+		}
+
+		int goldenWidth = 0;
+		int goldenHeight = 0;
+		std::vector<unsigned char> golden;
+		if (!ReadPpm(goldenFilename, goldenWidth, goldenHeight, golden))
+		{
+			result.bImagePassed = false;
+			result.note = "no golden image";
+		}
+		else if ((goldenWidth != width) || (goldenHeight != height))
+		{
+			result.bImagePassed = false;
+			result.note = "golden size differs";
+		}
+		else
+		{
+			std::vector<unsigned char> diff;
+			CompareImages(golden, actual, result.meanDeltaE, result.changedFraction, diff);
+			if ((result.changedFraction > MAX_CHANGED_PIXEL_FRACTION) || (result.meanDeltaE > MAX_MEAN_DELTA_E))
+			{
+				result.bImagePassed = false;
+				result.note = "image changed";
+				WritePpm(basePath + pose.name + "_actual.ppm", width, height, actual);
+				WritePpm(basePath + pose.name + "_diff.ppm", width, height, diff);
+			}
+		}
+
+		std::map<std::string, double>::const_iterator baselineEntry = baseline.find(pose.name);
+		if (baselineEntry != baseline.end())
+		{
+			result.baselineTime = baselineEntry->second;
+			double increase = result.frameTime - result.baselineTime;
+			if ((increase > result.baselineTime * MAX_FRAME_TIME_INCREASE) && (increase > MIN_FRAME_TIME_INCREASE_MS))
+			{
+				result.bTimePassed = false;
+				result.note += result.note.empty() ? "slower" : ", slower";
+			}
+		}
+
+		results.push_back(result);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebufferID);
+	glDeleteRenderbuffers(2, renderbufferIDs);
+
+	if (bUpdate)
+	{
+		std::ofstream baselineFile(basePath + g_BaselineFilename);
+		baselineFile << "# median frame time in ms per camera pose\n";
+		for (std::map<std::string, double>::const_iterator it = baseline.begin(); it != baseline.end(); ++it)
+		{
+			baselineFile << it->first << " " << std::fixed << std::setprecision(3) << it->second << "\n";
+		}
+	}
+
+	bool bPassed = true;
+	std::cout << std::setw(22) << "pose" << std::setw(10) << "mean dE" << std::setw(12) << "changed %"
+		<< std::setw(12) << "frame ms" << std::setw(12) << "base ms" << "  result\n";
+	for (const POSE_RESULT& result : results)
+	{
+		bool bPosePassed = result.bImagePassed && result.bTimePassed;
+		bPassed = bPassed && bPosePassed;
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(22) << result.name
+			<< std::setw(10) << result.meanDeltaE
+			<< std::setw(12) << (result.changedFraction * 100.0f)
+			<< std::setw(12) << result.frameTime
+			<< std::setw(12) << result.baselineTime
+			<< "  " << (bPosePassed ? "PASS" : "FAIL")
+			<< (result.note.empty() ? "" : " (" + result.note + ")") << "\n";
+	}
+	std::cout << std::endl;
+	if (bPassed)
+	{
+		std::cout << "INFO: Regression run passed" << std::endl;
+	}
+	else
+	{
+		std::cerr << "ERROR: Regression run failed" << std::endl;
+	}
+
+	return(bPassed);
+}
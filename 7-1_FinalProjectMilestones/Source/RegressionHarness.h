@@ -0,0 +1,28 @@
+///////////////////////////////////////////////////////////////////////////////
+// regressionharness.h
+// ============
+// golden image and frame time regression checks of the desk scene - a fixed
+// list of camera poses is rendered offscreen and compared against stored
+// reference images and a baseline of frame times
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneManager.h"
+#include "ViewManager.h"
+
+// GLFW library
+#include "GLFW/glfw3.h"
+
+namespace RegressionHarness
+{
+	// render every camera pose and compare it against the goldens
+	// and the frame time baseline in the passed in directory, or
+	// with bUpdate replace them with the new results; returns
+	// false if any pose regressed
+	bool Run(
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager,
+		const char* directory,
+		bool bUpdate);
+}
@@ -0,0 +1,311 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.cpp
+// ============
+// recorded list of the scene's draw calls, split into opaque and transparent
+// draws and sorted by distance from the camera before they are issued
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+/***********************************************************
+ *  RenderQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderQueue::RenderQueue()
+{
+	m_stats.opaqueCount = 0;
+	m_stats.transparentCount = 0;
+	m_stats.sortMilliseconds = 0.0;
+	m_samplesQueryID = 0;
+	m_timerQueryID = 0;
+	m_bQueryPending = false;
+	m_bQueryActive = false;
+	m_bSamplesActive = false;
+	m_querySampleCount = 0;
+	m_totalShadedSamples = 0;
+	m_totalShadingGpuMs = 0.0;
+}
+
+/***********************************************************
+ *  ~RenderQueue()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderQueue::~RenderQueue()
+{
+	if (m_samplesQueryID != 0)
+	{
+		glDeleteQueries(1, &m_samplesQueryID);
+		m_samplesQueryID = 0;
+	}
+	if (m_timerQueryID != 0)
+	{
+		glDeleteQueries(1, &m_timerQueryID);
+		m_timerQueryID = 0;
+	}
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used to remove the recorded draw items.
+ *  The vectors keep their capacity, so recording the same
+ *  scene again does not allocate.
+ ***********************************************************/
+void RenderQueue::Clear()
+{
+	m_items.clear();
+	m_opaqueOrder.clear();
+	m_transparentOrder.clear();
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used to append a draw item.
+ ***********************************************************/
+void RenderQueue::Submit(const DRAW_ITEM& item)
+{
+	m_items.push_back(item);
+}
+
+/***********************************************************
+ *  IsTransparent()
+ *
+ *  This method is used to decide whether a draw item has to
+ *  be alpha blended in the transparent pass.
+ ***********************************************************/
+bool RenderQueue::IsTransparent(const DRAW_ITEM& item)
+{
+	return((item.opacity < 1.0f) || ((item.bUseTexture == false) && (item.color.a < 1.0f)));
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method is used to split the recorded items into the
+ *  opaque and the transparent draw order.  Opaque items are
+ *  sorted front-to-back so that the depth test rejects the
+ *  hidden fragments early; transparent items are sorted
+ *  back-to-front so that they blend in the right order.
+ *  The distance is measured to the object's origin.
+ ***********************************************************/
+void RenderQueue::Sort(const glm::mat4& view)
+{
+	TRACE_SCOPE("SortRenderQueue");
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	m_opaqueOrder.clear();
+	m_transparentOrder.clear();
+	m_sortEntries.clear();
+
+	// opaque entries are collected first, transparent ones after
+	for (int pass = 0; pass < 2; pass++)
+	{
+		size_t firstEntry = m_sortEntries.size();
+		for (int i = 0; i < (int)m_items.size(); i++)
+		{
+			if (IsTransparent(m_items[i]) != (pass == 1))
+			{
+				continue;
+			}
+
+			glm::vec4 viewPosition = view * m_items[i].model[3];
+			SORT_ENTRY entry;
+			entry.viewDepth = -viewPosition.z;
+			entry.index = i;
+			m_sortEntries.push_back(entry);
+		}
+
+		// ties keep the recorded order, so that coplanar parts of
+		// one object are drawn the same way every frame
+		if (pass == 0)
+		{
+			std::stable_sort(m_sortEntries.begin() + firstEntry, m_sortEntries.end(),
+				[](const SORT_ENTRY& a, const SORT_ENTRY& b) { return a.viewDepth < b.viewDepth; });
+		}
+		else
+		{
+			std::stable_sort(m_sortEntries.begin() + firstEntry, m_sortEntries.end(),
+				[](const SORT_ENTRY& a, const SORT_ENTRY& b) { return a.viewDepth > b.viewDepth; });
+		}
+
+		std::vector<int>& order = (pass == 0) ? m_opaqueOrder : m_transparentOrder;
+		for (size_t i = firstEntry; i < m_sortEntries.size(); i++)
+		{
+			order.push_back(m_sortEntries[i].index);
+		}
+	}
+
+	m_stats.opaqueCount = (int)m_opaqueOrder.size();
+	m_stats.transparentCount = (int)m_transparentOrder.size();
+	m_stats.sortMilliseconds = TraceProfiler::NowMilliseconds() - startTime;
+}
+
+/***********************************************************
+ *  BeginFrameQuery()
+ *
+ *  This method is used to start timing the scene passes of
+ *  the frame, including the depth pre-pass.  A new query is
+ *  only started once the previous result has been collected.
+ ***********************************************************/
+void RenderQueue::BeginFrameQuery()
+{
+	CollectShadingQuery();
+	if (m_bQueryPending)
+	{
+		return;
+	}
+
+	if (m_samplesQueryID == 0)
+	{
+		glGenQueries(1, &m_samplesQueryID);
+		glGenQueries(1, &m_timerQueryID);
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, m_timerQueryID);
+	m_bQueryPending = true;
+	m_bQueryActive = true;
+}
+
+/***********************************************************
+ *  BeginShadingQuery()
+ *
+ *  This method is used to start counting the samples that
+ *  reach the lighting shader, after the depth pre-pass.
+ ***********************************************************/
+void RenderQueue::BeginShadingQuery()
+{
+	if (!m_bQueryActive)
+	{
+		return;
+	}
+
+	glBeginQuery(GL_SAMPLES_PASSED, m_samplesQueryID);
+	m_bSamplesActive = true;
+}
+
+/***********************************************************
+ *  EndFrameQuery()
+ *
+ *  This method is used to stop the queries started in the
+ *  same frame.
+ ***********************************************************/
+void RenderQueue::EndFrameQuery()
+{
+	if (!m_bQueryActive)
+	{
+		return;
+	}
+
+	if (m_bSamplesActive)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		m_bSamplesActive = false;
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+	m_bQueryActive = false;
+}
+
+/***********************************************************
+ *  CollectShadingQuery()
+ *
+ *  This method is used to add the results of the pending
+ *  queries to the totals, if the GPU has finished them.
+ ***********************************************************/
+void RenderQueue::CollectShadingQuery()
+{
+	if (!m_bQueryPending)
+	{
+		return;
+	}
+
+	GLint available = 0;
+	glGetQueryObjectiv(m_timerQueryID, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available == 0)
+	{
+		return;
+	}
+
+	GLuint64 samples = 0;
+	GLuint64 elapsedNanoseconds = 0;
+	glGetQueryObjectui64v(m_samplesQueryID, GL_QUERY_RESULT, &samples);
+	glGetQueryObjectui64v(m_timerQueryID, GL_QUERY_RESULT, &elapsedNanoseconds);
+
+	m_totalShadedSamples += samples;
+	m_totalShadingGpuMs += (double)elapsedNanoseconds / 1000000.0;
+	m_querySampleCount++;
+	m_bQueryPending = false;
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used to print the average number of shaded
+ *  samples and the GPU time of the shading passes, which show
+ *  how much overdraw the draw order removed.
+ ***********************************************************/
+void RenderQueue::PrintStats() const
+{
+	std::cout << "INFO: Render queue statistics\n";
+	std::cout << "  draws: " << m_stats.opaqueCount << " opaque, "
+		<< m_stats.transparentCount << " transparent, sort "
+		<< m_stats.sortMilliseconds << " ms\n";
+	if (m_querySampleCount > 0)
+	{
+		std::cout << "  frames: " << m_querySampleCount
+			<< ", avg shaded samples " << (m_totalShadedSamples / m_querySampleCount)
+			<< ", avg GPU " << (m_totalShadingGpuMs / m_querySampleCount) << " ms\n";
+	}
+	std::cout << std::endl;
+}
+
+/***********************************************************
+ *  ResetStats()
+ *
+ *  This method is used to restart the shading statistics,
+ *  e.g. after the draw order settings were changed.
+ ***********************************************************/
+void RenderQueue::ResetStats()
+{
+	m_querySampleCount = 0;
+	m_totalShadedSamples = 0;
+	m_totalShadingGpuMs = 0.0;
+}
+
+/***********************************************************
+ *  GetAverageShadedSamples()
+ *
+ *  This method is used to get the average number of samples
+ *  shaded per frame since the statistics were reset.
+ ***********************************************************/
+double RenderQueue::GetAverageShadedSamples()
+{
+	CollectShadingQuery();
+	if (m_querySampleCount == 0)
+	{
+		return(0.0);
+	}
+	return((double)m_totalShadedSamples / m_querySampleCount);
+}
+
+/***********************************************************
+ *  GetAverageShadingGpuMs()
+ *
+ *  This method is used to get the average GPU time of the
+ *  scene passes since the statistics were reset.
+ ***********************************************************/
+double RenderQueue::GetAverageShadingGpuMs()
+{
+	CollectShadingQuery();
+	if (m_querySampleCount == 0)
+	{
+		return(0.0);
+	}
+	return(m_totalShadingGpuMs / m_querySampleCount);
+}
@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.h
+// ============
+// recorded list of the scene's draw calls, split into opaque and transparent
+// draws and sorted by distance from the camera before they are issued
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  RenderQueue
+ *
+ *  This class holds the draw items recorded by the scene
+ *  code for one frame, the sorted opaque and transparent
+ *  draw orders, and the counters of the shading passes.
+ ***********************************************************/
+class RenderQueue
+{
+public:
+	// basic meshes that a draw item can reference
+	enum MESH_SHAPE
+	{
+		MESH_PLANE = 0,
+		MESH_BOX,
+		MESH_BOX_SIDE,			// meshParts holds the ShapeMeshes::BoxSide
+		MESH_CYLINDER,			// meshParts holds the MESH_PARTS flags
+		MESH_TAPERED_CYLINDER,	// meshParts holds the MESH_PARTS flags
+		MESH_SPHERE,
+		MESH_TORUS,
+		MESH_FOLIAGE			// meshParts holds the FoliageSystem::FOLIAGE_LAYER
+	};
+
+	// parts of a cylinder mesh to draw
+	enum MESH_PARTS
+	{
+		PART_TOP = 1,
+		PART_BOTTOM = 2,
+		PART_SIDES = 4,
+		PART_ALL = PART_TOP | PART_BOTTOM | PART_SIDES
+	};
+
+	// order in which the recorded draws are issued
+	enum RENDER_PATH
+	{
+		PATH_SOURCE_ORDER = 0,	// recorded order, blending always on
+		PATH_SORTED				// opaque front-to-back, then transparent back-to-front
+	};
+
+	// everything the scene shader needs for one draw call
+	struct DRAW_ITEM
+	{
+		int meshShape;
+		int meshParts;
+		glm::mat4 model;
+		glm::vec4 color;
+		bool bUseTexture;
+		int textureSlot;
+		glm::vec2 uvScale;
+		glm::vec3 diffuseColor;
+		glm::vec3 specularColor;
+		float shininess;
+		float opacity;
+	};
+
+	struct QUEUE_STATS
+	{
+		int opaqueCount;
+		int transparentCount;
+		double sortMilliseconds;
+	};
+
+	// constructor
+	RenderQueue();
+	// destructor
+	~RenderQueue();
+
+	// remove the draw items of the previous frame
+	void Clear();
+	// append a draw item in source order
+	void Submit(const DRAW_ITEM& item);
+
+	// split the items into opaque and transparent draws and
+	// sort each list by its distance from the camera
+	void Sort(const glm::mat4& view);
+
+	int GetItemCount() const { return (int)m_items.size(); }
+	const DRAW_ITEM& GetItem(int index) const { return m_items[index]; }
+	const std::vector<int>& GetOpaqueOrder() const { return m_opaqueOrder; }
+	const std::vector<int>& GetTransparentOrder() const { return m_transparentOrder; }
+	const QUEUE_STATS& GetStats() const { return m_stats; }
+
+	// items that are alpha blended and must not write depth
+	static bool IsTransparent(const DRAW_ITEM& item);
+
+	// time the scene passes and count the samples that reach the
+	// lighting shader; the results are read back non-blocking on
+	// a later frame
+	void BeginFrameQuery();
+	void BeginShadingQuery();
+	void EndFrameQuery();
+
+	// print the average shaded samples and GPU time per frame
+	void PrintStats() const;
+	void ResetStats();
+	double GetAverageShadedSamples();
+	double GetAverageShadingGpuMs();
+
+private:
+	struct SORT_ENTRY
+	{
+		float viewDepth;
+		int index;
+	};
+
+	std::vector<DRAW_ITEM> m_items;
+	std::vector<SORT_ENTRY> m_sortEntries;
+	std::vector<int> m_opaqueOrder;
+	std::vector<int> m_transparentOrder;
+	QUEUE_STATS m_stats;
+
+	// GL_TIME_ELAPSED query around the scene passes and
+	// GL_SAMPLES_PASSED query around the shading passes
+	GLuint m_samplesQueryID;
+	GLuint m_timerQueryID;
+	bool m_bQueryPending;
+	bool m_bQueryActive;
+	bool m_bSamplesActive;
+
+	// accumulated shading pass statistics
+	uint64_t m_querySampleCount;
+	uint64_t m_totalShadedSamples;
+	double m_totalShadingGpuMs;
+
+	// collect the results of the last shading queries if ready
+	void CollectShadingQuery();
+};
@@ -0,0 +1,443 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenegenerator.cpp
+// ============
+// procedural scene scaling - the recorded desk arrangement is repeated over a
+// grid of desks with random variations, so that the cost of the scene code,
+// the culling and the draw submission can be measured at large object counts
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneGenerator.h"
+#include "FoliageSystem.h"
+#include "TraceProfiler.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <random>
+
+// declaration of the global variables and defines
+namespace
+{
+	// the desk plane is 50 x 24 units, with the vase and the books
+	// hanging slightly over its left edge
+	const float CELL_SPACING_X = 56.0f;
+	const float CELL_SPACING_Z = 32.0f;
+
+	// random variations of the desks other than the original one
+	const float POSITION_JITTER = 2.0f;
+	const float YAW_JITTER_DEGREES = 8.0f;
+	const float MIN_CELL_SCALE = 0.9f;
+	const float MAX_CELL_SCALE = 1.1f;
+	const float MIN_TINT = 0.8f;
+	const float MAX_TINT = 1.2f;
+	// chance that a prop other than the desk plane is left out
+	const float PROP_DROP_CHANCE = 0.15f;
+
+	/***********************************************************
+	 *  GetItemRadius()
+	 *
+	 *  Radius of a sphere around the item's origin that holds
+	 *  its mesh - the basic meshes fit in a box from -1 to 1 on
+	 *  every axis, except for the torus which is a bit wider,
+	 *  and the foliage instances which spread around the plant.
+	 ***********************************************************/
+	float GetItemRadius(const RenderQueue::DRAW_ITEM& item)
+	{
+		if (item.meshShape == RenderQueue::MESH_FOLIAGE)
+		{
+			return(glm::length(glm::vec3(item.model[0])) *
+				glm::sqrt(FoliageSystem::PLANT_RADIUS * FoliageSystem::PLANT_RADIUS +
+					FoliageSystem::PLANT_HEIGHT * FoliageSystem::PLANT_HEIGHT));
+		}
+
+		float radius = glm::sqrt(
+			glm::dot(glm::vec3(item.model[0]), glm::vec3(item.model[0])) +
+			glm::dot(glm::vec3(item.model[1]), glm::vec3(item.model[1])) +
+			glm::dot(glm::vec3(item.model[2]), glm::vec3(item.model[2])));
+
+		return((item.meshShape == RenderQueue::MESH_TORUS) ? radius * 1.2f : radius);
+	}
+
+	/***********************************************************
+	 *  GetClipPlanes()
+	 *
+	 *  The planes of the clip volume of a view projection or
+	 *  light space matrix, from the rows of the matrix, with
+	 *  their normals pointing inwards.  The near plane is the
+	 *  last one, so that it can be left out of the test.
+	 ***********************************************************/
+	void GetClipPlanes(const glm::mat4& clipMatrix, glm::vec4 planes[6])
+	{
+		glm::vec4 rows[4];
+		for (int r = 0; r < 4; r++)
+		{
+			rows[r] = glm::vec4(clipMatrix[0][r], clipMatrix[1][r], clipMatrix[2][r], clipMatrix[3][r]);
+		}
+		for (int axis = 0; axis < 3; axis++)
+		{
+			planes[axis * 2] = rows[3] + rows[axis];
+			planes[axis * 2 + 1] = rows[3] - rows[axis];
+		}
+		std::swap(planes[4], planes[5]);
+		for (int p = 0; p < 6; p++)
+		{
+			planes[p] /= glm::length(glm::vec3(planes[p]));
+		}
+	}
+
+	/***********************************************************
+	 *  IsSphereInside()
+	 *
+	 *  True when the sphere is at least partly on the inner
+	 *  side of the first planeCount planes.
+	 ***********************************************************/
+	bool IsSphereInside(const glm::vec4 planes[6], int planeCount, const glm::vec3& center, float radius)
+	{
+		for (int p = 0; p < planeCount; p++)
+		{
+			if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -radius)
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  SceneGenerator()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneGenerator::SceneGenerator()
+{
+	m_columns = 1;
+	m_rows = 1;
+	m_seed = 0;
+	m_bFrustumCulling = true;
+	m_templateCenter = glm::vec3(0.0f);
+	m_templateRadius = 0.0f;
+	m_gridCenter = glm::vec3(0.0f);
+	m_gridRadius = 0.0f;
+	for (int prop = 0; prop < PROP_COUNT; prop++)
+	{
+		m_propItemCounts[prop] = 0;
+	}
+
+	m_stats.cellCount = 1;
+	m_stats.visibleCells = 1;
+	m_stats.templateItems = 0;
+	m_stats.generatedItems = 0;
+	m_stats.culledItems = 0;
+	m_stats.shadowCells = 0;
+	m_stats.cullMilliseconds = 0.0;
+	m_stats.expandMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  Configure()
+ *
+ *  This method is used to lay out the grid of desks.  The
+ *  columns are centered on the original desk and the rows
+ *  continue behind it, away from the default camera.  The
+ *  original desk keeps its exact placement and every prop,
+ *  so that the authored view is still part of the scene; the
+ *  others are turned, shifted, scaled, tinted and can lose
+ *  some of their props.
+ ***********************************************************/
+void SceneGenerator::Configure(int columns, int rows, unsigned int seed)
+{
+	m_columns = std::max(columns, 1);
+	m_rows = std::max(rows, 1);
+	m_seed = seed;
+
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+
+	int centerColumn = (m_columns - 1) / 2;
+
+	m_cells.clear();
+	m_cells.reserve((size_t)m_columns * m_rows);
+	for (int row = 0; row < m_rows; row++)
+	{
+		for (int column = 0; column < m_columns; column++)
+		{
+			GRID_CELL cell;
+			glm::vec3 position = glm::vec3(
+				(column - centerColumn) * CELL_SPACING_X,
+				0.0f,
+				-row * CELL_SPACING_Z);
+
+			if ((row == 0) && (column == centerColumn))
+			{
+				cell.transform = glm::mat4(1.0f);
+				cell.tint = glm::vec3(1.0f);
+				cell.scale = 1.0f;
+				cell.propMask = (1u << PROP_COUNT) - 1;
+			}
+			else
+			{
+				// half of the desks face the other way
+				float yawDegrees = (unit(generator) < 0.5f) ? 0.0f : 180.0f;
+				yawDegrees += signedUnit(generator) * YAW_JITTER_DEGREES;
+				position.x += signedUnit(generator) * POSITION_JITTER;
+				position.z += signedUnit(generator) * POSITION_JITTER;
+				cell.scale = MIN_CELL_SCALE + unit(generator) * (MAX_CELL_SCALE - MIN_CELL_SCALE);
+
+				cell.transform = glm::translate(position) *
+					glm::rotate(glm::radians(yawDegrees), glm::vec3(0.0f, 1.0f, 0.0f)) *
+					glm::scale(glm::vec3(cell.scale));
+
+				for (int c = 0; c < 3; c++)
+				{
+					cell.tint[c] = MIN_TINT + unit(generator) * (MAX_TINT - MIN_TINT);
+				}
+
+				cell.propMask = 1u << PROP_DESK;
+				for (int prop = PROP_DESK + 1; prop < PROP_COUNT; prop++)
+				{
+					if (unit(generator) >= PROP_DROP_CHANCE)
+					{
+						cell.propMask |= 1u << prop;
+					}
+				}
+			}
+
+			m_cells.push_back(cell);
+		}
+	}
+
+	m_stats.cellCount = (int)m_cells.size();
+	m_stats.visibleCells = m_stats.cellCount;
+}
+
+/***********************************************************
+ *  Expand()
+ *
+ *  This method is used to copy the draws of the recorded
+ *  desk out of the queue, test the bounding sphere of every
+ *  cell against the frustum planes, and record the draws of
+ *  the visible cells with the cell's transform and tint.  The
+ *  bounding sphere of the desk is rebuilt from the recorded
+ *  draws, so that it follows any change of the scene code,
+ *  and so is the bounding sphere of the whole grid.
+ ***********************************************************/
+void SceneGenerator::Expand(
+	RenderQueue& renderQueue,
+	const std::vector<int>& propFirstItems,
+	const glm::mat4& viewProjection)
+{
+	TRACE_SCOPE("ExpandSceneGrid");
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	int itemCount = renderQueue.GetItemCount();
+	m_templateItems.resize(itemCount);
+	m_templateProps.resize(itemCount);
+
+	// the bounds of the desk, as the box around the item spheres
+	glm::vec3 boundsMin = glm::vec3(1.0e30f);
+	glm::vec3 boundsMax = glm::vec3(-1.0e30f);
+	int prop = PROP_DESK;
+	for (int i = 0; i < itemCount; i++)
+	{
+		while ((prop + 1 < (int)propFirstItems.size()) && (propFirstItems[prop + 1] <= i))
+		{
+			prop++;
+		}
+
+		const RenderQueue::DRAW_ITEM& item = renderQueue.GetItem(i);
+		m_templateItems[i] = item;
+		m_templateProps[i] = prop;
+
+		glm::vec3 center = glm::vec3(item.model[3]);
+		float radius = GetItemRadius(item);
+		boundsMin = glm::min(boundsMin, center - glm::vec3(radius));
+		boundsMax = glm::max(boundsMax, center + glm::vec3(radius));
+	}
+	m_templateCenter = (boundsMin + boundsMax) * 0.5f;
+	m_templateRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+
+	// the grid bounds, as the box around the cell spheres
+	boundsMin = glm::vec3(1.0e30f);
+	boundsMax = glm::vec3(-1.0e30f);
+	for (const GRID_CELL& cell : m_cells)
+	{
+		glm::vec3 center = glm::vec3(cell.transform * glm::vec4(m_templateCenter, 1.0f));
+		float radius = m_templateRadius * cell.scale;
+		boundsMin = glm::min(boundsMin, center - glm::vec3(radius));
+		boundsMax = glm::max(boundsMax, center + glm::vec3(radius));
+	}
+	m_gridCenter = (boundsMin + boundsMax) * 0.5f;
+	m_gridRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+
+	glm::vec4 planes[6];
+	GetClipPlanes(viewProjection, planes);
+
+	// draws per prop, for counting the draws of the culled cells
+	for (int p = 0; p < PROP_COUNT; p++)
+	{
+		m_propItemCounts[p] = 0;
+	}
+	for (int i = 0; i < itemCount; i++)
+	{
+		m_propItemCounts[m_templateProps[i]]++;
+	}
+
+	double cullStartTime = TraceProfiler::NowMilliseconds();
+	m_visibleCells.clear();
+	m_stats.culledItems = 0;
+	for (int c = 0; c < (int)m_cells.size(); c++)
+	{
+		const GRID_CELL& cell = m_cells[c];
+		bool bVisible = true;
+		if ((m_bFrustumCulling == true) && (itemCount > 0))
+		{
+			glm::vec3 center = glm::vec3(cell.transform * glm::vec4(m_templateCenter, 1.0f));
+			bVisible = IsSphereInside(planes, 6, center, m_templateRadius * cell.scale);
+		}
+		if (bVisible == true)
+		{
+			m_visibleCells.push_back(c);
+		}
+		else
+		{
+			for (int p = 0; p < PROP_COUNT; p++)
+			{
+				if ((cell.propMask & (1u << p)) != 0)
+				{
+					m_stats.culledItems += m_propItemCounts[p];
+				}
+			}
+		}
+	}
+	m_stats.cullMilliseconds = TraceProfiler::NowMilliseconds() - cullStartTime;
+
+	renderQueue.Clear();
+	for (int c : m_visibleCells)
+	{
+		const GRID_CELL& cell = m_cells[c];
+		for (int i = 0; i < itemCount; i++)
+		{
+			if ((cell.propMask & (1u << m_templateProps[i])) == 0)
+			{
+				continue;
+			}
+
+			RenderQueue::DRAW_ITEM item = m_templateItems[i];
+			item.model = cell.transform * item.model;
+			item.color = glm::vec4(glm::vec3(item.color) * cell.tint, item.color.a);
+			item.diffuseColor *= cell.tint;
+			renderQueue.Submit(item);
+		}
+	}
+
+	m_stats.visibleCells = (int)m_visibleCells.size();
+	m_stats.templateItems = itemCount;
+	m_stats.generatedItems = renderQueue.GetItemCount();
+	m_stats.expandMilliseconds = TraceProfiler::NowMilliseconds() - startTime;
+}
+
+/***********************************************************
+ *  ExpandShadowCasters()
+ *
+ *  This method is used to list the draws of every cell that
+ *  can cast a shadow into the light volume, whether or not
+ *  the camera sees the cell.  The near plane is not tested,
+ *  since the casters in front of the light volume still
+ *  throw their shadows into it.  Uses the recorded desk of
+ *  the last Expand().
+ ***********************************************************/
+void SceneGenerator::ExpandShadowCasters(
+	std::vector<RenderQueue::DRAW_ITEM>& casters,
+	const glm::mat4& lightSpace)
+{
+	glm::vec4 planes[6];
+	GetClipPlanes(lightSpace, planes);
+
+	int itemCount = (int)m_templateItems.size();
+	casters.clear();
+	m_stats.shadowCells = 0;
+	for (const GRID_CELL& cell : m_cells)
+	{
+		glm::vec3 center = glm::vec3(cell.transform * glm::vec4(m_templateCenter, 1.0f));
+		if ((itemCount == 0) || (IsSphereInside(planes, 5, center, m_templateRadius * cell.scale) == false))
+		{
+			continue;
+		}
+
+		m_stats.shadowCells++;
+		for (int i = 0; i < itemCount; i++)
+		{
+			if ((cell.propMask & (1u << m_templateProps[i])) == 0)
+			{
+				continue;
+			}
+
+			// the depth pass only reads the transform and the mesh
+			RenderQueue::DRAW_ITEM item = m_templateItems[i];
+			item.model = cell.transform * item.model;
+			casters.push_back(item);
+		}
+	}
+}
+
+/***********************************************************
+ *  GetItemSource()
+ *
+ *  This method is used to find the grid cell and the prop of
+ *  a draw of the expanded queue.  Every visible cell holds
+ *  the recorded draws of its props in recorded order, so the
+ *  draw is found by counting the draws of the cells and the
+ *  props before it, without keeping a list per draw.
+ ***********************************************************/
+bool SceneGenerator::GetItemSource(int itemIndex, int& cell, int& prop) const
+{
+	if (itemIndex < 0)
+	{
+		return(false);
+	}
+
+	int firstItem = 0;
+	for (int c : m_visibleCells)
+	{
+		for (int p = 0; p < PROP_COUNT; p++)
+		{
+			if ((m_cells[c].propMask & (1u << p)) == 0)
+			{
+				continue;
+			}
+			if (itemIndex < firstItem + m_propItemCounts[p])
+			{
+				cell = c;
+				prop = p;
+				return(true);
+			}
+			firstItem += m_propItemCounts[p];
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  GetItemKeys()
+ *
+ *  This method is used to list the key of every draw of the
+ *  expanded queue, in the order that Expand() submitted the
+ *  draws.
+ ***********************************************************/
+void SceneGenerator::GetItemKeys(std::vector<int>& itemKeys) const
+{
+	int itemCount = m_stats.templateItems;
+	itemKeys.clear();
+	for (int c : m_visibleCells)
+	{
+		for (int i = 0; i < itemCount; i++)
+		{
+			if ((m_cells[c].propMask & (1u << m_templateProps[i])) != 0)
+			{
+				itemKeys.push_back(c * itemCount + i);
+			}
+		}
+	}
+}
@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenegenerator.h
+// ============
+// procedural scene scaling - the recorded desk arrangement is repeated over a
+// grid of desks with random variations, so that the cost of the scene code,
+// the culling and the draw submission can be measured at large object counts
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderQueue.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  SceneGenerator
+ *
+ *  This class holds the layout of the desk grid and expands
+ *  the draws of one recorded desk into the draws of every
+ *  grid cell that is inside the view frustum.
+ ***********************************************************/
+class SceneGenerator
+{
+public:
+	// groups of draws that a grid cell can leave out; the scene
+	// code records them in this order
+	enum DESK_PROP
+	{
+		PROP_DESK = 0,
+		PROP_KEYBOARD,
+		PROP_TEACUP,
+		PROP_MONITOR,
+		PROP_VASE,
+		PROP_BOOKS,
+		PROP_ORGANIZER,
+		PROP_COUNT
+	};
+
+	struct GENERATOR_STATS
+	{
+		int cellCount;
+		int visibleCells;
+		int templateItems;
+		int generatedItems;
+		// draws of the cells outside the frustum
+		int culledItems;
+		// cells drawn into the last shadow map
+		int shadowCells;
+		double cullMilliseconds;
+		double expandMilliseconds;
+	};
+
+	// constructor
+	SceneGenerator();
+
+	// lay out a grid of columns x rows desks with variations drawn
+	// from the seed; a 1 x 1 grid leaves the scene unchanged
+	void Configure(int columns, int rows, unsigned int seed);
+	bool IsActive() const { return (int)m_cells.size() > 1; }
+	int GetColumns() const { return m_columns; }
+	int GetRows() const { return m_rows; }
+	unsigned int GetSeed() const { return m_seed; }
+
+	// skip the cells whose bounding sphere is outside the frustum
+	void SetFrustumCulling(bool bEnabled) { m_bFrustumCulling = bEnabled; }
+	bool IsFrustumCulling() const { return m_bFrustumCulling; }
+
+	// replace the recorded desk in the queue by one copy for every
+	// visible cell; propFirstItems holds the index of the first
+	// draw of each DESK_PROP
+	void Expand(
+		RenderQueue& renderQueue,
+		const std::vector<int>& propFirstItems,
+		const glm::mat4& viewProjection);
+
+	// the draws of every cell inside the light volume, for the
+	// shadow pass, which does not depend on the camera
+	void ExpandShadowCasters(
+		std::vector<RenderQueue::DRAW_ITEM>& casters,
+		const glm::mat4& lightSpace);
+	// bounding sphere of every cell of the grid, as of the last
+	// Expand(), that the light volume is fitted to
+	const glm::vec3& GetGridCenter() const { return m_gridCenter; }
+	float GetGridRadius() const { return m_gridRadius; }
+
+	// cells drawn in the last frame, in grid order
+	const std::vector<int>& GetVisibleCells() const { return m_visibleCells; }
+	// grid cell and DESK_PROP that a draw of the last expanded
+	// queue was copied from
+	bool GetItemSource(int itemIndex, int& cell, int& prop) const;
+	// key of every draw of the last expanded queue, the cell times
+	// the recorded draws plus the recorded draw, which stays with
+	// the draw while the visible cells change; below GetItemKeyCount()
+	void GetItemKeys(std::vector<int>& itemKeys) const;
+	int GetItemKeyCount() const { return (int)m_cells.size() * m_stats.templateItems; }
+	const GENERATOR_STATS& GetStats() const { return m_stats; }
+
+private:
+	struct GRID_CELL
+	{
+		glm::mat4 transform;
+		glm::vec3 tint;
+		float scale;
+		unsigned int propMask;
+	};
+
+	int m_columns;
+	int m_rows;
+	unsigned int m_seed;
+	bool m_bFrustumCulling;
+	std::vector<GRID_CELL> m_cells;
+
+	// the recorded desk, copied out of the queue every frame
+	std::vector<RenderQueue::DRAW_ITEM> m_templateItems;
+	std::vector<int> m_templateProps;
+	// bounding spheres of the recorded desk and of the grid
+	glm::vec3 m_templateCenter;
+	float m_templateRadius;
+	glm::vec3 m_gridCenter;
+	float m_gridRadius;
+	// recorded draws of each DESK_PROP
+	int m_propItemCounts[PROP_COUNT];
+	std::vector<int> m_visibleCells;
+	GENERATOR_STATS m_stats;
+};
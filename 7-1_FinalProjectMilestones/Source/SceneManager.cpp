@@ -7,13 +7,24 @@
 //	Created for CS-330-Computational Graphics and Visualization, Nov. 1st, 2023
 ///////////////////////////////////////////////////////////////////////////////
 #include <tuple>
+#include <algorithm>
+#include <random>
+
+#include "MemoryTracker.h"
+#include "TraceProfiler.h"
+#include "GLStateCache.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
+// route the decoded image buffers through the allocation tracker
+#define STBI_MALLOC(size) MemoryTracker::Malloc(size)
+#define STBI_REALLOC(pMemory, newSize) MemoryTracker::Realloc(pMemory, newSize)
+#define STBI_FREE(pMemory) MemoryTracker::Free(pMemory)
 #include "stb_image.h"
 #endif
 
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include "SceneManager.h"
 
 // declaration of global variables
@@ -24,6 +35,103 @@ namespace
 	const char* g_TextureValueName = "objectTexture";
 	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+
+	// shadow mapping settings - the texture unit is reserved above
+	// the slots used by the scene textures
+	const int SHADOW_TEXTURE_UNIT = 15;
+	const int SHADOW_MAP_RESOLUTION = 2048;
+	const char* g_ShadowVertexShaderPath = "shaders/shadowDepthVertexShader.glsl";
+	const char* g_ShadowFragmentShaderPath = "shaders/shadowDepthFragmentShader.glsl";
+	const char* g_LightSpaceMatrixName = "lightSpaceMatrix";
+
+	// draws per frame the draw data ring is first created for - it
+	// grows when the generated scenes queue more
+	const int DRAW_DATA_CAPACITY = 1024;
+
+	// the depth pre-pass reuses the scene vertex shader, so that the
+	// laid down depth matches the shading pass exactly
+	const char* g_SceneVertexShaderPath = "shaders/sceneVertexShader.glsl";
+	const char* g_SceneFragmentShaderPath = "shaders/sceneFragmentShader.glsl";
+	const char* g_DepthFragmentShaderPath = "shaders/shadowDepthFragmentShader.glsl";
+	// sends the triangles of the multi-view variants to every view
+	const char* g_MultiViewGeometryShaderPath = "shaders/multiViewGeometryShader.glsl";
+	// baked lightmaps of the desk scene, reused while the scene and
+	// the lights stay the same
+	const char* g_LightmapCacheFilename = "lightmaps.cache";
+
+	// bounding sphere around the desk scene that the light frustum encloses
+	const glm::vec3 g_SceneBoundsCenter = glm::vec3(0.0f, 5.0f, 0.0f);
+	const float g_SceneBoundsRadius = 30.0f;
+
+	// number of point lights defined in SetupSceneLights - lights
+	// beyond these are added by the light stress test
+	const int SCENE_POINT_LIGHTS = 4;
+
+	// names of the SceneGenerator::DESK_PROP groups and of the
+	// RenderQueue::MESH_SHAPE meshes, for the picked objects
+	const char* g_PropNames[SceneGenerator::PROP_COUNT] = {
+		"desk", "keyboard and mouse", "teacup", "monitor", "vase", "books", "organizer" };
+	const char* g_MeshShapeNames[] = {
+		"plane", "box", "box side", "cylinder", "tapered cylinder", "sphere", "torus", "foliage" };
+
+	/***********************************************************
+	 *  HashBytes()
+	 *
+	 *  FNV-1a hash, used to fingerprint the object transforms.
+	 ***********************************************************/
+	uint64_t HashBytes(uint64_t hash, const void* pData, size_t size)
+	{
+		const unsigned char* pBytes = (const unsigned char*)pData;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return(hash);
+	}
+
+	const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+	/***********************************************************
+	 *  GetMeshBounds()
+	 *
+	 *  Transform from the unit box mesh to a box enclosing the
+	 *  passed in basic mesh, in the mesh's own space.  The
+	 *  boxes are slightly enlarged, so that a box never lies
+	 *  behind the surface of the object it encloses.
+	 ***********************************************************/
+	glm::mat4 GetMeshBounds(int meshShape)
+	{
+		glm::vec3 center = glm::vec3(0.0f);
+		glm::vec3 size = glm::vec3(1.0f);
+
+		switch (meshShape)
+		{
+		case RenderQueue::MESH_PLANE:
+			size = glm::vec3(2.0f, 0.02f, 2.0f);
+			break;
+		case RenderQueue::MESH_CYLINDER:
+		case RenderQueue::MESH_TAPERED_CYLINDER:
+			center = glm::vec3(0.0f, 0.5f, 0.0f);
+			size = glm::vec3(2.0f, 1.0f, 2.0f);
+			break;
+		case RenderQueue::MESH_SPHERE:
+			size = glm::vec3(2.0f);
+			break;
+		case RenderQueue::MESH_TORUS:
+			size = glm::vec3(2.4f);
+			break;
+		case RenderQueue::MESH_FOLIAGE:
+			center = glm::vec3(0.0f, FoliageSystem::PLANT_HEIGHT * 0.5f, 0.0f);
+			size = glm::vec3(
+				FoliageSystem::PLANT_RADIUS * 2.0f,
+				FoliageSystem::PLANT_HEIGHT,
+				FoliageSystem::PLANT_RADIUS * 2.0f);
+			break;
+		}
+
+		return(glm::translate(center) * glm::scale(size * 1.05f));
+	}
 }
 
 /***********************************************************
@@ -35,6 +143,76 @@ SceneManager::SceneManager(ShaderManager* pShaderManager)
 {
 	m_pShaderManager = pShaderManager;
 	m_basicMeshes = new ShapeMeshes();
+	m_loadedTextures = 0;
+	m_directionalLightDirection = glm::vec3(-0.5f, -0.6f, 0.7f);
+	m_directionalLightAmbient = glm::vec3(0.4f);
+	m_directionalLightDiffuse = glm::vec3(0.7f);
+	m_directionalLightSpecular = glm::vec3(0.6f);
+	m_pShadowMap = NULL;
+	m_pShadowShaderManager = NULL;
+	m_shadowQuality = ShadowMap::SHADOW_PCF_3X3;
+	m_bShadowCaching = true;
+	m_bShadowMapDirty = true;
+	m_shadowSceneSignature = 0;
+	m_frameSceneSignature = FNV_OFFSET_BASIS;
+	m_shadowBoundsCenter = g_SceneBoundsCenter;
+	m_shadowBoundsRadius = g_SceneBoundsRadius;
+	m_pClusteredLighting = NULL;
+	m_pointLightMode = ClusteredLighting::LIGHTS_CLUSTERED;
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
+	m_renderPath = RenderQueue::PATH_SORTED;
+	m_bDepthPrepass = false;
+	m_pDepthShaderManager = NULL;
+	m_pOcclusionCuller = NULL;
+	m_bOcclusionCulling = true;
+	m_pDrawDataRing = NULL;
+	m_pShaderPermutations = NULL;
+	m_bShaderPermutations = true;
+	m_bUseLighting = false;
+	m_fixedPointLightCount = 0;
+	m_pLightmapBaker = NULL;
+	m_bLightmaps = true;
+	m_lightmapPointLightCount = 0;
+	m_bLightmapsActive = false;
+	m_pSoftwareRasterizer = NULL;
+	m_bSoftwareRaster = false;
+	m_softwareThreadCount = 0;
+	m_pMultiViewTarget = NULL;
+	m_bMultiViewPass = false;
+	m_multiViewCount = 0;
+	m_multiViewStats = MULTI_VIEW_STATS();
+	m_pTextureStreamer = new TextureStreamer();
+	m_bTextureStreaming = true;
+	m_pFoliageSystem = NULL;
+	m_foliageParams.seed = 1;
+	m_foliageParams.density = 1.0f;
+	m_bFoliageSway = true;
+	m_timerIndex = 0;
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		m_timerQueryIDs[i][0] = 0;
+		m_timerQueryIDs[i][1] = 0;
+		m_primitiveQueryIDs[i] = 0;
+		m_bTimerPending[i] = false;
+	}
+	m_frameTiming = FRAME_TIMING();
+	m_drawCounters = DRAW_COUNTERS();
+	ResetFrameTiming();
+
+	// the recorded shader state carries over between draws and
+	// frames, just like the shader uniforms it replaces
+	m_drawState.meshShape = RenderQueue::MESH_BOX;
+	m_drawState.meshParts = RenderQueue::PART_ALL;
+	m_drawState.model = glm::mat4(1.0f);
+	m_drawState.color = glm::vec4(1.0f);
+	m_drawState.bUseTexture = false;
+	m_drawState.textureSlot = 0;
+	m_drawState.uvScale = glm::vec2(1.0f, 1.0f);
+	m_drawState.diffuseColor = glm::vec3(1.0f);
+	m_drawState.specularColor = glm::vec3(0.0f);
+	m_drawState.shininess = 1.0f;
+	m_drawState.opacity = 1.0f;
 }
 
 /***********************************************************
@@ -47,89 +225,105 @@ SceneManager::~SceneManager()
 	m_pShaderManager = NULL;
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
+	if (NULL != m_pShadowMap)
+	{
+		delete m_pShadowMap;
+		m_pShadowMap = NULL;
+	}
+	if (NULL != m_pShadowShaderManager)
+	{
+		delete m_pShadowShaderManager;
+		m_pShadowShaderManager = NULL;
+	}
+	if (NULL != m_pClusteredLighting)
+	{
+		delete m_pClusteredLighting;
+		m_pClusteredLighting = NULL;
+	}
+	if (NULL != m_pDepthShaderManager)
+	{
+		delete m_pDepthShaderManager;
+		m_pDepthShaderManager = NULL;
+	}
+	if (NULL != m_pOcclusionCuller)
+	{
+		delete m_pOcclusionCuller;
+		m_pOcclusionCuller = NULL;
+	}
+	if (NULL != m_pDrawDataRing)
+	{
+		delete m_pDrawDataRing;
+		m_pDrawDataRing = NULL;
+	}
+	if (NULL != m_pShaderPermutations)
+	{
+		delete m_pShaderPermutations;
+		m_pShaderPermutations = NULL;
+	}
+	if (NULL != m_pLightmapBaker)
+	{
+		delete m_pLightmapBaker;
+		m_pLightmapBaker = NULL;
+	}
+	if (NULL != m_pSoftwareRasterizer)
+	{
+		delete m_pSoftwareRasterizer;
+		m_pSoftwareRasterizer = NULL;
+	}
+	if (NULL != m_pMultiViewTarget)
+	{
+		delete m_pMultiViewTarget;
+		m_pMultiViewTarget = NULL;
+	}
+	if (NULL != m_pTextureStreamer)
+	{
+		delete m_pTextureStreamer;
+		m_pTextureStreamer = NULL;
+	}
+	if (NULL != m_pFoliageSystem)
+	{
+		delete m_pFoliageSystem;
+		m_pFoliageSystem = NULL;
+	}
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		if (m_timerQueryIDs[i][0] != 0)
+		{
+			glDeleteQueries(2, m_timerQueryIDs[i]);
+			glDeleteQueries(1, &m_primitiveQueryIDs[i]);
+		}
+	}
 }
 
 /***********************************************************
  *  CreateGLTexture()
  *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  This method is used for creating a texture for an image
+ *  file and loading it into the next available texture slot.
+ *  The texture object exists right away; the image is decoded
+ *  in the background and its mipmaps are uploaded smallest
+ *  first over the following frames by the texture streamer.
  ***********************************************************/
 bool SceneManager::CreateGLTexture(const char* filename, std::string tag, GLint wrapS = GL_REPEAT, GLint wrapT = GL_REPEAT)
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
-
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
-
-	// if the image was successfully read from the image file
-	if (image)
-	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		GLenum format;
-		if (colorChannels == 1)
-			format = GL_RED;
-		else if (colorChannels == 3)
-			format = GL_RGB;
-		else if (colorChannels == 4)
-			format = GL_RGBA;
-		else
-		{
-			std::cout << "Error: Unsupported number of channels: " << colorChannels << std::endl;
-			stbi_image_free(image);
-			glBindTexture(GL_TEXTURE_2D, 0);
-			return false;
-		}
-
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image);
-
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		// **IMPORTANT: Generate mipmaps BEFORE setting wrap parameters.**
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT);
-
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // Use mipmapping for minification
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+	GLuint textureID = m_pTextureStreamer->CreateTexture(filename, wrapS, wrapT);
+	if (textureID == 0)
+	{
+		// Error loading the image
+		return false;
+	}
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+	std::cout << "Successfully queued image:" << filename << std::endl;
 
-		return true;
-	}
+	// register the loaded texture and associate it with the special tag string
+	m_textureIDs[m_loadedTextures].ID = textureID;
+	m_textureIDs[m_loadedTextures].tag = tag;
+	m_loadedTextures++;
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	return true;
+}
 
-	// Error loading the image
-	return false;
-}/***********************************************************
+/***********************************************************
  *  BindGLTextures()
  *
  *  This method is used for binding the loaded textures to
@@ -140,8 +334,7 @@ void SceneManager::BindGLTextures()
 	for (int i = 0; i < m_loadedTextures; i++)
 	{
 		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		GLStateCache::BindTexture2D(i, m_textureIDs[i].ID);
 	}
 }
 
@@ -234,6 +427,7 @@ bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
 			material.diffuseColor = m_objectMaterials[index].diffuseColor;
 			material.specularColor = m_objectMaterials[index].specularColor;
 			material.shininess = m_objectMaterials[index].shininess;
+			material.opacity = m_objectMaterials[index].opacity;
 		}
 		else
 		{
@@ -247,8 +441,9 @@ bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
 /***********************************************************
  *  SetTransformations()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for setting the model transform of
+ *  the next recorded draw command using the passed in
+ *  transformation values.
  ***********************************************************/
 void SceneManager::SetTransformations(
 	glm::vec3 scaleXYZ,
@@ -276,17 +471,19 @@ void SceneManager::SetTransformations(
 
 	modelView = translation * rotationZ * rotationY * rotationX * scale;
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
-	}
+	// fingerprint the transform so that moved objects invalidate
+	// the cached shadow map
+	m_frameSceneSignature = HashBytes(m_frameSceneSignature, &modelView, sizeof(modelView));
+
+	// recorded with the next mesh draw
+	m_drawState.model = modelView;
 }
 
 /***********************************************************
  *  SetShaderColor()
  *
  *  This method is used for setting the passed in color
- *  into the shader for the next draw command
+ *  for the next recorded draw command
  ***********************************************************/
 void SceneManager::SetShaderColor(
 	float redColorValue,
@@ -302,42 +499,30 @@ void SceneManager::SetShaderColor(
 	currentColor.b = blueColorValue;
 	currentColor.a = alphaValue;
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
-	}
+	m_drawState.bUseTexture = false;
+	m_drawState.color = currentColor;
 }
 
 /***********************************************************
  *  SetShaderTexture()
  *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
+ *  This method is used for selecting the texture associated
+ *  with the passed in tag for the next recorded draw command.
  ***********************************************************/
 void SceneManager::SetShaderTexture(std::string textureTag)
 {
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
-
-		// Find the texture slot (0-15)
-		int textureSlot = FindTextureSlot(textureTag);
-		if (textureSlot != -1)
-		{
-			// Activate the correct texture unit BEFORE binding.
-			glActiveTexture(GL_TEXTURE0 + textureSlot);
-
-			// Bind the texture to the active texture unit.
-			glBindTexture(GL_TEXTURE_2D, m_textureIDs[textureSlot].ID);
+	m_drawState.bUseTexture = true;
 
-			// Tell the shader which texture unit to use.  This is CRUCIAL.
-			m_pShaderManager->setIntValue(g_TextureValueName, textureSlot); // Pass the SLOT, not the ID
-		}
-		else
-		{
-			std::cerr << "Texture slot not found for tag: " << textureTag << std::endl;
-		}
+	// Find the texture slot (0-15)
+	int textureSlot = FindTextureSlot(textureTag);
+	if (textureSlot != -1)
+	{
+		// the texture unit is bound when the draw is issued
+		m_drawState.textureSlot = textureSlot; // Pass the SLOT, not the ID
+	}
+	else
+	{
+		std::cerr << "Texture slot not found for tag: " << textureTag << std::endl;
 	}
 }
 
@@ -345,21 +530,18 @@ void SceneManager::SetShaderTexture(std::string textureTag)
  *  SetTextureUVScale()
  *
  *  This method is used for setting the texture UV scale
- *  values into the shader.
+ *  values for the next recorded draw command.
  ***********************************************************/
 void SceneManager::SetTextureUVScale(float u, float v)
 {
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
-	}
+	m_drawState.uvScale = glm::vec2(u, v);
 }
 
 /***********************************************************
  *  SetShaderMaterial()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for setting the material values
+ *  that the next recorded draw calls will use.
  ***********************************************************/
 void SceneManager::SetShaderMaterial(
 	std::string materialTag)
@@ -372,9 +554,10 @@ void SceneManager::SetShaderMaterial(
 		bReturn = FindMaterial(materialTag, material);
 		if (bReturn == true)
 		{
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+			m_drawState.diffuseColor = material.diffuseColor;
+			m_drawState.specularColor = material.specularColor;
+			m_drawState.shininess = material.shininess;
+			m_drawState.opacity = material.opacity;
 		}
 	}
 }
@@ -393,6 +576,8 @@ void SceneManager::SetShaderMaterial(
   *  rendering
   ***********************************************************/
 void SceneManager::LoadSceneTextures() {
+	MEMORY_PHASE("LoadSceneTextures");
+	TRACE_SCOPE("LoadSceneTextures");
 	bool bReturn = false;
 
 	// Load glass texture (repeating)
@@ -433,6 +618,12 @@ void SceneManager::LoadSceneTextures() {
 	bReturn = CreateGLTexture("textures/mouse_texture.jpg", "mouse_texture", GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);   // Specify clamping
 	if (!bReturn) std::cerr << "Failed to load mouse texture." << std::endl;
 
+	// without streaming, wait until every mipmap is uploaded
+	if (m_bTextureStreaming == false)
+	{
+		m_pTextureStreamer->Finish();
+	}
+
 	// Bind textures (this part remains unchanged)
 	BindGLTextures();
 }
@@ -469,6 +660,7 @@ void SceneManager::DefineObjectMaterials()
 	glassMaterial.diffuseColor = glm::vec3(0.1f, 0.1f, 0.2f); // Slightly bluish tint
 	glassMaterial.specularColor = glm::vec3(0.9f, 0.9f, 0.9f); // Very strong specular
 	glassMaterial.shininess = 256.0f; // Extremely shiny
+	glassMaterial.opacity = 0.6f; // see-through, drawn in the blended pass
 	glassMaterial.tag = "glass";
 	m_objectMaterials.push_back(glassMaterial);
 
@@ -566,62 +758,116 @@ void SceneManager::DefineObjectMaterials()
  *  SetupSceneLights()
  *
  *  This method is called to add and configure the light
- *  sources for the 3D scene.  There are up to 4 light sources.
+ *  sources for the 3D scene.  The first 4 point lights are
+ *  also set into the fixed pointLights[] shader array; any
+ *  further lights are only reachable through the clustered
+ *  light buffers.
  ***********************************************************/
 void SceneManager::SetupSceneLights()
 {
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+	GLStateCache::SetBool(m_pShaderManager, g_UseLightingName, true);
+	m_bUseLighting = true;
 
 	// --- Directional Light (Main Light Source) ---
 	// * Softer, coming from the front-left, slightly above.
 	// * Notice the shadows in the reference image.
-	m_pShaderManager->setVec3Value("directionalLight.direction", -0.5f, -0.6f, 0.7f); // Front-left, down
-	m_pShaderManager->setVec3Value("directionalLight.ambient", glm::vec3(0.4f));   // Reduced ambient
-	m_pShaderManager->setVec3Value("directionalLight.diffuse", glm::vec3(0.7f));   // Moderate diffuse
-	m_pShaderManager->setVec3Value("directionalLight.specular", glm::vec3(0.6f));  // Moderate specular
-	m_pShaderManager->setBoolValue("directionalLight.bActive", true);
+	GLStateCache::SetVec3(m_pShaderManager, "directionalLight.direction", m_directionalLightDirection); // Front-left, down
+	GLStateCache::SetVec3(m_pShaderManager, "directionalLight.ambient", m_directionalLightAmbient);   // Reduced ambient
+	GLStateCache::SetVec3(m_pShaderManager, "directionalLight.diffuse", m_directionalLightDiffuse);   // Moderate diffuse
+	GLStateCache::SetVec3(m_pShaderManager, "directionalLight.specular", m_directionalLightSpecular);  // Moderate specular
+	GLStateCache::SetBool(m_pShaderManager, "directionalLight.bActive", true);
+
+	m_pointLights.clear();
+	ClusteredLighting::POINT_LIGHT light;
 
 	// --- Point Light 1 (Overhead, Slightly Behind) ---
 	// * Acts as a general fill light, softening shadows.
-	m_pShaderManager->setVec3Value("pointLights[0].position", glm::vec3(0.0f, 12.0f, 5.0f)); // Higher, slightly behind
-	m_pShaderManager->setVec3Value("pointLights[0].ambient", glm::vec3(0.2f));    // Low ambient
-	m_pShaderManager->setVec3Value("pointLights[0].diffuse", glm::vec3(0.5f));    // Moderate diffuse
-	m_pShaderManager->setVec3Value("pointLights[0].specular", glm::vec3(0.3f));   // Low specular
-	m_pShaderManager->setFloatValue("pointLights[0].constant", 1.0f);
-	m_pShaderManager->setFloatValue("pointLights[0].linear", 0.045f);     // Slightly increased
-	m_pShaderManager->setFloatValue("pointLights[0].quadratic", 0.0075f);  // Slightly increased
-	m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
+	light.position = glm::vec3(0.0f, 12.0f, 5.0f); // Higher, slightly behind
+	light.ambient = glm::vec3(0.2f);    // Low ambient
+	light.diffuse = glm::vec3(0.5f);    // Moderate diffuse
+	light.specular = glm::vec3(0.3f);   // Low specular
+	light.constant = 1.0f;
+	light.linear = 0.045f;     // Slightly increased
+	light.quadratic = 0.0075f;  // Slightly increased
+	light.bActive = true;
+	m_pointLights.push_back(light);
 
 	// --- Point Light 2 (Front-Right, Close to Objects) ---
 	// * Adds a highlight to the right side of objects, creating more contrast.
-	m_pShaderManager->setVec3Value("pointLights[1].position", glm::vec3(10.0f, 6.0f, -3.0f)); // Front-right, closer
-	m_pShaderManager->setVec3Value("pointLights[1].ambient", glm::vec3(0.1f));     // Very low ambient
-	m_pShaderManager->setVec3Value("pointLights[1].diffuse", glm::vec3(0.6f));     // Moderate diffuse
-	m_pShaderManager->setVec3Value("pointLights[1].specular", glm::vec3(0.8f));    // Stronger specular
-	m_pShaderManager->setFloatValue("pointLights[1].constant", 1.0f);
-	m_pShaderManager->setFloatValue("pointLights[1].linear", 0.09f);
-	m_pShaderManager->setFloatValue("pointLights[1].quadratic", 0.032f);
-	m_pShaderManager->setBoolValue("pointLights[1].bActive", true);
+	light.position = glm::vec3(10.0f, 6.0f, -3.0f); // Front-right, closer
+	light.ambient = glm::vec3(0.1f);     // Very low ambient
+	light.diffuse = glm::vec3(0.6f);     // Moderate diffuse
+	light.specular = glm::vec3(0.8f);    // Stronger specular
+	light.constant = 1.0f;
+	light.linear = 0.09f;
+	light.quadratic = 0.032f;
+	light.bActive = true;
+	m_pointLights.push_back(light);
 
 	// --- Point Light 3 ---
-	m_pShaderManager->setVec3Value("pointLights[2].position", glm::vec3(-7.0f, 8.0f, 10.0f));
-	m_pShaderManager->setVec3Value("pointLights[2].ambient", glm::vec3(0.1f));
-	m_pShaderManager->setVec3Value("pointLights[2].diffuse", glm::vec3(0.3f));
-	m_pShaderManager->setVec3Value("pointLights[2].specular", glm::vec3(0.2f));
-	m_pShaderManager->setFloatValue("pointLights[2].constant", 1.0f);
-	m_pShaderManager->setFloatValue("pointLights[2].linear", 0.09f);
-	m_pShaderManager->setFloatValue("pointLights[2].quadratic", 0.032f);
-	m_pShaderManager->setBoolValue("pointLights[2].bActive", false);
+	light.position = glm::vec3(-7.0f, 8.0f, 10.0f);
+	light.ambient = glm::vec3(0.1f);
+	light.diffuse = glm::vec3(0.3f);
+	light.specular = glm::vec3(0.2f);
+	light.constant = 1.0f;
+	light.linear = 0.09f;
+	light.quadratic = 0.032f;
+	light.bActive = false;
+	m_pointLights.push_back(light);
 
 	// --- Point Light 4 ---
-	m_pShaderManager->setVec3Value("pointLights[3].position", glm::vec3(2.0f, 4.0f, -5.0f));
-	m_pShaderManager->setVec3Value("pointLights[3].ambient", glm::vec3(0.05f));
-	m_pShaderManager->setVec3Value("pointLights[3].diffuse", glm::vec3(0.2f));
-	m_pShaderManager->setVec3Value("pointLights[3].specular", glm::vec3(0.1f));
-	m_pShaderManager->setFloatValue("pointLights[3].constant", 1.0f);
-	m_pShaderManager->setFloatValue("pointLights[3].linear", 0.09f);
-	m_pShaderManager->setFloatValue("pointLights[3].quadratic", 0.032f);
-	m_pShaderManager->setBoolValue("pointLights[3].bActive", false);
+	light.position = glm::vec3(2.0f, 4.0f, -5.0f);
+	light.ambient = glm::vec3(0.05f);
+	light.diffuse = glm::vec3(0.2f);
+	light.specular = glm::vec3(0.1f);
+	light.constant = 1.0f;
+	light.linear = 0.09f;
+	light.quadratic = 0.032f;
+	light.bActive = false;
+	m_pointLights.push_back(light);
+
+	// the fixed shader path reads the first four lights from the
+	// pointLights[] uniform array
+	for (int i = 0; i < SCENE_POINT_LIGHTS; i++)
+	{
+		std::string prefix = "pointLights[" + std::to_string(i) + "].";
+		GLStateCache::SetVec3(m_pShaderManager, prefix + "position", m_pointLights[i].position);
+		GLStateCache::SetVec3(m_pShaderManager, prefix + "ambient", m_pointLights[i].ambient);
+		GLStateCache::SetVec3(m_pShaderManager, prefix + "diffuse", m_pointLights[i].diffuse);
+		GLStateCache::SetVec3(m_pShaderManager, prefix + "specular", m_pointLights[i].specular);
+		GLStateCache::SetFloat(m_pShaderManager, prefix + "constant", m_pointLights[i].constant);
+		GLStateCache::SetFloat(m_pShaderManager, prefix + "linear", m_pointLights[i].linear);
+		GLStateCache::SetFloat(m_pShaderManager, prefix + "quadratic", m_pointLights[i].quadratic);
+		GLStateCache::SetBool(m_pShaderManager, prefix + "bActive", m_pointLights[i].bActive);
+	}
+
+	// the specialized shader variants only loop over the active
+	// lights when they come first in the array
+	m_fixedPointLightCount = 0;
+	while ((m_fixedPointLightCount < SCENE_POINT_LIGHTS) && (m_pointLights[m_fixedPointLightCount].bActive == true))
+	{
+		m_fixedPointLightCount++;
+	}
+	for (int i = m_fixedPointLightCount; i < SCENE_POINT_LIGHTS; i++)
+	{
+		if (m_pointLights[i].bActive == true)
+		{
+			m_fixedPointLightCount = ShaderPermutations::RUNTIME_LIGHTS;
+		}
+	}
+
+	// the clustered and brute force paths read them from the light buffer
+	if (NULL != m_pClusteredLighting)
+	{
+		m_pClusteredLighting->SetLights(m_pointLights);
+	}
+
+	// the lights changed, so the shadow map has to be rendered again
+	if (NULL != m_pShadowMap)
+	{
+		m_pShadowMap->SetLight(m_directionalLightDirection, m_shadowBoundsCenter, m_shadowBoundsRadius);
+	}
+	m_bShadowMapDirty = true;
 }
 
 /***********************************************************
@@ -633,6 +879,17 @@ void SceneManager::SetupSceneLights()
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
+	MEMORY_PHASE("PrepareScene");
+	TRACE_SCOPE("PrepareScene");
+
+	// create the light buffers used by the clustered point lights
+	m_pClusteredLighting = new ClusteredLighting();
+	if (m_pClusteredLighting->Create(m_pShaderManager) == false)
+	{
+		std::cerr << "ERROR: Clustered lighting buffers could not be created" << std::endl;
+		m_pointLightMode = ClusteredLighting::LIGHTS_FIXED;
+	}
+
 	// define the materials for objects in the scene
 	DefineObjectMaterials();
 
@@ -646,147 +903,1474 @@ void SceneManager::PrepareScene()
 	// loaded in memory no matter how many times it is drawn
 	// in the rendered 3D scene
 
-	m_basicMeshes->LoadPlaneMesh();
+	{
+		TRACE_SCOPE("LoadPlaneMesh");
+		m_basicMeshes->LoadPlaneMesh();
+	}
 
 	// Load additional meshes for the scene
-	m_basicMeshes->LoadCylinderMesh();
-	m_basicMeshes->LoadTaperedCylinderMesh();
-	m_basicMeshes->LoadTorusMesh();
-	m_basicMeshes->LoadSphereMesh();
-	m_basicMeshes->LoadBoxMesh();
-	
-	
-}
-
-// --- Helper Functions---
+	{
+		TRACE_SCOPE("LoadCylinderMesh");
+		m_basicMeshes->LoadCylinderMesh();
+	}
+	{
+		TRACE_SCOPE("LoadTaperedCylinderMesh");
+		m_basicMeshes->LoadTaperedCylinderMesh();
+	}
+	{
+		TRACE_SCOPE("LoadTorusMesh");
+		m_basicMeshes->LoadTorusMesh();
+	}
+	{
+		TRACE_SCOPE("LoadSphereMesh");
+		m_basicMeshes->LoadSphereMesh();
+	}
+	{
+		TRACE_SCOPE("LoadBoxMesh");
+		m_basicMeshes->LoadBoxMesh();
+	}
 
-// --- Book Helper Functions ---
-void SceneManager::DrawBook(const glm::vec3& position, const glm::vec3& scale, const glm::vec4& color) {
-	SetShaderColor(color.r, color.g, color.b, color.a);
-	SetTransformations(scale, 0.0f, 0.0f, 0.0f, position);
-	m_basicMeshes->DrawBoxMesh();
-}
+	// the foliage instances are generated once and stay on the GPU
+	m_pFoliageSystem = new FoliageSystem();
+	{
+		TRACE_SCOPE("CreateFoliage");
+		if (m_pFoliageSystem->Create(m_foliageParams) == false)
+		{
+			std::cerr << "ERROR: Foliage buffers could not be created" << std::endl;
+		}
+	}
+	m_pFoliageSystem->SetSway(m_bFoliageSway);
 
-// Gray book (bottom)
-void SceneManager::DrawGrayBook(const glm::vec3& basePosition, float deskHeight) {
-	SetShaderMaterial("gray_book");
-	glm::vec3 bookScale = glm::vec3(10.5f, 2.5f, 4.5f); // Width, height, depth
-	glm::vec3 bookPosition = glm::vec3(basePosition.x, deskHeight + bookScale.y / 2.0f, basePosition.z + 0.2f);
-	glm::vec4 bookColor = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f); // Gray
-	DrawBook(bookPosition, bookScale, bookColor);
-}
+	// make sure that untouched UV scales do not collapse the
+	// texture coordinates to zero
+	SetTextureUVScale(1.0f, 1.0f);
 
-// Black book (middle)
-void SceneManager::DrawBlackBook(const glm::vec3& basePosition, float deskHeight) {
-	SetShaderMaterial("black_book");
-	glm::vec3 grayBookScale = glm::vec3(10.5f, 2.5f, 4.5f); // Gray book scale for positioning
-	glm::vec3 blackBookScale = glm::vec3(9.5f, 1.25f, 4.0f); // Slightly smaller
-	glm::vec3 grayBookPosition = glm::vec3(basePosition.x, deskHeight + grayBookScale.y / 2.0f, basePosition.z + 0.2f);
-	glm::vec3 blackBookPosition = grayBookPosition + glm::vec3(0.2f, grayBookScale.y / 2.0f + blackBookScale.y / 2.0f, -0.2f); // On top of gray book
-	glm::vec4 bookColor = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f); // Black (or very dark gray)
-	DrawBook(blackBookPosition, blackBookScale, bookColor);
-}
+	// the static scene casts its shadows on the first frame - the
+	// shadow map is then reused every frame until something changes
+	CreateShadowMap();
 
-// Light blue book (top)
-void SceneManager::DrawLightBlueBook(const glm::vec3& basePosition, float deskHeight) {
-	SetShaderMaterial("light_blue_book");
-	glm::vec3 grayBookScale = glm::vec3(10.5f, 2.5f, 4.5f); // Gray book scale
-	glm::vec3 blackBookScale = glm::vec3(9.5f, 1.25f, 4.0f); // Black book scale
-	glm::vec3 lightBlueBookScale = glm::vec3(9.0f, 1.25f, 3.5f); // Slightly smaller again
-	glm::vec3 grayBookPosition = glm::vec3(basePosition.x, deskHeight + grayBookScale.y / 2.0f, basePosition.z + 0.2f);
-	glm::vec3 blackBookPosition = grayBookPosition + glm::vec3(0.2f, grayBookScale.y / 2.0f + blackBookScale.y / 2.0f, -0.2f); // On top of gray book
-	glm::vec3 lightBlueBookPosition = blackBookPosition + glm::vec3(-0.2f, blackBookScale.y / 2.0f + lightBlueBookScale.y / 2.0f, 0.2f); // On top of black, offset
-	glm::vec4 bookColor = glm::vec4(0.4f, 0.6f, 0.8f, 1.0f); // Light blue
-	DrawBook(lightBlueBookPosition, lightBlueBookScale, bookColor);
-}
+	// the depth pre-pass program shares the scene vertex shader
+	m_pDepthShaderManager = new ShaderManager();
+	m_pDepthShaderManager->LoadShaders(g_SceneVertexShaderPath, g_DepthFragmentShaderPath);
 
+	m_pDrawDataRing = new DrawDataRing();
+	if (m_pDrawDataRing->Create(DRAW_DATA_CAPACITY) == false)
+	{
+		std::cerr << "ERROR: Draw data ring could not be created" << std::endl;
+		delete m_pDrawDataRing;
+		m_pDrawDataRing = NULL;
+	}
 
+	// both programs of the scene vertex shader read the per-draw
+	// data - a sampler is set on the bound program only, so each
+	// program is bound before its unit is set
+	if (NULL != m_pDrawDataRing)
+	{
+		GLStateCache::UseProgram(m_pDepthShaderManager);
+		GLStateCache::SetInt(m_pDepthShaderManager, "drawData", DrawDataRing::DRAW_DATA_TEXTURE_UNIT);
+	}
+	GLStateCache::UseProgram(m_pShaderManager);
+	if (NULL != m_pDrawDataRing)
+	{
+		GLStateCache::SetInt(m_pShaderManager, "drawData", DrawDataRing::DRAW_DATA_TEXTURE_UNIT);
+	}
 
-// --- Monitor Helper Functions ---
+	// the variants are compiled from the same sources as the scene
+	// shader, the first time a draw needs them
+	m_pShaderPermutations = new ShaderPermutations();
+	if (m_pShaderPermutations->Create(m_pShaderManager, g_SceneVertexShaderPath, g_SceneFragmentShaderPath) == false)
+	{
+		delete m_pShaderPermutations;
+		m_pShaderPermutations = NULL;
+	}
+	else
+	{
+		// without it the multi-view passes draw one view at a time
+		m_pShaderPermutations->LoadMultiViewShader(g_MultiViewGeometryShaderPath);
+	}
 
-void SceneManager::DrawMonitorBezel(const glm::vec3& position, const glm::vec3& scale, const glm::vec4& color)
-{
-	SetShaderColor(color.r, color.g, color.b, color.a);
-	SetTransformations(scale, 0.0f, 0.0f, 0.0f, position);
-	m_basicMeshes->DrawBoxMesh();
+	// the bounding box queries are drawn with the depth program
+	m_pOcclusionCuller = new OcclusionCuller();
+	if (m_pOcclusionCuller->Create() == false)
+	{
+		delete m_pOcclusionCuller;
+		m_pOcclusionCuller = NULL;
+	}
 }
 
-void SceneManager::DrawMonitorScreen(const glm::vec3& position, const glm::vec3& scale)
+/***********************************************************
+ *  CreateShadowMap()
+ *
+ *  This method is used for creating the shadow map of the
+ *  directional light and loading the depth-only shader.  The
+ *  shadow map is rendered from the first recorded frame.
+ ***********************************************************/
+void SceneManager::CreateShadowMap()
 {
-	SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f); // White screen
-	SetTransformations(scale, 0.0f, 0.0f, 0.0f, position);
-	m_basicMeshes->DrawBoxMesh();
-}
+	TRACE_SCOPE("CreateShadowMap");
+	m_pShadowMap = new ShadowMap();
+	if (m_pShadowMap->Create(SHADOW_MAP_RESOLUTION) == false)
+	{
+		delete m_pShadowMap;
+		m_pShadowMap = NULL;
+		m_shadowQuality = ShadowMap::SHADOW_OFF;
+	}
+	else
+	{
+		m_pShadowShaderManager = new ShaderManager();
+		m_pShadowShaderManager->LoadShaders(g_ShadowVertexShaderPath, g_ShadowFragmentShaderPath);
+		m_pShadowMap->SetLight(m_directionalLightDirection, m_shadowBoundsCenter, m_shadowBoundsRadius);
+	}
 
+	// the scene shader must keep the shadow sampler on its own
+	// unit even when shadows are off, since two sampler types
+	// sharing a texture unit is a draw-time error
+	GLStateCache::UseProgram(m_pShaderManager);
+	GLStateCache::SetInt(m_pShaderManager, "shadowMap", SHADOW_TEXTURE_UNIT);
+	SetShadowQuality(m_shadowQuality);
 
-void SceneManager::DrawMonitorStand(const glm::vec3& basePosition)
+	m_bShadowMapDirty = true;
+}
+
+/***********************************************************
+ *  UpdateShadowMap()
+ *
+ *  This method is used for re-rendering the shadow map when
+ *  it is out of date, or on every frame when caching is off.
+ *  It returns true when the cached map was reused.
+ ***********************************************************/
+bool SceneManager::UpdateShadowMap()
 {
-	// Stand Base
-	glm::vec3 scaleXYZ = glm::vec3(7.0f, 0.3f, 5.0f);
-	glm::vec3 positionXYZ = glm::vec3(basePosition.x, 0.15f, basePosition.z - 2.0f); //Relative to the base position.
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderColor(0.82f, 0.82f, 0.82f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();
+	TRACE_SCOPE("UpdateShadowMap");
+	if ((NULL == m_pShadowMap) || (m_shadowQuality == ShadowMap::SHADOW_OFF))
+	{
+		return(false);
+	}
 
-	// Stand Arm (22.5 forward tilt)
-	const float armLength = 8.2f;
-	scaleXYZ = glm::vec3(0.8f, armLength, 0.8f);
-	positionXYZ = glm::vec3(basePosition.x, 0.15f, basePosition.z - 3.6f); //Relative to the base position
-	SetTransformations(scaleXYZ, 22.5f, 0.0f, 0.0f, positionXYZ);
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	if ((m_bShadowCaching == true) && (m_bShadowMapDirty == false))
+	{
+		return(true);
+	}
 
-	// Connection Point (Hidden)
-	scaleXYZ = glm::vec3(1.8f, 0.5f, 0.8f);
-	positionXYZ = glm::vec3(basePosition.x, basePosition.y + 3.45f, basePosition.z - 0.5f);  //Relative to the base position
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderColor(0.08f, 0.08f, 0.08f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();
+	RenderShadowMap();
+	return(false);
 }
 
-
-void SceneManager::DrawMonitor(float deskHeight)
+/***********************************************************
+ *  RenderShadowMap()
+ *
+ *  This method is used for rendering the scene depth as seen
+ *  from the directional light.  The draw list recorded for the
+ *  lighting pass is replayed with the depth-only shader.  The
+ *  grid draws are only the cells that the camera sees, so with
+ *  a grid every cell inside the light volume is drawn instead,
+ *  which keeps the map independent of the camera.
+ ***********************************************************/
+void SceneManager::RenderShadowMap()
 {
-	const float monitorWidth = 18.0f;
-	const float totalHeight = 12.0f;
-	const float silverBezelHeight = 2.5f;
-	const float blackBezelThickness = 0.6f;
-	const float screenDepth = 0.05f;
-	const float monitorBaseY = deskHeight + 4.0f; // Base Y-position (raised above desk)
-	const float blackBezelHeight = 0.5f; // Black bezel between silver and screen
+	ShaderManager* pSceneShaderManager = m_pShaderManager;
 
-	glm::vec3 basePosition(0.0f, monitorBaseY, -1.0f); // added a base position for the whole monitor
+	m_pShadowMap->BeginRender();
 
-	// --- Draw the monitor components ---
+	GLStateCache::UseProgram(m_pShadowShaderManager);
+	GLStateCache::SetMat4(m_pShadowShaderManager, g_LightSpaceMatrixName, m_pShadowMap->GetLightSpaceMatrix());
 
-	// Black Bezel - Top
-	DrawMonitorBezel(
-		glm::vec3(basePosition.x, basePosition.y + totalHeight - blackBezelThickness / 2, basePosition.z),
-		glm::vec3(monitorWidth, blackBezelThickness, 0.2f),
-		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
-	);
+	m_pShaderManager = m_pShadowShaderManager;
+	if (m_sceneGenerator.IsActive() == true)
+	{
+		m_sceneGenerator.ExpandShadowCasters(m_shadowCasters, m_pShadowMap->GetLightSpaceMatrix());
+		for (size_t i = 0; i < m_shadowCasters.size(); i++)
+		{
+			DrawItem(m_shadowCasters[i], true, -1, -1);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < m_renderQueue.GetItemCount(); i++)
+		{
+			DrawItem(m_renderQueue.GetItem(i), true, -1, i);
+		}
+	}
+	m_pShaderManager = pSceneShaderManager;
 
-	// Black Bezel - Left
-	DrawMonitorBezel(
-		glm::vec3(basePosition.x - monitorWidth / 2 + blackBezelThickness / 2, basePosition.y + totalHeight / 2, basePosition.z),
-		glm::vec3(blackBezelThickness, totalHeight, 0.2f),
-		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
-	);
+	m_pShadowMap->EndRender();
 
-	// Black Bezel - Right
-	DrawMonitorBezel(
-		glm::vec3(basePosition.x + monitorWidth / 2 - blackBezelThickness / 2, basePosition.y + totalHeight / 2, basePosition.z),
-		glm::vec3(blackBezelThickness, totalHeight, 0.2f),
-		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
-	);
+	GLStateCache::UseProgram(m_pShaderManager);
+	GLStateCache::SetMat4(m_pShaderManager, g_LightSpaceMatrixName, m_pShadowMap->GetLightSpaceMatrix());
 
-	// Silver Bezel (Chin)
-	DrawMonitorBezel(
-		glm::vec3(basePosition.x, basePosition.y + silverBezelHeight / 2, basePosition.z + 0.05f),
-		glm::vec3(monitorWidth, silverBezelHeight, 0.3f),
-		glm::vec4(0.09f, 0.09f, 0.09f, 1.0f) 
-	);
+	m_shadowSceneSignature = m_frameSceneSignature;
+	m_bShadowMapDirty = false;
+}
 
-	// Black Bezel (Between silver and screen)
+/***********************************************************
+ *  SetShadowQuality()
+ *
+ *  This method is used for selecting the shadow filtering
+ *  quality - off, a single hardware filtered tap, or a 3x3
+ *  or 5x5 percentage closer filtering kernel.
+ ***********************************************************/
+void SceneManager::SetShadowQuality(int quality)
+{
+	m_shadowQuality = glm::clamp(quality, (int)ShadowMap::SHADOW_OFF, (int)ShadowMap::SHADOW_PCF_5X5);
+	if (NULL == m_pShadowMap)
+	{
+		// applied once the shadow map has been created
+		return;
+	}
+
+	bool bUseShadows = (m_shadowQuality != ShadowMap::SHADOW_OFF);
+	GLStateCache::SetBool(m_pShaderManager, "bUseShadows", bUseShadows);
+	GLStateCache::SetInt(m_pShaderManager, "shadowPcfRadius", bUseShadows ? (m_shadowQuality - 1) : 0);
+
+	// the map is not updated while shadows are off
+	m_bShadowMapDirty = true;
+}
+
+/***********************************************************
+ *  SetShadowCaching()
+ *
+ *  This method is used for enabling the reuse of the shadow
+ *  map between frames.  With caching off the shadow map is
+ *  rendered every frame, which gives the uncached baseline.
+ ***********************************************************/
+void SceneManager::SetShadowCaching(bool bEnabled)
+{
+	m_bShadowCaching = bEnabled;
+}
+
+/***********************************************************
+ *  InvalidateShadowMap()
+ *
+ *  This method is used for forcing the shadow map to be
+ *  rendered again on the next frame.
+ ***********************************************************/
+void SceneManager::InvalidateShadowMap()
+{
+	m_bShadowMapDirty = true;
+}
+
+/***********************************************************
+ *  SetViewTransform()
+ *
+ *  This method is used for passing the camera matrices of
+ *  the current frame, which the light clustering needs.
+ ***********************************************************/
+void SceneManager::SetViewTransform(const glm::mat4& view, const glm::mat4& projection)
+{
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+}
+
+/***********************************************************
+ *  SetPointLightMode()
+ *
+ *  This method is used for selecting how the shader finds
+ *  the point lights (ClusteredLighting::POINT_LIGHT_MODE).
+ ***********************************************************/
+void SceneManager::SetPointLightMode(int mode)
+{
+	m_pointLightMode = glm::clamp(mode, (int)ClusteredLighting::LIGHTS_FIXED, (int)ClusteredLighting::LIGHTS_OBJECT);
+	if (NULL == m_pClusteredLighting)
+	{
+		m_pointLightMode = ClusteredLighting::LIGHTS_FIXED;
+	}
+}
+
+/***********************************************************
+ *  AddStressLights()
+ *
+ *  This method is used for scattering additional small
+ *  colored point lights across the scene to stress the
+ *  light assignment.  The same seed gives the same lights.
+ ***********************************************************/
+void SceneManager::AddStressLights(int count, unsigned int seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> randomX(-24.0f, 24.0f);
+	std::uniform_real_distribution<float> randomY(0.5f, 6.0f);
+	std::uniform_real_distribution<float> randomZ(-11.0f, 11.0f);
+	std::uniform_real_distribution<float> randomColor(0.2f, 1.0f);
+
+	for (int i = 0; i < count; i++)
+	{
+		ClusteredLighting::POINT_LIGHT light;
+		glm::vec3 color = glm::vec3(randomColor(generator), randomColor(generator), randomColor(generator));
+
+		light.position = glm::vec3(randomX(generator), randomY(generator), randomZ(generator));
+		light.ambient = glm::vec3(0.0f);
+		light.diffuse = color * 0.25f;
+		light.specular = color * 0.1f;
+		// short range falloff so that each light only reaches a few units
+		light.constant = 1.0f;
+		light.linear = 0.7f;
+		light.quadratic = 1.8f;
+		light.bActive = true;
+		m_pointLights.push_back(light);
+	}
+
+	if (NULL != m_pClusteredLighting)
+	{
+		m_pClusteredLighting->SetLights(m_pointLights);
+	}
+}
+
+/***********************************************************
+ *  RemoveStressLights()
+ *
+ *  This method is used for returning to the point lights
+ *  defined in SetupSceneLights.
+ ***********************************************************/
+void SceneManager::RemoveStressLights()
+{
+	if ((int)m_pointLights.size() > SCENE_POINT_LIGHTS)
+	{
+		m_pointLights.resize(SCENE_POINT_LIGHTS);
+	}
+
+	if (NULL != m_pClusteredLighting)
+	{
+		m_pClusteredLighting->SetLights(m_pointLights);
+	}
+}
+
+/***********************************************************
+ *  GetClusterStats()
+ *
+ *  This method is used for getting the light assignment
+ *  statistics of the last frame.
+ ***********************************************************/
+ClusteredLighting::CLUSTER_STATS SceneManager::GetClusterStats()
+{
+	if (NULL == m_pClusteredLighting)
+	{
+		return(ClusteredLighting::CLUSTER_STATS());
+	}
+	return(m_pClusteredLighting->GetStats());
+}
+
+/***********************************************************
+ *  GetObjectLightStats()
+ *
+ *  This method is used for getting the per-object light
+ *  list statistics of the last frame.
+ ***********************************************************/
+ClusteredLighting::OBJECT_STATS SceneManager::GetObjectLightStats()
+{
+	if (NULL == m_pClusteredLighting)
+	{
+		return(ClusteredLighting::OBJECT_STATS());
+	}
+	return(m_pClusteredLighting->GetObjectStats());
+}
+
+/***********************************************************
+ *  UpdatePointLights()
+ *
+ *  This method is used for binning the point lights into
+ *  the clusters of the current view, or into the light lists
+ *  of the queued draws, and binding the light buffers for
+ *  the lighting pass.  The draws have to be recorded first.
+ ***********************************************************/
+void SceneManager::UpdatePointLights()
+{
+	TRACE_SCOPE("UpdatePointLights");
+	if ((NULL == m_pClusteredLighting) || (m_pointLightMode == ClusteredLighting::LIGHTS_FIXED))
+	{
+		GLStateCache::SetInt(m_pShaderManager, "pointLightMode", ClusteredLighting::LIGHTS_FIXED);
+		return;
+	}
+
+	if (m_pointLightMode == ClusteredLighting::LIGHTS_OBJECT)
+	{
+		// world space box of every draw, from the box that
+		// encloses its mesh
+		int itemCount = m_renderQueue.GetItemCount();
+		m_objectBounds.resize(itemCount);
+		for (int i = 0; i < itemCount; i++)
+		{
+			const RenderQueue::DRAW_ITEM& item = m_renderQueue.GetItem(i);
+			glm::mat4 boundsModel = item.model * GetMeshBounds(item.meshShape);
+			glm::vec3 center = glm::vec3(boundsModel[3]);
+			glm::vec3 extent = 0.5f * (glm::abs(glm::vec3(boundsModel[0])) +
+				glm::abs(glm::vec3(boundsModel[1])) + glm::abs(glm::vec3(boundsModel[2])));
+			m_objectBounds[i].minPoint = center - extent;
+			m_objectBounds[i].maxPoint = center + extent;
+		}
+		m_pClusteredLighting->BuildObjectLights(m_objectBounds, m_objectLights);
+	}
+	else
+	{
+		// the clusters are built for the render target that is bound
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+
+		m_pClusteredLighting->BuildClusters(m_viewMatrix, m_projectionMatrix, viewport[2], viewport[3]);
+	}
+	m_pClusteredLighting->Bind(m_pShaderManager, m_pointLightMode);
+}
+
+/***********************************************************
+ *  PrintShadowStats()
+ *
+ *  This method is used for printing the shadow pass cost of
+ *  the cached and uncached frames.
+ ***********************************************************/
+void SceneManager::PrintShadowStats()
+{
+	if (NULL != m_pShadowMap)
+	{
+		m_pShadowMap->PrintStats();
+	}
+}
+
+/***********************************************************
+ *  SetRenderPath()
+ *
+ *  This method is used for selecting the order in which the
+ *  recorded draws are issued (RenderQueue::RENDER_PATH).
+ ***********************************************************/
+void SceneManager::SetRenderPath(int renderPath)
+{
+	m_renderPath = glm::clamp(renderPath, (int)RenderQueue::PATH_SOURCE_ORDER, (int)RenderQueue::PATH_SORTED);
+}
+
+/***********************************************************
+ *  SetDepthPrepass()
+ *
+ *  This method is used for enabling the depth-only pre-pass
+ *  over the opaque draws, after which every visible pixel is
+ *  shaded exactly once.
+ ***********************************************************/
+void SceneManager::SetDepthPrepass(bool bEnabled)
+{
+	m_bDepthPrepass = bEnabled;
+}
+
+/***********************************************************
+ *  SetShaderPermutations()
+ *
+ *  This method is used for choosing between the uber shader
+ *  and the shader variants specialized for the texture, the
+ *  lighting and the active point lights of each draw.
+ ***********************************************************/
+void SceneManager::SetShaderPermutations(bool bEnabled)
+{
+	m_bShaderPermutations = bEnabled;
+}
+
+/***********************************************************
+ *  BakeLightmaps()
+ *
+ *  This method is used for baking the lighting of the desk
+ *  scene.  The desk is recorded on its own, without the grid
+ *  cells, and its draws keep their lightmaps for as long as
+ *  they are recorded in the same place.
+ ***********************************************************/
+void SceneManager::BakeLightmaps()
+{
+	TRACE_SCOPE("BakeLightmaps");
+
+	m_renderQueue.Clear();
+	m_propFirstItems.clear();
+	DrawSceneObjects();
+
+	LightmapBaker::BAKE_LIGHTS lights;
+	lights.bDirectionalActive = true;
+	lights.directionalDirection = m_directionalLightDirection;
+	lights.directionalAmbient = m_directionalLightAmbient;
+	lights.directionalDiffuse = m_directionalLightDiffuse;
+	lights.pointLights = m_pointLights;
+
+	if (NULL == m_pLightmapBaker)
+	{
+		m_pLightmapBaker = new LightmapBaker();
+	}
+	if (m_pLightmapBaker->Bake(m_renderQueue, m_renderQueue.GetItemCount(), lights, g_LightmapCacheFilename) == true)
+	{
+		GLStateCache::SetInt(m_pShaderManager, "lightmapTexture", LightmapBaker::LIGHTMAP_TEXTURE_UNIT);
+		m_lightmapPointLightCount = (int)m_pointLights.size();
+	}
+
+	m_renderQueue.Clear();
+	m_propFirstItems.clear();
+}
+
+/***********************************************************
+ *  SetLightmaps()
+ *
+ *  This method is used for choosing between the baked
+ *  lighting and the shader's light loops for the baked
+ *  draws.
+ ***********************************************************/
+void SceneManager::SetLightmaps(bool bEnabled)
+{
+	m_bLightmaps = bEnabled;
+}
+
+/***********************************************************
+ *  SetSoftwareRasterizer()
+ *
+ *  This method is used for switching the frames between the
+ *  GL passes and the CPU rasterizer.  The rasterizer decodes
+ *  its own copy of the scene textures, so it has to be
+ *  enabled after PrepareScene(); its buffers are created on
+ *  the first frame, at the size of the viewport.
+ ***********************************************************/
+void SceneManager::SetSoftwareRasterizer(bool bEnabled, int threadCount)
+{
+	m_bSoftwareRaster = bEnabled;
+	if ((NULL != m_pSoftwareRasterizer) && (threadCount != m_softwareThreadCount))
+	{
+		m_pSoftwareRasterizer->Destroy();
+	}
+	m_softwareThreadCount = threadCount;
+
+	if ((bEnabled == true) && (NULL == m_pSoftwareRasterizer))
+	{
+		m_pSoftwareRasterizer = new SoftwareRasterizer();
+		m_pSoftwareRasterizer->LoadTextures(GetTextureFiles());
+	}
+}
+
+/***********************************************************
+ *  SaveSoftwareFrame()
+ *
+ *  This method is used for writing the last frame drawn by
+ *  the software rasterizer to an image file.
+ ***********************************************************/
+bool SceneManager::SaveSoftwareFrame(const char* filename)
+{
+	if ((NULL == m_pSoftwareRasterizer) || (m_pSoftwareRasterizer->GetWidth() <= 0))
+	{
+		return(false);
+	}
+	return(m_pSoftwareRasterizer->SaveImage(filename));
+}
+
+/***********************************************************
+ *  GetSoftwareRasterStats()
+ *
+ *  This method is used for getting the counters and phase
+ *  times of the last software frame.
+ ***********************************************************/
+SoftwareRasterizer::RASTER_STATS SceneManager::GetSoftwareRasterStats()
+{
+	if (NULL == m_pSoftwareRasterizer)
+	{
+		return(SoftwareRasterizer::RASTER_STATS());
+	}
+	return(m_pSoftwareRasterizer->GetStats());
+}
+
+/***********************************************************
+ *  PickObject()
+ *
+ *  This method is used for finding the draw that the ray
+ *  hits first and the desk prop it was recorded for.  The
+ *  pick tree is refit or rebuilt for the draws of the last
+ *  frame before the ray is traced, so nothing is spent on it
+ *  in the frames without a pick.  With a desk grid, only the
+ *  desks that were in view can be picked.
+ ***********************************************************/
+bool SceneManager::PickObject(const glm::vec3& origin, const glm::vec3& direction, PICKED_OBJECT& picked)
+{
+	TRACE_SCOPE("PickObject");
+	double startTime = TraceProfiler::NowMilliseconds();
+	m_scenePicker.Update(m_renderQueue);
+	double updatedTime = TraceProfiler::NowMilliseconds();
+
+	ScenePicker::PICK_RESULT result;
+	bool bHit = m_scenePicker.Pick(origin, direction, result);
+	picked.queryMicroseconds = (TraceProfiler::NowMilliseconds() - updatedTime) * 1000.0;
+	picked.updateMilliseconds = updatedTime - startTime;
+
+	picked.itemIndex = result.itemIndex;
+	picked.distance = result.distance;
+	picked.position = result.position;
+	picked.prop = SceneGenerator::PROP_DESK;
+	picked.cell = 0;
+	if (bHit == false)
+	{
+		return(false);
+	}
+
+	if (m_sceneGenerator.IsActive() == true)
+	{
+		m_sceneGenerator.GetItemSource(result.itemIndex, picked.cell, picked.prop);
+	}
+	else
+	{
+		// the props start at the marked draws, in DESK_PROP order
+		for (int prop = 0; prop < (int)m_propFirstItems.size(); prop++)
+		{
+			if (m_propFirstItems[prop] <= result.itemIndex)
+			{
+				picked.prop = prop;
+			}
+		}
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  PrintPickedObject()
+ *
+ *  This method is used for printing what a pick found - the
+ *  prop, the mesh and material of the draw, where the ray hit
+ *  it, and how long the tree update and the query took.
+ ***********************************************************/
+void SceneManager::PrintPickedObject(const PICKED_OBJECT& picked)
+{
+	if (picked.itemIndex < 0)
+	{
+		std::cout << "INFO: Picked nothing, query " << picked.queryMicroseconds << " us" << std::endl;
+		return;
+	}
+
+	const RenderQueue::DRAW_ITEM& item = m_renderQueue.GetItem(picked.itemIndex);
+	std::cout << "INFO: Picked the " << g_PropNames[picked.prop];
+	if (m_sceneGenerator.IsActive() == true)
+	{
+		std::cout << " of desk " << picked.cell;
+	}
+	std::cout << ", draw " << picked.itemIndex << " (" << g_MeshShapeNames[item.meshShape] << ")"
+		<< " at " << picked.distance << " units, hit point ("
+		<< picked.position.x << ", " << picked.position.y << ", " << picked.position.z << ")\n";
+	std::cout << "  diffuse (" << item.diffuseColor.r << ", " << item.diffuseColor.g << ", " << item.diffuseColor.b << ")"
+		<< ", opacity " << item.opacity;
+	if ((item.bUseTexture == true) && (item.textureSlot >= 0) && (item.textureSlot < m_loadedTextures))
+	{
+		std::cout << ", texture " << m_textureIDs[item.textureSlot].tag;
+	}
+	std::cout << "\n  tree update " << picked.updateMilliseconds << " ms, query "
+		<< picked.queryMicroseconds << " us" << std::endl;
+}
+
+/***********************************************************
+ *  CreateMultiViewTarget()
+ *
+ *  This method is used for creating the atlas that the
+ *  multi-view passes render the views into, one tile of the
+ *  passed in size per view.
+ ***********************************************************/
+bool SceneManager::CreateMultiViewTarget(int tileWidth, int tileHeight)
+{
+	if (NULL == m_pMultiViewTarget)
+	{
+		m_pMultiViewTarget = new MultiViewTarget();
+	}
+	if (m_pMultiViewTarget->Create(tileWidth, tileHeight) == false)
+	{
+		delete m_pMultiViewTarget;
+		m_pMultiViewTarget = NULL;
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  RenderMultiView()
+ *
+ *  This method is used for rendering the scene from several
+ *  cameras into the tiles of the multi-view atlas.  The
+ *  single pass records, sorts and uploads the scene once and
+ *  draws every draw into all the views at the same time;
+ *  otherwise every view is a full RenderScene() of its own.
+ *  The settings that only hold for a single camera are
+ *  replaced for both, so that they draw the same images - the
+ *  clustered lights loop over every light, the occlusion
+ *  results and the pre-pass are not used and every grid cell
+ *  is recorded.
+ ***********************************************************/
+bool SceneManager::RenderMultiView(const SCENE_VIEW* pViews, int viewCount, bool bSinglePass)
+{
+	if ((NULL == m_pMultiViewTarget) || (NULL == pViews) || (viewCount <= 0) || (m_bSoftwareRaster == true))
+	{
+		return(false);
+	}
+	viewCount = std::min(viewCount, (int)MultiViewTarget::MAX_VIEWS);
+
+	// the single pass needs the multi-view shader variants
+	if ((bSinglePass == true) && ((NULL == m_pShaderPermutations) ||
+		(m_pShaderPermutations->IsMultiViewLoaded() == false) ||
+		(m_pShaderPermutations->GetVariant(ShaderPermutations::FEATURE_MULTI_VIEW |
+			ShaderPermutations::MakeFeatureMask(false, true, ShaderPermutations::RUNTIME_LIGHTS)) == NULL)))
+	{
+		return(false);
+	}
+
+	int pointLightMode = m_pointLightMode;
+	bool bOcclusionCulling = m_bOcclusionCulling;
+	bool bDepthPrepass = m_bDepthPrepass;
+	bool bGridCulling = m_sceneGenerator.IsFrustumCulling();
+	if (m_pointLightMode == ClusteredLighting::LIGHTS_CLUSTERED)
+	{
+		m_pointLightMode = ClusteredLighting::LIGHTS_ALL;
+	}
+	m_bOcclusionCulling = false;
+	m_bDepthPrepass = false;
+	m_sceneGenerator.SetFrustumCulling(false);
+
+	m_multiViewStats = MULTI_VIEW_STATS();
+	m_multiViewStats.viewCount = viewCount;
+	m_multiViewStats.bSinglePass = bSinglePass;
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	m_pMultiViewTarget->Begin(viewCount, bSinglePass);
+	if (bSinglePass == true)
+	{
+		RenderViewsSinglePass(pViews, viewCount);
+	}
+	else
+	{
+		for (int i = 0; i < viewCount; i++)
+		{
+			m_pMultiViewTarget->SetTileViewport(i);
+			GLStateCache::UseProgram(m_pShaderManager);
+			GLStateCache::SetMat4(m_pShaderManager, "view", pViews[i].view);
+			GLStateCache::SetMat4(m_pShaderManager, "projection", pViews[i].projection);
+			GLStateCache::SetVec3(m_pShaderManager, "viewPosition", glm::vec3(glm::inverse(pViews[i].view)[3]));
+			SetViewTransform(pViews[i].view, pViews[i].projection);
+			RenderScene();
+
+			m_multiViewStats.recordMilliseconds += m_frameTiming.recordMilliseconds;
+			m_multiViewStats.submitMilliseconds += m_frameTiming.totalMilliseconds - m_frameTiming.recordMilliseconds;
+		}
+		m_multiViewStats.itemCount = m_renderQueue.GetItemCount();
+	}
+	m_pMultiViewTarget->End();
+	m_multiViewStats.totalMilliseconds = TraceProfiler::NowMilliseconds() - startTime;
+
+	m_pointLightMode = pointLightMode;
+	m_bOcclusionCulling = bOcclusionCulling;
+	m_bDepthPrepass = bDepthPrepass;
+	m_sceneGenerator.SetFrustumCulling(bGridCulling);
+	return(true);
+}
+
+/***********************************************************
+ *  RenderViewsSinglePass()
+ *
+ *  This method is used for drawing every view of a multi-
+ *  view pass with one submission of the queue.  The scene
+ *  code, the grid expansion, the shadow map, the light
+ *  buffer, the sort and the draw data upload are done once
+ *  for all the views.  The first camera stands in for the
+ *  others where one camera is needed, so the transparent
+ *  draws are blended in its back-to-front order in every
+ *  view.
+ ***********************************************************/
+void SceneManager::RenderViewsSinglePass(const SCENE_VIEW* pViews, int viewCount)
+{
+	TRACE_SCOPE("RenderViewsSinglePass");
+	m_drawCounters = DRAW_COUNTERS();
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	SetViewTransform(pViews[0].view, pViews[0].projection);
+	for (int i = 0; i < viewCount; i++)
+	{
+		m_multiViewProjections[i] = pViews[i].projection * pViews[i].view;
+		m_multiViewPositions[i] = glm::vec3(glm::inverse(pViews[i].view)[3]);
+	}
+	m_multiViewCount = viewCount;
+
+	m_pTextureStreamer->Update();
+	RecordSceneDraws();
+	double recordedTime = TraceProfiler::NowMilliseconds();
+
+	PrepareShadowMap();
+	UpdatePointLights();
+	UploadSortedDraws();
+
+	// the variants copy the lights and the shadow settings from the
+	// uber shader, and get the cameras when they are first bound
+	bool bShaderPermutations = m_bShaderPermutations;
+	m_bShaderPermutations = true;
+	m_bMultiViewPass = true;
+	m_multiViewPrograms.clear();
+	DrawShadingPasses();
+	m_bMultiViewPass = false;
+	m_bShaderPermutations = bShaderPermutations;
+	if (NULL != m_pDrawDataRing)
+	{
+		m_pDrawDataRing->EndFrame();
+	}
+
+	m_multiViewStats.itemCount = m_renderQueue.GetItemCount();
+	m_multiViewStats.recordMilliseconds = recordedTime - startTime;
+	m_multiViewStats.submitMilliseconds = TraceProfiler::NowMilliseconds() - recordedTime;
+}
+
+/***********************************************************
+ *  SetMultiViewUniforms()
+ *
+ *  This method is used for setting the cameras of the pass
+ *  on the bound multi-view variant.  The array elements go
+ *  through the state cache one by one, so a view that did
+ *  not move since the last pass is not uploaded again.
+ ***********************************************************/
+void SceneManager::SetMultiViewUniforms(ShaderManager* pShaderManager)
+{
+	int uniformUploads = 0;
+	for (int i = 0; i < m_multiViewCount; i++)
+	{
+		std::string index = "[" + std::to_string(i) + "]";
+		uniformUploads += (int)GLStateCache::SetMat4(pShaderManager, "viewProjections" + index, m_multiViewProjections[i]);
+		uniformUploads += (int)GLStateCache::SetVec3(pShaderManager, "viewPositions" + index, m_multiViewPositions[i]);
+	}
+	uniformUploads += (int)GLStateCache::SetInt(pShaderManager, "viewCount", m_multiViewCount);
+	m_drawCounters.uniformUploads += uniformUploads;
+}
+
+/***********************************************************
+ *  SaveMultiViewAtlas()
+ *
+ *  This method is used for writing the atlas of the last
+ *  multi-view pass as a PPM image.
+ ***********************************************************/
+bool SceneManager::SaveMultiViewAtlas(const char* filename)
+{
+	if (NULL == m_pMultiViewTarget)
+	{
+		return(false);
+	}
+	return(m_pMultiViewTarget->SaveAtlas(filename));
+}
+
+/***********************************************************
+ *  RenderSoftware()
+ *
+ *  This method is used for drawing the recorded queue with
+ *  the software rasterizer and blitting the result into the
+ *  viewport.  The shadow map, the light assignment and the
+ *  GL passes are skipped, so the submit time of the frame is
+ *  the rasterizer's.
+ ***********************************************************/
+void SceneManager::RenderSoftware(double startTime, double recordedTime)
+{
+	TRACE_SCOPE("RenderSoftware");
+
+	m_renderQueue.Sort(m_viewMatrix);
+	double sortedTime = TraceProfiler::NowMilliseconds();
+
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	if ((m_pSoftwareRasterizer->GetWidth() != viewport[2]) || (m_pSoftwareRasterizer->GetHeight() != viewport[3]))
+	{
+		m_pSoftwareRasterizer->Create(viewport[2], viewport[3], m_softwareThreadCount);
+	}
+
+	SoftwareRasterizer::SHADING_LIGHTS lights;
+	lights.bUseLighting = m_bUseLighting;
+	lights.bDirectionalActive = true;
+	lights.directionalDirection = m_directionalLightDirection;
+	lights.directionalAmbient = m_directionalLightAmbient;
+	lights.directionalDiffuse = m_directionalLightDiffuse;
+	lights.directionalSpecular = m_directionalLightSpecular;
+	lights.pointLights = m_pointLights;
+
+	m_pSoftwareRasterizer->Render(m_renderQueue, m_viewMatrix, m_projectionMatrix, lights);
+	m_pSoftwareRasterizer->Blit();
+	double endTime = TraceProfiler::NowMilliseconds();
+
+	m_drawCounters.culledObjects = m_sceneGenerator.IsActive() ? m_sceneGenerator.GetStats().culledItems : 0;
+
+	m_frameTiming.itemCount = m_renderQueue.GetItemCount();
+	m_frameTiming.recordMilliseconds = recordedTime - startTime;
+	m_frameTiming.shadowMilliseconds = 0.0;
+	m_frameTiming.lightMilliseconds = 0.0;
+	m_frameTiming.sortMilliseconds = sortedTime - recordedTime;
+	m_frameTiming.submitMilliseconds = endTime - sortedTime;
+	m_frameTiming.queryMilliseconds = 0.0;
+	m_frameTiming.totalMilliseconds = endTime - startTime;
+	AccumulateFrameTiming();
+}
+
+/***********************************************************
+ *  PrintRenderStats()
+ *
+ *  This method is used for printing the draw counts, the
+ *  culled draws and the shading cost of the scene passes.
+ ***********************************************************/
+void SceneManager::PrintRenderStats()
+{
+	m_renderQueue.PrintStats();
+	if ((NULL != m_pOcclusionCuller) && (m_bOcclusionCulling == true))
+	{
+		m_pOcclusionCuller->PrintStats();
+	}
+	if (NULL != m_pDrawDataRing)
+	{
+		m_pDrawDataRing->PrintStats();
+	}
+	if (NULL != m_pShaderPermutations)
+	{
+		m_pShaderPermutations->PrintStats();
+	}
+}
+
+/***********************************************************
+ *  SetTextureStreaming()
+ *
+ *  This method is used for choosing between streaming the
+ *  texture mipmaps over the first frames and uploading every
+ *  texture completely before the first frame.  It has to be
+ *  called before PrepareScene().
+ ***********************************************************/
+void SceneManager::SetTextureStreaming(bool bEnabled, int uploadBudgetKB)
+{
+	m_bTextureStreaming = bEnabled;
+	if (uploadBudgetKB > 0)
+	{
+		m_pTextureStreamer->SetUploadBudget((size_t)uploadBudgetKB * 1024);
+	}
+}
+
+/***********************************************************
+ *  SetMipFilter()
+ *
+ *  This method is used for choosing how the texture mipmaps
+ *  are built - on the CPU with the box or Kaiser filter, or
+ *  with glGenerateMipmap after level 0 is uploaded.  It has
+ *  to be called before PrepareScene().
+ ***********************************************************/
+void SceneManager::SetMipFilter(int filter)
+{
+	m_pTextureStreamer->SetMipFilter(filter);
+}
+
+/***********************************************************
+ *  GetTextureFiles()
+ *
+ *  This method is used for getting the image files of the
+ *  scene textures, for the texture loading benchmark.
+ ***********************************************************/
+std::vector<std::string> SceneManager::GetTextureFiles() const
+{
+	std::vector<std::string> filenames;
+	for (int i = 0; i < m_pTextureStreamer->GetTextureCount(); i++)
+	{
+		filenames.push_back(m_pTextureStreamer->GetResidency(i).filename);
+	}
+	return(filenames);
+}
+
+/***********************************************************
+ *  PrintTextureResidency()
+ *
+ *  This method is used for printing the resident mipmaps
+ *  and memory of every scene texture.
+ ***********************************************************/
+void SceneManager::PrintTextureResidency()
+{
+	m_pTextureStreamer->PrintResidency();
+}
+
+/***********************************************************
+ *  SetOcclusionCulling()
+ *
+ *  This method is used for enabling the culling of draws
+ *  whose bounding box was hidden on the previous frame.
+ ***********************************************************/
+void SceneManager::SetOcclusionCulling(bool bEnabled)
+{
+	m_bOcclusionCulling = bEnabled;
+}
+
+/***********************************************************
+ *  SetFoliage()
+ *
+ *  This method is used for choosing how many flowers and
+ *  puffs the vase plant grows - a density of 1.0 generates
+ *  FoliageSystem::FLOWER_COUNT flowers and PUFF_COUNT puffs.
+ *  The density does not change the number of draw calls.
+ *  It has to be called before PrepareScene().
+ ***********************************************************/
+void SceneManager::SetFoliage(float density, unsigned int seed)
+{
+	m_foliageParams.density = density;
+	m_foliageParams.seed = seed;
+}
+
+/***********************************************************
+ *  SetFoliageSway()
+ *
+ *  This method is used for enabling or disabling the sway
+ *  animation of the foliage.  Still foliage renders the same
+ *  image every frame, which the regression runs rely on.
+ ***********************************************************/
+void SceneManager::SetFoliageSway(bool bEnabled)
+{
+	m_bFoliageSway = bEnabled;
+	if (NULL != m_pFoliageSystem)
+	{
+		m_pFoliageSystem->SetSway(bEnabled);
+	}
+}
+
+/***********************************************************
+ *  SubmitMesh()
+ *
+ *  This method is used for recording a draw of one of the
+ *  basic meshes with the current transform, color, texture
+ *  and material.  For box sides meshParts holds the side,
+ *  for cylinders the RenderQueue::MESH_PARTS to draw.
+ ***********************************************************/
+void SceneManager::SubmitMesh(int meshShape, int meshParts)
+{
+	m_drawState.meshShape = meshShape;
+	m_drawState.meshParts = meshParts;
+	m_renderQueue.Submit(m_drawState);
+}
+
+/***********************************************************
+ *  DrawItem()
+ *
+ *  This method is used for setting the shader state of a
+ *  recorded draw and drawing its mesh.  Draws with a draw
+ *  index read their transform and surface values from the
+ *  draw data ring, the others get them as uniforms.
+ *  Depth-only passes only need the model transform.  The
+ *  shading pass draws with the shader variant of the item's
+ *  features when the permutations are enabled, and a
+ *  multi-view pass always draws with the multi-view one.
+ ***********************************************************/
+void SceneManager::DrawItem(const RenderQueue::DRAW_ITEM& item, bool bDepthOnly, int drawIndex, int itemIndex)
+{
+	ShaderManager* pSceneShaderManager = m_pShaderManager;
+	if ((bDepthOnly == false) && (NULL != m_pShaderPermutations) && (m_bShaderPermutations == true))
+	{
+		int pointLightCount = (m_pointLightMode == ClusteredLighting::LIGHTS_FIXED)
+			? m_fixedPointLightCount : ShaderPermutations::RUNTIME_LIGHTS;
+		unsigned int featureMask = ShaderPermutations::MakeFeatureMask(item.bUseTexture, m_bUseLighting, pointLightCount);
+		if (m_bMultiViewPass == true)
+		{
+			featureMask |= ShaderPermutations::FEATURE_MULTI_VIEW;
+		}
+		ShaderManager* pVariant = m_pShaderPermutations->GetVariant(featureMask);
+		if (NULL != pVariant)
+		{
+			m_pShaderManager = pVariant;
+		}
+		else if (m_bMultiViewPass == true)
+		{
+			// the uber shader would only draw the first view
+			return;
+		}
+		GLStateCache::UseProgram(m_pShaderManager);
+
+		if ((m_bMultiViewPass == true) &&
+			(std::find(m_multiViewPrograms.begin(), m_multiViewPrograms.end(), m_pShaderManager) == m_multiViewPrograms.end()))
+		{
+			SetMultiViewUniforms(m_pShaderManager);
+			m_multiViewPrograms.push_back(m_pShaderManager);
+		}
+	}
+
+	// the state cache drops the uniforms and binds that repeat the
+	// previous draw, so only the uploads that happen are counted
+	int uniformUploads = (int)GLStateCache::SetBool(m_pShaderManager, "bUseDrawData", drawIndex >= 0);
+	if (drawIndex >= 0)
+	{
+		uniformUploads += (int)GLStateCache::SetInt(m_pShaderManager, "drawIndex", drawIndex);
+	}
+	else
+	{
+		uniformUploads += (int)GLStateCache::SetMat4(m_pShaderManager, g_ModelName, item.model);
+	}
+
+	if (bDepthOnly == false)
+	{
+		if (item.bUseTexture == true)
+		{
+			if (GLStateCache::BindTexture2D(item.textureSlot, m_textureIDs[item.textureSlot].ID) == true)
+			{
+				m_drawCounters.textureBinds++;
+			}
+			uniformUploads += (int)GLStateCache::SetInt(m_pShaderManager, g_TextureValueName, item.textureSlot);
+		}
+
+		if (drawIndex < 0)
+		{
+			uniformUploads += (int)GLStateCache::SetInt(m_pShaderManager, g_UseTextureName, item.bUseTexture);
+			if (item.bUseTexture == false)
+			{
+				uniformUploads += (int)GLStateCache::SetVec4(m_pShaderManager, g_ColorValueName, item.color);
+			}
+			uniformUploads += (int)GLStateCache::SetVec2(m_pShaderManager, "UVscale", item.uvScale);
+			uniformUploads += (int)GLStateCache::SetVec3(m_pShaderManager, "material.diffuseColor", item.diffuseColor);
+			uniformUploads += (int)GLStateCache::SetVec3(m_pShaderManager, "material.specularColor", item.specularColor);
+			uniformUploads += (int)GLStateCache::SetFloat(m_pShaderManager, "material.shininess", item.shininess);
+			uniformUploads += (int)GLStateCache::SetFloat(m_pShaderManager, "material.opacity", item.opacity);
+		}
+
+		// draws without a lightmap get an empty rectangle
+		glm::vec4 lightmapRect = glm::vec4(0.0f);
+		glm::mat4 lightmapTransform;
+		if ((m_bLightmapsActive == true) &&
+			(m_pLightmapBaker->GetItemLightmap(itemIndex, item, lightmapRect, lightmapTransform) == true))
+		{
+			uniformUploads += (int)GLStateCache::SetMat4(m_pShaderManager, "lightmapTransform", lightmapTransform);
+		}
+		uniformUploads += (int)GLStateCache::SetVec4(m_pShaderManager, "lightmapRect", lightmapRect);
+	}
+	m_drawCounters.uniformUploads += uniformUploads;
+
+	bool bTop = (item.meshParts & RenderQueue::PART_TOP) != 0;
+	bool bBottom = (item.meshParts & RenderQueue::PART_BOTTOM) != 0;
+	bool bSides = (item.meshParts & RenderQueue::PART_SIDES) != 0;
+
+	// the cylinders draw each of their parts separately
+	if ((item.meshShape == RenderQueue::MESH_CYLINDER) || (item.meshShape == RenderQueue::MESH_TAPERED_CYLINDER))
+	{
+		m_drawCounters.drawCalls += (int)bTop + (int)bBottom + (int)bSides;
+	}
+	else
+	{
+		m_drawCounters.drawCalls++;
+	}
+
+	switch (item.meshShape)
+	{
+	case RenderQueue::MESH_PLANE:
+		m_basicMeshes->DrawPlaneMesh();
+		break;
+	case RenderQueue::MESH_BOX:
+		m_basicMeshes->DrawBoxMesh();
+		break;
+	case RenderQueue::MESH_BOX_SIDE:
+		m_basicMeshes->DrawBoxMeshSide((ShapeMeshes::BoxSide)item.meshParts);
+		break;
+	case RenderQueue::MESH_CYLINDER:
+		m_basicMeshes->DrawCylinderMesh(bTop, bBottom, bSides);
+		break;
+	case RenderQueue::MESH_TAPERED_CYLINDER:
+		m_basicMeshes->DrawTaperedCylinderMesh(bTop, bBottom, bSides);
+		break;
+	case RenderQueue::MESH_SPHERE:
+		m_basicMeshes->DrawSphereMesh();
+		break;
+	case RenderQueue::MESH_TORUS:
+		m_basicMeshes->DrawTorusMesh();
+		break;
+	case RenderQueue::MESH_FOLIAGE:
+		// every instance of the layer in one draw call
+		if (NULL != m_pFoliageSystem)
+		{
+			uniformUploads = (int)GLStateCache::SetBool(m_pShaderManager, "bInstanced", true);
+			uniformUploads += (int)GLStateCache::SetFloat(m_pShaderManager, "swayTime", m_pFoliageSystem->GetSwayTime());
+			m_pFoliageSystem->DrawLayer(item.meshParts);
+			uniformUploads += (int)GLStateCache::SetBool(m_pShaderManager, "bInstanced", false);
+			m_drawCounters.uniformUploads += uniformUploads;
+		}
+		break;
+	}
+
+	m_pShaderManager = pSceneShaderManager;
+}
+
+/***********************************************************
+ *  DrawDepthPrepass()
+ *
+ *  This method is used for writing the depth of the opaque
+ *  draws, front-to-back and without color writes, so that
+ *  the shading pass only runs for the visible fragments.
+ ***********************************************************/
+void SceneManager::DrawDepthPrepass()
+{
+	TRACE_SCOPE("DrawDepthPrepass");
+	ShaderManager* pSceneShaderManager = m_pShaderManager;
+
+	GLStateCache::UseProgram(m_pDepthShaderManager);
+	GLStateCache::SetMat4(m_pDepthShaderManager, "view", m_viewMatrix);
+	GLStateCache::SetMat4(m_pDepthShaderManager, "projection", m_projectionMatrix);
+
+	GLStateCache::ColorMask(false);
+	GLStateCache::DepthMask(true);
+	GLStateCache::DepthFunc(GL_LESS);
+	GLStateCache::Disable(GL_BLEND);
+
+	m_pShaderManager = m_pDepthShaderManager;
+	const std::vector<int>& opaqueOrder = m_renderQueue.GetOpaqueOrder();
+	for (size_t i = 0; i < opaqueOrder.size(); i++)
+	{
+		DrawQueuedItem(opaqueOrder[i], true);
+	}
+	m_pShaderManager = pSceneShaderManager;
+
+	GLStateCache::ColorMask(true);
+	GLStateCache::UseProgram(m_pShaderManager);
+}
+
+/***********************************************************
+ *  DrawShadingPasses()
+ *
+ *  This method is used for issuing the recorded draws with
+ *  the lighting shader.  In source order every draw is
+ *  blended in the order it was recorded.  Sorted, the opaque
+ *  draws go front-to-back with blending off, then the
+ *  transparent draws back-to-front with depth writes off.
+ ***********************************************************/
+void SceneManager::DrawShadingPasses()
+{
+	TRACE_SCOPE("DrawShadingPasses");
+	// the light clusters, the lightmaps and the texture streamer
+	// select units behind the state cache's back
+	GLStateCache::InvalidateTextures();
+
+	// the lights, the shadow settings and the camera of the frame
+	// are set on the uber shader only
+	if ((NULL != m_pShaderPermutations) && (m_bShaderPermutations == true))
+	{
+		m_pShaderPermutations->SyncUniforms();
+	}
+
+	// after a pre-pass the opaque depth is already complete
+	GLStateCache::DepthFunc(m_bDepthPrepass ? GL_LEQUAL : GL_LESS);
+	GLStateCache::DepthMask(!m_bDepthPrepass);
+
+	if (m_renderPath == RenderQueue::PATH_SOURCE_ORDER)
+	{
+		GLStateCache::Enable(GL_BLEND);
+		for (int i = 0; i < m_renderQueue.GetItemCount(); i++)
+		{
+			DrawQueuedItem(i, false);
+		}
+	}
+	else
+	{
+		GLStateCache::Disable(GL_BLEND);
+		const std::vector<int>& opaqueOrder = m_renderQueue.GetOpaqueOrder();
+		for (size_t i = 0; i < opaqueOrder.size(); i++)
+		{
+			DrawQueuedItem(opaqueOrder[i], false);
+		}
+
+		GLStateCache::Enable(GL_BLEND);
+		GLStateCache::DepthFunc(GL_LESS);
+		GLStateCache::DepthMask(false);
+		const std::vector<int>& transparentOrder = m_renderQueue.GetTransparentOrder();
+		for (size_t i = 0; i < transparentOrder.size(); i++)
+		{
+			DrawQueuedItem(transparentOrder[i], false);
+		}
+	}
+
+	// leave the default state for anything drawn afterwards
+	GLStateCache::UseProgram(m_pShaderManager);
+	GLStateCache::Disable(GL_BLEND);
+	GLStateCache::DepthFunc(GL_LESS);
+	GLStateCache::DepthMask(true);
+}
+
+/***********************************************************
+ *  DrawQueuedItem()
+ *
+ *  This method is used for drawing one item of the render
+ *  queue.  Items hidden on the previous frame are skipped,
+ *  and items whose query result has not come back yet are
+ *  drawn under conditional rendering.
+ ***********************************************************/
+void SceneManager::DrawQueuedItem(int index, bool bDepthOnly)
+{
+	OcclusionCuller::ITEM_VISIBILITY visibility = OcclusionCuller::ITEM_VISIBLE;
+	if ((NULL != m_pOcclusionCuller) && (m_bOcclusionCulling == true))
+	{
+		visibility = m_pOcclusionCuller->GetVisibility(index);
+	}
+
+	if (visibility == OcclusionCuller::ITEM_OCCLUDED)
+	{
+		return;
+	}
+
+	int drawIndex = (NULL != m_pDrawDataRing) ? m_pDrawDataRing->GetDrawIndex(index) : -1;
+
+	if (visibility == OcclusionCuller::ITEM_CONDITIONAL)
+	{
+		m_pOcclusionCuller->BeginConditional(index);
+		DrawItem(m_renderQueue.GetItem(index), bDepthOnly, drawIndex, index);
+		m_pOcclusionCuller->EndConditional();
+	}
+	else
+	{
+		DrawItem(m_renderQueue.GetItem(index), bDepthOnly, drawIndex, index);
+	}
+}
+
+/***********************************************************
+ *  DrawOcclusionQueries()
+ *
+ *  This method is used for testing the bounding box of every
+ *  queued item against the finished depth buffer.  The
+ *  results decide which items are drawn on the next frame.
+ ***********************************************************/
+void SceneManager::DrawOcclusionQueries()
+{
+	TRACE_SCOPE("DrawOcclusionQueries");
+	glm::vec3 cameraPosition = glm::vec3(glm::inverse(m_viewMatrix)[3]);
+
+	GLStateCache::UseProgram(m_pDepthShaderManager);
+	GLStateCache::SetMat4(m_pDepthShaderManager, "view", m_viewMatrix);
+	GLStateCache::SetMat4(m_pDepthShaderManager, "projection", m_projectionMatrix);
+	// the boxes are placed through the model uniform
+	GLStateCache::SetBool(m_pDepthShaderManager, "bUseDrawData", false);
+
+	m_pOcclusionCuller->BeginQueries();
+	for (int i = 0; i < m_renderQueue.GetItemCount(); i++)
+	{
+		const RenderQueue::DRAW_ITEM& item = m_renderQueue.GetItem(i);
+		glm::mat4 boundsModel = item.model * GetMeshBounds(item.meshShape);
+
+		// the camera inside the box would clip its front faces
+		glm::vec3 localCamera = glm::vec3(glm::inverse(boundsModel) * glm::vec4(cameraPosition, 1.0f));
+		if ((glm::abs(localCamera.x) <= 0.5f) && (glm::abs(localCamera.y) <= 0.5f) && (glm::abs(localCamera.z) <= 0.5f))
+		{
+			m_pOcclusionCuller->ForceVisible(i);
+			continue;
+		}
+
+		if (m_pOcclusionCuller->BeginQuery(i) == true)
+		{
+			GLStateCache::SetMat4(m_pDepthShaderManager, g_ModelName, boundsModel);
+			m_basicMeshes->DrawBoxMesh();
+			m_pOcclusionCuller->EndQuery();
+		}
+	}
+	m_pOcclusionCuller->EndQueries();
+
+	GLStateCache::UseProgram(m_pShaderManager);
+}
+
+// --- Helper Functions---
+
+// --- Book Helper Functions ---
+void SceneManager::DrawBook(const glm::vec3& position, const glm::vec3& scale, const glm::vec4& color) {
+	SetShaderColor(color.r, color.g, color.b, color.a);
+	SetTransformations(scale, 0.0f, 0.0f, 0.0f, position);
+	SubmitMesh(RenderQueue::MESH_BOX);
+}
+
+// Gray book (bottom)
+void SceneManager::DrawGrayBook(const glm::vec3& basePosition, float deskHeight) {
+	SetShaderMaterial("gray_book");
+	glm::vec3 bookScale = glm::vec3(10.5f, 2.5f, 4.5f); // Width, height, depth
+	glm::vec3 bookPosition = glm::vec3(basePosition.x, deskHeight + bookScale.y / 2.0f, basePosition.z + 0.2f);
+	glm::vec4 bookColor = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f); // Gray
+	DrawBook(bookPosition, bookScale, bookColor);
+}
+
+// Black book (middle)
+void SceneManager::DrawBlackBook(const glm::vec3& basePosition, float deskHeight) {
+	SetShaderMaterial("black_book");
+	glm::vec3 grayBookScale = glm::vec3(10.5f, 2.5f, 4.5f); // Gray book scale for positioning
+	glm::vec3 blackBookScale = glm::vec3(9.5f, 1.25f, 4.0f); // Slightly smaller
+	glm::vec3 grayBookPosition = glm::vec3(basePosition.x, deskHeight + grayBookScale.y / 2.0f, basePosition.z + 0.2f);
+	glm::vec3 blackBookPosition = grayBookPosition + glm::vec3(0.2f, grayBookScale.y / 2.0f + blackBookScale.y / 2.0f, -0.2f); // On top of gray book
+	glm::vec4 bookColor = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f); // Black (or very dark gray)
+	DrawBook(blackBookPosition, blackBookScale, bookColor);
+}
+
+// Light blue book (top)
+void SceneManager::DrawLightBlueBook(const glm::vec3& basePosition, float deskHeight) {
+	SetShaderMaterial("light_blue_book");
+	glm::vec3 grayBookScale = glm::vec3(10.5f, 2.5f, 4.5f); // Gray book scale
+	glm::vec3 blackBookScale = glm::vec3(9.5f, 1.25f, 4.0f); // Black book scale
+	glm::vec3 lightBlueBookScale = glm::vec3(9.0f, 1.25f, 3.5f); // Slightly smaller again
+	glm::vec3 grayBookPosition = glm::vec3(basePosition.x, deskHeight + grayBookScale.y / 2.0f, basePosition.z + 0.2f);
+	glm::vec3 blackBookPosition = grayBookPosition + glm::vec3(0.2f, grayBookScale.y / 2.0f + blackBookScale.y / 2.0f, -0.2f); // On top of gray book
+	glm::vec3 lightBlueBookPosition = blackBookPosition + glm::vec3(-0.2f, blackBookScale.y / 2.0f + lightBlueBookScale.y / 2.0f, 0.2f); // On top of black, offset
+	glm::vec4 bookColor = glm::vec4(0.4f, 0.6f, 0.8f, 1.0f); // Light blue
+	DrawBook(lightBlueBookPosition, lightBlueBookScale, bookColor);
+}
+
+
+
+// --- Monitor Helper Functions ---
+
+void SceneManager::DrawMonitorBezel(const glm::vec3& position, const glm::vec3& scale, const glm::vec4& color)
+{
+	SetShaderColor(color.r, color.g, color.b, color.a);
+	SetTransformations(scale, 0.0f, 0.0f, 0.0f, position);
+	SubmitMesh(RenderQueue::MESH_BOX);
+}
+
+void SceneManager::DrawMonitorScreen(const glm::vec3& position, const glm::vec3& scale)
+{
+	SetShaderColor(1.0f, 1.0f, 1.0f, 1.0f); // White screen
+	SetTransformations(scale, 0.0f, 0.0f, 0.0f, position);
+	SubmitMesh(RenderQueue::MESH_BOX);
+}
+
+
+void SceneManager::DrawMonitorStand(const glm::vec3& basePosition)
+{
+	// Stand Base
+	glm::vec3 scaleXYZ = glm::vec3(7.0f, 0.3f, 5.0f);
+	glm::vec3 positionXYZ = glm::vec3(basePosition.x, 0.15f, basePosition.z - 2.0f); //Relative to the base position.
+	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
+	SetShaderColor(0.82f, 0.82f, 0.82f, 1.0f);
+	SubmitMesh(RenderQueue::MESH_BOX);
+
+	// Stand Arm (22.5 forward tilt)
+	const float armLength = 8.2f;
+	scaleXYZ = glm::vec3(0.8f, armLength, 0.8f);
+	positionXYZ = glm::vec3(basePosition.x, 0.15f, basePosition.z - 3.6f); //Relative to the base position
+	SetTransformations(scaleXYZ, 22.5f, 0.0f, 0.0f, positionXYZ);
+	SubmitMesh(RenderQueue::MESH_TAPERED_CYLINDER);
+
+	// Connection Point (Hidden)
+	scaleXYZ = glm::vec3(1.8f, 0.5f, 0.8f);
+	positionXYZ = glm::vec3(basePosition.x, basePosition.y + 3.45f, basePosition.z - 0.5f);  //Relative to the base position
+	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
+	SetShaderColor(0.08f, 0.08f, 0.08f, 1.0f);
+	SubmitMesh(RenderQueue::MESH_BOX);
+}
+
+
+void SceneManager::DrawMonitor(float deskHeight)
+{
+	const float monitorWidth = 18.0f;
+	const float totalHeight = 12.0f;
+	const float silverBezelHeight = 2.5f;
+	const float blackBezelThickness = 0.6f;
+	const float screenDepth = 0.05f;
+	const float monitorBaseY = deskHeight + 4.0f; // Base Y-position (raised above desk)
+	const float blackBezelHeight = 0.5f; // Black bezel between silver and screen
+
+	glm::vec3 basePosition(0.0f, monitorBaseY, -1.0f); // added a base position for the whole monitor
+
+	// --- Draw the monitor components ---
+
+	// Black Bezel - Top
+	DrawMonitorBezel(
+		glm::vec3(basePosition.x, basePosition.y + totalHeight - blackBezelThickness / 2, basePosition.z),
+		glm::vec3(monitorWidth, blackBezelThickness, 0.2f),
+		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+	);
+
+	// Black Bezel - Left
+	DrawMonitorBezel(
+		glm::vec3(basePosition.x - monitorWidth / 2 + blackBezelThickness / 2, basePosition.y + totalHeight / 2, basePosition.z),
+		glm::vec3(blackBezelThickness, totalHeight, 0.2f),
+		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+	);
+
+	// Black Bezel - Right
+	DrawMonitorBezel(
+		glm::vec3(basePosition.x + monitorWidth / 2 - blackBezelThickness / 2, basePosition.y + totalHeight / 2, basePosition.z),
+		glm::vec3(blackBezelThickness, totalHeight, 0.2f),
+		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+	);
+
+	// Silver Bezel (Chin)
+	DrawMonitorBezel(
+		glm::vec3(basePosition.x, basePosition.y + silverBezelHeight / 2, basePosition.z + 0.05f),
+		glm::vec3(monitorWidth, silverBezelHeight, 0.3f),
+		glm::vec4(0.09f, 0.09f, 0.09f, 1.0f) 
+	);
+
+	// Black Bezel (Between silver and screen)
 	DrawMonitorBezel(
 		glm::vec3(basePosition.x, basePosition.y + silverBezelHeight + blackBezelHeight / 2, basePosition.z),
 		glm::vec3(monitorWidth, blackBezelHeight, 0.2f),
@@ -810,7 +2394,7 @@ void SceneManager::DrawVaseBase(const glm::vec3& basePosition) {
 	SetShaderTexture("glass");
 	SetShaderMaterial("glass");
 	SetTransformations(glm::vec3(2.0f, 1.2f, 2.0f), 0.0f, 0.0f, 0.0f, basePosition);
-	m_basicMeshes->DrawSphereMesh();
+	SubmitMesh(RenderQueue::MESH_SPHERE);
 }
 
 void SceneManager::DrawVaseNeck(const glm::vec3& basePosition) {
@@ -819,7 +2403,7 @@ void SceneManager::DrawVaseNeck(const glm::vec3& basePosition) {
 	// Corrected: Base + base half-height + neck half-height.
 	glm::vec3 neckPosition = basePosition + glm::vec3(0.0f, 0.8f, 0.0f);
 	SetTransformations(glm::vec3(1.5f, 2.2f, 1.5f), 0.0f, 0.0f, 0.0f, neckPosition);
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	SubmitMesh(RenderQueue::MESH_TAPERED_CYLINDER);
 }
 
 void SceneManager::DrawVaseOpening(const glm::vec3& basePosition) {
@@ -827,10 +2411,10 @@ void SceneManager::DrawVaseOpening(const glm::vec3& basePosition) {
 	glm::vec3 neckPosition = basePosition + glm::vec3(0.0f, 0.8f , 0.0f); // Use calculated neck position
 	glm::vec3 openingPosition = neckPosition + glm::vec3(0.0f, 1.1f + 1.0f, 0.0f); 
 	SetTransformations(glm::vec3(0.75f, 2.0f, 0.75f), 0.0f, 0.0f, 0.0f, openingPosition);
-	m_basicMeshes->DrawCylinderMesh(false, false); // Sides
+	SubmitMesh(RenderQueue::MESH_CYLINDER, RenderQueue::PART_SIDES); // Sides
 	SetShaderTexture("glass"); // Texture for top and bottom
-	m_basicMeshes->DrawCylinderMesh(true, false, false); // Top
-	m_basicMeshes->DrawCylinderMesh(false, true, false); // Bottom
+	SubmitMesh(RenderQueue::MESH_CYLINDER, RenderQueue::PART_TOP); // Top
+	SubmitMesh(RenderQueue::MESH_CYLINDER, RenderQueue::PART_BOTTOM); // Bottom
 }
 
 void SceneManager::DrawVaseRim(const glm::vec3& basePosition) {
@@ -839,7 +2423,7 @@ void SceneManager::DrawVaseRim(const glm::vec3& basePosition) {
 	glm::vec3 neckPosition = basePosition + glm::vec3(0.0f, 1.8f, 0.0f); // Use calculated neck position
 	glm::vec3 rimPosition = neckPosition + glm::vec3(0.0f, 1.1f + 2.0f, 0.0f); 
 	SetTransformations(glm::vec3(0.9f, 0.9f, 0.5f), 90.0f, 0.0f, 0.0f, rimPosition);
-	m_basicMeshes->DrawTorusMesh();
+	SubmitMesh(RenderQueue::MESH_TORUS);
 }
 
 void SceneManager::DrawBrownStems(const glm::vec3& basePosition) {
@@ -858,7 +2442,7 @@ void SceneManager::DrawBrownStems(const glm::vec3& basePosition) {
 
 	for (const auto& offset : stemOffsets) {
 		SetTransformations(glm::vec3(0.1f, 0.1f, 1.5f), -90.0f, 25.0f, 10.0f, rimPosition + offset);
-		m_basicMeshes->DrawTaperedCylinderMesh();
+		SubmitMesh(RenderQueue::MESH_TAPERED_CYLINDER);
 	}
 }
 
@@ -866,24 +2450,12 @@ void SceneManager::DrawBeigePuffs(const glm::vec3& basePosition) {
 	SetShaderTexture("beige_puff");
 	SetShaderMaterial("beige_puff");
 
-	const float rimRadius = 1.0f;
-	const int puffCount = 24;
 	glm::vec3 neckPosition = basePosition + glm::vec3(0.0f, 1.2f + 1.1f, 0.0f); // Use calculated neck position
 	glm::vec3 rimPosition = neckPosition + glm::vec3(0.0f, 1.1f + 2.0f, 0.0f);
 
-	for (int i = 0; i < puffCount; ++i) {
-		float angle = glm::radians(360.0f * i / puffCount);
-		float spread = 0.8f + 0.4f * (i % 3);
-
-		glm::vec3 puffPosition = glm::vec3(
-			rimPosition.x + rimRadius * spread * cos(angle),
-			rimPosition.y + 0.3f + 0.5f * (i % 4),
-			rimPosition.z + rimRadius * spread * sin(angle)
-		);
-
-		SetTransformations(glm::vec3(0.25f, 0.25f, 0.8f), 0.0f, glm::degrees(angle) + 90.0f, 0.0f, puffPosition);
-		m_basicMeshes->DrawSphereMesh();
-	}
+	// the puffs are instances around the rim, placed by the foliage system
+	SetTransformations(glm::vec3(1.0f), 0.0f, 0.0f, 0.0f, rimPosition);
+	SubmitMesh(RenderQueue::MESH_FOLIAGE, FoliageSystem::LAYER_PUFFS);
 }
 
 void SceneManager::DrawGreenBranches(const glm::vec3& basePosition) {
@@ -911,13 +2483,13 @@ void SceneManager::DrawGreenBranches(const glm::vec3& basePosition) {
 
 		// Main branch
 		SetTransformations(glm::vec3(0.06f, 0.06f, 2.5f), -90.0f, yRot, zRot, rimPosition + pos);
-		m_basicMeshes->DrawTaperedCylinderMesh();
+		SubmitMesh(RenderQueue::MESH_TAPERED_CYLINDER);
 
 		// Sub-branches
 		for (int i = 0; i < 3; ++i) {
 			glm::vec3 subPos = rimPosition + pos + glm::vec3((i + 1) * 0.2f, 1.0f + (i * 0.8f), (i + 1) * 0.2f);
 			SetTransformations(glm::vec3(0.04f, 0.04f, 1.5f), -90.0f, yRot + 25.0f, zRot + 20.0f, subPos);
-			m_basicMeshes->DrawCylinderMesh();
+			SubmitMesh(RenderQueue::MESH_CYLINDER);
 
 			// Flowers on sub-branches
 			SetShaderTexture("white_flower");
@@ -925,7 +2497,7 @@ void SceneManager::DrawGreenBranches(const glm::vec3& basePosition) {
 			for (int j = 0; j < 2; ++j) {
 				glm::vec3 flowerPos = subPos + glm::vec3(0.1f * j, 0.5f + 0.4f * j, 0.1f * j);
 				SetTransformations(glm::vec3(0.1f), 0.0f, 0.0f, 0.0f, flowerPos);
-				m_basicMeshes->DrawSphereMesh();
+				SubmitMesh(RenderQueue::MESH_SPHERE);
 			}
 			SetShaderTexture("green_stem"); //reset texture
 			SetShaderMaterial("green_stem"); //reset material
@@ -937,45 +2509,13 @@ void SceneManager::DrawWhiteFlowers(const glm::vec3& basePosition) {
 	SetShaderTexture("white_flower");
 	SetShaderMaterial("white_flower");
 
-	const std::vector<glm::vec3> flowerOffsets = {
-		glm::vec3(0.1f, 0.2f, 0.1f),  glm::vec3(-0.15f, 0.3f, -0.1f),
-		glm::vec3(0.0f, 0.4f, 0.2f),  glm::vec3(-0.2f, 0.25f, 0.15f),
-		glm::vec3(0.15f, 0.35f, -0.2f), glm::vec3(-0.1f, 0.4f, -0.15f)
-	};
-	// Clusters
-	const std::vector<glm::vec3> flowerClusters = {
-	  glm::vec3(0.5f, 1.3f,  0.4f),
-	  glm::vec3(-0.6f, 1.6f, -0.3f),
-	  glm::vec3(0.3f, 2.2f, -0.5f),
-	  glm::vec3(-0.4f, 1.9f,  0.2f),
-	  glm::vec3(0.2f, 2.1f,  0.3f)
-	};
-
 	glm::vec3 neckPosition = basePosition + glm::vec3(0.0f, 1.2f + 1.1f, 0.0f); // Use calculated neck position
 	glm::vec3 rimPosition = neckPosition + glm::vec3(0.0f, 1.1f + 2.0f, 0.0f);
 
-	for (const auto& clusterBase : flowerClusters) {
-		for (int i = 0; i < 3; ++i) {
-			const auto& offset = flowerOffsets[i % flowerOffsets.size()];
-			glm::vec3 flowerPos = rimPosition + clusterBase + offset * glm::vec3(i + 1, 0.8f, (i % 2) ? -1.0f : 1.0f);
-			glm::vec3 flowerScale = glm::vec3(0.1f) * (0.9f + 0.2f * (i % 3));
-			SetTransformations(flowerScale, 0.0f, 30.0f * (i % 4), 15.0f * (i % 2), flowerPos);
-			m_basicMeshes->DrawSphereMesh();
-		}
-	}
-
-	// Scattered flowers
-	const std::vector<glm::vec3> scatteredFlowers = {
-	  glm::vec3(0.4f, 1.7f,  0.5f), glm::vec3(-0.3f, 2.0f, -0.4f),
-	  glm::vec3(0.15f, 1.8f,  0.6f), glm::vec3(-0.5f, 1.9f,  0.3f),
-	  glm::vec3(0.25f, 2.3f, -0.2f),glm::vec3(-0.2f, 2.1f,  0.4f)
-	};
-
-	for (size_t i = 0; i < scatteredFlowers.size(); ++i) {
-		glm::vec3 scale = glm::vec3(0.1f) * (0.85f + 0.1f * i);
-		SetTransformations(scale, 10.0f * (i % 3), 45.0f * (i % 4), 5.0f * (i % 2), rimPosition + scatteredFlowers[i]);
-		m_basicMeshes->DrawSphereMesh();
-	}
+	// the flower clusters are instances over the rim, placed by the
+	// foliage system
+	SetTransformations(glm::vec3(1.0f), 0.0f, 0.0f, 0.0f, rimPosition);
+	SubmitMesh(RenderQueue::MESH_FOLIAGE, FoliageSystem::LAYER_FLOWERS);
 }
 
 void SceneManager::DrawKeyboard(float deskHeight) {
@@ -1018,15 +2558,15 @@ void SceneManager::DrawKeyboard(float deskHeight) {
 	SetTransformations(scale, 0.0f, 0.0f, 0.0f, position);
 
 	// 5. Draw ONLY the top face.
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::box_top);
+	SubmitMesh(RenderQueue::MESH_BOX_SIDE, ShapeMeshes::BoxSide::box_top);
 
 	// --- Draw the other faces ---
 	
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::box_back);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::box_bottom);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::box_left);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::box_right);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::box_front);
+	SubmitMesh(RenderQueue::MESH_BOX_SIDE, ShapeMeshes::BoxSide::box_back);
+	SubmitMesh(RenderQueue::MESH_BOX_SIDE, ShapeMeshes::BoxSide::box_bottom);
+	SubmitMesh(RenderQueue::MESH_BOX_SIDE, ShapeMeshes::BoxSide::box_left);
+	SubmitMesh(RenderQueue::MESH_BOX_SIDE, ShapeMeshes::BoxSide::box_right);
+	SubmitMesh(RenderQueue::MESH_BOX_SIDE, ShapeMeshes::BoxSide::box_front);
 }
 
 void SceneManager::DrawMouse(float deskHeight) {
@@ -1039,7 +2579,7 @@ void SceneManager::DrawMouse(float deskHeight) {
 	glm::vec3 position = glm::vec3(8.0f, deskHeight + scale.y / 2.0f, -1.0f); // Adjust X and Z as needed.
 
 	SetTransformations(scale, 0.0f, 0.0f, 0.0f, position); // Apply scale and position
-	m_basicMeshes->DrawSphereMesh(); // Draw the elongated sphere.
+	SubmitMesh(RenderQueue::MESH_SPHERE); // Draw the elongated sphere.
 }
 
 void SceneManager::DrawTeacup(float deskHeight) {
@@ -1049,14 +2589,14 @@ void SceneManager::DrawTeacup(float deskHeight) {
 	glm::vec3 bottomScale = glm::vec3(1.5f, 0.5f, 1.5f); // Flatten the sphere on the Y-axis
 	glm::vec3 bottomPosition = glm::vec3(12.0f, deskHeight + 0.15f + bottomScale.y, 1.0f); //Position above desk
 	SetTransformations(bottomScale, 0.0f, 0.0f, 0.0f, bottomPosition);
-	m_basicMeshes->DrawSphereMesh();  
+	SubmitMesh(RenderQueue::MESH_SPHERE);  
 
 	// --- 2. Body (Cylinder) ---
 	glm::vec3 bodyScale = glm::vec3(1.5f, 1.0f, 1.5f); // Diameter and height of the cylinder.
 	// Position the cylinder *on top* of the half-sphere:
 	glm::vec3 bodyPosition = glm::vec3(12.0f, deskHeight + 0.15f + bottomScale.y + (bodyScale.y / 2.0), 1.0f);
 	SetTransformations(bodyScale, 0.0f, 0.0f, 0.0f, bodyPosition);
-	m_basicMeshes->DrawCylinderMesh(true, false); // Draw only sides
+	SubmitMesh(RenderQueue::MESH_CYLINDER, RenderQueue::PART_TOP | RenderQueue::PART_SIDES); // Draw only sides
 }
 void SceneManager::DrawSaucer(float deskHeight) {
 	SetShaderMaterial("saucer");
@@ -1065,14 +2605,14 @@ void SceneManager::DrawSaucer(float deskHeight) {
 	glm::vec3 topScale = glm::vec3(3.0f, 0.4f, 3.0f); // Wider and flatter than teacup bottom
 	glm::vec3 topPosition = glm::vec3(12.0f, deskHeight + 0.15f, 1.0f); // Adjust position
 	SetTransformations(topScale, 0.0f, 0.0f, 0.0f, topPosition);
-	m_basicMeshes->DrawSphereMesh();
+	SubmitMesh(RenderQueue::MESH_SPHERE);
 
 	// --- 2. Base (Flattened Cylinder) ---
 	glm::vec3 baseScale = glm::vec3(1.5f, 0.2f, 1.5f);  // Smaller diameter, very thin
 	// Position *under* the half-sphere:
 	glm::vec3 basePosition = glm::vec3(12.0f, deskHeight + 0.15f, 1.0f);
 	SetTransformations(baseScale, 0.0f, 0.0f, 0.0f, basePosition);
-	m_basicMeshes->DrawCylinderMesh(); //draw all parts of the cylinder
+	SubmitMesh(RenderQueue::MESH_CYLINDER); //draw all parts of the cylinder
 }
 
 void SceneManager::DrawOrganizer(float deskHeight) {
@@ -1088,14 +2628,14 @@ void SceneManager::DrawOrganizer(float deskHeight) {
 	glm::vec3 basePosition = glm::vec3(18.0f, deskHeight + baseHeight / 2.0f, 2.0f); 
 
 	SetTransformations(baseScale, 0.0f, 0.0f, 0.0f, basePosition);
-	m_basicMeshes->DrawBoxMesh();  // Draw the base
+	SubmitMesh(RenderQueue::MESH_BOX);  // Draw the base
 
 	// --- Back Panel ---
 	float backHeight = 10.0f; // Height of the back panel
 	glm::vec3 backScale = glm::vec3(baseWidth, backHeight, 0.2f); // Thin back panel
 	glm::vec3 backPosition = glm::vec3(basePosition.x, deskHeight + baseHeight + backHeight / 2.0f, basePosition.z - baseDepth / 2.0f + 0.1f); //Behind the base
 	SetTransformations(backScale, 0.0f, 0.0f, 0.0f, backPosition);
-	m_basicMeshes->DrawBoxMesh();
+	SubmitMesh(RenderQueue::MESH_BOX);
 
 	// --- Side Panels (Left and Right) ---
 	float sideHeight = 10.0f;
@@ -1103,11 +2643,11 @@ void SceneManager::DrawOrganizer(float deskHeight) {
 	// Left
 	glm::vec3 leftSidePosition = glm::vec3(basePosition.x - baseWidth / 2.0f + 0.1f, deskHeight + baseHeight + sideHeight / 2.0f, basePosition.z);
 	SetTransformations(sideScale, 0.0f, 0.0f, 0.0f, leftSidePosition);
-	m_basicMeshes->DrawBoxMesh();
+	SubmitMesh(RenderQueue::MESH_BOX);
 	//Right
 	glm::vec3 rightSidePosition = glm::vec3(basePosition.x + baseWidth / 2.0f - 0.1f, deskHeight + baseHeight + sideHeight / 2.0f, basePosition.z);
 	SetTransformations(sideScale, 0.0f, 0.0f, 0.0f, rightSidePosition);
-	m_basicMeshes->DrawBoxMesh();
+	SubmitMesh(RenderQueue::MESH_BOX);
 
 	// --- Shelves and Dividers ---
 	float shelfThickness = 0.2f;
@@ -1120,20 +2660,446 @@ void SceneManager::DrawOrganizer(float deskHeight) {
 		glm::vec3 shelfScale = glm::vec3(baseWidth - 0.4f, shelfThickness, dividerDepth); // Slightly smaller than base
 		glm::vec3 shelfPosition = glm::vec3(basePosition.x, deskHeight + baseHeight + (i + 1) * shelfSpacing, basePosition.z - 0.25f);
 		SetTransformations(shelfScale, 0.0f, 0.0f, 0.0f, shelfPosition);
-		m_basicMeshes->DrawBoxMesh();
+		SubmitMesh(RenderQueue::MESH_BOX);
 
 		// Lip (Front edge of the shelf)
 		glm::vec3 lipScale = glm::vec3(baseWidth - 0.4f, lipHeight, 0.2f);
 		glm::vec3 lipPosition = glm::vec3(basePosition.x, deskHeight + baseHeight + (i + 1) * shelfSpacing + lipHeight / 2.0f - shelfThickness / 2.0f, basePosition.z + dividerDepth / 2.0f - 0.1f); // Front edge
 		SetTransformations(lipScale, 0.0f, 0.0f, 0.0f, lipPosition);
-		m_basicMeshes->DrawBoxMesh();
+		SubmitMesh(RenderQueue::MESH_BOX);
 	}
 }
 
 // --- RenderScene Function ---
 
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene - the draw
+ *  calls are recorded first, the shadow map is brought up to
+ *  date and the point lights are assigned to clusters, then
+ *  the recorded draws are issued with the lighting shader and
+ *  their bounding boxes are tested for the next frame.  With
+ *  a scene grid, the recorded desk is expanded into the draws
+ *  of every visible grid cell before anything else uses the
+ *  queue.  The CPU time of every phase is measured, and the
+ *  whole scene is bracketed by GPU timestamps.
+ ***********************************************************/
 void SceneManager::RenderScene() {
-		// declare the variables for the transformations
+	MEMORY_PHASE("RenderScene");
+	TRACE_SCOPE("RenderScene");
+
+	// the triangle count comes back from the query of an earlier
+	// frame, so it carries over until a newer result is read
+	uint64_t triangles = m_drawCounters.triangles;
+	m_drawCounters = DRAW_COUNTERS();
+	m_drawCounters.triangles = triangles;
+
+	CollectFrameTimers();
+	if (m_timerQueryIDs[0][0] == 0)
+	{
+		for (int i = 0; i < TIMER_FRAMES; i++)
+		{
+			glGenQueries(2, m_timerQueryIDs[i]);
+			glGenQueries(1, &m_primitiveQueryIDs[i]);
+		}
+	}
+
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	// upload the next texture mipmaps within the frame's budget
+	m_pTextureStreamer->Update();
+
+	RecordSceneDraws();
+	double recordedTime = TraceProfiler::NowMilliseconds();
+
+	// the software frame issues none of the queries below, so it
+	// returns before a timer slot is taken
+	if ((NULL != m_pSoftwareRasterizer) && (m_bSoftwareRaster == true))
+	{
+		RenderSoftware(startTime, recordedTime);
+		return;
+	}
+
+	// a slot whose result has not come back yet is skipped, and
+	// that frame simply goes unmeasured
+	bool bTimerStarted = !m_bTimerPending[m_timerIndex];
+	if (bTimerStarted == true)
+	{
+		glQueryCounter(m_timerQueryIDs[m_timerIndex][0], GL_TIMESTAMP);
+	}
+
+	PrepareShadowMap();
+	double shadowTime = TraceProfiler::NowMilliseconds();
+
+	UpdatePointLights();
+	double lightTime = TraceProfiler::NowMilliseconds();
+
+	UploadSortedDraws();
+	double sortedTime = TraceProfiler::NowMilliseconds();
+
+	bool bOcclusionCulling = (NULL != m_pOcclusionCuller) && (m_bOcclusionCulling == true);
+	if (bOcclusionCulling == true)
+	{
+		// the grid cells come and go with the camera, so the grid
+		// draws are keyed by their cell and recorded draw; the
+		// recorded desk keeps its order from frame to frame
+		int keyCount = m_renderQueue.GetItemCount();
+		if (m_sceneGenerator.IsActive() == true)
+		{
+			m_sceneGenerator.GetItemKeys(m_occlusionKeys);
+			keyCount = m_sceneGenerator.GetItemKeyCount();
+		}
+		else
+		{
+			m_occlusionKeys.resize(keyCount);
+			for (int i = 0; i < keyCount; i++)
+			{
+				m_occlusionKeys[i] = i;
+			}
+		}
+		m_pOcclusionCuller->BeginFrame(m_occlusionKeys, keyCount);
+	}
+
+	if (bTimerStarted == true)
+	{
+		glBeginQuery(GL_PRIMITIVES_GENERATED, m_primitiveQueryIDs[m_timerIndex]);
+	}
+	m_renderQueue.BeginFrameQuery();
+	if ((m_bDepthPrepass == true) && (NULL != m_pDepthShaderManager))
+	{
+		DrawDepthPrepass();
+	}
+	m_renderQueue.BeginShadingQuery();
+	DrawShadingPasses();
+	if (NULL != m_pDrawDataRing)
+	{
+		m_pDrawDataRing->EndFrame();
+	}
+	m_renderQueue.EndFrameQuery();
+	if (bTimerStarted == true)
+	{
+		glEndQuery(GL_PRIMITIVES_GENERATED);
+	}
+	double submittedTime = TraceProfiler::NowMilliseconds();
+
+	// the box queries are timed separately to show their overhead
+	if (bOcclusionCulling == true)
+	{
+		DrawOcclusionQueries();
+	}
+	double endTime = TraceProfiler::NowMilliseconds();
+
+	if (bTimerStarted == true)
+	{
+		glQueryCounter(m_timerQueryIDs[m_timerIndex][1], GL_TIMESTAMP);
+		m_bTimerPending[m_timerIndex] = true;
+	}
+	m_timerIndex = (m_timerIndex + 1) % TIMER_FRAMES;
+
+	m_drawCounters.culledObjects = m_sceneGenerator.IsActive() ? m_sceneGenerator.GetStats().culledItems : 0;
+	if (bOcclusionCulling == true)
+	{
+		m_drawCounters.culledObjects += m_pOcclusionCuller->GetStats().occludedCount;
+	}
+
+	m_frameTiming.itemCount = m_renderQueue.GetItemCount();
+	m_frameTiming.recordMilliseconds = recordedTime - startTime;
+	m_frameTiming.shadowMilliseconds = shadowTime - recordedTime;
+	m_frameTiming.lightMilliseconds = lightTime - shadowTime;
+	m_frameTiming.sortMilliseconds = sortedTime - lightTime;
+	m_frameTiming.submitMilliseconds = submittedTime - sortedTime;
+	m_frameTiming.queryMilliseconds = endTime - submittedTime;
+	m_frameTiming.totalMilliseconds = endTime - startTime;
+	AccumulateFrameTiming();
+}
+
+/***********************************************************
+ *  RecordSceneDraws()
+ *
+ *  This method is used for recording the draws of the scene
+ *  into the queue.  With a scene grid the recorded desk is
+ *  expanded into the draws of every visible grid cell.  The
+ *  shadow map does not depend on the camera, so only the grid
+ *  layout and the light volume are added to the scene
+ *  signature, not the visible cells.
+ ***********************************************************/
+void SceneManager::RecordSceneDraws()
+{
+	m_renderQueue.Clear();
+	m_frameSceneSignature = FNV_OFFSET_BASIS;
+	m_propFirstItems.clear();
+	DrawSceneObjects();
+
+	m_frameTiming.cullMilliseconds = 0.0;
+	m_shadowBoundsCenter = g_SceneBoundsCenter;
+	m_shadowBoundsRadius = g_SceneBoundsRadius;
+	if (m_sceneGenerator.IsActive() == true)
+	{
+		m_sceneGenerator.Expand(m_renderQueue, m_propFirstItems, m_projectionMatrix * m_viewMatrix);
+		m_frameTiming.cullMilliseconds = m_sceneGenerator.GetStats().cullMilliseconds;
+
+		// the cell transforms follow from the layout and the seed,
+		// and the desk transforms are already in the signature
+		unsigned int gridLayout[3] = {
+			(unsigned int)m_sceneGenerator.GetColumns(),
+			(unsigned int)m_sceneGenerator.GetRows(),
+			m_sceneGenerator.GetSeed() };
+		m_frameSceneSignature = HashBytes(m_frameSceneSignature, gridLayout, sizeof(gridLayout));
+
+		// the light volume covers the whole grid, so that the cells
+		// away from the desk get their shadows too
+		m_shadowBoundsCenter = m_sceneGenerator.GetGridCenter();
+		m_shadowBoundsRadius = std::max(m_sceneGenerator.GetGridRadius(), g_SceneBoundsRadius);
+	}
+	m_frameSceneSignature = HashBytes(m_frameSceneSignature, &m_shadowBoundsCenter, sizeof(m_shadowBoundsCenter));
+	m_frameSceneSignature = HashBytes(m_frameSceneSignature, &m_shadowBoundsRadius, sizeof(m_shadowBoundsRadius));
+}
+
+/***********************************************************
+ *  PrepareShadowMap()
+ *
+ *  This method is used for re-rendering the shadow map when
+ *  an object moved since it was rendered, and binding it for
+ *  the shading pass.
+ ***********************************************************/
+void SceneManager::PrepareShadowMap()
+{
+	// an object moved since the shadow map was rendered, or the
+	// grid changed and with it the light volume
+	if (m_frameSceneSignature != m_shadowSceneSignature)
+	{
+		if (NULL != m_pShadowMap)
+		{
+			m_pShadowMap->SetLight(m_directionalLightDirection, m_shadowBoundsCenter, m_shadowBoundsRadius);
+		}
+		m_bShadowMapDirty = true;
+	}
+
+	bool bCached = UpdateShadowMap();
+
+	if ((NULL != m_pShadowMap) && (m_shadowQuality != ShadowMap::SHADOW_OFF))
+	{
+		// a frame reusing the cached map only pays for binding it -
+		// the light space matrix is still set on the scene program
+		double startTime = TraceProfiler::NowMilliseconds();
+		m_pShadowMap->BindTexture(SHADOW_TEXTURE_UNIT);
+		if (bCached == true)
+		{
+			m_pShadowMap->RecordCachedFrame(TraceProfiler::NowMilliseconds() - startTime);
+		}
+	}
+}
+
+/***********************************************************
+ *  UploadSortedDraws()
+ *
+ *  This method is used for sorting the queue for the camera
+ *  of the frame and uploading the per-draw data of the
+ *  sorted draws, and for binding the lightmaps when the
+ *  baked lighting still matches the lights.
+ ***********************************************************/
+void SceneManager::UploadSortedDraws()
+{
+	m_renderQueue.Sort(m_viewMatrix);
+	if (NULL != m_pDrawDataRing)
+	{
+		bool bObjectLights = (NULL != m_pClusteredLighting) && (m_pointLightMode == ClusteredLighting::LIGHTS_OBJECT);
+		m_pDrawDataRing->Upload(m_renderQueue, bObjectLights ? &m_objectLights : NULL);
+		m_pDrawDataRing->Bind();
+	}
+
+	// the stress lights are not in the baked lighting
+	m_bLightmapsActive = (NULL != m_pLightmapBaker) && (m_pLightmapBaker->IsValid() == true) &&
+		(m_bLightmaps == true) && (m_lightmapPointLightCount == (int)m_pointLights.size());
+	if (m_bLightmapsActive == true)
+	{
+		m_pLightmapBaker->Bind();
+	}
+}
+
+/***********************************************************
+ *  AccumulateFrameTiming()
+ *
+ *  This method is used to add the phase times of the frame
+ *  to the totals that are averaged over the frames.
+ ***********************************************************/
+void SceneManager::AccumulateFrameTiming()
+{
+	m_timingTotals.itemCount += m_frameTiming.itemCount;
+	m_timingTotals.recordMilliseconds += m_frameTiming.recordMilliseconds;
+	m_timingTotals.cullMilliseconds += m_frameTiming.cullMilliseconds;
+	m_timingTotals.shadowMilliseconds += m_frameTiming.shadowMilliseconds;
+	m_timingTotals.lightMilliseconds += m_frameTiming.lightMilliseconds;
+	m_timingTotals.sortMilliseconds += m_frameTiming.sortMilliseconds;
+	m_timingTotals.submitMilliseconds += m_frameTiming.submitMilliseconds;
+	m_timingTotals.queryMilliseconds += m_frameTiming.queryMilliseconds;
+	m_timingTotals.totalMilliseconds += m_frameTiming.totalMilliseconds;
+	m_timingFrames++;
+}
+
+/***********************************************************
+ *  CollectFrameTimers()
+ *
+ *  This method is used to add the GPU time of every frame
+ *  whose timestamps have come back to the timing totals.
+ ***********************************************************/
+void SceneManager::CollectFrameTimers()
+{
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		if (!m_bTimerPending[i])
+		{
+			continue;
+		}
+
+		GLint available = 0;
+		glGetQueryObjectiv(m_timerQueryIDs[i][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0)
+		{
+			continue;
+		}
+
+		GLuint64 startTime = 0;
+		GLuint64 endTime = 0;
+		glGetQueryObjectui64v(m_timerQueryIDs[i][0], GL_QUERY_RESULT, &startTime);
+		glGetQueryObjectui64v(m_timerQueryIDs[i][1], GL_QUERY_RESULT, &endTime);
+		m_bTimerPending[i] = false;
+
+		// the primitive query ended before the second timestamp, so
+		// its result is ready as well
+		GLuint64 primitiveCount = 0;
+		glGetQueryObjectui64v(m_primitiveQueryIDs[i], GL_QUERY_RESULT, &primitiveCount);
+		m_drawCounters.triangles = primitiveCount;
+
+		m_frameTiming.gpuMilliseconds = (double)(endTime - startTime) / 1000000.0;
+		m_timingTotals.gpuMilliseconds += m_frameTiming.gpuMilliseconds;
+		m_gpuTimingFrames++;
+	}
+}
+
+/***********************************************************
+ *  SetSceneGrid()
+ *
+ *  This method is used for repeating the recorded desk over
+ *  a grid of desks, for measuring how the frame scales with
+ *  the number of objects.  Every desk records about 150
+ *  draws, so a 40 x 40 grid holds about 240,000 objects.
+ ***********************************************************/
+void SceneManager::SetSceneGrid(int columns, int rows, unsigned int seed)
+{
+	m_sceneGenerator.Configure(columns, rows, seed);
+	m_bShadowMapDirty = true;
+}
+
+/***********************************************************
+ *  SetGridFrustumCulling()
+ *
+ *  This method is used for enabling or disabling the test
+ *  of the grid cells against the view frustum.  Without it
+ *  every cell is recorded, whether it can be seen or not.
+ ***********************************************************/
+void SceneManager::SetGridFrustumCulling(bool bEnabled)
+{
+	m_sceneGenerator.SetFrustumCulling(bEnabled);
+}
+
+/***********************************************************
+ *  GetAverageFrameTiming()
+ *
+ *  This method is used to get the phase times of the frames
+ *  since the last reset.  The GPU time is averaged over the
+ *  frames whose timestamps have come back.
+ ***********************************************************/
+SceneManager::FRAME_TIMING SceneManager::GetAverageFrameTiming()
+{
+	CollectFrameTimers();
+
+	FRAME_TIMING average = FRAME_TIMING();
+	if (m_timingFrames > 0)
+	{
+		average = m_timingTotals;
+		average.itemCount /= m_timingFrames;
+		average.recordMilliseconds /= m_timingFrames;
+		average.cullMilliseconds /= m_timingFrames;
+		average.shadowMilliseconds /= m_timingFrames;
+		average.lightMilliseconds /= m_timingFrames;
+		average.sortMilliseconds /= m_timingFrames;
+		average.submitMilliseconds /= m_timingFrames;
+		average.queryMilliseconds /= m_timingFrames;
+		average.totalMilliseconds /= m_timingFrames;
+		average.gpuMilliseconds = (m_gpuTimingFrames > 0) ? (m_timingTotals.gpuMilliseconds / m_gpuTimingFrames) : 0.0;
+	}
+	return(average);
+}
+
+/***********************************************************
+ *  ResetFrameTiming()
+ *
+ *  This method is used to restart the phase time totals.
+ ***********************************************************/
+void SceneManager::ResetFrameTiming()
+{
+	m_timingTotals = FRAME_TIMING();
+	m_timingFrames = 0;
+	m_gpuTimingFrames = 0;
+}
+
+/***********************************************************
+ *  PrintFrameTiming()
+ *
+ *  This method is used to print the averaged CPU time of
+ *  every phase of RenderScene and the GPU time of the scene.
+ ***********************************************************/
+void SceneManager::PrintFrameTiming()
+{
+	FRAME_TIMING average = GetAverageFrameTiming();
+
+	std::cout << "INFO: Scene timing statistics\n";
+	if (m_timingFrames > 0)
+	{
+		const SceneGenerator::GENERATOR_STATS& gridStats = m_sceneGenerator.GetStats();
+		std::cout << "  frames: " << m_timingFrames
+			<< ", grid " << m_sceneGenerator.GetColumns() << " x " << m_sceneGenerator.GetRows()
+			<< ", last visible cells " << gridStats.visibleCells
+			<< ", shadow cells " << gridStats.shadowCells
+			<< ", avg draws " << average.itemCount << "\n";
+		std::cout << "  CPU ms: record " << average.recordMilliseconds
+			<< " (cull " << average.cullMilliseconds << ")"
+			<< ", shadow " << average.shadowMilliseconds
+			<< ", lights " << average.lightMilliseconds
+			<< ", sort " << average.sortMilliseconds
+			<< ", submit " << average.submitMilliseconds
+			<< ", queries " << average.queryMilliseconds
+			<< ", total " << average.totalMilliseconds << "\n";
+		std::cout << "  GPU ms: scene " << average.gpuMilliseconds
+			<< ", shading passes " << m_renderQueue.GetAverageShadingGpuMs() << "\n";
+	}
+	std::cout << std::endl;
+}
+
+/***********************************************************
+ *  BeginSceneProp()
+ *
+ *  This method is used to mark where the draws of the next
+ *  desk prop start in the queue, so that the grid cells can
+ *  leave out whole props.  The props are marked in the order
+ *  of SceneGenerator::DESK_PROP.
+ ***********************************************************/
+void SceneManager::BeginSceneProp()
+{
+	m_propFirstItems.push_back(m_renderQueue.GetItemCount());
+}
+
+/***********************************************************
+ *  DrawSceneObjects()
+ *
+ *  This method is used for recording the draw calls for all
+ *  of the objects in the scene into the render queue.
+ ***********************************************************/
+void SceneManager::DrawSceneObjects() {
+	TRACE_SCOPE("DrawSceneObjects");
+	// declare the variables for the transformations
 	glm::vec3 scaleXYZ;
 	float XrotationDegrees = 0.0f;
 	float YrotationDegrees = 0.0f;
@@ -1149,6 +3115,8 @@ void SceneManager::RenderScene() {
 	//---------------------------------------------------------
 	// DARKER RECTANGULAR DESK PLANE
 	//---------------------------------------------------------
+	BeginSceneProp();
+
 	// Set rectangular dimensions (X-axis longer than Z-axis)
 	scaleXYZ = glm::vec3(25.0f, 1.0f, 12.0f);  // X:25, Z:12 for rectangular shape
 
@@ -1170,7 +3138,7 @@ void SceneManager::RenderScene() {
 	SetShaderMaterial("desk");
 
 	// Draw the desk surface
-	m_basicMeshes->DrawPlaneMesh();
+	SubmitMesh(RenderQueue::MESH_PLANE);
 
 	/****************************************************************/
 
@@ -1184,18 +3152,22 @@ void SceneManager::RenderScene() {
 	float deskHeight = 0.0f;
 
 	// Draw Keyboard and Mouse.  Place *before* the vase, so the vase is in front.
+	BeginSceneProp();
 	DrawKeyboard(deskHeight);
 	DrawMouse(deskHeight);
 
+	BeginSceneProp();
 	DrawTeacup(deskHeight);
 	DrawSaucer(deskHeight);
 
 	// Draw the monitor
+	BeginSceneProp();
 	DrawMonitor(deskHeight);
 
 	// VASE AND PLANT
 	const glm::vec3 basePosition(-17.0f, 6.0f, -5.0f); // Define vase base position
 
+	BeginSceneProp();
 	DrawVaseBase(basePosition);
 	DrawVaseNeck(basePosition);
 	DrawVaseOpening(basePosition);
@@ -1206,10 +3178,12 @@ void SceneManager::RenderScene() {
 	DrawWhiteFlowers(basePosition);
 
 	// Books under vase
+	BeginSceneProp();
 	DrawGrayBook(basePosition, deskHeight);      // Bottom, gray
 	DrawBlackBook(basePosition, deskHeight);     // Middle, black
 	DrawLightBlueBook(basePosition, deskHeight);  // Top, light blue
 
+	BeginSceneProp();
 	DrawOrganizer(deskHeight);
 }
 
@@ -11,6 +11,19 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "ShadowMap.h"
+#include "ClusteredLighting.h"
+#include "RenderQueue.h"
+#include "DrawDataRing.h"
+#include "ShaderPermutations.h"
+#include "OcclusionCuller.h"
+#include "TextureStreamer.h"
+#include "SceneGenerator.h"
+#include "FoliageSystem.h"
+#include "LightmapBaker.h"
+#include "SoftwareRasterizer.h"
+#include "ScenePicker.h"
+#include "MultiViewTarget.h"
 
 #include <string>
 #include <vector>
@@ -40,9 +53,70 @@ public:
 		glm::vec3 diffuseColor;
 		glm::vec3 specularColor;
 		float shininess;
+		// materials below 1.0 are drawn in the blended pass
+		float opacity = 1.0f;
 		std::string tag;
 	};
 
+	// CPU time of the phases of RenderScene, and the GPU time of
+	// the whole scene
+	struct FRAME_TIMING
+	{
+		double itemCount;
+		double recordMilliseconds;	// scene code and grid expansion
+		double cullMilliseconds;	// frustum test of the grid cells
+		double shadowMilliseconds;	// shadow map update
+		double lightMilliseconds;	// point light clusters
+		double sortMilliseconds;	// draw order
+		double submitMilliseconds;	// pre-pass and shading draws
+		double queryMilliseconds;	// occlusion bounding box pass
+		double totalMilliseconds;
+		double gpuMilliseconds;
+	};
+
+	// GL work of the last frame, for the performance HUD
+	struct DRAW_COUNTERS
+	{
+		int drawCalls;			// shadow, pre-pass and shading draws
+		int textureBinds;
+		int uniformUploads;		// per draw uniforms set by DrawItem()
+		int culledObjects;		// grid cells and occlusion queries
+		// triangles of the scene passes, read back from the query of
+		// an earlier frame
+		uint64_t triangles;
+	};
+
+	// the draw under a pick ray and the desk prop it belongs to
+	struct PICKED_OBJECT
+	{
+		int itemIndex;			// queue index of the draw, -1 for none
+		int prop;				// SceneGenerator::DESK_PROP of the draw
+		int cell;				// desk of the grid, 0 without a grid
+		float distance;
+		glm::vec3 position;
+		double updateMilliseconds;	// pick tree refit or build
+		double queryMicroseconds;
+	};
+
+	// camera of one view of a multi-view pass
+	struct SCENE_VIEW
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+	};
+
+	// CPU time of the last multi-view pass, summed over the views
+	// when every view had a pass of its own
+	struct MULTI_VIEW_STATS
+	{
+		int viewCount;
+		int itemCount;			// queued draws of one view
+		bool bSinglePass;
+		double recordMilliseconds;	// scene code and grid expansion
+		double submitMilliseconds;	// shadows, lights, sort and draws
+		double totalMilliseconds;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
@@ -54,6 +128,122 @@ private:
 	TEXTURE_INFO m_textureIDs[16];
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// direction and colors of the static directional light
+	glm::vec3 m_directionalLightDirection;
+	glm::vec3 m_directionalLightAmbient;
+	glm::vec3 m_directionalLightDiffuse;
+	glm::vec3 m_directionalLightSpecular;
+
+	// shadow map for the directional light and the depth-only
+	// shader used to render it
+	ShadowMap* m_pShadowMap;
+	ShaderManager* m_pShadowShaderManager;
+	// selected ShadowMap::SHADOW_QUALITY level
+	int m_shadowQuality;
+	// when caching is off the shadow map is re-rendered every frame
+	bool m_bShadowCaching;
+	// set when a light or object changed since the last shadow render
+	bool m_bShadowMapDirty;
+	// hash of all object transforms, used to detect moved objects
+	uint64_t m_shadowSceneSignature;
+	uint64_t m_frameSceneSignature;
+	// bounding sphere that the light volume is fitted to - the desk,
+	// or the whole grid - and the grid draws inside the volume
+	glm::vec3 m_shadowBoundsCenter;
+	float m_shadowBoundsRadius;
+	std::vector<RenderQueue::DRAW_ITEM> m_shadowCasters;
+
+	// point lights of the scene, including any stress test lights
+	std::vector<ClusteredLighting::POINT_LIGHT> m_pointLights;
+	// light buffers and cluster assignment for the point lights
+	ClusteredLighting* m_pClusteredLighting;
+	// selected ClusteredLighting::POINT_LIGHT_MODE
+	int m_pointLightMode;
+	// world space bounds and light lists of the queued draws,
+	// rebuilt every frame in the per-object light mode
+	std::vector<ClusteredLighting::OBJECT_BOUNDS> m_objectBounds;
+	std::vector<ClusteredLighting::OBJECT_LIGHTS> m_objectLights;
+	// camera matrices of the current frame
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+
+	// draw calls recorded by the scene code for the current frame
+	RenderQueue m_renderQueue;
+	// shader state that the next recorded draw call will use
+	RenderQueue::DRAW_ITEM m_drawState;
+	// selected RenderQueue::RENDER_PATH
+	int m_renderPath;
+	// lay down the opaque depth before the shading pass
+	bool m_bDepthPrepass;
+	// scene vertex shader with a depth-only fragment shader
+	ShaderManager* m_pDepthShaderManager;
+	// occlusion queries over the bounding boxes of the recorded draws
+	OcclusionCuller* m_pOcclusionCuller;
+	bool m_bOcclusionCulling;
+	// key of each recorded draw that its query result follows
+	std::vector<int> m_occlusionKeys;
+	// per-draw data of the queued items, fetched by the shaders
+	DrawDataRing* m_pDrawDataRing;
+	// specialized scene shader variants, selected per draw
+	ShaderPermutations* m_pShaderPermutations;
+	bool m_bShaderPermutations;
+	bool m_bUseLighting;
+	// active lights at the front of the fixed pointLights[] array, or
+	// ShaderPermutations::RUNTIME_LIGHTS when they are not contiguous
+	int m_fixedPointLightCount;
+	// baked lighting of the static desk scene, used while the point
+	// lights are the ones it was baked with
+	LightmapBaker* m_pLightmapBaker;
+	bool m_bLightmaps;
+	int m_lightmapPointLightCount;
+	// the lightmaps are used by the draws of this frame
+	bool m_bLightmapsActive;
+	// CPU backend that draws the recorded queue instead of the GL
+	// passes, on m_softwareThreadCount threads (0 for every core)
+	SoftwareRasterizer* m_pSoftwareRasterizer;
+	bool m_bSoftwareRaster;
+	int m_softwareThreadCount;
+	// tree over the boxes of the queued draws, brought up to date
+	// with the queue when an object is picked
+	ScenePicker m_scenePicker;
+	// thumbnail atlas that the multi-view passes render into, and
+	// the cameras of the pass being drawn - the multi-view shader
+	// variants get them the first time they are bound in a pass
+	MultiViewTarget* m_pMultiViewTarget;
+	bool m_bMultiViewPass;
+	int m_multiViewCount;
+	glm::mat4 m_multiViewProjections[MultiViewTarget::MAX_VIEWS];
+	glm::vec3 m_multiViewPositions[MultiViewTarget::MAX_VIEWS];
+	std::vector<ShaderManager*> m_multiViewPrograms;
+	MULTI_VIEW_STATS m_multiViewStats;
+	// progressive decoding and mipmap upload of the scene textures
+	TextureStreamer* m_pTextureStreamer;
+	bool m_bTextureStreaming;
+	// instanced flowers and puffs of the vase plant
+	FoliageSystem* m_pFoliageSystem;
+	FoliageSystem::FOLIAGE_PARAMS m_foliageParams;
+	bool m_bFoliageSway;
+	// grid of desks that the recorded desk is repeated over
+	SceneGenerator m_sceneGenerator;
+	// index of the first recorded draw of each desk prop
+	std::vector<int> m_propFirstItems;
+
+	// timestamps around the scene, in a small ring so that the
+	// results are read back a few frames later without a stall
+	static const int TIMER_FRAMES = 4;
+	GLuint m_timerQueryIDs[TIMER_FRAMES][2];
+	// triangles generated by the scene passes of the same frames
+	GLuint m_primitiveQueryIDs[TIMER_FRAMES];
+	bool m_bTimerPending[TIMER_FRAMES];
+	int m_timerIndex;
+	// phase times of the last frame and their totals since the
+	// last reset
+	FRAME_TIMING m_frameTiming;
+	FRAME_TIMING m_timingTotals;
+	int m_timingFrames;
+	int m_gpuTimingFrames;
+	// counted while the draws of the current frame are issued
+	DRAW_COUNTERS m_drawCounters;
 
 	// load texture images and convert to OpenGL texture data
 	//bool CreateGLTexture(const char* filename, std::string tag);
@@ -96,6 +286,53 @@ private:
 	void SetShaderMaterial(
 		std::string materialTag);
 
+	// create the shadow map and render it for the first time
+	void CreateShadowMap();
+	// re-render the shadow map if it is out of date - returns true
+	// when the cached map was reused
+	bool UpdateShadowMap();
+	// render the scene depth from the directional light
+	void RenderShadowMap();
+	// record the draw calls for every object in the scene
+	void DrawSceneObjects();
+	// record the scene into the queue and expand the desk grid
+	void RecordSceneDraws();
+	// bring the shadow map up to date with the recorded draws and
+	// bind it
+	void PrepareShadowMap();
+	// sort the queue for the current camera and upload the draw
+	// data and lightmaps of the queued draws
+	void UploadSortedDraws();
+	// record and prepare the scene once and draw it into the tile
+	// of every view through the multi-view shader variants
+	void RenderViewsSinglePass(const SCENE_VIEW* pViews, int viewCount);
+	// set the cameras of the pass on a bound multi-view variant
+	void SetMultiViewUniforms(ShaderManager* pShaderManager);
+	// mark the start of the next SceneGenerator::DESK_PROP
+	void BeginSceneProp();
+	// add the GPU time of the finished frames to the totals
+	void CollectFrameTimers();
+	// add the phase times of the frame to the totals
+	void AccumulateFrameTiming();
+	// sort the recorded queue and draw it with the software
+	// rasterizer instead of the GL passes
+	void RenderSoftware(double startTime, double recordedTime);
+	// record a draw of a basic mesh with the current shader state
+	void SubmitMesh(int meshShape, int meshParts = RenderQueue::PART_ALL);
+	// set the recorded shader state and draw the mesh - a draw index
+	// of -1 sets the state through uniforms instead of the draw data;
+	// the item index finds the item's lightmap
+	void DrawItem(const RenderQueue::DRAW_ITEM& item, bool bDepthOnly, int drawIndex, int itemIndex);
+	// issue the recorded draws in the selected order
+	void DrawDepthPrepass();
+	void DrawShadingPasses();
+	// draw a queued item unless it was occluded last frame
+	void DrawQueuedItem(int index, bool bDepthOnly);
+	// test the bounding boxes of the queued items against the depth
+	void DrawOcclusionQueries();
+	// assign the point lights to clusters and bind the light buffers
+	void UpdatePointLights();
+
 public:
 
 	// The following methods are for the students to 
@@ -131,4 +368,101 @@ public:
 	// pre-define the object materials for lighting
 	void DefineObjectMaterials();
 
+	// select the shadow filtering quality (ShadowMap::SHADOW_QUALITY)
+	void SetShadowQuality(int quality);
+	// enable or disable reuse of the shadow map between frames
+	void SetShadowCaching(bool bEnabled);
+	// force the shadow map to be re-rendered on the next frame
+	void InvalidateShadowMap();
+	// print the cached versus uncached shadow pass cost
+	void PrintShadowStats();
+
+	// set the camera matrices of the current frame
+	void SetViewTransform(const glm::mat4& view, const glm::mat4& projection);
+	// select how the shader finds the point lights
+	// (ClusteredLighting::POINT_LIGHT_MODE)
+	void SetPointLightMode(int mode);
+	// add or remove randomly placed lights for stress testing
+	void AddStressLights(int count, unsigned int seed);
+	void RemoveStressLights();
+	// light assignment statistics of the last frame
+	ClusteredLighting::CLUSTER_STATS GetClusterStats();
+	ClusteredLighting::OBJECT_STATS GetObjectLightStats();
+
+	// select the draw order (RenderQueue::RENDER_PATH)
+	void SetRenderPath(int renderPath);
+	// enable or disable the depth-only pre-pass
+	void SetDepthPrepass(bool bEnabled);
+	// draw with the specialized shader variants instead of the
+	// uber shader
+	void SetShaderPermutations(bool bEnabled);
+	// bake the lighting of the desk scene into lightmaps, or load
+	// them from the lightmap cache when nothing changed
+	void BakeLightmaps();
+	// draw the baked objects with their lightmaps instead of the
+	// light loops
+	void SetLightmaps(bool bEnabled);
+	// draw the frames with the CPU rasterizer on the passed in
+	// number of threads, 0 for every core, instead of with GL
+	void SetSoftwareRasterizer(bool bEnabled, int threadCount);
+	// write the last software frame as a PPM image
+	bool SaveSoftwareFrame(const char* filename);
+	// counters and phase times of the last software frame
+	SoftwareRasterizer::RASTER_STATS GetSoftwareRasterStats();
+	// find the object that a world space ray hits first among the
+	// draws of the last rendered frame
+	bool PickObject(const glm::vec3& origin, const glm::vec3& direction, PICKED_OBJECT& picked);
+	// print the picked draw, its prop and the time of the pick
+	void PrintPickedObject(const PICKED_OBJECT& picked);
+	// create the atlas that the multi-view passes render into, with
+	// tiles of the passed in size
+	bool CreateMultiViewTarget(int tileWidth, int tileHeight);
+	// render up to MultiViewTarget::MAX_VIEWS cameras into the tiles
+	// of the atlas - in a single submission that shares the scene's
+	// CPU work between the views, or with a full pass per view;
+	// false when the atlas or the single pass is not available
+	bool RenderMultiView(const SCENE_VIEW* pViews, int viewCount, bool bSinglePass);
+	// write the atlas of the last multi-view pass as a PPM image
+	bool SaveMultiViewAtlas(const char* filename);
+	const MULTI_VIEW_STATS& GetMultiViewStats() const { return m_multiViewStats; }
+	float GetMultiViewAspect() const { return (NULL != m_pMultiViewTarget) ? m_pMultiViewTarget->GetTileAspect() : 1.0f; }
+	// stream the texture mipmaps over the first frames, with the
+	// passed in upload budget per frame (0 keeps the default)
+	void SetTextureStreaming(bool bEnabled, int uploadBudgetKB);
+	// build the texture mipmaps with the passed in filter
+	// (MipGenerator::MIP_FILTER)
+	void SetMipFilter(int filter);
+	// image files of the loaded scene textures
+	std::vector<std::string> GetTextureFiles() const;
+	// print the resident mipmaps of every texture
+	void PrintTextureResidency();
+	// enable or disable the occlusion query culling
+	void SetOcclusionCulling(bool bEnabled);
+	// generate the vase plant's foliage with the passed in density
+	// and seed; it has to be called before PrepareScene()
+	void SetFoliage(float density, unsigned int seed);
+	// enable or disable the swaying of the foliage
+	void SetFoliageSway(bool bEnabled);
+	// the draw queue recorded for the frame, which also keeps the
+	// shaded samples and GPU time of the scene passes
+	RenderQueue& GetRenderQueue() { return m_renderQueue; }
+	// print the draw counts, culled draws and shading cost of the
+	// scene passes
+	void PrintRenderStats();
+
+	// repeat the desk over a grid of columns x rows desks with
+	// random variations; 1 x 1 renders the authored scene
+	void SetSceneGrid(int columns, int rows, unsigned int seed);
+	// enable or disable the frustum test of the grid cells
+	void SetGridFrustumCulling(bool bEnabled);
+	const SceneGenerator::GENERATOR_STATS& GetGridStats() const { return m_sceneGenerator.GetStats(); }
+	// phase times of RenderScene averaged since the last reset
+	FRAME_TIMING GetAverageFrameTiming();
+	void ResetFrameTiming();
+	// print the averaged phase times of RenderScene
+	void PrintFrameTiming();
+	// phase times and GL work of the last frame
+	const FRAME_TIMING& GetFrameTiming() const { return m_frameTiming; }
+	const DRAW_COUNTERS& GetDrawCounters() const { return m_drawCounters; }
+
 };
\ No newline at end of file
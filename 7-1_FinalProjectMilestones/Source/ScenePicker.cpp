@@ -0,0 +1,778 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenepicker.cpp
+// ============
+// ray picking of the scene's draws - a bounding volume hierarchy built with
+// the surface area heuristic over the world space boxes of the queued draws,
+// refit in place when the draws move and rebuilt when the refit tree has
+// grown too loose
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ScenePicker.h"
+#include "FoliageSystem.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// cost of testing a ray against a node box, and against the box
+	// of a draw, which first moves the ray into the draw's space
+	const float TRAVERSAL_COST = 1.0f;
+	const float ITEM_COST = 2.0f;
+	// groups of draws that no split beats are kept in one leaf
+	// up to this size
+	const int MAX_SAH_LEAF_SIZE = 16;
+	// deeper nodes are made leaves, which bounds the ray stack
+	const int MAX_DEPTH = 48;
+	const int BVH_STACK_SIZE = 64;
+	// the tree is rebuilt when a refit made a ray this much more
+	// expensive than right after the build
+	const float REBUILD_COST_RATIO = 1.5f;
+	// from this share of moved draws on, every node is refit in one
+	// pass instead of walking up from each moved draw
+	const int FULL_REFIT_FRACTION = 4;
+	const float MAX_PICK_DISTANCE = 1.0e30f;
+
+	/***********************************************************
+	 *  GetShapeBounds()
+	 *
+	 *  Object space box of a basic mesh.  The torus box is a
+	 *  cube, as the plane of its ring is not known here.
+	 ***********************************************************/
+	void GetShapeBounds(int meshShape, glm::vec3& boundsMin, glm::vec3& boundsMax)
+	{
+		switch (meshShape)
+		{
+		case RenderQueue::MESH_PLANE:
+			boundsMin = glm::vec3(-1.0f, -0.01f, -1.0f);
+			boundsMax = glm::vec3(1.0f, 0.01f, 1.0f);
+			break;
+		case RenderQueue::MESH_CYLINDER:
+		case RenderQueue::MESH_TAPERED_CYLINDER:
+			boundsMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+			boundsMax = glm::vec3(1.0f, 1.0f, 1.0f);
+			break;
+		case RenderQueue::MESH_SPHERE:
+			boundsMin = glm::vec3(-1.0f);
+			boundsMax = glm::vec3(1.0f);
+			break;
+		case RenderQueue::MESH_TORUS:
+			boundsMin = glm::vec3(-1.2f);
+			boundsMax = glm::vec3(1.2f);
+			break;
+		case RenderQueue::MESH_FOLIAGE:
+			boundsMin = glm::vec3(-FoliageSystem::PLANT_RADIUS, 0.0f, -FoliageSystem::PLANT_RADIUS);
+			boundsMax = glm::vec3(FoliageSystem::PLANT_RADIUS, FoliageSystem::PLANT_HEIGHT, FoliageSystem::PLANT_RADIUS);
+			break;
+		default:
+			boundsMin = glm::vec3(-0.5f);
+			boundsMax = glm::vec3(0.5f);
+			break;
+		}
+	}
+
+	/***********************************************************
+	 *  GetWorldBounds()
+	 *
+	 *  World space box around the transformed shape bounds.
+	 ***********************************************************/
+	void GetWorldBounds(int meshShape, const glm::mat4& model, glm::vec3& worldMin, glm::vec3& worldMax)
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		GetShapeBounds(meshShape, boundsMin, boundsMax);
+
+		glm::vec3 center = glm::vec3(model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+		glm::vec3 halfSize = (boundsMax - boundsMin) * 0.5f;
+		glm::vec3 extent = glm::abs(glm::vec3(model[0])) * halfSize.x +
+			glm::abs(glm::vec3(model[1])) * halfSize.y +
+			glm::abs(glm::vec3(model[2])) * halfSize.z;
+		worldMin = center - extent;
+		worldMax = center + extent;
+	}
+
+	/***********************************************************
+	 *  GetSurfaceArea()
+	 ***********************************************************/
+	float GetSurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return(2.0f * (size.x * size.y + size.y * size.z + size.z * size.x));
+	}
+
+	/***********************************************************
+	 *  GetBin()
+	 *
+	 *  SAH bucket of a box center along the split axis.
+	 ***********************************************************/
+	int GetBin(float center, float centerMin, float binScale)
+	{
+		int bin = (int)((center - centerMin) * binScale);
+		return(std::min(std::max(bin, 0), ScenePicker::SAH_BINS - 1));
+	}
+
+	/***********************************************************
+	 *  EnterBox()
+	 *
+	 *  Slab test of a ray against a world space box, with the
+	 *  distance where the ray enters it, or 0 from inside.
+	 ***********************************************************/
+	bool EnterBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float tMax,
+		const glm::vec3& boxMin, const glm::vec3& boxMax, float& tEnter)
+	{
+		glm::vec3 t1 = (boxMin - origin) * inverseDirection;
+		glm::vec3 t2 = (boxMax - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t1, t2);
+		glm::vec3 tFar = glm::max(t1, t2);
+		float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+		tEnter = enter;
+		return(enter <= exit);
+	}
+}
+
+/***********************************************************
+ *  ScenePicker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ScenePicker::ScenePicker()
+{
+	m_weightedArea = 0.0;
+	m_stats = PICKER_STATS();
+}
+
+/***********************************************************
+ *  ~ScenePicker()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ScenePicker::~ScenePicker()
+{
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used to drop the draws and the tree.
+ ***********************************************************/
+void ScenePicker::Clear()
+{
+	m_items.clear();
+	m_itemOrder.clear();
+	m_nodes.clear();
+	m_parents.clear();
+	m_itemLeaves.clear();
+	m_movedItems.clear();
+	m_weightedArea = 0.0;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used to bring the tree up to date with the
+ *  draws of the queue.  The draws are matched by their queue
+ *  index, and a draw whose mesh or transform differs from
+ *  the last update counts as moved.  A moved draw only needs
+ *  the boxes above it to grow or shrink, but the refit keeps
+ *  the grouping of the draws, which gets worse the further
+ *  they move from where the tree was built; once a ray costs
+ *  REBUILD_COST_RATIO times what it did after the build, the
+ *  tree is built again.
+ ***********************************************************/
+void ScenePicker::Update(const RenderQueue& renderQueue)
+{
+	TRACE_SCOPE("UpdateScenePicker");
+	int itemCount = renderQueue.GetItemCount();
+	bool bRebuild = (itemCount != (int)m_items.size());
+	if (bRebuild == true)
+	{
+		m_items.resize(itemCount);
+	}
+
+	m_movedItems.clear();
+	for (int i = 0; i < itemCount; i++)
+	{
+		const RenderQueue::DRAW_ITEM& drawItem = renderQueue.GetItem(i);
+		PICK_ITEM& item = m_items[i];
+		if ((bRebuild == false) &&
+			(item.meshShape == drawItem.meshShape) &&
+			(item.meshParts == drawItem.meshParts) &&
+			(memcmp(&item.model, &drawItem.model, sizeof(glm::mat4)) == 0))
+		{
+			continue;
+		}
+
+		item.meshShape = drawItem.meshShape;
+		item.meshParts = drawItem.meshParts;
+		item.model = drawItem.model;
+		GetWorldBounds(item.meshShape, item.model, item.boundsMin, item.boundsMax);
+		if (bRebuild == false)
+		{
+			m_movedItems.push_back(i);
+		}
+	}
+
+	if (bRebuild == true)
+	{
+		m_stats.movedItems = itemCount;
+		Build();
+		return;
+	}
+
+	m_stats.movedItems = (int)m_movedItems.size();
+	if (m_movedItems.empty() == false)
+	{
+		Refit();
+		if (m_stats.sahCost > m_stats.builtSahCost * REBUILD_COST_RATIO)
+		{
+			Build();
+		}
+	}
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used to build the tree over every draw,
+ *  top down from the root.
+ ***********************************************************/
+void ScenePicker::Build()
+{
+	TRACE_SCOPE("BuildPickTree");
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	int itemCount = (int)m_items.size();
+	m_nodes.clear();
+	m_parents.clear();
+	m_itemOrder.resize(itemCount);
+	m_itemLeaves.assign(itemCount, -1);
+	m_centers.resize(itemCount);
+	for (int i = 0; i < itemCount; i++)
+	{
+		m_itemOrder[i] = i;
+		m_centers[i] = (m_items[i].boundsMin + m_items[i].boundsMax) * 0.5f;
+	}
+
+	m_stats.leafCount = 0;
+	m_stats.maxDepth = 0;
+	if (itemCount > 0)
+	{
+		m_nodes.reserve((size_t)itemCount * 2);
+		m_parents.reserve((size_t)itemCount * 2);
+		m_nodes.push_back(BVH_NODE());
+		m_parents.push_back(-1);
+		BuildNode(0, 0, itemCount, 1);
+	}
+
+	m_weightedArea = 0.0;
+	for (int n = 0; n < (int)m_nodes.size(); n++)
+	{
+		m_weightedArea += GetSurfaceArea(m_nodes[n].boundsMin, m_nodes[n].boundsMax) * GetNodeWeight(n);
+	}
+
+	m_stats.itemCount = itemCount;
+	m_stats.nodeCount = (int)m_nodes.size();
+	m_stats.sahCost = GetSahCost();
+	m_stats.builtSahCost = m_stats.sahCost;
+	m_stats.builds++;
+	m_stats.buildMilliseconds = TraceProfiler::NowMilliseconds() - startTime;
+}
+
+/***********************************************************
+ *  BuildNode()
+ *
+ *  This method is used to fill in a node for the passed in
+ *  range of the item order.  The box centers are sorted into
+ *  SAH_BINS buckets along each axis, and the range is split
+ *  between the buckets where the summed surface areas of the
+ *  two halves, weighted by their draws, are the smallest.
+ *  When no split is cheaper than testing every draw, a small
+ *  range becomes a leaf and a large one is split at the
+ *  median of the widest axis.  The children of a node are
+ *  stored next to each other, after their parent.
+ ***********************************************************/
+void ScenePicker::BuildNode(int nodeIndex, int first, int count, int depth)
+{
+	glm::vec3 boundsMin = glm::vec3(1.0e30f);
+	glm::vec3 boundsMax = glm::vec3(-1.0e30f);
+	glm::vec3 centerMin = glm::vec3(1.0e30f);
+	glm::vec3 centerMax = glm::vec3(-1.0e30f);
+	for (int i = first; i < first + count; i++)
+	{
+		const PICK_ITEM& item = m_items[m_itemOrder[i]];
+		boundsMin = glm::min(boundsMin, item.boundsMin);
+		boundsMax = glm::max(boundsMax, item.boundsMax);
+		centerMin = glm::min(centerMin, m_centers[m_itemOrder[i]]);
+		centerMax = glm::max(centerMax, m_centers[m_itemOrder[i]]);
+	}
+	m_nodes[nodeIndex].boundsMin = boundsMin;
+	m_nodes[nodeIndex].boundsMax = boundsMax;
+	m_stats.maxDepth = std::max(m_stats.maxDepth, depth);
+
+	bool bLeaf = (count <= MAX_LEAF_SIZE) || (depth >= MAX_DEPTH);
+	int bestAxis = -1;
+	int bestBin = 0;
+	if (bLeaf == false)
+	{
+		float nodeArea = GetSurfaceArea(boundsMin, boundsMax);
+		float bestCost = ITEM_COST * count * nodeArea;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float extent = centerMax[axis] - centerMin[axis];
+			if (extent <= 0.0f)
+			{
+				continue;
+			}
+			float binScale = SAH_BINS / extent;
+
+			int binCounts[SAH_BINS] = {};
+			glm::vec3 binMin[SAH_BINS];
+			glm::vec3 binMax[SAH_BINS];
+			for (int b = 0; b < SAH_BINS; b++)
+			{
+				binMin[b] = glm::vec3(1.0e30f);
+				binMax[b] = glm::vec3(-1.0e30f);
+			}
+			for (int i = first; i < first + count; i++)
+			{
+				int itemIndex = m_itemOrder[i];
+				int bin = GetBin(m_centers[itemIndex][axis], centerMin[axis], binScale);
+				binCounts[bin]++;
+				binMin[bin] = glm::min(binMin[bin], m_items[itemIndex].boundsMin);
+				binMax[bin] = glm::max(binMax[bin], m_items[itemIndex].boundsMax);
+			}
+
+			// the draws and areas left of every split, swept from
+			// the left, then the right side swept back against them
+			int leftCounts[SAH_BINS - 1];
+			float leftAreas[SAH_BINS - 1];
+			glm::vec3 sweepMin = glm::vec3(1.0e30f);
+			glm::vec3 sweepMax = glm::vec3(-1.0e30f);
+			int sweepCount = 0;
+			for (int b = 0; b < SAH_BINS - 1; b++)
+			{
+				sweepCount += binCounts[b];
+				sweepMin = glm::min(sweepMin, binMin[b]);
+				sweepMax = glm::max(sweepMax, binMax[b]);
+				leftCounts[b] = sweepCount;
+				leftAreas[b] = GetSurfaceArea(sweepMin, sweepMax);
+			}
+
+			sweepMin = glm::vec3(1.0e30f);
+			sweepMax = glm::vec3(-1.0e30f);
+			sweepCount = 0;
+			for (int b = SAH_BINS - 1; b > 0; b--)
+			{
+				sweepCount += binCounts[b];
+				sweepMin = glm::min(sweepMin, binMin[b]);
+				sweepMax = glm::max(sweepMax, binMax[b]);
+				if ((sweepCount == 0) || (leftCounts[b - 1] == 0))
+				{
+					continue;
+				}
+				float cost = TRAVERSAL_COST * nodeArea + ITEM_COST *
+					(leftAreas[b - 1] * leftCounts[b - 1] + GetSurfaceArea(sweepMin, sweepMax) * sweepCount);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		if ((bestAxis < 0) && (count <= MAX_SAH_LEAF_SIZE))
+		{
+			bLeaf = true;
+		}
+	}
+
+	if (bLeaf == true)
+	{
+		m_nodes[nodeIndex].first = first;
+		m_nodes[nodeIndex].count = count;
+		for (int i = first; i < first + count; i++)
+		{
+			m_itemLeaves[m_itemOrder[i]] = nodeIndex;
+		}
+		m_stats.leafCount++;
+		return;
+	}
+
+	int half = count / 2;
+	if (bestAxis >= 0)
+	{
+		float binScale = SAH_BINS / (centerMax[bestAxis] - centerMin[bestAxis]);
+		float axisMin = centerMin[bestAxis];
+		int axis = bestAxis;
+		int split = bestBin;
+		std::vector<int>::iterator middle = std::partition(
+			m_itemOrder.begin() + first, m_itemOrder.begin() + first + count,
+			[this, axis, axisMin, binScale, split](int itemIndex)
+			{
+				return GetBin(m_centers[itemIndex][axis], axisMin, binScale) < split;
+			});
+		half = (int)(middle - (m_itemOrder.begin() + first));
+	}
+	else
+	{
+		glm::vec3 extent = centerMax - centerMin;
+		int axis = (extent.x >= extent.y) ? ((extent.x >= extent.z) ? 0 : 2) : ((extent.y >= extent.z) ? 1 : 2);
+		std::nth_element(m_itemOrder.begin() + first, m_itemOrder.begin() + first + half, m_itemOrder.begin() + first + count,
+			[this, axis](int a, int b)
+			{
+				return m_centers[a][axis] < m_centers[b][axis];
+			});
+	}
+
+	int childIndex = (int)m_nodes.size();
+	m_nodes[nodeIndex].first = childIndex;
+	m_nodes[nodeIndex].count = 0;
+	m_nodes.push_back(BVH_NODE());
+	m_nodes.push_back(BVH_NODE());
+	m_parents.push_back(nodeIndex);
+	m_parents.push_back(nodeIndex);
+	BuildNode(childIndex, first, half, depth + 1);
+	BuildNode(childIndex + 1, first + half, count - half, depth + 1);
+}
+
+/***********************************************************
+ *  Refit()
+ *
+ *  This method is used to update the boxes over the moved
+ *  draws.  Each moved draw walks up from its leaf until a
+ *  box comes out unchanged, as everything above it is then
+ *  unchanged too.  When many draws moved, all nodes are refit
+ *  in one backwards pass instead, which reaches every child
+ *  before its parent.
+ ***********************************************************/
+void ScenePicker::Refit()
+{
+	TRACE_SCOPE("RefitPickTree");
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	m_stats.refitNodes = 0;
+	if ((int)m_movedItems.size() * FULL_REFIT_FRACTION >= (int)m_items.size())
+	{
+		for (int n = (int)m_nodes.size() - 1; n >= 0; n--)
+		{
+			RefitNode(n);
+		}
+	}
+	else
+	{
+		for (int itemIndex : m_movedItems)
+		{
+			int nodeIndex = m_itemLeaves[itemIndex];
+			while ((nodeIndex >= 0) && (RefitNode(nodeIndex) == true))
+			{
+				nodeIndex = m_parents[nodeIndex];
+			}
+		}
+	}
+
+	m_stats.sahCost = GetSahCost();
+	m_stats.refits++;
+	m_stats.refitMilliseconds = TraceProfiler::NowMilliseconds() - startTime;
+}
+
+/***********************************************************
+ *  RefitNode()
+ *
+ *  This method is used to recompute the box of a node and
+ *  to keep the weighted area of the tree up to date with it.
+ ***********************************************************/
+bool ScenePicker::RefitNode(int nodeIndex)
+{
+	BVH_NODE& node = m_nodes[nodeIndex];
+	glm::vec3 boundsMin = glm::vec3(1.0e30f);
+	glm::vec3 boundsMax = glm::vec3(-1.0e30f);
+	if (node.count > 0)
+	{
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			boundsMin = glm::min(boundsMin, m_items[m_itemOrder[i]].boundsMin);
+			boundsMax = glm::max(boundsMax, m_items[m_itemOrder[i]].boundsMax);
+		}
+	}
+	else
+	{
+		boundsMin = glm::min(m_nodes[node.first].boundsMin, m_nodes[node.first + 1].boundsMin);
+		boundsMax = glm::max(m_nodes[node.first].boundsMax, m_nodes[node.first + 1].boundsMax);
+	}
+
+	if ((boundsMin == node.boundsMin) && (boundsMax == node.boundsMax))
+	{
+		return(false);
+	}
+
+	m_weightedArea += (GetSurfaceArea(boundsMin, boundsMax) - GetSurfaceArea(node.boundsMin, node.boundsMax)) *
+		GetNodeWeight(nodeIndex);
+	node.boundsMin = boundsMin;
+	node.boundsMax = boundsMax;
+	m_stats.refitNodes++;
+	return(true);
+}
+
+/***********************************************************
+ *  GetNodeWeight()
+ *
+ *  This method is used to get the cost of a ray that enters
+ *  the node - a box test for each child, or a draw test for
+ *  each draw of a leaf.
+ ***********************************************************/
+float ScenePicker::GetNodeWeight(int nodeIndex) const
+{
+	const BVH_NODE& node = m_nodes[nodeIndex];
+	return((node.count > 0) ? ITEM_COST * node.count : TRAVERSAL_COST);
+}
+
+/***********************************************************
+ *  GetSahCost()
+ *
+ *  This method is used to get the expected cost of a ray
+ *  through the root box, from the surface areas of the nodes
+ *  relative to the root - the chance that a random ray
+ *  through the root also passes through the node.
+ ***********************************************************/
+float ScenePicker::GetSahCost() const
+{
+	if (m_nodes.empty() == true)
+	{
+		return(0.0f);
+	}
+	float rootArea = GetSurfaceArea(m_nodes[0].boundsMin, m_nodes[0].boundsMax);
+	if (rootArea <= 0.0f)
+	{
+		return(0.0f);
+	}
+	return((float)(m_weightedArea / rootArea));
+}
+
+/***********************************************************
+ *  IntersectItem()
+ *
+ *  This method is used to test a ray against the object
+ *  space box of a draw's mesh.  A box around the ray origin
+ *  does not count, so that the camera can pick out of a
+ *  draw that it stands in.
+ ***********************************************************/
+bool ScenePicker::IntersectItem(int itemIndex, const glm::vec3& origin, const glm::vec3& direction, float tMax, float& tHit) const
+{
+	const PICK_ITEM& item = m_items[itemIndex];
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	GetShapeBounds(item.meshShape, boundsMin, boundsMax);
+
+	// the direction is not normalized in object space, so t is
+	// the same distance there as in world space
+	glm::mat4 worldToLocal = glm::inverse(item.model);
+	glm::vec3 localOrigin = glm::vec3(worldToLocal * glm::vec4(origin, 1.0f));
+	glm::vec3 localDirection = glm::vec3(worldToLocal * glm::vec4(direction, 0.0f));
+
+	float tNear = -1.0e30f;
+	float tFar = 1.0e30f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (std::fabs(localDirection[axis]) < 1.0e-12f)
+		{
+			if ((localOrigin[axis] < boundsMin[axis]) || (localOrigin[axis] > boundsMax[axis]))
+			{
+				return(false);
+			}
+			continue;
+		}
+		float t1 = (boundsMin[axis] - localOrigin[axis]) / localDirection[axis];
+		float t2 = (boundsMax[axis] - localOrigin[axis]) / localDirection[axis];
+		tNear = std::max(tNear, std::min(t1, t2));
+		tFar = std::min(tFar, std::max(t1, t2));
+	}
+
+	if ((tNear < 0.0f) || (tNear > tFar) || (tNear >= tMax))
+	{
+		return(false);
+	}
+	tHit = tNear;
+	return(true);
+}
+
+/***********************************************************
+ *  Pick()
+ *
+ *  This method is used to find the nearest draw along the
+ *  ray.  The nearer child of a node is visited first, and a
+ *  node is skipped once a hit was found in front of it, so a
+ *  ray into a dense scene usually ends after a few leaves.
+ ***********************************************************/
+bool ScenePicker::Pick(const glm::vec3& origin, const glm::vec3& direction, PICK_RESULT& result) const
+{
+	result.itemIndex = -1;
+	result.distance = 0.0f;
+	result.position = origin;
+	result.testedNodes = 0;
+	result.testedItems = 0;
+	if (m_nodes.empty() == true)
+	{
+		return(false);
+	}
+
+	glm::vec3 inverseDirection = 1.0f / direction;
+	float tMax = MAX_PICK_DISTANCE;
+	int stack[BVH_STACK_SIZE];
+	float stackEnter[BVH_STACK_SIZE];
+	int stackSize = 0;
+
+	float tEnter;
+	result.testedNodes++;
+	if (EnterBox(origin, inverseDirection, tMax, m_nodes[0].boundsMin, m_nodes[0].boundsMax, tEnter) == true)
+	{
+		stack[stackSize] = 0;
+		stackEnter[stackSize++] = tEnter;
+	}
+
+	while (stackSize > 0)
+	{
+		stackSize--;
+		if (stackEnter[stackSize] >= tMax)
+		{
+			continue;
+		}
+
+		const BVH_NODE& node = m_nodes[stack[stackSize]];
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				int itemIndex = m_itemOrder[i];
+				float tHit;
+				result.testedItems++;
+				if (IntersectItem(itemIndex, origin, direction, tMax, tHit) == true)
+				{
+					tMax = tHit;
+					result.itemIndex = itemIndex;
+				}
+			}
+			continue;
+		}
+
+		const BVH_NODE& child0 = m_nodes[node.first];
+		const BVH_NODE& child1 = m_nodes[node.first + 1];
+		float tEnter0;
+		float tEnter1;
+		bool bHit0 = EnterBox(origin, inverseDirection, tMax, child0.boundsMin, child0.boundsMax, tEnter0);
+		bool bHit1 = EnterBox(origin, inverseDirection, tMax, child1.boundsMin, child1.boundsMax, tEnter1);
+		result.testedNodes += 2;
+		if (stackSize + 2 > BVH_STACK_SIZE)
+		{
+			continue;
+		}
+
+		// the nearer child goes on top of the stack
+		if ((bHit0 == true) && (bHit1 == true) && (tEnter1 < tEnter0))
+		{
+			stack[stackSize] = node.first;
+			stackEnter[stackSize++] = tEnter0;
+			stack[stackSize] = node.first + 1;
+			stackEnter[stackSize++] = tEnter1;
+			continue;
+		}
+		if (bHit1 == true)
+		{
+			stack[stackSize] = node.first + 1;
+			stackEnter[stackSize++] = tEnter1;
+		}
+		if (bHit0 == true)
+		{
+			stack[stackSize] = node.first;
+			stackEnter[stackSize++] = tEnter0;
+		}
+	}
+
+	if (result.itemIndex < 0)
+	{
+		return(false);
+	}
+	result.distance = tMax;
+	result.position = origin + direction * tMax;
+	return(true);
+}
+
+/***********************************************************
+ *  PickBruteForce()
+ *
+ *  This method is used to find the nearest draw along the
+ *  ray by testing every draw, without the tree.
+ ***********************************************************/
+bool ScenePicker::PickBruteForce(const glm::vec3& origin, const glm::vec3& direction, PICK_RESULT& result) const
+{
+	result.itemIndex = -1;
+	result.distance = 0.0f;
+	result.position = origin;
+	result.testedNodes = 0;
+	result.testedItems = (int)m_items.size();
+
+	float tMax = MAX_PICK_DISTANCE;
+	for (int i = 0; i < (int)m_items.size(); i++)
+	{
+		float tHit;
+		if (IntersectItem(i, origin, direction, tMax, tHit) == true)
+		{
+			tMax = tHit;
+			result.itemIndex = i;
+		}
+	}
+
+	if (result.itemIndex < 0)
+	{
+		return(false);
+	}
+	result.distance = tMax;
+	result.position = origin + direction * tMax;
+	return(true);
+}
+
+/***********************************************************
+ *  GetViewRay()
+ *
+ *  This method is used to turn a point of the viewport into
+ *  the world space ray under it, from the near plane towards
+ *  the far plane.  It works for the perspective and the
+ *  orthographic projections alike.
+ ***********************************************************/
+void ScenePicker::GetViewRay(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	float ndcX,
+	float ndcY,
+	glm::vec3& origin,
+	glm::vec3& direction)
+{
+	glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+	glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+	origin = glm::vec3(nearPoint) / nearPoint.w;
+	direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used to print the size and the cost of the
+ *  tree, and how often and how fast it was updated.
+ ***********************************************************/
+void ScenePicker::PrintStats() const
+{
+	std::cout << std::fixed << std::setprecision(2)
+		<< "INFO: Pick tree over " << m_stats.itemCount << " draws, "
+		<< m_stats.nodeCount << " nodes, " << m_stats.leafCount << " leaves, depth " << m_stats.maxDepth
+		<< ", SAH cost " << m_stats.sahCost << " (" << m_stats.builtSahCost << " when built); "
+		<< m_stats.builds << " builds, last " << m_stats.buildMilliseconds << " ms, "
+		<< m_stats.refits << " refits, last " << m_stats.refitMilliseconds << " ms for "
+		<< m_stats.movedItems << " moved draws" << std::endl;
+}
@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenepicker.h
+// ============
+// ray picking of the scene's draws - a bounding volume hierarchy built with
+// the surface area heuristic over the world space boxes of the queued draws,
+// refit in place when the draws move and rebuilt when the refit tree has
+// grown too loose
+//
+//  A draw is hit where the ray enters the box of its mesh in object space,
+//  which is exact for the boxes and planes and close for the round meshes.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderQueue.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  ScenePicker
+ *
+ *  This class contains the pickable draws, the tree over
+ *  their boxes and the statistics of its last update.
+ ***********************************************************/
+class ScenePicker
+{
+public:
+	// draws in a leaf that the build stops splitting at
+	static const int MAX_LEAF_SIZE = 4;
+	// buckets of the surface area heuristic, per axis
+	static const int SAH_BINS = 16;
+
+	struct PICK_RESULT
+	{
+		int itemIndex;			// queue index of the hit draw, -1 for none
+		float distance;			// along the normalized ray direction
+		glm::vec3 position;
+		int testedNodes;
+		int testedItems;
+	};
+
+	struct PICKER_STATS
+	{
+		int itemCount;
+		int nodeCount;
+		int leafCount;
+		int maxDepth;
+		int builds;
+		int refits;
+		int movedItems;			// draws that changed in the last update
+		int refitNodes;			// nodes whose box the last refit changed
+		// expected cost of a ray, in box tests, relative to the root box
+		float sahCost;
+		float builtSahCost;		// the cost right after the last build
+		double buildMilliseconds;
+		double refitMilliseconds;
+	};
+
+	// constructor
+	ScenePicker();
+	// destructor
+	~ScenePicker();
+
+	// refit the tree when only the transforms or meshes of the draws
+	// changed since the last update, and rebuild it when the number
+	// of draws changed or the refit tree is too loose
+	void Update(const RenderQueue& renderQueue);
+	// drop the tree, so that the next update builds it
+	void Clear();
+
+	// nearest draw that the world space ray hits
+	bool Pick(const glm::vec3& origin, const glm::vec3& direction, PICK_RESULT& result) const;
+	// the same test against every draw, for checking the tree
+	bool PickBruteForce(const glm::vec3& origin, const glm::vec3& direction, PICK_RESULT& result) const;
+
+	// world space ray through a point of the viewport, given in
+	// normalized device coordinates, with a normalized direction
+	static void GetViewRay(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		float ndcX,
+		float ndcY,
+		glm::vec3& origin,
+		glm::vec3& direction);
+
+	const PICKER_STATS& GetStats() const { return m_stats; }
+	// print the size and the cost of the tree and its update times
+	void PrintStats() const;
+
+private:
+	// a draw as the tree sees it
+	struct PICK_ITEM
+	{
+		int meshShape;
+		int meshParts;
+		glm::mat4 model;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	struct BVH_NODE
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		// leaves hold count draws of the item order starting at
+		// first, inner nodes have count 0 and their children at
+		// first and first + 1
+		int first;
+		int count;
+	};
+
+	// the draws in queue order
+	std::vector<PICK_ITEM> m_items;
+	// queue indices of the draws, in the order of the leaves
+	std::vector<int> m_itemOrder;
+	std::vector<BVH_NODE> m_nodes;
+	// parent of every node and leaf of every draw, for the refit
+	std::vector<int> m_parents;
+	std::vector<int> m_itemLeaves;
+	// box centers of the draws, used while building
+	std::vector<glm::vec3> m_centers;
+	// draws that changed since the last update
+	std::vector<int> m_movedItems;
+	// surface area of every node weighted by its cost, summed
+	double m_weightedArea;
+	PICKER_STATS m_stats;
+
+	// build the tree over all draws
+	void Build();
+	void BuildNode(int nodeIndex, int first, int count, int depth);
+	// bring the boxes of the moved draws' ancestors up to date
+	void Refit();
+	// recompute the box of a node from its draws or children,
+	// returns false when the box did not change
+	bool RefitNode(int nodeIndex);
+	float GetNodeWeight(int nodeIndex) const;
+	float GetSahCost() const;
+	// distance where the ray enters the draw's box, if before tMax
+	bool IntersectItem(int itemIndex, const glm::vec3& origin, const glm::vec3& direction, float tMax, float& tHit) const;
+};
@@ -0,0 +1,521 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderpermutations.cpp
+// ============
+// specialized variants of the scene shader - the texture and lighting
+// switches and the active point light count are compiled in through
+// preprocessor defines, one program per feature mask, built on first use
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPermutations.h"
+
+#include "GLStateCache.h"
+#include "TraceProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// declaration of the global variables and defines
+namespace
+{
+	bool ReadTextFile(const char* path, std::string& text)
+	{
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		if (!file.is_open())
+		{
+			return(false);
+		}
+		std::stringstream stream;
+		stream << file.rdbuf();
+		text = stream.str();
+		return(true);
+	}
+
+	/***********************************************************
+	 *  CompileShader()
+	 *
+	 *  Compile a shader from its source, with the defines
+	 *  inserted after the #version line that has to come first.
+	 ***********************************************************/
+	GLuint CompileShader(GLenum shaderType, const std::string& source, const std::string& defines)
+	{
+		size_t versionEnd = source.find('\n');
+		versionEnd = (versionEnd == std::string::npos) ? source.size() : versionEnd + 1;
+		std::string header = source.substr(0, versionEnd) + defines;
+		const GLchar* sources[2] = { header.c_str(), source.c_str() + versionEnd };
+
+		GLuint shaderID = glCreateShader(shaderType);
+		glShaderSource(shaderID, 2, sources, NULL);
+		glCompileShader(shaderID);
+
+		GLint bCompiled = GL_FALSE;
+		glGetShaderiv(shaderID, GL_COMPILE_STATUS, &bCompiled);
+		if (bCompiled == GL_FALSE)
+		{
+			GLchar log[1024];
+			glGetShaderInfoLog(shaderID, sizeof(log), NULL, log);
+			std::cerr << "ERROR: Shader variant failed to compile:\n" << log << std::endl;
+			glDeleteShader(shaderID);
+			return(0);
+		}
+		return(shaderID);
+	}
+
+	/***********************************************************
+	 *  GetComponentCount()
+	 *
+	 *  Values stored by a uniform of the passed in type, or 0
+	 *  for the types that GLStateCache has no setter for, which
+	 *  the scene shaders do not use.
+	 ***********************************************************/
+	int GetComponentCount(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_FLOAT: case GL_INT: case GL_BOOL:
+			return(1);
+		case GL_FLOAT_VEC2:
+			return(2);
+		case GL_FLOAT_VEC3:
+			return(3);
+		case GL_FLOAT_VEC4:
+			return(4);
+		case GL_FLOAT_MAT4:
+			return(16);
+		case GL_SAMPLER_2D: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+			return(1);
+		}
+		return(0);
+	}
+}
+
+/***********************************************************
+ *  MakeFeatureMask()
+ *
+ *  This method is used to combine the switches of a draw
+ *  into the key of its variant.  Light counts outside of
+ *  the fixed array select the run time light branches.
+ ***********************************************************/
+unsigned int ShaderPermutations::MakeFeatureMask(bool bTextured, bool bLit, int pointLightCount)
+{
+	if ((pointLightCount < 0) || (pointLightCount >= RUNTIME_LIGHTS))
+	{
+		pointLightCount = RUNTIME_LIGHTS;
+	}
+
+	unsigned int featureMask = (unsigned int)pointLightCount << LIGHT_COUNT_SHIFT;
+	if (bTextured == true)
+	{
+		featureMask |= FEATURE_TEXTURED;
+	}
+	if (bLit == true)
+	{
+		featureMask |= FEATURE_LIT;
+	}
+	return(featureMask);
+}
+
+/***********************************************************
+ *  ShaderPermutations()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderPermutations::ShaderPermutations()
+{
+	m_pSourceShaderManager = NULL;
+	m_compileMilliseconds = 0.0;
+	m_copiedUniforms = 0;
+	m_syncCount = 0;
+}
+
+/***********************************************************
+ *  ~ShaderPermutations()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderPermutations::~ShaderPermutations()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to read the sources of the scene
+ *  shaders.  Nothing is compiled until a variant is asked
+ *  for.  The uniforms of the variants are copied from the
+ *  passed in uber shader.
+ ***********************************************************/
+bool ShaderPermutations::Create(
+	ShaderManager* pSourceShaderManager,
+	const char* vertexShaderPath,
+	const char* fragmentShaderPath)
+{
+	Destroy();
+	m_pSourceShaderManager = pSourceShaderManager;
+
+	if ((ReadTextFile(vertexShaderPath, m_vertexSource) == false) ||
+		(ReadTextFile(fragmentShaderPath, m_fragmentSource) == false))
+	{
+		std::cerr << "ERROR: Shader sources for the variants could not be read" << std::endl;
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  LoadMultiViewShader()
+ *
+ *  This method is used to read the source of the geometry
+ *  shader that the multi-view variants are compiled with.
+ *  It selects the viewport of each view and runs once per
+ *  view, so it needs viewport arrays and geometry shader
+ *  invocations (GL 4.1).
+ ***********************************************************/
+bool ShaderPermutations::LoadMultiViewShader(const char* geometryShaderPath)
+{
+	m_geometrySource.clear();
+	if (!GLEW_VERSION_4_1 && (!GLEW_ARB_viewport_array || !GLEW_ARB_gpu_shader5))
+	{
+		std::cout << "WARNING: Viewport arrays are not supported, multi-view rendering is off" << std::endl;
+		return(false);
+	}
+
+	if (ReadTextFile(geometryShaderPath, m_geometrySource) == false)
+	{
+		std::cerr << "ERROR: Multi-view geometry shader could not be read" << std::endl;
+		m_geometrySource.clear();
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to delete the compiled variants.
+ ***********************************************************/
+void ShaderPermutations::Destroy()
+{
+	for (auto& entry : m_variants)
+	{
+		SHADER_VARIANT* pVariant = entry.second;
+		glDeleteProgram(pVariant->pShaderManager->m_programID);
+		pVariant->pShaderManager->m_programID = 0;
+		GLStateCache::InvalidateUniforms(pVariant->pShaderManager);
+		delete pVariant->pShaderManager;
+		delete pVariant;
+	}
+	m_variants.clear();
+	m_failedMasks.clear();
+}
+
+/***********************************************************
+ *  GetVariant()
+ *
+ *  This method is used to look up the variant of a feature
+ *  mask, compiling it the first time it is needed.
+ ***********************************************************/
+ShaderManager* ShaderPermutations::GetVariant(unsigned int featureMask)
+{
+	auto found = m_variants.find(featureMask);
+	if (found != m_variants.end())
+	{
+		return(found->second->pShaderManager);
+	}
+	if (std::find(m_failedMasks.begin(), m_failedMasks.end(), featureMask) != m_failedMasks.end())
+	{
+		return(NULL);
+	}
+
+	double startTime = TraceProfiler::NowMilliseconds();
+	GLuint programID = CompileVariant(featureMask);
+	m_compileMilliseconds += TraceProfiler::NowMilliseconds() - startTime;
+	if (programID == 0)
+	{
+		m_failedMasks.push_back(featureMask);
+		return(NULL);
+	}
+
+	SHADER_VARIANT* pVariant = new SHADER_VARIANT();
+	pVariant->featureMask = featureMask;
+	pVariant->pShaderManager = new ShaderManager();
+	pVariant->pShaderManager->m_programID = programID;
+	pVariant->sourceProgram = 0;
+	m_variants[featureMask] = pVariant;
+
+	// a variant built in the middle of a frame needs the values
+	// that the uber shader already holds; the caller binds it next
+	if (NULL != m_pSourceShaderManager)
+	{
+		SyncVariant(pVariant);
+	}
+	return(pVariant->pShaderManager);
+}
+
+/***********************************************************
+ *  CompileVariant()
+ *
+ *  This method is used to build the program of a variant.
+ *  Only the fragment shader is specialized; the multi-view
+ *  variants also rename the vertex shader's outputs for the
+ *  geometry shader between the two.
+ ***********************************************************/
+GLuint ShaderPermutations::CompileVariant(unsigned int featureMask) const
+{
+	int pointLightCount = (featureMask >> LIGHT_COUNT_SHIFT) & LIGHT_COUNT_BITS;
+	std::ostringstream defines;
+	defines << "#define SPECIALIZED 1\n"
+		<< "#define VARIANT_TEXTURED " << (((featureMask & FEATURE_TEXTURED) != 0) ? 1 : 0) << "\n"
+		<< "#define VARIANT_LIT " << (((featureMask & FEATURE_LIT) != 0) ? 1 : 0) << "\n"
+		<< "#define VARIANT_POINT_LIGHTS " << ((pointLightCount == RUNTIME_LIGHTS) ? -1 : pointLightCount) << "\n";
+
+	bool bMultiView = (featureMask & FEATURE_MULTI_VIEW) != 0;
+	if ((bMultiView == true) && (m_geometrySource.empty() == true))
+	{
+		return(0);
+	}
+	std::string vertexDefines = bMultiView ? "#define MULTI_VIEW 1\n" : "";
+	if (bMultiView == true)
+	{
+		defines << "#define MULTI_VIEW 1\n";
+	}
+
+	GLuint vertexShaderID = CompileShader(GL_VERTEX_SHADER, m_vertexSource, vertexDefines);
+	GLuint fragmentShaderID = CompileShader(GL_FRAGMENT_SHADER, m_fragmentSource, defines.str());
+	GLuint geometryShaderID = bMultiView ? CompileShader(GL_GEOMETRY_SHADER, m_geometrySource, "") : 0;
+	if ((vertexShaderID == 0) || (fragmentShaderID == 0) || ((bMultiView == true) && (geometryShaderID == 0)))
+	{
+		glDeleteShader(vertexShaderID);
+		glDeleteShader(fragmentShaderID);
+		glDeleteShader(geometryShaderID);
+		return(0);
+	}
+
+	GLuint programID = glCreateProgram();
+	glAttachShader(programID, vertexShaderID);
+	glAttachShader(programID, fragmentShaderID);
+	if (bMultiView == true)
+	{
+		glAttachShader(programID, geometryShaderID);
+	}
+	glLinkProgram(programID);
+	glDeleteShader(vertexShaderID);
+	glDeleteShader(fragmentShaderID);
+	glDeleteShader(geometryShaderID);
+
+	GLint bLinked = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &bLinked);
+	if (bLinked == GL_FALSE)
+	{
+		GLchar log[1024];
+		glGetProgramInfoLog(programID, sizeof(log), NULL, log);
+		std::cerr << "ERROR: Shader variant " << featureMask << " failed to link:\n" << log << std::endl;
+		glDeleteProgram(programID);
+		return(0);
+	}
+
+	std::cout << "INFO: Compiled shader variant " << featureMask << " (textured "
+		<< (((featureMask & FEATURE_TEXTURED) != 0) ? 1 : 0) << ", lit "
+		<< (((featureMask & FEATURE_LIT) != 0) ? 1 : 0) << ", point lights "
+		<< ((pointLightCount == RUNTIME_LIGHTS) ? std::string("run time") : std::to_string(pointLightCount))
+		<< (bMultiView ? ", multi-view" : "") << ")" << std::endl;
+	return(programID);
+}
+
+/***********************************************************
+ *  BuildUniformTable()
+ *
+ *  This method is used to pair every active uniform of the
+ *  variant with the same uniform of the uber shader.
+ *  Arrays of basic types are paired element by element, by
+ *  the name the state cache knows them by.
+ ***********************************************************/
+void ShaderPermutations::BuildUniformTable(SHADER_VARIANT* pVariant, GLuint sourceProgram)
+{
+	pVariant->uniforms.clear();
+	pVariant->sourceProgram = sourceProgram;
+
+	GLuint targetProgram = pVariant->pShaderManager->m_programID;
+	GLint uniformCount = 0;
+	glGetProgramiv(targetProgram, GL_ACTIVE_UNIFORMS, &uniformCount);
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLchar name[256];
+		GLint arraySize = 0;
+		GLenum type = 0;
+		glGetActiveUniform(targetProgram, (GLuint)i, sizeof(name), NULL, &arraySize, &type, name);
+		if (GetComponentCount(type) == 0)
+		{
+			continue;
+		}
+
+		std::string baseName = name;
+		size_t bracket = baseName.rfind("[0]");
+		if ((arraySize > 1) && (bracket == baseName.size() - 3))
+		{
+			baseName = baseName.substr(0, bracket);
+		}
+
+		for (GLint element = 0; element < arraySize; element++)
+		{
+			std::string elementName = (arraySize > 1) ? baseName + "[" + std::to_string(element) + "]" : baseName;
+			UNIFORM_COPY copy;
+			copy.name = elementName;
+			copy.targetLocation = glGetUniformLocation(targetProgram, elementName.c_str());
+			copy.type = type;
+			copy.bValid = false;
+			memset(&copy.value, 0, sizeof(copy.value));
+			if ((glGetUniformLocation(sourceProgram, elementName.c_str()) >= 0) && (copy.targetLocation >= 0))
+			{
+				pVariant->uniforms.push_back(copy);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  ReadUniform()
+ *
+ *  This method is used to look a uniform of the uber shader
+ *  up in the state cache and to report whether it differs
+ *  from the value copied the last time.  Nothing is read
+ *  back from GL; a uniform the cache does not hold was never
+ *  set, or not since the cache forgot it, and the variant
+ *  keeps its value.
+ ***********************************************************/
+bool ShaderPermutations::ReadUniform(UNIFORM_COPY& copy) const
+{
+	UNIFORM_DATA value;
+	size_t size = GetComponentCount(copy.type) * sizeof(GLint);
+	if (GLStateCache::GetUniform(m_pSourceShaderManager, copy.name, &value, size) == false)
+	{
+		return(false);
+	}
+
+	if ((copy.bValid == true) && (memcmp(&copy.value, &value, size) == 0))
+	{
+		return(false);
+	}
+	memcpy(&copy.value, &value, size);
+	copy.bValid = true;
+	return(true);
+}
+
+/***********************************************************
+ *  WriteUniform()
+ *
+ *  This method is used to set a copied value on the bound
+ *  variant program, with the same entry points that the
+ *  shader manager uses, so that a GLCapture trace holds the
+ *  copies too.
+ ***********************************************************/
+void ShaderPermutations::WriteUniform(const UNIFORM_COPY& copy)
+{
+	GLint location = copy.targetLocation;
+	const UNIFORM_DATA& value = copy.value;
+	switch (copy.type)
+	{
+	case GL_FLOAT: glUniform1f(location, value.floats[0]); break;
+	case GL_FLOAT_VEC2: glUniform2fv(location, 1, value.floats); break;
+	case GL_FLOAT_VEC3: glUniform3fv(location, 1, value.floats); break;
+	case GL_FLOAT_VEC4: glUniform4fv(location, 1, value.floats); break;
+	case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, value.floats); break;
+	default:
+		// int, bool and the sampler units
+		glUniform1i(location, value.ints[0]);
+		break;
+	}
+}
+
+/***********************************************************
+ *  SyncUniforms()
+ *
+ *  This method is used to bring the variants up to date with
+ *  the uber shader, which is where the lights, the shadow
+ *  and cluster settings and the camera are set.  Only the
+ *  values that changed since the last copy are written, and
+ *  the state cache forgets the uniforms of every variant
+ *  that was written to.  The uber shader is bound again
+ *  afterwards.
+ ***********************************************************/
+void ShaderPermutations::SyncUniforms()
+{
+	if ((NULL == m_pSourceShaderManager) || (m_variants.empty() == true))
+	{
+		return;
+	}
+
+	bool bBound = false;
+	for (auto& entry : m_variants)
+	{
+		bBound |= SyncVariant(entry.second);
+	}
+	m_syncCount++;
+
+	if (bBound == true)
+	{
+		GLStateCache::UseProgram(m_pSourceShaderManager);
+	}
+}
+
+/***********************************************************
+ *  SyncVariant()
+ *
+ *  This method is used to copy the changed uniforms of the
+ *  uber shader into one variant.  Returns true when the
+ *  variant had to be bound for it.
+ ***********************************************************/
+bool ShaderPermutations::SyncVariant(SHADER_VARIANT* pVariant)
+{
+	GLuint sourceProgram = m_pSourceShaderManager->m_programID;
+	if (pVariant->sourceProgram != sourceProgram)
+	{
+		BuildUniformTable(pVariant, sourceProgram);
+	}
+
+	bool bChanged = false;
+	for (size_t i = 0; i < pVariant->uniforms.size(); i++)
+	{
+		UNIFORM_COPY& copy = pVariant->uniforms[i];
+		if (ReadUniform(copy) == false)
+		{
+			continue;
+		}
+		if (bChanged == false)
+		{
+			GLStateCache::UseProgram(pVariant->pShaderManager);
+			bChanged = true;
+		}
+		WriteUniform(copy);
+		m_copiedUniforms++;
+	}
+	if (bChanged == true)
+	{
+		GLStateCache::InvalidateUniforms(pVariant->pShaderManager);
+	}
+	return(bChanged);
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used to print how many variants were
+ *  compiled, what they cost to build and how many uniform
+ *  values had to be copied into them per frame.
+ ***********************************************************/
+void ShaderPermutations::PrintStats() const
+{
+	if (m_syncCount == 0)
+	{
+		return;
+	}
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< "INFO: Shader permutations: " << m_variants.size() << " variants compiled in "
+		<< m_compileMilliseconds << " ms, " << (double)m_copiedUniforms / m_syncCount
+		<< " uniforms copied per frame" << std::endl;
+}
@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderpermutations.h
+// ============
+// specialized variants of the scene shader - the texture and lighting
+// switches and the active point light count are compiled in through
+// preprocessor defines, one program per feature mask, built on first use
+//
+//  The variants are driven through ShaderManager objects of their own, so
+//  the rest of the scene code sets their uniforms like any other program.
+//  Uniforms set once or once per frame on the uber shader are copied into
+//  the variants by SyncUniforms() before they are drawn with.  The values
+//  come from GLStateCache's copy, so every uniform of the uber shader has
+//  to be set through the state cache.
+//
+//  Multi-view variants add the multi-view geometry shader, which draws
+//  every triangle into the tile of each camera of the pass.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <GL/glew.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/***********************************************************
+ *  ShaderPermutations
+ *
+ *  This class owns the shader sources and the cache of the
+ *  compiled variants.
+ ***********************************************************/
+class ShaderPermutations
+{
+public:
+	enum FEATURE_BITS
+	{
+		FEATURE_TEXTURED = 1 << 0,
+		FEATURE_LIT = 1 << 1,
+		// above the point light count
+		FEATURE_MULTI_VIEW = 1 << 5
+	};
+
+	// the point light count is stored above the feature bits
+	static const int LIGHT_COUNT_SHIFT = 2;
+	static const int LIGHT_COUNT_BITS = 0x7;
+	// light count of the variants that keep the point light mode
+	// branches - the light buffer modes, or fixed lights that are
+	// not all at the front of the array
+	static const int RUNTIME_LIGHTS = 7;
+
+	// build the feature mask of a draw
+	static unsigned int MakeFeatureMask(bool bTextured, bool bLit, int pointLightCount);
+
+	// constructor
+	ShaderPermutations();
+	// destructor
+	~ShaderPermutations();
+
+	// read the shader sources the variants are compiled from; the
+	// variants take their uniform values from the uber shader
+	bool Create(
+		ShaderManager* pSourceShaderManager,
+		const char* vertexShaderPath,
+		const char* fragmentShaderPath);
+	// read the geometry shader of the multi-view variants - false
+	// when it cannot be read or the GL has no viewport arrays
+	bool LoadMultiViewShader(const char* geometryShaderPath);
+	bool IsMultiViewLoaded() const { return !m_geometrySource.empty(); }
+	// delete every variant
+	void Destroy();
+
+	// variant of the feature mask, compiled on first use - NULL when
+	// it does not compile, and the uber shader has to be used
+	ShaderManager* GetVariant(unsigned int featureMask);
+	// copy the uniform values of the uber shader into the variants -
+	// called once per frame after the frame's uniforms are set
+	void SyncUniforms();
+
+	int GetVariantCount() const { return (int)m_variants.size(); }
+	// print the compiled variants, their compile time and the
+	// uniforms copied into them
+	void PrintStats() const;
+
+private:
+	// current value of one uniform, as the state cache holds it
+	union UNIFORM_DATA
+	{
+		GLfloat floats[16];
+		GLint ints[16];
+	};
+
+	struct UNIFORM_COPY
+	{
+		std::string name;
+		GLint targetLocation;
+		GLenum type;
+		bool bValid;
+		UNIFORM_DATA value;
+	};
+
+	struct SHADER_VARIANT
+	{
+		unsigned int featureMask;
+		ShaderManager* pShaderManager;
+		// built against the program the uniforms are copied from
+		GLuint sourceProgram;
+		std::vector<UNIFORM_COPY> uniforms;
+	};
+
+	ShaderManager* m_pSourceShaderManager;
+	std::string m_vertexSource;
+	std::string m_fragmentSource;
+	std::string m_geometrySource;
+	std::unordered_map<unsigned int, SHADER_VARIANT*> m_variants;
+	// masks whose variant failed to compile, so it is not retried
+	std::vector<unsigned int> m_failedMasks;
+
+	// statistics
+	double m_compileMilliseconds;
+	long long m_copiedUniforms;
+	int m_syncCount;
+
+	// compile and link the variant of the feature mask
+	GLuint CompileVariant(unsigned int featureMask) const;
+	// match the active uniforms of the variant with the source
+	void BuildUniformTable(SHADER_VARIANT* pVariant, GLuint sourceProgram);
+	// copy the changed uniforms into one variant
+	bool SyncVariant(SHADER_VARIANT* pVariant);
+	// read the value of the source uniform, true when it changed
+	bool ReadUniform(UNIFORM_COPY& copy) const;
+	static void WriteUniform(const UNIFORM_COPY& copy);
+};
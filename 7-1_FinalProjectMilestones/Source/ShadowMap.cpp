@@ -0,0 +1,315 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmap.cpp
+// ============
+// depth render target for the static directional light, with timing of the
+// shadow pass so that cached and re-rendered frames can be compared
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadowMap.h"
+#include "GLStateCache.h"
+#include "TraceProfiler.h"
+
+#include <iostream>
+
+// GLM Math Header inclusions
+#include <glm/gtx/transform.hpp>
+
+/***********************************************************
+ *  ShadowMap()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadowMap::ShadowMap()
+{
+	m_framebufferID = 0;
+	m_depthTextureID = 0;
+	m_resolution = 0;
+	m_lightSpaceMatrix = glm::mat4(1.0f);
+	m_savedFramebuffer = 0;
+	m_savedViewport[0] = m_savedViewport[1] = m_savedViewport[2] = m_savedViewport[3] = 0;
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		m_timerQueryIDs[i] = 0;
+		m_bTimerPending[i] = false;
+	}
+	m_timerIndex = 0;
+	m_bTimerActive = false;
+	m_renderStartTime = 0.0;
+	m_renderCount = 0;
+	m_gpuSampleCount = 0;
+	m_totalRenderCpuMs = 0.0;
+	m_totalRenderGpuMs = 0.0;
+	m_cachedFrameCount = 0;
+	m_totalCachedCpuMs = 0.0;
+}
+
+/***********************************************************
+ *  ~ShadowMap()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadowMap::~ShadowMap()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to create the depth texture with
+ *  hardware depth comparison enabled, and the framebuffer
+ *  object that renders into it.
+ ***********************************************************/
+bool ShadowMap::Create(int resolution)
+{
+	Destroy();
+
+	m_resolution = resolution;
+
+	glGenTextures(1, &m_depthTextureID);
+	glBindTexture(GL_TEXTURE_2D, m_depthTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, resolution, resolution, 0,
+		GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+
+	// linear filtering with depth comparison gives a free 2x2 PCF
+	// on every tap of the sampler2DShadow lookup
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	// samples outside of the light frustum read as fully lit
+	const float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	glGenFramebuffers(1, &m_framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTextureID, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "ERROR: Shadow map framebuffer is incomplete, status: 0x" << std::hex << status << std::dec << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	glGenQueries(TIMER_FRAMES, m_timerQueryIDs);
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		m_bTimerPending[i] = false;
+	}
+	m_timerIndex = 0;
+
+	std::cout << "INFO: Shadow map created, resolution: " << resolution << "x" << resolution << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to free the shadow map GL objects.
+ ***********************************************************/
+void ShadowMap::Destroy()
+{
+	if (m_timerQueryIDs[0] != 0)
+	{
+		glDeleteQueries(TIMER_FRAMES, m_timerQueryIDs);
+		for (int i = 0; i < TIMER_FRAMES; i++)
+		{
+			m_timerQueryIDs[i] = 0;
+			m_bTimerPending[i] = false;
+		}
+	}
+	if (m_framebufferID != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebufferID);
+		m_framebufferID = 0;
+	}
+	if (m_depthTextureID != 0)
+	{
+		glDeleteTextures(1, &m_depthTextureID);
+		m_depthTextureID = 0;
+	}
+}
+
+/***********************************************************
+ *  SetLight()
+ *
+ *  This method is used to build the light space matrix - an
+ *  orthographic projection looking down the light direction
+ *  that encloses a bounding sphere around the scene.
+ ***********************************************************/
+void ShadowMap::SetLight(
+	const glm::vec3& lightDirection,
+	const glm::vec3& sceneCenter,
+	float sceneRadius)
+{
+	glm::vec3 direction = glm::normalize(lightDirection);
+
+	// avoid a degenerate view matrix for a straight down light
+	glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+	if (glm::abs(glm::dot(direction, up)) > 0.99f)
+	{
+		up = glm::vec3(0.0f, 0.0f, 1.0f);
+	}
+
+	glm::vec3 eye = sceneCenter - direction * (sceneRadius * 2.0f);
+	glm::mat4 lightView = glm::lookAt(eye, sceneCenter, up);
+	glm::mat4 lightProjection = glm::ortho(
+		-sceneRadius, sceneRadius,
+		-sceneRadius, sceneRadius,
+		sceneRadius * 0.5f, sceneRadius * 3.5f);
+
+	m_lightSpaceMatrix = lightProjection * lightView;
+}
+
+/***********************************************************
+ *  BeginRender()
+ *
+ *  This method is used to redirect rendering into the
+ *  shadow map before the depth pass is drawn.
+ ***********************************************************/
+void ShadowMap::BeginRender()
+{
+	CollectTimerQueries();
+
+	m_renderStartTime = TraceProfiler::NowMilliseconds();
+	m_bTimerActive = !m_bTimerPending[m_timerIndex];
+	if (m_bTimerActive)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, m_timerQueryIDs[m_timerIndex]);
+	}
+
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebufferID);
+	glViewport(0, 0, m_resolution, m_resolution);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	// slope scaled depth offset to keep surfaces from shadowing themselves
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+}
+
+/***********************************************************
+ *  EndRender()
+ *
+ *  This method is used to restore the framebuffer and the
+ *  viewport after the depth pass has been drawn.
+ ***********************************************************/
+void ShadowMap::EndRender()
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_savedFramebuffer);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+
+	if (m_bTimerActive)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		m_bTimerPending[m_timerIndex] = true;
+		m_bTimerActive = false;
+	}
+	m_timerIndex = (m_timerIndex + 1) % TIMER_FRAMES;
+
+	m_totalRenderCpuMs += TraceProfiler::NowMilliseconds() - m_renderStartTime;
+	m_renderCount++;
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used to bind the shadow depth texture to
+ *  the passed in texture unit for the lighting pass.
+ ***********************************************************/
+void ShadowMap::BindTexture(int textureUnit) const
+{
+	GLStateCache::BindTexture2D(textureUnit, m_depthTextureID);
+}
+
+/***********************************************************
+ *  RecordCachedFrame()
+ *
+ *  This method is used to account for a frame in which the
+ *  cached shadow map was reused instead of re-rendered.
+ ***********************************************************/
+void ShadowMap::RecordCachedFrame(double cpuMilliseconds)
+{
+	m_cachedFrameCount++;
+	m_totalCachedCpuMs += cpuMilliseconds;
+
+	// pick up the GPU time of the last real renders once ready
+	CollectTimerQueries();
+}
+
+/***********************************************************
+ *  CollectTimerQueries()
+ *
+ *  This method is used to read back the GPU time of every
+ *  depth pass whose query result is already available, so
+ *  the CPU never stalls on the GPU.
+ ***********************************************************/
+void ShadowMap::CollectTimerQueries()
+{
+	for (int i = 0; i < TIMER_FRAMES; i++)
+	{
+		if (!m_bTimerPending[i])
+		{
+			continue;
+		}
+
+		GLint available = 0;
+		glGetQueryObjectiv(m_timerQueryIDs[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0)
+		{
+			continue;
+		}
+
+		GLuint64 elapsedNanoseconds = 0;
+		glGetQueryObjectui64v(m_timerQueryIDs[i], GL_QUERY_RESULT, &elapsedNanoseconds);
+		m_totalRenderGpuMs += (double)elapsedNanoseconds / 1000000.0;
+		m_gpuSampleCount++;
+		m_bTimerPending[i] = false;
+	}
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used to print the average cost of a frame
+ *  that re-rendered the shadow map against a frame that
+ *  reused the cached one.
+ ***********************************************************/
+void ShadowMap::PrintStats() const
+{
+	std::cout << "INFO: Shadow pass statistics (" << m_resolution << "x" << m_resolution << ")\n";
+	if (m_renderCount > 0)
+	{
+		std::cout << "  uncached frames: " << m_renderCount
+			<< ", avg CPU " << (m_totalRenderCpuMs / m_renderCount) << " ms";
+		if (m_gpuSampleCount > 0)
+		{
+			std::cout << ", avg GPU " << (m_totalRenderGpuMs / m_gpuSampleCount) << " ms";
+		}
+		std::cout << "\n";
+	}
+	if (m_cachedFrameCount > 0)
+	{
+		std::cout << "  cached frames:   " << m_cachedFrameCount
+			<< ", avg CPU " << (m_totalCachedCpuMs / m_cachedFrameCount) << " ms to bind the map, no depth pass\n";
+	}
+	std::cout << std::endl;
+}
@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmap.h
+// ============
+// depth render target for the static directional light, with timing of the
+// shadow pass so that cached and re-rendered frames can be compared
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+/***********************************************************
+ *  ShadowMap
+ *
+ *  This class owns the framebuffer and depth texture that
+ *  the directional light's shadow map is rendered into.
+ ***********************************************************/
+class ShadowMap
+{
+public:
+	// PCF filtering quality levels - the value passed to the
+	// shader is the PCF kernel radius (quality - 1)
+	enum SHADOW_QUALITY
+	{
+		SHADOW_OFF = 0,
+		SHADOW_HARD,		// single hardware-filtered tap
+		SHADOW_PCF_3X3,		// 9 taps
+		SHADOW_PCF_5X5		// 25 taps
+	};
+
+	// constructor
+	ShadowMap();
+	// destructor
+	~ShadowMap();
+
+	// create the depth texture and framebuffer
+	bool Create(int resolution);
+	// free the depth texture and framebuffer
+	void Destroy();
+
+	// fit an orthographic light frustum around the scene bounds
+	void SetLight(
+		const glm::vec3& lightDirection,
+		const glm::vec3& sceneCenter,
+		float sceneRadius);
+	glm::mat4 GetLightSpaceMatrix() const { return m_lightSpaceMatrix; }
+
+	// bind the shadow framebuffer for the depth pass and restore
+	// the previous framebuffer and viewport afterwards
+	void BeginRender();
+	void EndRender();
+
+	// bind the depth texture to the passed in texture unit
+	void BindTexture(int textureUnit) const;
+
+	// called once per frame in which the cached map was reused, with
+	// the CPU time spent binding it for the shading pass
+	void RecordCachedFrame(double cpuMilliseconds);
+
+	// print the cached versus uncached shadow pass cost
+	void PrintStats() const;
+
+	int GetResolution() const { return m_resolution; }
+
+private:
+	GLuint m_framebufferID;
+	GLuint m_depthTextureID;
+	int m_resolution;
+	glm::mat4 m_lightSpaceMatrix;
+
+	// saved state restored by EndRender()
+	GLint m_savedFramebuffer;
+	GLint m_savedViewport[4];
+
+	// ring of GPU timer queries for the depth pass - a query is
+	// read back once its result is available, and a render finding
+	// its slot still pending goes untimed instead of waiting
+	static const int TIMER_FRAMES = 4;
+	GLuint m_timerQueryIDs[TIMER_FRAMES];
+	bool m_bTimerPending[TIMER_FRAMES];
+	int m_timerIndex;
+	bool m_bTimerActive;
+	double m_renderStartTime;
+
+	// accumulated shadow pass statistics
+	uint64_t m_renderCount;
+	uint64_t m_gpuSampleCount;
+	double m_totalRenderCpuMs;
+	double m_totalRenderGpuMs;
+	uint64_t m_cachedFrameCount;
+	double m_totalCachedCpuMs;
+
+	// collect the GPU time of every depth pass that is ready
+	void CollectTimerQueries();
+};
@@ -0,0 +1,1324 @@
+///////////////////////////////////////////////////////////////////////////////
+// softwarerasterizer.cpp
+// ============
+// CPU render backend for hosts without a GPU - the recorded draw items are
+// transformed and set up on a pool of threads, binned into screen tiles and
+// rasterized tile by tile with SIMD edge functions and a hierarchical depth
+// test, into a color buffer that is blitted to the window or saved
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SoftwareRasterizer.h"
+#include "GLStateCache.h"
+#include "ShapeMeshes.h"
+#include "TextureStreamer.h"
+#include "TraceProfiler.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+
+// SSE2 is part of every x64 target; other targets use the scalar loops
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SOFTWARE_RASTERIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+// declaration of the global variables and defines
+namespace
+{
+	// draws per setup job - small enough to spread a desk's 150
+	// draws over the threads
+	const int SETUP_CHUNK_DRAWS = 8;
+	// a light reaches the pixels where its strongest channel is
+	// still above this intensity, like the clustered lights
+	const float LIGHT_CUTOFF_INTENSITY = 1.0f / 256.0f;
+	// triangles with a smaller doubled area in pixels are dropped
+	const float MIN_TRIANGLE_AREA = 1.0e-6f;
+
+	// tessellation of the round meshes
+	const int ROUND_SLICES = 48;
+	const int SPHERE_STACKS = 24;
+	const int TORUS_SIDES = 16;
+	// top radius of the tapered cylinder mesh, the bottom radius is 1
+	const float TAPERED_TOP_RADIUS = 0.5f;
+	// the torus ring lies in the XY plane - with the tube, it fills
+	// the 2.4 unit bounds the scene assumes for the mesh
+	const float TORUS_MAIN_RADIUS = 1.0f;
+	const float TORUS_TUBE_RADIUS = 0.2f;
+
+	const float PI = 3.14159265f;
+
+	/***********************************************************
+	 *  BoxDistanceSquared()
+	 *
+	 *  Squared distance from a point to an axis aligned box,
+	 *  zero inside it.
+	 ***********************************************************/
+	float BoxDistanceSquared(const glm::vec3& point, const glm::vec3& minPoint, const glm::vec3& maxPoint)
+	{
+		glm::vec3 closest = glm::min(glm::max(point, minPoint), maxPoint);
+		glm::vec3 offset = point - closest;
+		return(glm::dot(offset, offset));
+	}
+
+	/***********************************************************
+	 *  LerpVertex()
+	 *
+	 *  Vertex at t along the clip space segment from a to b.
+	 ***********************************************************/
+	template <typename VERTEX_TYPE>
+	VERTEX_TYPE LerpVertex(const VERTEX_TYPE& a, const VERTEX_TYPE& b, float t)
+	{
+		VERTEX_TYPE result;
+		result.clipPosition = a.clipPosition + (b.clipPosition - a.clipPosition) * t;
+		result.worldPosition = a.worldPosition + (b.worldPosition - a.worldPosition) * t;
+		result.worldNormal = a.worldNormal + (b.worldNormal - a.worldNormal) * t;
+		result.uv = a.uv + (b.uv - a.uv) * t;
+		return(result);
+	}
+}
+
+/***********************************************************
+ *  SoftwareRasterizer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SoftwareRasterizer::SoftwareRasterizer()
+{
+	m_width = 0;
+	m_height = 0;
+	m_stride = 0;
+	m_paddedHeight = 0;
+	m_tilesX = 0;
+	m_tilesY = 0;
+	m_blocksX = 0;
+	m_pRenderQueue = NULL;
+	m_jobType = JOB_SETUP;
+	m_jobCount = 0;
+	m_jobGeneration = 0;
+	m_busyWorkers = 0;
+	m_bStopping = false;
+	m_nextJob = 0;
+	m_textureID = 0;
+	m_framebufferID = 0;
+	m_stats = RASTER_STATS();
+
+	BuildMeshes();
+}
+
+/***********************************************************
+ *  ~SoftwareRasterizer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SoftwareRasterizer::~SoftwareRasterizer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to allocate the color and depth
+ *  buffers, the texture and framebuffer they are blitted
+ *  through, and to start the worker threads.  The calling
+ *  thread takes jobs as well, so one thread less is started
+ *  than the thread count.
+ ***********************************************************/
+bool SoftwareRasterizer::Create(int width, int height, int threadCount)
+{
+	Destroy();
+
+	if ((width <= 0) || (height <= 0))
+	{
+		return(false);
+	}
+
+	m_width = width;
+	m_height = height;
+	m_stride = (width + DEPTH_BLOCK_SIZE - 1) / DEPTH_BLOCK_SIZE * DEPTH_BLOCK_SIZE;
+	m_paddedHeight = (height + DEPTH_BLOCK_SIZE - 1) / DEPTH_BLOCK_SIZE * DEPTH_BLOCK_SIZE;
+	m_tilesX = (m_stride + TILE_SIZE - 1) / TILE_SIZE;
+	m_tilesY = (m_paddedHeight + TILE_SIZE - 1) / TILE_SIZE;
+	m_blocksX = m_stride / DEPTH_BLOCK_SIZE;
+
+	m_colorBuffer.assign((size_t)m_stride * m_paddedHeight * 4, 0);
+	m_depthBuffer.assign((size_t)m_stride * m_paddedHeight, 1.0f);
+	m_blockMaxDepth.assign((size_t)m_blocksX * (m_paddedHeight / DEPTH_BLOCK_SIZE), 1.0f);
+	m_tileBins.assign(m_tilesX * m_tilesY, std::vector<const TRIANGLE*>());
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	glActiveTexture(GL_TEXTURE0 + TextureStreamer::UPLOAD_TEXTURE_UNIT);
+	glGenTextures(1, &m_textureID);
+	glBindTexture(GL_TEXTURE_2D, m_textureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	GLStateCache::InvalidateTextures();
+
+	glGenFramebuffers(1, &m_framebufferID);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferID);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_textureID, 0);
+	GLenum status = glCheckFramebufferStatus(GL_READ_FRAMEBUFFER);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "ERROR: Software rasterizer framebuffer is incomplete, status: 0x" << std::hex << status << std::dec << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	if (threadCount <= 0)
+	{
+		threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+	}
+	m_bStopping = false;
+	for (int i = 1; i < threadCount; i++)
+	{
+		m_workers.push_back(std::thread(&SoftwareRasterizer::WorkerMain, this));
+	}
+	m_stats.threadCount = threadCount;
+
+	std::cout << "INFO: Software rasterizer " << width << "x" << height << ", "
+		<< m_tilesX * m_tilesY << " tiles, " << threadCount << " threads" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to stop the worker threads and free
+ *  the buffers and the GL objects.
+ ***********************************************************/
+void SoftwareRasterizer::Destroy()
+{
+	if (m_workers.empty() == false)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_jobMutex);
+			m_bStopping = true;
+		}
+		m_jobCondition.notify_all();
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
+		}
+		m_workers.clear();
+	}
+
+	if (m_framebufferID != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebufferID);
+		m_framebufferID = 0;
+	}
+	if (m_textureID != 0)
+	{
+		glDeleteTextures(1, &m_textureID);
+		m_textureID = 0;
+	}
+
+	m_colorBuffer.clear();
+	m_depthBuffer.clear();
+	m_blockMaxDepth.clear();
+	m_tileBins.clear();
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  LoadTextures()
+ *
+ *  This method is used to decode the scene textures into
+ *  RGBA texels.  The images are flipped on load like the
+ *  streamed GL textures, so the UVs address the same texels.
+ ***********************************************************/
+void SoftwareRasterizer::LoadTextures(const std::vector<std::string>& filenames)
+{
+	TRACE_SCOPE("LoadSoftwareTextures");
+
+	m_textures.clear();
+	stbi_set_flip_vertically_on_load(true);
+	for (const std::string& filename : filenames)
+	{
+		TEXTURE texture;
+		texture.width = 0;
+		texture.height = 0;
+
+		int colorChannels = 0;
+		unsigned char* image = stbi_load(filename.c_str(), &texture.width, &texture.height, &colorChannels, 4);
+		if (image)
+		{
+			texture.texels.assign(image, image + (size_t)texture.width * texture.height * 4);
+			stbi_image_free(image);
+		}
+		else
+		{
+			std::cout << "WARNING: Software rasterizer could not load the texture: " << filename << std::endl;
+		}
+		m_textures.push_back(texture);
+	}
+}
+
+/***********************************************************
+ *  BuildMeshes()
+ *
+ *  This method is used to tessellate the basic meshes in
+ *  object space, with the sizes of the ShapeMeshes meshes:
+ *  the plane and sphere span -1 to 1, the box -0.5 to 0.5,
+ *  and the cylinders have a radius of 1 from 0 to 1 in Y.
+ ***********************************************************/
+void SoftwareRasterizer::BuildMeshes()
+{
+	m_meshes.assign(MESH_ID_COUNT, MESH());
+
+	auto addVertex = [](MESH& mesh, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& uv)
+	{
+		VERTEX vertex;
+		vertex.position = position;
+		vertex.normal = normal;
+		vertex.uv = uv;
+		mesh.vertices.push_back(vertex);
+	};
+	// two triangles for every cell of a rows x columns grid of
+	// vertices that was added row by row
+	auto addGrid = [](MESH& mesh, unsigned int firstVertex, int rows, int columns)
+	{
+		const int rowLength = columns + 1;
+		for (int row = 0; row < rows; row++)
+		{
+			for (int column = 0; column < columns; column++)
+			{
+				unsigned int topLeft = firstVertex + row * rowLength + column;
+				unsigned int bottomLeft = topLeft + rowLength;
+				mesh.indices.push_back(topLeft);
+				mesh.indices.push_back(bottomLeft);
+				mesh.indices.push_back(topLeft + 1);
+				mesh.indices.push_back(topLeft + 1);
+				mesh.indices.push_back(bottomLeft);
+				mesh.indices.push_back(bottomLeft + 1);
+			}
+		}
+	};
+	// a quad from its center, the half extents along U and V and
+	// its normal
+	auto addQuad = [&](MESH& mesh, const glm::vec3& center, const glm::vec3& halfU, const glm::vec3& halfV, const glm::vec3& normal)
+	{
+		unsigned int firstVertex = (unsigned int)mesh.vertices.size();
+		addVertex(mesh, center - halfU - halfV, normal, glm::vec2(0.0f, 0.0f));
+		addVertex(mesh, center + halfU - halfV, normal, glm::vec2(1.0f, 0.0f));
+		addVertex(mesh, center - halfU + halfV, normal, glm::vec2(0.0f, 1.0f));
+		addVertex(mesh, center + halfU + halfV, normal, glm::vec2(1.0f, 1.0f));
+		addGrid(mesh, firstVertex, 1, 1);
+	};
+	// a disc of the passed in radius at height y, facing up or down
+	auto addDisc = [&](MESH& mesh, float radius, float y, bool bUp)
+	{
+		unsigned int center = (unsigned int)mesh.vertices.size();
+		glm::vec3 normal = glm::vec3(0.0f, bUp ? 1.0f : -1.0f, 0.0f);
+		addVertex(mesh, glm::vec3(0.0f, y, 0.0f), normal, glm::vec2(0.5f));
+		for (int slice = 0; slice <= ROUND_SLICES; slice++)
+		{
+			float angle = 2.0f * PI * slice / ROUND_SLICES;
+			glm::vec2 ring = glm::vec2(std::cos(angle), std::sin(angle));
+			addVertex(mesh, glm::vec3(ring.x * radius, y, ring.y * radius), normal, 0.5f + 0.5f * ring);
+		}
+		for (int slice = 0; slice < ROUND_SLICES; slice++)
+		{
+			mesh.indices.push_back(center);
+			mesh.indices.push_back(center + 1 + slice);
+			mesh.indices.push_back(center + 2 + slice);
+		}
+	};
+	// the sides of a cylinder from radius bottomRadius at y 0 to
+	// topRadius at y 1
+	auto addSides = [&](MESH& mesh, float bottomRadius, float topRadius)
+	{
+		unsigned int firstVertex = (unsigned int)mesh.vertices.size();
+		for (int row = 0; row <= 1; row++)
+		{
+			float radius = (row == 0) ? topRadius : bottomRadius;
+			for (int slice = 0; slice <= ROUND_SLICES; slice++)
+			{
+				float u = (float)slice / ROUND_SLICES;
+				glm::vec2 ring = glm::vec2(std::cos(u * 2.0f * PI), std::sin(u * 2.0f * PI));
+				glm::vec3 normal = glm::normalize(glm::vec3(ring.x, bottomRadius - topRadius, ring.y));
+				addVertex(mesh, glm::vec3(ring.x * radius, 1.0f - row, ring.y * radius), normal,
+					glm::vec2(u, 1.0f - row));
+			}
+		}
+		addGrid(mesh, firstVertex, 1, ROUND_SLICES);
+	};
+
+	addQuad(m_meshes[MESH_ID_PLANE], glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	// box sides in the order of the MESH_ID_BOX_SIDE ids
+	const glm::vec3 sideNormals[6] = {
+		glm::vec3(0.0f, 0.0f, -1.0f),	// back
+		glm::vec3(0.0f, -1.0f, 0.0f),	// bottom
+		glm::vec3(-1.0f, 0.0f, 0.0f),	// left
+		glm::vec3(1.0f, 0.0f, 0.0f),	// right
+		glm::vec3(0.0f, 1.0f, 0.0f),	// top
+		glm::vec3(0.0f, 0.0f, 1.0f)		// front
+	};
+	for (int side = 0; side < 6; side++)
+	{
+		glm::vec3 normal = sideNormals[side];
+		glm::vec3 halfV = (std::abs(normal.y) > 0.5f) ? glm::vec3(0.0f, 0.0f, -normal.y * 0.5f) : glm::vec3(0.0f, 0.5f, 0.0f);
+		glm::vec3 halfU = glm::cross(halfV, normal);
+		addQuad(m_meshes[MESH_ID_BOX_SIDE + side], normal * 0.5f, halfU, halfV, normal);
+		addQuad(m_meshes[MESH_ID_BOX], normal * 0.5f, halfU, halfV, normal);
+	}
+
+	addDisc(m_meshes[MESH_ID_CYLINDER_TOP], 1.0f, 1.0f, true);
+	addDisc(m_meshes[MESH_ID_CYLINDER_BOTTOM], 1.0f, 0.0f, false);
+	addSides(m_meshes[MESH_ID_CYLINDER_SIDES], 1.0f, 1.0f);
+	addDisc(m_meshes[MESH_ID_TAPERED_TOP], TAPERED_TOP_RADIUS, 1.0f, true);
+	addDisc(m_meshes[MESH_ID_TAPERED_BOTTOM], 1.0f, 0.0f, false);
+	addSides(m_meshes[MESH_ID_TAPERED_SIDES], 1.0f, TAPERED_TOP_RADIUS);
+
+	MESH& sphere = m_meshes[MESH_ID_SPHERE];
+	for (int stack = 0; stack <= SPHERE_STACKS; stack++)
+	{
+		float v = (float)stack / SPHERE_STACKS;
+		for (int slice = 0; slice <= ROUND_SLICES; slice++)
+		{
+			float u = (float)slice / ROUND_SLICES;
+			glm::vec3 normal = glm::vec3(
+				std::sin(v * PI) * std::cos(u * 2.0f * PI),
+				std::cos(v * PI),
+				std::sin(v * PI) * std::sin(u * 2.0f * PI));
+			addVertex(sphere, normal, normal, glm::vec2(u, 1.0f - v));
+		}
+	}
+	addGrid(sphere, 0, SPHERE_STACKS, ROUND_SLICES);
+
+	MESH& torus = m_meshes[MESH_ID_TORUS];
+	for (int ring = 0; ring <= ROUND_SLICES; ring++)
+	{
+		float u = (float)ring / ROUND_SLICES;
+		glm::vec3 center = glm::vec3(std::cos(u * 2.0f * PI), std::sin(u * 2.0f * PI), 0.0f);
+		for (int side = 0; side <= TORUS_SIDES; side++)
+		{
+			float v = (float)side / TORUS_SIDES;
+			glm::vec3 normal = center * std::cos(v * 2.0f * PI) + glm::vec3(0.0f, 0.0f, std::sin(v * 2.0f * PI));
+			addVertex(torus, center * TORUS_MAIN_RADIUS + normal * TORUS_TUBE_RADIUS, normal, glm::vec2(u, v));
+		}
+	}
+	addGrid(torus, 0, ROUND_SLICES, TORUS_SIDES);
+}
+
+/***********************************************************
+ *  RunJobs()
+ *
+ *  This method is used to hand count jobs to the worker
+ *  threads and take jobs on the calling thread too, until
+ *  every job is done.
+ ***********************************************************/
+void SoftwareRasterizer::RunJobs(int jobType, int count)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		m_jobType = jobType;
+		m_jobCount = count;
+		m_nextJob = 0;
+		m_busyWorkers = (int)m_workers.size();
+		m_jobGeneration++;
+	}
+	m_jobCondition.notify_all();
+
+	JOB_COUNTERS counters = JOB_COUNTERS();
+	ProcessJobs(jobType, counters);
+
+	std::unique_lock<std::mutex> lock(m_jobMutex);
+	m_doneCondition.wait(lock, [this]() { return m_busyWorkers == 0; });
+}
+
+/***********************************************************
+ *  WorkerMain()
+ *
+ *  This method is used as the loop of a worker thread - it
+ *  sleeps until the next batch of jobs is started, and every
+ *  worker reports back once per batch.
+ ***********************************************************/
+void SoftwareRasterizer::WorkerMain()
+{
+	unsigned int generation = 0;
+	for (;;)
+	{
+		int jobType = JOB_SETUP;
+		{
+			std::unique_lock<std::mutex> lock(m_jobMutex);
+			m_jobCondition.wait(lock, [&]() { return m_bStopping || (m_jobGeneration != generation); });
+			if (m_bStopping)
+			{
+				return;
+			}
+			generation = m_jobGeneration;
+			jobType = m_jobType;
+		}
+
+		JOB_COUNTERS counters = JOB_COUNTERS();
+		ProcessJobs(jobType, counters);
+
+		{
+			std::lock_guard<std::mutex> lock(m_jobMutex);
+			m_busyWorkers--;
+		}
+		m_doneCondition.notify_one();
+	}
+}
+
+/***********************************************************
+ *  ProcessJobs()
+ *
+ *  This method is used to take jobs of the current batch
+ *  until none are left, then add the counters of the jobs
+ *  to the frame statistics.
+ ***********************************************************/
+void SoftwareRasterizer::ProcessJobs(int jobType, JOB_COUNTERS& counters)
+{
+	for (;;)
+	{
+		int jobIndex = m_nextJob++;
+		if (jobIndex >= m_jobCount)
+		{
+			break;
+		}
+
+		if (jobType == JOB_SETUP)
+		{
+			SetupChunk(jobIndex, counters);
+		}
+		else
+		{
+			RasterTile(jobIndex, counters);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_jobMutex);
+	m_stats.skippedDraws += counters.skippedDraws;
+	m_stats.triangleCount += counters.triangleCount;
+	m_stats.testedBlocks += counters.testedBlocks;
+	m_stats.rejectedBlocks += counters.rejectedBlocks;
+	m_stats.shadedPixels += counters.shadedPixels;
+}
+
+/***********************************************************
+ *  Render()
+ *
+ *  This method is used to draw the sorted draw orders of the
+ *  render queue - the opaque draws front-to-back with depth
+ *  writes, then the transparent ones back-to-front, blended
+ *  and without depth writes, like the GL shading passes.
+ ***********************************************************/
+void SoftwareRasterizer::Render(
+	const RenderQueue& renderQueue,
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const SHADING_LIGHTS& lights)
+{
+	TRACE_SCOPE("SoftwareRender");
+
+	if (m_width <= 0)
+	{
+		return;
+	}
+
+	int threadCount = m_stats.threadCount;
+	double blitMilliseconds = m_stats.blitMilliseconds;
+	m_stats = RASTER_STATS();
+	m_stats.threadCount = threadCount;
+	m_stats.blitMilliseconds = blitMilliseconds;
+
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	m_pRenderQueue = &renderQueue;
+	m_viewProjection = projection * view;
+	m_viewPosition = glm::vec3(glm::inverse(view)[3]);
+	m_lights = lights;
+	m_lightRadii.resize(lights.pointLights.size());
+	for (size_t i = 0; i < lights.pointLights.size(); i++)
+	{
+		m_lightRadii[i] = lights.pointLights[i].bActive
+			? ClusteredLighting::CalcLightRadius(lights.pointLights[i], LIGHT_CUTOFF_INTENSITY) : -1.0f;
+	}
+
+	const std::vector<int>& opaqueOrder = renderQueue.GetOpaqueOrder();
+	const std::vector<int>& transparentOrder = renderQueue.GetTransparentOrder();
+	m_frameDraws.resize(opaqueOrder.size() + transparentOrder.size());
+	for (size_t i = 0; i < m_frameDraws.size(); i++)
+	{
+		bool bBlend = (i >= opaqueOrder.size());
+		m_frameDraws[i].itemIndex = bBlend ? transparentOrder[i - opaqueOrder.size()] : opaqueOrder[i];
+		m_frameDraws[i].bBlend = bBlend;
+		m_frameDraws[i].lights.clear();
+	}
+	m_stats.drawCount = (int)m_frameDraws.size();
+
+	int chunkCount = ((int)m_frameDraws.size() + SETUP_CHUNK_DRAWS - 1) / SETUP_CHUNK_DRAWS;
+	if ((int)m_chunkTriangles.size() < chunkCount)
+	{
+		m_chunkTriangles.resize(chunkCount);
+	}
+	RunJobs(JOB_SETUP, chunkCount);
+	double setupTime = TraceProfiler::NowMilliseconds();
+
+	BinTriangles();
+	double binTime = TraceProfiler::NowMilliseconds();
+
+	RunJobs(JOB_RASTER, m_tilesX * m_tilesY);
+	double rasterTime = TraceProfiler::NowMilliseconds();
+
+	m_stats.setupMilliseconds = setupTime - startTime;
+	m_stats.binMilliseconds = binTime - setupTime;
+	m_stats.rasterMilliseconds = rasterTime - binTime;
+}
+
+/***********************************************************
+ *  SetupChunk()
+ *
+ *  This method is used to run the vertex stage and set up
+ *  the triangles of one chunk of draws.  The point lights
+ *  that reach the world bounds of a draw are gathered here
+ *  too, so the pixels only loop over those.
+ ***********************************************************/
+void SoftwareRasterizer::SetupChunk(int chunkIndex, JOB_COUNTERS& counters)
+{
+	std::vector<TRIANGLE>& triangles = m_chunkTriangles[chunkIndex];
+	triangles.clear();
+
+	int firstSlot = chunkIndex * SETUP_CHUNK_DRAWS;
+	int endSlot = std::min(firstSlot + SETUP_CHUNK_DRAWS, (int)m_frameDraws.size());
+	for (int slot = firstSlot; slot < endSlot; slot++)
+	{
+		const RenderQueue::DRAW_ITEM& item = m_pRenderQueue->GetItem(m_frameDraws[slot].itemIndex);
+
+		int meshIDs[3];
+		int meshCount = 0;
+		switch (item.meshShape)
+		{
+		case RenderQueue::MESH_PLANE:
+			meshIDs[meshCount++] = MESH_ID_PLANE;
+			break;
+		case RenderQueue::MESH_BOX:
+			meshIDs[meshCount++] = MESH_ID_BOX;
+			break;
+		case RenderQueue::MESH_BOX_SIDE:
+			switch (item.meshParts)
+			{
+			case ShapeMeshes::BoxSide::box_back:	meshIDs[meshCount++] = MESH_ID_BOX_SIDE + 0; break;
+			case ShapeMeshes::BoxSide::box_bottom:	meshIDs[meshCount++] = MESH_ID_BOX_SIDE + 1; break;
+			case ShapeMeshes::BoxSide::box_left:	meshIDs[meshCount++] = MESH_ID_BOX_SIDE + 2; break;
+			case ShapeMeshes::BoxSide::box_right:	meshIDs[meshCount++] = MESH_ID_BOX_SIDE + 3; break;
+			case ShapeMeshes::BoxSide::box_top:		meshIDs[meshCount++] = MESH_ID_BOX_SIDE + 4; break;
+			case ShapeMeshes::BoxSide::box_front:	meshIDs[meshCount++] = MESH_ID_BOX_SIDE + 5; break;
+			}
+			break;
+		case RenderQueue::MESH_CYLINDER:
+		case RenderQueue::MESH_TAPERED_CYLINDER:
+		{
+			int firstID = (item.meshShape == RenderQueue::MESH_CYLINDER) ? MESH_ID_CYLINDER_TOP : MESH_ID_TAPERED_TOP;
+			if ((item.meshParts & RenderQueue::PART_TOP) != 0)
+			{
+				meshIDs[meshCount++] = firstID;
+			}
+			if ((item.meshParts & RenderQueue::PART_BOTTOM) != 0)
+			{
+				meshIDs[meshCount++] = firstID + 1;
+			}
+			if ((item.meshParts & RenderQueue::PART_SIDES) != 0)
+			{
+				meshIDs[meshCount++] = firstID + 2;
+			}
+			break;
+		}
+		case RenderQueue::MESH_SPHERE:
+			meshIDs[meshCount++] = MESH_ID_SPHERE;
+			break;
+		case RenderQueue::MESH_TORUS:
+			meshIDs[meshCount++] = MESH_ID_TORUS;
+			break;
+		default:
+			// the foliage instances only exist on the GPU
+			counters.skippedDraws++;
+			break;
+		}
+
+		for (int i = 0; i < meshCount; i++)
+		{
+			SetupMesh(m_meshes[meshIDs[i]], slot, triangles, counters);
+		}
+	}
+}
+
+/***********************************************************
+ *  SetupMesh()
+ *
+ *  This method is used to transform the vertices of one
+ *  mesh of a draw and set up its triangles.
+ ***********************************************************/
+void SoftwareRasterizer::SetupMesh(const MESH& mesh, int drawSlot, std::vector<TRIANGLE>& triangles, JOB_COUNTERS& counters)
+{
+	FRAME_DRAW& draw = m_frameDraws[drawSlot];
+	const glm::mat4& model = m_pRenderQueue->GetItem(draw.itemIndex).model;
+	glm::mat4 modelViewProjection = m_viewProjection * model;
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+
+	std::vector<CLIP_VERTEX> vertices(mesh.vertices.size());
+	glm::vec3 minPoint = glm::vec3(1.0e30f);
+	glm::vec3 maxPoint = glm::vec3(-1.0e30f);
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const VERTEX& source = mesh.vertices[i];
+		CLIP_VERTEX& vertex = vertices[i];
+		vertex.clipPosition = modelViewProjection * glm::vec4(source.position, 1.0f);
+		vertex.worldPosition = glm::vec3(model * glm::vec4(source.position, 1.0f));
+		vertex.worldNormal = normalMatrix * source.normal;
+		vertex.uv = source.uv;
+		minPoint = glm::min(minPoint, vertex.worldPosition);
+		maxPoint = glm::max(maxPoint, vertex.worldPosition);
+	}
+
+	// a draw of several meshes gathers the lights of each of them
+	for (size_t i = 0; i < m_lightRadii.size(); i++)
+	{
+		float radius = m_lightRadii[i];
+		if ((radius > 0.0f) &&
+			(BoxDistanceSquared(m_lights.pointLights[i].position, minPoint, maxPoint) <= radius * radius) &&
+			(std::find(draw.lights.begin(), draw.lights.end(), (int)i) == draw.lights.end()))
+		{
+			draw.lights.push_back((int)i);
+		}
+	}
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		CLIP_VERTEX triangle[3] = {
+			vertices[mesh.indices[i]],
+			vertices[mesh.indices[i + 1]],
+			vertices[mesh.indices[i + 2]] };
+		ClipTriangle(triangle, drawSlot, triangles);
+	}
+	counters.triangleCount += (int)mesh.indices.size() / 3;
+}
+
+/***********************************************************
+ *  ClipTriangle()
+ *
+ *  This method is used to drop the triangles that are
+ *  entirely outside one plane of the view volume, and to
+ *  clip the ones crossing the near plane into one or two
+ *  triangles in front of it.  The other planes need no
+ *  clipping - the screen bounds limit the rasterized pixels
+ *  and the depth test drops what is beyond the far plane.
+ ***********************************************************/
+void SoftwareRasterizer::ClipTriangle(const CLIP_VERTEX* pVertices, int drawSlot, std::vector<TRIANGLE>& triangles)
+{
+	int outsideMasks[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec4& p = pVertices[i].clipPosition;
+		outsideMasks[i] = ((p.x < -p.w) ? 1 : 0) | ((p.x > p.w) ? 2 : 0) |
+			((p.y < -p.w) ? 4 : 0) | ((p.y > p.w) ? 8 : 0) |
+			((p.z < -p.w) ? 16 : 0) | ((p.z > p.w) ? 32 : 0);
+	}
+	if ((outsideMasks[0] & outsideMasks[1] & outsideMasks[2]) != 0)
+	{
+		return;
+	}
+	if (((outsideMasks[0] | outsideMasks[1] | outsideMasks[2]) & 16) == 0)
+	{
+		SetupTriangle(pVertices[0], pVertices[1], pVertices[2], drawSlot, triangles);
+		return;
+	}
+
+	// walk the edges and keep the part with z >= -w
+	CLIP_VERTEX polygon[4];
+	int polygonSize = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		const CLIP_VERTEX& current = pVertices[i];
+		const CLIP_VERTEX& next = pVertices[(i + 1) % 3];
+		float currentDistance = current.clipPosition.z + current.clipPosition.w;
+		float nextDistance = next.clipPosition.z + next.clipPosition.w;
+
+		if (currentDistance >= 0.0f)
+		{
+			polygon[polygonSize++] = current;
+		}
+		if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+		{
+			polygon[polygonSize++] = LerpVertex(current, next, currentDistance / (currentDistance - nextDistance));
+		}
+	}
+
+	for (int i = 2; i < polygonSize; i++)
+	{
+		SetupTriangle(polygon[0], polygon[i - 1], polygon[i], drawSlot, triangles);
+	}
+}
+
+/***********************************************************
+ *  SetupTriangle()
+ *
+ *  This method is used to project a triangle to the screen
+ *  and compute its edge functions and depth plane.  The edge
+ *  functions are scaled by the inverse area, so that their
+ *  values at a pixel are the barycentric weights of the
+ *  vertices.  Both windings are drawn, like the GL passes,
+ *  which do not cull faces.
+ ***********************************************************/
+void SoftwareRasterizer::SetupTriangle(
+	const CLIP_VERTEX& v0,
+	const CLIP_VERTEX& v1,
+	const CLIP_VERTEX& v2,
+	int drawSlot,
+	std::vector<TRIANGLE>& triangles)
+{
+	const CLIP_VERTEX* pVertices[3] = { &v0, &v1, &v2 };
+	glm::vec3 screen[3];
+	float invW[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec4& p = pVertices[i]->clipPosition;
+		invW[i] = 1.0f / p.w;
+		screen[i] = glm::vec3(
+			(p.x * invW[i] * 0.5f + 0.5f) * m_width,
+			(p.y * invW[i] * 0.5f + 0.5f) * m_height,
+			p.z * invW[i] * 0.5f + 0.5f);
+	}
+
+	float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+		(screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+	if (std::abs(area) < MIN_TRIANGLE_AREA)
+	{
+		return;
+	}
+	// counter-clockwise from here on
+	if (area < 0.0f)
+	{
+		std::swap(pVertices[1], pVertices[2]);
+		std::swap(screen[1], screen[2]);
+		std::swap(invW[1], invW[2]);
+		area = -area;
+	}
+
+	TRIANGLE triangle;
+	float minX = std::min(screen[0].x, std::min(screen[1].x, screen[2].x));
+	float maxX = std::max(screen[0].x, std::max(screen[1].x, screen[2].x));
+	float minY = std::min(screen[0].y, std::min(screen[1].y, screen[2].y));
+	float maxY = std::max(screen[0].y, std::max(screen[1].y, screen[2].y));
+	triangle.minX = std::max(0, (int)std::floor(minX));
+	triangle.minY = std::max(0, (int)std::floor(minY));
+	triangle.maxX = std::min(m_width - 1, (int)std::ceil(maxX));
+	triangle.maxY = std::min(m_height - 1, (int)std::ceil(maxY));
+	if ((triangle.minX > triangle.maxX) || (triangle.minY > triangle.maxY))
+	{
+		return;
+	}
+
+	float invArea = 1.0f / area;
+	triangle.depthA = 0.0f;
+	triangle.depthB = 0.0f;
+	triangle.depthC = 0.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec3& a = screen[(i + 1) % 3];
+		const glm::vec3& b = screen[(i + 2) % 3];
+		float edgeA = a.y - b.y;
+		float edgeB = b.x - a.x;
+		triangle.bTopLeft[i] = (edgeA > 0.0f) || ((edgeA == 0.0f) && (edgeB < 0.0f));
+		triangle.edgeA[i] = edgeA * invArea;
+		triangle.edgeB[i] = edgeB * invArea;
+		triangle.edgeC[i] = -(edgeA * a.x + edgeB * a.y) * invArea;
+
+		triangle.depthA += triangle.edgeA[i] * screen[i].z;
+		triangle.depthB += triangle.edgeB[i] * screen[i].z;
+		triangle.depthC += triangle.edgeC[i] * screen[i].z;
+
+		triangle.invW[i] = invW[i];
+		triangle.worldPosition[i] = pVertices[i]->worldPosition;
+		triangle.worldNormal[i] = pVertices[i]->worldNormal;
+		triangle.uv[i] = pVertices[i]->uv;
+	}
+	triangle.minDepth = std::min(screen[0].z, std::min(screen[1].z, screen[2].z));
+	triangle.drawSlot = drawSlot;
+	triangles.push_back(triangle);
+}
+
+/***********************************************************
+ *  BinTriangles()
+ *
+ *  This method is used to append every set up triangle to
+ *  the bins of the tiles its bounds overlap.  The chunks are
+ *  walked in order, so every bin keeps the draw order.
+ ***********************************************************/
+void SoftwareRasterizer::BinTriangles()
+{
+	for (std::vector<const TRIANGLE*>& bin : m_tileBins)
+	{
+		bin.clear();
+	}
+
+	int chunkCount = ((int)m_frameDraws.size() + SETUP_CHUNK_DRAWS - 1) / SETUP_CHUNK_DRAWS;
+	for (int chunk = 0; chunk < chunkCount; chunk++)
+	{
+		for (const TRIANGLE& triangle : m_chunkTriangles[chunk])
+		{
+			int firstTileX = triangle.minX / TILE_SIZE;
+			int lastTileX = triangle.maxX / TILE_SIZE;
+			int firstTileY = triangle.minY / TILE_SIZE;
+			int lastTileY = triangle.maxY / TILE_SIZE;
+			for (int tileY = firstTileY; tileY <= lastTileY; tileY++)
+			{
+				for (int tileX = firstTileX; tileX <= lastTileX; tileX++)
+				{
+					m_tileBins[tileY * m_tilesX + tileX].push_back(&triangle);
+				}
+			}
+			m_stats.binnedTriangles++;
+			m_stats.tileTriangles += (lastTileX - firstTileX + 1) * (lastTileY - firstTileY + 1);
+		}
+	}
+}
+
+/***********************************************************
+ *  RasterTile()
+ *
+ *  This method is used to clear one tile and rasterize the
+ *  triangles of its bin, depth block by depth block.  Only
+ *  the thread of the tile writes its pixels, so the tiles
+ *  need no locking.
+ ***********************************************************/
+void SoftwareRasterizer::RasterTile(int tileIndex, JOB_COUNTERS& counters)
+{
+	int tileX = (tileIndex % m_tilesX) * TILE_SIZE;
+	int tileY = (tileIndex / m_tilesX) * TILE_SIZE;
+	int endX = std::min(tileX + TILE_SIZE, m_stride);
+	int endY = std::min(tileY + TILE_SIZE, m_paddedHeight);
+
+	for (int y = tileY; y < endY; y++)
+	{
+		unsigned char* pColor = &m_colorBuffer[((size_t)y * m_stride + tileX) * 4];
+		for (int x = tileX; x < endX; x++)
+		{
+			pColor[0] = 0;
+			pColor[1] = 0;
+			pColor[2] = 0;
+			pColor[3] = 255;
+			pColor += 4;
+		}
+		std::fill(m_depthBuffer.begin() + (size_t)y * m_stride + tileX,
+			m_depthBuffer.begin() + (size_t)y * m_stride + endX, 1.0f);
+	}
+	for (int y = tileY; y < endY; y += DEPTH_BLOCK_SIZE)
+	{
+		for (int x = tileX; x < endX; x += DEPTH_BLOCK_SIZE)
+		{
+			m_blockMaxDepth[(y / DEPTH_BLOCK_SIZE) * m_blocksX + x / DEPTH_BLOCK_SIZE] = 1.0f;
+		}
+	}
+
+	for (const TRIANGLE* pTriangle : m_tileBins[tileIndex])
+	{
+		const TRIANGLE& triangle = *pTriangle;
+		int firstX = std::max(triangle.minX, tileX) / DEPTH_BLOCK_SIZE * DEPTH_BLOCK_SIZE;
+		int firstY = std::max(triangle.minY, tileY) / DEPTH_BLOCK_SIZE * DEPTH_BLOCK_SIZE;
+		int lastX = std::min(triangle.maxX, endX - 1);
+		int lastY = std::min(triangle.maxY, endY - 1);
+		for (int blockY = firstY; blockY <= lastY; blockY += DEPTH_BLOCK_SIZE)
+		{
+			for (int blockX = firstX; blockX <= lastX; blockX += DEPTH_BLOCK_SIZE)
+			{
+				RasterBlock(triangle, blockX, blockY, counters);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  RasterBlock()
+ *
+ *  This method is used to rasterize a triangle inside one
+ *  depth block.  The block is skipped when it lies outside
+ *  an edge, or when the nearest depth of the triangle's
+ *  plane in the block is behind the farthest depth stored
+ *  in it.  The pixels are tested four at a time, and only
+ *  the ones that pass the edges and the depth are shaded.
+ ***********************************************************/
+void SoftwareRasterizer::RasterBlock(const TRIANGLE& triangle, int blockX, int blockY, JOB_COUNTERS& counters)
+{
+	counters.testedBlocks++;
+
+	float firstCenterX = blockX + 0.5f;
+	float lastCenterX = blockX + DEPTH_BLOCK_SIZE - 0.5f;
+	float firstCenterY = blockY + 0.5f;
+	float lastCenterY = blockY + DEPTH_BLOCK_SIZE - 0.5f;
+	for (int i = 0; i < 3; i++)
+	{
+		float maxEdge = triangle.edgeC[i] +
+			triangle.edgeA[i] * ((triangle.edgeA[i] > 0.0f) ? lastCenterX : firstCenterX) +
+			triangle.edgeB[i] * ((triangle.edgeB[i] > 0.0f) ? lastCenterY : firstCenterY);
+		if (maxEdge < 0.0f)
+		{
+			return;
+		}
+	}
+
+	float& blockMaxDepth = m_blockMaxDepth[(blockY / DEPTH_BLOCK_SIZE) * m_blocksX + blockX / DEPTH_BLOCK_SIZE];
+	float nearDepth = triangle.depthC +
+		triangle.depthA * ((triangle.depthA > 0.0f) ? firstCenterX : lastCenterX) +
+		triangle.depthB * ((triangle.depthB > 0.0f) ? firstCenterY : lastCenterY);
+	if (std::max(nearDepth, triangle.minDepth) >= blockMaxDepth)
+	{
+		counters.rejectedBlocks++;
+		return;
+	}
+
+	const FRAME_DRAW& draw = m_frameDraws[triangle.drawSlot];
+	const bool bBlend = draw.bBlend;
+	bool bWritten = false;
+
+#ifdef SOFTWARE_RASTERIZER_SSE2
+	const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	const __m128 zero = _mm_setzero_ps();
+	__m128 edgeA[3];
+	__m128 topLeft[3];
+	for (int i = 0; i < 3; i++)
+	{
+		edgeA[i] = _mm_set1_ps(triangle.edgeA[i]);
+		topLeft[i] = _mm_castsi128_ps(_mm_set1_epi32(triangle.bTopLeft[i] ? -1 : 0));
+	}
+	const __m128 depthA = _mm_set1_ps(triangle.depthA);
+#endif
+
+	for (int y = blockY; y < blockY + DEPTH_BLOCK_SIZE; y++)
+	{
+		float centerY = y + 0.5f;
+		float* pDepth = &m_depthBuffer[(size_t)y * m_stride + blockX];
+		unsigned char* pColor = &m_colorBuffer[((size_t)y * m_stride + blockX) * 4];
+
+		for (int quad = 0; quad < DEPTH_BLOCK_SIZE; quad += 4)
+		{
+			float centerX = blockX + quad + 0.5f;
+			int mask = 0;
+
+#ifdef SOFTWARE_RASTERIZER_SSE2
+			__m128 x = _mm_add_ps(_mm_set1_ps(centerX), laneOffsets);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int i = 0; i < 3; i++)
+			{
+				__m128 edge = _mm_add_ps(_mm_mul_ps(edgeA[i], x),
+					_mm_set1_ps(triangle.edgeB[i] * centerY + triangle.edgeC[i]));
+				__m128 edgeInside = _mm_or_ps(_mm_cmpgt_ps(edge, zero),
+					_mm_and_ps(_mm_cmpeq_ps(edge, zero), topLeft[i]));
+				inside = _mm_and_ps(inside, edgeInside);
+			}
+			__m128 depth = _mm_add_ps(_mm_mul_ps(depthA, x),
+				_mm_set1_ps(triangle.depthB * centerY + triangle.depthC));
+			__m128 stored = _mm_loadu_ps(pDepth + quad);
+			__m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(depth, stored));
+			mask = _mm_movemask_ps(pass);
+			if ((mask != 0) && (bBlend == false))
+			{
+				_mm_storeu_ps(pDepth + quad, _mm_or_ps(_mm_and_ps(pass, depth), _mm_andnot_ps(pass, stored)));
+			}
+#else
+			for (int lane = 0; lane < 4; lane++)
+			{
+				float x = centerX + lane;
+				bool bInside = true;
+				for (int i = 0; i < 3; i++)
+				{
+					float edge = triangle.edgeA[i] * x + (triangle.edgeB[i] * centerY + triangle.edgeC[i]);
+					bInside = bInside && ((edge > 0.0f) || ((edge == 0.0f) && triangle.bTopLeft[i]));
+				}
+				float depth = triangle.depthA * x + (triangle.depthB * centerY + triangle.depthC);
+				if (bInside && (depth < pDepth[quad + lane]))
+				{
+					mask |= 1 << lane;
+					if (bBlend == false)
+					{
+						pDepth[quad + lane] = depth;
+					}
+				}
+			}
+#endif
+
+			if (mask == 0)
+			{
+				continue;
+			}
+			bWritten = true;
+
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if ((mask & (1 << lane)) == 0)
+				{
+					continue;
+				}
+
+				float x = centerX + lane;
+				float weight0 = triangle.edgeA[0] * x + triangle.edgeB[0] * centerY + triangle.edgeC[0];
+				float weight1 = triangle.edgeA[1] * x + triangle.edgeB[1] * centerY + triangle.edgeC[1];
+				glm::vec4 color = ShadePixel(triangle, weight0, weight1, 1.0f - weight0 - weight1);
+				color = glm::clamp(color, 0.0f, 1.0f);
+
+				unsigned char* pPixel = pColor + (quad + lane) * 4;
+				if (bBlend == true)
+				{
+					for (int channel = 0; channel < 4; channel++)
+					{
+						float destination = pPixel[channel] / 255.0f;
+						float blended = color[channel] * color.a + destination * (1.0f - color.a);
+						pPixel[channel] = (unsigned char)(blended * 255.0f + 0.5f);
+					}
+				}
+				else
+				{
+					for (int channel = 0; channel < 4; channel++)
+					{
+						pPixel[channel] = (unsigned char)(color[channel] * 255.0f + 0.5f);
+					}
+				}
+				counters.shadedPixels++;
+			}
+		}
+	}
+
+	// the block's farthest depth can only have moved closer
+	if ((bWritten == true) && (bBlend == false))
+	{
+		float maxDepth = 0.0f;
+		for (int y = blockY; y < blockY + DEPTH_BLOCK_SIZE; y++)
+		{
+			const float* pDepth = &m_depthBuffer[(size_t)y * m_stride + blockX];
+			for (int x = 0; x < DEPTH_BLOCK_SIZE; x++)
+			{
+				maxDepth = std::max(maxDepth, pDepth[x]);
+			}
+		}
+		blockMaxDepth = maxDepth;
+	}
+}
+
+/***********************************************************
+ *  ShadePixel()
+ *
+ *  This method is used to shade one pixel the way the scene
+ *  fragment shader does, with the attributes interpolated
+ *  perspective correctly from the barycentric weights.
+ ***********************************************************/
+glm::vec4 SoftwareRasterizer::ShadePixel(const TRIANGLE& triangle, float weight0, float weight1, float weight2) const
+{
+	float perspective0 = weight0 * triangle.invW[0];
+	float perspective1 = weight1 * triangle.invW[1];
+	float perspective2 = weight2 * triangle.invW[2];
+	float invSum = 1.0f / (perspective0 + perspective1 + perspective2);
+	perspective0 *= invSum;
+	perspective1 *= invSum;
+	perspective2 *= invSum;
+
+	const FRAME_DRAW& draw = m_frameDraws[triangle.drawSlot];
+	const RenderQueue::DRAW_ITEM& item = m_pRenderQueue->GetItem(draw.itemIndex);
+
+	glm::vec4 baseColor = item.color;
+	if (item.bUseTexture == true)
+	{
+		glm::vec2 uv = triangle.uv[0] * perspective0 + triangle.uv[1] * perspective1 + triangle.uv[2] * perspective2;
+		baseColor = SampleTexture(item.textureSlot, uv * item.uvScale);
+	}
+	if (m_lights.bUseLighting == false)
+	{
+		return(glm::vec4(glm::vec3(baseColor), baseColor.a * item.opacity));
+	}
+
+	glm::vec3 position = triangle.worldPosition[0] * perspective0 +
+		triangle.worldPosition[1] * perspective1 + triangle.worldPosition[2] * perspective2;
+	glm::vec3 normal = glm::normalize(triangle.worldNormal[0] * perspective0 +
+		triangle.worldNormal[1] * perspective1 + triangle.worldNormal[2] * perspective2);
+	glm::vec3 viewDirection = glm::normalize(m_viewPosition - position);
+	glm::vec3 base = glm::vec3(baseColor);
+	glm::vec3 phongResult = glm::vec3(0.0f);
+
+	if (m_lights.bDirectionalActive == true)
+	{
+		glm::vec3 lightDirection = glm::normalize(-m_lights.directionalDirection);
+		float diffuseImpact = std::max(glm::dot(normal, lightDirection), 0.0f);
+		glm::vec3 reflectDirection = glm::reflect(-lightDirection, normal);
+		float specularImpact = std::pow(std::max(glm::dot(viewDirection, reflectDirection), 0.0f), item.shininess);
+
+		phongResult += m_lights.directionalAmbient * base +
+			m_lights.directionalDiffuse * diffuseImpact * item.diffuseColor * base +
+			m_lights.directionalSpecular * specularImpact * item.specularColor;
+	}
+
+	for (int lightIndex : draw.lights)
+	{
+		const ClusteredLighting::POINT_LIGHT& light = m_lights.pointLights[lightIndex];
+		glm::vec3 toLight = light.position - position;
+		float distance = glm::length(toLight);
+		if (distance > m_lightRadii[lightIndex])
+		{
+			continue;
+		}
+
+		glm::vec3 lightDirection = toLight / std::max(distance, 1.0e-6f);
+		float diffuseImpact = std::max(glm::dot(normal, lightDirection), 0.0f);
+		glm::vec3 reflectDirection = glm::reflect(-lightDirection, normal);
+		float specularImpact = std::pow(std::max(glm::dot(viewDirection, reflectDirection), 0.0f), item.shininess);
+		float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+		phongResult += (light.ambient * base +
+			light.diffuse * diffuseImpact * item.diffuseColor * base +
+			light.specular * specularImpact * item.specularColor) * attenuation;
+	}
+
+	return(glm::vec4(phongResult, baseColor.a * item.opacity));
+}
+
+/***********************************************************
+ *  SampleTexture()
+ *
+ *  This method is used to sample a scene texture bilinearly
+ *  with repeating UVs.
+ ***********************************************************/
+glm::vec4 SoftwareRasterizer::SampleTexture(int textureSlot, const glm::vec2& uv) const
+{
+	if ((textureSlot < 0) || (textureSlot >= (int)m_textures.size()) || m_textures[textureSlot].texels.empty())
+	{
+		return(glm::vec4(1.0f));
+	}
+
+	const TEXTURE& texture = m_textures[textureSlot];
+	float x = uv.x * texture.width - 0.5f;
+	float y = uv.y * texture.height - 0.5f;
+	float floorX = std::floor(x);
+	float floorY = std::floor(y);
+	float fractionX = x - floorX;
+	float fractionY = y - floorY;
+
+	int x0 = (int)floorX % texture.width;
+	int y0 = (int)floorY % texture.height;
+	x0 = (x0 < 0) ? x0 + texture.width : x0;
+	y0 = (y0 < 0) ? y0 + texture.height : y0;
+	int x1 = (x0 + 1 == texture.width) ? 0 : x0 + 1;
+	int y1 = (y0 + 1 == texture.height) ? 0 : y0 + 1;
+
+	auto texel = [&](int column, int row)
+	{
+		const unsigned char* pTexel = &texture.texels[((size_t)row * texture.width + column) * 4];
+		return(glm::vec4(pTexel[0], pTexel[1], pTexel[2], pTexel[3]));
+	};
+	glm::vec4 bottom = glm::mix(texel(x0, y0), texel(x1, y0), fractionX);
+	glm::vec4 top = glm::mix(texel(x0, y1), texel(x1, y1), fractionX);
+	return(glm::mix(bottom, top, fractionY) / 255.0f);
+}
+
+/***********************************************************
+ *  Blit()
+ *
+ *  This method is used to upload the color buffer into its
+ *  texture and copy it into the viewport of the bound draw
+ *  framebuffer - the window, or the dynamic resolution
+ *  target when that is active.
+ ***********************************************************/
+void SoftwareRasterizer::Blit()
+{
+	TRACE_SCOPE("SoftwareBlit");
+
+	if (m_textureID == 0)
+	{
+		return;
+	}
+	double startTime = TraceProfiler::NowMilliseconds();
+
+	glActiveTexture(GL_TEXTURE0 + TextureStreamer::UPLOAD_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, m_stride);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, m_colorBuffer.data());
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	GLStateCache::InvalidateTextures();
+
+	GLint previousFramebuffer = 0;
+	GLint viewport[4] = { 0, 0, m_width, m_height };
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebufferID);
+	glBlitFramebuffer(
+		0, 0, m_width, m_height,
+		viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+		GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+
+	m_stats.blitMilliseconds = TraceProfiler::NowMilliseconds() - startTime;
+}
+
+/***********************************************************
+ *  SaveImage()
+ *
+ *  This method is used to write the color buffer of the last
+ *  frame as a binary PPM, top row first.
+ ***********************************************************/
+bool SoftwareRasterizer::SaveImage(const char* filename) const
+{
+	FILE* pFile = fopen(filename, "wb");
+	if (NULL == pFile)
+	{
+		std::cerr << "ERROR: Could not write the software frame: " << filename << std::endl;
+		return(false);
+	}
+
+	fprintf(pFile, "P6\n%d %d\n255\n", m_width, m_height);
+	std::vector<unsigned char> row(m_width * 3);
+	for (int y = m_height - 1; y >= 0; y--)
+	{
+		const unsigned char* pSource = &m_colorBuffer[(size_t)y * m_stride * 4];
+		for (int x = 0; x < m_width; x++)
+		{
+			row[x * 3 + 0] = pSource[x * 4 + 0];
+			row[x * 3 + 1] = pSource[x * 4 + 1];
+			row[x * 3 + 2] = pSource[x * 4 + 2];
+		}
+		fwrite(row.data(), 1, row.size(), pFile);
+	}
+	fclose(pFile);
+
+	std::cout << "INFO: Software frame written to " << filename << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used to print the counters and the phase
+ *  times of the last frame.
+ ***********************************************************/
+void SoftwareRasterizer::PrintStats() const
+{
+	double rejectedPercent = (m_stats.testedBlocks > 0)
+		? 100.0 * m_stats.rejectedBlocks / m_stats.testedBlocks : 0.0;
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< "INFO: Software rasterizer, " << m_stats.threadCount << " threads: "
+		<< m_stats.drawCount << " draws (" << m_stats.skippedDraws << " skipped), "
+		<< m_stats.triangleCount << " triangles, " << m_stats.binnedTriangles << " binned into "
+		<< m_stats.tileTriangles << " tile lists\n"
+		<< "      " << m_stats.testedBlocks << " depth blocks, " << rejectedPercent << "% rejected by the "
+		<< "hierarchical depth, " << m_stats.shadedPixels << " shaded pixels\n"
+		<< "      setup " << m_stats.setupMilliseconds << " ms, bin " << m_stats.binMilliseconds
+		<< " ms, raster " << m_stats.rasterMilliseconds << " ms, blit " << m_stats.blitMilliseconds << " ms"
+		<< std::endl;
+}
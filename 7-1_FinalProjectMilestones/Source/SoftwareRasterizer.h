@@ -0,0 +1,276 @@
+///////////////////////////////////////////////////////////////////////////////
+// softwarerasterizer.h
+// ============
+// CPU render backend for hosts without a GPU - the recorded draw items are
+// transformed and set up on a pool of threads, binned into screen tiles and
+// rasterized tile by tile with SIMD edge functions and a hierarchical depth
+// test, into a color buffer that is blitted to the window or saved
+//
+//  The backend draws the same RenderQueue the GL passes draw, with the same
+//  materials, textures and lights.  The basic meshes are tessellated on the
+//  CPU to the shapes of ShapeMeshes, since those only live in GL buffers.
+//  The scene is lit per pixel with the scene shader's Phong terms, without
+//  the shadow map, and the textures are sampled bilinearly from their top
+//  level.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ClusteredLighting.h"
+#include "RenderQueue.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  SoftwareRasterizer
+ *
+ *  This class owns the CPU meshes and textures, the color
+ *  and depth buffers, the worker threads and the texture
+ *  the color buffer is blitted through.
+ ***********************************************************/
+class SoftwareRasterizer
+{
+public:
+	// screen tiles that one thread rasterizes at a time
+	static const int TILE_SIZE = 64;
+	// blocks of the hierarchical depth buffer, inside the tiles
+	static const int DEPTH_BLOCK_SIZE = 8;
+
+	// the lights the scene is shaded with
+	struct SHADING_LIGHTS
+	{
+		bool bUseLighting;
+		bool bDirectionalActive;
+		glm::vec3 directionalDirection;
+		glm::vec3 directionalAmbient;
+		glm::vec3 directionalDiffuse;
+		glm::vec3 directionalSpecular;
+		std::vector<ClusteredLighting::POINT_LIGHT> pointLights;
+	};
+
+	struct RASTER_STATS
+	{
+		int threadCount;
+		int drawCount;
+		int skippedDraws;		// meshes the backend does not draw
+		int triangleCount;		// triangles out of the vertex stage
+		int binnedTriangles;	// after clipping and culling
+		int tileTriangles;		// triangle and tile pairs
+		long long testedBlocks;
+		long long rejectedBlocks;	// hidden by the hierarchical depth
+		long long shadedPixels;
+		double setupMilliseconds;
+		double binMilliseconds;
+		double rasterMilliseconds;
+		double blitMilliseconds;
+	};
+
+	// constructor
+	SoftwareRasterizer();
+	// destructor
+	~SoftwareRasterizer();
+
+	// allocate the buffers for the passed in size and start the
+	// worker threads - a thread count of 0 uses every core
+	bool Create(int width, int height, int threadCount);
+	// stop the threads and free the buffers and the GL objects
+	void Destroy();
+
+	// decode the scene textures, in the order of their texture slots
+	void LoadTextures(const std::vector<std::string>& filenames);
+
+	// draw the sorted opaque and transparent orders of the queue
+	void Render(
+		const RenderQueue& renderQueue,
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const SHADING_LIGHTS& lights);
+	// copy the color buffer into the bound draw framebuffer
+	void Blit();
+	// write the color buffer as a binary PPM image
+	bool SaveImage(const char* filename) const;
+
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+	const RASTER_STATS& GetStats() const { return m_stats; }
+	// print the counters and phase times of the last frame
+	void PrintStats() const;
+
+private:
+	// tessellated basic meshes, the cylinders split into their parts
+	enum MESH_ID
+	{
+		MESH_ID_PLANE = 0,
+		MESH_ID_BOX,
+		MESH_ID_BOX_SIDE,		// back, bottom, left, right, top and front
+		MESH_ID_CYLINDER_TOP = MESH_ID_BOX_SIDE + 6,
+		MESH_ID_CYLINDER_BOTTOM,
+		MESH_ID_CYLINDER_SIDES,
+		MESH_ID_TAPERED_TOP,
+		MESH_ID_TAPERED_BOTTOM,
+		MESH_ID_TAPERED_SIDES,
+		MESH_ID_SPHERE,
+		MESH_ID_TORUS,
+		MESH_ID_COUNT
+	};
+
+	enum JOB_TYPE
+	{
+		JOB_SETUP = 0,
+		JOB_RASTER
+	};
+
+	struct VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 uv;
+	};
+
+	struct MESH
+	{
+		std::vector<VERTEX> vertices;
+		std::vector<unsigned int> indices;
+	};
+
+	// RGBA texels, bottom row first like the GL textures
+	struct TEXTURE
+	{
+		int width;
+		int height;
+		std::vector<unsigned char> texels;
+	};
+
+	// a vertex out of the vertex stage
+	struct CLIP_VERTEX
+	{
+		glm::vec4 clipPosition;
+		glm::vec3 worldPosition;
+		glm::vec3 worldNormal;
+		glm::vec2 uv;
+	};
+
+	// a triangle set up for rasterization - edge i is zero along
+	// the side opposite vertex i and positive inside, evaluated at
+	// the pixel centers; the depth is a plane in screen space
+	struct TRIANGLE
+	{
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		// pixels exactly on an edge belong to the triangle for the
+		// top and left edges only
+		bool bTopLeft[3];
+		float depthA;
+		float depthB;
+		float depthC;
+		float minDepth;
+		float invW[3];
+		glm::vec3 worldPosition[3];
+		glm::vec3 worldNormal[3];
+		glm::vec2 uv[3];
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+		// slot of the draw in the frame's draw order
+		int drawSlot;
+	};
+
+	// per-draw values of the frame
+	struct FRAME_DRAW
+	{
+		int itemIndex;
+		bool bBlend;
+		// point lights whose range reaches the draw's bounds
+		std::vector<int> lights;
+	};
+
+	// counters of one job, added to the frame stats when it ends
+	struct JOB_COUNTERS
+	{
+		int skippedDraws;
+		int triangleCount;
+		long long testedBlocks;
+		long long rejectedBlocks;
+		long long shadedPixels;
+	};
+
+	int m_width;
+	int m_height;
+	// the buffers are padded to whole depth blocks
+	int m_stride;
+	int m_paddedHeight;
+	int m_tilesX;
+	int m_tilesY;
+	int m_blocksX;
+	std::vector<unsigned char> m_colorBuffer;
+	std::vector<float> m_depthBuffer;
+	// farthest depth of every depth block
+	std::vector<float> m_blockMaxDepth;
+
+	std::vector<MESH> m_meshes;
+	std::vector<TEXTURE> m_textures;
+
+	// inputs of the frame being rendered
+	const RenderQueue* m_pRenderQueue;
+	glm::mat4 m_viewProjection;
+	glm::vec3 m_viewPosition;
+	SHADING_LIGHTS m_lights;
+	std::vector<float> m_lightRadii;
+	std::vector<FRAME_DRAW> m_frameDraws;
+	// triangles of each setup chunk, kept in draw order
+	std::vector<std::vector<TRIANGLE> > m_chunkTriangles;
+	// triangles overlapping every tile, in draw order
+	std::vector<std::vector<const TRIANGLE*> > m_tileBins;
+
+	// worker threads, woken for every job and waited for by Render()
+	std::vector<std::thread> m_workers;
+	std::mutex m_jobMutex;
+	std::condition_variable m_jobCondition;
+	std::condition_variable m_doneCondition;
+	int m_jobType;
+	int m_jobCount;
+	unsigned int m_jobGeneration;
+	int m_busyWorkers;
+	bool m_bStopping;
+	std::atomic<int> m_nextJob;
+
+	GLuint m_textureID;
+	GLuint m_framebufferID;
+	RASTER_STATS m_stats;
+
+	// tessellate the basic meshes
+	void BuildMeshes();
+
+	// run count jobs of the passed in type on the workers and the
+	// calling thread, returning when all of them are done
+	void RunJobs(int jobType, int count);
+	void WorkerMain();
+	// take jobs until none are left
+	void ProcessJobs(int jobType, JOB_COUNTERS& counters);
+
+	// vertex stage, clipping and triangle setup of one chunk of draws
+	void SetupChunk(int chunkIndex, JOB_COUNTERS& counters);
+	void SetupMesh(const MESH& mesh, int drawSlot, std::vector<TRIANGLE>& triangles, JOB_COUNTERS& counters);
+	// clip against the near plane and set up the remaining triangles
+	void ClipTriangle(const CLIP_VERTEX* pVertices, int drawSlot, std::vector<TRIANGLE>& triangles);
+	void SetupTriangle(const CLIP_VERTEX& v0, const CLIP_VERTEX& v1, const CLIP_VERTEX& v2, int drawSlot, std::vector<TRIANGLE>& triangles);
+	// append the triangles to the bins of the tiles they overlap
+	void BinTriangles();
+
+	// clear and rasterize one tile
+	void RasterTile(int tileIndex, JOB_COUNTERS& counters);
+	void RasterBlock(const TRIANGLE& triangle, int blockX, int blockY, JOB_COUNTERS& counters);
+	// shade one pixel with the barycentric weights of its vertices
+	glm::vec4 ShadePixel(const TRIANGLE& triangle, float weight0, float weight1, float weight2) const;
+	glm::vec4 SampleTexture(int textureSlot, const glm::vec2& uv) const;
+};
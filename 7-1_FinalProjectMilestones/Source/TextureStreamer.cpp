@@ -0,0 +1,502 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.cpp
+// ============
+// progressive texture loading - images are decoded and their mip chains are
+// built on a worker thread, then uploaded smallest level first under a
+// per-frame byte budget while the scene is already rendering
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureStreamer.h"
+#include "MemoryTracker.h"
+#include "TraceProfiler.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// default upload budget - a few full size levels per second
+	const size_t DEFAULT_UPLOAD_BUDGET = 1024 * 1024;
+	// MIN_LOD change per frame while a new level fades in
+	const float LOD_FADE_STEP = 0.125f;
+
+}
+
+/***********************************************************
+ *  TextureStreamer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureStreamer::TextureStreamer()
+{
+	m_uploadBudget = DEFAULT_UPLOAD_BUDGET;
+	m_bComplete = true;
+	m_frameCount = 0;
+	m_startTime = 0.0;
+	m_bStopWorker = false;
+	m_bFadeLevels = true;
+	m_mipFilter = MipGenerator::MIP_FILTER_BOX;
+}
+
+/***********************************************************
+ *  ~TextureStreamer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopWorker = true;
+	}
+	m_condition.notify_all();
+	if (m_worker.joinable())
+	{
+		m_worker.join();
+	}
+
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		glDeleteTextures(1, &m_textures[i]->textureID);
+		delete m_textures[i];
+	}
+	m_textures.clear();
+}
+
+/***********************************************************
+ *  SetUploadBudget()
+ *
+ *  This method is used to set how many bytes of mip level
+ *  data are uploaded per frame.  At least one level is
+ *  always uploaded, so a small budget cannot stall.
+ ***********************************************************/
+void TextureStreamer::SetUploadBudget(size_t bytesPerFrame)
+{
+	m_uploadBudget = bytesPerFrame;
+}
+
+/***********************************************************
+ *  SetMipFilter()
+ *
+ *  This method is used to set how the mip chains of the
+ *  textures created afterwards are built.  With the GPU
+ *  filter only level 0 is streamed and glGenerateMipmap
+ *  fills in the rest when it is uploaded.
+ ***********************************************************/
+void TextureStreamer::SetMipFilter(int filter)
+{
+	m_mipFilter = filter;
+}
+
+/***********************************************************
+ *  CreateTexture()
+ *
+ *  This method is used to create the texture object right
+ *  away, with a single neutral texel, and to queue the image
+ *  for decoding.  Only the image header is read here.
+ ***********************************************************/
+GLuint TextureStreamer::CreateTexture(const char* filename, GLint wrapS, GLint wrapT)
+{
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+
+	if (stbi_info(filename, &width, &height, &colorChannels) == 0)
+	{
+		std::cout << "Could not load image:" << filename << std::endl;
+		return(0);
+	}
+
+	GLenum format;
+	if (colorChannels == 1)
+		format = GL_RED;
+	else if (colorChannels == 3)
+		format = GL_RGB;
+	else if (colorChannels == 4)
+		format = GL_RGBA;
+	else
+	{
+		std::cout << "Error: Unsupported number of channels: " << colorChannels << std::endl;
+		return(0);
+	}
+
+	STREAMED_TEXTURE* pTexture = new STREAMED_TEXTURE();
+	pTexture->filename = filename;
+	pTexture->width = width;
+	pTexture->height = height;
+	pTexture->channels = colorChannels;
+	pTexture->format = format;
+	pTexture->bDecoded = false;
+	pTexture->bFailed = false;
+	pTexture->finestResident = 0;
+	pTexture->minLod = 0.0f;
+	pTexture->residentBytes = 0;
+	pTexture->totalBytes = 0;
+	pTexture->requestTime = TraceProfiler::NowMilliseconds();
+	pTexture->residentTime = -1.0;
+
+	// the placeholder texel keeps the texture complete until the
+	// first real level arrives
+	const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+
+	glActiveTexture(GL_TEXTURE0 + UPLOAD_TEXTURE_UNIT);
+	glGenTextures(1, &pTexture->textureID);
+	glBindTexture(GL_TEXTURE_2D, pTexture->textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT);
+
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	// the flip setting is global in stb_image, so it is set here
+	// rather than on the worker thread
+	stbi_set_flip_vertically_on_load(true);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_textures.push_back(pTexture);
+		m_decodeQueue.push_back(pTexture);
+	}
+	m_condition.notify_one();
+
+	if (!m_worker.joinable())
+	{
+		m_worker = std::thread(&TextureStreamer::WorkerMain, this);
+	}
+
+	if (m_bComplete)
+	{
+		m_bComplete = false;
+		m_frameCount = 0;
+		m_startTime = TraceProfiler::NowMilliseconds();
+	}
+
+	return(pTexture->textureID);
+}
+
+/***********************************************************
+ *  WorkerMain()
+ *
+ *  This method is used as the decode thread - it takes the
+ *  queued textures one at a time until it is stopped.
+ ***********************************************************/
+void TextureStreamer::WorkerMain()
+{
+	TRACE_THREAD_NAME("texture decode");
+	while (true)
+	{
+		STREAMED_TEXTURE* pTexture = NULL;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_bStopWorker || !m_decodeQueue.empty(); });
+			if (m_bStopWorker)
+			{
+				return;
+			}
+			pTexture = m_decodeQueue.front();
+			m_decodeQueue.pop_front();
+		}
+
+		DecodeTexture(pTexture);
+	}
+}
+
+/***********************************************************
+ *  DecodeTexture()
+ *
+ *  This method is used to decode the image and to build all
+ *  of its mip levels down to 1x1 with the mip generator.
+ *  Nothing here touches GL.
+ ***********************************************************/
+void TextureStreamer::DecodeTexture(STREAMED_TEXTURE* pTexture)
+{
+	// the phase stack is per thread, so the worker names its own
+	// phase for the decoded pixels and the mip chain
+	MEMORY_PHASE("LoadSceneTextures");
+	TRACE_SCOPE("DecodeTexture");
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+	std::vector<MIP_LEVEL> levels;
+
+	unsigned char* image = stbi_load(
+		pTexture->filename.c_str(),
+		&width,
+		&height,
+		&colorChannels,
+		pTexture->channels);
+
+	if (image)
+	{
+		MipGenerator::GenerateMipChain(
+			image, width, height, pTexture->channels, m_mipFilter, levels);
+		stbi_image_free(image);
+	}
+	else
+	{
+		std::cout << "Could not load image:" << pTexture->filename << std::endl;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	pTexture->levels = std::move(levels);
+	pTexture->bFailed = pTexture->levels.empty();
+	pTexture->finestResident = (int)pTexture->levels.size();
+	for (size_t i = 0; i < pTexture->levels.size(); i++)
+	{
+		pTexture->totalBytes += pTexture->levels[i].pixels.size();
+	}
+	pTexture->bDecoded = true;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used to upload the next mip levels.  The
+ *  smallest missing level of each texture goes first, and
+ *  the textures take turns, so that every texture sharpens
+ *  at the same pace until the byte budget is used up.
+ ***********************************************************/
+void TextureStreamer::Update()
+{
+	TRACE_SCOPE("UploadTextureMips");
+	if (m_bComplete)
+	{
+		return;
+	}
+
+	m_frameCount++;
+
+	std::vector<STREAMED_TEXTURE*> decoded;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (size_t i = 0; i < m_textures.size(); i++)
+		{
+			if (m_textures[i]->bDecoded && !m_textures[i]->bFailed)
+			{
+				decoded.push_back(m_textures[i]);
+			}
+		}
+	}
+
+	glActiveTexture(GL_TEXTURE0 + UPLOAD_TEXTURE_UNIT);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	size_t uploadedBytes = 0;
+	bool bUploaded = true;
+	while (bUploaded && ((uploadedBytes < m_uploadBudget) || (uploadedBytes == 0)))
+	{
+		bUploaded = false;
+		for (size_t i = 0; i < decoded.size(); i++)
+		{
+			STREAMED_TEXTURE* pTexture = decoded[i];
+			if (pTexture->finestResident == 0)
+			{
+				continue;
+			}
+
+			int level = pTexture->finestResident - 1;
+			size_t levelBytes = pTexture->levels[level].pixels.size();
+			if ((uploadedBytes > 0) && (uploadedBytes + levelBytes > m_uploadBudget))
+			{
+				continue;
+			}
+
+			UploadLevel(pTexture, level);
+			uploadedBytes += levelBytes;
+			bUploaded = true;
+		}
+	}
+
+	// fade in the levels uploaded on earlier frames
+	bool bComplete = true;
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		STREAMED_TEXTURE* pTexture = m_textures[i];
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!pTexture->bDecoded)
+		{
+			bComplete = false;
+		}
+		else if (!pTexture->bFailed)
+		{
+			UpdateMinLod(pTexture);
+			if ((pTexture->finestResident > 0) || (pTexture->minLod > 0.0f))
+			{
+				bComplete = false;
+			}
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	if (bComplete)
+	{
+		m_bComplete = true;
+		std::cout << "INFO: All textures resident after " << m_frameCount << " frames, "
+			<< (TraceProfiler::NowMilliseconds() - m_startTime) << " ms" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  UploadLevel()
+ *
+ *  This method is used to upload one mip level and to lower
+ *  the base level to it.  The CPU copy of the level is freed
+ *  once it is on the GPU.
+ ***********************************************************/
+void TextureStreamer::UploadLevel(STREAMED_TEXTURE* pTexture, int level)
+{
+	MIP_LEVEL& mipLevel = pTexture->levels[level];
+
+	glBindTexture(GL_TEXTURE_2D, pTexture->textureID);
+	glTexImage2D(GL_TEXTURE_2D, level, pTexture->format, mipLevel.width, mipLevel.height, 0,
+		pTexture->format, GL_UNSIGNED_BYTE, mipLevel.pixels.data());
+
+	// the first real level also ends the placeholder's range
+	if (pTexture->finestResident == (int)pTexture->levels.size())
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+	// start the new level blurred and sharpen it over the next
+	// frames, instead of popping it in at once
+	if ((m_bFadeLevels == true) && (level < (int)pTexture->levels.size() - 1))
+	{
+		pTexture->minLod = 1.0f;
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, pTexture->minLod);
+	}
+
+	// only level 0 was streamed - let the driver build the rest
+	if ((pTexture->levels.size() == 1) && ((mipLevel.width > 1) || (mipLevel.height > 1)))
+	{
+		int maxLevel = (int)floor(log2((double)std::max(mipLevel.width, mipLevel.height)));
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+	}
+
+	pTexture->residentBytes += mipLevel.pixels.size();
+	pTexture->finestResident = level;
+	std::vector<unsigned char>().swap(mipLevel.pixels);
+
+	if (level == 0)
+	{
+		pTexture->residentTime = TraceProfiler::NowMilliseconds();
+	}
+}
+
+/***********************************************************
+ *  UpdateMinLod()
+ *
+ *  This method is used to lower GL_TEXTURE_MIN_LOD one step
+ *  towards the newly uploaded base level.
+ ***********************************************************/
+void TextureStreamer::UpdateMinLod(STREAMED_TEXTURE* pTexture)
+{
+	if (pTexture->minLod <= 0.0f)
+	{
+		return;
+	}
+
+	pTexture->minLod = std::max(pTexture->minLod - LOD_FADE_STEP, 0.0f);
+	glBindTexture(GL_TEXTURE_2D, pTexture->textureID);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, pTexture->minLod);
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used to wait for the decode thread and to
+ *  upload every remaining level at once, which gives the
+ *  behavior of loading without streaming.
+ ***********************************************************/
+void TextureStreamer::Finish()
+{
+	size_t uploadBudget = m_uploadBudget;
+	m_uploadBudget = (size_t)-1;
+	// skip the fade, there is no frame to see it in
+	m_bFadeLevels = false;
+
+	while (!m_bComplete)
+	{
+		Update();
+		if (!m_bComplete)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	m_uploadBudget = uploadBudget;
+	m_bFadeLevels = true;
+}
+
+/***********************************************************
+ *  GetResidency()
+ *
+ *  This method is used to get the resident levels and bytes
+ *  of the texture with the passed in index.
+ ***********************************************************/
+TextureStreamer::TEXTURE_RESIDENCY TextureStreamer::GetResidency(int index) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const STREAMED_TEXTURE* pTexture = m_textures[index];
+
+	TEXTURE_RESIDENCY residency;
+	residency.filename = pTexture->filename;
+	residency.width = pTexture->width;
+	residency.height = pTexture->height;
+	residency.levelCount = (int)pTexture->levels.size();
+	residency.residentLevels = (int)pTexture->levels.size() - pTexture->finestResident;
+	residency.residentBytes = pTexture->residentBytes;
+	residency.totalBytes = pTexture->totalBytes;
+	residency.residentMilliseconds = -1.0;
+	if (pTexture->residentTime >= 0.0)
+	{
+		residency.residentMilliseconds = pTexture->residentTime - pTexture->requestTime;
+	}
+	return(residency);
+}
+
+/***********************************************************
+ *  PrintResidency()
+ *
+ *  This method is used to print the resident mip levels and
+ *  memory of every streamed texture.
+ ***********************************************************/
+void TextureStreamer::PrintResidency() const
+{
+	std::cout << "INFO: Texture residency\n";
+	for (int i = 0; i < GetTextureCount(); i++)
+	{
+		TEXTURE_RESIDENCY residency = GetResidency(i);
+		std::cout << "  " << std::left << std::setw(36) << residency.filename << std::right
+			<< std::setw(6) << residency.width << "x" << std::setw(5) << std::left << residency.height << std::right
+			<< " levels " << residency.residentLevels << "/" << residency.levelCount
+			<< ", " << (residency.residentBytes / 1024) << "/" << (residency.totalBytes / 1024) << " KB";
+		if (residency.residentMilliseconds >= 0.0)
+		{
+			std::cout << ", resident after " << residency.residentMilliseconds << " ms";
+		}
+		std::cout << "\n";
+	}
+	std::cout << std::endl;
+}
@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.h
+// ============
+// progressive texture loading - images are decoded and their mip chains are
+// built on a worker thread, then uploaded smallest level first under a
+// per-frame byte budget while the scene is already rendering
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MipGenerator.h"
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  TextureStreamer
+ *
+ *  This class owns the streamed texture objects, the decode
+ *  worker thread and the per-frame mip level uploads.
+ ***********************************************************/
+class TextureStreamer
+{
+public:
+	// residency of one texture, for the statistics output
+	struct TEXTURE_RESIDENCY
+	{
+		std::string filename;
+		int width;
+		int height;
+		int levelCount;
+		int residentLevels;
+		size_t residentBytes;
+		size_t totalBytes;
+		// time from the request until every level was resident,
+		// or a negative value while levels are still missing
+		double residentMilliseconds;
+	};
+
+	// texture unit used to bind textures while uploading, so that
+	// the units the shader samples from are left untouched
+	static const int UPLOAD_TEXTURE_UNIT = 11;
+
+	// constructor
+	TextureStreamer();
+	// destructor
+	~TextureStreamer();
+
+	// bytes of mip level data uploaded per Update() call
+	void SetUploadBudget(size_t bytesPerFrame);
+	// MipGenerator::MIP_FILTER used for the textures created afterwards
+	void SetMipFilter(int filter);
+
+	// create the texture object for the image file and queue it
+	// for decoding - returns 0 if the image cannot be read
+	GLuint CreateTexture(const char* filename, GLint wrapS, GLint wrapT);
+
+	// upload the next mip levels within the budget; called once
+	// per frame before drawing
+	void Update();
+	// wait for every texture and upload all remaining levels
+	void Finish();
+	// true once every level of every texture is resident
+	bool IsComplete() const { return m_bComplete; }
+
+	int GetTextureCount() const { return (int)m_textures.size(); }
+	TEXTURE_RESIDENCY GetResidency(int index) const;
+	// print the resident levels and memory of every texture
+	void PrintResidency() const;
+
+private:
+	typedef MipGenerator::MIP_LEVEL MIP_LEVEL;
+
+	struct STREAMED_TEXTURE
+	{
+		GLuint textureID;
+		std::string filename;
+		int width;
+		int height;
+		int channels;
+		GLenum format;
+		// filled in by the worker thread; only read by the main
+		// thread after bDecoded was set under the mutex
+		std::vector<MIP_LEVEL> levels;
+		bool bDecoded;
+		bool bFailed;
+		// finest level that has been uploaded (levels.size() while
+		// none is); sampling is clamped to the resident levels
+		int finestResident;
+		// MIN_LOD that fades a newly uploaded level in
+		float minLod;
+		size_t residentBytes;
+		size_t totalBytes;
+		double requestTime;
+		double residentTime;
+	};
+
+	std::vector<STREAMED_TEXTURE*> m_textures;
+	size_t m_uploadBudget;
+	// lower MIN_LOD gradually after each uploaded level
+	bool m_bFadeLevels;
+	// how the worker builds the mip chains
+	int m_mipFilter;
+	bool m_bComplete;
+	int m_frameCount;
+	double m_startTime;
+
+	// decode worker and the queue of textures it still has to decode
+	std::thread m_worker;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<STREAMED_TEXTURE*> m_decodeQueue;
+	bool m_bStopWorker;
+
+	void WorkerMain();
+	// decode the image file and build the full mip chain
+	void DecodeTexture(STREAMED_TEXTURE* pTexture);
+	// upload one level and clamp the sampled levels to it
+	void UploadLevel(STREAMED_TEXTURE* pTexture, int level);
+	// fade the most recently uploaded level in over a few frames
+	void UpdateMinLod(STREAMED_TEXTURE* pTexture);
+};
@@ -0,0 +1,312 @@
+///////////////////////////////////////////////////////////////////////////////
+// traceprofiler.cpp
+// ============
+// optional CPU trace profiler - scoped timers append their events to a buffer
+// of the calling thread, and the events of every thread are written out as
+// Chrome trace-event JSON (chrome://tracing or ui.perfetto.dev)
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TraceProfiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef ENABLE_TRACE_PROFILER
+
+// declaration of the global variables and defines
+namespace
+{
+	// one finished scope, in microseconds since Initialize()
+	struct TRACE_EVENT
+	{
+		const char* name;
+		double startTime;
+		double duration;
+	};
+
+	// the events of a thread are kept in fixed size chunks, so that
+	// recorded events never move and can be read while the thread
+	// keeps appending
+	const size_t EVENTS_PER_CHUNK = 4096;
+	const size_t MAX_CHUNKS = 1024;
+
+	struct THREAD_BUFFER
+	{
+		int threadID;
+		std::atomic<const char*> threadName;
+		std::atomic<TRACE_EVENT*> chunks[MAX_CHUNKS];
+		// published after the event is written
+		std::atomic<size_t> eventCount;
+		std::atomic<uint64_t> droppedEvents;
+	};
+
+	std::atomic<bool> g_bRecording(false);
+	std::chrono::steady_clock::time_point g_startTime;
+	std::string g_outputFilename;
+
+	// every thread that recorded an event; the buffers are only
+	// released at process exit, since a worker thread may still be
+	// closing a scope while the trace is written
+	std::mutex g_bufferMutex;
+	std::vector<THREAD_BUFFER*> g_threadBuffers;
+
+	thread_local THREAD_BUFFER* t_pThreadBuffer = NULL;
+
+	/***********************************************************
+	 *  GetThreadBuffer()
+	 *
+	 *  Return the event buffer of the calling thread, creating
+	 *  and registering it on the thread's first event.
+	 ***********************************************************/
+	THREAD_BUFFER* GetThreadBuffer()
+	{
+		if (NULL == t_pThreadBuffer)
+		{
+			THREAD_BUFFER* pBuffer = new THREAD_BUFFER;
+			pBuffer->threadName.store(NULL, std::memory_order_relaxed);
+			for (size_t i = 0; i < MAX_CHUNKS; i++)
+			{
+				pBuffer->chunks[i].store(NULL, std::memory_order_relaxed);
+			}
+			pBuffer->eventCount.store(0, std::memory_order_relaxed);
+			pBuffer->droppedEvents.store(0, std::memory_order_relaxed);
+
+			std::lock_guard<std::mutex> lock(g_bufferMutex);
+			pBuffer->threadID = (int)g_threadBuffers.size() + 1;
+			g_threadBuffers.push_back(pBuffer);
+			t_pThreadBuffer = pBuffer;
+		}
+		return(t_pThreadBuffer);
+	}
+
+	/***********************************************************
+	 *  WriteJsonString()
+	 *
+	 *  Write a quoted JSON string, escaping the characters that
+	 *  would end it.
+	 ***********************************************************/
+	void WriteJsonString(FILE* pFile, const char* text)
+	{
+		fputc('"', pFile);
+		for (const char* pChar = (NULL != text) ? text : ""; *pChar != '\0'; pChar++)
+		{
+			if ((*pChar == '"') || (*pChar == '\\'))
+			{
+				fputc('\\', pFile);
+			}
+			fputc(((unsigned char)*pChar < 0x20) ? ' ' : *pChar, pFile);
+		}
+		fputc('"', pFile);
+	}
+}
+
+/***********************************************************
+ *  IsEnabled()
+ *
+ *  The trace scopes were compiled into this build.
+ ***********************************************************/
+bool TraceProfiler::IsEnabled()
+{
+	return(true);
+}
+
+/***********************************************************
+ *  IsRecording()
+ *
+ *  Events are only kept between Initialize() with the
+ *  TRACE_PROFILE variable set and Shutdown().
+ ***********************************************************/
+bool TraceProfiler::IsRecording()
+{
+	return(g_bRecording.load(std::memory_order_relaxed));
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  Read the output file from the TRACE_PROFILE environment
+ *  variable and start recording, with the calling thread
+ *  named as the main thread.
+ ***********************************************************/
+void TraceProfiler::Initialize()
+{
+	const char* filename = getenv("TRACE_PROFILE");
+	if ((NULL == filename) || (filename[0] == '\0'))
+	{
+		return;
+	}
+
+	g_outputFilename = filename;
+	g_startTime = std::chrono::steady_clock::now();
+	g_bRecording.store(true, std::memory_order_release);
+	SetThreadName("main");
+
+	std::cout << "INFO: Recording a CPU trace to " << g_outputFilename << std::endl;
+}
+
+/***********************************************************
+ *  Shutdown()
+ *
+ *  Stop recording and write every recorded event as a
+ *  complete ("X") event, followed by the thread names as
+ *  metadata events.
+ ***********************************************************/
+void TraceProfiler::Shutdown()
+{
+	if (!g_bRecording.exchange(false))
+	{
+		return;
+	}
+
+	FILE* pFile = fopen(g_outputFilename.c_str(), "w");
+	if (NULL == pFile)
+	{
+		std::cerr << "ERROR: Could not write the CPU trace: " << g_outputFilename << std::endl;
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_bufferMutex);
+
+	size_t writtenEvents = 0;
+	uint64_t droppedEvents = 0;
+	bool bFirst = true;
+	fprintf(pFile, "{\"traceEvents\":[\n");
+	for (THREAD_BUFFER* pBuffer : g_threadBuffers)
+	{
+		size_t eventCount = pBuffer->eventCount.load(std::memory_order_acquire);
+		for (size_t i = 0; i < eventCount; i++)
+		{
+			const TRACE_EVENT& event = pBuffer->chunks[i / EVENTS_PER_CHUNK].load(std::memory_order_relaxed)[i % EVENTS_PER_CHUNK];
+			fprintf(pFile, "%s{\"name\":", bFirst ? "" : ",\n");
+			WriteJsonString(pFile, event.name);
+			fprintf(pFile, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+				event.startTime, event.duration, pBuffer->threadID);
+			bFirst = false;
+		}
+		writtenEvents += eventCount;
+		droppedEvents += pBuffer->droppedEvents.load(std::memory_order_relaxed);
+
+		const char* threadName = pBuffer->threadName.load(std::memory_order_relaxed);
+		if (NULL != threadName)
+		{
+			fprintf(pFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+				bFirst ? "" : ",\n", pBuffer->threadID);
+			WriteJsonString(pFile, threadName);
+			fprintf(pFile, "}}");
+			bFirst = false;
+		}
+	}
+	fprintf(pFile, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(pFile);
+
+	std::cout << "INFO: Wrote " << writtenEvents << " trace events from " << g_threadBuffers.size()
+		<< " threads to " << g_outputFilename;
+	if (droppedEvents > 0)
+	{
+		std::cout << ", " << droppedEvents << " events dropped";
+	}
+	std::cout << std::endl;
+}
+
+/***********************************************************
+ *  SetThreadName()
+ *
+ *  Name the calling thread's track in the trace viewer.
+ ***********************************************************/
+void TraceProfiler::SetThreadName(const char* threadName)
+{
+	if (IsRecording())
+	{
+		GetThreadBuffer()->threadName.store(threadName, std::memory_order_relaxed);
+	}
+}
+
+/***********************************************************
+ *  NowMicroseconds()
+ *
+ *  Time since recording started, in microseconds.
+ ***********************************************************/
+double TraceProfiler::NowMicroseconds()
+{
+	return std::chrono::duration<double, std::micro>(
+		std::chrono::steady_clock::now() - g_startTime).count();
+}
+
+/***********************************************************
+ *  RecordEvent()
+ *
+ *  Append a finished scope to the calling thread's buffer.
+ *  Only the owning thread appends, so the event is written
+ *  first and then published by the count; a new chunk is
+ *  published before the count that reaches into it.
+ ***********************************************************/
+void TraceProfiler::RecordEvent(const char* eventName, double startTime, double endTime)
+{
+	if (!IsRecording())
+	{
+		return;
+	}
+
+	THREAD_BUFFER* pBuffer = GetThreadBuffer();
+	size_t index = pBuffer->eventCount.load(std::memory_order_relaxed);
+	size_t chunkIndex = index / EVENTS_PER_CHUNK;
+	if (chunkIndex >= MAX_CHUNKS)
+	{
+		pBuffer->droppedEvents.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	TRACE_EVENT* pChunk = pBuffer->chunks[chunkIndex].load(std::memory_order_relaxed);
+	if (NULL == pChunk)
+	{
+		pChunk = new TRACE_EVENT[EVENTS_PER_CHUNK];
+		pBuffer->chunks[chunkIndex].store(pChunk, std::memory_order_relaxed);
+	}
+
+	TRACE_EVENT& event = pChunk[index % EVENTS_PER_CHUNK];
+	event.name = eventName;
+	event.startTime = startTime;
+	event.duration = endTime - startTime;
+	pBuffer->eventCount.store(index + 1, std::memory_order_release);
+}
+
+#else
+
+bool TraceProfiler::IsEnabled()
+{
+	return(false);
+}
+
+bool TraceProfiler::IsRecording()
+{
+	return(false);
+}
+
+void TraceProfiler::Initialize()
+{
+}
+
+void TraceProfiler::Shutdown()
+{
+}
+
+void TraceProfiler::SetThreadName(const char*)
+{
+}
+
+double TraceProfiler::NowMicroseconds()
+{
+	return(0.0);
+}
+
+void TraceProfiler::RecordEvent(const char*, double, double)
+{
+}
+
+#endif
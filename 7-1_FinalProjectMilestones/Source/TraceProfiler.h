@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// traceprofiler.h
+// ============
+// optional CPU trace profiler - scoped timers append their events to a buffer
+// of the calling thread, and the events of every thread are written out as
+// Chrome trace-event JSON (chrome://tracing or ui.perfetto.dev)
+//
+//  The scopes are only compiled in when the ENABLE_TRACE_PROFILER
+//  preprocessor symbol is defined in the project settings; without it the
+//  trace macros compile to nothing.  Even when compiled in, nothing is
+//  recorded unless the TRACE_PROFILE environment variable names the file
+//  the trace is written to.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace TraceProfiler
+{
+	// true when the scopes were compiled into the application
+	bool IsEnabled();
+	// true while events are being recorded
+	bool IsRecording();
+
+	// start recording if the TRACE_PROFILE environment variable is
+	// set; called once at startup, before the first scope
+	void Initialize();
+	// stop recording and write the events of every thread to the
+	// file named by TRACE_PROFILE
+	void Shutdown();
+
+	// name the calling thread in the trace; the name must be a
+	// string literal or otherwise outlive the profiler
+	void SetThreadName(const char* threadName);
+
+	// microseconds since Initialize()
+	double NowMicroseconds();
+	// monotonic clock in milliseconds, for the frame and pass timings;
+	// defined here so that it works without the profiler compiled in
+	inline double NowMilliseconds()
+	{
+		return std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+	// append a finished scope to the calling thread's buffer
+	void RecordEvent(const char* eventName, double startTime, double endTime);
+
+	// records the time spent in the enclosing scope
+	class ScopedEvent
+	{
+	public:
+		explicit ScopedEvent(const char* eventName)
+		{
+			m_eventName = eventName;
+			m_startTime = IsRecording() ? NowMicroseconds() : -1.0;
+		}
+		~ScopedEvent()
+		{
+			if (m_startTime >= 0.0)
+			{
+				RecordEvent(m_eventName, m_startTime, NowMicroseconds());
+			}
+		}
+	private:
+		const char* m_eventName;
+		double m_startTime;
+
+		ScopedEvent(const ScopedEvent&) = delete;
+		ScopedEvent& operator=(const ScopedEvent&) = delete;
+	};
+}
+
+#ifdef ENABLE_TRACE_PROFILER
+#define TRACE_PROFILER_CONCAT_INNER(a, b) a##b
+#define TRACE_PROFILER_CONCAT(a, b) TRACE_PROFILER_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(eventName) TraceProfiler::ScopedEvent TRACE_PROFILER_CONCAT(traceScope_, __LINE__)(eventName)
+#define TRACE_THREAD_NAME(threadName) TraceProfiler::SetThreadName(threadName)
+#else
+#define TRACE_SCOPE(eventName)
+#define TRACE_THREAD_NAME(threadName)
+#endif
@@ -8,11 +8,17 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ViewManager.h"
+#include "TraceProfiler.h"
+#include "GLStateCache.h"
+#include "ScenePicker.h"
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
-#include <glm/gtc/type_ptr.hpp>    
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <iostream>    
 
 // declaration of the global variables and defines
 namespace
@@ -39,6 +45,23 @@ namespace
 	// the following variable is false when orthographic projection
 	// is off and true when it is on
 	bool bOrthographicProjection = false;
+
+	// fixed time step of a replayed camera path
+	const float REPLAY_TIMESTEP = 1.0f / 60.0f;
+	// mouse input is not applied while a camera path is replayed
+	bool gbReplayingCamera = false;
+	// mouse input of the current frame, for the camera recording
+	float gMouseOffsetX = 0.0f;
+	float gMouseOffsetY = 0.0f;
+	float gScrollOffset = 0.0f;
+
+	// a left click asks for a pick at the cursor, in normalized
+	// device coordinates; the C key releases the cursor from the
+	// camera, so that it can be moved onto an object
+	bool gbPickRequested = false;
+	float gPickX = 0.0f;
+	float gPickY = 0.0f;
+	bool gbCursorReleased = false;
 }
 
 /***********************************************************
@@ -52,6 +75,13 @@ ViewManager::ViewManager(
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
+	m_pCameraPath = NULL;
+	m_cameraPathMode = CAMERA_PATH_OFF;
+	m_replayFrame = 0;
+	m_lastReplayTime = 0.0;
+	m_bShowPerfHud = false;
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(0.0f, 5.0f, 12.0f);
@@ -76,6 +106,11 @@ ViewManager::~ViewManager()
 		delete g_pCamera;
 		g_pCamera = NULL;
 	}
+	if (NULL != m_pCameraPath)
+	{
+		delete m_pCameraPath;
+		m_pCameraPath = NULL;
+	}
 }
 
 /***********************************************************
@@ -85,6 +120,7 @@ ViewManager::~ViewManager()
  ***********************************************************/
 GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 {
+	TRACE_SCOPE("CreateDisplayWindow");
 	GLFWwindow* window = nullptr;
 
 	// try to create the displayed OpenGL window
@@ -110,8 +146,11 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	// this callback is used to receive mouse scroll events
 	glfwSetScrollCallback(window, &ViewManager::Mouse_Scroll_Callback);
 
-	// enable blending for supporting tranparent rendering
-	glEnable(GL_BLEND);
+	// this callback is used to receive mouse button events
+	glfwSetMouseButtonCallback(window, &ViewManager::Mouse_Button_Callback);
+
+	// blend function for tranparent rendering - blending itself is
+	// only enabled by the scene manager for the passes that need it
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	m_pWindow = window;
@@ -145,8 +184,22 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
 	gLastX = xMousePos;
 	gLastY = yMousePos;
 
+	// the replayed path owns the camera
+	if (gbReplayingCamera)
+	{
+		return;
+	}
+
+	// a released cursor moves over the scene without turning it
+	if (gbCursorReleased)
+	{
+		return;
+	}
+
 	// move the 3D camera according to the calculated offsets
 	g_pCamera->ProcessMouseMovement(xOffset, yOffset);
+	gMouseOffsetX += xOffset;
+	gMouseOffsetY += yOffset;
 }
 
 /***********************************************************
@@ -159,11 +212,288 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
 void ViewManager::Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, double yOffset)
 {
 	// Pass the scroll input to the camera's ProcessMouseScroll method
-	if (g_pCamera != nullptr)
+	if ((g_pCamera != nullptr) && !gbReplayingCamera)
 	{
 		g_pCamera->ProcessMouseScroll(static_cast<float>(yOffset));
+		gScrollOffset += static_cast<float>(yOffset);
+	}
+}
+/***********************************************************
+ *  Mouse_Button_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  a mouse button is pressed or released within the active
+ *  GLFW display window.
+ ***********************************************************/
+void ViewManager::Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if ((button != GLFW_MOUSE_BUTTON_LEFT) || (action != GLFW_PRESS))
+	{
+		return;
+	}
+
+	int windowWidth = 0;
+	int windowHeight = 0;
+	glfwGetWindowSize(window, &windowWidth, &windowHeight);
+	if ((windowWidth <= 0) || (windowHeight <= 0))
+	{
+		return;
+	}
+
+	// a captured cursor is hidden and steers the camera, so the
+	// pick goes through the center of the view
+	double xCursorPos = windowWidth * 0.5;
+	double yCursorPos = windowHeight * 0.5;
+	if (gbCursorReleased)
+	{
+		glfwGetCursorPos(window, &xCursorPos, &yCursorPos);
+	}
+
+	// reversed since y-coordinates go from bottom to top
+	gPickX = (float)(2.0 * xCursorPos / windowWidth - 1.0);
+	gPickY = (float)(1.0 - 2.0 * yCursorPos / windowHeight);
+	gbPickRequested = true;
+}
+
+/***********************************************************
+ *  TakePickRay()
+ *
+ *  This method is used for getting the world space ray under
+ *  the cursor of the last left click.  The click is used up,
+ *  so a click is picked only once.
+ ***********************************************************/
+bool ViewManager::TakePickRay(glm::vec3& origin, glm::vec3& direction)
+{
+	if (gbPickRequested == false)
+	{
+		return(false);
 	}
+	gbPickRequested = false;
+
+	ScenePicker::GetViewRay(m_viewMatrix, m_projectionMatrix, gPickX, gPickY, origin, direction);
+	return(true);
+}
+
+/***********************************************************
+ *  SetCameraPose()
+ *
+ *  This method is used for placing the camera at a fixed
+ *  position and direction, with the passed in projection,
+ *  the same way as the O and P keys do.
+ ***********************************************************/
+void ViewManager::SetCameraPose(
+	glm::vec3 position,
+	glm::vec3 front,
+	float zoom,
+	bool bOrthographic)
+{
+	bOrthographicProjection = bOrthographic;
+	g_pCamera->Position = position;
+	g_pCamera->Front = front;
+	g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
+	g_pCamera->Zoom = zoom;
+}
+
+/***********************************************************
+ *  GetViewWidth()
+ *
+ *  This method is used for getting the width that the
+ *  projection aspect ratio is calculated from.
+ ***********************************************************/
+int ViewManager::GetViewWidth()
+{
+	return(WINDOW_WIDTH);
+}
+
+/***********************************************************
+ *  GetViewHeight()
+ *
+ *  This method is used for getting the height that the
+ *  projection aspect ratio is calculated from.
+ ***********************************************************/
+int ViewManager::GetViewHeight()
+{
+	return(WINDOW_HEIGHT);
 }
+
+/***********************************************************
+ *  StartCameraRecording()
+ *
+ *  This method is used to start recording the camera state
+ *  and the input of every frame.  The path is written to the
+ *  passed in file by StopCameraPath().
+ ***********************************************************/
+void ViewManager::StartCameraRecording(const char* filename)
+{
+	if (NULL == m_pCameraPath)
+	{
+		m_pCameraPath = new CameraPath();
+	}
+	m_pCameraPath->Clear();
+	m_cameraPathFilename = filename;
+	m_cameraPathMode = CAMERA_PATH_RECORD;
+	gMouseOffsetX = 0.0f;
+	gMouseOffsetY = 0.0f;
+	gScrollOffset = 0.0f;
+
+	std::cout << "INFO: Recording the camera path to " << filename << std::endl;
+}
+
+/***********************************************************
+ *  StartCameraReplay()
+ *
+ *  This method is used to load a recorded camera path and
+ *  to replay it from the next frame on.  Vsync is turned off
+ *  so that the measured frame times are the render times.
+ ***********************************************************/
+bool ViewManager::StartCameraReplay(const char* filename)
+{
+	if (NULL == m_pCameraPath)
+	{
+		m_pCameraPath = new CameraPath();
+	}
+	if ((m_pCameraPath->Load(filename) == false) || (m_pCameraPath->GetFrameCount() == 0))
+	{
+		return(false);
+	}
+
+	m_cameraPathFilename = filename;
+	m_cameraPathMode = CAMERA_PATH_REPLAY;
+	m_replayFrame = 0;
+	m_replayFrameTimes.clear();
+	m_replayFrameTimes.reserve(m_pCameraPath->GetFrameCount());
+	m_lastReplayTime = 0.0;
+	gbReplayingCamera = true;
+
+	glfwSwapInterval(0);
+	return(true);
+}
+
+/***********************************************************
+ *  StopCameraPath()
+ *
+ *  This method is used to end the recording or the replay.
+ *  A recording is written to its file, and a replay prints
+ *  the frame times it measured.
+ ***********************************************************/
+void ViewManager::StopCameraPath()
+{
+	if (m_cameraPathMode == CAMERA_PATH_RECORD)
+	{
+		m_pCameraPath->Save(m_cameraPathFilename.c_str());
+	}
+	else if (m_cameraPathMode == CAMERA_PATH_REPLAY)
+	{
+		PrintReplayStats();
+		gbReplayingCamera = false;
+		glfwSwapInterval(1);
+	}
+	m_cameraPathMode = CAMERA_PATH_OFF;
+}
+
+/***********************************************************
+ *  RecordCameraFrame()
+ *
+ *  This method is used to append the camera state after the
+ *  input of this frame was processed, together with that
+ *  input, to the recorded path.
+ ***********************************************************/
+void ViewManager::RecordCameraFrame()
+{
+	const int keys[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E, GLFW_KEY_O, GLFW_KEY_P };
+
+	CameraPath::CAMERA_FRAME frame;
+	frame.deltaTime = gDeltaTime;
+	frame.position = g_pCamera->Position;
+	frame.front = g_pCamera->Front;
+	frame.up = g_pCamera->Up;
+	frame.yaw = g_pCamera->Yaw;
+	frame.pitch = g_pCamera->Pitch;
+	frame.zoom = g_pCamera->Zoom;
+	frame.bOrthographic = bOrthographicProjection;
+	frame.keys = 0;
+	for (int i = 0; i < (int)(sizeof(keys) / sizeof(keys[0])); i++)
+	{
+		if (glfwGetKey(m_pWindow, keys[i]) == GLFW_PRESS)
+		{
+			frame.keys |= (uint16_t)(1 << i);
+		}
+	}
+	frame.mouseOffsetX = gMouseOffsetX;
+	frame.mouseOffsetY = gMouseOffsetY;
+	frame.scrollOffset = gScrollOffset;
+	m_pCameraPath->AddFrame(frame);
+
+	gMouseOffsetX = 0.0f;
+	gMouseOffsetY = 0.0f;
+	gScrollOffset = 0.0f;
+}
+
+/***********************************************************
+ *  ReplayCameraFrame()
+ *
+ *  This method is used to set the camera to the next frame
+ *  of the replayed path, and to close the window after the
+ *  last one.  Escape still ends the replay early.
+ ***********************************************************/
+void ViewManager::ReplayCameraFrame()
+{
+	double currentTime = TraceProfiler::NowMilliseconds();
+	if (m_lastReplayTime > 0.0)
+	{
+		m_replayFrameTimes.push_back(currentTime - m_lastReplayTime);
+	}
+	m_lastReplayTime = currentTime;
+
+	if ((m_replayFrame >= m_pCameraPath->GetFrameCount()) ||
+		(glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS))
+	{
+		StopCameraPath();
+		glfwSetWindowShouldClose(m_pWindow, true);
+		return;
+	}
+
+	const CameraPath::CAMERA_FRAME& frame = m_pCameraPath->GetFrame(m_replayFrame++);
+	g_pCamera->Position = frame.position;
+	g_pCamera->Front = frame.front;
+	g_pCamera->Up = frame.up;
+	g_pCamera->Yaw = frame.yaw;
+	g_pCamera->Pitch = frame.pitch;
+	g_pCamera->Zoom = frame.zoom;
+	bOrthographicProjection = frame.bOrthographic;
+}
+
+/***********************************************************
+ *  PrintReplayStats()
+ *
+ *  This method is used to print the frame times measured
+ *  over the replayed path.
+ ***********************************************************/
+void ViewManager::PrintReplayStats() const
+{
+	if (m_replayFrameTimes.empty())
+	{
+		return;
+	}
+
+	std::vector<double> sortedTimes = m_replayFrameTimes;
+	std::sort(sortedTimes.begin(), sortedTimes.end());
+	double totalTime = 0.0;
+	for (size_t i = 0; i < sortedTimes.size(); i++)
+	{
+		totalTime += sortedTimes[i];
+	}
+
+	std::cout << "INFO: Camera path replay of " << m_cameraPathFilename << "\n";
+	std::cout << "  frames: " << sortedTimes.size()
+		<< ", total " << totalTime << " ms\n";
+	std::cout << "  frame time: avg " << (totalTime / sortedTimes.size())
+		<< " ms, median " << sortedTimes[sortedTimes.size() / 2]
+		<< " ms, 95th " << sortedTimes[(sortedTimes.size() * 95) / 100]
+		<< " ms, max " << sortedTimes.back() << " ms\n";
+	std::cout << std::endl;
+}
+
 /***********************************************************
  *  ProcessKeyboardEvents()
  *
@@ -235,6 +565,34 @@ void ViewManager::ProcessKeyboardEvents()
 	{
 		pPressed = false;
 	}
+
+	// toggle the performance HUD
+	static bool hPressed = false;
+	if (glfwGetKey(m_pWindow, GLFW_KEY_H) == GLFW_PRESS && !hPressed)
+	{
+		m_bShowPerfHud = !m_bShowPerfHud;
+		hPressed = true;
+	}
+	else if (glfwGetKey(m_pWindow, GLFW_KEY_H) == GLFW_RELEASE)
+	{
+		hPressed = false;
+	}
+
+	// release the cursor for picking objects with a left click,
+	// or capture it again for steering the camera
+	static bool cPressed = false;
+	if (glfwGetKey(m_pWindow, GLFW_KEY_C) == GLFW_PRESS && !cPressed)
+	{
+		gbCursorReleased = !gbCursorReleased;
+		glfwSetInputMode(m_pWindow, GLFW_CURSOR, gbCursorReleased ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
+		// the camera does not jump to where the cursor was moved
+		gFirstMouse = true;
+		cPressed = true;
+	}
+	else if (glfwGetKey(m_pWindow, GLFW_KEY_C) == GLFW_RELEASE)
+	{
+		cPressed = false;
+	}
 }
 
 /***********************************************************
@@ -246,17 +604,33 @@ void ViewManager::ProcessKeyboardEvents()
  ***********************************************************/
 void ViewManager::PrepareSceneView()
 {
+	TRACE_SCOPE("PrepareSceneView");
 	glm::mat4 view;
 	glm::mat4 projection;
 
-	// per-frame timing
-	float currentFrame = glfwGetTime();
-	gDeltaTime = currentFrame - gLastFrame;
-	gLastFrame = currentFrame;
-
-	// process any keyboard events that may be waiting in the 
-	// event queue
-	ProcessKeyboardEvents();
+	if (m_cameraPathMode == CAMERA_PATH_REPLAY)
+	{
+		// a replay advances by a fixed step, however long the
+		// frame took, so every run sees the same camera
+		gDeltaTime = REPLAY_TIMESTEP;
+		ReplayCameraFrame();
+	}
+	else
+	{
+		// per-frame timing
+		float currentFrame = glfwGetTime();
+		gDeltaTime = currentFrame - gLastFrame;
+		gLastFrame = currentFrame;
+
+		// process any keyboard events that may be waiting in the 
+		// event queue
+		ProcessKeyboardEvents();
+
+		if (m_cameraPathMode == CAMERA_PATH_RECORD)
+		{
+			RecordCameraFrame();
+		}
+	}
 
 	// get the current view matrix from the camera
 	view = g_pCamera->GetViewMatrix();
@@ -276,14 +650,18 @@ void ViewManager::PrepareSceneView()
 		projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
 	}
 
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+
 	// if the shader manager object is valid
 	if (NULL != m_pShaderManager)
 	{
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
+		// set the view matrix into the shader for proper rendering - the
+		// state cache skips the uploads while the camera stands still
+		GLStateCache::SetMat4(m_pShaderManager, g_ViewName, view);
+		// the projection only changes on zoom or a projection toggle
+		GLStateCache::SetMat4(m_pShaderManager, g_ProjectionName, projection);
 		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		GLStateCache::SetVec3(m_pShaderManager, "viewPosition", g_pCamera->Position);
 	}
 }
\ No newline at end of file
@@ -11,6 +11,7 @@
 
 #include "ShaderManager.h"
 #include "camera.h"
+#include "CameraPath.h"
 
 // GLFW library
 #include "GLFW/glfw3.h" 
@@ -30,14 +31,37 @@ public:
 	// mouse scroll position callback for mouse interaction with the 3D scene
 	static void Mouse_Scroll_Callback(GLFWwindow* window, double xOffset, double yOffset);
 
+	// mouse button callback for picking objects in the 3D scene
+	static void Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods);
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// camera matrices calculated for the current frame
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+
+	// camera path being recorded or replayed
+	CameraPath* m_pCameraPath;
+	int m_cameraPathMode;
+	std::string m_cameraPathFilename;
+	int m_replayFrame;
+	// wall clock time of each replayed frame, for the statistics
+	std::vector<double> m_replayFrameTimes;
+	double m_lastReplayTime;
+	// toggled with the H key
+	bool m_bShowPerfHud;
 
 	// process keyboard events for interaction with the 3D scene
 	void ProcessKeyboardEvents();
+	// append the camera state and input of this frame to the path
+	void RecordCameraFrame();
+	// set the camera from the next frame of the path
+	void ReplayCameraFrame();
+	// print the frame times measured over the replay
+	void PrintReplayStats() const;
 
 public:
 	// create the initial OpenGL display window
@@ -45,4 +69,40 @@ public:
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+
+	// camera matrices calculated by the last PrepareSceneView()
+	const glm::mat4& GetViewMatrix() const { return m_viewMatrix; }
+	const glm::mat4& GetProjectionMatrix() const { return m_projectionMatrix; }
+	// world space ray under the cursor of the last left click, once
+	// per click, through the camera of the last PrepareSceneView()
+	bool TakePickRay(glm::vec3& origin, glm::vec3& direction);
+
+	// place the camera at a fixed pose, for repeatable renders
+	void SetCameraPose(
+		glm::vec3 position,
+		glm::vec3 front,
+		float zoom,
+		bool bOrthographic);
+	// size of the viewport the projection is set up for
+	static int GetViewWidth();
+	static int GetViewHeight();
+
+	// whether the camera is driven by the user or by a path file
+	enum CAMERA_PATH_MODE
+	{
+		CAMERA_PATH_OFF = 0,
+		CAMERA_PATH_RECORD,
+		CAMERA_PATH_REPLAY
+	};
+	// record the camera of every frame until StopCameraPath()
+	void StartCameraRecording(const char* filename);
+	// drive the camera from a recorded path with a fixed timestep;
+	// the window closes after the last frame
+	bool StartCameraReplay(const char* filename);
+	// write the recording or print the replay frame times
+	void StopCameraPath();
+
+	// whether the performance HUD is drawn over the scene
+	bool IsPerfHudVisible() const { return m_bShowPerfHud; }
+	void SetPerfHudVisible(bool bVisible) { m_bShowPerfHud = bVisible; }
 };
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 330 core
+///////////////////////////////////////////////////////////////////////////////
+// hudfragmentshader.glsl
+// ============
+// performance HUD - the font atlas holds the coverage of the glyphs, and a
+// solid texel of it is used for the panel and the graph bars
+///////////////////////////////////////////////////////////////////////////////
+
+in vec2 fragmentTextureCoordinate;
+in vec4 fragmentColor;
+
+out vec4 outFragmentColor;
+
+uniform sampler2D fontTexture;
+
+void main()
+{
+	float coverage = texture(fontTexture, fragmentTextureCoordinate).r;
+	outFragmentColor = vec4(fragmentColor.rgb, fragmentColor.a * coverage);
+}
@@ -0,0 +1,25 @@
+#version 330 core
+///////////////////////////////////////////////////////////////////////////////
+// hudvertexshader.glsl
+// ============
+// performance HUD - the quads are placed in pixels from the top left corner
+// of the window and converted to clip space here
+///////////////////////////////////////////////////////////////////////////////
+
+layout (location = 0) in vec2 inPosition;
+layout (location = 1) in vec2 inTextureCoordinate;
+layout (location = 2) in vec4 inColor;
+
+out vec2 fragmentTextureCoordinate;
+out vec4 fragmentColor;
+
+// framebuffer size in pixels
+uniform vec2 screenSize;
+
+void main()
+{
+	vec2 clipPosition = (inPosition / screenSize) * 2.0f - 1.0f;
+	gl_Position = vec4(clipPosition.x, -clipPosition.y, 0.0f, 1.0f);
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentColor = inColor;
+}
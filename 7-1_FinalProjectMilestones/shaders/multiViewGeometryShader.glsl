@@ -0,0 +1,85 @@
+#version 330 core
+#extension GL_ARB_gpu_shader5 : require
+#extension GL_ARB_viewport_array : require
+///////////////////////////////////////////////////////////////////////////////
+// multiviewgeometryshader.glsl
+// ============
+// multi-view geometry shader - every triangle of the scene is sent to each
+// camera of the pass, one shader invocation per camera, and lands in the
+// camera's tile of the atlas through the viewport array
+//
+//  Only compiled into the ShaderPermutations variants with MULTI_VIEW set,
+//  which rename the scene vertex shader's outputs to the geometry* inputs
+//  below; the outputs keep the names the scene fragment shader reads.
+///////////////////////////////////////////////////////////////////////////////
+
+// must match MultiViewTarget::MAX_VIEWS
+#define MAX_VIEWS 16
+
+layout (triangles, invocations = MAX_VIEWS) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+in vec3 geometryPosition[];
+in vec3 geometryVertexNormal[];
+in vec2 geometryTextureCoordinate[];
+in vec4 geometryPositionLightSpace[];
+flat in vec4 geometryDrawColor[];
+flat in vec4 geometryDrawSurface[];
+flat in vec4 geometryDrawDiffuse[];
+flat in vec3 geometryDrawSpecular[];
+flat in ivec2 geometryDrawLights[];
+in vec3 geometryLightmapPosition[];
+in vec3 geometryObjectNormal[];
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+out vec4 fragmentPositionLightSpace;
+out float fragmentViewDepth;
+flat out vec4 drawColor;
+flat out vec4 drawSurface;
+flat out vec4 drawDiffuse;
+flat out vec3 drawSpecular;
+flat out ivec2 drawLights;
+out vec3 fragmentLightmapPosition;
+out vec3 fragmentObjectNormal;
+// camera of the view, in place of the viewPosition uniform
+flat out vec3 fragmentViewPosition;
+
+// projection * view and the world space position of every camera;
+// the invocations past viewCount emit nothing
+uniform mat4 viewProjections[MAX_VIEWS];
+uniform vec3 viewPositions[MAX_VIEWS];
+uniform int viewCount;
+
+void main()
+{
+	if (gl_InvocationID >= viewCount)
+	{
+		return;
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		gl_Position = viewProjections[gl_InvocationID] * vec4(geometryPosition[i], 1.0f);
+		gl_ViewportIndex = gl_InvocationID;
+
+		fragmentPosition = geometryPosition[i];
+		fragmentVertexNormal = geometryVertexNormal[i];
+		fragmentTextureCoordinate = geometryTextureCoordinate[i];
+		fragmentPositionLightSpace = geometryPositionLightSpace[i];
+		// w of a perspective projection is the distance in front
+		// of the camera
+		fragmentViewDepth = gl_Position.w;
+		drawColor = geometryDrawColor[i];
+		drawSurface = geometryDrawSurface[i];
+		drawDiffuse = geometryDrawDiffuse[i];
+		drawSpecular = geometryDrawSpecular[i];
+		drawLights = geometryDrawLights[i];
+		fragmentLightmapPosition = geometryLightmapPosition[i];
+		fragmentObjectNormal = geometryObjectNormal[i];
+		fragmentViewPosition = viewPositions[gl_InvocationID];
+		EmitVertex();
+	}
+	EndPrimitive();
+}
@@ -0,0 +1,406 @@
+#version 330 core
+///////////////////////////////////////////////////////////////////////////////
+// scenefragmentshader.glsl
+// ============
+// scene fragment shader - Phong lighting from one directional light and
+// any number of point lights, with shadows cast by the directional light
+//
+//  Loaded as is, this is the uber shader that branches on the texture and
+//  lighting switches at run time.  ShaderPermutations compiles specialized
+//  variants by defining SPECIALIZED together with VARIANT_TEXTURED and
+//  VARIANT_LIT (0 or 1) and VARIANT_POINT_LIGHTS, the number of leading
+//  pointLights[] entries that are active, or -1 to keep the point light
+//  mode branches.
+//
+//  Draws baked by LightmapBaker sample their light from the lightmap atlas
+//  instead of running the light loops.
+//
+//  Variants with MULTI_VIEW defined are drawn through the multi-view
+//  geometry shader, which passes the camera of each view along.
+///////////////////////////////////////////////////////////////////////////////
+
+#define TOTAL_POINT_LIGHTS 4
+
+// cluster grid dimensions - must match ClusteredLighting
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+
+// values of pointLightMode - must match ClusteredLighting::POINT_LIGHT_MODE
+#define LIGHTS_FIXED 0
+#define LIGHTS_CLUSTERED 1
+#define LIGHTS_ALL 2
+#define LIGHTS_OBJECT 3
+
+struct Material
+{
+	vec3 diffuseColor;
+	vec3 specularColor;
+	float shininess;
+	// below 1.0 the object is drawn in the blended pass
+	float opacity;
+};
+
+struct DirectionalLight
+{
+	vec3 direction;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+	bool bActive;
+};
+
+struct PointLight
+{
+	vec3 position;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+	float constant;
+	float linear;
+	float quadratic;
+	bool bActive;
+};
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+in vec4 fragmentPositionLightSpace;
+in float fragmentViewDepth;
+flat in vec4 drawColor;
+flat in vec4 drawSurface;
+flat in vec4 drawDiffuse;
+flat in vec3 drawSpecular;
+flat in ivec2 drawLights;
+in vec3 fragmentLightmapPosition;
+in vec3 fragmentObjectNormal;
+
+out vec4 outFragmentColor;
+
+uniform bool bUseLighting;
+uniform sampler2D objectTexture;
+#if defined(MULTI_VIEW)
+flat in vec3 fragmentViewPosition;
+#define viewPosition fragmentViewPosition
+#else
+uniform vec3 viewPosition;
+#endif
+uniform DirectionalLight directionalLight;
+uniform PointLight pointLights[TOTAL_POINT_LIGHTS];
+
+// material of the draw, filled in from the vertex shader's outputs
+Material material;
+
+// shadow map of the directional light - a depth texture with hardware
+// depth comparison enabled, so each tap returns a filtered 0..1 value
+uniform sampler2DShadow shadowMap;
+uniform bool bUseShadows;
+// PCF kernel radius in texels: 0 = single tap, 1 = 3x3, 2 = 5x5
+uniform int shadowPcfRadius;
+
+// clustered point lights - four RGBA32F texels per light, an
+// (offset, count) pair per cluster and the packed light index list
+uniform int pointLightMode;
+uniform int clusterLightCount;
+uniform samplerBuffer clusterLightData;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+uniform vec2 clusterTileSize;
+// slice = log(viewDepth) * scale + bias
+uniform vec2 clusterDepthParams;
+// per-object point light lists are stored with the draw data
+uniform samplerBuffer drawData;
+
+// baked lighting - the atlas position of the draw's first tile, the
+// tile size in atlas UV and in texels; no texels when not baked
+uniform vec4 lightmapRect;
+uniform sampler2D lightmapTexture;
+
+/***********************************************************
+ *  CalcShadowFactor()
+ *
+ *  Returns 1.0 for fully lit and 0.0 for fully shadowed.
+ ***********************************************************/
+float CalcShadowFactor(vec3 normal, vec3 lightDirection)
+{
+	if (!bUseShadows)
+	{
+		return 1.0f;
+	}
+
+	vec3 projected = fragmentPositionLightSpace.xyz / fragmentPositionLightSpace.w;
+	projected = projected * 0.5f + 0.5f;
+
+	// everything outside of the light frustum is lit
+	if (projected.z > 1.0f)
+	{
+		return 1.0f;
+	}
+
+	// slope scaled bias against shadow acne
+	float bias = max(0.0015f * (1.0f - dot(normal, lightDirection)), 0.0005f);
+	float compareDepth = projected.z - bias;
+
+	vec2 texelSize = 1.0f / vec2(textureSize(shadowMap, 0));
+	float lit = 0.0f;
+	int taps = 0;
+	for (int x = -shadowPcfRadius; x <= shadowPcfRadius; ++x)
+	{
+		for (int y = -shadowPcfRadius; y <= shadowPcfRadius; ++y)
+		{
+			vec2 offset = vec2(x, y) * texelSize;
+			lit += texture(shadowMap, vec3(projected.xy + offset, compareDepth));
+			taps++;
+		}
+	}
+
+	return lit / float(taps);
+}
+
+/***********************************************************
+ *  CalcDirectionalLight()
+ ***********************************************************/
+vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDirection, vec3 baseColor)
+{
+	vec3 lightDirection = normalize(-light.direction);
+
+	float diffuseImpact = max(dot(normal, lightDirection), 0.0f);
+	vec3 reflectDirection = reflect(-lightDirection, normal);
+	float specularImpact = pow(max(dot(viewDirection, reflectDirection), 0.0f), material.shininess);
+
+	vec3 ambient = light.ambient * baseColor;
+	vec3 diffuse = light.diffuse * diffuseImpact * material.diffuseColor * baseColor;
+	vec3 specular = light.specular * specularImpact * material.specularColor;
+
+	float shadow = CalcShadowFactor(normal, lightDirection);
+
+	return ambient + shadow * (diffuse + specular);
+}
+
+/***********************************************************
+ *  CalcPointLight()
+ ***********************************************************/
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDirection, vec3 baseColor)
+{
+	vec3 lightDirection = normalize(light.position - fragmentPosition);
+
+	float diffuseImpact = max(dot(normal, lightDirection), 0.0f);
+	vec3 reflectDirection = reflect(-lightDirection, normal);
+	float specularImpact = pow(max(dot(viewDirection, reflectDirection), 0.0f), material.shininess);
+
+	float distance = length(light.position - fragmentPosition);
+	float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+	vec3 ambient = light.ambient * baseColor;
+	vec3 diffuse = light.diffuse * diffuseImpact * material.diffuseColor * baseColor;
+	vec3 specular = light.specular * specularImpact * material.specularColor;
+
+	return (ambient + diffuse + specular) * attenuation;
+}
+
+/***********************************************************
+ *  CalcBufferLight()
+ *
+ *  Shades with one light from the light data buffer.  The
+ *  lights are range limited, so anything beyond the radius
+ *  is skipped.
+ ***********************************************************/
+vec3 CalcBufferLight(int lightIndex, vec3 normal, vec3 viewDirection, vec3 baseColor)
+{
+	int texel = lightIndex * 4;
+	vec4 positionRadius = texelFetch(clusterLightData, texel);
+
+	vec3 toLight = positionRadius.xyz - fragmentPosition;
+	if (dot(toLight, toLight) > positionRadius.w * positionRadius.w)
+	{
+		return vec3(0.0f);
+	}
+
+	vec4 ambientConstant = texelFetch(clusterLightData, texel + 1);
+	vec4 diffuseLinear = texelFetch(clusterLightData, texel + 2);
+	vec4 specularQuadratic = texelFetch(clusterLightData, texel + 3);
+
+	PointLight light;
+	light.position = positionRadius.xyz;
+	light.ambient = ambientConstant.rgb;
+	light.constant = ambientConstant.w;
+	light.diffuse = diffuseLinear.rgb;
+	light.linear = diffuseLinear.w;
+	light.specular = specularQuadratic.rgb;
+	light.quadratic = specularQuadratic.w;
+	light.bActive = true;
+
+	return CalcPointLight(light, normal, viewDirection, baseColor);
+}
+
+/***********************************************************
+ *  CalcClusteredLights()
+ *
+ *  Shades with the lights that were binned into the cluster
+ *  containing this fragment.
+ ***********************************************************/
+vec3 CalcClusteredLights(vec3 normal, vec3 viewDirection, vec3 baseColor)
+{
+	ivec3 cluster = ivec3(
+		int(gl_FragCoord.x / clusterTileSize.x),
+		int(gl_FragCoord.y / clusterTileSize.y),
+		int(log(fragmentViewDepth) * clusterDepthParams.x + clusterDepthParams.y));
+	cluster = clamp(cluster, ivec3(0), ivec3(CLUSTERS_X - 1, CLUSTERS_Y - 1, CLUSTERS_Z - 1));
+
+	int clusterIndex = (cluster.z * CLUSTERS_Y + cluster.y) * CLUSTERS_X + cluster.x;
+	uvec2 range = texelFetch(clusterGrid, clusterIndex).xy;
+
+	vec3 result = vec3(0.0f);
+	for (uint i = 0u; i < range.y; i++)
+	{
+		int lightIndex = int(texelFetch(clusterLightIndices, int(range.x + i)).r);
+		result += CalcBufferLight(lightIndex, normal, viewDirection, baseColor);
+	}
+	return result;
+}
+
+/***********************************************************
+ *  CalcObjectLights()
+ *
+ *  Shades with the lights that were found to reach the draw
+ *  on the CPU.  Draws without a light list use every light.
+ ***********************************************************/
+vec3 CalcObjectLights(vec3 normal, vec3 viewDirection, vec3 baseColor)
+{
+	vec3 result = vec3(0.0f);
+	if (drawLights.x < 0)
+	{
+		for (int i = 0; i < clusterLightCount; i++)
+		{
+			result += CalcBufferLight(i, normal, viewDirection, baseColor);
+		}
+		return result;
+	}
+
+	for (int i = 0; i < drawLights.y; i++)
+	{
+		int lightIndex = int(texelFetch(drawData, drawLights.x + i / 4)[i % 4]);
+		result += CalcBufferLight(lightIndex, normal, viewDirection, baseColor);
+	}
+	return result;
+}
+
+/***********************************************************
+ *  SampleLightmap()
+ *
+ *  The draw has six tiles in the atlas, three by two, one
+ *  for each face direction of its bounds.  The tile is the
+ *  one the object space normal points to the most, and the
+ *  position on the face gives the texel - the same mapping
+ *  LightmapBaker bakes with.
+ ***********************************************************/
+vec3 SampleLightmap()
+{
+	vec3 magnitude = abs(fragmentObjectNormal);
+	int tile;
+	vec2 faceUV;
+	if ((magnitude.x >= magnitude.y) && (magnitude.x >= magnitude.z))
+	{
+		tile = (fragmentObjectNormal.x >= 0.0f) ? 0 : 1;
+		faceUV = fragmentLightmapPosition.zy;
+	}
+	else if (magnitude.y >= magnitude.z)
+	{
+		tile = (fragmentObjectNormal.y >= 0.0f) ? 2 : 3;
+		faceUV = fragmentLightmapPosition.xz;
+	}
+	else
+	{
+		tile = (fragmentObjectNormal.z >= 0.0f) ? 4 : 5;
+		faceUV = fragmentLightmapPosition.xy;
+	}
+
+	// stay half a texel inside of the tile, so the filter never
+	// reads the neighboring tiles
+	float halfTexel = 0.5f / lightmapRect.w;
+	faceUV = clamp(faceUV, vec2(halfTexel), vec2(1.0f - halfTexel));
+
+	vec2 tileOrigin = vec2(float(tile % 3), float(tile / 3));
+	return texture(lightmapTexture, lightmapRect.xy + (tileOrigin + faceUV) * lightmapRect.z).rgb;
+}
+
+void main()
+{
+	// the per-draw values are passed on by the vertex shader
+	material = Material(drawDiffuse.rgb, drawSpecular, drawSurface.z, drawSurface.w);
+
+#if defined(SPECIALIZED)
+#if VARIANT_TEXTURED
+	vec4 baseColor = texture(objectTexture, fragmentTextureCoordinate * drawSurface.xy);
+#else
+	vec4 baseColor = drawColor;
+#endif
+#if !VARIANT_LIT
+	outFragmentColor = vec4(baseColor.rgb, baseColor.a * material.opacity);
+	return;
+#endif
+#else
+	vec4 baseColor = drawColor;
+	if (drawDiffuse.a > 0.5f)
+	{
+		baseColor = texture(objectTexture, fragmentTextureCoordinate * drawSurface.xy);
+	}
+
+	if (!bUseLighting)
+	{
+		outFragmentColor = vec4(baseColor.rgb, baseColor.a * material.opacity);
+		return;
+	}
+#endif
+
+	if (lightmapRect.w > 0.0f)
+	{
+		outFragmentColor = vec4(baseColor.rgb * SampleLightmap(), baseColor.a * material.opacity);
+		return;
+	}
+
+	vec3 normal = normalize(fragmentVertexNormal);
+	vec3 viewDirection = normalize(viewPosition - fragmentPosition);
+	vec3 phongResult = vec3(0.0f);
+
+	if (directionalLight.bActive)
+	{
+		phongResult += CalcDirectionalLight(directionalLight, normal, viewDirection, baseColor.rgb);
+	}
+
+#if defined(SPECIALIZED) && (VARIANT_POINT_LIGHTS >= 0)
+	// only the active fixed lights, without testing their flags
+	for (int i = 0; i < VARIANT_POINT_LIGHTS; i++)
+	{
+		phongResult += CalcPointLight(pointLights[i], normal, viewDirection, baseColor.rgb);
+	}
+#else
+	if (pointLightMode == LIGHTS_CLUSTERED)
+	{
+		phongResult += CalcClusteredLights(normal, viewDirection, baseColor.rgb);
+	}
+	else if (pointLightMode == LIGHTS_OBJECT)
+	{
+		phongResult += CalcObjectLights(normal, viewDirection, baseColor.rgb);
+	}
+	else if (pointLightMode == LIGHTS_ALL)
+	{
+		for (int i = 0; i < clusterLightCount; i++)
+		{
+			phongResult += CalcBufferLight(i, normal, viewDirection, baseColor.rgb);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < TOTAL_POINT_LIGHTS; i++)
+		{
+			if (pointLights[i].bActive)
+			{
+				phongResult += CalcPointLight(pointLights[i], normal, viewDirection, baseColor.rgb);
+			}
+		}
+	}
+#endif
+
+	outFragmentColor = vec4(phongResult, baseColor.a * material.opacity);
+}
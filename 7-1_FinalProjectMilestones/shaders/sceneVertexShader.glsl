@@ -0,0 +1,182 @@
+#version 330 core
+///////////////////////////////////////////////////////////////////////////////
+// scenevertexshader.glsl
+// ============
+// scene vertex shader - transforms the mesh vertices into clip space and
+// passes the world space position, normal and UVs to the fragment shader;
+// instanced foliage is placed and swayed per instance, and the per-draw
+// data is fetched from the draw data ring or taken from the uniforms;
+// baked draws also get the position and normal their lightmap UVs are
+// derived from
+//
+//  With MULTI_VIEW defined the outputs go to the multi-view geometry shader,
+//  which sends every triangle to each camera of the pass.
+///////////////////////////////////////////////////////////////////////////////
+
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+// foliage instances - offset from the plant origin and scale, and the
+// stretch, yaw, sway phase and sway amplitude
+layout (location = 3) in vec4 inInstancePlacement;
+layout (location = 4) in vec4 inInstanceShape;
+
+struct Material
+{
+	vec3 diffuseColor;
+	vec3 specularColor;
+	float shininess;
+	float opacity;
+};
+
+#if defined(MULTI_VIEW)
+// the geometry shader reads the outputs under these names and passes
+// them on to the fragment shader under the usual ones
+#define fragmentPosition geometryPosition
+#define fragmentVertexNormal geometryVertexNormal
+#define fragmentTextureCoordinate geometryTextureCoordinate
+#define fragmentPositionLightSpace geometryPositionLightSpace
+#define fragmentViewDepth geometryViewDepth
+#define drawColor geometryDrawColor
+#define drawSurface geometryDrawSurface
+#define drawDiffuse geometryDrawDiffuse
+#define drawSpecular geometryDrawSpecular
+#define drawLights geometryDrawLights
+#define fragmentLightmapPosition geometryLightmapPosition
+#define fragmentObjectNormal geometryObjectNormal
+#endif
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+out vec4 fragmentPositionLightSpace;
+// positive distance in front of the camera, used for the cluster lookup
+out float fragmentViewDepth;
+// per-draw surface values, the same for every vertex of a draw
+flat out vec4 drawColor;
+// UV scale, shininess and opacity
+flat out vec4 drawSurface;
+// diffuse color and whether the texture is used
+flat out vec4 drawDiffuse;
+flat out vec3 drawSpecular;
+// texel of the draw's first point light index and the light count
+flat out ivec2 drawLights;
+// position in the 0..1 cube of the mesh bounds and the object space
+// normal, which pick the lightmap tile and the texel within it
+out vec3 fragmentLightmapPosition;
+out vec3 fragmentObjectNormal;
+
+// the depth pre-pass uses this shader too, and the shading pass
+// tests against its depth with GL_LEQUAL
+invariant gl_Position;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// transforms world space into the directional light's clip space
+uniform mat4 lightSpaceMatrix;
+
+// the instance attributes are only read for the foliage draws
+uniform bool bInstanced;
+uniform float swayTime;
+
+// per-draw data - when bUseDrawData is set it is read from the draw
+// data ring at drawIndex, otherwise it comes from the uniforms below
+uniform bool bUseDrawData;
+uniform int drawIndex;
+uniform samplerBuffer drawData;
+uniform bool bUseTexture;
+uniform vec4 objectColor;
+uniform vec2 UVscale;
+uniform Material material;
+
+// object space to the 0..1 cube of the mesh bounds, for baked draws
+uniform mat4 lightmapTransform;
+
+// RGBA32F texels per draw - must match DrawDataRing::TEXELS_PER_DRAW
+const int TEXELS_PER_DRAW = 9;
+
+const float SWAY_SPEED = 1.7f;
+
+/***********************************************************
+ *  InstanceTransform()
+ *
+ *  Yaw, scale and stretch of the instance, placed at its
+ *  offset from the plant origin.  The offset swings back and
+ *  forth further the higher the instance sits, like the tip
+ *  of a bending stem.
+ ***********************************************************/
+mat4 InstanceTransform()
+{
+	float scale = inInstancePlacement.w;
+	float stretch = inInstanceShape.x;
+	float cosYaw = cos(inInstanceShape.y);
+	float sinYaw = sin(inInstanceShape.y);
+
+	vec3 offset = inInstancePlacement.xyz;
+	float bend = inInstanceShape.w * max(offset.y, 0.0f);
+	float phase = inInstanceShape.z;
+	offset.x += bend * sin(swayTime * SWAY_SPEED + phase);
+	offset.z += bend * 0.6f * sin(swayTime * SWAY_SPEED * 1.3f + phase * 1.7f);
+
+	return mat4(
+		vec4(cosYaw * scale, 0.0f, -sinYaw * scale, 0.0f),
+		vec4(0.0f, scale, 0.0f, 0.0f),
+		vec4(sinYaw * scale * stretch, 0.0f, cosYaw * scale * stretch, 0.0f),
+		vec4(offset, 1.0f));
+}
+
+/***********************************************************
+ *  LoadDrawData()
+ *
+ *  Read the draw's model matrix and surface values.  The
+ *  matrix is stored as its first three rows, the fourth row
+ *  of an affine transform is always 0,0,0,1.
+ ***********************************************************/
+mat4 LoadDrawData()
+{
+	if (!bUseDrawData)
+	{
+		drawColor = objectColor;
+		drawSurface = vec4(UVscale, material.shininess, material.opacity);
+		drawDiffuse = vec4(material.diffuseColor, bUseTexture ? 1.0f : 0.0f);
+		drawSpecular = material.specularColor;
+		// no light list - the fragment shader uses every light
+		drawLights = ivec2(-1, 0);
+		return model;
+	}
+
+	int base = drawIndex * TEXELS_PER_DRAW;
+	vec4 row0 = texelFetch(drawData, base);
+	vec4 row1 = texelFetch(drawData, base + 1);
+	vec4 row2 = texelFetch(drawData, base + 2);
+	drawColor = texelFetch(drawData, base + 3);
+	drawSurface = texelFetch(drawData, base + 4);
+	drawDiffuse = texelFetch(drawData, base + 5);
+	vec4 specularLights = texelFetch(drawData, base + 6);
+	drawSpecular = specularLights.rgb;
+	drawLights = ivec2(base + 7, int(specularLights.w));
+	return transpose(mat4(row0, row1, row2, vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+void main()
+{
+	mat4 objectModel = LoadDrawData();
+	if (bInstanced)
+	{
+		objectModel = objectModel * InstanceTransform();
+	}
+
+	vec4 worldPosition = objectModel * vec4(inVertexPosition, 1.0f);
+
+	gl_Position = projection * view * worldPosition;
+
+	fragmentPosition = vec3(worldPosition);
+	fragmentVertexNormal = mat3(transpose(inverse(objectModel))) * inVertexNormal;
+	fragmentTextureCoordinate = inTextureCoordinate;
+	fragmentPositionLightSpace = lightSpaceMatrix * worldPosition;
+	fragmentViewDepth = -(view * worldPosition).z;
+	fragmentLightmapPosition = vec3(lightmapTransform * vec4(inVertexPosition, 1.0f));
+	fragmentObjectNormal = inVertexNormal;
+}
@@ -0,0 +1,12 @@
+#version 330 core
+///////////////////////////////////////////////////////////////////////////////
+// shadowdepthfragmentshader.glsl
+// ============
+// depth only fragment shader for rendering the directional light shadow map,
+// also paired with the scene vertex shader for the depth pre-pass
+///////////////////////////////////////////////////////////////////////////////
+
+void main()
+{
+	// only the depth buffer is written
+}
@@ -0,0 +1,37 @@
+#version 330 core
+///////////////////////////////////////////////////////////////////////////////
+// shadowdepthvertexshader.glsl
+// ============
+// depth only vertex shader for rendering the directional light shadow map
+///////////////////////////////////////////////////////////////////////////////
+
+layout (location = 0) in vec3 inVertexPosition;
+// foliage instances, see scenevertexshader.glsl
+layout (location = 3) in vec4 inInstancePlacement;
+layout (location = 4) in vec4 inInstanceShape;
+
+uniform mat4 model;
+uniform mat4 lightSpaceMatrix;
+
+// the shadow map is cached between frames, so the foliage casts
+// the shadow of its rest pose and does not sway here
+uniform bool bInstanced;
+
+void main()
+{
+	mat4 objectModel = model;
+	if (bInstanced)
+	{
+		float scale = inInstancePlacement.w;
+		float stretch = inInstanceShape.x;
+		float cosYaw = cos(inInstanceShape.y);
+		float sinYaw = sin(inInstanceShape.y);
+		objectModel = model * mat4(
+			vec4(cosYaw * scale, 0.0f, -sinYaw * scale, 0.0f),
+			vec4(0.0f, scale, 0.0f, 0.0f),
+			vec4(sinYaw * scale * stretch, 0.0f, cosYaw * scale * stretch, 0.0f),
+			vec4(inInstancePlacement.xyz, 1.0f));
+	}
+
+	gl_Position = lightSpaceMatrix * objectModel * vec4(inVertexPosition, 1.0f);
+}
@@ -0,0 +1,33 @@
+#version 330 core
+///////////////////////////////////////////////////////////////////////////////
+// upscalefragmentshader.glsl
+// ============
+// bilinear upscale of the rendered part of the dynamic resolution target,
+// followed by an unsharp mask that restores some of the lost edge contrast
+///////////////////////////////////////////////////////////////////////////////
+
+in vec2 fragmentScreenCoord;
+
+out vec4 outFragmentColor;
+
+uniform sampler2D sourceTexture;
+// rendered size divided by the texture size
+uniform vec2 sourceScale;
+// size of one rendered pixel in texture coordinates
+uniform vec2 sourceTexelSize;
+// 0 gives the plain bilinear result
+uniform float sharpness;
+
+void main()
+{
+	vec2 uv = fragmentScreenCoord * sourceScale;
+	vec3 center = texture(sourceTexture, uv).rgb;
+
+	vec3 neighbors = texture(sourceTexture, uv + vec2(sourceTexelSize.x, 0.0f)).rgb
+		+ texture(sourceTexture, uv - vec2(sourceTexelSize.x, 0.0f)).rgb
+		+ texture(sourceTexture, uv + vec2(0.0f, sourceTexelSize.y)).rgb
+		+ texture(sourceTexture, uv - vec2(0.0f, sourceTexelSize.y)).rgb;
+
+	vec3 sharpened = center + (center * 4.0f - neighbors) * (sharpness * 0.25f);
+	outFragmentColor = vec4(clamp(sharpened, 0.0f, 1.0f), 1.0f);
+}
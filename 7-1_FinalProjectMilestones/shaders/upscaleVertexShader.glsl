@@ -0,0 +1,16 @@
+#version 330 core
+///////////////////////////////////////////////////////////////////////////////
+// upscalevertexshader.glsl
+// ============
+// full screen triangle for upscaling the dynamic resolution render target,
+// generated from the vertex index so that no vertex buffer is needed
+///////////////////////////////////////////////////////////////////////////////
+
+out vec2 fragmentScreenCoord;
+
+void main()
+{
+	vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+	fragmentScreenCoord = corner;
+	gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+}